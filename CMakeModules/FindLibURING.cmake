@@ -0,0 +1,80 @@
+# - Try to find liburing
+# Once done this will define
+#
+#  LIBURING_FOUND - system has liburing with io_uring_submit_and_wait_timeout() (liburing >= 2.2)
+#  LIBURING_INCLUDE_DIRS - the liburing include directory
+#  LIBURING_LIBRARIES - link these to use liburing
+#
+#  Copyright (c) 2026 CESNET, z.s.p.o.
+#
+#  Redistribution and use in source and binary forms, with or without
+#  modification, are permitted provided that the following conditions
+#  are met:
+#
+#  1. Redistributions of source code must retain the copyright
+#     notice, this list of conditions and the following disclaimer.
+#  2. Redistributions in binary form must reproduce the copyright
+#     notice, this list of conditions and the following disclaimer in the
+#     documentation and/or other materials provided with the distribution.
+#  3. The name of the author may not be used to endorse or promote products
+#     derived from this software without specific prior written permission.
+#
+#  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+#  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+#  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+#  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+#  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+#  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+#  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+#  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+#  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+#  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+if(LIBURING_LIBRARIES AND LIBURING_INCLUDE_DIRS)
+  # in cache already
+  set(LIBURING_FOUND TRUE)
+else()
+
+  find_path(LIBURING_INCLUDE_DIR
+    NAMES
+      liburing.h
+    PATHS
+      /opt/local/include
+      /sw/include
+      ${CMAKE_INCLUDE_PATH}
+      ${CMAKE_INSTALL_PREFIX}/include
+  )
+
+  find_library(LIBURING_LIBRARY
+    NAMES
+      uring
+    PATHS
+      /usr/lib
+      /usr/lib64
+      /opt/local/lib
+      /sw/lib
+      ${CMAKE_LIBRARY_PATH}
+      ${CMAKE_INSTALL_PREFIX}/lib
+  )
+
+  if(LIBURING_INCLUDE_DIR AND LIBURING_LIBRARY)
+    # the version is not available in older headers, so see if the declaration of a function
+    # io_uring_submit_and_wait_timeout is in the header file (added in liburing 2.2)
+    file(STRINGS ${LIBURING_INCLUDE_DIR}/liburing.h URING_SUBMIT_TIMEOUT REGEX "io_uring_submit_and_wait_timeout")
+    if ("${URING_SUBMIT_TIMEOUT}" STREQUAL "")
+      set(LIBURING_FOUND FALSE)
+    else()
+      set(LIBURING_FOUND TRUE)
+    endif()
+  else()
+    set(LIBURING_FOUND FALSE)
+  endif()
+
+  set(LIBURING_INCLUDE_DIRS ${LIBURING_INCLUDE_DIR})
+  set(LIBURING_LIBRARIES ${LIBURING_LIBRARY})
+
+  # show the LIBURING_INCLUDE_DIRS and LIBURING_LIBRARIES variables only in the advanced view
+  mark_as_advanced(LIBURING_INCLUDE_DIRS LIBURING_LIBRARIES)
+
+endif()
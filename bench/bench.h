@@ -0,0 +1,222 @@
+/**
+ * \file bench.h
+ * \brief libnetconf2 benchmarks - common functions
+ *
+ * Copyright (c) 2026 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#ifndef NC_BENCH_H_
+#define NC_BENCH_H_
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libyang/libyang.h>
+
+#include <session_client.h>
+#include <session_p.h>
+#include <session_server.h>
+#include "bench/config.h"
+
+/*
+ * Every measurement is printed as a single JSON object on its own line (JSON Lines):
+ * {"bench":"<name>",<parameters>,"ops":<count>,"seconds":<time>,"ops_per_sec":<rate>,"bytes_per_sec":<rate>}
+ *
+ * The amount of work of every measurement is fixed so that the results of different runs are comparable,
+ * it can be multiplied by a non-negative number set in the NC_BENCH_SCALE environment variable.
+ */
+
+#define bench_assert(cond) if (!(cond)) { fprintf(stderr, "bench assert failed (%s:%d)\n", __FILE__, __LINE__); exit(1); }
+
+/**
+ * @brief Get the number of operations of a measurement.
+ *
+ * @param[in] ops Default number of operations.
+ * @return Number of operations scaled by NC_BENCH_SCALE, at least 1.
+ */
+static inline uint64_t
+bench_ops(uint64_t ops)
+{
+    const char *scale;
+    double s;
+
+    scale = getenv("NC_BENCH_SCALE");
+    if (scale) {
+        s = strtod(scale, NULL);
+        if (s > 0) {
+            ops = ops * s;
+        }
+    }
+
+    return ops ? ops : 1;
+}
+
+/**
+ * @brief Get the current monotonic time.
+ *
+ * @return Time in seconds.
+ */
+static inline double
+bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Print the result of a measurement.
+ *
+ * @param[in] bench Benchmark name.
+ * @param[in] params JSON members with the parameters of the measurement, without surrounding braces.
+ * @param[in] ops Number of operations performed.
+ * @param[in] bytes Number of bytes transferred, 0 if not relevant.
+ * @param[in] seconds Time the operations took.
+ */
+static inline void
+bench_report(const char *bench, const char *params, uint64_t ops, uint64_t bytes, double seconds)
+{
+    printf("{\"bench\":\"%s\"%s%s,\"ops\":%" PRIu64 ",\"seconds\":%.6f,\"ops_per_sec\":%.1f", bench,
+            params[0] ? "," : "", params, ops, seconds, seconds > 0 ? ops / seconds : 0.0);
+    if (bytes) {
+        printf(",\"bytes_per_sec\":%.1f", seconds > 0 ? bytes / seconds : 0.0);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+static inline struct nc_server_reply *
+bench_get_clb(struct lyd_node *rpc, struct nc_session *session)
+{
+    (void)rpc;
+    (void)session;
+
+    return nc_server_reply_ok();
+}
+
+/**
+ * @brief Create the server context of the benchmarks with a "get" callback replying "ok".
+ *
+ * @return Created context.
+ */
+static inline struct ly_ctx *
+bench_ctx_new(void)
+{
+    struct ly_ctx *ctx;
+    struct lysc_node *rpc;
+    const char *nc_features[] = {"candidate", NULL};
+
+    bench_assert(!ly_ctx_new(BENCH_DATA_DIR "/modules", 0, &ctx));
+    bench_assert(ly_ctx_load_module(ctx, "ietf-netconf-acm", NULL, NULL));
+    bench_assert(ly_ctx_load_module(ctx, "ietf-netconf", NULL, nc_features));
+    bench_assert(ly_ctx_load_module(ctx, "nc-notifications", NULL, NULL));
+
+    rpc = (struct lysc_node *)lys_find_path(ctx, NULL, "/ietf-netconf:get", 0);
+    bench_assert(rpc);
+    rpc->priv = bench_get_clb;
+
+    return ctx;
+}
+
+struct bench_accept_arg {
+    int fd;
+    const struct ly_ctx *ctx;
+    struct nc_session *session;
+};
+
+static inline void *
+bench_accept_thread(void *arg)
+{
+    struct bench_accept_arg *a = arg;
+
+    bench_assert(nc_accept_inout(a->fd, a->fd, "bench", a->ctx, &a->session) == NC_MSG_HELLO);
+    return NULL;
+}
+
+/**
+ * @brief Create a connected pair of server and client sessions on a socketpair.
+ *
+ * @param[in] ctx Context of both the sessions.
+ * @param[out] server Server session.
+ * @param[out] client Client session.
+ */
+static inline void
+bench_session_pair(struct ly_ctx *ctx, struct nc_session **server, struct nc_session **client)
+{
+    int sock[2];
+    pthread_t tid;
+    struct bench_accept_arg arg;
+
+    bench_assert(!socketpair(AF_UNIX, SOCK_STREAM, 0, sock));
+
+    arg.fd = sock[0];
+    arg.ctx = ctx;
+    arg.session = NULL;
+    bench_assert(!pthread_create(&tid, NULL, bench_accept_thread, &arg));
+
+    *client = nc_connect_inout(sock[1], sock[1], ctx);
+    bench_assert(*client);
+
+    pthread_join(tid, NULL);
+    *server = arg.session;
+}
+
+/**
+ * @brief Create a connected pair of server and client sessions on a socketpair or in memory.
+ *
+ * @param[in] ctx Context of both the sessions.
+ * @param[in] mem Whether to use the in-memory transport.
+ * @param[out] server Server session.
+ * @param[out] client Client session.
+ */
+static inline void
+bench_session_pair_ti(struct ly_ctx *ctx, int mem, struct nc_session **server, struct nc_session **client)
+{
+    if (mem) {
+        bench_assert(nc_accept_mem("bench", ctx, server, client) == NC_MSG_HELLO);
+    } else {
+        bench_session_pair(ctx, server, client);
+    }
+}
+
+/**
+ * @brief Free a pair of sessions created by bench_session_pair() or bench_session_pair_ti() and close their socketpair.
+ *
+ * @param[in] server Server session.
+ * @param[in] client Client session.
+ */
+static inline void
+bench_session_pair_free(struct nc_session *server, struct nc_session *client)
+{
+    int fd;
+
+    if (nc_session_get_ti(server) == NC_TI_MEM) {
+        /* no file descriptors to close */
+        nc_session_free(server, NULL);
+        nc_session_free(client, NULL);
+        return;
+    }
+
+    fd = server->ti.fd.in;
+    nc_session_free(server, NULL);
+    close(fd);
+
+    fd = client->ti.fd.in;
+    nc_session_free(client, NULL);
+    close(fd);
+}
+
+#endif /* NC_BENCH_H_ */
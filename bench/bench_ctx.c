@@ -0,0 +1,114 @@
+/**
+ * \file bench_ctx.c
+ * \brief libnetconf2 benchmarks - time of creating and filling the context of a new client session
+ *
+ * Copyright (c) 2026 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <libyang/libyang.h>
+
+#include "bench/bench.h"
+
+/* number of client sessions connected for every configuration */
+#define BENCH_CTX_CONNECTS 50
+
+struct bench_ctx_arg {
+    int fd;
+    const struct ly_ctx *ctx;
+};
+
+static void *
+bench_ctx_server(void *arg)
+{
+    struct bench_ctx_arg *a = arg;
+    struct nc_pollsession *ps;
+    struct nc_session *session;
+    int ret;
+
+    bench_assert(nc_accept_inout(a->fd, a->fd, "bench", a->ctx, &session) == NC_MSG_HELLO);
+    ps = nc_ps_new();
+    bench_assert(ps);
+    bench_assert(!nc_ps_add_session(ps, session));
+
+    /* serve the RPCs of the client filling its context until it closes the session */
+    do {
+        ret = nc_ps_poll(ps, -1, NULL);
+        bench_assert(!(ret & NC_PSPOLL_ERROR));
+    } while (!(ret & NC_PSPOLL_SESSION_TERM));
+
+    nc_ps_free(ps);
+    nc_session_free(session, NULL);
+    close(a->fd);
+
+    nc_thread_destroy();
+    return NULL;
+}
+
+static void
+bench_ctx_fill(struct ly_ctx *ctx, int pool)
+{
+    struct nc_session *client;
+    struct bench_ctx_arg arg;
+    pthread_t tid;
+    int sock[2];
+    char params[16];
+    uint64_t i, count;
+    double start, total = 0;
+
+    bench_assert(!nc_client_set_ctx_pool(pool));
+
+    count = bench_ops(BENCH_CTX_CONNECTS);
+    for (i = 0; i < count; ++i) {
+        bench_assert(!socketpair(AF_UNIX, SOCK_STREAM, 0, sock));
+        arg.fd = sock[0];
+        arg.ctx = ctx;
+        bench_assert(!pthread_create(&tid, NULL, bench_ctx_server, &arg));
+
+        /* only the connect is measured, it creates and fills the context */
+        start = bench_now();
+        client = nc_connect_inout(sock[1], sock[1], NULL);
+        total += bench_now() - start;
+        bench_assert(client);
+
+        nc_session_free(client, NULL);
+        pthread_join(tid, NULL);
+        close(sock[1]);
+    }
+
+    sprintf(params, "\"pool\":%d", pool);
+    bench_report("client_ctx_fill", params, count, 0, total);
+}
+
+int
+main(void)
+{
+    struct ly_ctx *ctx;
+
+    nc_server_init();
+    nc_client_init();
+    bench_assert(!nc_client_set_schema_searchpath(BENCH_DATA_DIR "/modules"));
+    ctx = bench_ctx_new();
+
+    bench_ctx_fill(ctx, 0);
+    bench_ctx_fill(ctx, 1);
+
+    ly_ctx_destroy(ctx);
+    nc_client_destroy();
+    nc_server_destroy();
+    return 0;
+}
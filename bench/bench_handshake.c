@@ -0,0 +1,232 @@
+/**
+ * \file bench_handshake.c
+ * \brief libnetconf2 benchmarks - SSH and TLS accept and handshake rate
+ *
+ * Copyright (c) 2026 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libyang/libyang.h>
+
+#include "bench/bench.h"
+
+/* number of sessions established for every transport */
+#define BENCH_HANDSHAKE_CONNECTS 100
+/* millisec */
+#define BENCH_ACCEPT_TIMEOUT 5000
+
+#define BENCH_SSH_PORT 6101
+#define BENCH_TLS_PORT 6601
+
+struct bench_handshake_arg {
+    const struct ly_ctx *ctx;
+    uint64_t count;
+};
+
+static void *
+bench_handshake_server(void *arg)
+{
+    struct bench_handshake_arg *a = arg;
+    struct nc_session *session;
+    uint64_t i;
+
+    for (i = 0; i < a->count; ++i) {
+        bench_assert(nc_accept(BENCH_ACCEPT_TIMEOUT, a->ctx, &session) == NC_MSG_HELLO);
+        nc_session_free(session, NULL);
+    }
+
+    nc_thread_destroy();
+    return NULL;
+}
+
+/**
+ * @brief Measure the rate of establishing sessions with a client connect callback.
+ *
+ * @param[in] ctx Context of the sessions.
+ * @param[in] transport Name of the transport.
+ * @param[in] connect Callback connecting a client session.
+ */
+static void
+bench_handshake(struct ly_ctx *ctx, const char *transport, struct nc_session *(*connect)(struct ly_ctx *ctx))
+{
+    struct bench_handshake_arg arg;
+    struct nc_session *client;
+    pthread_t tid;
+    char params[32];
+    uint64_t i;
+    double start, total = 0;
+
+    arg.ctx = ctx;
+    arg.count = bench_ops(BENCH_HANDSHAKE_CONNECTS);
+    bench_assert(!pthread_create(&tid, NULL, bench_handshake_server, &arg));
+
+    for (i = 0; i < arg.count; ++i) {
+        /* only the connect is measured, it includes the transport handshake and the hello exchange */
+        start = bench_now();
+        client = connect(ctx);
+        total += bench_now() - start;
+        bench_assert(client);
+        nc_session_free(client, NULL);
+    }
+    pthread_join(tid, NULL);
+
+    sprintf(params, "\"transport\":\"%s\"", transport);
+    bench_report("handshake", params, arg.count, 0, total);
+}
+
+#ifdef NC_ENABLED_SSH
+
+static int
+bench_hostkey_clb(const char *name, void *user_data, char **privkey_path, char **privkey_data,
+        NC_SSH_KEY_TYPE *privkey_type)
+{
+    (void)user_data;
+    (void)privkey_data;
+    (void)privkey_type;
+
+    if (!strcmp(name, "key_rsa")) {
+        *privkey_path = strdup(BENCH_DATA_DIR "/key_rsa");
+        return 0;
+    }
+
+    return 1;
+}
+
+static int
+bench_ssh_hostkey_check_clb(const char *hostname, ssh_session session, void *priv)
+{
+    (void)hostname;
+    (void)session;
+    (void)priv;
+
+    return 0;
+}
+
+static struct nc_session *
+bench_connect_ssh(struct ly_ctx *ctx)
+{
+    return nc_connect_ssh("127.0.0.1", BENCH_SSH_PORT, ctx);
+}
+
+static void
+bench_ssh_setup(void)
+{
+    nc_server_ssh_set_hostkey_clb(bench_hostkey_clb, NULL, NULL);
+    bench_assert(!nc_server_add_endpt("bench_ssh", NC_TI_LIBSSH));
+    bench_assert(!nc_server_endpt_set_address("bench_ssh", "127.0.0.1"));
+    bench_assert(!nc_server_endpt_set_port("bench_ssh", BENCH_SSH_PORT));
+    bench_assert(!nc_server_ssh_endpt_add_hostkey("bench_ssh", "key_rsa", -1));
+    bench_assert(!nc_server_ssh_endpt_set_auth_methods("bench_ssh", NC_SSH_AUTH_PUBLICKEY));
+    bench_assert(!nc_server_ssh_add_authkey_path(BENCH_DATA_DIR "/key_ecdsa.pub", "bench"));
+
+    nc_client_ssh_set_auth_hostkey_check_clb(bench_ssh_hostkey_check_clb, NULL);
+    bench_assert(!nc_client_ssh_set_username("bench"));
+    bench_assert(!nc_client_ssh_add_keypair(BENCH_DATA_DIR "/key_ecdsa.pub", BENCH_DATA_DIR "/key_ecdsa"));
+    nc_client_ssh_set_auth_pref(NC_SSH_AUTH_PUBLICKEY, 1);
+    nc_client_ssh_set_auth_pref(NC_SSH_AUTH_PASSWORD, -1);
+    nc_client_ssh_set_auth_pref(NC_SSH_AUTH_INTERACTIVE, -1);
+}
+
+#endif /* NC_ENABLED_SSH */
+
+#ifdef NC_ENABLED_TLS
+
+static int
+bench_server_cert_clb(const char *name, void *user_data, char **cert_path, char **cert_data, char **privkey_path,
+        char **privkey_data, NC_SSH_KEY_TYPE *privkey_type)
+{
+    (void)user_data;
+    (void)cert_data;
+    (void)privkey_data;
+    (void)privkey_type;
+
+    if (!strcmp(name, "bench_cert")) {
+        *cert_path = strdup(BENCH_DATA_DIR "/server.crt");
+        *privkey_path = strdup(BENCH_DATA_DIR "/server.key");
+        return 0;
+    }
+
+    return 1;
+}
+
+static int
+bench_trusted_cert_list_clb(const char *name, void *user_data, char ***cert_paths, int *cert_path_count,
+        char ***cert_data, int *cert_data_count)
+{
+    (void)user_data;
+    (void)cert_data;
+    (void)cert_data_count;
+
+    if (!strcmp(name, "bench_cert_list")) {
+        *cert_paths = malloc(sizeof **cert_paths);
+        (*cert_paths)[0] = strdup(BENCH_DATA_DIR "/client.crt");
+        *cert_path_count = 1;
+        return 0;
+    }
+
+    return 1;
+}
+
+static struct nc_session *
+bench_connect_tls(struct ly_ctx *ctx)
+{
+    return nc_connect_tls("127.0.0.1", BENCH_TLS_PORT, ctx);
+}
+
+static void
+bench_tls_setup(void)
+{
+    nc_server_tls_set_server_cert_clb(bench_server_cert_clb, NULL, NULL);
+    nc_server_tls_set_trusted_cert_list_clb(bench_trusted_cert_list_clb, NULL, NULL);
+    bench_assert(!nc_server_add_endpt("bench_tls", NC_TI_OPENSSL));
+    bench_assert(!nc_server_endpt_set_address("bench_tls", "127.0.0.1"));
+    bench_assert(!nc_server_endpt_set_port("bench_tls", BENCH_TLS_PORT));
+    bench_assert(!nc_server_tls_endpt_set_server_cert("bench_tls", "bench_cert"));
+    bench_assert(!nc_server_tls_endpt_add_trusted_cert_list("bench_tls", "bench_cert_list"));
+    bench_assert(!nc_server_tls_endpt_add_ctn("bench_tls", 0, "02:B3:9F:26:65:76:6B:CC:FC:86:8E:D4:1A:81:64:0F:92:EB:18:AE:FF",
+            NC_TLS_CTN_SPECIFIED, "bench"));
+
+    bench_assert(!nc_client_tls_set_cert_key_paths(BENCH_DATA_DIR "/client.crt", BENCH_DATA_DIR "/client.key"));
+    bench_assert(!nc_client_tls_set_trusted_ca_paths(NULL, BENCH_DATA_DIR));
+}
+
+#endif /* NC_ENABLED_TLS */
+
+int
+main(void)
+{
+    struct ly_ctx *ctx;
+
+    nc_server_init();
+    nc_client_init();
+    ctx = bench_ctx_new();
+
+#ifdef NC_ENABLED_SSH
+    bench_ssh_setup();
+    bench_handshake(ctx, "ssh", bench_connect_ssh);
+    bench_assert(!nc_server_del_endpt("bench_ssh", 0));
+#endif
+#ifdef NC_ENABLED_TLS
+    bench_tls_setup();
+    bench_handshake(ctx, "tls", bench_connect_tls);
+    bench_assert(!nc_server_del_endpt("bench_tls", 0));
+#endif
+
+    ly_ctx_destroy(ctx);
+    nc_client_destroy();
+    nc_server_destroy();
+    return 0;
+}
@@ -0,0 +1,121 @@
+/**
+ * \file bench_io.c
+ * \brief libnetconf2 benchmarks - NETCONF 1.0 and 1.1 message framing throughput
+ *
+ * Copyright (c) 2026 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libyang/libyang.h>
+
+#include "bench/bench.h"
+
+/* total amount of data written for every message size */
+#define BENCH_IO_BYTES (64 * 1024 * 1024)
+/* maximum number of messages written for every message size */
+#define BENCH_IO_MAX_MSGS (256 * 1024)
+
+struct bench_io_arg {
+    struct nc_session *session;
+    const char *msg;
+    size_t len;
+    uint64_t count;
+};
+
+static void *
+bench_io_writer(void *arg)
+{
+    struct bench_io_arg *a = arg;
+    uint64_t i;
+
+    for (i = 0; i < a->count; ++i) {
+        bench_assert(nc_write_msg_buf_io(a->session, -1, NC_MSG_RPC, a->msg, a->len) == NC_MSG_RPC);
+    }
+
+    return NULL;
+}
+
+static void
+bench_io_framing(struct ly_ctx *ctx, int mem, NC_VERSION version, size_t size)
+{
+    struct nc_session *server, *client;
+    struct bench_io_arg arg;
+    struct ly_in *msg;
+    pthread_t tid;
+    char *buf, params[64];
+    uint64_t i;
+    double start;
+
+    bench_session_pair_ti(ctx, mem, &server, &client);
+    server->version = version;
+    client->version = version;
+
+    /* message of the given size without any end tag inside */
+    buf = malloc(size);
+    bench_assert(buf);
+    memset(buf, 'x', size);
+    memcpy(buf, "<rpc>", 5);
+    memcpy(buf + size - 6, "</rpc>", 6);
+
+    arg.session = client;
+    arg.msg = buf;
+    arg.len = size;
+    arg.count = BENCH_IO_BYTES / size;
+    if (arg.count > BENCH_IO_MAX_MSGS) {
+        arg.count = BENCH_IO_MAX_MSGS;
+    }
+    arg.count = bench_ops(arg.count);
+
+    start = bench_now();
+    bench_assert(!pthread_create(&tid, NULL, bench_io_writer, &arg));
+    for (i = 0; i < arg.count; ++i) {
+        bench_assert(nc_read_msg_buf_io(server, -1, &msg) == 1);
+        nc_read_msg_free(server, msg);
+    }
+    pthread_join(tid, NULL);
+
+    sprintf(params, "\"transport\":\"%s\",\"version\":\"%s\",\"size\":%zu", mem ? "mem" : "fd",
+            (version == NC_VERSION_10) ? "1.0" : "1.1", size);
+    bench_report("framing", params, arg.count, arg.count * size, bench_now() - start);
+
+    free(buf);
+    bench_session_pair_free(server, client);
+}
+
+int
+main(void)
+{
+    struct ly_ctx *ctx;
+    const size_t sizes[] = {64, 1024, 16 * 1024, 256 * 1024, 4 * 1024 * 1024};
+    uint32_t i;
+    int mem;
+
+    nc_server_init();
+    nc_client_init();
+    ctx = bench_ctx_new();
+
+    for (mem = 0; mem < 2; ++mem) {
+        for (i = 0; i < sizeof sizes / sizeof *sizes; ++i) {
+            bench_io_framing(ctx, mem, NC_VERSION_10, sizes[i]);
+            bench_io_framing(ctx, mem, NC_VERSION_11, sizes[i]);
+        }
+    }
+
+    ly_ctx_destroy(ctx);
+    nc_client_destroy();
+    nc_server_destroy();
+    return 0;
+}
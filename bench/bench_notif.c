@@ -0,0 +1,124 @@
+/**
+ * \file bench_notif.c
+ * \brief libnetconf2 benchmarks - notification fan-out rate by subscribed session count
+ *
+ * Copyright (c) 2026 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libyang/libyang.h>
+
+#include "bench/bench.h"
+
+/* number of notifications delivered for every session count */
+#define BENCH_NOTIF_DELIVERIES 100000
+
+struct bench_notif_arg {
+    struct nc_session **clients;
+    uint32_t client_count;
+    uint64_t notif_count;
+};
+
+static void *
+bench_notif_reader(void *arg)
+{
+    struct bench_notif_arg *a = arg;
+    struct lyd_node *envp, *op;
+    uint64_t n;
+    uint32_t i;
+
+    /* read in the order the notifications are broadcasted so that no session transport fills up */
+    for (n = 0; n < a->notif_count; ++n) {
+        for (i = 0; i < a->client_count; ++i) {
+            bench_assert(nc_recv_notif(a->clients[i], -1, &envp, &op) == NC_MSG_NOTIF);
+            lyd_free_tree(envp);
+            lyd_free_tree(op);
+        }
+    }
+
+    return NULL;
+}
+
+static void
+bench_notif_fanout(struct ly_ctx *ctx, uint32_t session_count)
+{
+    struct nc_session **servers, **clients;
+    struct nc_server_notif *notif;
+    struct bench_notif_arg arg;
+    struct lyd_node *ntf;
+    struct timespec ts;
+    pthread_t tid;
+    char *eventtime, params[32];
+    uint64_t n;
+    uint32_t i;
+    double start;
+
+    servers = malloc(session_count * sizeof *servers);
+    clients = malloc(session_count * sizeof *clients);
+    bench_assert(servers && clients);
+    for (i = 0; i < session_count; ++i) {
+        bench_session_pair(ctx, &servers[i], &clients[i]);
+        nc_session_inc_notif_status(servers[i]);
+    }
+
+    bench_assert(!lyd_new_path(NULL, ctx, "/nc-notifications:notificationComplete", NULL, 0, &ntf));
+    clock_gettime(CLOCK_REALTIME, &ts);
+    bench_assert(!ly_time_ts2str(&ts, &eventtime));
+    notif = nc_server_notif_new(ntf, eventtime, NC_PARAMTYPE_FREE);
+    bench_assert(notif);
+
+    arg.clients = clients;
+    arg.client_count = session_count;
+    arg.notif_count = bench_ops(BENCH_NOTIF_DELIVERIES / session_count);
+
+    start = bench_now();
+    bench_assert(!pthread_create(&tid, NULL, bench_notif_reader, &arg));
+    for (n = 0; n < arg.notif_count; ++n) {
+        bench_assert(nc_server_notif_broadcast(servers, session_count, notif, -1) == (int)session_count);
+    }
+    pthread_join(tid, NULL);
+
+    sprintf(params, "\"sessions\":%" PRIu32, session_count);
+    bench_report("notif_fanout", params, arg.notif_count * session_count, 0, bench_now() - start);
+
+    nc_server_notif_free(notif);
+    for (i = 0; i < session_count; ++i) {
+        bench_session_pair_free(servers[i], clients[i]);
+    }
+    free(servers);
+    free(clients);
+}
+
+int
+main(void)
+{
+    struct ly_ctx *ctx;
+    const uint32_t session_counts[] = {1, 16, 128};
+    uint32_t i;
+
+    nc_server_init();
+    nc_client_init();
+    ctx = bench_ctx_new();
+
+    for (i = 0; i < sizeof session_counts / sizeof *session_counts; ++i) {
+        bench_notif_fanout(ctx, session_counts[i]);
+    }
+
+    ly_ctx_destroy(ctx);
+    nc_client_destroy();
+    nc_server_destroy();
+    return 0;
+}
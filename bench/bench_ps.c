@@ -0,0 +1,141 @@
+/**
+ * \file bench_ps.c
+ * \brief libnetconf2 benchmarks - RPC rate of nc_ps_poll() by session and thread count
+ *
+ * Copyright (c) 2026 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libyang/libyang.h>
+
+#include "bench/bench.h"
+
+/* number of RPCs processed for every configuration */
+#define BENCH_PS_RPCS 20000
+/* maximum number of polling threads */
+#define BENCH_PS_MAX_THREADS 4
+
+struct bench_ps_arg {
+    struct nc_pollsession *ps;
+    volatile int stop;
+};
+
+static void *
+bench_ps_thread(void *arg)
+{
+    struct bench_ps_arg *a = arg;
+    int ret;
+
+    while (!a->stop) {
+        ret = nc_ps_poll(a->ps, 100, NULL);
+        bench_assert(!(ret & (NC_PSPOLL_ERROR | NC_PSPOLL_SESSION_TERM)));
+    }
+
+    nc_thread_destroy();
+    return NULL;
+}
+
+static void
+bench_ps_rpc(struct ly_ctx *ctx, int mem, uint32_t session_count, uint32_t thread_count)
+{
+    struct nc_session **servers, **clients;
+    struct bench_ps_arg arg;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    pthread_t tids[BENCH_PS_MAX_THREADS];
+    uint64_t *msgids, rounds, r;
+    uint32_t i;
+    char params[64];
+    double start;
+
+    servers = malloc(session_count * sizeof *servers);
+    clients = malloc(session_count * sizeof *clients);
+    msgids = malloc(session_count * sizeof *msgids);
+    bench_assert(servers && clients && msgids);
+
+    arg.ps = nc_ps_new();
+    bench_assert(arg.ps);
+    arg.stop = 0;
+    for (i = 0; i < session_count; ++i) {
+        bench_session_pair_ti(ctx, mem, &servers[i], &clients[i]);
+        bench_assert(!nc_ps_add_session(arg.ps, servers[i]));
+    }
+
+    rpc = nc_rpc_get(NULL, 0, NC_PARAMTYPE_CONST);
+    bench_assert(rpc);
+
+    for (i = 0; i < thread_count; ++i) {
+        bench_assert(!pthread_create(&tids[i], NULL, bench_ps_thread, &arg));
+    }
+
+    /* every round sends an RPC on every session and waits for all the replies */
+    rounds = bench_ops(BENCH_PS_RPCS / session_count);
+    start = bench_now();
+    for (r = 0; r < rounds; ++r) {
+        for (i = 0; i < session_count; ++i) {
+            bench_assert(nc_send_rpc(clients[i], rpc, -1, &msgids[i]) == NC_MSG_RPC);
+        }
+        for (i = 0; i < session_count; ++i) {
+            bench_assert(nc_recv_reply(clients[i], rpc, msgids[i], -1, &envp, &op) == NC_MSG_REPLY);
+            lyd_free_tree(envp);
+            lyd_free_tree(op);
+        }
+    }
+
+    sprintf(params, "\"transport\":\"%s\",\"sessions\":%" PRIu32 ",\"threads\":%" PRIu32, mem ? "mem" : "fd",
+            session_count, thread_count);
+    bench_report("ps_poll_rpc", params, rounds * session_count, 0, bench_now() - start);
+
+    arg.stop = 1;
+    for (i = 0; i < thread_count; ++i) {
+        pthread_join(tids[i], NULL);
+    }
+
+    nc_rpc_free(rpc);
+    nc_ps_free(arg.ps);
+    for (i = 0; i < session_count; ++i) {
+        bench_session_pair_free(servers[i], clients[i]);
+    }
+    free(servers);
+    free(clients);
+    free(msgids);
+}
+
+int
+main(void)
+{
+    struct ly_ctx *ctx;
+    const uint32_t session_counts[] = {1, 16, 128};
+    const uint32_t thread_counts[] = {1, 2, BENCH_PS_MAX_THREADS};
+    uint32_t i, j;
+    int mem;
+
+    nc_server_init();
+    nc_client_init();
+    ctx = bench_ctx_new();
+
+    for (mem = 0; mem < 2; ++mem) {
+        for (i = 0; i < sizeof session_counts / sizeof *session_counts; ++i) {
+            for (j = 0; j < sizeof thread_counts / sizeof *thread_counts; ++j) {
+                bench_ps_rpc(ctx, mem, session_counts[i], thread_counts[j]);
+            }
+        }
+    }
+
+    ly_ctx_destroy(ctx);
+    nc_client_destroy();
+    nc_server_destroy();
+    return 0;
+}
@@ -16,14 +16,18 @@
 #define _GNU_SOURCE /* asprintf, signals */
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <poll.h>
 #include <pwd.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -36,6 +40,8 @@
 #include "compat.h"
 #include "libnetconf.h"
 
+extern struct nc_server_opts server_opts;
+
 const char *nc_msgtype2str[] = {
     "error",
     "would block",
@@ -49,6 +55,7 @@ const char *nc_msgtype2str[] = {
 };
 
 #define BUFFERSIZE 512
+#define READ_BUFSIZE (32 * BUFFERSIZE)
 
 #ifdef NC_ENABLED_TLS
 
@@ -86,12 +93,442 @@ nc_ssl_error_get_reasons(void)
 
 #endif
 
+/**
+ * @brief Make the bell of an in-memory transport ring readable.
+ *
+ * @param[in] ring Ring to use.
+ */
+static void
+nc_mem_bell_ring(struct nc_mem_ring *ring)
+{
+    char c = 0;
+
+    if (write(ring->bell[1], &c, 1) == -1) {
+        /* the pipe is full, it is readable then */
+    }
+}
+
+/**
+ * @brief Consume everything written into the bell of an in-memory transport ring.
+ *
+ * @param[in] ring Ring to use.
+ */
+static void
+nc_mem_bell_reset(struct nc_mem_ring *ring)
+{
+    char buf[64];
+
+    while (read(ring->bell[0], buf, sizeof buf) == sizeof buf) {}
+}
+
+/**
+ * @brief Free an in-memory transport pipe.
+ *
+ * @param[in] mp Pipe to free.
+ */
+static void
+nc_mem_pipe_free(struct nc_mem_pipe *mp)
+{
+    int i, j;
+
+    for (i = 0; i < 2; ++i) {
+        free(mp->ring[i].buf);
+        for (j = 0; j < 2; ++j) {
+            if (mp->ring[i].bell[j] > -1) {
+                close(mp->ring[i].bell[j]);
+            }
+        }
+    }
+    free(mp);
+}
+
+struct nc_mem_pipe *
+nc_mem_pipe_new(size_t hello_len)
+{
+    struct nc_mem_pipe *mp;
+    int i, j;
+    uint32_t size;
+
+    mp = calloc(1, sizeof *mp);
+    if (!mp) {
+        ERRMEM;
+        return NULL;
+    }
+    for (i = 0; i < 2; ++i) {
+        mp->ring[i].bell[0] = -1;
+        mp->ring[i].bell[1] = -1;
+    }
+    ATOMIC_STORE_RELAXED(mp->refcount, 2);
+
+    for (i = 0; i < 2; ++i) {
+        size = NC_MEM_RING_SIZE;
+        if (i == 1) {
+            /* server-to-client ring must hold the whole server hello, it is read only after it is written */
+            if (hello_len > UINT32_MAX / 2) {
+                ERR(NULL, "Server <hello> message too long (%zu B).", hello_len);
+                goto error;
+            }
+            while (size < hello_len) {
+                size <<= 1;
+            }
+        }
+        mp->ring[i].size = size;
+        mp->ring[i].buf = malloc(size);
+        if (!mp->ring[i].buf) {
+            ERRMEM;
+            goto error;
+        }
+
+        if (pipe(mp->ring[i].bell)) {
+            ERR(NULL, "Failed to create a pipe (%s).", strerror(errno));
+            mp->ring[i].bell[0] = -1;
+            mp->ring[i].bell[1] = -1;
+            goto error;
+        }
+        for (j = 0; j < 2; ++j) {
+            if ((fcntl(mp->ring[i].bell[j], F_SETFL, O_NONBLOCK) == -1) ||
+                    (fcntl(mp->ring[i].bell[j], F_SETFD, FD_CLOEXEC) == -1)) {
+                ERR(NULL, "fcntl failed (%s).", strerror(errno));
+                goto error;
+            }
+        }
+    }
+
+    return mp;
+
+error:
+    nc_mem_pipe_free(mp);
+    return NULL;
+}
+
+void
+nc_mem_pipe_release(struct nc_mem_pipe *mp)
+{
+    if (!mp) {
+        return;
+    }
+
+    /* wake the peer waiting for data, it learns that the pipe is closed once it reads everything */
+    ATOMIC_STORE_RELAXED(mp->closed, 1);
+    ATOMIC_FENCE();
+    nc_mem_bell_ring(&mp->ring[0]);
+    nc_mem_bell_ring(&mp->ring[1]);
+
+    if (ATOMIC_DEC_RELAXED(mp->refcount) == 1) {
+        /* the peer is done with the pipe, too */
+        ATOMIC_FENCE();
+        nc_mem_pipe_free(mp);
+    }
+}
+
+int
+nc_mem_readable(struct nc_session *session)
+{
+    struct nc_mem_ring *ring = NC_MEM_RX(session);
+    uint32_t tail;
+
+    tail = ATOMIC_LOAD_RELAXED(ring->tail);
+    if ((uint32_t)ATOMIC_LOAD_ACQUIRE(ring->head) != tail) {
+        return 1;
+    }
+
+    /* empty, reset the bell and check again because the writer rings it only if it sees the ring empty */
+    nc_mem_bell_reset(ring);
+    ATOMIC_FENCE();
+    if ((uint32_t)ATOMIC_LOAD_ACQUIRE(ring->head) != tail) {
+        /* some data were written meanwhile, keep the bell readable for them */
+        nc_mem_bell_ring(ring);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Read data from the ring of an in-memory transport session.
+ *
+ * @param[in] session Session to read from.
+ * @param[out] buf Buffer to read into.
+ * @param[in] count Maximum number of bytes to read.
+ * @return Number of bytes read, 0 if there are none, -1 if the pipe was closed and there will be none.
+ */
+static ssize_t
+nc_mem_read(struct nc_session *session, char *buf, size_t count)
+{
+    struct nc_mem_ring *ring = NC_MEM_RX(session);
+    uint32_t head, tail;
+    size_t off, part;
+
+    if (!nc_mem_readable(session)) {
+        return ATOMIC_LOAD_RELAXED(session->ti.mem.pipe->closed) ? -1 : 0;
+    }
+
+    tail = ATOMIC_LOAD_RELAXED(ring->tail);
+    head = ATOMIC_LOAD_ACQUIRE(ring->head);
+    if (count > (uint32_t)(head - tail)) {
+        count = (uint32_t)(head - tail);
+    }
+
+    /* read until the end of the ring buffer and then the rest from its beginning */
+    off = tail & (ring->size - 1);
+    part = (count < ring->size - off) ? count : ring->size - off;
+    memcpy(buf, ring->buf + off, part);
+    memcpy(buf + part, ring->buf, count - part);
+
+    /* give the space back to the writer */
+    ATOMIC_STORE_RELEASE(ring->tail, (uint32_t)(tail + count));
+    return count;
+}
+
+/**
+ * @brief Write data into the ring of an in-memory transport session.
+ *
+ * @param[in] session Session to write to.
+ * @param[in] buf Data to write.
+ * @param[in] count Length of @p buf.
+ * @return Number of bytes written, 0 if the ring is full.
+ */
 static ssize_t
-nc_read(struct nc_session *session, char *buf, size_t count, uint32_t inact_timeout, struct timespec *ts_act_timeout)
+nc_mem_write(struct nc_session *session, const char *buf, size_t count)
+{
+    struct nc_mem_ring *ring = NC_MEM_TX(session);
+    uint32_t head, tail;
+    size_t off, part;
+
+    head = ATOMIC_LOAD_RELAXED(ring->head);
+    tail = ATOMIC_LOAD_ACQUIRE(ring->tail);
+    if (count > ring->size - (uint32_t)(head - tail)) {
+        count = ring->size - (uint32_t)(head - tail);
+    }
+    if (!count) {
+        return 0;
+    }
+
+    /* write until the end of the ring buffer and then the rest to its beginning */
+    off = head & (ring->size - 1);
+    part = (count < ring->size - off) ? count : ring->size - off;
+    memcpy(ring->buf + off, buf, part);
+    memcpy(ring->buf, buf + part, count - part);
+
+    /* publish the data, the reader needs to be woken only if it may have seen the ring empty */
+    ATOMIC_STORE_RELEASE(ring->head, (uint32_t)(head + count));
+    ATOMIC_FENCE();
+    if ((uint32_t)ATOMIC_LOAD_RELAXED(ring->tail) == head) {
+        nc_mem_bell_ring(ring);
+    }
+    return count;
+}
+
+#ifdef NC_ENABLED_SSH
+
+/**
+ * @brief Check the SSH channel of a session, processing any SSH messages read from the socket.
+ *
+ * @param[in] session Session to use, SSH locked.
+ * @param[in] out Whether to check the channel window instead of data.
+ * @return Number of bytes available (or the window size for @p out), 0 if none.
+ * @return SSH_EOF if the channel is closed.
+ * @return SSH_ERROR on error.
+ */
+static int
+nc_ssh_channel_ready(struct nc_session *session, int out)
+{
+    int r;
+
+    r = ssh_channel_poll_timeout(session->ti.libssh.channel, 0, 0);
+    if (!out || (r < 0)) {
+        return r;
+    }
+
+    return ssh_channel_window_size(session->ti.libssh.channel) ? 1 : 0;
+}
+
+/**
+ * @brief Wait for data on the SSH channel of a session without blocking the other NETCONF sessions
+ * on the same SSH session.
+ *
+ * The SSH session is locked only to check the channel, libssh buffers the data of all the channels read
+ * from the socket, so the data of this channel may also be read by another session. That is why only one
+ * thread waits on the socket (and reads it), the others wait until the SSH session is unlocked.
+ *
+ * Waiting for the channel window to open for writing works the same way, the peer adjusts it by an SSH message.
+ *
+ * @param[in] session Session to use.
+ * @param[in] io_timeout Timeout in msec.
+ * @param[in] out Whether to wait for the channel window instead of data.
+ * @return Number of bytes available (or the window size for @p out), 0 on timeout.
+ * @return SSH_EOF if the channel is closed.
+ * @return SSH_ERROR on error.
+ */
+static int
+nc_ssh_channel_poll(struct nc_session *session, int io_timeout, int out)
+{
+    struct nc_ssh_lock *sl = session->ti.libssh.ssh_lock;
+    struct timespec ts_timeout, ts_real;
+    struct pollfd fds[2];
+    int r, pr;
+    int32_t left = -1;
+    char buf[16];
+
+    if (io_timeout > -1) {
+        nc_gettimespec_mono_add(&ts_timeout, io_timeout);
+    }
+
+    /* SSH LOCK */
+    if (nc_session_ssh_lock(session, -1, __func__) != 1) {
+        return SSH_ERROR;
+    }
+
+    while (!(r = nc_ssh_channel_ready(session, out))) {
+        if (io_timeout > -1) {
+            left = nc_difftimespec_mono_cur(&ts_timeout);
+            if (left < 1) {
+                break;
+            }
+        }
+
+        if (sl->polling) {
+            /* another thread is waiting on the socket, wait until it (or anyone else) reads it */
+            if (left > -1) {
+                nc_gettimespec_real_add(&ts_real, left);
+                pthread_cond_timedwait(&sl->cond, &sl->lock, &ts_real);
+            } else {
+                pthread_cond_wait(&sl->cond, &sl->lock);
+            }
+            continue;
+        }
+
+        /* wait on the socket until there are some data or the socket is read by another thread */
+        sl->polling = 1;
+        sl->poll_thread = pthread_self();
+        fds[0].fd = ssh_get_fd(session->ti.libssh.session);
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = sl->wake[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        /* SSH UNLOCK */
+        nc_session_ssh_unlock(session, __func__);
+
+        pr = poll(fds, 2, left);
+        if ((pr == -1) && (errno == EINTR)) {
+            pr = 0;
+        } else if (pr == -1) {
+            ERR(session, "poll failed (%s).", strerror(errno));
+        }
+
+        /* SSH LOCK */
+        if (nc_session_ssh_lock(session, -1, __func__) != 1) {
+            return SSH_ERROR;
+        }
+        sl->polling = 0;
+        if (sl->woken) {
+            while (read(sl->wake[0], buf, sizeof buf) > 0) {}
+            sl->woken = 0;
+        }
+        if (pr == -1) {
+            r = SSH_ERROR;
+            break;
+        }
+    }
+
+    /* SSH UNLOCK, lets another waiting thread wait on the socket */
+    nc_session_ssh_unlock(session, __func__);
+
+    return r;
+}
+
+#endif /* NC_ENABLED_SSH */
+
+/**
+ * @brief Wait until the transport of a session can be read from or written to.
+ *
+ * @param[in] session Session to wait on.
+ * @param[in] events Events to wait for, POLLIN or POLLOUT.
+ * @param[in] timeout Timeout in milliseconds.
+ * @return 1 if the transport may be ready, 0 on timeout, -1 on error.
+ */
+static int
+nc_transport_wait(struct nc_session *session, short events, int32_t timeout)
+{
+    struct pollfd fds = {0};
+    int r;
+
+#ifdef NC_ENABLED_SSH
+    if (session->ti_type == NC_TI_LIBSSH) {
+        /* other channels on the same SSH session may read the socket, the channel window is adjusted by the peer */
+        r = nc_ssh_channel_poll(session, timeout, (events & POLLOUT) ? 1 : 0);
+        if (r == SSH_ERROR) {
+            ERR(session, "SSH channel poll error (%s).", ssh_get_error(session->ti.libssh.session));
+            return -1;
+        }
+
+        /* EOF is detected by the following read or write */
+        return r ? 1 : 0;
+    }
+#endif
+
+    if (events & POLLOUT) {
+        switch (session->ti_type) {
+        case NC_TI_FD:
+            fds.fd = session->ti.fd.out;
+            break;
+#ifdef NC_ENABLED_TLS
+        case NC_TI_OPENSSL:
+            fds.fd = SSL_get_wfd(session->ti.tls);
+            break;
+#endif
+        case NC_TI_MEM:
+            /* nothing signals free space in the ring */
+            fds.fd = -1;
+            break;
+        default:
+            fds.fd = nc_session_ti_fd(session);
+            break;
+        }
+    } else {
+        fds.fd = nc_session_ti_fd(session);
+    }
+
+    if (fds.fd == -1) {
+        /* nothing to wait on */
+        usleep(NC_TIMEOUT_STEP);
+        return 1;
+    }
+
+    fds.events = events;
+    r = poll(&fds, 1, timeout);
+    if (r == -1) {
+        if (errno == EINTR) {
+            return 1;
+        }
+        ERR(session, "poll failed (%s).", strerror(errno));
+        return -1;
+    }
+
+    /* POLLHUP and POLLERR are detected by the following read or write */
+    return r ? 1 : 0;
+}
+
+/**
+ * @brief Read data from the transport, waits until at least some are available.
+ *
+ * @param[in] session Session to read from.
+ * @param[out] buf Buffer to read into.
+ * @param[in] count Maximum number of bytes to read.
+ * @param[in] inact_timeout Inactive timeout in milliseconds.
+ * @param[in] ts_act_timeout Absolute active timeout.
+ * @return Number of bytes read (at least 1), 0 if there is no transport, -1 on error.
+ */
+static ssize_t
+nc_read_transport(struct nc_session *session, char *buf, size_t count, uint32_t inact_timeout,
+        struct timespec *ts_act_timeout)
 {
-    size_t readd = 0;
     ssize_t r = -1;
     int fd, interrupted;
+    int32_t inact_left, act_left;
+    short events;
     struct timespec ts_inact_timeout;
 
     assert(session);
@@ -108,6 +545,7 @@ nc_read(struct nc_session *session, char *buf, size_t count, uint32_t inact_time
     nc_gettimespec_mono_add(&ts_inact_timeout, inact_timeout);
     do {
         interrupted = 0;
+        events = POLLIN;
         switch (session->ti_type) {
         case NC_TI_NONE:
             return 0;
@@ -116,7 +554,7 @@ nc_read(struct nc_session *session, char *buf, size_t count, uint32_t inact_time
         case NC_TI_UNIX:
             fd = (session->ti_type == NC_TI_FD) ? session->ti.fd.in : session->ti.unixsock.sock;
             /* read via standard file descriptor */
-            r = read(fd, buf + readd, count - readd);
+            r = read(fd, buf, count);
             if (r < 0) {
                 if (errno == EAGAIN) {
                     r = 0;
@@ -139,10 +577,30 @@ nc_read(struct nc_session *session, char *buf, size_t count, uint32_t inact_time
             }
             break;
 
+        case NC_TI_MEM:
+            r = nc_mem_read(session, buf, count);
+            if (r == -1) {
+                ERR(session, "In-memory transport unexpectedly closed.");
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_DROPPED;
+                return -1;
+            }
+            break;
+
 #ifdef NC_ENABLED_SSH
         case NC_TI_LIBSSH:
-            /* read via libssh */
-            r = ssh_channel_read(session->ti.libssh.channel, buf + readd, count - readd, 0);
+            /* read via libssh, the SSH session is locked only for the call */
+            /* SSH LOCK */
+            if (nc_session_ssh_lock(session, -1, __func__) != 1) {
+                return -1;
+            }
+            r = ssh_channel_read(session->ti.libssh.channel, buf, count, 0);
+            if ((r == 0) && ssh_channel_is_eof(session->ti.libssh.channel)) {
+                r = SSH_EOF;
+            }
+            /* SSH UNLOCK */
+            nc_session_ssh_unlock(session, __func__);
+
             if (r == SSH_AGAIN) {
                 r = 0;
                 break;
@@ -151,14 +609,11 @@ nc_read(struct nc_session *session, char *buf, size_t count, uint32_t inact_time
                 session->status = NC_STATUS_INVALID;
                 session->term_reason = NC_SESSION_TERM_OTHER;
                 return -1;
-            } else if (r == 0) {
-                if (ssh_channel_is_eof(session->ti.libssh.channel)) {
-                    ERR(session, "SSH channel unexpected EOF.");
-                    session->status = NC_STATUS_INVALID;
-                    session->term_reason = NC_SESSION_TERM_DROPPED;
-                    return -1;
-                }
-                break;
+            } else if (r == SSH_EOF) {
+                ERR(session, "SSH channel unexpected EOF.");
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_DROPPED;
+                return -1;
             }
             break;
 #endif
@@ -167,14 +622,18 @@ nc_read(struct nc_session *session, char *buf, size_t count, uint32_t inact_time
         case NC_TI_OPENSSL:
             /* read via OpenSSL */
             ERR_clear_error();
-            r = SSL_read(session->ti.tls, buf + readd, count - readd);
+            r = SSL_read(session->ti.tls, buf, count);
             if (r <= 0) {
                 int e;
                 char *reasons;
 
                 switch (e = SSL_get_error(session->ti.tls, r)) {
                 case SSL_ERROR_WANT_READ:
+                    r = 0;
+                    break;
                 case SSL_ERROR_WANT_WRITE:
+                    /* renegotiation, the socket must become writable */
+                    events = POLLOUT;
                     r = 0;
                     break;
                 case SSL_ERROR_ZERO_RETURN:
@@ -206,12 +665,20 @@ nc_read(struct nc_session *session, char *buf, size_t count, uint32_t inact_time
         }
 
         if (r == 0) {
-            /* nothing read */
-            if (!interrupted) {
-                usleep(NC_TIMEOUT_STEP);
+            /* nothing read, wait for the data until the nearer timeout */
+            inact_left = nc_difftimespec_mono_cur(&ts_inact_timeout);
+            act_left = nc_difftimespec_mono_cur(ts_act_timeout);
+            if (!interrupted && (inact_left > 0) && (act_left > 0)) {
+                if (nc_transport_wait(session, events, (inact_left < act_left) ? inact_left : act_left) == -1) {
+                    session->status = NC_STATUS_INVALID;
+                    session->term_reason = NC_SESSION_TERM_OTHER;
+                    return -1;
+                }
+                inact_left = nc_difftimespec_mono_cur(&ts_inact_timeout);
+                act_left = nc_difftimespec_mono_cur(ts_act_timeout);
             }
-            if ((nc_difftimespec_mono_cur(&ts_inact_timeout) < 1) || (nc_difftimespec_mono_cur(ts_act_timeout) < 1)) {
-                if (nc_difftimespec_mono_cur(&ts_inact_timeout) < 1) {
+            if ((inact_left < 1) || (act_left < 1)) {
+                if (inact_left < 1) {
                     ERR(session, "Inactive read timeout elapsed.");
                 } else {
                     ERR(session, "Active read timeout elapsed.");
@@ -220,133 +687,255 @@ nc_read(struct nc_session *session, char *buf, size_t count, uint32_t inact_time
                 session->term_reason = NC_SESSION_TERM_OTHER;
                 return -1;
             }
-        } else {
-            /* something read */
-            readd += r;
+        }
+    } while (r == 0);
+
+    if (r > 0) {
+        ATOMIC_ADD_RELAXED(session->stats.in_bytes, r);
+    }
+    return r;
+}
 
-            /* reset inactive timeout */
-            nc_gettimespec_mono_add(&ts_inact_timeout, inact_timeout);
+char *
+nc_session_rbuf_space(struct nc_session *session, size_t *size)
+{
+    if (!session->rbuf) {
+        session->rbuf = malloc(READ_BUFSIZE);
+        if (!session->rbuf) {
+            ERRMEM;
+            return NULL;
         }
+        session->rbuf_start = 0;
+        session->rbuf_len = 0;
+    }
 
-    } while (readd < count);
-    buf[count] = '\0';
+    /* move the unprocessed data to the beginning of the buffer */
+    if (session->rbuf_len && session->rbuf_start) {
+        memmove(session->rbuf, session->rbuf + session->rbuf_start, session->rbuf_len);
+    }
+    session->rbuf_start = 0;
 
-    return (ssize_t)readd;
+    if (session->rbuf_len == READ_BUFSIZE) {
+        ERRINT;
+        return NULL;
+    }
+
+    *size = READ_BUFSIZE - session->rbuf_len;
+    return session->rbuf + session->rbuf_len;
 }
 
+/**
+ * @brief Read another block of data from the transport into the session receive buffer.
+ *
+ * @param[in] session Session to read from.
+ * @param[in] inact_timeout Inactive timeout in milliseconds.
+ * @param[in] ts_act_timeout Absolute active timeout.
+ * @return Number of bytes read (at least 1), -1 on error.
+ */
 static ssize_t
-nc_read_chunk(struct nc_session *session, size_t len, uint32_t inact_timeout, struct timespec *ts_act_timeout, char **chunk)
+nc_read_rbuf_fill(struct nc_session *session, uint32_t inact_timeout, struct timespec *ts_act_timeout)
 {
     ssize_t r;
+    char *space;
+    size_t size;
 
-    assert(session);
-    assert(chunk);
-
-    if (!len) {
-        return 0;
+    space = nc_session_rbuf_space(session, &size);
+    if (!space) {
+        return -1;
     }
 
-    *chunk = malloc((len + 1) * sizeof **chunk);
-    if (!*chunk) {
-        ERRMEM;
+    r = nc_read_transport(session, space, size, inact_timeout, ts_act_timeout);
+    if (r < 1) {
         return -1;
     }
+    session->rbuf_len += r;
 
-    r = nc_read(session, *chunk, len, inact_timeout, ts_act_timeout);
-    if (r <= 0) {
-        free(*chunk);
-        return -1;
+    return r;
+}
+
+/**
+ * @brief Move data from the session receive buffer.
+ *
+ * @param[in] session Session to use.
+ * @param[out] buf Buffer to copy the data into, NULL to only discard them.
+ * @param[in] count Maximum number of bytes to move.
+ * @return Number of bytes moved.
+ */
+static size_t
+nc_read_rbuf_consume(struct nc_session *session, char *buf, size_t count)
+{
+    if (count > session->rbuf_len) {
+        count = session->rbuf_len;
     }
 
-    /* terminating null byte */
-    (*chunk)[r] = 0;
+    if (buf && count) {
+        memcpy(buf, session->rbuf + session->rbuf_start, count);
+    }
+    session->rbuf_start += count;
+    session->rbuf_len -= count;
 
-    return r;
+    return count;
 }
 
 static ssize_t
-nc_read_until(struct nc_session *session, const char *endtag, size_t limit, uint32_t inact_timeout,
-        struct timespec *ts_act_timeout, char **result)
+nc_read(struct nc_session *session, char *buf, size_t count, uint32_t inact_timeout, struct timespec *ts_act_timeout)
 {
-    char *chunk = NULL;
-    size_t size, count = 0, r, len, i, matched = 0;
+    size_t readd;
+    ssize_t r;
 
     assert(session);
-    assert(endtag);
+    assert(buf);
 
-    if (limit && (limit < BUFFERSIZE)) {
-        size = limit;
-    } else {
-        size = BUFFERSIZE;
-    }
-    chunk = malloc((size + 1) * sizeof *chunk);
-    if (!chunk) {
-        ERRMEM;
-        return -1;
+    if (!count) {
+        return 0;
     }
 
-    len = strlen(endtag);
-    while (1) {
-        if (limit && (count == limit)) {
-            free(chunk);
-            WRN(session, "Reading limit (%d) reached.", limit);
-            ERR(session, "Invalid input data (missing \"%s\" sequence).", endtag);
-            return -1;
-        }
+    /* use the buffered data first */
+    readd = nc_read_rbuf_consume(session, buf, count);
 
-        /* resize buffer if needed */
-        if ((count + (len - matched)) >= size) {
-            /* get more memory */
-            size = size + BUFFERSIZE;
-            chunk = nc_realloc(chunk, (size + 1) * sizeof *chunk);
-            if (!chunk) {
-                ERRMEM;
+    while (readd < count) {
+        if (count - readd >= READ_BUFSIZE) {
+            /* large enough to be read directly without the additional copy */
+            r = nc_read_transport(session, buf + readd, count - readd, inact_timeout, ts_act_timeout);
+            if (r < 1) {
                 return -1;
             }
+            readd += r;
+        } else {
+            if (nc_read_rbuf_fill(session, inact_timeout, ts_act_timeout) < 1) {
+                return -1;
+            }
+            readd += nc_read_rbuf_consume(session, buf + readd, count - readd);
         }
+    }
+    buf[count] = '\0';
 
-        /* get another character */
-        r = nc_read(session, &(chunk[count]), len - matched, inact_timeout, ts_act_timeout);
-        if (r != len - matched) {
-            free(chunk);
-            return -1;
-        }
+    return (ssize_t)readd;
+}
+
+/**
+ * @brief Read data up to and including an end tag.
+ *
+ * @param[in] session Session to read from.
+ * @param[in] endtag End tag to look for.
+ * @param[in] limit Maximum number of bytes read, 0 for no limit.
+ * @param[in] inact_timeout Inactivity timeout in msec.
+ * @param[in] ts_act_timeout Absolute activity timeout.
+ * @param[in,out] result Read data terminated by a null byte, NULL to discard them. If @p result_size is set,
+ * it is a buffer of the caller reallocated if needed but never freed, otherwise it is allocated.
+ * @param[in,out] result_size Optional size of the caller buffer @p result, updated if it is reallocated.
+ * @return Number of bytes read.
+ * @return -1 on error.
+ */
+static ssize_t
+nc_read_until(struct nc_session *session, const char *endtag, size_t limit, uint32_t inact_timeout,
+        struct timespec *ts_act_timeout, char **result, size_t *result_size)
+{
+    char *chunk = NULL, *data, *end;
+    size_t size = 0, count = 0, len, cpy;
 
-        count += len - matched;
+    assert(session);
+    assert(endtag);
 
-        for (i = len - matched; i > 0; i--) {
-            if (!strncmp(&endtag[matched], &(chunk[count - i]), i)) {
-                /*part of endtag found */
-                matched += i;
-                break;
+    if (result_size) {
+        chunk = *result;
+        size = *result_size;
+    }
+
+    len = strlen(endtag);
+    while (1) {
+        /* look for the endtag in the buffered data */
+        data = session->rbuf ? session->rbuf + session->rbuf_start : NULL;
+        end = NULL;
+        cpy = 0;
+        if (session->rbuf_len >= len) {
+            end = memmem(data, session->rbuf_len, endtag, len);
+            if (end) {
+                cpy = (end - data) + len;
             } else {
-                matched = 0;
+                /* keep the bytes that can still be the beginning of the endtag */
+                cpy = session->rbuf_len - (len - 1);
+            }
+        }
+
+        if (limit && (count + cpy > limit)) {
+            WRN(session, "Reading limit (%d) reached.", limit);
+            ERR(session, "Invalid input data (missing \"%s\" sequence).", endtag);
+            goto error;
+        }
+
+        if (cpy && result) {
+            /* resize buffer if needed */
+            if (count + cpy >= size) {
+                size = (size ? size * 2 : BUFFERSIZE);
+                if (size < count + cpy + 1) {
+                    size = count + cpy + 1;
+                }
+                chunk = nc_realloc(chunk, size * sizeof *chunk);
+                if (!chunk) {
+                    ERRMEM;
+                    size = 0;
+                    goto error;
+                }
             }
+            nc_read_rbuf_consume(session, chunk + count, cpy);
+        } else {
+            nc_read_rbuf_consume(session, NULL, cpy);
         }
+        count += cpy;
 
-        /* whole endtag found */
-        if (matched == len) {
+        if (end) {
+            /* whole endtag found */
             break;
         }
-    }
 
-    /* terminating null byte */
-    chunk[count] = 0;
+        /* get more data */
+        if (nc_read_rbuf_fill(session, inact_timeout, ts_act_timeout) < 1) {
+            goto error;
+        }
+    }
 
     if (result) {
+        /* terminating null byte */
+        chunk[count] = 0;
         *result = chunk;
+        if (result_size) {
+            *result_size = size;
+        }
+    }
+    return count;
+
+error:
+    if (result_size) {
+        /* the buffer stays with the caller */
+        *result = chunk;
+        *result_size = size;
     } else {
         free(chunk);
     }
-    return count;
+    return -1;
 }
 
-int
-nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **msg, int passing_io_lock)
+/**
+ * @brief Read a message from the wire.
+ *
+ * @param[in] session NETCONF session from which the message is being read.
+ * @param[in] io_timeout Timeout in milliseconds.
+ * @param[out] msg Input handled with the NETCONF message.
+ * @param[in] passing_io_lock True if @p session IO lock is already held, it is always unlocked.
+ * @param[in] use_mbuf Whether to read the message into the message buffer of the session.
+ * @return 1 on success.
+ * @return 0 on timeout.
+ * @return -1 on error.
+ * @return -2 on malformed message error.
+ */
+static int
+nc_read_msg(struct nc_session *session, int io_timeout, struct ly_in **msg, int passing_io_lock, int use_mbuf)
 {
     int ret = 1, r, io_locked = passing_io_lock;
-    char *data = NULL, *chunk;
+    char *data = NULL, *chunk, hdr[32];
     uint64_t chunk_len, len = 0;
+    size_t size = 0, hdr_size;
     /* use timeout in milliseconds instead seconds */
     uint32_t inact_timeout = NC_READ_INACT_TIMEOUT * 1000;
     struct timespec ts_act_timeout;
@@ -354,6 +943,12 @@ nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **msg, i
     assert(session && msg);
     *msg = NULL;
 
+    if (use_mbuf) {
+        /* fill the buffer kept from the previous message */
+        data = session->mbuf;
+        size = session->mbuf_size;
+    }
+
     if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
         ERR(session, "Invalid session to read from.");
         ret = -1;
@@ -374,23 +969,32 @@ nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **msg, i
     /* read the message */
     switch (session->version) {
     case NC_VERSION_10:
-        r = nc_read_until(session, NC_VERSION_10_ENDTAG, 0, inact_timeout, &ts_act_timeout, &data);
+        if (use_mbuf) {
+            r = nc_read_until(session, NC_VERSION_10_ENDTAG, 0, inact_timeout, &ts_act_timeout, &data, &size);
+        } else {
+            r = nc_read_until(session, NC_VERSION_10_ENDTAG, 0, inact_timeout, &ts_act_timeout, &data, NULL);
+        }
         if (r == -1) {
             ret = r;
             goto cleanup;
         }
 
         /* cut off the end tag */
-        data[r - NC_VERSION_10_ENDTAG_LEN] = '\0';
+        len = r - NC_VERSION_10_ENDTAG_LEN;
+        data[len] = '\0';
         break;
     case NC_VERSION_11:
         while (1) {
-            r = nc_read_until(session, "\n#", 0, inact_timeout, &ts_act_timeout, NULL);
+            r = nc_read_until(session, "\n#", 0, inact_timeout, &ts_act_timeout, NULL, NULL);
             if (r == -1) {
                 ret = r;
                 goto cleanup;
             }
-            r = nc_read_until(session, "\n", 0, inact_timeout, &ts_act_timeout, &chunk);
+
+            /* the chunk header fits the stack buffer, the limit prevents it from being reallocated */
+            chunk = hdr;
+            hdr_size = sizeof hdr;
+            r = nc_read_until(session, "\n", hdr_size - 1, inact_timeout, &ts_act_timeout, &chunk, &hdr_size);
             if (r == -1) {
                 ret = r;
                 goto cleanup;
@@ -398,8 +1002,7 @@ nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **msg, i
 
             if (!strcmp(chunk, "#\n")) {
                 /* end of chunked framing message */
-                free(chunk);
-                if (!data) {
+                if (!len) {
                     ERR(session, "Invalid frame chunk delimiters.");
                     ret = -2;
                     goto cleanup;
@@ -409,33 +1012,45 @@ nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **msg, i
 
             /* convert string to the size of the following chunk */
             chunk_len = strtoul(chunk, (char **)NULL, 10);
-            free(chunk);
             if (!chunk_len) {
                 ERR(session, "Invalid frame chunk size detected, fatal error.");
                 ret = -2;
                 goto cleanup;
             }
 
-            /* now we have size of next chunk, so read the chunk */
-            r = nc_read_chunk(session, chunk_len, inact_timeout, &ts_act_timeout, &chunk);
-            if (r == -1) {
-                ret = r;
+            /* enlarge the message buffer geometrically, remember to count terminating null byte */
+            if (len + chunk_len + 1 > size) {
+                size = size * 2;
+                if (size < len + chunk_len + 1) {
+                    size = len + chunk_len + 1;
+                }
+                data = nc_realloc(data, size);
+                if (!data) {
+                    ERRMEM;
+                    size = 0;
+                    ret = -1;
+                    goto cleanup;
+                }
+            }
+
+            /* now we have size of next chunk, so read the chunk directly into the message buffer */
+            r = nc_read(session, data + len, chunk_len, inact_timeout, &ts_act_timeout);
+            if (r < 1) {
+                ret = -1;
                 goto cleanup;
             }
+            len += chunk_len;
+        }
 
-            /* realloc message buffer, remember to count terminating null byte */
-            data = nc_realloc(data, len + chunk_len + 1);
+        if (!use_mbuf && (size > len + 1)) {
+            /* give back the unused part of the message buffer, it may be almost as large as the message */
+            data = nc_realloc(data, len + 1);
             if (!data) {
                 ERRMEM;
                 ret = -1;
                 goto cleanup;
             }
-            memcpy(data + len, chunk, chunk_len);
-            len += chunk_len;
-            data[len] = '\0';
-            free(chunk);
         }
-
         break;
     }
 
@@ -444,16 +1059,26 @@ nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **msg, i
     nc_session_io_unlock(session, __func__);
     io_locked = 0;
 
-    DBG(session, "Received message:\n%s\n", data);
+    DBG_MSG(session, "Received message", data, len);
 
-    /* build an input structure, eats data */
+    /* build an input structure, eats data unless it is the message buffer */
     if (ly_in_new_memory(data, msg)) {
         ret = -1;
         goto cleanup;
     }
-    data = NULL;
+    if (use_mbuf) {
+        session->mbuf_in = *msg;
+    } else {
+        data = NULL;
+    }
 
 cleanup:
+    if (use_mbuf) {
+        /* keep the buffer even on error, it is released with the message or the session */
+        session->mbuf = data;
+        session->mbuf_size = size;
+        data = NULL;
+    }
     if (io_locked) {
         /* SESSION IO UNLOCK */
         nc_session_io_unlock(session, __func__);
@@ -462,6 +1087,67 @@ cleanup:
     return ret;
 }
 
+int
+nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **msg, int passing_io_lock)
+{
+    return nc_read_msg(session, io_timeout, msg, passing_io_lock, 0);
+}
+
+int
+nc_read_msg_buf_io(struct nc_session *session, int io_timeout, struct ly_in **msg)
+{
+    /* the buffer is used by a message not yet freed, it is not expected to happen */
+    return nc_read_msg(session, io_timeout, msg, 0, session->mbuf_in ? 0 : 1);
+}
+
+void
+nc_read_msg_free(struct nc_session *session, struct ly_in *msg)
+{
+    if (!msg) {
+        return;
+    }
+
+    if (msg != session->mbuf_in) {
+        ly_in_free(msg, 1);
+        return;
+    }
+
+    /* keep the buffer for the next message unless a huge message was received */
+    ly_in_free(msg, 0);
+    session->mbuf_in = NULL;
+    if (session->mbuf_size > NC_SESSION_MBUF_KEEP_SIZE) {
+        free(session->mbuf);
+        session->mbuf = NULL;
+        session->mbuf_size = 0;
+    }
+}
+
+void
+nc_session_buf_trim(struct nc_session *session)
+{
+    if (!session->rbuf_len) {
+        free(session->rbuf);
+        session->rbuf = NULL;
+        session->rbuf_start = 0;
+    }
+
+    free(session->wbuf);
+    session->wbuf = NULL;
+
+    if (!session->obuf_len) {
+        free(session->obuf);
+        session->obuf = NULL;
+        session->obuf_start = 0;
+        session->obuf_size = 0;
+    }
+
+    if (!session->mbuf_in) {
+        free(session->mbuf);
+        session->mbuf = NULL;
+        session->mbuf_size = 0;
+    }
+}
+
 /* return -1 means either poll error or that session was invalidated (socket error), EINTR is handled inside */
 static int
 nc_read_poll(struct nc_session *session, int io_timeout)
@@ -475,11 +1161,15 @@ nc_read_poll(struct nc_session *session, int io_timeout)
         return -1;
     }
 
+    if (session->rbuf_len) {
+        /* some data already received */
+        return 1;
+    }
+
     switch (session->ti_type) {
 #ifdef NC_ENABLED_SSH
     case NC_TI_LIBSSH:
-        /* EINTR is handled, it resumes waiting */
-        ret = ssh_channel_poll_timeout(session->ti.libssh.channel, io_timeout, 0);
+        ret = nc_ssh_channel_poll(session, io_timeout, 0);
         if (ret == SSH_ERROR) {
             ERR(session, "SSH channel poll error (%s).", ssh_get_error(session->ti.libssh.session));
             session->status = NC_STATUS_INVALID;
@@ -514,10 +1204,19 @@ nc_read_poll(struct nc_session *session, int io_timeout)
     /* fallthrough */
     case NC_TI_FD:
     case NC_TI_UNIX:
+    case NC_TI_MEM:
         if (session->ti_type == NC_TI_FD) {
             fds.fd = session->ti.fd.in;
         } else if (session->ti_type == NC_TI_UNIX) {
             fds.fd = session->ti.unixsock.sock;
+        } else if (session->ti_type == NC_TI_MEM) {
+            if (nc_mem_readable(session) || ATOMIC_LOAD_RELAXED(session->ti.mem.pipe->closed)) {
+                /* data in the ring, or the pipe is closed which the following read reports */
+                ret = 1;
+                fds.revents = POLLIN;
+                break;
+            }
+            fds.fd = nc_session_ti_fd(session);
         }
 
         fds.events = POLLIN;
@@ -609,6 +1308,8 @@ nc_session_is_connected(struct nc_session *session)
     case NC_TI_UNIX:
         fds.fd = session->ti.unixsock.sock;
         break;
+    case NC_TI_MEM:
+        return !ATOMIC_LOAD_RELAXED(session->ti.mem.pipe->closed);
 #ifdef NC_ENABLED_SSH
     case NC_TI_LIBSSH:
         return ssh_is_connected(session->ti.libssh.session);
@@ -639,25 +1340,515 @@ nc_session_is_connected(struct nc_session *session)
         return 0;
     }
 
-    return 1;
+    return 1;
+}
+
+/**
+ * @brief Wait until a stalled write can continue.
+ *
+ * @param[in] session Session being written to.
+ * @param[in] events Events to wait for, POLLOUT or POLLIN (TLS renegotiation).
+ * @param[in] ts_timeout Absolute timeout of the stalled write.
+ * @return 0 on success, -1 on error or timeout.
+ */
+static int
+nc_write_wait(struct nc_session *session, short events, const struct timespec *ts_timeout)
+{
+    int32_t left;
+
+    left = nc_difftimespec_mono_cur(ts_timeout);
+    if ((left < 1) || !nc_transport_wait(session, events, left)) {
+        ERR(session, "Write timeout elapsed.");
+    } else if (nc_session_is_connected(session)) {
+        return 0;
+    }
+
+    session->status = NC_STATUS_INVALID;
+    session->term_reason = NC_SESSION_TERM_OTHER;
+    return -1;
+}
+
+/**
+ * @brief Check whether data written into a session are appended to its output queue.
+ *
+ * @param[in] session Session to check.
+ * @return 1 if the output queue is used, 0 if the data are written directly.
+ */
+static int
+nc_out_queue_used(const struct nc_session *session)
+{
+    if ((session->side == NC_SERVER) && session->opts.server.out_batch) {
+        /* collecting the replies of an RPC batch */
+        return 1;
+    }
+
+    if ((session->side != NC_SERVER) || (session->ti_type == NC_TI_MEM) || (session->ti_type == NC_TI_NONE)) {
+        /* nothing to wait on for the in-memory transport to accept more data */
+        return 0;
+    }
+
+    /* keep using the queue until it is empty even if it was disabled meanwhile */
+    return server_opts.out_queue_size || session->obuf_len;
+}
+
+/**
+ * @brief Append data to the output queue of a session.
+ *
+ * If the data would not fit into the configured queue size, the writer is blocked until all
+ * the queued data are written so that the queue never grows past the size (unless @p buf
+ * alone is larger).
+ *
+ * @param[in] session Session to use.
+ * @param[in] buf Data to append.
+ * @param[in] count Length of @p buf.
+ * @return Number of appended bytes, -1 on error.
+ */
+static int
+nc_out_queue_add(struct nc_session *session, const void *buf, size_t count)
+{
+    size_t size;
+
+    if (session->obuf_len && server_opts.out_queue_size && (session->obuf_len + count > server_opts.out_queue_size) &&
+            !((session->side == NC_SERVER) && session->opts.server.out_batch)) {
+        /* queue full, the peer is not reading fast enough, wait for it */
+        if (nc_session_out_queue_flush(session, 1)) {
+            return -1;
+        }
+    }
+
+    if (session->obuf_start && (session->obuf_start + session->obuf_len + count > session->obuf_size)) {
+        /* move the queued data to the buffer beginning */
+        memmove(session->obuf, session->obuf + session->obuf_start, session->obuf_len);
+        session->obuf_start = 0;
+    }
+
+    if (session->obuf_len + count > session->obuf_size) {
+        for (size = session->obuf_size ? session->obuf_size : NC_WRITE_BUF_SIZE; size < session->obuf_len + count;
+                size *= 2) {}
+        session->obuf = nc_realloc(session->obuf, size);
+        if (!session->obuf) {
+            ERRMEM;
+            session->obuf_size = 0;
+            session->obuf_len = 0;
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_OTHER;
+            return -1;
+        }
+        session->obuf_size = size;
+    }
+
+    memcpy(session->obuf + session->obuf_start + session->obuf_len, buf, count);
+    session->obuf_len += count;
+    return count;
+}
+
+/* maximum length of a chunk header "\n#<chunk-size>\n" */
+#define WRITE_CHUNKHDR_MAXLEN 24
+/* maximum length of a message end tag */
+#define WRITE_ENDTAG_MAXLEN 6
+/* size of the whole session write buffer */
+#define WRITE_BUFSIZE (WRITE_CHUNKHDR_MAXLEN + NC_WRITE_BUF_SIZE + WRITE_ENDTAG_MAXLEN)
+
+struct wclb_arg {
+    struct nc_session *session;
+    char *buf;          /**< session write buffer, space for a chunk header is reserved before it */
+    size_t len;
+    uint64_t *write_usec; /**< time spent writing into the transport is added here, if set */
+};
+
+/**
+ * @brief Write as much data into the transport of a session as it accepts right away.
+ *
+ * @param[in] session Session to use.
+ * @param[in] buf Data to write.
+ * @param[in] count Length of @p buf.
+ * @param[out] events Events to wait for if nothing was written, 0 if the write can be retried right away.
+ * @return Number of written bytes, -1 on error.
+ */
+static ssize_t
+nc_write_ti_step(struct nc_session *session, const void *buf, size_t count, short *events)
+{
+    ssize_t c;
+
+#ifdef NC_ENABLED_TLS
+    unsigned long e;
+#endif
+
+    *events = POLLOUT;
+    switch (session->ti_type) {
+    case NC_TI_FD:
+    case NC_TI_UNIX:
+        if (session->ti_type == NC_TI_FD) {
+            c = write(session->ti.fd.out, buf, count);
+        } else {
+            c = send(session->ti.unixsock.sock, buf, count, MSG_DONTWAIT | MSG_NOSIGNAL);
+        }
+        if ((c < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            c = 0;
+        } else if ((c < 0) && (errno == EINTR)) {
+            *events = 0;
+            c = 0;
+        } else if (c < 0) {
+            ERR(session, "socket error (%s).", strerror(errno));
+            return -1;
+        }
+        break;
+
+    case NC_TI_MEM:
+        c = nc_mem_write(session, buf, count);
+        break;
+
+#ifdef NC_ENABLED_SSH
+    case NC_TI_LIBSSH:
+        /* SSH LOCK */
+        if (nc_session_ssh_lock(session, -1, __func__) != 1) {
+            return -1;
+        }
+        if (ssh_channel_is_closed(session->ti.libssh.channel) || ssh_channel_is_eof(session->ti.libssh.channel)) {
+            if (ssh_channel_is_closed(session->ti.libssh.channel)) {
+                ERR(session, "SSH channel unexpectedly closed.");
+            } else {
+                ERR(session, "SSH channel unexpected EOF.");
+            }
+            nc_session_ssh_unlock(session, __func__);
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_DROPPED;
+            return -1;
+        }
+        /* non-blocking, writes only what fits into the channel window */
+        c = ssh_channel_write(session->ti.libssh.channel, buf, count);
+        /* SSH UNLOCK */
+        nc_session_ssh_unlock(session, __func__);
+        if (c == SSH_AGAIN) {
+            c = 0;
+        } else if (c < 0) {
+            ERR(session, "SSH channel write failed.");
+            return -1;
+        }
+        break;
+#endif
+#ifdef NC_ENABLED_TLS
+    case NC_TI_OPENSSL:
+        /* partial writes are enabled, a retried write may continue from a moved buffer */
+        c = SSL_write(session->ti.tls, buf, count);
+        if (c < 1) {
+            char *reasons;
+
+            switch ((e = SSL_get_error(session->ti.tls, c))) {
+            case SSL_ERROR_ZERO_RETURN:
+                ERR(session, "SSL connection was properly closed.");
+                return -1;
+            case SSL_ERROR_WANT_WRITE:
+                c = 0;
+                break;
+            case SSL_ERROR_WANT_READ:
+                /* renegotiation, the peer data must be read first */
+                *events = POLLIN;
+                c = 0;
+                break;
+            case SSL_ERROR_SYSCALL:
+                ERR(session, "SSL socket error (%s).", strerror(errno));
+                return -1;
+            case SSL_ERROR_SSL:
+                reasons = nc_ssl_error_get_reasons();
+                ERR(session, "SSL error (%s).", reasons);
+                free(reasons);
+                return -1;
+            default:
+                ERR(session, "Unknown SSL error occurred (err code %lu).", e);
+                return -1;
+            }
+        }
+        break;
+#endif
+    default:
+        ERRINT;
+        return -1;
+    }
+
+    if (c > 0) {
+        ATOMIC_ADD_RELAXED(session->stats.out_bytes, c);
+    }
+    return c;
+}
+
+/**
+ * @brief Write data into the transport of a session, wait until all of them are written.
+ *
+ * @param[in] session Session to use.
+ * @param[in] buf Data to write.
+ * @param[in] count Length of @p buf.
+ * @return Number of written bytes, -1 on error.
+ */
+static int
+nc_write_ti(struct nc_session *session, const void *buf, size_t count)
+{
+    ssize_t c;
+    size_t written = 0;
+    short events;
+    struct timespec ts_timeout;
+
+    nc_gettimespec_mono_add(&ts_timeout, NC_WRITE_TIMEOUT * 1000);
+    do {
+        c = nc_write_ti_step(session, (char *)buf + written, count - written, &events);
+        if (c == -1) {
+            return -1;
+        } else if (c) {
+            /* progress, restart the timeout */
+            nc_gettimespec_mono_add(&ts_timeout, NC_WRITE_TIMEOUT * 1000);
+        } else if (events) {
+            /* we must wait */
+            if (nc_write_wait(session, events, &ts_timeout)) {
+                return -1;
+            }
+        }
+
+        written += c;
+    } while (written < count);
+
+    return written;
+}
+
+/**
+ * @brief Learn how many bytes can be written into a file descriptor transport without blocking.
+ *
+ * File descriptors of ::nc_accept_inout() sessions are owned by the application and may be blocking,
+ * such a descriptor is written only once it is writable and at most PIPE_BUF bytes at a time.
+ *
+ * @param[in] session Session with #NC_TI_FD transport.
+ * @param[in] count Number of bytes to write.
+ * @return Number of bytes to write, 0 if the descriptor is not writable.
+ */
+static size_t
+nc_write_fd_avail(struct nc_session *session, size_t count)
+{
+    struct pollfd fds = {0};
+    int flags;
+
+    flags = fcntl(session->ti.fd.out, F_GETFL);
+    if ((flags == -1) || (flags & O_NONBLOCK)) {
+        /* the write fails on its own */
+        return count;
+    }
+
+    fds.fd = session->ti.fd.out;
+    fds.events = POLLOUT;
+    if (poll(&fds, 1, 0) < 1) {
+        return 0;
+    }
+
+    /* POLLERR and POLLHUP are detected by the write */
+    return (count > PIPE_BUF) ? PIPE_BUF : count;
+}
+
+int
+nc_session_out_queue_flush(struct nc_session *session, int block)
+{
+    ssize_t c;
+    size_t count;
+    short events;
+    struct timespec ts_timeout;
+
+    if ((session->side == NC_SERVER) && session->opts.server.out_batch) {
+        /* written once the whole RPC batch is processed */
+        return 0;
+    }
+
+    nc_gettimespec_mono_add(&ts_timeout, NC_WRITE_TIMEOUT * 1000);
+    while (session->obuf_len) {
+        count = session->obuf_len;
+        if (!block && (session->ti_type == NC_TI_FD) && !(count = nc_write_fd_avail(session, count))) {
+            /* the rest is written when the transport is writable again */
+            return 0;
+        }
+
+        c = nc_write_ti_step(session, session->obuf + session->obuf_start, count, &events);
+        if (c == -1) {
+            if (session->status != NC_STATUS_INVALID) {
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_DROPPED;
+            }
+            return -1;
+        } else if (!c) {
+            if (!events) {
+                /* interrupted */
+                continue;
+            } else if (!block) {
+                /* the rest is written when the transport is writable again */
+                return 0;
+            } else if (nc_write_wait(session, events, &ts_timeout)) {
+                return -1;
+            }
+            continue;
+        }
+
+        session->obuf_start += c;
+        session->obuf_len -= c;
+        nc_gettimespec_mono_add(&ts_timeout, NC_WRITE_TIMEOUT * 1000);
+    }
+
+    /* everything written */
+    session->obuf_start = 0;
+    return 0;
+}
+
+static int
+nc_write(struct nc_session *session, const void *buf, size_t count)
+{
+    if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
+        return -1;
+    }
+
+    /* prevent SIGPIPE this way */
+    if (!nc_session_is_connected(session)) {
+        ERR(session, "Communication socket unexpectedly closed.");
+        session->status = NC_STATUS_INVALID;
+        session->term_reason = NC_SESSION_TERM_DROPPED;
+        return -1;
+    }
+
+    DBG_MSG(session, "Sending message", buf, count);
+
+    if (nc_out_queue_used(session)) {
+        return nc_out_queue_add(session, buf, count);
+    }
+
+    return nc_write_ti(session, buf, count);
+}
+
+int
+nc_session_out_batch(struct nc_session *session, int start)
+{
+    int ret = 0;
+
+    /* SESSION IO LOCK */
+    if (nc_session_io_lock(session, NC_SESSION_LOCK_TIMEOUT, __func__) != 1) {
+        if (!start) {
+            /* the collected messages cannot be written, do not keep collecting them */
+            session->opts.server.out_batch = 0;
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_OTHER;
+        }
+        return -1;
+    }
+
+    if (start) {
+        session->opts.server.out_batch = 1;
+    } else {
+        session->opts.server.out_batch = 0;
+        if (!session->obuf_len) {
+            /* nothing written meanwhile */
+        } else if (nc_out_queue_used(session)) {
+            /* keep the output queue working as usual */
+            ret = nc_session_out_queue_flush(session, !server_opts.out_queue_size);
+        } else {
+            /* all the collected messages at once */
+            if (nc_write_ti(session, session->obuf + session->obuf_start, session->obuf_len) == -1) {
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_OTHER;
+                ret = -1;
+            }
+            session->obuf_start = 0;
+            session->obuf_len = 0;
+        }
+    }
+
+    /* SESSION IO UNLOCK */
+    nc_session_io_unlock(session, __func__);
+    return ret;
+}
+
+/**
+ * @brief Print a message split into several parts as a single one.
+ *
+ * @param[in] session Session sending the message.
+ * @param[in] iov Parts of the message.
+ * @param[in] iovcnt Count of @p iov.
+ */
+static void
+nc_writev_dump(struct nc_session *session, const struct iovec *iov, int iovcnt)
+{
+    char *msg;
+    size_t len = 0;
+    int i;
+
+    if (iovcnt == 1) {
+        prv_print_dump(session, "Sending message", iov[0].iov_base, iov[0].iov_len);
+        return;
+    }
+
+    for (i = 0; i < iovcnt; ++i) {
+        len += iov[i].iov_len;
+    }
+    msg = malloc(len);
+    if (!msg) {
+        ERRMEM;
+        return;
+    }
+    for (len = 0, i = 0; i < iovcnt; ++i) {
+        memcpy(msg + len, iov[i].iov_base, iov[i].iov_len);
+        len += iov[i].iov_len;
+    }
+
+    prv_print_dump(session, "Sending message", msg, len);
+    free(msg);
+}
+
+/**
+ * @brief Write data in several parts into a transport without vectored writes, the parts are coalesced
+ * in the session write buffer so that they are written in as few TLS records or SSH packets as possible.
+ *
+ * @param[in] session Session to use.
+ * @param[in] iov Parts to write.
+ * @param[in] iovcnt Count of @p iov.
+ * @return Number of written bytes, -1 on error.
+ */
+static int
+nc_writev_buf(struct nc_session *session, const struct iovec *iov, int iovcnt)
+{
+    size_t len = 0, off = 0, n;
+    int c, i = 0, written = 0;
+
+    if (!session->wbuf) {
+        session->wbuf = malloc(WRITE_BUFSIZE);
+        if (!session->wbuf) {
+            ERRMEM;
+            return -1;
+        }
+    }
+
+    while (i < iovcnt) {
+        /* fill the buffer */
+        n = iov[i].iov_len - off;
+        if (n > WRITE_BUFSIZE - len) {
+            n = WRITE_BUFSIZE - len;
+        }
+        memcpy(session->wbuf + len, (char *)iov[i].iov_base + off, n);
+        len += n;
+        off += n;
+        if (off == iov[i].iov_len) {
+            ++i;
+            off = 0;
+        }
+
+        if (len && ((len == WRITE_BUFSIZE) || (i == iovcnt))) {
+            c = nc_write_ti(session, session->wbuf, len);
+            if (c == -1) {
+                return -1;
+            }
+            written += c;
+            len = 0;
+        }
+    }
+
+    return written;
 }
 
-#define WRITE_BUFSIZE (2 * BUFFERSIZE)
-struct wclb_arg {
-    struct nc_session *session;
-    char buf[WRITE_BUFSIZE];
-    size_t len;
-};
-
 static int
-nc_write(struct nc_session *session, const void *buf, size_t count)
+nc_writev(struct nc_session *session, struct iovec *iov, int iovcnt)
 {
-    int c, fd, interrupted;
-    size_t written = 0;
-
-#ifdef NC_ENABLED_TLS
-    unsigned long e;
-#endif
+    int c, fd, i, written = 0;
+    struct timespec ts_timeout;
 
     if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
         return -1;
@@ -671,86 +1862,57 @@ nc_write(struct nc_session *session, const void *buf, size_t count)
         return -1;
     }
 
-    DBG(session, "Sending message:\n%.*s\n", count, buf);
+    if (ATOMIC_LOAD_RELAXED(verbose_level) >= NC_VERB_DEBUG) {
+        nc_writev_dump(session, iov, iovcnt);
+    }
 
-    do {
-        interrupted = 0;
-        switch (session->ti_type) {
-        case NC_TI_FD:
-        case NC_TI_UNIX:
-            fd = session->ti_type == NC_TI_FD ? session->ti.fd.out : session->ti.unixsock.sock;
-            c = write(fd, (char *)(buf + written), count - written);
-            if ((c < 0) && (errno == EAGAIN)) {
-                c = 0;
-            } else if ((c < 0) && (errno == EINTR)) {
-                c = 0;
-                interrupted = 1;
-            } else if (c < 0) {
-                ERR(session, "socket error (%s).", strerror(errno));
+    if (nc_out_queue_used(session)) {
+        for (i = 0; i < iovcnt; ++i) {
+            c = nc_out_queue_add(session, iov[i].iov_base, iov[i].iov_len);
+            if (c == -1) {
                 return -1;
             }
-            break;
+            written += c;
+        }
+        return written;
+    }
 
-#ifdef NC_ENABLED_SSH
-        case NC_TI_LIBSSH:
-            if (ssh_channel_is_closed(session->ti.libssh.channel) || ssh_channel_is_eof(session->ti.libssh.channel)) {
-                if (ssh_channel_is_closed(session->ti.libssh.channel)) {
-                    ERR(session, "SSH channel unexpectedly closed.");
-                } else {
-                    ERR(session, "SSH channel unexpected EOF.");
-                }
-                session->status = NC_STATUS_INVALID;
-                session->term_reason = NC_SESSION_TERM_DROPPED;
-                return -1;
-            }
-            c = ssh_channel_write(session->ti.libssh.channel, (char *)(buf + written), count - written);
-            if ((c == SSH_ERROR) || (c == -1)) {
-                ERR(session, "SSH channel write failed.");
-                return -1;
-            }
-            break;
-#endif
-#ifdef NC_ENABLED_TLS
-        case NC_TI_OPENSSL:
-            c = SSL_write(session->ti.tls, (char *)(buf + written), count - written);
-            if (c < 1) {
-                char *reasons;
+    if ((session->ti_type != NC_TI_FD) && (session->ti_type != NC_TI_UNIX)) {
+        /* no vectored write available */
+        return nc_writev_buf(session, iov, iovcnt);
+    }
 
-                switch ((e = SSL_get_error(session->ti.tls, c))) {
-                case SSL_ERROR_ZERO_RETURN:
-                    ERR(session, "SSL connection was properly closed.");
-                    return -1;
-                case SSL_ERROR_WANT_WRITE:
-                case SSL_ERROR_WANT_READ:
-                    c = 0;
-                    break;
-                case SSL_ERROR_SYSCALL:
-                    ERR(session, "SSL socket error (%s).", strerror(errno));
-                    return -1;
-                case SSL_ERROR_SSL:
-                    reasons = nc_ssl_error_get_reasons();
-                    ERR(session, "SSL error (%s).", reasons);
-                    free(reasons);
-                    return -1;
-                default:
-                    ERR(session, "Unknown SSL error occurred (err code %d).", e);
-                    return -1;
-                }
+    fd = session->ti_type == NC_TI_FD ? session->ti.fd.out : session->ti.unixsock.sock;
+    nc_gettimespec_mono_add(&ts_timeout, NC_WRITE_TIMEOUT * 1000);
+    while (iovcnt) {
+        c = writev(fd, iov, iovcnt);
+        if ((c < 0) && (errno == EAGAIN)) {
+            /* we must wait */
+            if (nc_write_wait(session, POLLOUT, &ts_timeout)) {
+                return -1;
             }
-            break;
-#endif
-        default:
-            ERRINT;
+            continue;
+        } else if ((c < 0) && (errno == EINTR)) {
+            continue;
+        } else if (c < 0) {
+            ERR(session, "socket error (%s).", strerror(errno));
             return -1;
         }
-
-        if ((c == 0) && !interrupted) {
-            /* we must wait */
-            usleep(NC_TIMEOUT_STEP);
-        }
-
         written += c;
-    } while (written < count);
+        nc_gettimespec_mono_add(&ts_timeout, NC_WRITE_TIMEOUT * 1000);
+        ATOMIC_ADD_RELAXED(session->stats.out_bytes, c);
+
+        /* skip all the written data */
+        while (iovcnt && ((size_t)c >= iov->iov_len)) {
+            c -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt) {
+            iov->iov_base = (char *)iov->iov_base + c;
+            iov->iov_len -= c;
+        }
+    }
 
     return written;
 }
@@ -758,51 +1920,63 @@ nc_write(struct nc_session *session, const void *buf, size_t count)
 static int
 nc_write_starttag_and_msg(struct nc_session *session, const void *buf, size_t count)
 {
-    int ret = 0, c;
-    char chunksize[24];
+    char chunksize[WRITE_CHUNKHDR_MAXLEN];
+    struct iovec iov[2];
+    int iovcnt = 0;
 
-    // warning: ‘%zu’ directive writing between 4 and 20 bytes into a region of size 18 [-Wformat-overflow=]
     if (session->version == NC_VERSION_11) {
-        sprintf(chunksize, "\n#%zu\n", count);
-        ret = nc_write(session, chunksize, strlen(chunksize));
-        if (ret == -1) {
-            return -1;
-        }
-    }
-
-    c = nc_write(session, buf, count);
-    if (c == -1) {
-        return -1;
+        iov[iovcnt].iov_base = chunksize;
+        iov[iovcnt].iov_len = sprintf(chunksize, "\n#%zu\n", count);
+        ++iovcnt;
     }
-    ret += c;
+    iov[iovcnt].iov_base = (void *)buf;
+    iov[iovcnt].iov_len = count;
+    ++iovcnt;
 
-    return ret;
+    /* chunk header and data together */
+    return nc_writev(session, iov, iovcnt);
 }
 
 static int
-nc_write_endtag(struct nc_session *session)
+nc_write_clb_flush(struct wclb_arg *warg, int endtag)
 {
-    int ret;
+    char chunksize[WRITE_CHUNKHDR_MAXLEN], *start;
+    size_t len, hdr_len = 0;
+    uint64_t usec = 0;
+    int ret = 0;
 
-    if (session->version == NC_VERSION_11) {
-        ret = nc_write(session, "\n##\n", 4);
-    } else {
-        ret = nc_write(session, "]]>]]>", 6);
+    start = warg->buf;
+    len = warg->len;
+    if (len && (warg->session->version == NC_VERSION_11)) {
+        /* chunk header right before the data in the reserved space */
+        hdr_len = sprintf(chunksize, "\n#%zu\n", len);
+        start -= hdr_len;
+        memcpy(start, chunksize, hdr_len);
+        len += hdr_len;
     }
 
-    return ret;
-}
-
-static int
-nc_write_clb_flush(struct wclb_arg *warg)
-{
-    int ret = 0;
+    if (endtag) {
+        /* end tag right after the data, there is always space reserved for it */
+        if (warg->session->version == NC_VERSION_11) {
+            memcpy(start + len, "\n##\n", 4);
+            len += 4;
+        } else {
+            memcpy(start + len, "]]>]]>", 6);
+            len += 6;
+        }
+    }
 
-    /* flush current buffer */
-    if (warg->len) {
-        ret = nc_write_starttag_and_msg(warg->session, warg->buf, warg->len);
-        warg->len = 0;
+    /* write everything at once */
+    if (len) {
+        if (warg->write_usec) {
+            usec = nc_time_mono_usec();
+        }
+        ret = nc_write(warg->session, start, len);
+        if (warg->write_usec) {
+            *warg->write_usec += nc_time_mono_usec() - usec;
+        }
     }
+    warg->len = 0;
 
     return ret;
 }
@@ -815,32 +1989,20 @@ nc_write_clb(void *arg, const void *buf, size_t count, int xmlcontent)
     struct wclb_arg *warg = (struct wclb_arg *)arg;
 
     if (!buf) {
-        c = nc_write_clb_flush(warg);
-        if (c == -1) {
-            return -1;
-        }
-        ret += c;
-
-        /* endtag */
-        c = nc_write_endtag(warg->session);
-        if (c == -1) {
-            return -1;
-        }
-        ret += c;
-
-        return ret;
+        /* remaining data with the endtag */
+        return nc_write_clb_flush(warg, 1);
     }
 
-    if (warg->len && (warg->len + count > WRITE_BUFSIZE)) {
+    if (warg->len && (warg->len + count > NC_WRITE_BUF_SIZE)) {
         /* dump current buffer */
-        c = nc_write_clb_flush(warg);
+        c = nc_write_clb_flush(warg, 0);
         if (c == -1) {
             return -1;
         }
         ret += c;
     }
 
-    if (!xmlcontent && (count > WRITE_BUFSIZE)) {
+    if (!xmlcontent && (count > NC_WRITE_BUF_SIZE)) {
         /* write directly */
         c = nc_write_starttag_and_msg(warg->session, buf, count);
         if (c == -1) {
@@ -851,9 +2013,9 @@ nc_write_clb(void *arg, const void *buf, size_t count, int xmlcontent)
         /* keep in buffer and write later */
         if (xmlcontent) {
             for (l = 0; l < count; l++) {
-                if (warg->len + 5 >= WRITE_BUFSIZE) {
+                if (warg->len + 5 >= NC_WRITE_BUF_SIZE) {
                     /* buffer is full */
-                    c = nc_write_clb_flush(warg);
+                    c = nc_write_clb_flush(warg, 0);
                     if (c == -1) {
                         return -1;
                     }
@@ -884,7 +2046,7 @@ nc_write_clb(void *arg, const void *buf, size_t count, int xmlcontent)
             }
         } else {
             memcpy(&warg->buf[warg->len], buf, count);
-            warg->len += count; /* is <= WRITE_BUFSIZE */
+            warg->len += count; /* is <= NC_WRITE_BUF_SIZE */
             ret += count;
         }
     }
@@ -906,6 +2068,159 @@ nc_write_xmlclb(void *arg, const void *buf, size_t count)
     return count;
 }
 
+/**
+ * @brief Learn libyang printer flag for a with-defaults mode.
+ *
+ * @param[in] wd With-defaults mode.
+ * @return LYD_PRINT_WD_* flag.
+ */
+static uint32_t
+nc_write_wd_flag(NC_WD_MODE wd)
+{
+    switch (wd) {
+    case NC_WD_TRIM:
+        return LYD_PRINT_WD_TRIM;
+    case NC_WD_ALL:
+        return LYD_PRINT_WD_ALL;
+    case NC_WD_ALL_TAG:
+        return LYD_PRINT_WD_ALL_TAG;
+    case NC_WD_UNKNOWN:
+    case NC_WD_EXPLICIT:
+    default:
+        break;
+    }
+
+    return LYD_PRINT_WD_EXPLICIT;
+}
+
+/**
+ * @brief Write an XML attribute with its value escaped.
+ *
+ * @param[in] arg Write callback argument.
+ * @param[in] prefix Attribute prefix or name if @p name is NULL.
+ * @param[in] name Optional attribute name.
+ * @param[in] value Attribute value.
+ */
+static void
+nc_write_xml_attr(struct wclb_arg *arg, const char *prefix, const char *name, const char *value)
+{
+    size_t len;
+
+    nc_write_clb((void *)arg, " ", 1, 0);
+    nc_write_clb((void *)arg, prefix, strlen(prefix), 0);
+    if (name) {
+        nc_write_clb((void *)arg, ":", 1, 0);
+        nc_write_clb((void *)arg, name, strlen(name), 0);
+    }
+    nc_write_clb((void *)arg, "=\"", 2, 0);
+    while (*value) {
+        /* escaping XML content does not cover quotes */
+        len = strcspn(value, "\"");
+        nc_write_clb((void *)arg, value, len, 1);
+        value += len;
+        if (*value) {
+            nc_write_clb((void *)arg, "&quot;", 6, 0);
+            ++value;
+        }
+    }
+    nc_write_clb((void *)arg, "\"", 1, 0);
+}
+
+/**
+ * @brief Write a DATA rpc-reply with the data printed batch by batch as they are produced.
+ *
+ * @param[in] arg Write callback argument.
+ * @param[in] rpc_envp Envelopes of the RPC to reply to.
+ * @param[in] reply Streamed reply.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_write_reply_stream(struct wclb_arg *arg, struct lyd_node_opaq *rpc_envp, struct nc_server_reply_data_stream *reply)
+{
+    struct nc_session *session = arg->session;
+    struct lyd_node *data;
+    struct lyd_attr *attr, *prev;
+    char *str = NULL;
+    int ret = -1;
+    LY_ERR lyrc;
+
+    /* <rpc-reply> open, with all the attributes of the rpc */
+    nc_write_clb((void *)arg, "<", 1, 0);
+    if (rpc_envp->name.prefix) {
+        nc_write_clb((void *)arg, rpc_envp->name.prefix, strlen(rpc_envp->name.prefix), 0);
+        nc_write_clb((void *)arg, ":", 1, 0);
+    }
+    nc_write_clb((void *)arg, "rpc-reply", 9, 0);
+    nc_write_xml_attr(arg, "xmlns", rpc_envp->name.prefix, rpc_envp->name.module_ns);
+    for (attr = rpc_envp->attr; attr; attr = attr->next) {
+        if (attr->name.prefix) {
+            /* declare every prefix once */
+            for (prev = rpc_envp->attr; prev != attr; prev = prev->next) {
+                if (prev->name.prefix && !strcmp(prev->name.prefix, attr->name.prefix)) {
+                    break;
+                }
+            }
+            if ((prev == attr) && (!rpc_envp->name.prefix || strcmp(rpc_envp->name.prefix, attr->name.prefix))) {
+                nc_write_xml_attr(arg, "xmlns", attr->name.prefix, attr->name.module_ns);
+            }
+            nc_write_xml_attr(arg, attr->name.prefix, attr->name.name, attr->value);
+        } else {
+            nc_write_xml_attr(arg, attr->name.name, NULL, attr->value);
+        }
+    }
+    nc_write_clb((void *)arg, ">", 1, 0);
+
+    if (reply->anydata) {
+        /* <anydata> open */
+        if (asprintf(&str, "<%s xmlns=\"%s\">", reply->anydata->name, reply->anydata->module->ns) == -1) {
+            ERRMEM;
+            str = NULL;
+            goto cleanup;
+        }
+        nc_write_clb((void *)arg, str, strlen(str), 0);
+        free(str);
+        str = NULL;
+    }
+
+    /* print and free every batch before producing the next one */
+    do {
+        data = NULL;
+        if (reply->data_clb(session, reply->user_data, &data)) {
+            ERR(session, "Failed to produce reply data.");
+            goto cleanup;
+        }
+
+        if (data) {
+            lyrc = lyd_print_clb(nc_write_xmlclb, (void *)arg, data, LYD_XML,
+                    LYD_PRINT_SHRINK | LYD_PRINT_WITHSIBLINGS | nc_write_wd_flag(reply->wd));
+            lyd_free_siblings(data);
+            if (lyrc || ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING))) {
+                goto cleanup;
+            }
+        }
+    } while (data);
+
+    if (reply->anydata) {
+        /* <anydata> close */
+        nc_write_clb((void *)arg, "</", 2, 0);
+        nc_write_clb((void *)arg, reply->anydata->name, strlen(reply->anydata->name), 0);
+        nc_write_clb((void *)arg, ">", 1, 0);
+    }
+
+    /* <rpc-reply> close */
+    nc_write_clb((void *)arg, "</", 2, 0);
+    if (rpc_envp->name.prefix) {
+        nc_write_clb((void *)arg, rpc_envp->name.prefix, strlen(rpc_envp->name.prefix), 0);
+        nc_write_clb((void *)arg, ":", 1, 0);
+    }
+    nc_write_clb((void *)arg, "rpc-reply>", 10, 0);
+    ret = 0;
+
+cleanup:
+    free(str);
+    return ret;
+}
+
 /* return NC_MSG_ERROR can change session status, acquires IO lock as needed */
 NC_MSG_TYPE
 nc_write_msg_io(struct nc_session *session, int io_timeout, int type, ...)
@@ -921,6 +2236,7 @@ nc_write_msg_io(struct nc_session *session, int io_timeout, int type, ...)
     struct wclb_arg arg;
     const char **capabilities;
     uint32_t *sid = NULL, i, wd = 0;
+    uint64_t usec = 0;
     LY_ERR lyrc;
 
     assert(session);
@@ -932,6 +2248,11 @@ nc_write_msg_io(struct nc_session *session, int io_timeout, int type, ...)
 
     arg.session = session;
     arg.len = 0;
+    arg.write_usec = NULL;
+    if ((type == NC_MSG_REPLY) && (session->side == NC_SERVER) && session->opts.server.trace) {
+        /* measure the reply write for the RPC latency */
+        arg.write_usec = &session->opts.server.trace->stage_usec[NC_RPC_STAGE_WRITE];
+    }
 
     /* SESSION IO LOCK */
     ret = nc_session_io_lock(session, io_timeout, __func__);
@@ -941,6 +2262,31 @@ nc_write_msg_io(struct nc_session *session, int io_timeout, int type, ...)
         return NC_MSG_WOULDBLOCK;
     }
 
+    if (nc_out_queue_used(session)) {
+        /* write what the transport accepts now so that the queue is as short as possible */
+        if (nc_session_out_queue_flush(session, 0)) {
+            nc_session_io_unlock(session, __func__);
+            return NC_MSG_ERROR;
+        }
+        if ((type == NC_MSG_NOTIF) && server_opts.out_queue_size && (session->obuf_len >= server_opts.out_queue_size)) {
+            /* the peer is not reading fast enough */
+            VRB(session, "Output queue full (%zu bytes), notification not sent.", session->obuf_len);
+            nc_session_io_unlock(session, __func__);
+            return NC_MSG_WOULDBLOCK;
+        }
+    }
+
+    if (!session->wbuf) {
+        /* first message written into the session */
+        session->wbuf = malloc(WRITE_BUFSIZE);
+        if (!session->wbuf) {
+            ERRMEM;
+            nc_session_io_unlock(session, __func__);
+            return NC_MSG_ERROR;
+        }
+    }
+    arg.buf = session->wbuf + WRITE_CHUNKHDR_MAXLEN;
+
     va_start(ap, type);
 
     switch (type) {
@@ -1003,6 +2349,17 @@ nc_write_msg_io(struct nc_session *session, int io_timeout, int type, ...)
             break;
         }
 
+        if (reply->type == NC_RPL_DATA_STREAM) {
+            if (nc_write_reply_stream(&arg, rpc_envp, (struct nc_server_reply_data_stream *)reply)) {
+                /* part of the reply may have been written already, there is no way to recover */
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_OTHER;
+                ret = NC_MSG_ERROR;
+                goto cleanup;
+            }
+            break;
+        }
+
         /* build a rpc-reply opaque node that can be simply printed */
         if (lyd_new_opaq2(NULL, session->ctx, "rpc-reply", NULL, rpc_envp->name.prefix, rpc_envp->name.module_ns,
                 &reply_envp)) {
@@ -1022,21 +2379,7 @@ nc_write_msg_io(struct nc_session *session, int io_timeout, int type, ...)
             }
             break;
         case NC_RPL_DATA:
-            switch (((struct nc_server_reply_data *)reply)->wd) {
-            case NC_WD_UNKNOWN:
-            case NC_WD_EXPLICIT:
-                wd = LYD_PRINT_WD_EXPLICIT;
-                break;
-            case NC_WD_TRIM:
-                wd = LYD_PRINT_WD_TRIM;
-                break;
-            case NC_WD_ALL:
-                wd = LYD_PRINT_WD_ALL;
-                break;
-            case NC_WD_ALL_TAG:
-                wd = LYD_PRINT_WD_ALL_TAG;
-                break;
-            }
+            wd = nc_write_wd_flag(((struct nc_server_reply_data *)reply)->wd);
 
             node = ((struct nc_server_reply_data *)reply)->data;
             assert(node->schema->nodetype & (LYS_RPC | LYS_ACTION));
@@ -1148,6 +2491,17 @@ nc_write_msg_io(struct nc_session *session, int io_timeout, int type, ...)
     /* flush message */
     nc_write_clb((void *)&arg, NULL, 0, 0);
 
+    if (nc_out_queue_used(session)) {
+        if (arg.write_usec) {
+            usec = nc_time_mono_usec();
+        }
+        /* hello must be sent before the peer hello can be expected, wait for everything if queue was disabled */
+        nc_session_out_queue_flush(session, !server_opts.out_queue_size || (type == NC_MSG_HELLO));
+        if (arg.write_usec) {
+            *arg.write_usec += nc_time_mono_usec() - usec;
+        }
+    }
+
     if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
         /* error was already written */
         ret = NC_MSG_ERROR;
@@ -1162,6 +2516,132 @@ cleanup:
     return ret;
 }
 
+NC_MSG_TYPE
+nc_write_msg_buf_io(struct nc_session *session, int io_timeout, NC_MSG_TYPE type, const char *buf, size_t len)
+{
+    char chunksize[WRITE_CHUNKHDR_MAXLEN];
+    struct iovec iov[3];
+    int iovcnt = 0, ret;
+
+    assert(session && buf);
+
+    if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
+        ERR(session, "Invalid session to write to.");
+        return NC_MSG_ERROR;
+    }
+
+    /* SESSION IO LOCK */
+    ret = nc_session_io_lock(session, io_timeout, __func__);
+    if (ret < 0) {
+        return NC_MSG_ERROR;
+    } else if (!ret) {
+        return NC_MSG_WOULDBLOCK;
+    }
+
+    if (nc_out_queue_used(session)) {
+        if (nc_session_out_queue_flush(session, 0)) {
+            nc_session_io_unlock(session, __func__);
+            return NC_MSG_ERROR;
+        }
+        if ((type == NC_MSG_NOTIF) && server_opts.out_queue_size && (session->obuf_len >= server_opts.out_queue_size)) {
+            VRB(session, "Output queue full (%zu bytes), notification not sent.", session->obuf_len);
+            nc_session_io_unlock(session, __func__);
+            return NC_MSG_WOULDBLOCK;
+        }
+    }
+
+    /* frame the whole message as a single chunk */
+    if (session->version == NC_VERSION_11) {
+        iov[iovcnt].iov_base = chunksize;
+        iov[iovcnt].iov_len = sprintf(chunksize, "\n#%zu\n", len);
+        ++iovcnt;
+    }
+    iov[iovcnt].iov_base = (void *)buf;
+    iov[iovcnt].iov_len = len;
+    ++iovcnt;
+    if (session->version == NC_VERSION_11) {
+        iov[iovcnt].iov_base = "\n##\n";
+        iov[iovcnt].iov_len = 4;
+    } else {
+        iov[iovcnt].iov_base = NC_VERSION_10_ENDTAG;
+        iov[iovcnt].iov_len = NC_VERSION_10_ENDTAG_LEN;
+    }
+    ++iovcnt;
+
+    if ((nc_writev(session, iov, iovcnt) == -1) || (nc_out_queue_used(session) &&
+            nc_session_out_queue_flush(session, !server_opts.out_queue_size)) ||
+            ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING))) {
+        ret = NC_MSG_ERROR;
+    } else {
+        ret = type;
+    }
+
+    nc_session_io_unlock(session, __func__);
+    return ret;
+}
+
+NC_MSG_TYPE
+nc_write_rpc_buf_io(struct nc_session *session, int io_timeout, const char *buf, size_t len)
+{
+    char chunksize[WRITE_CHUNKHDR_MAXLEN], rpc_open[128];
+    struct iovec iov[5];
+    int iovcnt = 0, open_len, ret;
+
+    assert(session && buf);
+
+    if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
+        ERR(session, "Invalid session to write to.");
+        return NC_MSG_ERROR;
+    }
+
+    /* SESSION IO LOCK */
+    ret = nc_session_io_lock(session, io_timeout, __func__);
+    if (ret < 0) {
+        return NC_MSG_ERROR;
+    } else if (!ret) {
+        return NC_MSG_WOULDBLOCK;
+    }
+
+    /* <rpc> open with the next message ID */
+    open_len = sprintf(rpc_open, "<rpc xmlns=\"%s\" message-id=\"%" PRIu64 "\">", NC_NS_BASE,
+            session->opts.client.msgid + 1);
+
+    /* frame the whole message as a single chunk */
+    if (session->version == NC_VERSION_11) {
+        iov[iovcnt].iov_base = chunksize;
+        iov[iovcnt].iov_len = sprintf(chunksize, "\n#%zu\n", open_len + len + 6);
+        ++iovcnt;
+    }
+    iov[iovcnt].iov_base = rpc_open;
+    iov[iovcnt].iov_len = open_len;
+    ++iovcnt;
+    iov[iovcnt].iov_base = (void *)buf;
+    iov[iovcnt].iov_len = len;
+    ++iovcnt;
+    iov[iovcnt].iov_base = "</rpc>";
+    iov[iovcnt].iov_len = 6;
+    ++iovcnt;
+    if (session->version == NC_VERSION_11) {
+        iov[iovcnt].iov_base = "\n##\n";
+        iov[iovcnt].iov_len = 4;
+    } else {
+        iov[iovcnt].iov_base = NC_VERSION_10_ENDTAG;
+        iov[iovcnt].iov_len = NC_VERSION_10_ENDTAG_LEN;
+    }
+    ++iovcnt;
+
+    if ((nc_writev(session, iov, iovcnt) == -1) ||
+            ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING))) {
+        ret = NC_MSG_ERROR;
+    } else {
+        session->opts.client.msgid++;
+        ret = NC_MSG_RPC;
+    }
+
+    nc_session_io_unlock(session, __func__);
+    return ret;
+}
+
 void *
 nc_realloc(void *ptr, size_t size)
 {
@@ -106,7 +106,9 @@
  * implements NETCONF \<get-schema\> operation, the schema is retrieved from the server and stored
  * localy into the searchpath (if specified) for a future use. If none of these methods succeed to
  * load particular schema, the data from this schema are ignored during the communication with the
- * server.
+ * server. Clients connecting to many servers can also set a schema cache directory using
+ * ::nc_client_set_schema_cache_dir(), where all the retrieved schemas are stored and looked for before
+ * using \<get-schema\> again.
  *
  * Besides the mentioned setters, there are many other @ref howtoclientssh "SSH", @ref howtoclienttls "TLS"
  * and @ref howtoclientch "Call Home" getter/setter functions to manipulate with various settings. All these
@@ -139,6 +141,12 @@
  *
  * - ::nc_client_set_schema_searchpath()
  * - ::nc_client_get_schema_searchpath()
+ * - ::nc_client_set_schema_cache_dir()
+ * - ::nc_client_get_schema_cache_dir()
+ * - ::nc_client_set_ctx_pool()
+ * - ::nc_client_get_ctx_pool()
+ * - ::nc_client_set_notif_reactor()
+ * - ::nc_client_get_notif_reactor()
  * - ::nc_client_set_schema_callback()
  * - ::nc_client_get_schema_callback()
  *
@@ -149,6 +157,7 @@
  *
  * - ::nc_server_init()
  * - ::nc_server_destroy()
+ * - ::nc_server_ctx_release()
  *
  * Available in both __nc_client.h__ and __nc_server.h__.
  *
@@ -190,7 +199,9 @@
  *
  * New NETCONF sessions can also be created on existing authenticated SSH sessions.
  * There is a new SSH channel needed, on which the NETCONF session is then created.
- * Use ::nc_connect_ssh_channel() for this purpose.
+ * Use ::nc_connect_ssh_channel() for this purpose. The sessions on one SSH session
+ * can be used concurrently by different threads, the SSH session is locked only
+ * while its socket is read or written.
  *
  * Functions List
  * --------------
@@ -243,11 +254,30 @@
  * - ::nc_client_tls_get_trusted_ca_paths()
  * - ::nc_client_tls_set_crl_paths()
  * - ::nc_client_tls_get_crl_paths()
+ * - ::nc_client_tls_set_ktls()
  *
  * - ::nc_connect_tls()
  * - ::nc_connect_libssl()
  *
  *
+ * Many servers
+ * ============
+ *
+ * To connect to a large number of SSH and TLS servers at once, for example a whole
+ * fleet of devices, use ::nc_connect_batch(). The calling thread drives the TCP connects
+ * of many targets concurrently without blocking and a pool of worker threads resolves
+ * their host names and then establishes the transport and NETCONF sessions, reporting every
+ * session to a callback.
+ * The options are the same as for ::nc_connect_ssh() and ::nc_connect_tls().
+ *
+ * Functions List
+ * --------------
+ *
+ * Available in __nc_client.h__.
+ *
+ * - ::nc_connect_batch()
+ *
+ *
  * FD and UNIX socket
  * ==================
  *
@@ -303,6 +333,7 @@
  * - ::nc_client_tls_ch_get_trusted_ca_paths()
  * - ::nc_client_tls_ch_set_crl_paths()
  * - ::nc_client_tls_ch_get_crl_paths()
+ * - ::nc_client_tls_ch_set_ktls()
  *
  * - ::nc_accept_callhome()
  *
@@ -326,7 +357,10 @@
  * ::nc_server_set_capab_withdefaults() and generally ::nc_server_set_capability().
  * Timeout for receiving the _hello_ message on a new session can be set
  * by ::nc_server_set_hello_timeout() and the timeout for disconnecting
- * an inactive session by ::nc_server_set_idle_timeout().
+ * an inactive session by ::nc_server_set_idle_timeout(). Sessions behind slow links can be
+ * prevented from blocking the threads writing into them by enabling output queues with
+ * ::nc_server_set_out_queue_size(). Clients pipelining many RPCs are served with less
+ * overhead if ::nc_server_set_rpc_batch() allows processing several of them by one poll.
  *
  * Context does not only determine server modules, but its overall
  * functionality as well. For every RPC the server should support,
@@ -345,6 +379,12 @@
  * is available to set the unix socket file permissions, and ::nc_server_endpt_set_port()
  * is invalid.
  *
+ * A larger configuration, for example a whole datastore with many endpoints, should be
+ * applied between ::nc_server_config_begin() and ::nc_server_config_commit(). The changes are
+ * made to a staged copy of the configuration that replaces the current one at once on commit,
+ * so sessions are accepted and called home with the current configuration meanwhile. Only the
+ * listening sockets and other derived structures of what changed are created again.
+ *
  * Functions List
  * --------------
  *
@@ -354,12 +394,16 @@
  * - ::nc_server_set_capability()
  * - ::nc_server_set_hello_timeout()
  * - ::nc_server_set_idle_timeout()
+ * - ::nc_server_set_out_queue_size()
+ * - ::nc_server_set_rpc_batch()
  *
  * - ::nc_server_add_endpt()
  * - ::nc_server_del_endpt()
  * - ::nc_server_endpt_set_address()
  * - ::nc_server_endpt_set_port()
  * - ::nc_server_endpt_set_perms()
+ * - ::nc_server_config_begin()
+ * - ::nc_server_config_commit()
  *
  *
  * SSH
@@ -422,6 +466,10 @@
  * If you need to remove trusted certificates, you can do so with ::nc_server_tls_endpt_del_trusted_cert_list().
  * To clear all Certificate Revocation Lists use ::nc_server_tls_endpt_clear_crls().
  *
+ * On Linux with OpenSSL 3, the record encryption of the accepted sessions can be offloaded to the kernel
+ * with ::nc_server_tls_endpt_set_ktls(). If the kernel or the negotiated cipher does not support it,
+ * OpenSSL is used as usual. Whether a session uses the offload is returned by ::nc_session_get_ktls().
+ *
  * Functions List
  * --------------
  *
@@ -433,6 +481,7 @@
  * - ::nc_server_tls_endpt_set_trusted_ca_paths()
  * - ::nc_server_tls_endpt_set_crl_paths()
  * - ::nc_server_tls_endpt_clear_crls()
+ * - ::nc_server_tls_endpt_set_ktls()
  * - ::nc_server_tls_endpt_add_ctn()
  * - ::nc_server_tls_endpt_del_ctn()
  * - ::nc_server_tls_endpt_get_ctn()
@@ -455,6 +504,21 @@
  *
  * - ::nc_accept_inout()
  *
+ * In-Memory
+ * =========
+ *
+ * If both the client and the server run in the same process, a connected
+ * pair of their sessions can be created with ::nc_accept_mem(). The sessions
+ * pass the messages through shared ring buffers instead of any file descriptors
+ * and the client session uses the server context.
+ *
+ * Functions List
+ * --------------
+ *
+ * Available in __nc_server.h__.
+ *
+ * - ::nc_accept_mem()
+ *
  *
  * Call Home
  * =========
@@ -464,7 +528,9 @@
  * for CH clients. However, one important difference is that
  * once all the mandatory options are set, _libnetconf2_ __will not__
  * immediately start connecting to a client. It will do so only after
- * calling ::nc_connect_ch_client_dispatch() in a separate thread.
+ * calling ::nc_connect_ch_client_dispatch(). All the dispatched clients
+ * share one scheduler thread timing their connection attempts and a few
+ * worker threads connecting them, so no thread is created per client.
  *
  * Lastly, monitoring of these sessions is up to the application.
  *
@@ -504,6 +570,7 @@
  * - ::nc_server_tls_ch_client_endpt_del_trusted_cert_list()
  * - ::nc_server_tls_ch_client_endpt_set_trusted_ca_paths()
  * - ::nc_server_tls_ch_client_endpt_set_crl_paths()
+ * - ::nc_server_tls_ch_client_endpt_set_ktls()
  * - ::nc_server_tls_ch_client_endpt_clear_crls()
  * - ::nc_server_tls_ch_client_endpt_add_ctn()
  * - ::nc_server_tls_ch_client_endpt_del_ctn()
@@ -517,12 +584,28 @@
  * and the first with a pending connection is used. To remove all CH clients,
  * endpoints, and free any used dynamic memory, [destroy](@ref howtoinit) the server.
  *
+ * A server accepting many connections at once can instead create an acceptor
+ * with ::nc_acceptor_new(). Its threads wait for new connections and pass them
+ * to worker threads performing the handshakes, every new session is then given
+ * to a callback. With SO_REUSEPORT enabled by ::nc_server_set_reuseport(), each
+ * acceptor thread listens on its own sockets and the kernel balances the connections.
+ *
+ * Alternatively, ::nc_accept_nonblock() returns a new session right after its connection
+ * is accepted, with the SSH or TLS and NETCONF handshakes still in progress. They are
+ * then advanced without blocking by ::nc_session_handshake() or by ::nc_ps_poll() once
+ * the session is added into a pollsession, so a few threads can handle many connecting clients.
+ *
  * Functions List
  * --------------
  *
  * Available in __nc_server.h__.
  *
  * - ::nc_accept()
+ * - ::nc_accept_nonblock()
+ * - ::nc_session_handshake()
+ * - ::nc_acceptor_new()
+ * - ::nc_acceptor_free()
+ * - ::nc_server_set_reuseport()
  */
 
 /**
@@ -535,6 +618,16 @@
  * with ::nc_recv_notif_dispatch() that asynchronously (in a separate thread)
  * reads notifications and passes them to your callback.
  *
+ * To avoid waiting for every reply before sending another RPC, send the RPCs
+ * using ::nc_send_rpc_async() instead. Their replies are then passed to your callback
+ * by ::nc_recv_reply_async_dispatch() or, if no callback was set, retrieved one by one
+ * by ::nc_recv_reply_async().
+ *
+ * An RPC sent repeatedly can be prepared once by ::nc_rpc_prepare() and then sent
+ * by ::nc_send_rpc_prepared() on any session with the same context without creating
+ * and printing it again. Parts of the prepared RPC, such as the target datastore,
+ * can be marked as slots and substituted with other values on every send.
+ *
  * Functions List
  * --------------
  *
@@ -570,6 +663,12 @@
  *
  * - ::nc_send_rpc()
  * - ::nc_recv_reply()
+ * - ::nc_send_rpc_async()
+ * - ::nc_rpc_prepare()
+ * - ::nc_send_rpc_prepared()
+ * - ::nc_rpc_prepared_free()
+ * - ::nc_recv_reply_async_dispatch()
+ * - ::nc_recv_reply_async()
  * - ::nc_recv_notif()
  * - ::nc_recv_notif_dispatch()
  */
@@ -586,13 +685,39 @@
  *
  * If an SSH NETCONF session asks for a new channel, you can accept
  * this request with ::nc_ps_accept_ssh_channel() or ::nc_session_accept_ssh_channel()
- * depending on the structure you want to use as the argument.
+ * depending on the structure you want to use as the argument. RPCs received on
+ * different channels of one SSH session are processed concurrently.
+ *
+ * Statistics of every session, as defined by _ietf-netconf-monitoring_, are
+ * available by ::nc_session_get_stats() and the global statistics of all the
+ * server sessions by ::nc_server_get_stats(). Both can be read any time without
+ * affecting the communication.
+ *
+ * To find out where the time of processing RPCs goes, ::nc_server_set_rpc_latency()
+ * enables measuring every stage of it (waiting for the pollsession lock, reading,
+ * parsing, the RPC callback, printing and writing the reply). The latencies are
+ * kept in histograms for every RPC and summarized by ::nc_server_get_rpc_latency().
+ * A tracing callback called around every stage can be set by ::nc_server_set_rpc_trace_clb().
+ *
+ * RPCs can be rejected or answered before they are parsed by a callback set with
+ * ::nc_server_set_rpc_envelope_clb(). It gets only the message-id and the operation read
+ * from the \<rpc\> envelope so that, for example, denied \<edit-config\> RPCs with large
+ * content are never parsed and validated.
  *
  * Functions List
  * --------------
  *
  * Available in __nc_server.h__.
  *
+ * - ::nc_session_get_stats()
+ * - ::nc_server_get_stats()
+ * - ::nc_server_set_rpc_latency()
+ * - ::nc_server_get_rpc_latency()
+ * - ::nc_server_get_rpc_latency_names()
+ * - ::nc_server_reset_rpc_latency()
+ * - ::nc_server_set_rpc_trace_clb()
+ * - ::nc_server_set_rpc_envelope_clb()
+ *
  * - ::nc_ps_new()
  * - ::nc_ps_add_session()
  * - ::nc_ps_del_session()
@@ -632,7 +757,9 @@
  * To free up some resources, it is possible to adjust the maximum idle period
  * of a session before it is disconnected. In _Call Home_, for both a persistent
  * and periodic connection can this idle timeout be specified separately for each
- * client using corresponding functions.
+ * client using corresponding functions. A pollsession keeps the idle and handshake
+ * timeouts of its sessions in a timer wheel so only the sessions whose timeout
+ * elapsed are checked and ::nc_ps_poll() waits exactly until the next one does.
  *
  * Lastly, SSH user authentication timeout can be also modified. It is the time
  * a client has to successfully authenticate after connecting before it is disconnected.
@@ -646,6 +773,10 @@
  * - ::nc_server_get_hello_timeout()
  * - ::nc_server_set_idle_timeout()
  * - ::nc_server_get_idle_timeout()
+ * - ::nc_server_set_out_queue_size()
+ * - ::nc_server_get_out_queue_size()
+ * - ::nc_server_set_rpc_batch()
+ * - ::nc_server_get_rpc_batch()
  * - ::nc_server_ch_client_periodic_set_idle_timeout()
  * - ::nc_server_ssh_ch_client_endpt_set_auth_timeout()
  * - ::nc_server_ssh_ch_client_endpt_set_auth_timeout()
@@ -13,8 +13,13 @@
  *     https://opensource.org/licenses/BSD-3-Clause
  */
 
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <libyang/libyang.h>
 
@@ -34,6 +39,55 @@ ATOMIC_T verbose_level = 0;
 void (*depr_print_clb)(NC_VERB_LEVEL level, const char *msg);
 void (*print_clb)(const struct nc_session *session, NC_VERB_LEVEL level, const char *msg);
 
+/**
+ * @brief Maximum number of messages printed per second for a session, 0 for no limit
+ */
+static ATOMIC_T log_session_rate;
+
+/**
+ * @brief Maximum printed length of NETCONF messages, 0 for no limit
+ */
+static ATOMIC_T log_dump_limit;
+
+/**
+ * @brief Record of a message in the ring buffer of a thread, records are aligned to ::NC_LOG_REC_ALIGN.
+ */
+struct nc_log_rec {
+    uint32_t len;                   /**< length of the whole record with its padding */
+    int32_t level;                  /**< verbose level of the message, -1 for skipped space at the end of the ring */
+    uint32_t id;                    /**< ID of the session that generated the message, 0 if none */
+    char msg[];                     /**< formatted message */
+};
+
+/**
+ * @brief Ring buffer of the messages of a thread, written only by the thread and read only by the printing thread.
+ */
+struct nc_log_ring {
+    char *buf;
+    uint32_t size;                  /**< size of buf, a power of two */
+    ATOMIC_T head;                  /**< count of written bytes, modulo 2^32 */
+    ATOMIC_T tail;                  /**< count of printed bytes, modulo 2^32 */
+    ATOMIC_T dropped;               /**< messages dropped because the ring was full */
+    ATOMIC_T orphaned;              /**< the thread exited, the ring is freed once printed */
+    struct nc_log_ring *next;       /**< next ring, modified only with the lock held by the printing thread */
+};
+
+/**
+ * @brief Asynchronous printing of messages.
+ */
+static struct {
+    pthread_mutex_t lock;           /**< lock for the ring list and the printing thread */
+    pthread_cond_t cond;            /**< signaled on new messages */
+    pthread_key_t key;              /**< ring of the current thread */
+    int key_created;
+    struct nc_log_ring *rings;      /**< rings of all the threads printing asynchronously, new ones are prepended */
+    ATOMIC_T ring_size;             /**< size of new rings, 0 if messages are printed synchronously */
+    ATOMIC_T signaled;              /**< the printing thread was signaled about new messages */
+    int running;                    /**< whether the printing thread runs */
+    int stop;                       /**< whether the printing thread should terminate */
+    pthread_t tid;
+} log_async = {.lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
+
 API void
 nc_verbosity(NC_VERB_LEVEL level)
 {
@@ -62,6 +116,307 @@ nc_libssh_thread_verbosity(int level)
 
 #endif
 
+/**
+ * @brief Print a formatted message.
+ *
+ * @param[in] session Optional NETCONF session that generated the message.
+ * @param[in] level Verbose level.
+ * @param[in] msg Message.
+ */
+static void
+prv_print(const struct nc_session *session, NC_VERB_LEVEL level, const char *msg)
+{
+    if (print_clb) {
+        print_clb(session, level, msg);
+    } else if (depr_print_clb) {
+        depr_print_clb(level, msg);
+    } else if (session && session->id) {
+        fprintf(stderr, "Session %u %s: %s\n", session->id, verb[level].label, msg);
+    } else {
+        fprintf(stderr, "%s: %s\n", verb[level].label, msg);
+    }
+}
+
+/**
+ * @brief Check the rate limit of the messages of a session.
+ *
+ * Concurrent messages may make the limit only approximate.
+ *
+ * @param[in] session NETCONF session that generated a message.
+ * @return Whether the message is over the limit and is to be dropped.
+ */
+static int
+prv_rate_limited(const struct nc_session *session)
+{
+    struct nc_session *s = (struct nc_session *)session;
+    struct timespec ts;
+    uint32_t rate, dropped;
+
+    rate = ATOMIC_LOAD_RELAXED(log_session_rate);
+    if (!rate) {
+        return 0;
+    }
+
+    nc_gettimespec_mono_add(&ts, 0);
+    if (ATOMIC_LOAD_RELAXED(s->log.window) != (uint32_t)ts.tv_sec) {
+        /* new window */
+        ATOMIC_STORE_RELAXED(s->log.window, (uint32_t)ts.tv_sec);
+        ATOMIC_STORE_RELAXED(s->log.count, 0);
+
+        dropped = ATOMIC_LOAD_RELAXED(s->log.dropped);
+        if (dropped) {
+            ATOMIC_SUB_RELAXED(s->log.dropped, dropped);
+            prv_printf(session, NC_VERB_WARNING, "%" PRIu32 " messages dropped by the rate limit.", dropped);
+        }
+    }
+
+    if (ATOMIC_INC_RELAXED(s->log.count) >= rate) {
+        ATOMIC_INC_RELAXED(s->log.dropped);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Thread-specific data destructor of a ring, which is printed and freed by the printing thread.
+ *
+ * @param[in] arg Ring of the exiting thread.
+ */
+static void
+nc_log_ring_orphan(void *arg)
+{
+    struct nc_log_ring *ring = arg, **r;
+
+    ATOMIC_STORE_RELEASE(ring->orphaned, 1);
+
+    /* LOCK */
+    pthread_mutex_lock(&log_async.lock);
+
+    if (!log_async.running) {
+        /* there is no printing thread to free it */
+        for (r = &log_async.rings; *r != ring; r = &(*r)->next) {}
+        *r = ring->next;
+        free(ring->buf);
+        free(ring);
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&log_async.lock);
+}
+
+/**
+ * @brief Get the ring of the current thread, create it if needed.
+ *
+ * @return Ring, NULL on error.
+ */
+static struct nc_log_ring *
+nc_log_ring_get(void)
+{
+    struct nc_log_ring *ring;
+
+    ring = pthread_getspecific(log_async.key);
+    if (ring) {
+        return ring;
+    }
+
+    /* no error can be printed, the message is then printed synchronously */
+    ring = calloc(1, sizeof *ring);
+    if (!ring) {
+        return NULL;
+    }
+    ring->size = ATOMIC_LOAD_RELAXED(log_async.ring_size);
+    ring->buf = malloc(ring->size);
+    if (!ring->size || !ring->buf || pthread_setspecific(log_async.key, ring)) {
+        free(ring->buf);
+        free(ring);
+        return NULL;
+    }
+
+    /* LOCK */
+    pthread_mutex_lock(&log_async.lock);
+
+    ring->next = log_async.rings;
+    log_async.rings = ring;
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&log_async.lock);
+
+    return ring;
+}
+
+/**
+ * @brief Format a message into the ring of the current thread.
+ *
+ * @param[in] session Optional NETCONF session that generated the message.
+ * @param[in] level Verbose level.
+ * @param[in] format Formatting string.
+ * @param[in] args Format arguments.
+ * @return 0 if the message was written or dropped, -1 if it should be printed synchronously.
+ */
+static int
+nc_log_ring_write(const struct nc_session *session, NC_VERB_LEVEL level, const char *format, va_list args)
+{
+    struct nc_log_ring *ring;
+    struct nc_log_rec *rec;
+    uint32_t head, free_len, pos, cont, max;
+    int len;
+
+    ring = nc_log_ring_get();
+    if (!ring) {
+        return -1;
+    }
+
+    head = ATOMIC_LOAD_RELAXED(ring->head);
+    free_len = ring->size - (head - (uint32_t)ATOMIC_LOAD_ACQUIRE(ring->tail));
+    pos = head & (ring->size - 1);
+    cont = ring->size - pos;
+    if ((cont < NC_LOG_REC_MIN_SIZE) && (free_len > cont)) {
+        /* skip the short space at the end of the ring, only the first 2 members fit into it */
+        rec = (struct nc_log_rec *)(ring->buf + pos);
+        rec->len = cont;
+        rec->level = -1;
+        head += cont;
+        free_len -= cont;
+        pos = 0;
+        cont = ring->size;
+    }
+    if (cont > free_len) {
+        cont = free_len;
+    }
+    if (cont < NC_LOG_REC_MIN_SIZE) {
+        /* ring full */
+        ATOMIC_INC_RELAXED(ring->dropped);
+        ATOMIC_STORE_RELEASE(ring->head, head);
+        return 0;
+    }
+
+    /* format the message directly into the ring, truncated to the free space */
+    rec = (struct nc_log_rec *)(ring->buf + pos);
+    max = cont - sizeof *rec;
+    len = vsnprintf(rec->msg, max, format, args);
+    if (len < 0) {
+        rec->msg[0] = '\0';
+        len = 0;
+    }
+    if ((uint32_t)len >= max) {
+        len = max - 1;
+        memcpy(rec->msg + len - 3, "...", 3);
+    }
+
+    rec->len = (sizeof *rec + len + 1 + NC_LOG_REC_ALIGN - 1) & ~(uint32_t)(NC_LOG_REC_ALIGN - 1);
+    rec->level = level;
+    rec->id = session ? session->id : 0;
+    ATOMIC_STORE_RELEASE(ring->head, head + rec->len);
+
+    /* the signal can be lost without the lock, the printing thread wakes up regularly anyway */
+    if (!ATOMIC_LOAD_RELAXED(log_async.signaled)) {
+        ATOMIC_STORE_RELAXED(log_async.signaled, 1);
+        pthread_cond_signal(&log_async.cond);
+    }
+    return 0;
+}
+
+/**
+ * @brief Print all the messages in a ring.
+ *
+ * The session may have been freed since, so the messages of sessions are printed with a placeholder
+ * session with only the ID of the original one.
+ *
+ * @param[in] ring Ring to print.
+ * @return Whether the ring is empty.
+ */
+static int
+nc_log_ring_print(struct nc_log_ring *ring)
+{
+    struct nc_log_rec *rec;
+    struct nc_session session = {0};
+    uint32_t head, tail, dropped;
+    char msg[64];
+
+    head = ATOMIC_LOAD_ACQUIRE(ring->head);
+    tail = ATOMIC_LOAD_RELAXED(ring->tail);
+    while (tail != head) {
+        rec = (struct nc_log_rec *)(ring->buf + (tail & (ring->size - 1)));
+        if (rec->level > -1) {
+            session.id = rec->id;
+            prv_print(rec->id ? &session : NULL, rec->level, rec->msg);
+        }
+        tail += rec->len;
+
+        /* free the space right away */
+        ATOMIC_STORE_RELEASE(ring->tail, tail);
+    }
+
+    dropped = ATOMIC_LOAD_RELAXED(ring->dropped);
+    if (dropped) {
+        ATOMIC_SUB_RELAXED(ring->dropped, dropped);
+        sprintf(msg, "%" PRIu32 " messages dropped, the ring buffer was full.", dropped);
+        prv_print(NULL, NC_VERB_WARNING, msg);
+    }
+
+    return head == (uint32_t)ATOMIC_LOAD_ACQUIRE(ring->head);
+}
+
+/**
+ * @brief Printing thread of asynchronous messages.
+ *
+ * @param[in] arg Unused.
+ * @return NULL.
+ */
+static void *
+nc_log_async_thread(void *arg)
+{
+    struct nc_log_ring *ring, **r;
+    struct timespec ts;
+    int stop;
+
+    (void)arg;
+
+    do {
+        /* LOCK */
+        pthread_mutex_lock(&log_async.lock);
+
+        if (!log_async.stop && !ATOMIC_LOAD_RELAXED(log_async.signaled)) {
+            nc_gettimespec_real_add(&ts, NC_LOG_ASYNC_WAIT);
+            pthread_cond_timedwait(&log_async.cond, &log_async.lock, &ts);
+        }
+        ATOMIC_STORE_RELAXED(log_async.signaled, 0);
+        stop = log_async.stop;
+        ring = log_async.rings;
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&log_async.lock);
+
+        /* the rings are printed without the lock, only this thread removes them from the list */
+        for ( ; ring; ring = ring->next) {
+            nc_log_ring_print(ring);
+        }
+
+        /* LOCK */
+        pthread_mutex_lock(&log_async.lock);
+
+        /* free the printed rings of exited threads */
+        for (r = &log_async.rings; *r; ) {
+            ring = *r;
+            if (ATOMIC_LOAD_ACQUIRE(ring->orphaned) && nc_log_ring_print(ring)) {
+                *r = ring->next;
+                free(ring->buf);
+                free(ring);
+            } else {
+                r = &ring->next;
+            }
+        }
+        if (stop) {
+            log_async.running = 0;
+        }
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&log_async.lock);
+    } while (!stop);
+
+    return NULL;
+}
+
 static void
 prv_vprintf(const struct nc_session *session, NC_VERB_LEVEL level, const char *format, va_list args)
 {
@@ -71,6 +426,14 @@ prv_vprintf(const struct nc_session *session, NC_VERB_LEVEL level, const char *f
     void *mem;
     int req_len;
 
+    if (session && (level != NC_VERB_ERROR) && prv_rate_limited(session)) {
+        return;
+    }
+
+    if (ATOMIC_LOAD_RELAXED(log_async.ring_size) && !nc_log_ring_write(session, level, format, args)) {
+        return;
+    }
+
     prv_msg = malloc(PRV_MSG_INIT_SIZE);
     if (!prv_msg) {
         return;
@@ -97,15 +460,7 @@ prv_vprintf(const struct nc_session *session, NC_VERB_LEVEL level, const char *f
         }
     }
 
-    if (print_clb) {
-        print_clb(session, level, prv_msg);
-    } else if (depr_print_clb) {
-        depr_print_clb(level, prv_msg);
-    } else if (session && session->id) {
-        fprintf(stderr, "Session %u %s: %s\n", session->id, verb[level].label, prv_msg);
-    } else {
-        fprintf(stderr, "%s: %s\n", verb[level].label, prv_msg);
-    }
+    prv_print(session, level, prv_msg);
 
 cleanup:
     free(prv_msg);
@@ -122,6 +477,19 @@ prv_printf(const struct nc_session *session, NC_VERB_LEVEL level, const char *fo
     va_end(ap);
 }
 
+void
+prv_print_dump(const struct nc_session *session, const char *what, const char *msg, size_t len)
+{
+    uint32_t limit;
+
+    limit = ATOMIC_LOAD_RELAXED(log_dump_limit);
+    if (limit && (len > limit)) {
+        prv_printf(session, NC_VERB_DEBUG, "%s:\n%.*s\n[... %zu more bytes]\n", what, (int)limit, msg, len - limit);
+    } else {
+        prv_printf(session, NC_VERB_DEBUG, "%s:\n%.*s\n", what, (int)len, msg);
+    }
+}
+
 static void
 nc_ly_log_clb(LY_LOG_LEVEL lvl, const char *msg, const char *UNUSED(path))
 {
@@ -147,3 +515,102 @@ nc_set_print_clb_session(void (*clb)(const struct nc_session *, NC_VERB_LEVEL, c
     depr_print_clb = NULL;
     ly_set_log_clb(nc_ly_log_clb, 1);
 }
+
+API int
+nc_set_print_async(uint32_t ring_size)
+{
+    struct nc_log_ring *ring, **r;
+    uint32_t size;
+    pthread_t tid;
+    const char *errmsg = NULL;
+    int ret;
+
+    if (ring_size > (UINT32_C(1) << 31)) {
+        ERRARG("ring_size");
+        return -1;
+    }
+
+    /* LOCK */
+    pthread_mutex_lock(&log_async.lock);
+
+    if (ring_size) {
+        for (size = NC_LOG_RING_MIN_SIZE; size < ring_size; size <<= 1) {}
+
+        if (!log_async.key_created) {
+            if ((ret = pthread_key_create(&log_async.key, nc_log_ring_orphan))) {
+                errmsg = "Creating a thread-specific data key";
+                goto error;
+            }
+            log_async.key_created = 1;
+        }
+        if (!log_async.running) {
+            log_async.stop = 0;
+            if ((ret = pthread_create(&log_async.tid, NULL, nc_log_async_thread, NULL))) {
+                errmsg = "Creating a thread";
+                goto error;
+            }
+            log_async.running = 1;
+        }
+        ATOMIC_STORE_RELAXED(log_async.ring_size, size);
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&log_async.lock);
+        return 0;
+    }
+
+    ATOMIC_STORE_RELAXED(log_async.ring_size, 0);
+    if (!log_async.running || log_async.stop) {
+        /* UNLOCK */
+        pthread_mutex_unlock(&log_async.lock);
+        return 0;
+    }
+
+    /* let the printing thread print all the messages and terminate */
+    log_async.stop = 1;
+    tid = log_async.tid;
+    pthread_cond_signal(&log_async.cond);
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&log_async.lock);
+
+    pthread_join(tid, NULL);
+
+    /* the ring of this thread is not needed anymore, those of other threads are kept until they exit */
+    ring = pthread_getspecific(log_async.key);
+    if (ring) {
+        pthread_setspecific(log_async.key, NULL);
+
+        /* LOCK */
+        pthread_mutex_lock(&log_async.lock);
+
+        for (r = &log_async.rings; *r != ring; r = &(*r)->next) {}
+        *r = ring->next;
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&log_async.lock);
+
+        free(ring->buf);
+        free(ring);
+    }
+    return 0;
+
+error:
+    /* UNLOCK */
+    pthread_mutex_unlock(&log_async.lock);
+
+    /* printed only without the lock, it may be needed for printing */
+    ERR(NULL, "%s failed (%s).", errmsg, strerror(ret));
+    return -1;
+}
+
+API void
+nc_set_print_session_rate(uint32_t rate)
+{
+    ATOMIC_STORE_RELAXED(log_session_rate, rate);
+}
+
+API void
+nc_set_print_msg_dump_limit(uint32_t len)
+{
+    ATOMIC_STORE_RELAXED(log_dump_limit, len);
+}
@@ -88,6 +88,43 @@ void nc_set_print_clb(void (*clb)(NC_VERB_LEVEL, const char *));
  */
 void nc_set_print_clb_session(void (*clb)(const struct nc_session *, NC_VERB_LEVEL, const char *));
 
+/**
+ * @brief Set asynchronous printing of libnetconf2 messages.
+ *
+ * Every thread then formats its messages into its own ring buffer, which is never locked, and
+ * the messages are printed by a separate thread. If a ring buffer is full, messages are dropped
+ * and their count is printed later. Messages that do not fit into the free space of a ring buffer
+ * are truncated.
+ *
+ * The print callback is then called from the printing thread and the session it gets, if any, is only
+ * a placeholder with the ID of the original session, which may have been freed already, so only
+ * ::nc_session_get_id() can be used on it. libyang messages are always printed synchronously.
+ * Asynchronous printing should be disabled before exiting to print all the remaining messages.
+ *
+ * @param[in] ring_size Size in bytes of the ring buffer of every thread, rounded up to a power of two,
+ * 0 to print all the messages synchronously (default).
+ * @return 0 on success, -1 on error.
+ */
+int nc_set_print_async(uint32_t ring_size);
+
+/**
+ * @brief Limit the number of messages printed for every session.
+ *
+ * Any further messages of a session within the same second, except errors, are dropped and their
+ * count is printed later.
+ *
+ * @param[in] rate Maximum number of messages per second printed for a session, 0 for no limit (default).
+ */
+void nc_set_print_session_rate(uint32_t rate);
+
+/**
+ * @brief Limit the length of sent and received NETCONF messages printed on #NC_VERB_DEBUG level.
+ *
+ * @param[in] len Maximum number of printed bytes of every message, the rest is replaced by its length,
+ * 0 for no limit (default).
+ */
+void nc_set_print_msg_dump_limit(uint32_t len);
+
 /** @} */
 
 #ifdef __cplusplus
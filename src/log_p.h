@@ -34,11 +34,41 @@
  */
 void prv_printf(const struct nc_session *session, NC_VERB_LEVEL level, const char *format, ...);
 
+/**
+ * @brief Internal printing function of a whole NETCONF message, truncated if set so.
+ *
+ * @param[in] session NETCONF session that sent or received the message.
+ * @param[in] what Description of the message.
+ * @param[in] msg Message.
+ * @param[in] len Length of @p msg.
+ */
+void prv_print_dump(const struct nc_session *session, const char *what, const char *msg, size_t len);
+
 /**
  * @brief Verbose level variable
  */
 extern ATOMIC_T verbose_level;
 
+/**
+ * Minimal size in bytes of the ring buffer of a thread printing messages asynchronously.
+ */
+#define NC_LOG_RING_MIN_SIZE 4096
+
+/**
+ * Minimal space in bytes of a record in the ring buffer, shorter free space at the end of the ring is skipped.
+ */
+#define NC_LOG_REC_MIN_SIZE 128
+
+/**
+ * Alignment in bytes of the records in the ring buffer, the space skipped at the end of the ring is at least this long.
+ */
+#define NC_LOG_REC_ALIGN 8
+
+/**
+ * Timeout in msec of the thread printing asynchronous messages waiting for new ones.
+ */
+#define NC_LOG_ASYNC_WAIT 100
+
 /*
  * Verbose printing macros
  */
@@ -47,6 +77,7 @@ extern ATOMIC_T verbose_level;
 #define VRB(session, format, args ...) if(ATOMIC_LOAD_RELAXED(verbose_level)>=NC_VERB_VERBOSE){prv_printf(session,NC_VERB_VERBOSE,format,##args);}
 #define DBG(session, format, args ...) if(ATOMIC_LOAD_RELAXED(verbose_level)>=NC_VERB_DEBUG){prv_printf(session,NC_VERB_DEBUG,format,##args);}
 #define DBL(session, format, args ...) if(ATOMIC_LOAD_RELAXED(verbose_level)>=NC_VERB_DEBUG_LOWLVL){prv_printf(session,NC_VERB_DEBUG_LOWLVL,format,##args);}
+#define DBG_MSG(session, what, msg, len) if(ATOMIC_LOAD_RELAXED(verbose_level)>=NC_VERB_DEBUG){prv_print_dump(session,what,msg,len);}
 
 #define ERRMEM ERR(NULL, "%s: memory reallocation failed (%s:%d).", __func__, __FILE__, __LINE__)
 #define ERRARG(arg) ERR(NULL, "%s: invalid argument (%s).", __func__, arg)
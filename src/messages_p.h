@@ -36,6 +36,15 @@ struct nc_server_reply_data {
     NC_WD_MODE wd;
 };
 
+struct nc_server_reply_data_stream {
+    NC_RPL type;
+    const struct lysc_node *anydata; /**< RPC output anydata/anyxml node the produced data are printed in, if any */
+    nc_server_reply_data_clb data_clb;
+    void *user_data;
+    void (*free_user_data)(void *user_data);
+    NC_WD_MODE wd;
+};
+
 struct nc_server_reply_error {
     NC_RPL type;
     struct lyd_node *err;
@@ -260,6 +269,24 @@ struct nc_rpc_resyncsub {
     uint32_t id;
 };
 
+/**
+ * @brief Occurrence of a slot in a prepared RPC.
+ */
+struct nc_rpc_slot {
+    uint16_t slot;           /**< index of the slot */
+    size_t offset;           /**< offset of the occurrence in the printed RPC */
+};
+
+struct nc_rpc_prepared {
+    const struct ly_ctx *ctx;    /**< context the RPC was created in */
+    char *xml;                   /**< printed RPC content of the <rpc> element */
+    size_t len;                  /**< length of xml */
+    size_t *slot_lens;           /**< lengths of all the slots */
+    uint16_t slot_count;         /**< number of slots */
+    struct nc_rpc_slot *occurs;  /**< occurrences of all the slots sorted by their offset */
+    uint32_t occur_count;        /**< number of occurrences */
+};
+
 void nc_server_rpc_free(struct nc_server_rpc *rpc);
 
 void nc_client_err_clean(struct nc_err *err, struct ly_ctx *ctx);
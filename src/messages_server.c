@@ -76,6 +76,35 @@ nc_server_reply_data(struct lyd_node *data, NC_WD_MODE wd, NC_PARAMTYPE paramtyp
     return (struct nc_server_reply *)ret;
 }
 
+API struct nc_server_reply *
+nc_server_reply_data_stream(const struct lysc_node *anydata, nc_server_reply_data_clb data_clb, void *user_data,
+        void (*free_user_data)(void *user_data), NC_WD_MODE wd)
+{
+    struct nc_server_reply_data_stream *ret;
+
+    if (anydata && !(anydata->nodetype & LYS_ANYDATA)) {
+        ERRARG("anydata");
+        return NULL;
+    } else if (!data_clb) {
+        ERRARG("data_clb");
+        return NULL;
+    }
+
+    ret = malloc(sizeof *ret);
+    if (!ret) {
+        ERRMEM;
+        return NULL;
+    }
+
+    ret->type = NC_RPL_DATA_STREAM;
+    ret->anydata = anydata;
+    ret->data_clb = data_clb;
+    ret->user_data = user_data;
+    ret->free_user_data = free_user_data;
+    ret->wd = wd;
+    return (struct nc_server_reply *)ret;
+}
+
 API struct nc_server_reply *
 nc_server_reply_err(struct lyd_node *err)
 {
@@ -805,6 +834,7 @@ API void
 nc_server_reply_free(struct nc_server_reply *reply)
 {
     struct nc_server_reply_data *data_rpl;
+    struct nc_server_reply_data_stream *stream_rpl;
     struct nc_server_reply_error *error_rpl;
 
     if (!reply) {
@@ -818,6 +848,12 @@ nc_server_reply_free(struct nc_server_reply *reply)
             lyd_free_siblings(data_rpl->data);
         }
         break;
+    case NC_RPL_DATA_STREAM:
+        stream_rpl = (struct nc_server_reply_data_stream *)reply;
+        if (stream_rpl->free_user_data) {
+            stream_rpl->free_user_data(stream_rpl->user_data);
+        }
+        break;
     case NC_RPL_OK:
         /* nothing to free */
         break;
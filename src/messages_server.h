@@ -104,6 +104,38 @@ struct nc_server_reply *nc_server_reply_ok(void);
  */
 struct nc_server_reply *nc_server_reply_data(struct lyd_node *data, NC_WD_MODE wd, NC_PARAMTYPE paramtype);
 
+/**
+ * @brief Prototype of callbacks producing the data of a streamed DATA rpc-reply.
+ *
+ * The callback is called repeatedly while the reply is being sent and every batch it produces
+ * is printed and freed before the next batch is requested, so the whole data never have to
+ * be held in memory.
+ *
+ * @param[in] session Session the reply is being sent on.
+ * @param[in] user_data Arbitrary user data set with the reply.
+ * @param[out] data Next batch of sibling data trees, spent by the caller. NULL if there are no more data.
+ * @return 0 on success, non-zero on error. The reply cannot be finished after an error
+ * and the session is terminated.
+ */
+typedef int (*nc_server_reply_data_clb)(struct nc_session *session, void *user_data, struct lyd_node **data);
+
+/**
+ * @brief Create a DATA rpc-reply object with the data produced incrementally while it is being sent.
+ *
+ * Meant for huge replies, such as \<get\> of large data, so that they never have to be created
+ * as a whole before being sent.
+ *
+ * @param[in] anydata RPC output anydata or anyxml node all the produced data belong to, for example
+ * the \<data\> node of \<get\>. If NULL, the produced data are the RPC output nodes themselves.
+ * @param[in] data_clb Callback producing the reply data.
+ * @param[in] user_data Arbitrary user data passed to @p data_clb.
+ * @param[in] free_user_data Optional callback for freeing @p user_data when the reply is freed.
+ * @param[in] wd with-default mode if applicable
+ * @return rpc-reply object, NULL on error.
+ */
+struct nc_server_reply *nc_server_reply_data_stream(const struct lysc_node *anydata, nc_server_reply_data_clb data_clb,
+        void *user_data, void (*free_user_data)(void *user_data), NC_WD_MODE wd);
+
 /**
  * @brief Create an ERROR rpc-reply object.
  *
@@ -313,11 +345,28 @@ struct nc_server_notif *nc_server_notif_new(struct lyd_node *event, char *eventt
  * @param[in] timeout Timeout for writing in milliseconds. Use negative value for infinite
  *            waiting and 0 for return if data cannot be sent immediately.
  * @return #NC_MSG_NOTIF on success,
- *         #NC_MSG_WOULDBLOCK in case of a busy session, and
+ *         #NC_MSG_WOULDBLOCK in case of a busy session or a full session output queue, and
  *         #NC_MSG_ERROR on error.
  */
 NC_MSG_TYPE nc_server_notif_send(struct nc_session *session, struct nc_server_notif *notif, int timeout);
 
+/**
+ * @brief Send NETCONF Event Notification via several sessions.
+ *
+ * Unlike calling nc_server_notif_send() for every session, the notification is printed only once
+ * and the same message is then written to all the sessions. Sessions not subscribed to notifications
+ * are skipped.
+ *
+ * @param[in] sessions Array of NETCONF sessions where the Event Notification will be written.
+ * @param[in] session_count Number of @p sessions.
+ * @param[in] notif NETCONF Notification object to send via the sessions.
+ * @param[in] timeout Timeout for writing into every session in milliseconds. Use negative value for infinite
+ *            waiting and 0 for return if data cannot be sent immediately.
+ * @return Number of sessions the notification was sent to, -1 on error.
+ */
+int nc_server_notif_broadcast(struct nc_session **sessions, uint32_t session_count, struct nc_server_notif *notif,
+        int timeout);
+
 /**
  * @brief Free a server Event Notification object.
  *
@@ -114,7 +114,8 @@ typedef enum NC_REPLY {
     NC_RPL_OK,    /**< OK rpc-reply */
     NC_RPL_DATA,  /**< DATA rpc-reply */
     NC_RPL_ERROR, /**< ERROR rpc-reply */
-    NC_RPL_NOTIF  /**< notification (client-only) */
+    NC_RPL_NOTIF, /**< notification (client-only) */
+    NC_RPL_DATA_STREAM /**< DATA rpc-reply with the data produced while it is being sent (server-only) */
 } NC_RPL;
 
 /**
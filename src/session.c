@@ -17,6 +17,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <libyang/libyang.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -49,7 +50,6 @@
 
 /* in seconds */
 #define NC_CLIENT_HELLO_TIMEOUT 60
-#define NC_SERVER_HELLO_TIMEOUT 60
 
 /* in milliseconds */
 #define NC_CLOSE_REPLY_TIMEOUT 200
@@ -164,6 +164,29 @@ nc_difftimespec_mono_cur(const struct timespec *ts)
     return nsec_diff / 1000000L;
 }
 
+uint64_t
+nc_time_mono_usec(void)
+{
+    struct timespec ts;
+
+    nc_gettimespec_mono_add(&ts, 0);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t
+nc_hash_fnv1a(uint32_t hash, const void *data, size_t len)
+{
+    const uint8_t *ptr = data;
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        hash ^= ptr[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
 const char *
 nc_keytype2str(NC_SSH_KEY_TYPE type)
 {
@@ -223,7 +246,7 @@ nc_sock_enable_keepalive(int sock, struct nc_keepalives *ka)
 }
 
 struct nc_session *
-nc_new_session(NC_SIDE side, int shared_ti)
+nc_new_session(NC_SIDE side)
 {
     struct nc_session *sess;
 
@@ -235,29 +258,15 @@ nc_new_session(NC_SIDE side, int shared_ti)
     sess->side = side;
 
     if (side == NC_SERVER) {
-        pthread_mutex_init(&sess->opts.server.ntf_status_lock, NULL);
         pthread_mutex_init(&sess->opts.server.rpc_lock, NULL);
         pthread_cond_init(&sess->opts.server.rpc_cond, NULL);
-
-        pthread_mutex_init(&sess->opts.server.ch_lock, NULL);
-        pthread_cond_init(&sess->opts.server.ch_cond, NULL);
     } else {
         pthread_mutex_init(&sess->opts.client.msgs_lock, NULL);
     }
 
-    if (!shared_ti) {
-        sess->io_lock = malloc(sizeof *sess->io_lock);
-        if (!sess->io_lock) {
-            goto error;
-        }
-        pthread_mutex_init(sess->io_lock, NULL);
-    }
+    pthread_mutex_init(&sess->io_lock, NULL);
 
     return sess;
-
-error:
-    free(sess);
-    return NULL;
 }
 
 /*
@@ -389,8 +398,18 @@ nc_session_rpc_unlock(struct nc_session *session, int timeout, const char *func)
     return 1;
 }
 
-int
-nc_session_io_lock(struct nc_session *session, int timeout, const char *func)
+/**
+ * @brief Lock a lock of a session.
+ *
+ * @param[in] session Session of the lock.
+ * @param[in] lock Lock to lock.
+ * @param[in] timeout Timeout in msec to use.
+ * @param[in] func Caller function for logging.
+ * @param[in] name Name of the lock for logging.
+ * @return 1 on success, 0 on timeout, -1 on error.
+ */
+static int
+nc_session_mutex_lock(struct nc_session *session, pthread_mutex_t *lock, int timeout, const char *func, const char *name)
 {
     int ret;
     struct timespec ts_timeout;
@@ -398,11 +417,11 @@ nc_session_io_lock(struct nc_session *session, int timeout, const char *func)
     if (timeout > 0) {
         nc_gettimespec_real_add(&ts_timeout, timeout);
 
-        ret = pthread_mutex_timedlock(session->io_lock, &ts_timeout);
+        ret = pthread_mutex_timedlock(lock, &ts_timeout);
     } else if (!timeout) {
-        ret = pthread_mutex_trylock(session->io_lock);
+        ret = pthread_mutex_trylock(lock);
     } else { /* timeout == -1 */
-        ret = pthread_mutex_lock(session->io_lock);
+        ret = pthread_mutex_lock(lock);
     }
 
     if (ret) {
@@ -412,28 +431,131 @@ nc_session_io_lock(struct nc_session *session, int timeout, const char *func)
         }
 
         /* error */
-        ERR(session, "%s: failed to IO lock a session (%s).", func, strerror(ret));
+        ERR(session, "%s: failed to %s lock a session (%s).", func, name, strerror(ret));
         return -1;
     }
 
     return 1;
 }
 
-int
-nc_session_io_unlock(struct nc_session *session, const char *func)
+/**
+ * @brief Unlock a lock of a session.
+ *
+ * @param[in] session Session of the lock.
+ * @param[in] lock Lock to unlock.
+ * @param[in] func Caller function for logging.
+ * @param[in] name Name of the lock for logging.
+ * @return 1 on success, -1 on error.
+ */
+static int
+nc_session_mutex_unlock(struct nc_session *session, pthread_mutex_t *lock, const char *func, const char *name)
 {
     int ret;
 
-    ret = pthread_mutex_unlock(session->io_lock);
+    ret = pthread_mutex_unlock(lock);
     if (ret) {
         /* error */
-        ERR(session, "%s: failed to IO unlock a session (%s).", func, strerror(ret));
+        ERR(session, "%s: failed to %s unlock a session (%s).", func, name, strerror(ret));
         return -1;
     }
 
     return 1;
 }
 
+int
+nc_session_io_lock(struct nc_session *session, int timeout, const char *func)
+{
+    return nc_session_mutex_lock(session, &session->io_lock, timeout, func, "IO");
+}
+
+int
+nc_session_io_unlock(struct nc_session *session, const char *func)
+{
+    return nc_session_mutex_unlock(session, &session->io_lock, func, "IO");
+}
+
+#ifdef NC_ENABLED_SSH
+
+int
+nc_session_ssh_lock_new(struct nc_session *session)
+{
+    struct nc_ssh_lock *sl;
+    int i;
+
+    sl = calloc(1, sizeof *sl);
+    if (!sl) {
+        ERRMEM;
+        return -1;
+    }
+
+    if (pipe(sl->wake)) {
+        ERR(session, "Failed to create a pipe (%s).", strerror(errno));
+        free(sl);
+        return -1;
+    }
+    for (i = 0; i < 2; ++i) {
+        if ((fcntl(sl->wake[i], F_SETFL, O_NONBLOCK) == -1) || (fcntl(sl->wake[i], F_SETFD, FD_CLOEXEC) == -1)) {
+            ERR(session, "fcntl failed (%s).", strerror(errno));
+            close(sl->wake[0]);
+            close(sl->wake[1]);
+            free(sl);
+            return -1;
+        }
+    }
+
+    pthread_mutex_init(&sl->lock, NULL);
+    pthread_cond_init(&sl->cond, NULL);
+    session->ti.libssh.ssh_lock = sl;
+
+    return 0;
+}
+
+void
+nc_session_ssh_lock_free(struct nc_session *session)
+{
+    struct nc_ssh_lock *sl = session->ti.libssh.ssh_lock;
+
+    if (!sl) {
+        return;
+    }
+
+    close(sl->wake[0]);
+    close(sl->wake[1]);
+    pthread_cond_destroy(&sl->cond);
+    pthread_mutex_destroy(&sl->lock);
+    free(sl);
+    session->ti.libssh.ssh_lock = NULL;
+}
+
+int
+nc_session_ssh_lock(struct nc_session *session, int timeout, const char *func)
+{
+    return nc_session_mutex_lock(session, &session->ti.libssh.ssh_lock->lock, timeout, func, "SSH");
+}
+
+int
+nc_session_ssh_unlock(struct nc_session *session, const char *func)
+{
+    struct nc_ssh_lock *sl = session->ti.libssh.ssh_lock;
+    int ret;
+
+    if (sl->polling && !sl->woken && !pthread_equal(sl->poll_thread, pthread_self())) {
+        /* the socket may have been read, the thread waiting on it must check its channel */
+        if (write(sl->wake[1], "", 1) == 1) {
+            sl->woken = 1;
+        }
+    }
+
+    ret = nc_session_mutex_unlock(session, &sl->lock, func, "SSH");
+
+    /* the threads waiting for channel data must check their channels */
+    pthread_cond_broadcast(&sl->cond);
+
+    return ret;
+}
+
+#endif /* NC_ENABLED_SSH */
+
 int
 nc_session_client_msgs_lock(struct nc_session *session, int *timeout, const char *func)
 {
@@ -638,6 +760,99 @@ nc_session_get_data(const struct nc_session *session)
     return session->data;
 }
 
+API int
+nc_session_get_stats(const struct nc_session *session, struct nc_session_stats *stats)
+{
+    if (!session) {
+        ERRARG("session");
+        return -1;
+    } else if (!stats) {
+        ERRARG("stats");
+        return -1;
+    }
+
+    stats->in_rpcs = ATOMIC_LOAD_RELAXED(session->stats.in_rpcs);
+    stats->in_bad_rpcs = ATOMIC_LOAD_RELAXED(session->stats.in_bad_rpcs);
+    stats->out_rpc_errors = ATOMIC_LOAD_RELAXED(session->stats.out_rpc_errors);
+    stats->out_notifications = ATOMIC_LOAD_RELAXED(session->stats.out_notifications);
+    stats->in_bytes = ATOMIC_LOAD_RELAXED(session->stats.in_bytes);
+    stats->out_bytes = ATOMIC_LOAD_RELAXED(session->stats.out_bytes);
+    return 0;
+}
+
+#ifdef NC_ENABLED_TLS
+
+void
+nc_tls_ktls_enable(SSL *tls)
+{
+#ifdef SSL_OP_ENABLE_KTLS
+    /* OpenSSL switches the records to the kernel after the handshake only if the kernel supports the cipher */
+    SSL_set_options(tls, SSL_OP_ENABLE_KTLS);
+#else
+    (void)tls;
+#endif
+}
+
+int
+nc_tls_ktls_get(SSL *tls)
+{
+    int ktls = NC_TLS_KTLS_NONE;
+
+#ifdef SSL_OP_ENABLE_KTLS
+    if (BIO_get_ktls_send(SSL_get_wbio(tls))) {
+        ktls |= NC_TLS_KTLS_SEND;
+    }
+    if (BIO_get_ktls_recv(SSL_get_rbio(tls))) {
+        ktls |= NC_TLS_KTLS_RECV;
+    }
+#else
+    (void)tls;
+#endif
+
+    return ktls;
+}
+
+void
+nc_tls_ktls_print(const struct nc_session *session, SSL *tls)
+{
+    int ktls;
+
+#ifdef SSL_OP_ENABLE_KTLS
+    if (!(SSL_get_options(tls) & SSL_OP_ENABLE_KTLS)) {
+        /* not requested */
+        return;
+    }
+#else
+    return;
+#endif
+
+    ktls = nc_tls_ktls_get(tls);
+    if (ktls == (NC_TLS_KTLS_SEND | NC_TLS_KTLS_RECV)) {
+        VRB(session, "Kernel TLS offload active.");
+    } else if (ktls) {
+        VRB(session, "Kernel TLS offload active only for %s.", (ktls & NC_TLS_KTLS_SEND) ? "sending" : "receiving");
+    } else {
+        VRB(session, "Kernel TLS offload not supported for cipher %s, using OpenSSL.", SSL_get_cipher_name(tls));
+    }
+}
+
+API int
+nc_session_get_ktls(const struct nc_session *session)
+{
+    if (!session) {
+        ERRARG("session");
+        return -1;
+    }
+
+    if ((session->ti_type != NC_TI_OPENSSL) || !session->ti.tls) {
+        return NC_TLS_KTLS_NONE;
+    }
+
+    return nc_tls_ktls_get(session->ti.tls);
+}
+
+#endif /* NC_ENABLED_TLS */
+
 NC_MSG_TYPE
 nc_send_msg_io(struct nc_session *session, int io_timeout, struct lyd_node *op)
 {
@@ -737,20 +952,27 @@ nc_session_free_transport(struct nc_session *session, int *multisession)
         (void)siter;
         break;
 
+    case NC_TI_MEM:
+        nc_mem_pipe_release(session->ti.mem.pipe);
+        (void)connected;
+        (void)siter;
+        break;
+
 #ifdef NC_ENABLED_SSH
     case NC_TI_LIBSSH: {
         int r;
 
-        if (connected) {
-            ssh_channel_send_eof(session->ti.libssh.channel);
-            ssh_channel_free(session->ti.libssh.channel);
-        }
         /* There can be multiple NETCONF sessions on the same SSH session (NETCONF session maps to
          * SSH channel). So destroy the SSH session only if there is no other NETCONF session using
          * it. Also, avoid concurrent free by multiple threads of sessions that share the SSH session.
          */
-        /* SESSION IO LOCK */
-        r = nc_session_io_lock(session, NC_SESSION_FREE_LOCK_TIMEOUT, __func__);
+        /* SSH LOCK */
+        r = nc_session_ssh_lock(session, NC_SESSION_FREE_LOCK_TIMEOUT, __func__);
+
+        if (connected) {
+            ssh_channel_send_eof(session->ti.libssh.channel);
+            ssh_channel_free(session->ti.libssh.channel);
+        }
 
         if (session->ti.libssh.next) {
             for (siter = session->ti.libssh.next; siter != session; siter = siter->ti.libssh.next) {
@@ -771,8 +993,11 @@ nc_session_free_transport(struct nc_session *session, int *multisession)
                     /* free starting SSH NETCONF session (channel will be freed in ssh_free()) */
                     free(siter->username);
                     free(siter->host);
+                    pthread_mutex_destroy(&siter->io_lock);
                     if (!(siter->flags & NC_SESSION_SHAREDCTX)) {
                         ly_ctx_destroy((struct ly_ctx *)siter->ctx);
+                    } else if ((siter->side == NC_CLIENT) && (siter->flags & NC_SESSION_CLIENT_POOLCTX)) {
+                        nc_client_ctx_pool_release(siter->ctx);
                     }
 
                     free(siter);
@@ -815,9 +1040,19 @@ nc_session_free_transport(struct nc_session *session, int *multisession)
             }
         }
 
-        /* SESSION IO UNLOCK */
+        /* SSH UNLOCK */
         if (r == 1) {
-            nc_session_io_unlock(session, __func__);
+            nc_session_ssh_unlock(session, __func__);
+        }
+
+        if (!*multisession) {
+            /* the last NETCONF session on the SSH session, the lock may be destroyed only once no one holds it */
+            if ((r == 1) || (nc_session_ssh_lock(session, -1, __func__) == 1)) {
+                if (r != 1) {
+                    nc_session_ssh_unlock(session, __func__);
+                }
+                nc_session_ssh_lock_free(session);
+            }
         }
         break;
     }
@@ -848,10 +1083,35 @@ nc_session_free_transport(struct nc_session *session, int *multisession)
     }
 }
 
+int
+nc_session_ti_fd(const struct nc_session *session)
+{
+    switch (session->ti_type) {
+    case NC_TI_FD:
+        return session->ti.fd.in;
+    case NC_TI_UNIX:
+        return session->ti.unixsock.sock;
+    case NC_TI_MEM:
+        return NC_MEM_RX(session)->bell[0];
+#ifdef NC_ENABLED_SSH
+    case NC_TI_LIBSSH:
+        return ssh_get_fd(session->ti.libssh.session);
+#endif
+#ifdef NC_ENABLED_TLS
+    case NC_TI_OPENSSL:
+        return SSL_get_rfd(session->ti.tls);
+#endif
+    case NC_TI_NONE:
+        break;
+    }
+
+    return -1;
+}
+
 API void
 nc_session_free(struct nc_session *session, void (*data_free)(void *))
 {
-    int r, i, rpc_locked = 0, msgs_locked = 0, timeout;
+    int r, rpc_locked = 0, msgs_locked = 0, timeout;
     int multisession = 0; /* flag for more NETCONF sessions on a single SSH session */
     struct nc_msg_cont *contiter;
     struct ly_in *msg;
@@ -866,6 +1126,7 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
     if ((session->side == NC_CLIENT) && ATOMIC_LOAD_RELAXED(session->opts.client.ntf_thread_running)) {
         /* let the threads know they should quit */
         ATOMIC_STORE_RELAXED(session->opts.client.ntf_thread_running, 0);
+        nc_client_notif_reactor_del(session);
 
         /* wait for them */
         nc_gettimespec_mono_add(&ts, NC_SESSION_FREE_LOCK_TIMEOUT);
@@ -878,6 +1139,12 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
         }
     }
 
+    if ((session->side == NC_SERVER) && (session->flags & NC_SESSION_SERVER_COUNTED) &&
+            (session->term_reason != NC_SESSION_TERM_CLOSED) && (session->term_reason != NC_SESSION_TERM_KILLED)) {
+        /* not terminated by <close-session> nor <kill-session> */
+        ATOMIC_INC_RELAXED(server_opts.stats.dropped_sessions);
+    }
+
     if (session->side == NC_SERVER) {
         r = nc_session_rpc_lock(session, NC_SESSION_FREE_LOCK_TIMEOUT, __func__);
         if (r == -1) {
@@ -890,6 +1157,17 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
         }
     }
 
+    if ((session->side == NC_SERVER) && session->obuf_len && (session->status == NC_STATUS_RUNNING)) {
+        /* SESSION IO LOCK */
+        if (nc_session_io_lock(session, NC_SESSION_FREE_LOCK_TIMEOUT, __func__) == 1) {
+            /* write the queued messages, the last reply among them */
+            nc_session_out_queue_flush(session, 1);
+
+            /* SESSION IO UNLOCK */
+            nc_session_io_unlock(session, __func__);
+        }
+    }
+
     if (session->side == NC_CLIENT) {
         timeout = NC_SESSION_FREE_LOCK_TIMEOUT;
 
@@ -918,6 +1196,9 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
             nc_session_client_msgs_unlock(session, __func__);
         }
 
+        /* RPCs still waiting for their reply */
+        nc_client_rpc_pending_free(session);
+
         if (session->status == NC_STATUS_RUNNING) {
             /* receive any leftover messages */
             while (nc_read_msg_poll_io(session, 0, &msg) == 1) {
@@ -930,10 +1211,7 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
 
         /* list of server's capabilities */
         if (session->opts.client.cpblts) {
-            for (i = 0; session->opts.client.cpblts[i]; i++) {
-                free(session->opts.client.cpblts[i]);
-            }
-            free(session->opts.client.cpblts);
+            nc_client_cpblts_release(session->opts.client.cpblts);
         }
 
         /* LY ext data */
@@ -961,33 +1239,15 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
         data_free(session->data);
     }
 
-    if ((session->side == NC_SERVER) && (session->flags & NC_SESSION_CALLHOME)) {
-        /* CH LOCK */
-        pthread_mutex_lock(&session->opts.server.ch_lock);
-    }
-
     /* mark session for closing */
     session->status = NC_STATUS_CLOSING;
 
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
     if ((session->side == NC_SERVER) && (session->flags & NC_SESSION_CH_THREAD)) {
-        pthread_cond_signal(&session->opts.server.ch_cond);
-
-        nc_gettimespec_real_add(&ts, NC_SESSION_FREE_LOCK_TIMEOUT);
-
-        /* wait for CH thread to actually wake up and terminate */
-        r = 0;
-        while (!r && (session->flags & NC_SESSION_CH_THREAD)) {
-            r = pthread_cond_timedwait(&session->opts.server.ch_cond, &session->opts.server.ch_lock, &ts);
-        }
-        if (r) {
-            ERR(session, "Waiting for Call Home thread failed (%s).", strerror(r));
-        }
-    }
-
-    if ((session->side == NC_SERVER) && (session->flags & NC_SESSION_CALLHOME)) {
-        /* CH UNLOCK */
-        pthread_mutex_unlock(&session->opts.server.ch_lock);
+        /* the Call Home client is reconnected by the scheduler */
+        nc_ch_sched_session_free(session);
     }
+#endif
 
     /* transport implementation cleanup */
     nc_session_free_transport(session, &multisession);
@@ -996,9 +1256,17 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
     free(session->username);
     free(session->host);
     free(session->path);
+    free(session->rbuf);
+    free(session->wbuf);
+    free(session->obuf);
+    free(session->mbuf);
 
     if (session->side == NC_SERVER) {
-        pthread_mutex_destroy(&session->opts.server.ntf_status_lock);
+        free(session->opts.server.trace);
+        if (session->opts.server.handshake) {
+            free(session->opts.server.handshake->endpt_name);
+            free(session->opts.server.handshake);
+        }
         if (rpc_locked) {
             nc_session_rpc_unlock(session, NC_SESSION_LOCK_TIMEOUT, __func__);
         }
@@ -1006,20 +1274,15 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
         pthread_cond_destroy(&session->opts.server.rpc_cond);
     }
 
-    if (session->io_lock && !multisession) {
-        pthread_mutex_destroy(session->io_lock);
-        free(session->io_lock);
-    }
+    pthread_mutex_destroy(&session->io_lock);
 
     if (!(session->flags & NC_SESSION_SHAREDCTX)) {
         ly_ctx_destroy((struct ly_ctx *)session->ctx);
+    } else if ((session->side == NC_CLIENT) && (session->flags & NC_SESSION_CLIENT_POOLCTX)) {
+        nc_client_ctx_pool_release(session->ctx);
     }
 
-    if (session->side == NC_SERVER) {
-        /* free CH synchronization structures */
-        pthread_cond_destroy(&session->opts.server.ch_cond);
-        pthread_mutex_destroy(&session->opts.server.ch_lock);
-    } else {
+    if (session->side == NC_CLIENT) {
         pthread_mutex_destroy(&session->opts.client.msgs_lock);
     }
 
@@ -1287,6 +1550,111 @@ nc_server_get_cpblts(const struct ly_ctx *ctx)
     return nc_server_get_cpblts_version(ctx, LYS_VERSION_UNDEF);
 }
 
+/**
+ * @brief Release a reference of cached server capabilities. Capabilities lock is expected to be held.
+ *
+ * @param[in] cache Cached capabilities, freed with the last reference.
+ */
+static void
+nc_server_cpblts_unref(struct nc_server_cpblts *cache)
+{
+    int i;
+
+    if (--cache->refcount) {
+        return;
+    }
+
+    for (i = 0; cache->cpblts[i]; ++i) {
+        free(cache->cpblts[i]);
+    }
+    free(cache->cpblts);
+    free(cache->content_id);
+    free(cache);
+}
+
+void
+nc_server_cpblts_invalidate(const struct ly_ctx *ctx)
+{
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.cpblts_lock);
+
+    if (server_opts.cpblts_cache && (!ctx || (server_opts.cpblts_cache->ctx == ctx))) {
+        /* sessions still sending their hello keep their reference */
+        nc_server_cpblts_unref(server_opts.cpblts_cache);
+        server_opts.cpblts_cache = NULL;
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.cpblts_lock);
+}
+
+/**
+ * @brief Get the server capabilities of a context, created only once for every version of the context.
+ *
+ * @param[in] ctx Context to use.
+ * @param[in] version YANG version of the modules.
+ * @return Referenced cached capabilities, NULL on error.
+ */
+static struct nc_server_cpblts *
+nc_server_cpblts_get(const struct ly_ctx *ctx, LYS_VERSION version)
+{
+    struct nc_server_cpblts *cache;
+    char *content_id = NULL;
+    uint16_t change_count;
+
+    /* content-id may change without the context changing */
+    if (server_opts.content_id_clb) {
+        content_id = server_opts.content_id_clb(server_opts.content_id_data);
+        if (!content_id) {
+            ERRMEM;
+            return NULL;
+        }
+    }
+    change_count = ly_ctx_get_change_count(ctx);
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.cpblts_lock);
+
+    cache = server_opts.cpblts_cache;
+    if (cache && ((cache->ctx != ctx) || (cache->change_count != change_count) || (cache->version != version) ||
+            (!content_id != !cache->content_id) || (content_id && strcmp(content_id, cache->content_id)))) {
+        /* outdated */
+        nc_server_cpblts_unref(cache);
+        server_opts.cpblts_cache = NULL;
+        cache = NULL;
+    }
+
+    if (!cache) {
+        cache = calloc(1, sizeof *cache);
+        if (!cache) {
+            ERRMEM;
+            goto cleanup;
+        }
+        cache->cpblts = nc_server_get_cpblts_version(ctx, version);
+        if (!cache->cpblts) {
+            free(cache);
+            cache = NULL;
+            goto cleanup;
+        }
+        cache->refcount = 1;
+        cache->ctx = ctx;
+        cache->change_count = change_count;
+        cache->version = version;
+        cache->content_id = content_id;
+        content_id = NULL;
+
+        server_opts.cpblts_cache = cache;
+    }
+    ++cache->refcount;
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.cpblts_lock);
+
+    free(content_id);
+    return cache;
+}
+
 static int
 parse_cpblts(struct lyd_node *capabilities, char ***list)
 {
@@ -1356,6 +1724,7 @@ nc_send_hello_io(struct nc_session *session)
     NC_MSG_TYPE ret;
     int i, io_timeout;
     char **cpblts;
+    struct nc_server_cpblts *cache = NULL;
     uint32_t *sid;
 
     if (session->side == NC_CLIENT) {
@@ -1372,10 +1741,12 @@ nc_send_hello_io(struct nc_session *session)
         io_timeout = NC_CLIENT_HELLO_TIMEOUT * 1000;
         sid = NULL;
     } else {
-        cpblts = nc_server_get_cpblts_version(session->ctx, LYS_VERSION_1_0);
-        if (!cpblts) {
+        /* shared by all the sessions of the context */
+        cache = nc_server_cpblts_get(session->ctx, LYS_VERSION_1_0);
+        if (!cache) {
             return NC_MSG_ERROR;
         }
+        cpblts = cache->cpblts;
 
         io_timeout = NC_SERVER_HELLO_TIMEOUT * 1000;
         sid = &session->id;
@@ -1383,10 +1754,18 @@ nc_send_hello_io(struct nc_session *session)
 
     ret = nc_write_msg_io(session, io_timeout, NC_MSG_HELLO, cpblts, sid);
 
-    for (i = 0; cpblts[i]; ++i) {
-        free(cpblts[i]);
+    if (cache) {
+        /* LOCK */
+        pthread_mutex_lock(&server_opts.cpblts_lock);
+        nc_server_cpblts_unref(cache);
+        /* UNLOCK */
+        pthread_mutex_unlock(&server_opts.cpblts_lock);
+    } else {
+        for (i = 0; cpblts[i]; ++i) {
+            free(cpblts[i]);
+        }
+        free(cpblts);
     }
-    free(cpblts);
 
     return ret;
 }
@@ -1397,8 +1776,8 @@ nc_recv_client_hello_io(struct nc_session *session)
     struct ly_in *msg;
     struct lyd_node *hello = NULL, *iter;
     struct lyd_node_opaq *node;
-    int r, ver = -1, flag = 0;
-    char *str;
+    int r, i, ver = -1, flag = 0;
+    char *str, **cpblts = NULL;
     long long int id;
     NC_MSG_TYPE rc = NC_MSG_HELLO;
 
@@ -1446,7 +1825,21 @@ nc_recv_client_hello_io(struct nc_session *session)
             }
             flag = 1;
 
-            if ((ver = parse_cpblts(&node->node, &session->opts.client.cpblts)) < 0) {
+            ver = parse_cpblts(&node->node, &cpblts);
+            if (ver < 0) {
+                if (cpblts) {
+                    for (i = 0; cpblts[i]; ++i) {
+                        free(cpblts[i]);
+                    }
+                    free(cpblts);
+                }
+                rc = NC_MSG_ERROR;
+                goto cleanup;
+            }
+
+            /* share the capabilities with the other sessions */
+            session->opts.client.cpblts = nc_client_cpblts_get(cpblts);
+            if (!session->opts.client.cpblts) {
                 rc = NC_MSG_ERROR;
                 goto cleanup;
             }
@@ -1475,15 +1868,14 @@ cleanup:
 }
 
 static NC_MSG_TYPE
-nc_recv_server_hello_io(struct nc_session *session)
+nc_recv_server_hello_io(struct nc_session *session, int timeout_io)
 {
-    struct ly_in *msg;
+    struct ly_in *msg = NULL;
     struct lyd_node *hello = NULL, *iter;
     struct lyd_node_opaq *node;
     NC_MSG_TYPE rc = NC_MSG_HELLO;
-    int r, ver = -1, flag = 0, timeout_io;
+    int r, ver = -1, flag = 0;
 
-    timeout_io = server_opts.hello_timeout ? server_opts.hello_timeout * 1000 : NC_SERVER_HELLO_TIMEOUT * 1000;
     r = nc_read_msg_poll_io(session, timeout_io, &msg);
     switch (r) {
     case 1:
@@ -1522,7 +1914,9 @@ nc_recv_server_hello_io(struct nc_session *session)
         }
         break;
     case 0:
-        ERR(session, "Client <hello> timeout elapsed.");
+        if (timeout_io) {
+            ERR(session, "Client <hello> timeout elapsed.");
+        }
         rc = NC_MSG_WOULDBLOCK;
         break;
     default:
@@ -1536,6 +1930,28 @@ cleanup:
     return rc;
 }
 
+NC_MSG_TYPE
+nc_handshake_send_io(struct nc_session *session)
+{
+    return nc_send_hello_io(session);
+}
+
+NC_MSG_TYPE
+nc_handshake_recv_io(struct nc_session *session, int timeout)
+{
+    NC_MSG_TYPE type;
+
+    type = nc_recv_server_hello_io(session, timeout);
+    if (type == NC_MSG_HELLO) {
+        session->flags |= NC_SESSION_SERVER_COUNTED;
+        ATOMIC_INC_RELAXED(server_opts.stats.in_sessions);
+    } else if (type == NC_MSG_BAD_HELLO) {
+        ATOMIC_INC_RELAXED(server_opts.stats.in_bad_hellos);
+    }
+
+    return type;
+}
+
 NC_MSG_TYPE
 nc_handshake_io(struct nc_session *session)
 {
@@ -1549,12 +1965,70 @@ nc_handshake_io(struct nc_session *session)
     if (session->side == NC_CLIENT) {
         type = nc_recv_client_hello_io(session);
     } else {
-        type = nc_recv_server_hello_io(session);
+        type = nc_handshake_recv_io(session, server_opts.hello_timeout ?
+                server_opts.hello_timeout * 1000 : NC_SERVER_HELLO_TIMEOUT * 1000);
     }
 
     return type;
 }
 
+size_t
+nc_server_hello_len(const struct ly_ctx *ctx, uint32_t sid)
+{
+    struct nc_server_cpblts *cache;
+    const char *ptr;
+    size_t len;
+    int i;
+
+    cache = nc_server_cpblts_get(ctx, LYS_VERSION_1_0);
+    if (!cache) {
+        return 0;
+    }
+
+    /* the same message nc_write_msg_io() prints, with escaped capabilities and the NETCONF 1.0 end tag */
+    len = snprintf(NULL, 0, "<hello xmlns=\"%s\"><capabilities>", NC_NS_BASE);
+    for (i = 0; cache->cpblts[i]; ++i) {
+        len += 12 + 13;
+        for (ptr = cache->cpblts[i]; *ptr; ++ptr) {
+            len += (*ptr == '&') ? 5 : ((*ptr == '<') || (*ptr == '>')) ? 4 : 1;
+        }
+    }
+    len += snprintf(NULL, 0, "</capabilities><session-id>%u</session-id></hello>", sid);
+    len += NC_VERSION_10_ENDTAG_LEN;
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.cpblts_lock);
+    nc_server_cpblts_unref(cache);
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.cpblts_lock);
+
+    return len;
+}
+
+NC_MSG_TYPE
+nc_handshake_mem_io(struct nc_session *server, struct nc_session *client)
+{
+    NC_MSG_TYPE type;
+
+    /* both hellos must be sent before the peer ones are received, the rings were made large enough for them */
+    type = nc_send_hello_io(server);
+    if (type != NC_MSG_HELLO) {
+        return type;
+    }
+    type = nc_send_hello_io(client);
+    if (type != NC_MSG_HELLO) {
+        return type;
+    }
+
+    type = nc_handshake_recv_io(server, server_opts.hello_timeout ?
+            server_opts.hello_timeout * 1000 : NC_SERVER_HELLO_TIMEOUT * 1000);
+    if (type != NC_MSG_HELLO) {
+        return type;
+    }
+
+    return nc_recv_client_hello_io(client);
+}
+
 #ifdef NC_ENABLED_SSH
 
 static void
@@ -50,6 +50,15 @@ typedef enum {
     NC_TLS_CTN_COMMON_NAME      /**< common name as username */
 } NC_TLS_CTN_MAPTYPE;
 
+/**
+ * @brief Enumeration of kernel TLS offload directions, used as a bitmask.
+ */
+typedef enum {
+    NC_TLS_KTLS_NONE = 0x00,    /**< all the records are processed by OpenSSL in user space */
+    NC_TLS_KTLS_SEND = 0x01,    /**< sent records are encrypted by the kernel */
+    NC_TLS_KTLS_RECV = 0x02     /**< received records are decrypted by the kernel */
+} NC_TLS_KTLS;
+
 #endif /* NC_ENABLED_TLS */
 
 /**
@@ -75,8 +84,10 @@ typedef enum {
     NC_TI_LIBSSH,     /**< libssh - use libssh library, only for NETCONF over SSH transport */
 #endif
 #ifdef NC_ENABLED_TLS
-    NC_TI_OPENSSL     /**< OpenSSL - use OpenSSL library, only for NETCONF over TLS transport */
+    NC_TI_OPENSSL,    /**< OpenSSL - use OpenSSL library, only for NETCONF over TLS transport */
 #endif
+    NC_TI_MEM         /**< in-memory ring buffers - client and server sessions in the same process,
+                           see nc_accept_mem() */
 } NC_TRANSPORT_IMPL;
 
 /**
@@ -112,6 +123,18 @@ typedef enum {
  */
 struct nc_session;
 
+/**
+ * @brief Statistics of a NETCONF session, see ietf-netconf-monitoring for the meaning of the counters.
+ */
+struct nc_session_stats {
+    uint32_t in_rpcs;               /**< correct \<rpc\> messages received (server side only) */
+    uint32_t in_bad_rpcs;           /**< messages received that were not correct \<rpc\> messages (server side only) */
+    uint32_t out_rpc_errors;        /**< \<rpc-reply\> messages with \<rpc-error\> sent (server side only) */
+    uint32_t out_notifications;     /**< \<notification\> messages sent (server side only) */
+    uint64_t in_bytes;              /**< bytes read from the transport */
+    uint64_t out_bytes;             /**< bytes written into the transport */
+};
+
 /**
  * @brief Get session status.
  *
@@ -216,6 +239,32 @@ void nc_session_set_data(struct nc_session *session, void *data);
  */
 void *nc_session_get_data(const struct nc_session *session);
 
+/**
+ * @brief Get the statistics of a session.
+ *
+ * The counters are updated without locking so they can be read any time, even while the session
+ * is being communicated on.
+ *
+ * @param[in] session Session to get the statistics of.
+ * @param[out] stats Current statistics.
+ * @return 0 on success, -1 on error.
+ */
+int nc_session_get_stats(const struct nc_session *session, struct nc_session_stats *stats);
+
+#ifdef NC_ENABLED_TLS
+
+/**
+ * @brief Get the kernel TLS offload used by a session, see nc_server_tls_endpt_set_ktls()
+ * and nc_client_tls_set_ktls().
+ *
+ * @param[in] session Session to get the information from.
+ * @return Bitmask of ::NC_TLS_KTLS values, always ::NC_TLS_KTLS_NONE for other than TLS sessions.
+ * @return -1 on error.
+ */
+int nc_session_get_ktls(const struct nc_session *session);
+
+#endif /* NC_ENABLED_TLS */
+
 /**
  * @brief Free the NETCONF session object.
  *
@@ -46,6 +46,11 @@
 #include "messages_client.h"
 #include "session_client.h"
 
+#ifdef HAVE_EPOLL
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+#endif
+
 #include "../modules/ietf_netconf@2013-09-29_yang.h"
 #include "../modules/ietf_netconf_monitoring@2010-10-04_yang.h"
 
@@ -60,6 +65,22 @@ char *sshauth_privkey_passphrase(const char *privkey_path, void *priv);
 
 static pthread_once_t nc_client_context_once = PTHREAD_ONCE_INIT;
 static pthread_key_t nc_client_context_key;
+
+/* ACCESS locked with ctx_pool_lock, shared by all the threads */
+static struct nc_client_ctx_pool_item {
+    char *key;                   /**< serialized server module information */
+    struct ly_ctx *ctx;          /**< shared context */
+    uint32_t refcount;           /**< number of sessions using the context */
+    int not_strict;              /**< whether some server modules failed to be loaded into the context */
+    uint64_t released;           /**< ctx_pool_tick when the context was last left unused */
+} *ctx_pool;
+static uint32_t ctx_pool_count;
+static uint64_t ctx_pool_tick;
+static pthread_mutex_t ctx_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ACCESS locked with cpblts_lock, shared by all the threads */
+static struct nc_client_cpblts *cpblts_sets;
+static pthread_mutex_t cpblts_lock = PTHREAD_MUTEX_INITIALIZER;
 #ifdef __linux__
 static struct nc_client_context context_main = {
     .opts.ka = {
@@ -109,6 +130,7 @@ nc_client_context_free(void *ptr)
     {
         /* for the main thread the same is done in nc_client_destroy() */
         free(c->opts.schema_searchpath);
+        free(c->opts.schema_cache_dir);
 
 #if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
         int i;
@@ -298,6 +320,202 @@ nc_client_get_schema_searchpath(void)
     return client_opts.schema_searchpath;
 }
 
+API int
+nc_client_set_schema_cache_dir(const char *path)
+{
+    free(client_opts.schema_cache_dir);
+
+    if (path) {
+        client_opts.schema_cache_dir = strdup(path);
+        if (!client_opts.schema_cache_dir) {
+            ERRMEM;
+            return 1;
+        }
+    } else {
+        client_opts.schema_cache_dir = NULL;
+    }
+
+    return 0;
+}
+
+API const char *
+nc_client_get_schema_cache_dir(void)
+{
+    return client_opts.schema_cache_dir;
+}
+
+API int
+nc_client_set_ctx_pool(int enabled)
+{
+    client_opts.ctx_pool = enabled ? 1 : 0;
+    return 0;
+}
+
+API int
+nc_client_get_ctx_pool(void)
+{
+    return client_opts.ctx_pool;
+}
+
+/**
+ * @brief Get a referenced context from the client context pool.
+ *
+ * @param[in] key Serialized server module information.
+ * @param[out] not_strict Whether some server modules failed to be loaded into the context.
+ * @return Shared context, NULL if there is none.
+ */
+static struct ly_ctx *
+nc_client_ctx_pool_get(const char *key, int *not_strict)
+{
+    struct ly_ctx *ctx = NULL;
+    uint32_t i;
+
+    /* LOCK */
+    pthread_mutex_lock(&ctx_pool_lock);
+
+    for (i = 0; i < ctx_pool_count; ++i) {
+        if (!strcmp(ctx_pool[i].key, key)) {
+            ++ctx_pool[i].refcount;
+            ctx = ctx_pool[i].ctx;
+            *not_strict = ctx_pool[i].not_strict;
+            break;
+        }
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&ctx_pool_lock);
+
+    return ctx;
+}
+
+/**
+ * @brief Add a fully created context into the client context pool, referenced once.
+ *
+ * @param[in] key Serialized server module information, spent on success.
+ * @param[in] ctx Context to share.
+ * @param[in] not_strict Whether some server modules failed to be loaded into the context.
+ * @return 0 on success, -1 if a context with the same key exists already or on error.
+ */
+static int
+nc_client_ctx_pool_add(char *key, struct ly_ctx *ctx, int not_strict)
+{
+    struct nc_client_ctx_pool_item *new_pool;
+    uint32_t i;
+    int ret = -1;
+
+    /* LOCK */
+    pthread_mutex_lock(&ctx_pool_lock);
+
+    for (i = 0; i < ctx_pool_count; ++i) {
+        if (!strcmp(ctx_pool[i].key, key)) {
+            /* another session created the same context meanwhile */
+            goto cleanup;
+        }
+    }
+
+    new_pool = realloc(ctx_pool, (ctx_pool_count + 1) * sizeof *ctx_pool);
+    if (!new_pool) {
+        ERRMEM;
+        goto cleanup;
+    }
+    ctx_pool = new_pool;
+    ctx_pool[ctx_pool_count].key = key;
+    ctx_pool[ctx_pool_count].ctx = ctx;
+    ctx_pool[ctx_pool_count].refcount = 1;
+    ctx_pool[ctx_pool_count].not_strict = not_strict;
+    ++ctx_pool_count;
+    ret = 0;
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&ctx_pool_lock);
+    return ret;
+}
+
+void
+nc_client_ctx_pool_release(const struct ly_ctx *ctx)
+{
+    struct ly_ctx *evicted = NULL;
+    char *evicted_key = NULL;
+    uint32_t i, idle = 0, lru = 0;
+
+    /* LOCK */
+    pthread_mutex_lock(&ctx_pool_lock);
+
+    for (i = 0; i < ctx_pool_count; ++i) {
+        if (ctx_pool[i].ctx == ctx) {
+            /* the context is kept for any future sessions */
+            assert(ctx_pool[i].refcount);
+            if (!--ctx_pool[i].refcount) {
+                ctx_pool[i].released = ++ctx_pool_tick;
+            }
+            break;
+        }
+    }
+
+    /* find the least recently used of the unused contexts */
+    for (i = 0; i < ctx_pool_count; ++i) {
+        if (ctx_pool[i].refcount) {
+            continue;
+        }
+        if (!idle++ || (ctx_pool[i].released < ctx_pool[lru].released)) {
+            lru = i;
+        }
+    }
+
+    if (idle > NC_CLIENT_CTX_POOL_IDLE_MAX) {
+        /* too many unused contexts, evict it */
+        evicted = ctx_pool[lru].ctx;
+        evicted_key = ctx_pool[lru].key;
+        --ctx_pool_count;
+        if (lru < ctx_pool_count) {
+            ctx_pool[lru] = ctx_pool[ctx_pool_count];
+        }
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&ctx_pool_lock);
+
+    if (evicted) {
+        /* no session uses it so it can be destroyed without the lock */
+        free(evicted_key);
+        ly_ctx_destroy(evicted);
+    }
+}
+
+/**
+ * @brief Destroy all the contexts in the client context pool not used by any session.
+ */
+static void
+nc_client_ctx_pool_clear(void)
+{
+    uint32_t i = 0;
+
+    /* LOCK */
+    pthread_mutex_lock(&ctx_pool_lock);
+
+    while (i < ctx_pool_count) {
+        if (ctx_pool[i].refcount) {
+            ++i;
+            continue;
+        }
+
+        free(ctx_pool[i].key);
+        ly_ctx_destroy(ctx_pool[i].ctx);
+        --ctx_pool_count;
+        if (i < ctx_pool_count) {
+            ctx_pool[i] = ctx_pool[ctx_pool_count];
+        }
+    }
+    if (!ctx_pool_count) {
+        free(ctx_pool);
+        ctx_pool = NULL;
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&ctx_pool_lock);
+}
+
 API int
 nc_client_set_schema_callback(ly_module_imp_clb clb, void *user_data)
 {
@@ -323,10 +541,12 @@ nc_client_get_schema_callback(void **user_data)
 struct module_info {
     char *name;
     char *revision;
+    char *data;                     /**< module retrieved in advance via <get-schema>, if any */
 
     struct {
         char *name;
         char *revision;
+        char *data;                 /**< submodule retrieved in advance via <get-schema>, if any */
     } *submodules;
     char **features;
     int implemented;
@@ -340,6 +560,51 @@ struct clb_data_s {
     int has_get_schema;
 };
 
+/**
+ * @brief Read YANG module content from a file.
+ *
+ * @param[in] session NC session.
+ * @param[in] path Path of the file.
+ * @return Module content.
+ */
+static char *
+retrieve_module_data_file(struct nc_session *session, const char *path)
+{
+    FILE *f;
+    long length, l;
+    char *model_data = NULL;
+
+    f = fopen(path, "r");
+    if (!f) {
+        ERR(session, "Unable to open file \"%s\" (%s).", path, strerror(errno));
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    length = ftell(f);
+    if (length < 0) {
+        ERR(session, "Unable to get the size of module file \"%s\".", path);
+        fclose(f);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_SET);
+
+    model_data = malloc(length + 1);
+    if (!model_data) {
+        ERRMEM;
+    } else if ((l = fread(model_data, 1, length, f)) != length) {
+        ERR(session, "Reading module from \"%s\" failed (%d bytes read, but %d expected).", path, l, length);
+        free(model_data);
+        model_data = NULL;
+    } else {
+        /* terminating NULL byte */
+        model_data[length] = '\0';
+    }
+    fclose(f);
+
+    return model_data;
+}
+
 /**
  * @brief Retrieve YANG module content from a local file.
  *
@@ -354,8 +619,6 @@ retrieve_module_data_localfile(const char *name, const char *rev, struct clb_dat
         LYS_INFORMAT *format)
 {
     char *localfile = NULL;
-    FILE *f;
-    long length, l;
     char *model_data = NULL;
 
     if (lys_search_localfile(ly_ctx_get_searchdirs(clb_data->session->ctx),
@@ -366,44 +629,96 @@ retrieve_module_data_localfile(const char *name, const char *rev, struct clb_dat
     if (localfile) {
         VRB(clb_data->session, "Reading module \"%s@%s\" from local file \"%s\".", name, rev ? rev : "<latest>",
                 localfile);
-        f = fopen(localfile, "r");
-        if (!f) {
-            ERR(clb_data->session, "Unable to open file \"%s\" (%s).", localfile, strerror(errno));
-            free(localfile);
-            return NULL;
-        }
+        model_data = retrieve_module_data_file(clb_data->session, localfile);
+        free(localfile);
+    }
+
+    return model_data;
+}
+
+/**
+ * @brief Check whether a module name or revision can be used in a schema cache file name.
+ *
+ * @param[in] str Name or revision.
+ * @return Whether @p str can be used.
+ */
+static int
+schema_cache_name_valid(const char *str)
+{
+    return str[0] && !strchr(str, '/') && !strstr(str, "..");
+}
+
+/**
+ * @brief Get the path of a YANG module in the schema cache directory.
+ *
+ * Modules with a revision are identified by their name and revision, any other modules only in combination
+ * with the whole content-id of the server YANG library. Any characters of the content-id not safe to be used
+ * in a file name are percent-encoded.
+ *
+ * @param[in] name Module name.
+ * @param[in] rev Module revision.
+ * @param[in] session NC session.
+ * @return Path of the module in the cache, NULL if the module cannot be cached.
+ */
+static char *
+schema_cache_path(const char *name, const char *rev, struct nc_session *session)
+{
+    const char *cpblt, *content_id = NULL;
+    char *path = NULL, *id;
+    int len, i, r;
 
-        fseek(f, 0, SEEK_END);
-        length = ftell(f);
-        if (length < 0) {
-            ERR(clb_data->session, "Unable to get the size of module file \"%s\".", localfile);
-            free(localfile);
-            fclose(f);
+    if (!client_opts.schema_cache_dir || !schema_cache_name_valid(name) ||
+            (rev && rev[0] && !schema_cache_name_valid(rev))) {
+        /* no cache or names not safe to be used in a file name */
+        return NULL;
+    }
+
+    if (rev && rev[0]) {
+        r = asprintf(&path, "%s/%s@%s.yang", client_opts.schema_cache_dir, name, rev);
+    } else {
+        /* use the content-id (or module-set-id) as the revision */
+        cpblt = nc_session_cpblt(session, "urn:ietf:params:netconf:capability:yang-library:");
+        if (cpblt) {
+            content_id = strstr(cpblt, "content-id=");
+            if (content_id) {
+                content_id += 11;
+            } else if ((content_id = strstr(cpblt, "module-set-id="))) {
+                content_id += 14;
+            }
+        }
+        if (!content_id || !content_id[0] || (content_id[0] == '&')) {
             return NULL;
         }
-        fseek(f, 0, SEEK_SET);
 
-        model_data = malloc(length + 1);
-        if (!model_data) {
+        /* escape the whole content-id, each character may need 3 */
+        len = strcspn(content_id, "&");
+        id = malloc(len * 3 + 1);
+        if (!id) {
             ERRMEM;
-        } else if ((l = fread(model_data, 1, length, f)) != length) {
-            ERR(clb_data->session, "Reading module from \"%s\" failed (%d bytes read, but %d expected).", localfile, l,
-                    length);
-            free(model_data);
-            model_data = NULL;
-        } else {
-            /* terminating NULL byte */
-            model_data[length] = '\0';
+            return NULL;
         }
-        fclose(f);
-        free(localfile);
+        for (i = 0; len; ++content_id, --len) {
+            if (isalnum((unsigned char)*content_id) || strchr("-_", *content_id)) {
+                id[i++] = *content_id;
+            } else {
+                i += sprintf(id + i, "%%%02X", (unsigned char)*content_id);
+            }
+        }
+        id[i] = '\0';
+
+        r = asprintf(&path, "%s/%s#%s.yang", client_opts.schema_cache_dir, name, id);
+        free(id);
+    }
+    if (r == -1) {
+        ERRMEM;
+        return NULL;
     }
 
-    return model_data;
+    return path;
 }
 
 /**
- * @brief Retrieve YANG module content from a reply to get-schema RPC.
+ * @brief Retrieve YANG module content from the schema cache directory.
  *
  * @param[in] name Module name.
  * @param[in] rev Module revision.
@@ -412,50 +727,99 @@ retrieve_module_data_localfile(const char *name, const char *rev, struct clb_dat
  * @return Module content.
  */
 static char *
-retrieve_module_data_getschema(const char *name, const char *rev, struct clb_data_s *clb_data,
-        LYS_INFORMAT *format)
+retrieve_module_data_cache(const char *name, const char *rev, struct clb_data_s *clb_data, LYS_INFORMAT *format)
 {
-    struct nc_rpc *rpc;
-    struct lyd_node *envp = NULL, *op = NULL;
-    struct lyd_node_any *get_schema_data;
-    NC_MSG_TYPE msg;
-    uint64_t msgid;
-    char *localfile = NULL, *envp_str = NULL, *model_data = NULL;
-    FILE *f;
+    char *path, *model_data = NULL;
 
-    VRB(clb_data->session, "Reading module \"%s@%s\" from server via get-schema.", name, rev ? rev : "<latest>");
-    rpc = nc_rpc_getschema(name, rev, "yang", NC_PARAMTYPE_CONST);
+    path = schema_cache_path(name, rev, clb_data->session);
+    if (!path) {
+        return NULL;
+    }
 
-    while ((msg = nc_send_rpc(clb_data->session, rpc, 0, &msgid)) == NC_MSG_WOULDBLOCK) {
-        usleep(1000);
+    if (!access(path, R_OK)) {
+        VRB(clb_data->session, "Reading module \"%s@%s\" from schema cache \"%s\".", name, rev ? rev : "<latest>", path);
+        model_data = retrieve_module_data_file(clb_data->session, path);
+        if (model_data) {
+            *format = LYS_IN_YANG;
+        }
     }
-    if (msg == NC_MSG_ERROR) {
-        ERR(clb_data->session, "Failed to send the <get-schema> RPC.");
-        nc_rpc_free(rpc);
-        return NULL;
+    free(path);
+
+    return model_data;
+}
+
+/**
+ * @brief Store YANG module content retrieved via get-schema into the schema cache directory.
+ *
+ * @param[in] name Module name.
+ * @param[in] rev Module revision.
+ * @param[in] model_data Module content.
+ * @param[in] session NC session.
+ */
+static void
+store_module_data_cache(const char *name, const char *rev, const char *model_data, struct nc_session *session)
+{
+    char *path, *tmp_path = NULL;
+    int fd, r;
+    FILE *f;
+
+    path = schema_cache_path(name, rev, session);
+    if (!path) {
+        return;
     }
 
-    do {
-        msg = nc_recv_reply(clb_data->session, rpc, msgid, NC_READ_ACT_TIMEOUT * 1000, &envp, &op);
-    } while (msg == NC_MSG_NOTIF || msg == NC_MSG_REPLY_ERR_MSGID);
-    nc_rpc_free(rpc);
-    if (msg == NC_MSG_WOULDBLOCK) {
-        ERR(clb_data->session, "Timeout for receiving reply to a <get-schema> expired.");
+    /* write a temporary file and rename it so that concurrent readers never see a partial module */
+    if (asprintf(&tmp_path, "%s.XXXXXX", path) == -1) {
+        ERRMEM;
         goto cleanup;
-    } else if (msg == NC_MSG_ERROR) {
-        ERR(clb_data->session, "Failed to receive a reply to <get-schema>.");
+    }
+    fd = mkstemp(tmp_path);
+    if (fd == -1) {
+        WRN(session, "Unable to store \"%s\" into the schema cache (%s).", path, strerror(errno));
         goto cleanup;
-    } else if (!op) {
+    }
+    f = fdopen(fd, "w");
+    if (!f) {
+        close(fd);
+        unlink(tmp_path);
+        goto cleanup;
+    }
+    r = fputs(model_data, f);
+    if (fclose(f) || (r == EOF) || rename(tmp_path, path)) {
+        WRN(session, "Unable to store \"%s\" into the schema cache (%s).", path, strerror(errno));
+        unlink(tmp_path);
+    }
+
+cleanup:
+    free(tmp_path);
+    free(path);
+}
+
+/**
+ * @brief Get YANG module content from a reply to get-schema RPC.
+ *
+ * @param[in] session NC session.
+ * @param[in] envp Reply envelope.
+ * @param[in] op Reply operation.
+ * @return Module content.
+ */
+static char *
+getschema_reply_data(struct nc_session *session, const struct lyd_node *envp, const struct lyd_node *op)
+{
+    struct lyd_node_any *get_schema_data;
+    char *envp_str = NULL, *model_data = NULL;
+
+    if (!op) {
         assert(envp);
         lyd_print_mem(&envp_str, envp, LYD_XML, 0);
-        WRN(clb_data->session, "Received an unexpected reply to <get-schema>:\n%s", envp_str);
+        WRN(session, "Received an unexpected reply to <get-schema>:\n%s", envp_str);
         free(envp_str);
-        goto cleanup;
+        return NULL;
     }
 
     if (!lyd_child(op) || (lyd_child(op)->schema->nodetype != LYS_ANYXML)) {
-        ERR(clb_data->session, "Unexpected data in reply to a <get-schema> RPC.");
-        goto cleanup;
+        ERR(session, "Unexpected data in reply to a <get-schema> RPC.");
+        return NULL;
     }
     get_schema_data = (struct lyd_node_any *)lyd_child(op);
     switch (get_schema_data->value_type) {
@@ -477,31 +841,147 @@ retrieve_module_data_getschema(const char *name, const char *rev, struct clb_dat
         free(model_data);
         model_data = NULL;
     }
-    if (!model_data) {
-        goto cleanup;
-    }
 
-    /* set format */
-    *format = LYS_IN_YANG;
+    return model_data;
+}
 
-    /* try to store the model_data into local module repository */
-    lys_search_localfile(ly_ctx_get_searchdirs(clb_data->session->ctx), 0, name, rev, &localfile, NULL);
-    if (client_opts.schema_searchpath && !localfile) {
-        if (asprintf(&localfile, "%s/%s%s%s.yang", client_opts.schema_searchpath, name, rev ? "@" : "",
-                rev ? rev : "") == -1) {
-            ERRMEM;
-        } else {
-            f = fopen(localfile, "w");
-            if (!f) {
-                WRN(clb_data->session, "Unable to store \"%s\" as a local copy of module retrieved via <get-schema> (%s).",
-                        localfile, strerror(errno));
-            } else {
-                fputs(model_data, f);
+/**
+ * @brief Store YANG module content retrieved via get-schema RPC locally for any future use.
+ *
+ * @param[in] name Module name.
+ * @param[in] rev Module revision.
+ * @param[in] model_data Module content.
+ * @param[in] session NC session.
+ */
+static void
+store_module_data(const char *name, const char *rev, const char *model_data, struct nc_session *session)
+{
+    char *localfile = NULL;
+    FILE *f;
+
+    /* store the module for any later connections */
+    store_module_data_cache(name, rev, model_data, session);
+
+    /* try to store the model_data into local module repository */
+    lys_search_localfile(ly_ctx_get_searchdirs(session->ctx), 0, name, rev, &localfile, NULL);
+    if (client_opts.schema_searchpath && !localfile) {
+        if (asprintf(&localfile, "%s/%s%s%s.yang", client_opts.schema_searchpath, name, rev ? "@" : "",
+                rev ? rev : "") == -1) {
+            ERRMEM;
+        } else {
+            f = fopen(localfile, "w");
+            if (!f) {
+                WRN(session, "Unable to store \"%s\" as a local copy of module retrieved via <get-schema> (%s).",
+                        localfile, strerror(errno));
+            } else {
+                fputs(model_data, f);
                 fclose(f);
             }
         }
     }
     free(localfile);
+}
+
+/**
+ * @brief Take YANG module content retrieved in advance via get-schema RPC.
+ *
+ * @param[in] name Module name.
+ * @param[in] rev Module revision.
+ * @param[in] modules Server module info with the retrieved modules.
+ * @return Module content, NULL if not retrieved.
+ */
+static char *
+take_module_data_prefetched(const char *name, const char *rev, struct module_info *modules)
+{
+    uint32_t u, v;
+    char *model_data = NULL;
+
+    if (!modules) {
+        return NULL;
+    }
+
+#define NC_REV_MATCH(r1, r2) ((!(r1) && !(r2)) || ((r1) && (r2) && !strcmp(r1, r2)))
+    for (u = 0; modules[u].name; ++u) {
+        if (modules[u].data && !strcmp(modules[u].name, name) && NC_REV_MATCH(modules[u].revision, rev)) {
+            model_data = modules[u].data;
+            modules[u].data = NULL;
+            return model_data;
+        }
+        for (v = 0; modules[u].submodules && modules[u].submodules[v].name; ++v) {
+            if (modules[u].submodules[v].data && !strcmp(modules[u].submodules[v].name, name) &&
+                    NC_REV_MATCH(modules[u].submodules[v].revision, rev)) {
+                model_data = modules[u].submodules[v].data;
+                modules[u].submodules[v].data = NULL;
+                return model_data;
+            }
+        }
+    }
+#undef NC_REV_MATCH
+
+    return NULL;
+}
+
+/**
+ * @brief Retrieve YANG module content from a reply to get-schema RPC.
+ *
+ * @param[in] name Module name.
+ * @param[in] rev Module revision.
+ * @param[in] clb_data get-schema callback data.
+ * @param[out] format Module format.
+ * @return Module content.
+ */
+static char *
+retrieve_module_data_getschema(const char *name, const char *rev, struct clb_data_s *clb_data,
+        LYS_INFORMAT *format)
+{
+    struct nc_rpc *rpc;
+    struct lyd_node *envp = NULL, *op = NULL;
+    NC_MSG_TYPE msg;
+    uint64_t msgid;
+    char *model_data = NULL;
+
+    /* it may have been retrieved already, together with other modules */
+    model_data = take_module_data_prefetched(name, rev, clb_data->modules);
+    if (model_data) {
+        VRB(clb_data->session, "Using module \"%s@%s\" retrieved from server via get-schema.", name,
+                rev ? rev : "<latest>");
+        *format = LYS_IN_YANG;
+        return model_data;
+    }
+
+    VRB(clb_data->session, "Reading module \"%s@%s\" from server via get-schema.", name, rev ? rev : "<latest>");
+    rpc = nc_rpc_getschema(name, rev, "yang", NC_PARAMTYPE_CONST);
+
+    while ((msg = nc_send_rpc(clb_data->session, rpc, 0, &msgid)) == NC_MSG_WOULDBLOCK) {
+        usleep(1000);
+    }
+    if (msg == NC_MSG_ERROR) {
+        ERR(clb_data->session, "Failed to send the <get-schema> RPC.");
+        nc_rpc_free(rpc);
+        return NULL;
+    }
+
+    do {
+        msg = nc_recv_reply(clb_data->session, rpc, msgid, NC_READ_ACT_TIMEOUT * 1000, &envp, &op);
+    } while (msg == NC_MSG_NOTIF || msg == NC_MSG_REPLY_ERR_MSGID);
+    nc_rpc_free(rpc);
+    if (msg == NC_MSG_WOULDBLOCK) {
+        ERR(clb_data->session, "Timeout for receiving reply to a <get-schema> expired.");
+        goto cleanup;
+    } else if (msg == NC_MSG_ERROR) {
+        ERR(clb_data->session, "Failed to receive a reply to <get-schema>.");
+        goto cleanup;
+    }
+
+    model_data = getschema_reply_data(clb_data->session, envp, op);
+    if (!model_data) {
+        goto cleanup;
+    }
+
+    /* set format */
+    *format = LYS_IN_YANG;
+
+    store_module_data(name, rev, model_data, clb_data->session);
 
 cleanup:
     lyd_free_tree(envp);
@@ -539,7 +1019,11 @@ retrieve_module_data(const char *mod_name, const char *mod_rev, void *user_data,
 
     /* 2. try to use <get-schema> */
     if (!model_data && clb_data->has_get_schema) {
-        model_data = retrieve_module_data_getschema(mod_name, mod_rev, clb_data, format);
+        /* it may have been retrieved before */
+        model_data = retrieve_module_data_cache(mod_name, mod_rev, clb_data, format);
+        if (!model_data) {
+            model_data = retrieve_module_data_getschema(mod_name, mod_rev, clb_data, format);
+        }
     }
 
     /* 3. try to use user callback */
@@ -631,7 +1115,11 @@ retrieve_module_data_imp(const char *mod_name, const char *mod_rev, const char *
 
         /* 2. try to use <get-schema> */
         if (!model_data && clb_data->has_get_schema) {
-            model_data = retrieve_module_data_getschema(name, rev, clb_data, format);
+            /* it may have been retrieved before */
+            model_data = retrieve_module_data_cache(name, rev, clb_data, format);
+            if (!model_data) {
+                model_data = retrieve_module_data_getschema(name, rev, clb_data, format);
+            }
         }
     } else {
         /* we are unsure which revision of the module we should load, so first try to get
@@ -642,7 +1130,11 @@ retrieve_module_data_imp(const char *mod_name, const char *mod_rev, const char *
 
         /* 1. try to use <get-schema> */
         if (clb_data->has_get_schema) {
-            model_data = retrieve_module_data_getschema(name, rev, clb_data, format);
+            /* only a module of this YANG library content could have been cached */
+            model_data = retrieve_module_data_cache(name, rev, clb_data, format);
+            if (!model_data) {
+                model_data = retrieve_module_data_getschema(name, rev, clb_data, format);
+            }
         }
 
         /* 2. try to get data locally */
@@ -781,10 +1273,12 @@ free_module_info(struct module_info *list)
             }
             free(list[u].features);
         }
+        free(list[u].data);
         if (list[u].submodules) {
             for (v = 0; list[u].submodules[v].name; ++v) {
                 free(list[u].submodules[v].name);
                 free(list[u].submodules[v].revision);
+                free(list[u].submodules[v].data);
             }
             free(list[u].submodules);
         }
@@ -792,6 +1286,54 @@ free_module_info(struct module_info *list)
     free(list);
 }
 
+/**
+ * @brief Serialize server module information into a client context pool key.
+ *
+ * @param[in] modules Server module information.
+ * @return Key, NULL on error.
+ */
+static char *
+nc_client_ctx_pool_key(const struct module_info *modules)
+{
+    char *key = NULL;
+    size_t size = 0;
+    FILE *f;
+    uint32_t u, v;
+
+    f = open_memstream(&key, &size);
+    if (!f) {
+        ERRMEM;
+        return NULL;
+    }
+
+    for (u = 0; modules[u].name; ++u) {
+        fprintf(f, "%s@%s%s", modules[u].name, modules[u].revision ? modules[u].revision : "",
+                modules[u].implemented ? "+" : "");
+        for (v = 0; modules[u].features && modules[u].features[v]; ++v) {
+            fprintf(f, "%c%s", v ? ',' : '(', modules[u].features[v]);
+        }
+        if (v) {
+            fputc(')', f);
+        }
+        for (v = 0; modules[u].submodules && modules[u].submodules[v].name; ++v) {
+            fprintf(f, "%c%s@%s", v ? ',' : '[', modules[u].submodules[v].name,
+                    modules[u].submodules[v].revision ? modules[u].submodules[v].revision : "");
+        }
+        if (v) {
+            fputc(']', f);
+        }
+        fputc(';', f);
+    }
+
+    if (fclose(f)) {
+        ERRMEM;
+        free(key);
+        return NULL;
+    }
+
+    return key;
+}
+
 /**
  * @brief Retrieve yang-library and schema-mounts operational data from the server.
  *
@@ -1069,6 +1611,195 @@ build_module_info_cpblts(char **cpblts, struct module_info **result)
     return 0;
 }
 
+/**
+ * @brief Learn the message-id of a reply.
+ *
+ * @param[in] envp Reply envelope.
+ * @param[out] msgid Message-id of the reply.
+ * @return 0 on success, -1 if there is none.
+ */
+static int
+nc_reply_get_msgid(const struct lyd_node *envp, uint64_t *msgid)
+{
+    struct lyd_attr *attr;
+
+    LY_LIST_FOR(((struct lyd_node_opaq *)envp)->attr, attr) {
+        if (!strcmp(attr->name.name, "message-id")) {
+            *msgid = strtoull(attr->value, NULL, 10);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Check whether a (sub)module needs to be retrieved via get-schema RPC.
+ *
+ * @param[in] session NC session.
+ * @param[in] name (Sub)module name.
+ * @param[in] rev (Sub)module revision.
+ * @param[in] data Data of the (sub)module retrieved in advance, if any.
+ * @return Whether to retrieve it.
+ */
+static int
+nc_ctx_prefetch_needed(struct nc_session *session, const char *name, const char *rev, const char *data)
+{
+    char *path;
+    int needed = 1;
+
+    if (data || !rev) {
+        /* retrieved already or unsure which revision would be retrieved */
+        return 0;
+    }
+    if (ly_ctx_get_module(session->ctx, name, rev) || ly_ctx_get_submodule(session->ctx, name, rev)) {
+        /* in the context already */
+        return 0;
+    }
+
+    /* available locally */
+    path = NULL;
+    if (!lys_search_localfile(ly_ctx_get_searchdirs(session->ctx),
+            !(ly_ctx_get_options(session->ctx) & LY_CTX_DISABLE_SEARCHDIR_CWD), name, rev, &path, NULL) && path) {
+        needed = 0;
+    }
+    free(path);
+    if (needed && (path = schema_cache_path(name, rev, session))) {
+        if (!access(path, R_OK)) {
+            needed = 0;
+        }
+        free(path);
+    }
+
+    return needed;
+}
+
+/**
+ * @brief Retrieve all the missing server (sub)modules via get-schema RPCs in advance, pipelined.
+ *
+ * Up to ::NC_CLIENT_GETSCHEMA_PIPELINE RPCs are sent before a reply to the first one is awaited. Any failure only
+ * stops the retrieval, the (sub)modules are then retrieved one by one when loaded.
+ *
+ * @param[in] session NC session.
+ * @param[in] modules Server module info to store the retrieved (sub)modules in.
+ */
+static void
+nc_ctx_prefetch_modules(struct nc_session *session, struct module_info *modules)
+{
+    struct {
+        struct nc_rpc *rpc;
+        uint64_t msgid;
+        const char *name;
+        const char *rev;
+        char **data;
+    } pending[NC_CLIENT_GETSCHEMA_PIPELINE];
+    struct lyd_node *envp, *op;
+    uint32_t u = 0, v = 0, count = 0, i;
+    uint64_t msgid;
+    const char *name, *rev;
+    char **data;
+    NC_MSG_TYPE msg;
+    int done = 0;
+
+    while (!done || count) {
+        /* find the next (sub)module to retrieve */
+        data = NULL;
+        while (!done && !data) {
+            if (!modules[u].name) {
+                done = 1;
+                break;
+            }
+
+            if (v == 0) {
+                name = modules[u].name;
+                rev = modules[u].revision;
+                if (nc_ctx_prefetch_needed(session, name, rev, modules[u].data)) {
+                    data = &modules[u].data;
+                }
+            } else {
+                name = modules[u].submodules[v - 1].name;
+                rev = modules[u].submodules[v - 1].revision;
+                if (nc_ctx_prefetch_needed(session, name, rev, modules[u].submodules[v - 1].data)) {
+                    data = &modules[u].submodules[v - 1].data;
+                }
+            }
+
+            /* move to the next submodule or module */
+            if (modules[u].submodules && modules[u].submodules[v].name) {
+                ++v;
+            } else {
+                ++u;
+                v = 0;
+            }
+        }
+
+        if (data) {
+            /* send the RPC */
+            VRB(session, "Reading module \"%s@%s\" from server via get-schema.", name, rev);
+            pending[count].rpc = nc_rpc_getschema(name, rev, "yang", NC_PARAMTYPE_CONST);
+            if (!pending[count].rpc) {
+                break;
+            }
+            while ((msg = nc_send_rpc(session, pending[count].rpc, 0, &pending[count].msgid)) == NC_MSG_WOULDBLOCK) {
+                usleep(1000);
+            }
+            if (msg == NC_MSG_ERROR) {
+                ERR(session, "Failed to send the <get-schema> RPC.");
+                nc_rpc_free(pending[count].rpc);
+                break;
+            }
+            pending[count].name = name;
+            pending[count].rev = rev;
+            pending[count].data = data;
+            ++count;
+
+            if (count < NC_CLIENT_GETSCHEMA_PIPELINE) {
+                /* send more */
+                continue;
+            }
+        }
+        if (!count) {
+            break;
+        }
+
+        /* receive a reply, expected to be the one to the oldest RPC */
+        envp = op = NULL;
+        do {
+            msg = nc_recv_reply(session, pending[0].rpc, pending[0].msgid, NC_READ_ACT_TIMEOUT * 1000, &envp, &op);
+        } while (msg == NC_MSG_NOTIF);
+        if (msg == NC_MSG_WOULDBLOCK) {
+            ERR(session, "Timeout for receiving reply to a <get-schema> expired.");
+            break;
+        } else if (msg == NC_MSG_ERROR) {
+            ERR(session, "Failed to receive a reply to <get-schema>.");
+            break;
+        }
+
+        /* match the reply with its RPC */
+        i = count;
+        if (!nc_reply_get_msgid(envp, &msgid)) {
+            for (i = 0; (i < count) && (pending[i].msgid != msgid); ++i) {}
+        }
+        if (i < count) {
+            *pending[i].data = getschema_reply_data(session, envp, op);
+            if (*pending[i].data) {
+                store_module_data(pending[i].name, pending[i].rev, *pending[i].data, session);
+            }
+
+            nc_rpc_free(pending[i].rpc);
+            --count;
+            memmove(pending + i, pending + i + 1, (count - i) * sizeof *pending);
+        }
+        lyd_free_tree(envp);
+        lyd_free_tree(op);
+    }
+
+    /* replies to any RPCs left are discarded when received */
+    for (i = 0; i < count; ++i) {
+        nc_rpc_free(pending[i].rpc);
+    }
+}
+
 /**
  * @brief Fill client context based on server modules info.
  *
@@ -1088,6 +1819,11 @@ nc_ctx_fill(struct nc_session *session, struct module_info *modules, ly_module_i
     struct lys_module *mod;
     uint32_t u;
 
+    if (has_get_schema) {
+        /* avoid waiting for a reply to every <get-schema> separately */
+        nc_ctx_prefetch_modules(session, modules);
+    }
+
     for (u = 0; modules[u].name; ++u) {
         /* skip import-only modules */
         if (!modules[u].implemented) {
@@ -1230,14 +1966,16 @@ cleanup:
 int
 nc_ctx_check_and_fill(struct nc_session *session)
 {
-    int i, get_schema_support = 0, yanglib_support = 0, xpath_support = 0, nmda_support = 0, ret = -1;
+    int i, get_schema_support = 0, yanglib_support = 0, xpath_support = 0, nmda_support = 0, ret = -1, not_strict;
     ly_module_imp_clb old_clb = NULL;
     void *old_data = NULL;
     struct lys_module *mod = NULL;
-    char *revision;
+    struct ly_ctx *pool_ctx;
+    char *revision, *pool_key = NULL, **cpblts;
     struct module_info *server_modules = NULL, *sm = NULL;
 
     assert(session->opts.client.cpblts && session->ctx);
+    cpblts = session->opts.client.cpblts->cpblts;
 
     /* store the original user's callback, we will be switching between local search, get-schema and user callback */
     old_clb = ly_ctx_get_module_imp_clb(session->ctx, &old_data);
@@ -1250,14 +1988,14 @@ nc_ctx_check_and_fill(struct nc_session *session)
     ly_ctx_set_module_imp_clb(session->ctx, NULL, NULL);
 
     /* check if get-schema and yang-library is supported */
-    for (i = 0; session->opts.client.cpblts[i]; ++i) {
-        if (!strncmp(session->opts.client.cpblts[i], "urn:ietf:params:xml:ns:yang:ietf-netconf-monitoring?", 52)) {
+    for (i = 0; cpblts[i]; ++i) {
+        if (!strncmp(cpblts[i], "urn:ietf:params:xml:ns:yang:ietf-netconf-monitoring?", 52)) {
             get_schema_support = 1 + i;
-        } else if (!strncmp(session->opts.client.cpblts[i], "urn:ietf:params:netconf:capability:yang-library:", 48)) {
+        } else if (!strncmp(cpblts[i], "urn:ietf:params:netconf:capability:yang-library:", 48)) {
             yanglib_support = 1 + i;
-        } else if (!strncmp(session->opts.client.cpblts[i], "urn:ietf:params:netconf:capability:xpath:1.0", 44)) {
+        } else if (!strncmp(cpblts[i], "urn:ietf:params:netconf:capability:xpath:1.0", 44)) {
             xpath_support = 1 + i;
-        } else if (!strncmp(session->opts.client.cpblts[i], "urn:ietf:params:xml:ns:yang:ietf-netconf-nmda", 45)) {
+        } else if (!strncmp(cpblts[i], "urn:ietf:params:xml:ns:yang:ietf-netconf-nmda", 45)) {
             nmda_support = 1 + i;
         }
     }
@@ -1267,7 +2005,7 @@ nc_ctx_check_and_fill(struct nc_session *session)
     VRB(session, "Capability for NMDA RPCs support%s found.", nmda_support ? "" : " not");
 
     /* get information about server's modules from capabilities list until we will have yang-library */
-    if (build_module_info_cpblts(session->opts.client.cpblts, &server_modules) || !server_modules) {
+    if (build_module_info_cpblts(cpblts, &server_modules) || !server_modules) {
         ERR(session, "Unable to get server module information from the <hello>'s capabilities.");
         goto cleanup;
     }
@@ -1286,7 +2024,7 @@ nc_ctx_check_and_fill(struct nc_session *session)
     /* get correct version of ietf-yang-library into context */
     if (yanglib_support) {
         /* use get-schema to get server's ietf-yang-library */
-        revision = strstr(session->opts.client.cpblts[yanglib_support - 1], "revision=");
+        revision = strstr(cpblts[yanglib_support - 1], "revision=");
         if (!revision) {
             WRN(session, "Loading NETCONF ietf-yang-library module failed, missing revision in NETCONF <hello> message.");
             WRN(session, "Unable to automatically use <get-schema>.");
@@ -1333,6 +2071,22 @@ nc_ctx_check_and_fill(struct nc_session *session)
         }
     }
 
+    /* try to use the context of a server with the same modules */
+    if (client_opts.ctx_pool && !(session->flags & NC_SESSION_SHAREDCTX)) {
+        pool_key = nc_client_ctx_pool_key(server_modules);
+        if (pool_key && (pool_ctx = nc_client_ctx_pool_get(pool_key, &not_strict))) {
+            VRB(session, "Using a shared context of a server with the same modules.");
+            ly_ctx_destroy(session->ctx);
+            session->ctx = pool_ctx;
+            session->flags |= NC_SESSION_SHAREDCTX | NC_SESSION_CLIENT_POOLCTX;
+            if (not_strict) {
+                session->flags |= NC_SESSION_CLIENT_NOT_STRICT;
+            }
+            ret = 0;
+            goto cleanup;
+        }
+    }
+
     /* compile all modules at once to avoid invalid errors or warnings */
     ly_ctx_set_options(session->ctx, LY_CTX_EXPLICIT_COMPILE);
 
@@ -1362,11 +2116,25 @@ nc_ctx_check_and_fill(struct nc_session *session)
 cleanup:
     free_module_info(server_modules);
 
+    if (session->flags & NC_SESSION_CLIENT_POOLCTX) {
+        /* shared context must not be modified */
+        free(pool_key);
+        return ret;
+    }
+
     /* set user callback back */
     ly_ctx_set_module_imp_clb(session->ctx, old_clb, old_data);
     ly_ctx_unset_options(session->ctx, LY_CTX_DISABLE_SEARCHDIRS);
     ly_ctx_unset_options(session->ctx, LY_CTX_EXPLICIT_COMPILE);
 
+    /* share the context unless it holds the mounted schemas of this session */
+    if (!ret && pool_key && !ly_ctx_get_module_implemented(session->ctx, "ietf-yang-schema-mount") &&
+            !nc_client_ctx_pool_add(pool_key, session->ctx, session->flags & NC_SESSION_CLIENT_NOT_STRICT)) {
+        session->flags |= NC_SESSION_SHAREDCTX | NC_SESSION_CLIENT_POOLCTX;
+        pool_key = NULL;
+    }
+    free(pool_key);
+
     return ret;
 }
 
@@ -1384,7 +2152,7 @@ nc_connect_inout(int fdin, int fdout, struct ly_ctx *ctx)
     }
 
     /* prepare session structure */
-    session = nc_new_session(NC_CLIENT, 0);
+    session = nc_new_session(NC_CLIENT);
     if (!session) {
         ERRMEM;
         return NULL;
@@ -1455,7 +2223,7 @@ nc_connect_unix(const char *address, struct ly_ctx *ctx)
     }
 
     /* prepare session structure */
-    session = nc_new_session(NC_CLIENT, 0);
+    session = nc_new_session(NC_CLIENT);
     if (!session) {
         ERRMEM;
         goto fail;
@@ -1715,205 +2483,1543 @@ error:
 
 #if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
 
-int
-nc_client_ch_add_bind_listen(const char *address, uint16_t port, const char *hostname, NC_TRANSPORT_IMPL ti)
+static void
+nc_connect_batch_conn_free(struct nc_connect_batch_conn *conn)
 {
-    int sock;
-
-    if (!address) {
-        ERRARG("address");
-        return -1;
-    } else if (!port) {
-        ERRARG("port");
-        return -1;
-    }
-
-    sock = nc_sock_listen_inet(address, port, &client_opts.ka);
-    if (sock == -1) {
-        return -1;
+    if (!conn) {
+        return;
     }
 
-    ++client_opts.ch_bind_count;
-    client_opts.ch_binds = nc_realloc(client_opts.ch_binds, client_opts.ch_bind_count * sizeof *client_opts.ch_binds);
-    if (!client_opts.ch_binds) {
-        ERRMEM;
-        close(sock);
-        return -1;
+    if (conn->res_list) {
+        freeaddrinfo(conn->res_list);
     }
-
-    client_opts.ch_binds_aux = nc_realloc(client_opts.ch_binds_aux, client_opts.ch_bind_count * sizeof *client_opts.ch_binds_aux);
-    if (!client_opts.ch_binds_aux) {
-        ERRMEM;
-        close(sock);
-        return -1;
+    if (conn->sock > -1) {
+        close(conn->sock);
     }
-    client_opts.ch_binds_aux[client_opts.ch_bind_count - 1].ti = ti;
-    client_opts.ch_binds_aux[client_opts.ch_bind_count - 1].hostname = hostname ? strdup(hostname) : NULL;
+    free(conn->ip_host);
+    free(conn);
+}
+
+/**
+ * @brief Start a non-blocking TCP connect of a batch target to its current or any next address.
+ *
+ * @param[in] conn Target connection with the address to try first.
+ * @param[in] timeout Timeout of connecting to a single address in msec, -1 for none.
+ * @return 0 if a connect is in progress, -1 if there are no more addresses to try.
+ */
+static int
+nc_connect_batch_next(struct nc_connect_batch_conn *conn, int timeout)
+{
+    int flags;
+
+    for ( ; conn->res; conn->res = conn->res->ai_next) {
+        conn->sock = socket(conn->res->ai_family, conn->res->ai_socktype, conn->res->ai_protocol);
+        if (conn->sock == -1) {
+            ERR(NULL, "Socket could not be created (%s).", strerror(errno));
+            continue;
+        }
+        if (((flags = fcntl(conn->sock, F_GETFL)) == -1) || (fcntl(conn->sock, F_SETFL, flags | O_NONBLOCK) == -1)) {
+            ERR(NULL, "fcntl() failed (%s).", strerror(errno));
+        } else if ((connect(conn->sock, conn->res->ai_addr, conn->res->ai_addrlen) == 0) || (errno == EINPROGRESS)) {
+            /* finished when the socket is writable */
+            if (timeout > -1) {
+                nc_gettimespec_mono_add(&conn->ts_timeout, timeout);
+            }
+            return 0;
+        } else {
+            VRB(NULL, "connect() to %s:%u failed (%s).", conn->host, conn->port, strerror(errno));
+        }
+
+        close(conn->sock);
+        conn->sock = -1;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Create a batch target connection.
+ *
+ * @param[in] target Target to connect to.
+ * @param[in] idx Index of @p target.
+ * @return Target connection, NULL on error.
+ */
+static struct nc_connect_batch_conn *
+nc_connect_batch_conn_new(const struct nc_connect_target *target, uint32_t idx)
+{
+    struct nc_connect_batch_conn *conn;
+
+    conn = calloc(1, sizeof *conn);
+    if (!conn) {
+        ERRMEM;
+        return NULL;
+    }
+    conn->idx = idx;
+    conn->sock = -1;
+    conn->host = (target->host && !strisempty(target->host)) ? target->host : "localhost";
+    conn->port = target->port;
+    if (!conn->port) {
+#ifdef NC_ENABLED_SSH
+        if (target->ti == NC_TI_LIBSSH) {
+            conn->port = NC_PORT_SSH;
+        }
+#endif
+#ifdef NC_ENABLED_TLS
+        if (target->ti == NC_TI_OPENSSL) {
+            conn->port = NC_PORT_TLS;
+        }
+#endif
+    }
+
+    return conn;
+}
+
+/**
+ * @brief Resolve the addresses of a batch target.
+ *
+ * @param[in] conn Target connection.
+ * @param[in] numeric Whether to only convert a numeric host address, which never blocks.
+ * @return 0 on success;
+ * @return 1 if @p numeric is set and the host is not a numeric address;
+ * @return -1 on error.
+ */
+static int
+nc_connect_batch_resolve(struct nc_connect_batch_conn *conn, int numeric)
+{
+    struct addrinfo hints;
+    char port_s[6];
+    int r;
+
+    snprintf(port_s, 6, "%u", conn->port);
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    if (numeric) {
+        hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+    }
+    if ((r = getaddrinfo(conn->host, port_s, &hints, &conn->res_list))) {
+        conn->res_list = NULL;
+        if (numeric && (r == EAI_NONAME)) {
+            /* a host name */
+            return 1;
+        }
+        ERR(NULL, "Unable to translate the host address of \"%s\" (%s).", conn->host, gai_strerror(r));
+        return -1;
+    }
+
+    conn->res = conn->res_list;
+    return 0;
+}
+
+/**
+ * @brief Start connecting to the resolved addresses of a batch target.
+ *
+ * @param[in] conn Resolved target connection.
+ * @param[in] timeout Timeout of connecting to a single address in msec, -1 for none.
+ * @return 0 if a connect is in progress, -1 on error.
+ */
+static int
+nc_connect_batch_start(struct nc_connect_batch_conn *conn, int timeout)
+{
+    if (nc_connect_batch_next(conn, timeout)) {
+        ERR(NULL, "Unable to connect to %s:%u.", conn->host, conn->port);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Finish a TCP connect of a batch target whose socket became writable.
+ *
+ * @param[in] conn Target connection.
+ * @return 0 if connected, -1 if connecting to the current address failed.
+ */
+static int
+nc_connect_batch_connected(struct nc_connect_batch_conn *conn)
+{
+    int error = 0, opt = 1;
+    socklen_t len = sizeof error;
+    void *addr;
+
+    if (getsockopt(conn->sock, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
+        ERR(NULL, "getsockopt() failed (%s).", strerror(errno));
+        return -1;
+    } else if (error) {
+        VRB(NULL, "connect() to %s:%u failed (%s).", conn->host, conn->port, strerror(error));
+        return -1;
+    }
+
+    if (nc_sock_enable_keepalive(conn->sock, &client_opts.ka)) {
+        return -1;
+    }
+    if (setsockopt(conn->sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof opt) == -1) {
+        ERR(NULL, "Could not set TCP_NODELAY socket option (%s).", strerror(errno));
+        return -1;
+    }
+
+    if ((conn->res->ai_family == AF_INET) || (conn->res->ai_family == AF_INET6)) {
+        conn->ip_host = malloc(INET6_ADDRSTRLEN);
+        if (!conn->ip_host) {
+            ERRMEM;
+            return -1;
+        }
+        if (conn->res->ai_family == AF_INET) {
+            addr = &((struct sockaddr_in *)conn->res->ai_addr)->sin_addr;
+        } else {
+            addr = &((struct sockaddr_in6 *)conn->res->ai_addr)->sin6_addr;
+        }
+        if (!inet_ntop(conn->res->ai_family, addr, conn->ip_host, INET6_ADDRSTRLEN)) {
+            ERR(NULL, "Converting host to IP address failed (%s).", strerror(errno));
+            free(conn->ip_host);
+            conn->ip_host = NULL;
+            return -1;
+        }
+    }
+
+    VRB(NULL, "Successfully connected to %s:%u over %s.", conn->host, conn->port,
+            (conn->res->ai_family == AF_INET6) ? "IPv6" : "IPv4");
+    return 0;
+}
+
+/**
+ * @brief Batch connect worker thread, establishing the transport and NETCONF session on the connected sockets.
+ */
+static void *
+nc_connect_batch_thread(void *arg)
+{
+    struct nc_connect_batch *batch = arg;
+    struct nc_connect_batch_conn *conn;
+    struct nc_session *session;
+
+    /* use the client options of the thread driving the batch, it waits for this thread before returning */
+    pthread_setspecific(nc_client_context_key, batch->context);
+
+    while (1) {
+        /* LOCK */
+        pthread_mutex_lock(&batch->lock);
+
+        while (!batch->queue_head && !batch->stop) {
+            pthread_cond_wait(&batch->cond, &batch->lock);
+        }
+        conn = batch->queue_head;
+        if (conn) {
+            batch->queue_head = conn->next;
+            if (!batch->queue_head) {
+                batch->queue_tail = NULL;
+            }
+            if (conn->sock > -1) {
+                --batch->queued;
+
+                /* a connection slot was freed */
+                pthread_cond_broadcast(&batch->cond);
+            }
+        }
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&batch->lock);
+
+        if (!conn) {
+            break;
+        }
+
+        if (conn->sock == -1) {
+            /* only resolve the host name, it may block, connecting is driven by the batch thread */
+            nc_connect_batch_resolve(conn, 0);
+
+            /* LOCK */
+            pthread_mutex_lock(&batch->lock);
+
+            conn->next = batch->resolved;
+            batch->resolved = conn;
+            pthread_cond_broadcast(&batch->cond);
+
+            /* UNLOCK */
+            pthread_mutex_unlock(&batch->lock);
+
+            if (write(batch->wakefd[1], "", 1) == -1) {
+                /* the pipe is full, the batch thread is going to be woken up anyway */
+            }
+            continue;
+        }
+
+        /* the socket and the IP host are consumed */
+        session = NULL;
+        switch (batch->targets[conn->idx].ti) {
+#ifdef NC_ENABLED_SSH
+        case NC_TI_LIBSSH:
+            session = nc_connect_ssh_sock(conn->host, conn->port, conn->sock, conn->ip_host, batch->ctx);
+            break;
+#endif
+#ifdef NC_ENABLED_TLS
+        case NC_TI_OPENSSL:
+            session = nc_connect_tls_sock(conn->host, conn->port, conn->sock, conn->ip_host, batch->ctx);
+            break;
+#endif
+        default:
+            ERRINT;
+            close(conn->sock);
+            free(conn->ip_host);
+            break;
+        }
+        conn->sock = -1;
+        conn->ip_host = NULL;
+
+        batch->clb(&batch->targets[conn->idx], session, batch->user_data);
+        nc_connect_batch_conn_free(conn);
+    }
+
+    /* the context is still owned by the driving thread */
+    pthread_setspecific(nc_client_context_key, NULL);
+    nc_thread_destroy();
+    return NULL;
+}
+
+/**
+ * @brief Pass a connected batch target or a target to resolve to the worker threads.
+ *
+ * @param[in] batch Batch connect.
+ * @param[in] conn Connected target or a target without a socket to resolve.
+ */
+static void
+nc_connect_batch_queue(struct nc_connect_batch *batch, struct nc_connect_batch_conn *conn)
+{
+    /* the addresses are no longer needed */
+    if (conn->res_list) {
+        freeaddrinfo(conn->res_list);
+        conn->res_list = NULL;
+    }
+    conn->res = NULL;
+    conn->next = NULL;
+
+    /* LOCK */
+    pthread_mutex_lock(&batch->lock);
+
+    if (batch->queue_tail) {
+        batch->queue_tail->next = conn;
+    } else {
+        batch->queue_head = conn;
+    }
+    batch->queue_tail = conn;
+    if (conn->sock > -1) {
+        ++batch->queued;
+    }
+    pthread_cond_broadcast(&batch->cond);
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&batch->lock);
+}
+
+API int
+nc_connect_batch(const struct nc_connect_target *targets, uint32_t target_count, struct ly_ctx *ctx,
+        uint32_t max_pending, uint16_t thread_count, int timeout, nc_connect_batch_clb clb, void *user_data)
+{
+    struct nc_connect_batch batch = {.wakefd = {-1, -1}};
+    struct nc_connect_batch_conn **conns = NULL, *conn, *resolved;
+    struct pollfd *pfds = NULL;
+    pthread_t *tids = NULL;
+    uint32_t i, next = 0, conn_count = 0, resolving = 0, queued;
+    uint16_t started = 0;
+    int r, wait, ret = 0;
+    const char *tls_host = NULL;
+    char buf[64];
+
+    if (!targets) {
+        ERRARG("targets");
+        return -1;
+    } else if (!max_pending) {
+        ERRARG("max_pending");
+        return -1;
+    } else if (!thread_count) {
+        ERRARG("thread_count");
+        return -1;
+    } else if (!clb) {
+        ERRARG("clb");
+        return -1;
+    }
+
+    for (i = 0; i < target_count; ++i) {
+        switch (targets[i].ti) {
+#ifdef NC_ENABLED_SSH
+        case NC_TI_LIBSSH:
+            break;
+#endif
+#ifdef NC_ENABLED_TLS
+        case NC_TI_OPENSSL:
+            if (!tls_host) {
+                tls_host = (targets[i].host && !strisempty(targets[i].host)) ? targets[i].host : "localhost";
+            }
+            break;
+#endif
+        default:
+            ERR(NULL, "Target %" PRIu32 " uses an unsupported transport.", i);
+            return -1;
+        }
+    }
+
+#ifdef NC_ENABLED_TLS
+    /* the TLS context is shared by the workers, create it only once */
+    if (tls_host && nc_connect_tls_prepare(tls_host)) {
+        return -1;
+    }
+#endif
+
+    batch.targets = targets;
+    batch.ctx = ctx;
+    batch.clb = clb;
+    batch.user_data = user_data;
+    batch.context = nc_client_context_location();
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.cond, NULL);
+
+    if (pipe(batch.wakefd) == -1) {
+        ERR(NULL, "Failed to create a pipe (%s).", strerror(errno));
+        batch.wakefd[0] = -1;
+        batch.wakefd[1] = -1;
+        ret = -1;
+        goto cleanup;
+    }
+    for (i = 0; i < 2; ++i) {
+        if (((r = fcntl(batch.wakefd[i], F_GETFL)) == -1) || (fcntl(batch.wakefd[i], F_SETFL, r | O_NONBLOCK) == -1)) {
+            ERR(NULL, "fcntl() failed (%s).", strerror(errno));
+            ret = -1;
+            goto cleanup;
+        }
+    }
+
+    /* the last poll slot is used by the wake-up pipe */
+    conns = malloc(max_pending * sizeof *conns);
+    pfds = malloc((max_pending + 1) * sizeof *pfds);
+    tids = malloc(thread_count * sizeof *tids);
+    if (!conns || !pfds || !tids) {
+        ERRMEM;
+        ret = -1;
+        goto cleanup;
+    }
+
+    for (started = 0; started < thread_count; ++started) {
+        if ((r = pthread_create(&tids[started], NULL, nc_connect_batch_thread, &batch))) {
+            ERR(NULL, "Creating a new thread failed (%s).", strerror(r));
+            ret = -1;
+            goto cleanup;
+        }
+    }
+
+    while ((next < target_count) || conn_count || resolving) {
+        /* LOCK */
+        pthread_mutex_lock(&batch.lock);
+
+        /* all the connection slots may be taken by targets being resolved or waiting for a worker */
+        while (!conn_count && !batch.resolved &&
+                ((next == target_count) || (resolving + batch.queued >= max_pending))) {
+            pthread_cond_wait(&batch.cond, &batch.lock);
+        }
+        queued = batch.queued;
+        resolved = batch.resolved;
+        batch.resolved = NULL;
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&batch.lock);
+
+        /* start connecting to the targets resolved by the workers */
+        while (resolved) {
+            conn = resolved;
+            resolved = resolved->next;
+            conn->next = NULL;
+            --resolving;
+
+            if (conn->res_list && !nc_connect_batch_start(conn, timeout)) {
+                conns[conn_count++] = conn;
+            } else {
+                clb(&targets[conn->idx], NULL, user_data);
+                nc_connect_batch_conn_free(conn);
+            }
+        }
+
+        /* start connecting to new targets, host names are resolved by the workers because it may block */
+        while ((next < target_count) && (conn_count + resolving + queued < max_pending)) {
+            conn = nc_connect_batch_conn_new(&targets[next], next);
+            r = conn ? nc_connect_batch_resolve(conn, 1) : -1;
+            if (r == 1) {
+                nc_connect_batch_queue(&batch, conn);
+                ++resolving;
+            } else if (!r && !nc_connect_batch_start(conn, timeout)) {
+                conns[conn_count++] = conn;
+            } else {
+                clb(&targets[next], NULL, user_data);
+                nc_connect_batch_conn_free(conn);
+            }
+            ++next;
+        }
+        if (!conn_count) {
+            continue;
+        }
+
+        /* wait for the connects or resolved targets, with free slots recheck regularly whether new targets can be
+         * started */
+        wait = (next < target_count) ? NC_CLIENT_CONNECT_BATCH_WAIT : -1;
+        for (i = 0; i < conn_count; ++i) {
+            pfds[i].fd = conns[i]->sock;
+            pfds[i].events = POLLOUT;
+            pfds[i].revents = 0;
+            if (conns[i]->ts_timeout.tv_sec || conns[i]->ts_timeout.tv_nsec) {
+                r = nc_difftimespec_mono_cur(&conns[i]->ts_timeout);
+                if (r < 0) {
+                    r = 0;
+                }
+                if ((wait == -1) || (r < wait)) {
+                    wait = r;
+                }
+            }
+        }
+        pfds[conn_count].fd = resolving ? batch.wakefd[0] : -1;
+        pfds[conn_count].events = POLLIN;
+        pfds[conn_count].revents = 0;
+        r = poll(pfds, conn_count + 1, wait);
+        if ((r == -1) && (errno != EINTR)) {
+            ERR(NULL, "poll() failed (%s).", strerror(errno));
+            usleep(NC_TIMEOUT_STEP);
+            continue;
+        }
+        if (pfds[conn_count].revents) {
+            /* the resolved targets are taken in the next iteration */
+            while (read(batch.wakefd[0], buf, sizeof buf) > 0) {}
+        }
+
+        for (i = 0; i < conn_count; ) {
+            conn = conns[i];
+            if (pfds[i].revents) {
+                if (!nc_connect_batch_connected(conn)) {
+                    nc_connect_batch_queue(&batch, conn);
+                    conn = NULL;
+                }
+            } else if ((conn->ts_timeout.tv_sec || conn->ts_timeout.tv_nsec) &&
+                    (nc_difftimespec_mono_cur(&conn->ts_timeout) < 1)) {
+                VRB(NULL, "Connecting to %s:%u timed out after %d ms.", conn->host, conn->port, timeout);
+            } else {
+                /* still connecting */
+                ++i;
+                continue;
+            }
+
+            if (conn) {
+                /* try the next address */
+                close(conn->sock);
+                conn->sock = -1;
+                conn->res = conn->res->ai_next;
+                if (!nc_connect_batch_next(conn, timeout)) {
+                    pfds[i].fd = conn->sock;
+                    pfds[i].revents = 0;
+                    ++i;
+                    continue;
+                }
+
+                ERR(NULL, "Unable to connect to %s:%u.", conn->host, conn->port);
+                clb(&targets[conn->idx], NULL, user_data);
+                nc_connect_batch_conn_free(conn);
+            }
+
+            /* move the last connection to the free slot */
+            --conn_count;
+            conns[i] = conns[conn_count];
+            pfds[i] = pfds[conn_count];
+        }
+    }
+
+cleanup:
+    /* LOCK */
+    pthread_mutex_lock(&batch.lock);
+
+    batch.stop = 1;
+    pthread_cond_broadcast(&batch.cond);
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&batch.lock);
+
+    /* workers process all the queued connections first */
+    for (i = 0; i < started; ++i) {
+        pthread_join(tids[i], NULL);
+    }
+
+    pthread_mutex_destroy(&batch.lock);
+    pthread_cond_destroy(&batch.cond);
+    if (batch.wakefd[0] > -1) {
+        close(batch.wakefd[0]);
+        close(batch.wakefd[1]);
+    }
+    free(conns);
+    free(pfds);
+    free(tids);
+    return ret;
+}
+
+int
+nc_client_ch_add_bind_listen(const char *address, uint16_t port, const char *hostname, NC_TRANSPORT_IMPL ti)
+{
+    int sock;
+
+    if (!address) {
+        ERRARG("address");
+        return -1;
+    } else if (!port) {
+        ERRARG("port");
+        return -1;
+    }
+
+    sock = nc_sock_listen_inet(address, port, &client_opts.ka, 0);
+    if (sock == -1) {
+        return -1;
+    }
+
+    ++client_opts.ch_bind_count;
+    client_opts.ch_binds = nc_realloc(client_opts.ch_binds, client_opts.ch_bind_count * sizeof *client_opts.ch_binds);
+    if (!client_opts.ch_binds) {
+        ERRMEM;
+        close(sock);
+        return -1;
+    }
+
+    client_opts.ch_binds_aux = nc_realloc(client_opts.ch_binds_aux, client_opts.ch_bind_count * sizeof *client_opts.ch_binds_aux);
+    if (!client_opts.ch_binds_aux) {
+        ERRMEM;
+        close(sock);
+        return -1;
+    }
+    client_opts.ch_binds_aux[client_opts.ch_bind_count - 1].ti = ti;
+    client_opts.ch_binds_aux[client_opts.ch_bind_count - 1].hostname = hostname ? strdup(hostname) : NULL;
 
     client_opts.ch_binds[client_opts.ch_bind_count - 1].address = strdup(address);
     client_opts.ch_binds[client_opts.ch_bind_count - 1].port = port;
     client_opts.ch_binds[client_opts.ch_bind_count - 1].sock = sock;
     client_opts.ch_binds[client_opts.ch_bind_count - 1].pollin = 0;
 
-    return 0;
+    return 0;
+}
+
+int
+nc_client_ch_del_bind(const char *address, uint16_t port, NC_TRANSPORT_IMPL ti)
+{
+    uint32_t i;
+    int ret = -1;
+
+    if (!address && !port && !ti) {
+        for (i = 0; i < client_opts.ch_bind_count; ++i) {
+            close(client_opts.ch_binds[i].sock);
+            free(client_opts.ch_binds[i].address);
+
+            free(client_opts.ch_binds_aux[i].hostname);
+
+            ret = 0;
+        }
+        client_opts.ch_bind_count = 0;
+
+        free(client_opts.ch_binds);
+        client_opts.ch_binds = NULL;
+
+        free(client_opts.ch_binds_aux);
+        client_opts.ch_binds_aux = NULL;
+    } else {
+        for (i = 0; i < client_opts.ch_bind_count; ++i) {
+            if ((!address || !strcmp(client_opts.ch_binds[i].address, address)) &&
+                    (!port || (client_opts.ch_binds[i].port == port)) &&
+                    (!ti || (client_opts.ch_binds_aux[i].ti == ti))) {
+                close(client_opts.ch_binds[i].sock);
+                free(client_opts.ch_binds[i].address);
+
+                --client_opts.ch_bind_count;
+                if (!client_opts.ch_bind_count) {
+                    free(client_opts.ch_binds);
+                    client_opts.ch_binds = NULL;
+
+                    free(client_opts.ch_binds_aux);
+                    client_opts.ch_binds_aux = NULL;
+                } else if (i < client_opts.ch_bind_count) {
+                    memcpy(&client_opts.ch_binds[i], &client_opts.ch_binds[client_opts.ch_bind_count],
+                            sizeof *client_opts.ch_binds);
+
+                    memcpy(&client_opts.ch_binds_aux[i], &client_opts.ch_binds_aux[client_opts.ch_bind_count],
+                            sizeof *client_opts.ch_binds_aux);
+                }
+
+                ret = 0;
+            }
+        }
+    }
+
+    return ret;
+}
+
+API int
+nc_accept_callhome(int timeout, struct ly_ctx *ctx, struct nc_session **session)
+{
+    int sock;
+    char *host = NULL;
+    uint16_t port, idx;
+
+    if (!client_opts.ch_binds) {
+        ERRINIT;
+        return -1;
+    } else if (!session) {
+        ERRARG("session");
+        return -1;
+    }
+
+    sock = nc_sock_accept_binds(client_opts.ch_binds, client_opts.ch_bind_count, NULL, timeout, &host, &port, &idx);
+    if (sock < 1) {
+        free(host);
+        return sock;
+    }
+
+#ifdef NC_ENABLED_SSH
+    if (client_opts.ch_binds_aux[idx].ti == NC_TI_LIBSSH) {
+        *session = nc_accept_callhome_ssh_sock(sock, host, port, ctx, NC_TRANSPORT_TIMEOUT);
+    } else
+#endif
+#ifdef NC_ENABLED_TLS
+    if (client_opts.ch_binds_aux[idx].ti == NC_TI_OPENSSL) {
+        *session = nc_accept_callhome_tls_sock(sock, host, port, ctx, NC_TRANSPORT_TIMEOUT,
+                client_opts.ch_binds_aux[idx].hostname);
+    } else
+#endif
+    {
+        close(sock);
+        *session = NULL;
+    }
+
+    free(host);
+
+    if (!(*session)) {
+        return -1;
+    }
+
+    return 1;
+}
+
+#endif /* NC_ENABLED_SSH || NC_ENABLED_TLS */
+
+/**
+ * @brief Hash a capability without its parameters.
+ *
+ * @param[in] cpblt Capability to hash.
+ * @param[out] len Length of the capability without its parameters.
+ * @return Hash of the capability.
+ */
+static uint32_t
+nc_client_cpblt_hash(const char *cpblt, size_t *len)
+{
+    *len = strcspn(cpblt, "?");
+    return nc_hash_fnv1a(NC_HASH_FNV1A_INIT, cpblt, *len);
+}
+
+/**
+ * @brief Free capabilities, including the strings.
+ *
+ * @param[in] cpblts NULL-terminated capabilities to free.
+ */
+static void
+nc_client_cpblts_free_list(char **cpblts)
+{
+    uint32_t i;
+
+    for (i = 0; cpblts[i]; ++i) {
+        free(cpblts[i]);
+    }
+    free(cpblts);
+}
+
+/**
+ * @brief Create the capability hash set of shared capabilities.
+ *
+ * @param[in] set Shared capabilities, on error the hash set is not created and all the lookups are linear.
+ */
+static void
+nc_client_cpblts_index(struct nc_client_cpblts *set)
+{
+    uint32_t size = 16, i, slot, hash;
+    size_t len, len2;
+
+    /* keep the load factor at most 1/2 */
+    while (size < 2 * set->count) {
+        size <<= 1;
+    }
+
+    set->idx = calloc(size, sizeof *set->idx);
+    if (!set->idx) {
+        ERRMEM;
+        return;
+    }
+    set->idx_size = size;
+
+    for (i = 0; i < set->count; ++i) {
+        hash = nc_client_cpblt_hash(set->cpblts[i], &len);
+        for (slot = hash & (size - 1); set->idx[slot]; slot = (slot + 1) & (size - 1)) {
+            nc_client_cpblt_hash(set->cpblts[set->idx[slot] - 1], &len2);
+            if ((len == len2) && !strncmp(set->cpblts[set->idx[slot] - 1], set->cpblts[i], len)) {
+                /* the first capability with the same URI is kept */
+                break;
+            }
+        }
+        if (!set->idx[slot]) {
+            set->idx[slot] = i + 1;
+        }
+    }
+}
+
+struct nc_client_cpblts *
+nc_client_cpblts_get(char **cpblts)
+{
+    struct nc_client_cpblts *set;
+    uint32_t hash = NC_HASH_FNV1A_INIT, count, i;
+
+    /* hash of all the capabilities, each including its terminating zero */
+    for (count = 0; cpblts[count]; ++count) {
+        hash = nc_hash_fnv1a(hash, cpblts[count], strlen(cpblts[count]) + 1);
+    }
+
+    /* LOCK */
+    pthread_mutex_lock(&cpblts_lock);
+
+    for (set = cpblts_sets; set; set = set->next) {
+        if ((set->hash != hash) || (set->count != count)) {
+            continue;
+        }
+        for (i = 0; (i < count) && !strcmp(set->cpblts[i], cpblts[i]); ++i) {}
+        if (i == count) {
+            /* the same capabilities are shared already */
+            ++set->refcount;
+            nc_client_cpblts_free_list(cpblts);
+            goto cleanup;
+        }
+    }
+
+    set = calloc(1, sizeof *set);
+    if (!set) {
+        ERRMEM;
+        nc_client_cpblts_free_list(cpblts);
+        goto cleanup;
+    }
+    set->refcount = 1;
+    set->hash = hash;
+    set->count = count;
+    set->cpblts = cpblts;
+    nc_client_cpblts_index(set);
+
+    set->next = cpblts_sets;
+    cpblts_sets = set;
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&cpblts_lock);
+    return set;
+}
+
+void
+nc_client_cpblts_release(struct nc_client_cpblts *cpblts)
+{
+    struct nc_client_cpblts **iter;
+
+    /* LOCK */
+    pthread_mutex_lock(&cpblts_lock);
+
+    if (--cpblts->refcount) {
+        /* still used */
+        cpblts = NULL;
+    } else {
+        for (iter = &cpblts_sets; *iter != cpblts; iter = &(*iter)->next) {}
+        *iter = cpblts->next;
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&cpblts_lock);
+
+    if (cpblts) {
+        nc_client_cpblts_free_list(cpblts->cpblts);
+        free(cpblts->idx);
+        free(cpblts);
+    }
+}
+
+API const char * const *
+nc_session_get_cpblts(const struct nc_session *session)
+{
+    if (!session) {
+        ERRARG("session");
+        return NULL;
+    }
+
+    if (!session->opts.client.cpblts) {
+        return NULL;
+    }
+    return (const char * const *)session->opts.client.cpblts->cpblts;
+}
+
+API const char *
+nc_session_cpblt(const struct nc_session *session, const char *capab)
+{
+    const struct nc_client_cpblts *set;
+    uint32_t i, hash, slot;
+    size_t len, base_len, base_len2;
+
+    if (!session) {
+        ERRARG("session");
+        return NULL;
+    } else if (!capab) {
+        ERRARG("capab");
+        return NULL;
+    }
+
+    set = session->opts.client.cpblts;
+    if (!set) {
+        return NULL;
+    }
+
+    len = strlen(capab);
+    hash = nc_client_cpblt_hash(capab, &base_len);
+    if (set->idx) {
+        /* find the first capability with the same URI */
+        for (slot = hash & (set->idx_size - 1); set->idx[slot]; slot = (slot + 1) & (set->idx_size - 1)) {
+            i = set->idx[slot] - 1;
+            nc_client_cpblt_hash(set->cpblts[i], &base_len2);
+            if ((base_len == base_len2) && !strncmp(set->cpblts[i], capab, base_len)) {
+                break;
+            }
+        }
+
+        if (set->idx[slot] && !strncmp(set->cpblts[i], capab, len)) {
+            return set->cpblts[i];
+        } else if (!set->idx[slot] && (capab[base_len] == '?')) {
+            /* any match would have the same URI */
+            return NULL;
+        }
+    }
+
+    /* only the beginning of a URI or no hash set, the capabilities must be searched */
+    for (i = 0; set->cpblts[i]; ++i) {
+        if (!strncmp(set->cpblts[i], capab, len)) {
+            return set->cpblts[i];
+        }
+    }
+
+    return NULL;
+}
+
+API int
+nc_session_ntf_thread_running(const struct nc_session *session)
+{
+    if (!session || (session->side != NC_CLIENT)) {
+        ERRARG("session");
+        return 0;
+    }
+
+    return ATOMIC_LOAD_RELAXED(session->opts.client.ntf_thread_running);
+}
+
+API void
+nc_client_init(void)
+{
+    nc_init();
+}
+
+#ifdef HAVE_EPOLL
+
+/* ACCESS locked with notif_reactor_lock, shared by all the threads */
+static struct nc_notif_reactor *notif_reactor;
+static pthread_mutex_t notif_reactor_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Queue a reactor session to be processed by a worker.
+ *
+ * @param[in] reactor Notification reactor, must be locked.
+ * @param[in] rsession Reactor session to queue.
+ */
+static void
+nc_notif_reactor_queue(struct nc_notif_reactor *reactor, struct nc_notif_reactor_session *rsession)
+{
+    rsession->state = NC_NTF_REACTOR_QUEUED;
+    rsession->next = NULL;
+    if (reactor->queue_tail) {
+        reactor->queue_tail->next = rsession;
+    } else {
+        reactor->queue_head = rsession;
+    }
+    reactor->queue_tail = rsession;
+
+    pthread_cond_signal(&reactor->event_cond);
+}
+
+/**
+ * @brief Stop dispatching a reactor session, which must not be queued. Its callback data must then be freed
+ * by ::nc_notif_reactor_finish() once unlocked.
+ *
+ * @param[in] reactor Notification reactor, must be locked.
+ * @param[in] rsession Reactor session to remove, freed by the I/O thread later.
+ */
+static void
+nc_notif_reactor_remove(struct nc_notif_reactor *reactor, struct nc_notif_reactor_session *rsession)
+{
+    struct epoll_event ev = {0};
+
+    /* may fail if the file descriptor was already closed, which is fine */
+    epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, rsession->fd, &ev);
+
+    --reactor->session_count;
+    if (rsession->idx < reactor->session_count) {
+        reactor->sessions[rsession->idx] = reactor->sessions[reactor->session_count];
+        reactor->sessions[rsession->idx]->idx = rsession->idx;
+    }
+    rsession->session->opts.client.ntf_reactor = NULL;
+    rsession->state = NC_NTF_REACTOR_REMOVED;
+
+    /* an epoll event already returned may still refer to it */
+    rsession->next = reactor->garbage;
+    reactor->garbage = rsession;
 }
 
-int
-nc_client_ch_del_bind(const char *address, uint16_t port, NC_TRANSPORT_IMPL ti)
+/**
+ * @brief Finish removing a reactor session, the session itself may be freed afterwards.
+ *
+ * @param[in] rsession Copy of the removed reactor session.
+ */
+static void
+nc_notif_reactor_finish(const struct nc_notif_reactor_session *rsession)
 {
-    uint32_t i;
-    int ret = -1;
+    VRB(rsession->session, "Notification reactor stopped dispatching the session.");
+    if (rsession->free_data) {
+        rsession->free_data(rsession->user_data);
+    }
+    ATOMIC_DEC_RELAXED(rsession->session->opts.client.ntf_thread_count);
+}
 
-    if (!address && !port && !ti) {
-        for (i = 0; i < client_opts.ch_bind_count; ++i) {
-            close(client_opts.ch_binds[i].sock);
-            free(client_opts.ch_binds[i].address);
+static void *
+nc_notif_reactor_io_thread(void *arg)
+{
+    struct nc_notif_reactor *reactor = arg;
+    struct nc_notif_reactor_session *rsession;
+    struct epoll_event events[NC_CLIENT_NOTIF_REACTOR_EVENTS];
+    uint64_t val;
+    int i, count;
+
+    while (1) {
+        /* LOCK */
+        pthread_mutex_lock(&notif_reactor_lock);
+        if (reactor->stop) {
+            /* UNLOCK */
+            pthread_mutex_unlock(&notif_reactor_lock);
+            break;
+        }
 
-            free(client_opts.ch_binds_aux[i].hostname);
+        /* all the events that could refer to the removed sessions were processed */
+        while (reactor->garbage) {
+            rsession = reactor->garbage;
+            reactor->garbage = rsession->next;
+            free(rsession);
+        }
 
-            ret = 0;
+        /* UNLOCK */
+        pthread_mutex_unlock(&notif_reactor_lock);
+
+        count = epoll_wait(reactor->epfd, events, NC_CLIENT_NOTIF_REACTOR_EVENTS, -1);
+        if (count == -1) {
+            if (errno != EINTR) {
+                ERR(NULL, "epoll_wait() failed (%s).", strerror(errno));
+                usleep(NC_TIMEOUT_STEP);
+            }
+            continue;
         }
-        client_opts.ch_bind_count = 0;
 
-        free(client_opts.ch_binds);
-        client_opts.ch_binds = NULL;
+        /* LOCK */
+        pthread_mutex_lock(&notif_reactor_lock);
 
-        free(client_opts.ch_binds_aux);
-        client_opts.ch_binds_aux = NULL;
-    } else {
-        for (i = 0; i < client_opts.ch_bind_count; ++i) {
-            if ((!address || !strcmp(client_opts.ch_binds[i].address, address)) &&
-                    (!port || (client_opts.ch_binds[i].port == port)) &&
-                    (!ti || (client_opts.ch_binds_aux[i].ti == ti))) {
-                close(client_opts.ch_binds[i].sock);
-                free(client_opts.ch_binds[i].address);
+        for (i = 0; i < count; ++i) {
+            rsession = events[i].data.ptr;
+            if (!rsession) {
+                /* consume the wake-up event */
+                if (read(reactor->wakefd, &val, sizeof val) == -1) {
+                    /* nothing to do, it is non-blocking */
+                }
+                continue;
+            }
 
-                --client_opts.ch_bind_count;
-                if (!client_opts.ch_bind_count) {
-                    free(client_opts.ch_binds);
-                    client_opts.ch_binds = NULL;
+            if (rsession->state == NC_NTF_REACTOR_IDLE) {
+                nc_notif_reactor_queue(reactor, rsession);
+            } else if (rsession->state == NC_NTF_REACTOR_BUSY) {
+                rsession->again = 1;
+            }
+        }
 
-                    free(client_opts.ch_binds_aux);
-                    client_opts.ch_binds_aux = NULL;
-                } else if (i < client_opts.ch_bind_count) {
-                    memcpy(&client_opts.ch_binds[i], &client_opts.ch_binds[client_opts.ch_bind_count],
-                            sizeof *client_opts.ch_binds);
+        /* UNLOCK */
+        pthread_mutex_unlock(&notif_reactor_lock);
+    }
 
-                    memcpy(&client_opts.ch_binds_aux[i], &client_opts.ch_binds_aux[client_opts.ch_bind_count],
-                            sizeof *client_opts.ch_binds_aux);
+    return NULL;
+}
+
+static void *
+nc_notif_reactor_worker_thread(void *arg)
+{
+    struct nc_notif_reactor *reactor = arg;
+    struct nc_notif_reactor_session *rsession, done;
+    struct nc_session *session;
+    struct lyd_node *envp, *op;
+    struct epoll_event ev = {0};
+    NC_MSG_TYPE msgtype;
+    uint32_t count;
+    int finished;
+
+    while (1) {
+        /* LOCK */
+        pthread_mutex_lock(&notif_reactor_lock);
+
+        while (!reactor->queue_head && !reactor->stop) {
+            pthread_cond_wait(&reactor->event_cond, &notif_reactor_lock);
+        }
+        if (reactor->stop) {
+            /* UNLOCK */
+            pthread_mutex_unlock(&notif_reactor_lock);
+            break;
+        }
+
+        rsession = reactor->queue_head;
+        reactor->queue_head = rsession->next;
+        if (!reactor->queue_head) {
+            reactor->queue_tail = NULL;
+        }
+        rsession->state = NC_NTF_REACTOR_BUSY;
+        rsession->again = 0;
+        finished = rsession->stop;
+        session = rsession->session;
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&notif_reactor_lock);
+
+        /* receive all the notifications available, only this thread works with the session */
+        for (count = 0; !finished && (count < NC_CLIENT_NOTIF_REACTOR_BATCH); ++count) {
+            if (!ATOMIC_LOAD_RELAXED(session->opts.client.ntf_thread_running)) {
+                finished = 1;
+                break;
+            }
+
+            msgtype = nc_recv_notif(session, 0, &envp, &op);
+            if (msgtype == NC_MSG_NOTIF) {
+                rsession->notif_clb(session, envp, op, rsession->user_data);
+                if (!strcmp(op->schema->name, "notificationComplete") &&
+                        !strcmp(op->schema->module->name, "nc-notifications")) {
+                    finished = 1;
+                }
+                lyd_free_tree(envp);
+                lyd_free_tree(op);
+            } else if (msgtype != NC_MSG_REPLY) {
+                if ((msgtype == NC_MSG_ERROR) && (session->status != NC_STATUS_RUNNING)) {
+                    /* the session is broken */
+                    finished = 1;
                 }
+                break;
+            }
+        }
 
-                ret = 0;
+        /* LOCK */
+        pthread_mutex_lock(&notif_reactor_lock);
+
+        if (!finished && !rsession->stop) {
+            if ((count == NC_CLIENT_NOTIF_REACTOR_BATCH) || rsession->again) {
+                /* there may be more notifications, let other sessions be processed first */
+                nc_notif_reactor_queue(reactor, rsession);
+            } else {
+                /* wait for more data */
+                rsession->state = NC_NTF_REACTOR_IDLE;
+                ev.events = EPOLLIN | EPOLLONESHOT;
+                ev.data.ptr = rsession;
+                if (epoll_ctl(reactor->epfd, EPOLL_CTL_MOD, rsession->fd, &ev) == -1) {
+                    ERR(session, "Failed to wait for notifications of the session (%s).", strerror(errno));
+                    finished = 1;
+                }
             }
+        } else {
+            finished = 1;
+        }
+
+        if (finished) {
+            nc_notif_reactor_remove(reactor, rsession);
+            done = *rsession;
+        }
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&notif_reactor_lock);
+
+        if (finished) {
+            nc_notif_reactor_finish(&done);
         }
     }
 
-    return ret;
+    return NULL;
 }
 
-API int
-nc_accept_callhome(int timeout, struct ly_ctx *ctx, struct nc_session **session)
+/**
+ * @brief Stop a notification reactor and free it, all its sessions stop being dispatched.
+ *
+ * @param[in] reactor Notification reactor, no longer accessible by other threads.
+ * @param[in] worker_count Number of the worker threads running.
+ * @param[in] io_thread Whether the I/O thread is running.
+ */
+static void
+nc_notif_reactor_destroy(struct nc_notif_reactor *reactor, uint16_t worker_count, int io_thread)
 {
-    int sock;
-    char *host = NULL;
-    uint16_t port, idx;
+    struct nc_notif_reactor_session *rsession, done;
+    uint64_t val = 1;
+    uint16_t i;
+
+    /* LOCK */
+    pthread_mutex_lock(&notif_reactor_lock);
+    reactor->stop = 1;
+    pthread_cond_broadcast(&reactor->event_cond);
+    /* UNLOCK */
+    pthread_mutex_unlock(&notif_reactor_lock);
+
+    if (io_thread) {
+        if (write(reactor->wakefd, &val, sizeof val) == -1) {
+            /* counter overflow is not possible in practice, nothing to do */
+        }
+        pthread_join(reactor->io_tid, NULL);
+    }
+    for (i = 0; i < worker_count; ++i) {
+        pthread_join(reactor->worker_tids[i], NULL);
+    }
 
-    if (!client_opts.ch_binds) {
-        ERRINIT;
-        return -1;
-    } else if (!session) {
-        ERRARG("session");
-        return -1;
+    /* no threads left, remove all the sessions */
+    while (1) {
+        /* LOCK */
+        pthread_mutex_lock(&notif_reactor_lock);
+        if (!reactor->session_count) {
+            /* UNLOCK */
+            pthread_mutex_unlock(&notif_reactor_lock);
+            break;
+        }
+        nc_notif_reactor_remove(reactor, reactor->sessions[0]);
+        done = *reactor->garbage;
+        /* UNLOCK */
+        pthread_mutex_unlock(&notif_reactor_lock);
+
+        nc_notif_reactor_finish(&done);
     }
 
-    sock = nc_sock_accept_binds(client_opts.ch_binds, client_opts.ch_bind_count, timeout, &host, &port, &idx);
-    if (sock < 1) {
-        free(host);
-        return sock;
+    while (reactor->garbage) {
+        rsession = reactor->garbage;
+        reactor->garbage = rsession->next;
+        free(rsession);
+    }
+    if (reactor->wakefd > -1) {
+        close(reactor->wakefd);
     }
+    if (reactor->epfd > -1) {
+        close(reactor->epfd);
+    }
+    pthread_cond_destroy(&reactor->event_cond);
+    free(reactor->sessions);
+    free(reactor->worker_tids);
+    free(reactor);
+}
 
-#ifdef NC_ENABLED_SSH
-    if (client_opts.ch_binds_aux[idx].ti == NC_TI_LIBSSH) {
-        *session = nc_accept_callhome_ssh_sock(sock, host, port, ctx, NC_TRANSPORT_TIMEOUT);
-    } else
-#endif
-#ifdef NC_ENABLED_TLS
-    if (client_opts.ch_binds_aux[idx].ti == NC_TI_OPENSSL) {
-        *session = nc_accept_callhome_tls_sock(sock, host, port, ctx, NC_TRANSPORT_TIMEOUT,
-                client_opts.ch_binds_aux[idx].hostname);
-    } else
-#endif
-    {
-        close(sock);
-        *session = NULL;
+/**
+ * @brief Create and start a notification reactor.
+ *
+ * @param[in] worker_count Number of the worker threads.
+ * @return Running notification reactor, NULL on error.
+ */
+static struct nc_notif_reactor *
+nc_notif_reactor_new(uint16_t worker_count)
+{
+    struct nc_notif_reactor *reactor;
+    struct epoll_event ev = {0};
+    uint16_t i;
+    int r;
+
+    reactor = calloc(1, sizeof *reactor);
+    if (!reactor) {
+        ERRMEM;
+        return NULL;
     }
+    pthread_cond_init(&reactor->event_cond, NULL);
 
-    free(host);
+    reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+    reactor->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((reactor->epfd == -1) || (reactor->wakefd == -1)) {
+        ERR(NULL, "Failed to create a notification reactor (%s).", strerror(errno));
+        nc_notif_reactor_destroy(reactor, 0, 0);
+        return NULL;
+    }
 
-    if (!(*session)) {
-        return -1;
+    /* NULL data pointer marks the wake-up event */
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, reactor->wakefd, &ev) == -1) {
+        ERR(NULL, "Failed to add an eventfd into epoll (%s).", strerror(errno));
+        nc_notif_reactor_destroy(reactor, 0, 0);
+        return NULL;
     }
 
-    return 1;
-}
+    reactor->worker_tids = malloc(worker_count * sizeof *reactor->worker_tids);
+    if (!reactor->worker_tids) {
+        ERRMEM;
+        nc_notif_reactor_destroy(reactor, 0, 0);
+        return NULL;
+    }
 
-#endif /* NC_ENABLED_SSH || NC_ENABLED_TLS */
+    /* workers */
+    for (i = 0; i < worker_count; ++i) {
+        r = pthread_create(&reactor->worker_tids[i], NULL, nc_notif_reactor_worker_thread, reactor);
+        if (r) {
+            ERR(NULL, "Creating a new thread failed (%s).", strerror(r));
+            nc_notif_reactor_destroy(reactor, i, 0);
+            return NULL;
+        }
+    }
+    reactor->worker_count = worker_count;
 
-API const char * const *
-nc_session_get_cpblts(const struct nc_session *session)
-{
-    if (!session) {
-        ERRARG("session");
+    /* waiting for data */
+    r = pthread_create(&reactor->io_tid, NULL, nc_notif_reactor_io_thread, reactor);
+    if (r) {
+        ERR(NULL, "Creating a new thread failed (%s).", strerror(r));
+        nc_notif_reactor_destroy(reactor, reactor->worker_count, 0);
         return NULL;
     }
 
-    return (const char * const *)session->opts.client.cpblts;
+    return reactor;
 }
 
-API const char *
-nc_session_cpblt(const struct nc_session *session, const char *capab)
+/**
+ * @brief Start dispatching notifications of a session by the notification reactor.
+ *
+ * @param[in] session Session to dispatch.
+ * @param[in] notif_clb Notification callback.
+ * @param[in] user_data Arbitrary user data for @p notif_clb.
+ * @param[in] free_data Callback for freeing @p user_data.
+ * @return 1 if the session is dispatched by the reactor;
+ * @return 0 if the reactor is not used or cannot be used for the session;
+ * @return -1 on error.
+ */
+static int
+nc_notif_reactor_add(struct nc_session *session, nc_notif_dispatch_clb notif_clb, void *user_data,
+        void (*free_data)(void *))
 {
-    int i, len;
+    struct nc_notif_reactor *reactor;
+    struct nc_notif_reactor_session *rsession = NULL, **sessions;
+    struct epoll_event ev = {0};
+    int ret = 0;
 
-    if (!session) {
-        ERRARG("session");
-        return NULL;
-    } else if (!capab) {
-        ERRARG("capab");
-        return NULL;
+    /* LOCK */
+    pthread_mutex_lock(&notif_reactor_lock);
+
+    reactor = notif_reactor;
+    if (!reactor || session->opts.client.ntf_reactor) {
+        /* no reactor or already dispatched by it, use a thread */
+        goto cleanup;
     }
 
-    len = strlen(capab);
-    for (i = 0; session->opts.client.cpblts[i]; ++i) {
-        if (!strncmp(session->opts.client.cpblts[i], capab, len)) {
-            return session->opts.client.cpblts[i];
+    rsession = calloc(1, sizeof *rsession);
+    sessions = realloc(reactor->sessions, (reactor->session_count + 1) * sizeof *reactor->sessions);
+    if (!rsession || !sessions) {
+        ERRMEM;
+        ret = -1;
+        goto cleanup;
+    }
+    reactor->sessions = sessions;
+
+    rsession->session = session;
+    rsession->notif_clb = notif_clb;
+    rsession->user_data = user_data;
+    rsession->free_data = free_data;
+    rsession->fd = nc_session_ti_fd(session);
+    if (rsession->fd == -1) {
+        goto cleanup;
+    }
+
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = rsession;
+    if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, rsession->fd, &ev) == -1) {
+        /* most likely an SSH session with several NETCONF sessions, use a thread */
+        VRB(session, "Session cannot be dispatched by the notification reactor (%s).", strerror(errno));
+        goto cleanup;
+    }
+
+    rsession->idx = reactor->session_count;
+    reactor->sessions[reactor->session_count++] = rsession;
+    session->opts.client.ntf_reactor = rsession;
+    ATOMIC_INC_RELAXED(session->opts.client.ntf_thread_count);
+    ATOMIC_STORE_RELAXED(session->opts.client.ntf_thread_running, 1);
+
+    /* some notifications may have been received already */
+    nc_notif_reactor_queue(reactor, rsession);
+    rsession = NULL;
+    ret = 1;
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&notif_reactor_lock);
+
+    free(rsession);
+    return ret;
+}
+
+/**
+ * @brief Let the notification reactor know that a notification of a session was received by another reader.
+ *
+ * @param[in] session Session with the notification buffered.
+ */
+static void
+nc_notif_reactor_wake(struct nc_session *session)
+{
+    struct nc_notif_reactor_session *rsession;
+
+    /* LOCK */
+    pthread_mutex_lock(&notif_reactor_lock);
+
+    rsession = session->opts.client.ntf_reactor;
+    if (rsession && notif_reactor) {
+        if (rsession->state == NC_NTF_REACTOR_IDLE) {
+            nc_notif_reactor_queue(notif_reactor, rsession);
+        } else if (rsession->state == NC_NTF_REACTOR_BUSY) {
+            rsession->again = 1;
         }
     }
 
-    return NULL;
+    /* UNLOCK */
+    pthread_mutex_unlock(&notif_reactor_lock);
+}
+
+void
+nc_client_notif_reactor_del(struct nc_session *session)
+{
+    struct nc_notif_reactor_session *rsession, done;
+    int removed = 0;
+
+    /* LOCK */
+    pthread_mutex_lock(&notif_reactor_lock);
+
+    rsession = session->opts.client.ntf_reactor;
+    if (rsession && notif_reactor) {
+        if (rsession->state == NC_NTF_REACTOR_IDLE) {
+            nc_notif_reactor_remove(notif_reactor, rsession);
+            done = *rsession;
+            removed = 1;
+        } else {
+            /* the worker will remove it */
+            rsession->stop = 1;
+        }
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&notif_reactor_lock);
+
+    if (removed) {
+        nc_notif_reactor_finish(&done);
+    }
+}
+
+/**
+ * @brief Stop the notification reactor, if running.
+ */
+static void
+nc_client_notif_reactor_clear(void)
+{
+    struct nc_notif_reactor *reactor;
+
+    /* LOCK */
+    pthread_mutex_lock(&notif_reactor_lock);
+    reactor = notif_reactor;
+    notif_reactor = NULL;
+    /* UNLOCK */
+    pthread_mutex_unlock(&notif_reactor_lock);
+
+    if (reactor) {
+        nc_notif_reactor_destroy(reactor, reactor->worker_count, 1);
+    }
+}
+
+#else
+
+void
+nc_client_notif_reactor_del(struct nc_session *session)
+{
+    (void)session;
 }
 
+#endif /* HAVE_EPOLL */
+
 API int
-nc_session_ntf_thread_running(const struct nc_session *session)
+nc_client_set_notif_reactor(uint16_t worker_count)
 {
-    if (!session || (session->side != NC_CLIENT)) {
-        ERRARG("session");
+#ifdef HAVE_EPOLL
+    struct nc_notif_reactor *reactor = NULL;
+
+    /* LOCK */
+    pthread_mutex_lock(&notif_reactor_lock);
+    if (notif_reactor && (notif_reactor->worker_count == worker_count)) {
+        /* UNLOCK */
+        pthread_mutex_unlock(&notif_reactor_lock);
         return 0;
+    } else if (notif_reactor && notif_reactor->session_count) {
+        /* UNLOCK */
+        pthread_mutex_unlock(&notif_reactor_lock);
+        ERR(NULL, "Cannot change the notification reactor while it is dispatching sessions.");
+        return -1;
     }
+    /* UNLOCK */
+    pthread_mutex_unlock(&notif_reactor_lock);
 
-    return ATOMIC_LOAD_RELAXED(session->opts.client.ntf_thread_running);
+    nc_client_notif_reactor_clear();
+
+    if (worker_count) {
+        reactor = nc_notif_reactor_new(worker_count);
+        if (!reactor) {
+            return -1;
+        }
+
+        /* LOCK */
+        pthread_mutex_lock(&notif_reactor_lock);
+        notif_reactor = reactor;
+        /* UNLOCK */
+        pthread_mutex_unlock(&notif_reactor_lock);
+    }
+
+    return 0;
+#else
+    if (worker_count) {
+        ERR(NULL, "Notification reactor is not supported without epoll.");
+        return -1;
+    }
+
+    return 0;
+#endif
 }
 
-API void
-nc_client_init(void)
+API uint16_t
+nc_client_get_notif_reactor(void)
 {
-    nc_init();
+    uint16_t worker_count = 0;
+
+#ifdef HAVE_EPOLL
+    /* LOCK */
+    pthread_mutex_lock(&notif_reactor_lock);
+    if (notif_reactor) {
+        worker_count = notif_reactor->worker_count;
+    }
+    /* UNLOCK */
+    pthread_mutex_unlock(&notif_reactor_lock);
+#endif
+
+    return worker_count;
 }
 
 API void
 nc_client_destroy(void)
 {
     nc_client_set_schema_searchpath(NULL);
+    nc_client_set_schema_cache_dir(NULL);
+    nc_client_ctx_pool_clear();
+#ifdef HAVE_EPOLL
+    nc_client_notif_reactor_clear();
+#endif
 #if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
     nc_client_ch_del_bind(NULL, 0, 0);
 #endif
@@ -1929,25 +4035,16 @@ nc_client_destroy(void)
 static NC_MSG_TYPE
 recv_reply_check_msgid(struct nc_session *session, const struct lyd_node *envp, uint64_t msgid)
 {
-    char *ptr;
-    struct lyd_attr *attr;
     uint64_t cur_msgid;
 
     assert(envp && !envp->schema);
 
     /* find the message-id attribute */
-    LY_LIST_FOR(((struct lyd_node_opaq *)envp)->attr, attr) {
-        if (!strcmp(attr->name.name, "message-id")) {
-            break;
-        }
-    }
-
-    if (!attr) {
+    if (nc_reply_get_msgid(envp, &cur_msgid)) {
         ERR(session, "Received a <rpc-reply> without a message-id.");
         return NC_MSG_REPLY_ERR_MSGID;
     }
 
-    cur_msgid = strtoul(attr->value, &ptr, 10);
     if (cur_msgid != msgid) {
         ERR(session, "Received a <rpc-reply> with an unexpected message-id %" PRIu64 " (expected %" PRIu64 ").",
                 cur_msgid, msgid);
@@ -1957,6 +4054,190 @@ recv_reply_check_msgid(struct nc_session *session, const struct lyd_node *envp,
     return NC_MSG_REPLY;
 }
 
+/**
+ * @brief Learn the message-id of a received rpc-reply without parsing it.
+ *
+ * @param[in] msg Received rpc-reply.
+ * @return Message-id of the reply, 0 if there is none.
+ */
+static uint64_t
+recv_reply_peek_msgid(struct ly_in *msg)
+{
+    const char *str, *end;
+
+    str = strstr(ly_in_memory(msg, NULL), "rpc-reply");
+    if (!str || !(end = strchr(str, '>'))) {
+        return 0;
+    }
+
+    /* only the attributes of the rpc-reply element */
+    for (str += 9; str < end; ++str) {
+        if (strncmp(str, "message-id", 10)) {
+            continue;
+        }
+        str += 10;
+
+        while (isspace(*str)) {
+            ++str;
+        }
+        if (*str != '=') {
+            continue;
+        }
+        ++str;
+        while (isspace(*str)) {
+            ++str;
+        }
+        if ((*str != '\"') && (*str != '\'')) {
+            continue;
+        }
+
+        return strtoull(str + 1, NULL, 10);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Find an RPC waiting for its reply. Message-ids are sequential so they are used as the hash directly.
+ *
+ * @param[in] session NETCONF client session, MSGS lock is expected to be held.
+ * @param[in] msgid Message-id of the RPC.
+ * @return Found RPC, NULL if there is none.
+ */
+static struct nc_rpc_pending *
+rpc_pending_find(const struct nc_session *session, uint64_t msgid)
+{
+    const struct nc_rpc_pending *rpcs = session->opts.client.rpcs;
+    uint32_t i, mask;
+
+    if (!msgid || !session->opts.client.rpc_count) {
+        return NULL;
+    }
+
+    mask = session->opts.client.rpc_size - 1;
+    for (i = msgid & mask; rpcs[i].msgid; i = (i + 1) & mask) {
+        if (rpcs[i].msgid == msgid) {
+            return (struct nc_rpc_pending *)&rpcs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Add an RPC waiting for its reply.
+ *
+ * @param[in] session NETCONF client session, MSGS lock is expected to be held.
+ * @param[in] rpc RPC to add.
+ * @return 0 on success, -1 on error.
+ */
+static int
+rpc_pending_add(struct nc_session *session, const struct nc_rpc_pending *rpc)
+{
+    struct nc_rpc_pending *rpcs;
+    uint32_t i, j, size, mask;
+
+    if ((session->opts.client.rpc_count + 1) * 2 > session->opts.client.rpc_size) {
+        /* enlarge the table */
+        size = session->opts.client.rpc_size ? session->opts.client.rpc_size * 2 : NC_NAME_INDEX_MIN_SIZE;
+        rpcs = calloc(size, sizeof *rpcs);
+        if (!rpcs) {
+            ERRMEM;
+            return -1;
+        }
+
+        mask = size - 1;
+        for (i = 0; i < session->opts.client.rpc_size; ++i) {
+            if (!session->opts.client.rpcs[i].msgid) {
+                continue;
+            }
+            for (j = session->opts.client.rpcs[i].msgid & mask; rpcs[j].msgid; j = (j + 1) & mask) {}
+            rpcs[j] = session->opts.client.rpcs[i];
+        }
+
+        free(session->opts.client.rpcs);
+        session->opts.client.rpcs = rpcs;
+        session->opts.client.rpc_size = size;
+    }
+
+    mask = session->opts.client.rpc_size - 1;
+    for (i = rpc->msgid & mask; session->opts.client.rpcs[i].msgid; i = (i + 1) & mask) {}
+    session->opts.client.rpcs[i] = *rpc;
+    ++session->opts.client.rpc_count;
+
+    return 0;
+}
+
+/**
+ * @brief Remove an RPC waiting for its reply, its data are not freed.
+ *
+ * @param[in] session NETCONF client session, MSGS lock is expected to be held.
+ * @param[in] rpc RPC to remove.
+ */
+static void
+rpc_pending_del(struct nc_session *session, struct nc_rpc_pending *rpc)
+{
+    struct nc_rpc_pending *rpcs = session->opts.client.rpcs;
+    uint32_t i, j, home, mask;
+
+    mask = session->opts.client.rpc_size - 1;
+    i = rpc - rpcs;
+    rpcs[i].msgid = 0;
+
+    /* shift back the following RPCs so that no lookup stops at the freed slot */
+    for (j = (i + 1) & mask; rpcs[j].msgid; j = (j + 1) & mask) {
+        home = rpcs[j].msgid & mask;
+        if ((i <= j) ? ((home <= i) || (home > j)) : ((home <= i) && (home > j))) {
+            rpcs[i] = rpcs[j];
+            rpcs[j].msgid = 0;
+            i = j;
+        }
+    }
+
+    --session->opts.client.rpc_count;
+}
+
+void
+nc_client_rpc_pending_free(struct nc_session *session)
+{
+    struct nc_rpc_pending *rpcs;
+    uint32_t i, size;
+    int r, timeout;
+
+    do {
+        /* MSGS LOCK */
+        timeout = NC_SESSION_FREE_LOCK_TIMEOUT;
+        r = nc_session_client_msgs_lock(session, &timeout, __func__);
+
+        /* detach the RPCs so that the callbacks may use the session */
+        rpcs = session->opts.client.rpcs;
+        size = session->opts.client.rpc_size;
+        session->opts.client.rpcs = NULL;
+        session->opts.client.rpc_size = 0;
+        session->opts.client.rpc_count = 0;
+
+        if (r == 1) {
+            /* MSGS UNLOCK */
+            nc_session_client_msgs_unlock(session, __func__);
+        }
+
+        for (i = 0; i < size; ++i) {
+            if (!rpcs[i].msgid) {
+                continue;
+            }
+
+            if (rpcs[i].reply_clb) {
+                rpcs[i].reply_clb(session, rpcs[i].msgid, NC_MSG_ERROR, NULL, NULL, rpcs[i].user_data);
+            }
+            lyd_free_tree(rpcs[i].envp);
+            lyd_free_tree(rpcs[i].op);
+        }
+        free(rpcs);
+
+        /* the callbacks may have sent other RPCs, they are freed as well */
+    } while (session->opts.client.rpcs);
+}
+
 /**
  * @brief Used to roughly estimate the type of the message, does not actually parse or verify it.
  *
@@ -2033,7 +4314,9 @@ recv_msg(struct nc_session *session, int timeout, NC_MSG_TYPE expected, struct l
     struct nc_msg_cont **cont_ptr;
     struct ly_in *msg = NULL;
     struct nc_msg_cont *cont, *prev;
+    struct timespec ts;
     NC_MSG_TYPE ret = NC_MSG_ERROR;
+    uint64_t msgid;
     int r;
 
     *message = NULL;
@@ -2048,9 +4331,12 @@ recv_msg(struct nc_session *session, int timeout, NC_MSG_TYPE expected, struct l
         goto cleanup;
     }
 
-    /* Find the expected message in the buffer */
+    /* Find the expected message in the buffer, replies to asynchronous RPCs are never returned */
     prev = NULL;
-    for (cont = session->opts.client.msgs; cont && (cont->type != expected); cont = cont->next) {
+    for (cont = session->opts.client.msgs; cont; cont = cont->next) {
+        if ((cont->type == expected) && ((expected != NC_MSG_REPLY) || !rpc_pending_find(session, cont->msgid))) {
+            break;
+        }
         prev = cont;
     }
 
@@ -2069,6 +4355,11 @@ recv_msg(struct nc_session *session, int timeout, NC_MSG_TYPE expected, struct l
         goto cleanup_unlock;
     }
 
+    if (timeout > 0) {
+        nc_gettimespec_mono_add(&ts, timeout);
+    }
+
+read_msg:
     /* Read a message from the wire */
     r = nc_read_msg_poll_io(session, timeout, &msg);
     if (!r) {
@@ -2084,9 +4375,10 @@ recv_msg(struct nc_session *session, int timeout, NC_MSG_TYPE expected, struct l
     if (ret == NC_MSG_ERROR) {
         goto cleanup_unlock;
     }
+    msgid = (ret == NC_MSG_REPLY) ? recv_reply_peek_msgid(msg) : 0;
 
     /* If received a message of different type store it in the buffer */
-    if (ret != expected) {
+    if ((ret != expected) || ((ret == NC_MSG_REPLY) && rpc_pending_find(session, msgid))) {
         cont_ptr = &session->opts.client.msgs;
         while (*cont_ptr) {
             cont_ptr = &((*cont_ptr)->next);
@@ -2100,7 +4392,23 @@ recv_msg(struct nc_session *session, int timeout, NC_MSG_TYPE expected, struct l
         (*cont_ptr)->msg = msg;
         msg = NULL;
         (*cont_ptr)->type = ret;
+        (*cont_ptr)->msgid = msgid;
         (*cont_ptr)->next = NULL;
+#ifdef HAVE_EPOLL
+        if (ret == NC_MSG_NOTIF) {
+            nc_notif_reactor_wake(session);
+        }
+#endif
+
+        if ((ret == expected) && timeout) {
+            /* reply to an asynchronous RPC, keep waiting for the expected one */
+            if ((timeout < 0) || ((timeout = nc_difftimespec_mono_cur(&ts)) > 0)) {
+                goto read_msg;
+            }
+            ret = NC_MSG_WOULDBLOCK;
+        } else if (ret == expected) {
+            ret = NC_MSG_WOULDBLOCK;
+        }
     }
 
 cleanup_unlock:
@@ -2135,6 +4443,11 @@ recv_reply(struct nc_session *session, int timeout, struct lyd_node *op, uint64_
 
     /* parse */
     lyrc = lyd_parse_op(NULL, op, msg, LYD_XML, LYD_TYPE_REPLY_NETCONF, envp, NULL);
+
+    /* the raw message is not needed anymore, free it before any further processing */
+    ly_in_free(msg, 1);
+    msg = NULL;
+
     if (!lyrc) {
         ret = recv_reply_check_msgid(session, *envp, msgid);
         goto cleanup;
@@ -2290,40 +4603,310 @@ recv_reply_dup_rpc(struct nc_session *session, struct nc_rpc *rpc, struct lyd_no
         break;
     }
 
-    if (module_name && rpc_name) {
-        mod = ly_ctx_get_module_implemented(session->ctx, module_name);
-        if (!mod) {
-            ERR(session, "Missing \"%s\" module in the context.", module_name);
-            return -1;
-        }
+    if (module_name && rpc_name) {
+        mod = ly_ctx_get_module_implemented(session->ctx, module_name);
+        if (!mod) {
+            ERR(session, "Missing \"%s\" module in the context.", module_name);
+            return -1;
+        }
+
+        /* create the operation node */
+        lyrc = lyd_new_inner(NULL, mod, rpc_name, 0, op);
+    }
+    if (module_check) {
+        if (!ly_ctx_get_module_implemented(session->ctx, module_check)) {
+            ERR(session, "Missing \"%s\" module in the context.", module_check);
+            return -1;
+        }
+    }
+
+    if (lyrc) {
+        return -1;
+    }
+    return 0;
+}
+
+API NC_MSG_TYPE
+nc_recv_reply(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, int timeout, struct lyd_node **envp,
+        struct lyd_node **op)
+{
+    NC_MSG_TYPE ret;
+
+    if (!session) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
+    } else if (!rpc) {
+        ERRARG("rpc");
+        return NC_MSG_ERROR;
+    } else if (!envp) {
+        ERRARG("envp");
+        return NC_MSG_ERROR;
+    } else if (!op) {
+        ERRARG("op");
+        return NC_MSG_ERROR;
+    } else if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to receive RPC replies.");
+        return NC_MSG_ERROR;
+    }
+
+    /* get a duplicate of the RPC node to append reply to */
+    if (recv_reply_dup_rpc(session, rpc, op)) {
+        return NC_MSG_ERROR;
+    }
+
+    /* receive a reply */
+    ret = recv_reply(session, timeout, *op, msgid, envp);
+
+    /* do not return the RPC copy on error or if the reply includes no data */
+    if (((ret != NC_MSG_REPLY) && (ret != NC_MSG_REPLY_ERR_MSGID)) || !lyd_child(*op)) {
+        lyd_free_tree(*op);
+        *op = NULL;
+    }
+    return ret;
+}
+
+/**
+ * @brief Receive a reply to an RPC sent asynchronously and finish the RPC.
+ *
+ * @param[in] session NETCONF session from which this function receives messages.
+ * @param[in] timeout Timeout for reading in milliseconds. Use negative value for infinite.
+ * @return 1 if a reply was received;
+ * @return 0 if not, on timeout or when another message was received;
+ * @return -1 on error.
+ */
+static int
+recv_reply_async(struct nc_session *session, int timeout)
+{
+    struct nc_msg_cont **cont_ptr;
+    struct nc_msg_cont *cont, *prev;
+    struct nc_rpc_pending *rpc = NULL, rpc_done = {0};
+    struct ly_in *msg = NULL;
+    struct lyd_node *envp = NULL;
+    NC_MSG_TYPE type;
+    uint64_t msgid;
+    int r, ret = 0;
+
+    /* MSGS LOCK */
+    r = nc_session_client_msgs_lock(session, &timeout, __func__);
+    if (r < 1) {
+        return r;
+    }
+
+    /* the reply may have been received already */
+    prev = NULL;
+    for (cont = session->opts.client.msgs; cont; cont = cont->next) {
+        if ((cont->type == NC_MSG_REPLY) && (rpc = rpc_pending_find(session, cont->msgid)) &&
+                (rpc->type == NC_MSG_NONE)) {
+            break;
+        }
+        prev = cont;
+    }
+
+    if (cont) {
+        /* remove found message from buffer */
+        if (prev) {
+            prev->next = cont->next;
+        } else {
+            session->opts.client.msgs = cont->next;
+        }
+        msg = cont->msg;
+        free(cont);
+    } else {
+        /* read a message from the wire */
+        ret = nc_read_msg_poll_io(session, timeout, &msg);
+        if (ret < 1) {
+            goto cleanup_unlock;
+        }
+        ret = 0;
+
+        type = get_msg_type(session, msg);
+        if (type == NC_MSG_ERROR) {
+            ret = -1;
+            goto cleanup_unlock;
+        }
+        msgid = (type == NC_MSG_REPLY) ? recv_reply_peek_msgid(msg) : 0;
+
+        rpc = rpc_pending_find(session, msgid);
+        if (!rpc || (rpc->type != NC_MSG_NONE)) {
+            /* not a reply to an asynchronous RPC, store it in the buffer */
+            cont_ptr = &session->opts.client.msgs;
+            while (*cont_ptr) {
+                cont_ptr = &((*cont_ptr)->next);
+            }
+            *cont_ptr = malloc(sizeof **cont_ptr);
+            if (!*cont_ptr) {
+                ERRMEM;
+                ret = -1;
+                goto cleanup_unlock;
+            }
+            (*cont_ptr)->msg = msg;
+            msg = NULL;
+            (*cont_ptr)->type = type;
+            (*cont_ptr)->msgid = msgid;
+            (*cont_ptr)->next = NULL;
+#ifdef HAVE_EPOLL
+            if (type == NC_MSG_NOTIF) {
+                nc_notif_reactor_wake(session);
+            }
+#endif
+            goto cleanup_unlock;
+        }
+    }
+
+    /* parse the reply */
+    if (lyd_parse_op(NULL, rpc->op, msg, LYD_XML, LYD_TYPE_REPLY_NETCONF, &envp, NULL)) {
+        ERR(session, "Received an invalid message (%s).", ly_errmsg(LYD_CTX(rpc->op)));
+        lyd_free_tree(envp);
+        envp = NULL;
+        rpc->type = NC_MSG_ERROR;
+    } else {
+        rpc->type = NC_MSG_REPLY;
+    }
+    ret = 1;
+
+    if (rpc->reply_clb) {
+        /* the callback is called once unlocked */
+        rpc_done = *rpc;
+        rpc_done.envp = envp;
+        rpc_pending_del(session, rpc);
+    } else {
+        /* keep it until retrieved */
+        rpc->envp = envp;
+    }
+
+cleanup_unlock:
+    /* MSGS UNLOCK */
+    nc_session_client_msgs_unlock(session, __func__);
+
+    ly_in_free(msg, 1);
+    if (rpc_done.reply_clb) {
+        rpc_done.reply_clb(session, rpc_done.msgid, rpc_done.type, rpc_done.envp,
+                ((rpc_done.type == NC_MSG_REPLY) && lyd_child(rpc_done.op)) ? rpc_done.op : NULL, rpc_done.user_data);
+        lyd_free_tree(rpc_done.envp);
+        lyd_free_tree(rpc_done.op);
+    }
+    return ret;
+}
+
+API NC_MSG_TYPE
+nc_send_rpc_async(struct nc_session *session, struct nc_rpc *rpc, int timeout, nc_rpc_reply_clb reply_clb,
+        void *user_data, uint64_t *msgid)
+{
+    struct nc_rpc_pending pending = {0}, *rpc_p;
+    NC_MSG_TYPE ret;
+    uint64_t sent_msgid;
+    int r;
+
+    if (!session) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
+    } else if (!rpc) {
+        ERRARG("rpc");
+        return NC_MSG_ERROR;
+    } else if (!msgid) {
+        ERRARG("msgid");
+        return NC_MSG_ERROR;
+    } else if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to send RPCs.");
+        return NC_MSG_ERROR;
+    }
+
+    /* prepare the operation to parse the reply into */
+    if (recv_reply_dup_rpc(session, rpc, &pending.op)) {
+        return NC_MSG_ERROR;
+    }
+    pending.type = NC_MSG_NONE;
+    pending.reply_clb = reply_clb;
+    pending.user_data = user_data;
+
+    /* MSGS LOCK, held until the RPC is sent so that no reply is received before the RPC is waited for */
+    r = nc_session_client_msgs_lock(session, &timeout, __func__);
+    if (r != 1) {
+        lyd_free_tree(pending.op);
+        return r ? NC_MSG_ERROR : NC_MSG_WOULDBLOCK;
+    }
+
+    /* wait for the reply with the message-id the RPC should get */
+    pending.msgid = session->opts.client.msgid + 1;
+    if (rpc_pending_add(session, &pending)) {
+        lyd_free_tree(pending.op);
+        ret = NC_MSG_ERROR;
+        goto cleanup_unlock;
+    }
 
-        /* create the operation node */
-        lyrc = lyd_new_inner(NULL, mod, rpc_name, 0, op);
+    ret = nc_send_rpc(session, rpc, timeout, &sent_msgid);
+    rpc_p = rpc_pending_find(session, pending.msgid);
+    if (ret != NC_MSG_RPC) {
+        /* not sent, no reply to wait for */
+        rpc_pending_del(session, rpc_p);
+        lyd_free_tree(pending.op);
+    } else if (sent_msgid != pending.msgid) {
+        /* an RPC was sent by another thread meanwhile, the removed RPC is added back without enlarging the table */
+        rpc_pending_del(session, rpc_p);
+        pending.msgid = sent_msgid;
+        rpc_pending_add(session, &pending);
     }
-    if (module_check) {
-        if (!ly_ctx_get_module_implemented(session->ctx, module_check)) {
-            ERR(session, "Missing \"%s\" module in the context.", module_check);
-            return -1;
-        }
+
+cleanup_unlock:
+    /* MSGS UNLOCK */
+    nc_session_client_msgs_unlock(session, __func__);
+
+    if (ret == NC_MSG_RPC) {
+        *msgid = pending.msgid;
     }
+    return ret;
+}
 
-    if (lyrc) {
+API int
+nc_recv_reply_async_dispatch(struct nc_session *session, int timeout)
+{
+    struct timespec ts;
+    int r, count = 0;
+
+    if (!session) {
+        ERRARG("session");
+        return -1;
+    } else if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to receive RPC replies.");
         return -1;
     }
-    return 0;
+
+    if (timeout > 0) {
+        nc_gettimespec_mono_add(&ts, timeout);
+    }
+
+    /* wait for the first reply */
+    while (!(r = recv_reply_async(session, timeout))) {
+        if (!timeout || ((timeout > 0) && ((timeout = nc_difftimespec_mono_cur(&ts)) < 1))) {
+            return 0;
+        }
+    }
+    if (r == -1) {
+        return -1;
+    }
+
+    /* process all the replies already received */
+    do {
+        ++count;
+    } while (recv_reply_async(session, 0) == 1);
+
+    return count;
 }
 
 API NC_MSG_TYPE
-nc_recv_reply(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, int timeout, struct lyd_node **envp,
+nc_recv_reply_async(struct nc_session *session, uint64_t msgid, int timeout, struct lyd_node **envp,
         struct lyd_node **op)
 {
-    NC_MSG_TYPE ret;
+    struct nc_rpc_pending *rpc;
+    struct timespec ts;
+    NC_MSG_TYPE ret = NC_MSG_NONE;
+    int r, lock_timeout;
 
     if (!session) {
         ERRARG("session");
         return NC_MSG_ERROR;
-    } else if (!rpc) {
-        ERRARG("rpc");
+    } else if (!msgid) {
+        ERRARG("msgid");
         return NC_MSG_ERROR;
     } else if (!envp) {
         ERRARG("envp");
@@ -2336,20 +4919,58 @@ nc_recv_reply(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, in
         return NC_MSG_ERROR;
     }
 
-    /* get a duplicate of the RPC node to append reply to */
-    if (recv_reply_dup_rpc(session, rpc, op)) {
-        return NC_MSG_ERROR;
+    *envp = NULL;
+    *op = NULL;
+    if (timeout > 0) {
+        nc_gettimespec_mono_add(&ts, timeout);
     }
 
-    /* receive a reply */
-    ret = recv_reply(session, timeout, *op, msgid, envp);
+    while (1) {
+        /* MSGS LOCK */
+        lock_timeout = timeout;
+        r = nc_session_client_msgs_lock(session, &lock_timeout, __func__);
+        if (r == -1) {
+            return NC_MSG_ERROR;
+        } else if (r) {
+            rpc = rpc_pending_find(session, msgid);
+            if (!rpc || rpc->reply_clb) {
+                ERR(session, "No RPC with message-id %" PRIu64 " is waiting for its reply.", msgid);
+                ret = NC_MSG_ERROR;
+            } else if (rpc->type != NC_MSG_NONE) {
+                /* received */
+                ret = rpc->type;
+                *envp = rpc->envp;
+                if ((ret == NC_MSG_REPLY) && lyd_child(rpc->op)) {
+                    *op = rpc->op;
+                } else {
+                    lyd_free_tree(rpc->op);
+                }
+                rpc_pending_del(session, rpc);
+            }
 
-    /* do not return the RPC copy on error or if the reply includes no data */
-    if (((ret != NC_MSG_REPLY) && (ret != NC_MSG_REPLY_ERR_MSGID)) || !lyd_child(*op)) {
-        lyd_free_tree(*op);
-        *op = NULL;
+            /* MSGS UNLOCK */
+            nc_session_client_msgs_unlock(session, __func__);
+
+            if (ret != NC_MSG_NONE) {
+                return ret;
+            }
+        }
+
+        if (timeout > 0) {
+            timeout = nc_difftimespec_mono_cur(&ts);
+            if (timeout < 1) {
+                return NC_MSG_WOULDBLOCK;
+            }
+        }
+
+        /* receive a reply, possibly to another RPC */
+        r = recv_reply_async(session, timeout);
+        if (r == -1) {
+            return NC_MSG_ERROR;
+        } else if (!r && !timeout) {
+            return NC_MSG_WOULDBLOCK;
+        }
     }
-    return ret;
 }
 
 static NC_MSG_TYPE
@@ -2370,6 +4991,11 @@ recv_notif(struct nc_session *session, int timeout, struct lyd_node **envp, stru
 
     /* Parse */
     lyrc = lyd_parse_op(session->ctx, NULL, msg, LYD_XML, LYD_TYPE_NOTIF_NETCONF, envp, op);
+
+    /* the raw message is not needed anymore, free it before any further processing */
+    ly_in_free(msg, 1);
+    msg = NULL;
+
     if (!lyrc) {
         goto cleanup;
     } else {
@@ -2481,6 +5107,14 @@ nc_recv_notif_dispatch_data(struct nc_session *session, nc_notif_dispatch_clb no
         return -1;
     }
 
+#ifdef HAVE_EPOLL
+    /* dispatched by the notification reactor, if used */
+    ret = nc_notif_reactor_add(session, notif_clb, user_data, free_data);
+    if (ret) {
+        return (ret == 1) ? 0 : -1;
+    }
+#endif
+
     ntarg = malloc(sizeof *ntarg);
     if (!ntarg) {
         ERRMEM;
@@ -2527,11 +5161,18 @@ nc_wd2str(NC_WD_MODE wd)
     return NULL;
 }
 
-API NC_MSG_TYPE
-nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_t *msgid)
+/**
+ * @brief Create the data tree of an RPC.
+ *
+ * @param[in] session Session whose context to use.
+ * @param[in] rpc RPC to create.
+ * @param[out] data_p Created RPC data tree.
+ * @param[out] dofree Whether @p data_p should be freed by the caller.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_rpc_create_tree(struct nc_session *session, struct nc_rpc *rpc, struct lyd_node **data_p, int *dofree)
 {
-    NC_MSG_TYPE r;
-    int dofree = 1;
     struct ly_in *in;
     struct nc_rpc_act_generic *rpc_gen;
     struct nc_rpc_getconfig *rpc_gc;
@@ -2560,21 +5201,8 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
     LY_ERR lyrc = 0;
     int i;
     char str[11];
-    uint64_t cur_msgid;
 
-    if (!session) {
-        ERRARG("session");
-        return NC_MSG_ERROR;
-    } else if (!rpc) {
-        ERRARG("rpc");
-        return NC_MSG_ERROR;
-    } else if (!msgid) {
-        ERRARG("msgid");
-        return NC_MSG_ERROR;
-    } else if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
-        ERR(session, "Invalid session to send RPCs.");
-        return NC_MSG_ERROR;
-    }
+    *dofree = 1;
 
     switch (rpc->type) {
     case NC_RPC_ACT_GENERIC:
@@ -2595,21 +5223,21 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         mod = ly_ctx_get_module_implemented(session->ctx, "ietf-netconf");
         if (!mod) {
             ERR(session, "Missing \"ietf-netconf\" module in the context.");
-            return NC_MSG_ERROR;
+            return -1;
         }
         break;
     case NC_RPC_GETSCHEMA:
         mod = ly_ctx_get_module_implemented(session->ctx, "ietf-netconf-monitoring");
         if (!mod) {
             ERR(session, "Missing \"ietf-netconf-monitoring\" module in the context.");
-            return NC_MSG_ERROR;
+            return -1;
         }
         break;
     case NC_RPC_SUBSCRIBE:
         mod = ly_ctx_get_module_implemented(session->ctx, "notifications");
         if (!mod) {
             ERR(session, "Missing \"notifications\" module in the context.");
-            return NC_MSG_ERROR;
+            return -1;
         }
         break;
     case NC_RPC_GETDATA:
@@ -2617,7 +5245,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         mod = ly_ctx_get_module_implemented(session->ctx, "ietf-netconf-nmda");
         if (!mod) {
             ERR(session, "Missing \"ietf-netconf-nmda\" module in the context.");
-            return NC_MSG_ERROR;
+            return -1;
         }
         break;
     case NC_RPC_ESTABLISHSUB:
@@ -2627,7 +5255,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         mod = ly_ctx_get_module_implemented(session->ctx, "ietf-subscribed-notifications");
         if (!mod) {
             ERR(session, "Missing \"ietf-subscribed-notifications\" module in the context.");
-            return NC_MSG_ERROR;
+            return -1;
         }
         break;
     case NC_RPC_ESTABLISHPUSH:
@@ -2635,24 +5263,24 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
         mod = ly_ctx_get_module_implemented(session->ctx, "ietf-subscribed-notifications");
         if (!mod) {
             ERR(session, "Missing \"ietf-subscribed-notifications\" module in the context.");
-            return NC_MSG_ERROR;
+            return -1;
         }
         mod2 = ly_ctx_get_module_implemented(session->ctx, "ietf-yang-push");
         if (!mod2) {
             ERR(session, "Missing \"ietf-yang-push\" module in the context.");
-            return NC_MSG_ERROR;
+            return -1;
         }
         break;
     case NC_RPC_RESYNCSUB:
         mod = ly_ctx_get_module_implemented(session->ctx, "ietf-yang-push");
         if (!mod) {
             ERR(session, "Missing \"ietf-yang-push\" module in the context.");
-            return NC_MSG_ERROR;
+            return -1;
         }
         break;
     case NC_RPC_UNKNOWN:
         ERRINT;
-        return NC_MSG_ERROR;
+        return -1;
     }
 
 #define CHECK_LYRC_BREAK(func_call) if ((lyrc = func_call)) break;
@@ -2663,7 +5291,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
 
         if (rpc_gen->has_data) {
             data = rpc_gen->content.data;
-            dofree = 0;
+            *dofree = 0;
         } else {
             ly_in_new_memory(rpc_gen->content.xml_str, &in);
             lyrc = lyd_parse_op(session->ctx, NULL, in, LYD_XML, LYD_TYPE_RPC_YANG, &data, NULL);
@@ -3125,7 +5753,7 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
 
     case NC_RPC_UNKNOWN:
         ERRINT;
-        return NC_MSG_ERROR;
+        return -1;
     }
 
 #undef CHECK_LYRC_BREAK
@@ -3133,6 +5761,36 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
     if (lyrc) {
         ERR(session, "Failed to create RPC, perhaps a required feature is disabled.");
         lyd_free_tree(data);
+        return -1;
+    }
+
+    *data_p = data;
+    return 0;
+}
+
+API NC_MSG_TYPE
+nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_t *msgid)
+{
+    NC_MSG_TYPE r;
+    int dofree;
+    struct lyd_node *data;
+    uint64_t cur_msgid;
+
+    if (!session) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
+    } else if (!rpc) {
+        ERRARG("rpc");
+        return NC_MSG_ERROR;
+    } else if (!msgid) {
+        ERRARG("msgid");
+        return NC_MSG_ERROR;
+    } else if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to send RPCs.");
+        return NC_MSG_ERROR;
+    }
+
+    if (nc_rpc_create_tree(session, rpc, &data, &dofree)) {
         return NC_MSG_ERROR;
     }
 
@@ -3150,6 +5808,218 @@ nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_
     return r;
 }
 
+static int
+nc_rpc_slot_cmp(const void *ptr1, const void *ptr2)
+{
+    const struct nc_rpc_slot *occur1 = ptr1, *occur2 = ptr2;
+
+    if (occur1->offset < occur2->offset) {
+        return -1;
+    }
+    return occur1->offset > occur2->offset;
+}
+
+API struct nc_rpc_prepared *
+nc_rpc_prepare(struct nc_session *session, struct nc_rpc *rpc, const char **slots, uint16_t slot_count)
+{
+    struct nc_rpc_prepared *prepared = NULL;
+    struct nc_rpc_slot *occurs;
+    struct lyd_node *data;
+    const char *ptr;
+    char *xml = NULL, *str;
+    int dofree;
+    uint16_t i;
+    uint32_t j;
+    LY_ERR lyrc;
+
+    if (!session) {
+        ERRARG("session");
+        return NULL;
+    } else if (!rpc) {
+        ERRARG("rpc");
+        return NULL;
+    } else if (!slots && slot_count) {
+        ERRARG("slots");
+        return NULL;
+    } else if (session->side != NC_CLIENT) {
+        ERR(session, "Invalid session to prepare RPCs.");
+        return NULL;
+    }
+
+    /* create and print the RPC just like when sending it */
+    if (nc_rpc_create_tree(session, rpc, &data, &dofree)) {
+        return NULL;
+    }
+    lyrc = lyd_print_mem(&xml, data, LYD_XML, LYD_PRINT_SHRINK | LYD_PRINT_KEEPEMPTYCONT);
+    if (!lyrc && data->schema && (data->schema->nodetype & (LYS_CONTAINER | LYS_LIST))) {
+        /* action */
+        if (asprintf(&str, "<action xmlns=\"urn:ietf:params:xml:ns:yang:1\">%s</action>", xml) == -1) {
+            ERRMEM;
+            lyrc = LY_EMEM;
+        } else {
+            free(xml);
+            xml = str;
+        }
+    }
+    if (dofree) {
+        lyd_free_tree(data);
+    }
+    if (lyrc) {
+        goto error;
+    }
+
+    prepared = calloc(1, sizeof *prepared);
+    if (!prepared) {
+        ERRMEM;
+        goto error;
+    }
+    prepared->ctx = session->ctx;
+    prepared->xml = xml;
+    xml = NULL;
+    prepared->len = strlen(prepared->xml);
+
+    if (slot_count) {
+        prepared->slot_lens = malloc(slot_count * sizeof *prepared->slot_lens);
+        if (!prepared->slot_lens) {
+            ERRMEM;
+            goto error;
+        }
+        prepared->slot_count = slot_count;
+    }
+
+    /* find all the slot occurrences */
+    for (i = 0; i < slot_count; ++i) {
+        if (!slots[i] || !slots[i][0]) {
+            ERRARG("slots");
+            goto error;
+        }
+        prepared->slot_lens[i] = strlen(slots[i]);
+
+        for (ptr = strstr(prepared->xml, slots[i]); ptr; ptr = strstr(ptr + prepared->slot_lens[i], slots[i])) {
+            occurs = realloc(prepared->occurs, (prepared->occur_count + 1) * sizeof *prepared->occurs);
+            if (!occurs) {
+                ERRMEM;
+                goto error;
+            }
+            prepared->occurs = occurs;
+            prepared->occurs[prepared->occur_count].slot = i;
+            prepared->occurs[prepared->occur_count].offset = ptr - prepared->xml;
+            ++prepared->occur_count;
+        }
+    }
+
+    /* sort them and make sure they do not overlap */
+    qsort(prepared->occurs, prepared->occur_count, sizeof *prepared->occurs, nc_rpc_slot_cmp);
+    for (j = 1; j < prepared->occur_count; ++j) {
+        if (prepared->occurs[j - 1].offset + prepared->slot_lens[prepared->occurs[j - 1].slot] >
+                prepared->occurs[j].offset) {
+            ERR(session, "Prepared RPC slots \"%s\" and \"%s\" overlap.", slots[prepared->occurs[j - 1].slot],
+                    slots[prepared->occurs[j].slot]);
+            goto error;
+        }
+    }
+
+    return prepared;
+
+error:
+    free(xml);
+    nc_rpc_prepared_free(prepared);
+    return NULL;
+}
+
+API NC_MSG_TYPE
+nc_send_rpc_prepared(struct nc_session *session, const struct nc_rpc_prepared *prepared, const char **values,
+        int timeout, uint64_t *msgid)
+{
+    NC_MSG_TYPE r;
+    char *buf = NULL;
+    const char *val;
+    size_t len, off, seg_len, val_len;
+    uint32_t i;
+    uint64_t cur_msgid;
+
+    if (!session) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
+    } else if (!prepared) {
+        ERRARG("prepared");
+        return NC_MSG_ERROR;
+    } else if (!msgid) {
+        ERRARG("msgid");
+        return NC_MSG_ERROR;
+    } else if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to send RPCs.");
+        return NC_MSG_ERROR;
+    } else if (session->ctx != prepared->ctx) {
+        ERR(session, "Prepared RPC was created in different context than that of the session.");
+        return NC_MSG_ERROR;
+    }
+
+    if (values && prepared->occur_count) {
+        /* learn the substituted length */
+        len = prepared->len;
+        for (i = 0; i < prepared->occur_count; ++i) {
+            if (values[prepared->occurs[i].slot]) {
+                len += strlen(values[prepared->occurs[i].slot]);
+                len -= prepared->slot_lens[prepared->occurs[i].slot];
+            }
+        }
+
+        buf = malloc(len);
+        if (!buf) {
+            ERRMEM;
+            return NC_MSG_ERROR;
+        }
+
+        /* substitute the slots */
+        len = 0;
+        off = 0;
+        for (i = 0; i < prepared->occur_count; ++i) {
+            seg_len = prepared->occurs[i].offset - off;
+            memcpy(buf + len, prepared->xml + off, seg_len);
+            len += seg_len;
+            off += seg_len;
+
+            val = values[prepared->occurs[i].slot];
+            if (!val) {
+                /* keep the slot */
+                val = prepared->xml + off;
+                val_len = prepared->slot_lens[prepared->occurs[i].slot];
+            } else {
+                val_len = strlen(val);
+            }
+            memcpy(buf + len, val, val_len);
+            len += val_len;
+            off += prepared->slot_lens[prepared->occurs[i].slot];
+        }
+        memcpy(buf + len, prepared->xml + off, prepared->len - off);
+        len += prepared->len - off;
+    }
+
+    /* send RPC, store its message ID */
+    r = nc_write_rpc_buf_io(session, timeout, buf ? buf : prepared->xml, buf ? len : prepared->len);
+    cur_msgid = session->opts.client.msgid;
+    free(buf);
+
+    if (r == NC_MSG_RPC) {
+        *msgid = cur_msgid;
+    }
+    return r;
+}
+
+API void
+nc_rpc_prepared_free(struct nc_rpc_prepared *prepared)
+{
+    if (!prepared) {
+        return;
+    }
+
+    free(prepared->xml);
+    free(prepared->slot_lens);
+    free(prepared->occurs);
+    free(prepared);
+}
+
 API void
 nc_client_session_set_not_strict(struct nc_session *session)
 {
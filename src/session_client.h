@@ -63,6 +63,27 @@ int nc_client_set_schema_searchpath(const char *path);
  */
 const char *nc_client_get_schema_searchpath(void);
 
+/**
+ * @brief Set a directory used as a persistent cache of schemas retrieved via \<get-schema\>.
+ *
+ * Every module retrieved from a server is stored in the directory, under its name and revision
+ * (or the whole server YANG library content-id for a module without a revision, with any characters
+ * not safe in a file name percent-encoded). Modules with a name or revision containing "/" or ".."
+ * are never cached. On any later connection (to any server), cached modules are used instead of
+ * retrieving them again, but the schema searchpath is still searched first. The directory must exist and should not be shared with any schema searchpath.
+ *
+ * @param[in] path Schema cache directory, NULL to disable the cache.
+ * @return 0 on success, 1 on (memory allocation) failure.
+ */
+int nc_client_set_schema_cache_dir(const char *path);
+
+/**
+ * @brief Get schema cache directory that was set by nc_client_set_schema_cache_dir().
+ *
+ * @return Schema cache directory, NULL if not set.
+ */
+const char *nc_client_get_schema_cache_dir(void);
+
 /**
  * @brief Set callback function to get missing schemas.
  *
@@ -83,6 +104,51 @@ int nc_client_set_schema_callback(ly_module_imp_clb clb, void *user_data);
  */
 ly_module_imp_clb nc_client_get_schema_callback(void **user_data);
 
+/**
+ * @brief Set whether to share libyang contexts of sessions to servers with identical YANG modules.
+ *
+ * When enabled, a context created for a session (no custom context passed when connecting) is kept in a process-wide
+ * pool, keyed by the server modules learned from its yang-library (or capabilities). Any later session to a server
+ * with the same modules, revisions, features, and submodules then uses this context instead of creating a new one.
+ * Shared contexts are read-only and remain in the pool until ::nc_client_destroy(), except that only a few
+ * contexts not used by any session are kept, the least recently used ones are destroyed. Contexts of servers
+ * supporting schema-mount are never shared.
+ *
+ * @param[in] enabled Whether the context pool is used for new sessions, disabled by default.
+ * @return 0 on success.
+ */
+int nc_client_set_ctx_pool(int enabled);
+
+/**
+ * @brief Learn whether the client context pool is used, set by nc_client_set_ctx_pool().
+ *
+ * @return Whether contexts are shared.
+ */
+int nc_client_get_ctx_pool(void);
+
+/**
+ * @brief Set the number of threads dispatching notifications of all the client sessions.
+ *
+ * By default, ::nc_recv_notif_dispatch() creates a new thread for every session. With a notification reactor,
+ * a single thread waits for data on all the dispatched sessions at once and the notifications are received
+ * and passed to the callbacks by @p worker_count threads. Notifications of a single session are still processed
+ * in the order they were received, never by more threads at once. Sessions whose transport cannot be waited on
+ * separately (several NETCONF sessions on one SSH session) are still dispatched by their own thread.
+ *
+ * Can be changed only when no sessions are dispatched by the reactor. Requires epoll support.
+ *
+ * @param[in] worker_count Number of the reactor worker threads, 0 to create a thread for every session.
+ * @return 0 on success, -1 on error.
+ */
+int nc_client_set_notif_reactor(uint16_t worker_count);
+
+/**
+ * @brief Learn the number of notification reactor worker threads, set by nc_client_set_notif_reactor().
+ *
+ * @return Number of the worker threads, 0 if every session is dispatched by its own thread.
+ */
+uint16_t nc_client_get_notif_reactor(void);
+
 /**
  * @brief Use the provided thread-specific client's context in the current thread.
  *
@@ -455,6 +521,17 @@ int nc_client_tls_set_crl_paths(const char *crl_file, const char *crl_dir);
  */
 void nc_client_tls_get_crl_paths(const char **crl_file, const char **crl_dir);
 
+/**
+ * @brief Set whether to request kernel TLS (kTLS) offload of the client TLS sessions.
+ *
+ * The kernel then encrypts and decrypts the records once the handshake is finished, if OpenSSL (3.0 or newer),
+ * the kernel, and the negotiated cipher support it, otherwise the session silently falls back to OpenSSL.
+ * Check the result with nc_session_get_ktls().
+ *
+ * @param[in] enable Whether to request the offload, disabled by default.
+ */
+void nc_client_tls_set_ktls(int enable);
+
 /**
  * @brief Connect to the NETCONF server using TLS transport (via libssl)
  *
@@ -493,6 +570,58 @@ struct nc_session *nc_connect_libssl(SSL *tls, struct ly_ctx *ctx);
  * @{
  */
 
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+
+/**
+ * @brief Server to connect to by ::nc_connect_batch().
+ */
+struct nc_connect_target {
+    NC_TRANSPORT_IMPL ti;       /**< transport to use, ::NC_TI_LIBSSH or ::NC_TI_OPENSSL */
+    const char *host;           /**< hostname or IP address of the server, 'localhost' if NULL */
+    uint16_t port;              /**< port of the server, the default port of @p ti if 0 */
+    void *user_data;            /**< arbitrary user data of the target */
+};
+
+/**
+ * @brief Callback reporting the result of connecting to a target of ::nc_connect_batch().
+ *
+ * @param[in] target Target that was connected to.
+ * @param[in] session New NETCONF session owned by the callback, NULL if connecting failed.
+ * @param[in] user_data Arbitrary user data passed to ::nc_connect_batch().
+ */
+typedef void (*nc_connect_batch_clb)(const struct nc_connect_target *target, struct nc_session *session,
+        void *user_data);
+
+/**
+ * @brief Connect to many NETCONF servers at once.
+ *
+ * TCP connects of up to @p max_pending targets are in progress at once, driven without blocking by the calling
+ * thread. Host names are resolved by @p thread_count worker threads because it may block, IP addresses are used
+ * right away. Connected sockets are passed to the workers, too, which establish the SSH or TLS transport,
+ * exchange \<hello\> messages and fill the contexts, as ::nc_connect_ssh() or ::nc_connect_tls() would. The
+ * targets being resolved and the connected sockets waiting for a worker also count towards @p max_pending,
+ * so no server waits for its handshake for too long.
+ *
+ * The workers use the client options (SSH and TLS authentication, keepalives, searchpath, ...) of the
+ * calling thread, which must not change them until the function returns.
+ *
+ * @param[in] targets Servers to connect to.
+ * @param[in] target_count Number of @p targets.
+ * @param[in] ctx Optional custom context shared by all the sessions. It must already contain all the modules
+ * needed by the servers, the workers would be modifying it concurrently otherwise. Preferably use NULL together
+ * with the context pool (::nc_client_set_ctx_pool()).
+ * @param[in] max_pending Maximum number of targets being connected or waiting for a worker at once.
+ * @param[in] thread_count Number of the worker threads.
+ * @param[in] timeout Timeout in msec of a TCP connect to a single address of a target, -1 for none.
+ * @param[in] clb Callback called for every target once, concurrently by the calling thread and the workers.
+ * @param[in] user_data Arbitrary user data passed to @p clb.
+ * @return 0 once all the targets were reported, -1 on error before connecting to any of them.
+ */
+int nc_connect_batch(const struct nc_connect_target *targets, uint32_t target_count, struct ly_ctx *ctx,
+        uint32_t max_pending, uint16_t thread_count, int timeout, nc_connect_batch_clb clb, void *user_data);
+
+#endif
+
 /**
  * @brief Get session capabilities.
  *
@@ -610,6 +739,122 @@ int nc_recv_notif_dispatch_data(struct nc_session *session, nc_notif_dispatch_cl
  */
 NC_MSG_TYPE nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_t *msgid);
 
+/**
+ * @brief NETCONF RPC created and printed once to be sent many times.
+ */
+struct nc_rpc_prepared;
+
+/**
+ * @brief Create and print an RPC so that it can be sent repeatedly by ::nc_send_rpc_prepared().
+ *
+ * Optional slots are strings in the printed RPC that can be substituted by other values on every
+ * send. Every occurrence of a slot is substituted so use unique strings, for example
+ * the name of a datastore or a unique placeholder in a filter.
+ *
+ * @param[in] session NETCONF session whose context to use.
+ * @param[in] rpc NETCONF RPC object to prepare, may be freed right after.
+ * @param[in] slots Array of slot strings, may be NULL.
+ * @param[in] slot_count Number of @p slots.
+ * @return Prepared RPC, NULL on error.
+ */
+struct nc_rpc_prepared *nc_rpc_prepare(struct nc_session *session, struct nc_rpc *rpc, const char **slots,
+        uint16_t slot_count);
+
+/**
+ * @brief Send a prepared RPC via the session.
+ *
+ * The prepared RPC is not modified and can be sent on several sessions at once as long as
+ * they use the same context it was prepared in. Replies are received as for ::nc_send_rpc()
+ * using the original RPC object.
+ *
+ * @param[in] session NETCONF session where the RPC will be written.
+ * @param[in] prepared Prepared RPC to send.
+ * @param[in] values Array of values substituted for every slot, NULL for no substitution. Values
+ * are inserted as they are, so they must be valid XML in place of the slots. A NULL value keeps the slot itself.
+ * @param[in] timeout Timeout for writing in milliseconds. Use negative value for infinite
+ * waiting and 0 for return if data cannot be sent immediately.
+ * @param[out] msgid If RPC was successfully sent, this is it's message ID.
+ * @return #NC_MSG_RPC on success,
+ *         #NC_MSG_WOULDBLOCK in case of a busy session, and
+ *         #NC_MSG_ERROR on error.
+ */
+NC_MSG_TYPE nc_send_rpc_prepared(struct nc_session *session, const struct nc_rpc_prepared *prepared,
+        const char **values, int timeout, uint64_t *msgid);
+
+/**
+ * @brief Free a prepared RPC.
+ *
+ * @param[in] prepared Prepared RPC to free.
+ */
+void nc_rpc_prepared_free(struct nc_rpc_prepared *prepared);
+
+/**
+ * @brief Callback for receiving a reply to an RPC sent by ::nc_send_rpc_async().
+ *
+ * @param[in] session NC session that received the reply.
+ * @param[in] msgid Message ID of the RPC.
+ * @param[in] msgtype #NC_MSG_REPLY if the reply was received, #NC_MSG_ERROR if it could not be parsed or
+ * the session was freed before the reply was received. RPCs sent by the callback while the session is being freed
+ * are finished with #NC_MSG_ERROR as well.
+ * @param[in] envp NETCONF rpc-reply XML envelopes, NULL on error.
+ * @param[in] op Parsed NETCONF reply data, if any (none for \<ok\> or error replies).
+ * @param[in] user_data Arbitrary user data passed to ::nc_send_rpc_async().
+ */
+typedef void (*nc_rpc_reply_clb)(struct nc_session *session, uint64_t msgid, NC_MSG_TYPE msgtype,
+        const struct lyd_node *envp, const struct lyd_node *op, void *user_data);
+
+/**
+ * @brief Send NETCONF RPC message via the session without waiting for its reply.
+ *
+ * Any number of RPCs can be sent this way before their replies are received. Replies are then received
+ * by ::nc_recv_reply_async_dispatch() or ::nc_recv_reply_async(), never by ::nc_recv_reply().
+ *
+ * @param[in] session NETCONF session where the RPC will be written.
+ * @param[in] rpc NETCONF RPC object to send via the specified session, may be freed right after sending.
+ * @param[in] timeout Timeout for writing in milliseconds. Use negative value for infinite
+ * waiting and 0 for return if data cannot be sent immediately.
+ * @param[in] reply_clb Callback called for the reply. If not set, the reply is kept until it is retrieved
+ * using ::nc_recv_reply_async().
+ * @param[in] user_data Arbitrary user data passed to @p reply_clb.
+ * @param[out] msgid If RPC was successfully sent, this is it's message ID.
+ * @return #NC_MSG_RPC on success,
+ *         #NC_MSG_WOULDBLOCK in case of a busy session, and
+ *         #NC_MSG_ERROR on error.
+ */
+NC_MSG_TYPE nc_send_rpc_async(struct nc_session *session, struct nc_rpc *rpc, int timeout, nc_rpc_reply_clb reply_clb,
+        void *user_data, uint64_t *msgid);
+
+/**
+ * @brief Receive replies to RPCs sent by ::nc_send_rpc_async() and pass them to their callbacks.
+ *
+ * Waits until at least one reply is received and then processes all the replies immediately available.
+ * Any notifications received meanwhile are kept for ::nc_recv_notif().
+ *
+ * @param[in] session NETCONF client session.
+ * @param[in] timeout Timeout for reading in milliseconds. Use negative value for infinite
+ * waiting and 0 for immediate return if data are not available on the wire.
+ * @return Number of the replies received, 0 if @p timeout has elapsed, -1 on error.
+ */
+int nc_recv_reply_async_dispatch(struct nc_session *session, int timeout);
+
+/**
+ * @brief Receive the reply to a specific RPC sent by ::nc_send_rpc_async() without a callback.
+ *
+ * Replies to other RPCs received meanwhile are processed as by ::nc_recv_reply_async_dispatch().
+ *
+ * @param[in] session NETCONF client session.
+ * @param[in] msgid Message ID of the RPC.
+ * @param[in] timeout Timeout for reading in milliseconds. Use negative value for infinite
+ * waiting and 0 for immediate return if data are not available on the wire.
+ * @param[out] envp NETCONF rpc-reply XML envelopes.
+ * @param[out] op Parsed NETCONF reply data, if any (none for \<ok\> or error replies).
+ * @return #NC_MSG_REPLY for success,
+ *         #NC_MSG_WOULDBLOCK if @p timeout has elapsed, and
+ *         #NC_MSG_ERROR if reading or parsing the reply has failed or no such RPC is waiting for its reply.
+ */
+NC_MSG_TYPE nc_recv_reply_async(struct nc_session *session, uint64_t msgid, int timeout, struct lyd_node **envp,
+        struct lyd_node **op);
+
 /**
  * @brief Make a session not strict when sending RPCs and receiving RPC replies. In other words,
  * it will silently skip unknown nodes without an error.
@@ -354,6 +354,14 @@ int nc_client_tls_ch_set_crl_paths(const char *crl_file, const char *crl_dir);
  */
 void nc_client_tls_ch_get_crl_paths(const char **crl_file, const char **crl_dir);
 
+/**
+ * @brief Set whether to request kernel TLS (kTLS) offload of the client Call Home TLS sessions,
+ * see nc_client_tls_set_ktls().
+ *
+ * @param[in] enable Whether to request the offload, disabled by default.
+ */
+void nc_client_tls_ch_set_ktls(int enable);
+
 /** @} Client-side Call Home on TLS */
 
 #endif /* NC_ENABLED_TLS */
@@ -1522,12 +1522,15 @@ _nc_connect_libssh(ssh_session ssh_session, struct ly_ctx *ctx, struct nc_keepal
     }
 
     /* prepare session structure */
-    session = nc_new_session(NC_CLIENT, 0);
+    session = nc_new_session(NC_CLIENT);
     if (!session) {
         ERRMEM;
         return NULL;
     }
     session->status = NC_STATUS_STARTING;
+    if (nc_session_ssh_lock_new(session)) {
+        goto fail;
+    }
     session->ti_type = NC_TI_LIBSSH;
     session->ti.libssh.session = ssh_session;
 
@@ -1635,28 +1638,17 @@ fail:
     return NULL;
 }
 
-API struct nc_session *
-nc_connect_ssh(const char *host, uint16_t port, struct ly_ctx *ctx)
+struct nc_session *
+nc_connect_ssh_sock(const char *host, uint16_t port, int sock, char *ip_host, struct ly_ctx *ctx)
 {
     const long timeout = NC_SSH_TIMEOUT;
-    int sock;
-    uint32_t port_uint;
-    char *username, *ip_host = NULL;
+    uint32_t port_uint = port;
+    char *username;
     struct passwd *pw, pw_buf;
     struct nc_session *session = NULL;
     char *buf = NULL;
     size_t buf_len = 0;
 
-    /* process parameters */
-    if (!host || strisempty(host)) {
-        host = "localhost";
-    }
-
-    if (!port) {
-        port = NC_PORT_SSH;
-    }
-    port_uint = port;
-
     if (!ssh_opts.username) {
         pw = nc_getpwuid(getuid(), &pw_buf, &buf, &buf_len);
         if (!pw) {
@@ -1670,7 +1662,7 @@ nc_connect_ssh(const char *host, uint16_t port, struct ly_ctx *ctx)
     }
 
     /* prepare session structure */
-    session = nc_new_session(NC_CLIENT, 0);
+    session = nc_new_session(NC_CLIENT);
     if (!session) {
         ERRMEM;
         goto fail;
@@ -1678,6 +1670,9 @@ nc_connect_ssh(const char *host, uint16_t port, struct ly_ctx *ctx)
     session->status = NC_STATUS_STARTING;
 
     /* transport-specific data */
+    if (nc_session_ssh_lock_new(session)) {
+        goto fail;
+    }
     session->ti_type = NC_TI_LIBSSH;
     session->ti.libssh.session = ssh_new();
     if (!session->ti.libssh.session) {
@@ -1691,14 +1686,10 @@ nc_connect_ssh(const char *host, uint16_t port, struct ly_ctx *ctx)
     ssh_options_set(session->ti.libssh.session, SSH_OPTIONS_USER, username);
     ssh_options_set(session->ti.libssh.session, SSH_OPTIONS_TIMEOUT, &timeout);
 
-    /* create and assign communication socket */
-    sock = nc_sock_connect(host, port, -1, &client_opts.ka, NULL, &ip_host);
-    if (sock == -1) {
-        ERR(session, "Unable to connect to %s:%u (%s).", host, port, strerror(errno));
-        goto fail;
-    }
+    /* assign communication socket, closed with the SSH session */
     ssh_options_set(session->ti.libssh.session, SSH_OPTIONS_FD, &sock);
     ssh_set_blocking(session->ti.libssh.session, 0);
+    sock = -1;
 
     /* store information for session connection */
     session->host = strdup(host);
@@ -1732,12 +1723,40 @@ nc_connect_ssh(const char *host, uint16_t port, struct ly_ctx *ctx)
     return session;
 
 fail:
+    if (sock > -1) {
+        close(sock);
+    }
     free(buf);
     free(ip_host);
     nc_session_free(session, NULL);
     return NULL;
 }
 
+API struct nc_session *
+nc_connect_ssh(const char *host, uint16_t port, struct ly_ctx *ctx)
+{
+    int sock;
+    char *ip_host = NULL;
+
+    /* process parameters */
+    if (!host || strisempty(host)) {
+        host = "localhost";
+    }
+
+    if (!port) {
+        port = NC_PORT_SSH;
+    }
+
+    /* create communication socket */
+    sock = nc_sock_connect(host, port, -1, &client_opts.ka, NULL, &ip_host);
+    if (sock == -1) {
+        ERR(NULL, "Unable to connect to %s:%u (%s).", host, port, strerror(errno));
+        return NULL;
+    }
+
+    return nc_connect_ssh_sock(host, port, sock, ip_host, ctx);
+}
+
 API struct nc_session *
 nc_connect_libssh(ssh_session ssh_session, struct ly_ctx *ctx)
 {
@@ -1755,17 +1774,22 @@ nc_connect_ssh_channel(struct nc_session *session, struct ly_ctx *ctx)
     }
 
     /* prepare session structure */
-    new_session = nc_new_session(NC_CLIENT, 1);
+    new_session = nc_new_session(NC_CLIENT);
     if (!new_session) {
         ERRMEM;
         return NULL;
     }
     new_session->status = NC_STATUS_STARTING;
 
-    /* share some parameters including the IO lock (we are using one socket for both sessions) */
+    /* share some parameters including the SSH lock (we are using one socket for both sessions) */
     new_session->ti_type = NC_TI_LIBSSH;
     new_session->ti.libssh.session = session->ti.libssh.session;
-    new_session->io_lock = session->io_lock;
+    new_session->ti.libssh.ssh_lock = session->ti.libssh.ssh_lock;
+
+    /* SSH LOCK */
+    if (nc_session_ssh_lock(new_session, -1, __func__) != 1) {
+        goto fail;
+    }
 
     /* append to the session ring list */
     if (!session->ti.libssh.next) {
@@ -1778,13 +1802,14 @@ nc_connect_ssh_channel(struct nc_session *session, struct ly_ctx *ctx)
     }
 
     /* create the channel safely */
-    if (nc_session_io_lock(new_session, -1, __func__) != 1) {
-        goto fail;
-    }
     if (open_netconf_channel(new_session, NC_TRANSPORT_TIMEOUT) != 1) {
+        /* SSH UNLOCK */
+        nc_session_ssh_unlock(new_session, __func__);
         goto fail;
     }
-    nc_session_io_unlock(new_session, __func__);
+
+    /* SSH UNLOCK */
+    nc_session_ssh_unlock(new_session, __func__);
 
     if (nc_client_session_new_ctx(new_session, ctx) != EXIT_SUCCESS) {
         goto fail;
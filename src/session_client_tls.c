@@ -469,6 +469,30 @@ _nc_client_tls_get_crl_paths(const char **crl_file, const char **crl_dir, struct
     }
 }
 
+static void
+_nc_client_tls_set_ktls(int enable, struct nc_client_tls_opts *opts)
+{
+#ifndef SSL_OP_ENABLE_KTLS
+    if (enable) {
+        WRN(NULL, "Kernel TLS offload not supported by OpenSSL %s, ignoring.", OPENSSL_VERSION_TEXT);
+    }
+#endif
+
+    opts->ktls = enable ? 1 : 0;
+}
+
+API void
+nc_client_tls_set_ktls(int enable)
+{
+    _nc_client_tls_set_ktls(enable, &tls_opts);
+}
+
+API void
+nc_client_tls_ch_set_ktls(int enable)
+{
+    _nc_client_tls_set_ktls(enable, &tls_ch_opts);
+}
+
 API void
 nc_client_tls_get_crl_paths(const char **crl_file, const char **crl_dir)
 {
@@ -653,38 +677,30 @@ nc_client_tls_connect_check(int connect_ret, SSL *tls, const char *peername)
     return connect_ret;
 }
 
-API struct nc_session *
-nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
+int
+nc_connect_tls_prepare(const char *host)
 {
-    struct nc_session *session = NULL;
-    int sock, ret;
-    struct timespec ts_timeout;
-    char *ip_host = NULL;
-
     if (!tls_opts.cert_path || (!tls_opts.ca_file && !tls_opts.ca_dir)) {
         ERRINIT;
-        return NULL;
-    }
-
-    /* process parameters */
-    if (!host || strisempty(host)) {
-        host = "localhost";
-    }
-
-    if (!port) {
-        port = NC_PORT_TLS;
+        return -1;
     }
 
     /* create/update TLS structures */
-    if (nc_client_tls_update_opts(&tls_opts, host)) {
-        return NULL;
-    }
+    return nc_client_tls_update_opts(&tls_opts, host);
+}
+
+struct nc_session *
+nc_connect_tls_sock(const char *host, uint16_t port, int sock, char *ip_host, struct ly_ctx *ctx)
+{
+    struct nc_session *session = NULL;
+    int ret;
+    struct timespec ts_timeout;
 
     /* prepare session structure */
-    session = nc_new_session(NC_CLIENT, 0);
+    session = nc_new_session(NC_CLIENT);
     if (!session) {
         ERRMEM;
-        return NULL;
+        goto fail;
     }
     session->status = NC_STATUS_STARTING;
 
@@ -694,14 +710,20 @@ nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
         ERR(NULL, "Failed to create a new TLS session structure (%s).", ERR_reason_error_string(ERR_get_error()));
         goto fail;
     }
-
-    /* create and assign socket */
-    sock = nc_sock_connect(host, port, -1, &client_opts.ka, NULL, &ip_host);
-    if (sock == -1) {
-        ERR(NULL, "Unable to connect to %s:%u (%s).", host, port, strerror(errno));
+    if (tls_opts.ktls) {
+        nc_tls_ktls_enable(session->ti.tls);
+    }
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L // >= 1.1.0
+    /* verify the identity of this server, the context may have been created for another one */
+    if (!SSL_set1_host(session->ti.tls, host)) {
+        ERR(NULL, "Failed to set expected server hostname (%s).", ERR_reason_error_string(ERR_get_error()));
         goto fail;
     }
+#endif
+
+    /* assign socket, closed with the session */
     SSL_set_fd(session->ti.tls, sock);
+    sock = -1;
 
     /* set the SSL_MODE_AUTO_RETRY flag to allow OpenSSL perform re-handshake automatically */
     SSL_set_mode(session->ti.tls, SSL_MODE_AUTO_RETRY);
@@ -721,6 +743,7 @@ nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
     if (nc_client_tls_connect_check(ret, session->ti.tls, host) != 1) {
         goto fail;
     }
+    nc_tls_ktls_print(NULL, session->ti.tls);
 
     if (nc_client_session_new_ctx(session, ctx) != EXIT_SUCCESS) {
         goto fail;
@@ -745,11 +768,43 @@ nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
     return session;
 
 fail:
+    if (sock > -1) {
+        close(sock);
+    }
     free(ip_host);
     nc_session_free(session, NULL);
     return NULL;
 }
 
+API struct nc_session *
+nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
+{
+    int sock;
+    char *ip_host = NULL;
+
+    /* process parameters */
+    if (!host || strisempty(host)) {
+        host = "localhost";
+    }
+
+    if (!port) {
+        port = NC_PORT_TLS;
+    }
+
+    if (nc_connect_tls_prepare(host)) {
+        return NULL;
+    }
+
+    /* create socket */
+    sock = nc_sock_connect(host, port, -1, &client_opts.ka, NULL, &ip_host);
+    if (sock == -1) {
+        ERR(NULL, "Unable to connect to %s:%u (%s).", host, port, strerror(errno));
+        return NULL;
+    }
+
+    return nc_connect_tls_sock(host, port, sock, ip_host, ctx);
+}
+
 API struct nc_session *
 nc_connect_libssl(SSL *tls, struct ly_ctx *ctx)
 {
@@ -764,7 +819,7 @@ nc_connect_libssl(SSL *tls, struct ly_ctx *ctx)
     }
 
     /* prepare session structure */
-    session = nc_new_session(NC_CLIENT, 0);
+    session = nc_new_session(NC_CLIENT);
     if (!session) {
         ERRMEM;
         return NULL;
@@ -814,6 +869,9 @@ nc_accept_callhome_tls_sock(int sock, const char *host, uint16_t port, struct ly
         ERR(NULL, "Failed to create new TLS session structure (%s).", ERR_reason_error_string(ERR_get_error()));
         goto cleanup;
     }
+    if (tls_ch_opts.ktls) {
+        nc_tls_ktls_enable(tls);
+    }
 
     SSL_set_fd(tls, sock);
 
@@ -837,6 +895,7 @@ nc_accept_callhome_tls_sock(int sock, const char *host, uint16_t port, struct ly
     if (nc_client_tls_connect_check(ret, tls, peername ? peername : host) != 1) {
         goto cleanup;
     }
+    nc_tls_ktls_print(NULL, tls);
 
     /* connect */
     session = nc_connect_libssl(tls, ctx);
@@ -29,6 +29,12 @@
 #include "netconf.h"
 #include "session.h"
 #include "session_client.h"
+#include "session_server.h"
+#include "session_server_ch.h"
+
+#ifdef HAVE_IO_URING
+# include <liburing.h>
+#endif
 
 #ifdef NC_ENABLED_SSH
 
@@ -77,6 +83,10 @@ struct nc_server_ssh_opts {
     /* SSH bind options */
     char **hostkeys;
     uint8_t hostkey_count;
+    ssh_bind sbind;         /**< prepared bind with the loaded host keys shared by all the accepts, created on demand */
+    uint32_t sbind_gen;     /**< generation of the host key callback @p sbind was created with */
+    uint8_t sbind_keep;     /**< staged copy only, whether @p sbind of the copied options is taken over on commit */
+    pthread_mutex_t sbind_lock; /**< serializes the accepts on @p sbind of these options only */
 
     int auth_methods;
     uint16_t auth_attempts;
@@ -103,6 +113,8 @@ struct nc_client_tls_opts {
     char *crl_dir;
     int8_t crl_store_change;
     X509_STORE *crl_store;
+
+    int8_t ktls;            /**< whether to request kernel TLS offload */
 };
 
 /* ACCESS locked, separate locks */
@@ -113,6 +125,14 @@ struct nc_server_tls_opts {
     char *trusted_ca_file;
     char *trusted_ca_dir;
     X509_STORE *crl_store;
+    struct {
+        char *file;
+        char *dir;
+    } *crl_paths;           /**< CRL locations loaded into @p crl_store */
+    uint16_t crl_path_count;
+
+    SSL_CTX *tls_ctx;       /**< prepared context shared by all the accepted sessions, created on demand */
+    uint32_t tls_ctx_gen;   /**< generation of the global callbacks @p tls_ctx was created with */
 
     struct nc_ctn {
         uint32_t id;
@@ -121,8 +141,21 @@ struct nc_server_tls_opts {
         char *name;
         struct nc_ctn *next;
     } *ctn;
+
+    struct nc_ctn **ctn_index;  /**< hash index of the valid ctn entries by their fingerprint, open addressing */
+    uint32_t ctn_index_size;    /**< number of ctn_index slots, a power of 2 */
+    uint8_t ctn_algs;           /**< bitmask of fingerprint algorithms (1 << code) used by the indexed entries */
+
+    uint8_t keep;               /**< staged copy only, NC_TLS_KEEP_* bitmask of the cached data of the copied options
+                                     taken over on commit, the rest is created again */
+
+    uint8_t ktls;               /**< whether to request kernel TLS offload of the accepted sessions */
 };
 
+#define NC_TLS_KEEP_CTX 0x01    /**< tls_ctx */
+#define NC_TLS_KEEP_CRL 0x02    /**< crl_store */
+#define NC_TLS_KEEP_CTN 0x04    /**< ctn entries with their index */
+
 #endif /* NC_ENABLED_TLS */
 
 /* ACCESS unlocked */
@@ -140,9 +173,20 @@ struct nc_server_unix_opts {
     gid_t gid;
 };
 
+/**
+ * @brief Poll set of listening sockets kept between accepts, rebuilt only when the sockets change.
+ */
+struct nc_bind_pollset {
+    struct pollfd *pfds;         /**< poll structures of all the valid listening sockets in the order of binds */
+    uint16_t count;              /**< number of used pfds */
+    uint16_t size;               /**< number of allocated pfds */
+};
+
 /* ACCESS unlocked */
 struct nc_client_opts {
     char *schema_searchpath;
+    char *schema_cache_dir;
+    int ctx_pool;
     ly_module_imp_clb schema_clb;
     void *schema_clb_data;
     struct nc_keepalives ka;
@@ -176,6 +220,181 @@ struct nc_client_context {
 #endif /* NC_ENABLED_TLS */
 };
 
+/**
+ * @brief Hash index of array items by their name, the name must be the first member of an item.
+ */
+struct nc_name_index {
+    uint16_t *slots;             /**< item index incremented by one for every used slot, 0 for an empty slot */
+    uint32_t size;               /**< number of slots, a power of 2 */
+};
+
+/**
+ * @brief Cached server capabilities of a context, shared by sessions sending their \<hello\>.
+ *
+ * ACCESS locked with cpblts_lock
+ */
+struct nc_server_cpblts {
+    uint32_t refcount;           /**< number of users, including the cache itself */
+    const struct ly_ctx *ctx;    /**< context the capabilities were created from */
+    uint16_t change_count;       /**< change count of @p ctx when the capabilities were created */
+    LYS_VERSION version;         /**< YANG version of the modules */
+    char *content_id;            /**< content-id returned by the content-id callback, if set */
+    char **cpblts;               /**< NULL-terminated capabilities */
+};
+
+/**
+ * @brief Cache of printed modules and submodules returned by the default \<get-schema\> callback.
+ *
+ * ACCESS locked with lock
+ */
+struct nc_server_schema_cache {
+    const struct ly_ctx *ctx;    /**< context of the printed (sub)modules */
+    uint16_t change_count;       /**< change count of @p ctx when the (sub)modules were printed */
+    struct nc_server_schema {
+        const void *mod;         /**< printed module or submodule, NULL for an empty slot */
+        LYS_OUTFORMAT format;    /**< format of @p data */
+        char *data;              /**< printed (sub)module */
+    } *schemas;                  /**< hash table of the printed (sub)modules, open addressing */
+    uint32_t size;               /**< number of schemas slots, a power of 2 */
+    uint32_t count;              /**< number of used schemas slots */
+    size_t mem;                  /**< memory used by all the printed (sub)modules */
+    pthread_mutex_t lock;
+};
+
+/**
+ * Number of linear sub-buckets of every power of 2 in a latency histogram.
+ */
+#define NC_LATENCY_SUB_BUCKETS 8
+
+/**
+ * Number of buckets of a latency histogram, larger latencies than 2^32 usec are counted in the last one.
+ */
+#define NC_LATENCY_BUCKETS (30 * NC_LATENCY_SUB_BUCKETS)
+
+/**
+ * @brief Histogram of latencies in usec, the buckets are powers of 2 split into linear sub-buckets.
+ */
+struct nc_latency_hist {
+    uint64_t count;              /**< number of latencies */
+    uint64_t sum;                /**< sum of all the latencies */
+    uint64_t min;                /**< minimal latency */
+    uint64_t max;                /**< maximal latency */
+    uint32_t buckets[NC_LATENCY_BUCKETS]; /**< number of latencies in every bucket */
+};
+
+/**
+ * @brief Histogram of latencies in usec as ::nc_latency_hist, updated concurrently by atomic operations.
+ */
+struct nc_latency_acc {
+    ATOMIC64_T count;            /**< number of latencies */
+    ATOMIC64_T sum;              /**< sum of all the latencies */
+    ATOMIC64_T min;              /**< minimal latency, UINT64_MAX if there are none */
+    ATOMIC64_T max;              /**< maximal latency */
+    ATOMIC_T buckets[NC_LATENCY_BUCKETS]; /**< number of latencies in every bucket */
+};
+
+/**
+ * @brief Latency histograms of the RPC processing stages for every RPC name.
+ *
+ * ACCESS locked with lock, the histograms are updated with only a read lock
+ */
+struct nc_server_rpc_latency {
+    struct nc_rpc_latency_entry {
+        char *name;              /**< "<module>:<rpc>" name, must be the first member for the name index */
+        struct nc_latency_acc stages[NC_RPC_STAGE_COUNT]; /**< histogram of every stage */
+    } *rpcs;
+    uint16_t count;              /**< number of rpcs */
+    struct nc_name_index index;  /**< name index of rpcs */
+    pthread_rwlock_t lock;
+};
+
+/**
+ * @brief Stage latencies of the RPC currently processed on a server session.
+ *
+ * ACCESS locked with session RPC lock
+ */
+struct nc_rpc_trace {
+    uint64_t stage_usec[NC_RPC_STAGE_COUNT]; /**< time spent in every stage in usec */
+};
+
+/**
+ * @brief RPC processing callback with its user data, replaced as a whole so that it can be used without a lock.
+ *
+ * A replaced callback may still be used by other threads, it is kept until no thread is using any callback.
+ */
+struct nc_server_rpc_clb {
+    union {
+        nc_rpc_trace_clb trace;
+        nc_rpc_envelope_clb envelope;
+    } clb;
+    void *user_data;
+    void (*free_user_data)(void *user_data);
+    struct nc_server_rpc_clb *next; /**< next replaced callback */
+};
+
+/**
+ * @brief Server endpoints with their listening sockets and Call Home clients.
+ *
+ * A configuration batch modifies a staged copy that replaces the current configuration on commit.
+ */
+struct nc_server_config {
+    struct nc_bind *binds;       /**< listening sockets of endpts, in the same order, no sockets in a staged copy */
+    struct nc_endpt {
+        char *name;
+        NC_TRANSPORT_IMPL ti;
+        struct nc_keepalives ka;
+
+        union {
+#ifdef NC_ENABLED_SSH
+            struct nc_server_ssh_opts *ssh;
+#endif
+#ifdef NC_ENABLED_TLS
+            struct nc_server_tls_opts *tls;
+#endif
+            struct nc_server_unix_opts *unixsock;
+        } opts;
+    } *endpts;
+    uint16_t endpt_count;
+    struct nc_name_index endpt_index;
+
+    struct nc_ch_client {
+        char *name;
+        struct nc_ch_endpt {
+            char *name;
+            NC_TRANSPORT_IMPL ti;
+            char *address;
+            uint16_t port;
+            int sock_pending;
+            struct nc_keepalives ka;
+
+            union {
+#ifdef NC_ENABLED_SSH
+                struct nc_server_ssh_opts *ssh;
+#endif
+#ifdef NC_ENABLED_TLS
+                struct nc_server_tls_opts *tls;
+#endif
+            } opts;
+        } *ch_endpts;
+        uint16_t ch_endpt_count;
+        NC_CH_CONN_TYPE conn_type;
+
+        union {
+            struct {
+                uint16_t period;
+                time_t anchor_time;
+                uint16_t idle_timeout;
+            } period;
+        } conn;
+        NC_CH_START_WITH start_with;
+        uint8_t max_attempts;
+        uint32_t id;
+        pthread_mutex_t lock;
+    } *ch_clients;
+    uint16_t ch_client_count;
+    struct nc_name_index ch_client_index;
+};
+
 struct nc_server_opts {
     /* ACCESS unlocked */
     NC_WD_MODE wd_basic_mode;
@@ -186,11 +405,28 @@ struct nc_server_opts {
     char *(*content_id_clb)(void *user_data);
     void *content_id_data;
 
+    struct nc_server_cpblts *cpblts_cache;
+    pthread_mutex_t cpblts_lock;
+
+    struct nc_server_schema_cache schema_cache;
+
     void (*content_id_data_free)(void *data);
 
     /* ACCESS unlocked */
     uint16_t hello_timeout;
     uint16_t idle_timeout;
+    uint32_t out_queue_size;     /**< size limit of session output queues, 0 if they are not used */
+    uint16_t rpc_batch;          /**< maximum number of RPCs of a session processed by one poll */
+    int rpc_latency_enabled;     /**< whether RPC stage latencies are measured */
+    ATOMIC_PTR_T(struct nc_server_rpc_clb *) rpc_trace; /**< RPC trace callback, if set */
+    ATOMIC_PTR_T(struct nc_server_rpc_clb *) rpc_envelope; /**< RPC envelope callback, if set */
+
+    ATOMIC_PTR_T(struct nc_server_rpc_clb *) rpc_clb_replaced; /**< replaced RPC callbacks not freed yet,
+                                                                    modified only with rpc_clb_lock */
+    ATOMIC_T rpc_clb_users;                     /**< number of threads using an RPC callback */
+    pthread_mutex_t rpc_clb_lock;               /**< lock for replacing RPC callbacks */
+
+    struct nc_server_rpc_latency rpc_latency;
 
 #ifdef NC_ENABLED_SSH
     int (*passwd_auth_clb)(const struct nc_session *session, const char *password, void *user_data);
@@ -233,8 +469,21 @@ struct nc_server_opts {
         char *base64;
         NC_SSH_KEY_TYPE type;
         char *username;
+        ssh_key key;             /**< imported public key, NULL if it failed to be imported */
+        uint32_t hash;           /**< hash of the key fingerprint */
+        struct nc_authkey_file {
+            struct timespec mtime;
+            struct timespec ctime;
+            off_t size;
+            ino_t ino;
+            int racy;            /**< changed too recently to be sure a later change would be noticed */
+        } file;                  /**< version of path when the key was imported, zeroed if it could not be accessed */
     } *authkeys;
     uint16_t authkey_count;
+    uint16_t authkey_path_count; /**< number of authkeys imported from a file */
+    uint16_t *authkey_index;     /**< hash index of the imported authkeys by their fingerprint hash,
+                                      authkey index incremented by one for every used slot, 0 for an empty slot */
+    uint32_t authkey_index_size; /**< number of authkey_index slots, a power of 2 */
     pthread_mutex_t authkey_lock;
 
     int (*hostkey_clb)(const char *name, void *user_data, char **privkey_path, char **privkey_data,
@@ -246,82 +495,91 @@ struct nc_server_opts {
     /* ACCESS locked, add/remove endpts/binds - bind_lock + WRITE endpt_lock (strict order!)
      *                modify endpts - WRITE endpt_lock
      *                access endpts - READ endpt_lock
-     *                modify/poll binds - bind_lock */
-    struct nc_bind *binds;
+     *                modify/poll binds - bind_lock
+     *                add/remove CH clients - WRITE lock ch_client_lock
+     *                modify CH clients - READ lock ch_client_lock + ch_client_lock
+     *                replace all - bind_lock + WRITE endpt_lock + WRITE ch_client_lock */
+    struct nc_server_config config;
+    struct nc_bind_pollset bind_pollset;
+    int reuseport;               /**< whether the listening TCP sockets are created with SO_REUSEPORT */
     pthread_mutex_t bind_lock;
-    struct nc_endpt {
-        char *name;
-        NC_TRANSPORT_IMPL ti;
-        struct nc_keepalives ka;
-
-        union {
-#ifdef NC_ENABLED_SSH
-            struct nc_server_ssh_opts *ssh;
-#endif
-#ifdef NC_ENABLED_TLS
-            struct nc_server_tls_opts *tls;
-#endif
-            struct nc_server_unix_opts *unixsock;
-        } opts;
-    } *endpts;
-    uint16_t endpt_count;
     pthread_rwlock_t endpt_lock;
-
-    /* ACCESS locked, add/remove CH clients - WRITE lock ch_client_lock
-     *                modify CH clients - READ lock ch_client_lock + ch_client_lock */
-    struct nc_ch_client {
-        char *name;
-        struct nc_ch_endpt {
-            char *name;
-            NC_TRANSPORT_IMPL ti;
-            char *address;
-            uint16_t port;
-            int sock_pending;
-            struct nc_keepalives ka;
-
-            union {
-#ifdef NC_ENABLED_SSH
-                struct nc_server_ssh_opts *ssh;
-#endif
-#ifdef NC_ENABLED_TLS
-                struct nc_server_tls_opts *tls;
-#endif
-            } opts;
-        } *ch_endpts;
-        uint16_t ch_endpt_count;
-        NC_CH_CONN_TYPE conn_type;
-
-        union {
-            struct {
-                uint16_t period;
-                time_t anchor_time;
-                uint16_t idle_timeout;
-            } period;
-        } conn;
-        NC_CH_START_WITH start_with;
-        uint8_t max_attempts;
-        uint32_t id;
-        pthread_mutex_t lock;
-    } *ch_clients;
-    uint16_t ch_client_count;
     pthread_rwlock_t ch_client_lock;
 
+    /* ACCESS unlocked, config_lock serializes the configuration batches, held from nc_server_config_begin() until
+     * the commit */
+    pthread_mutex_t config_lock;
+    pthread_key_t config_key;    /**< staged configuration of the batch of the calling thread, if any */
+
     /* Atomic IDs */
     ATOMIC_T new_session_id;
     ATOMIC_T new_client_id;
+
+    /* ACCESS atomic */
+    time_t start_time;             /**< real time the server was initialized */
+    struct {
+        ATOMIC_T in_bad_hellos;
+        ATOMIC_T in_sessions;
+        ATOMIC_T dropped_sessions;
+        ATOMIC_T in_rpcs;
+        ATOMIC_T in_bad_rpcs;
+        ATOMIC_T out_rpc_errors;
+        ATOMIC_T out_notifications;
+    } stats;                       /**< global statistics of all the server sessions */
 };
 
+/**
+ * Increase a statistics counter of a server session and the global one.
+ */
+#define NC_SERVER_STATS_INC(session, counter) \
+    do { \
+        ATOMIC_INC_RELAXED((session)->stats.counter); \
+        ATOMIC_INC_RELAXED(server_opts.stats.counter); \
+    } while (0)
+
 /**
  * Sleep time in usec to wait between nc_recv_notif() calls.
  */
 #define NC_CLIENT_NOTIF_THREAD_SLEEP 10000
 
+/**
+ * Maximum number of notifications of a single session processed by a notification reactor worker at once,
+ * the session is then queued again so that other sessions are not starved.
+ */
+#define NC_CLIENT_NOTIF_REACTOR_BATCH 32
+
+/**
+ * Maximum number of events read from epoll by a notification reactor at once.
+ */
+#define NC_CLIENT_NOTIF_REACTOR_EVENTS 64
+
+/**
+ * Maximum number of client pool contexts not used by any session, the least recently used one is destroyed
+ * once there are more.
+ */
+#define NC_CLIENT_CTX_POOL_IDLE_MAX 8
+
+/**
+ * Maximum time in msec a batch connect waits for TCP connections while more targets are waiting to be connected.
+ */
+#define NC_CLIENT_CONNECT_BATCH_WAIT 50
+
+/**
+ * Namespace of the YANG XML elements, such as \<action\>.
+ */
+#define NC_NS_YANG "urn:ietf:params:xml:ns:yang:1"
+
 /**
  * Timeout in msec for transport-related data to arrive (ssh_handle_key_exchange(), SSL_accept(), SSL_connect()).
  * It can be quite a lot on slow machines (waiting for TLS cert-to-name resolution, ...).
  */
 #define NC_TRANSPORT_TIMEOUT 10000
 
+/**
+ * Timeout in seconds for the client \<hello\> to arrive if not set by nc_server_set_hello_timeout().
+ */
+#define NC_SERVER_HELLO_TIMEOUT 60
+
 /**
  * Timeout in msec for acquiring a lock of a session (used with a condition, so higher numbers could be required
  * only in case of extreme concurrency).
@@ -333,6 +591,43 @@ struct nc_server_opts {
  */
 #define NC_SESSION_FREE_LOCK_TIMEOUT 1000
 
+/**
+ * Maximum size in bytes of a received message buffer kept by a server session for the next message.
+ */
+#define NC_SESSION_MBUF_KEEP_SIZE (1024 * 1024)
+
+/**
+ * Time in seconds without an RPC after which a polled server session frees its receive and send buffers.
+ */
+#define NC_SESSION_BUF_IDLE_TIMEOUT 60
+
+/**
+ * Time in seconds after the last change of an authorized key file when another change may not be noticeable
+ * by its timestamps, such a file is imported again on every check.
+ */
+#define NC_AUTHKEY_RACY_TIME 2
+
+/**
+ * Minimal number of slots of a hash index of names.
+ */
+#define NC_NAME_INDEX_MIN_SIZE 16
+
+/**
+ * Maximum memory in bytes used for caching (sub)modules printed by the default \<get-schema\> callback.
+ */
+#define NC_SERVER_SCHEMA_CACHE_MAX_MEM (16 * 1024 * 1024)
+
+/**
+ * Maximum number of attributes of the \<rpc\> element and of the operation element, including namespace
+ * declarations, for the RPC envelope to be read before parsing the whole RPC.
+ */
+#define NC_RPC_ENVELOPE_ATTR_MAX 8
+
+/**
+ * Maximum number of \<get-schema\> RPCs sent by a client without receiving their replies.
+ */
+#define NC_CLIENT_GETSCHEMA_PIPELINE 16
+
 /**
  * Timeout in msec for acquiring a lock of a pollsession structure.
  */
@@ -344,20 +639,91 @@ struct nc_server_opts {
 #define NC_PS_QUEUE_TIMEOUT 5000
 
 /**
- * Time slept in msec if no endpoint was created for a running Call Home client.
+ * Timeout in msec for a Call Home socket to establish its connection.
  */
-#define NC_CH_NO_ENDPT_WAIT 1000
+#define NC_CH_CONNECT_TIMEOUT 500
 
 /**
- * Timeout in msec for a Call Home socket to establish its connection.
+ * Maximum random delay in msec added to an immediate persistent Call Home reconnect so that the clients
+ * of a restarted peer do not all reconnect at once.
  */
-#define NC_CH_CONNECT_TIMEOUT 500
+#define NC_CH_RECONNECT_JITTER 1000
+
+/**
+ * Number of the Call Home scheduler worker threads connecting the clients and performing the handshakes.
+ */
+#define NC_CH_SCHED_WORKERS 4
+
+/**
+ * Maximum time in msec the Call Home scheduler thread waits without rechecking its timer queue.
+ */
+#define NC_CH_SCHED_MAX_WAIT 3600000
 
 /**
  * Number of sockets kept waiting to be accepted.
  */
 #define NC_REVERSE_QUEUE 5
 
+/**
+ * Maximum number of epoll events processed by a single pollsession wait.
+ */
+#define NC_PS_EPOLL_EVENTS 64
+
+/**
+ * Maximum time in msec a pollsession waits in epoll while the output queue of some session cannot be waited for
+ * by epoll (in-memory sessions, sessions read by io_uring).
+ */
+#define NC_PS_EPOLL_OUT_WAIT 1
+
+/**
+ * Number of submission queue entries of a pollsession io_uring instance, more requests are submitted in batches.
+ */
+#define NC_PS_URING_ENTRIES 256
+
+/**
+ * Maximum time in msec a pollsession waits for events while some sessions with expired timers could not
+ * be handled because other threads were working with them.
+ */
+#define NC_PS_TIMER_BUSY_WAIT 100
+
+/**
+ * Number of bits of the slot index of a pollsession timer wheel level, the number of slots of every level.
+ */
+#define NC_PS_WHEEL_BITS 6
+#define NC_PS_WHEEL_SLOTS (1 << NC_PS_WHEEL_BITS)
+
+/**
+ * Number of pollsession timer wheel levels, a level slot lasts NC_PS_WHEEL_SLOTS times longer than a slot of
+ * the level below, the lowest level slots last 1 s.
+ */
+#define NC_PS_WHEEL_LEVELS 3
+
+/**
+ * Timeout in msec used by pollsession dispatcher threads for waiting on events and for session IO.
+ */
+#define NC_PS_DISPATCH_TIMEOUT 100
+
+/**
+ * Number of queued events per a pollsession dispatcher worker thread.
+ */
+#define NC_PS_DISPATCH_QUEUE_FACTOR 4
+
+/**
+ * Maximum difference in the number of sessions of the most and the least loaded pollsession group shard
+ * before the sessions are rebalanced.
+ */
+#define NC_PS_GROUP_SKEW 8
+
+/**
+ * Timeout in msec used by acceptor threads for waiting on new connections.
+ */
+#define NC_ACCEPTOR_TIMEOUT 100
+
+/**
+ * Number of queued connections per an acceptor handshake worker thread.
+ */
+#define NC_ACCEPTOR_QUEUE_FACTOR 4
+
 /**
  * @brief Type of the session
  */
@@ -383,11 +749,117 @@ typedef enum {
 struct nc_msg_cont {
     struct ly_in *msg;
     NC_MSG_TYPE type;         /**< can be either NC_MSG_REPLY or NC_MSG_NOTIF */
+    uint64_t msgid;           /**< message-id of a reply, 0 if unknown */
     struct nc_msg_cont *next;
 };
 
+/**
+ * @brief RPC sent asynchronously waiting for its reply
+ */
+struct nc_rpc_pending {
+    uint64_t msgid;             /**< message-id of the RPC, 0 for an empty slot */
+    struct lyd_node *op;        /**< RPC operation the reply is parsed into */
+    struct lyd_node *envp;      /**< reply envelope, if received and there is no callback */
+    NC_MSG_TYPE type;           /**< NC_MSG_NONE until the reply is received, NC_MSG_REPLY or NC_MSG_ERROR then */
+    nc_rpc_reply_clb reply_clb; /**< callback for the reply */
+    void *user_data;            /**< user data for the callback */
+};
+
+/**
+ * @brief Single-producer single-consumer ring buffer of the in-memory transport.
+ *
+ * The positions only grow and are masked when accessing @p buf, the ring is empty if they are equal.
+ */
+struct nc_mem_ring {
+    char *buf;                   /**< ring data of @p size bytes */
+    uint32_t size;               /**< size of @p buf, a power of 2 */
+    ATOMIC_T head;               /**< number of bytes ever written, changed only by the writing session */
+    ATOMIC_T tail;               /**< number of bytes ever read, changed only by the reading session */
+    int bell[2];                 /**< pipe signalling the reader, readable whenever there are unread data
+                                      (but not only then) so that it can be polled as the transport file descriptor */
+};
+
+/**
+ * @brief In-memory transport shared by a pair of client and server sessions.
+ */
+struct nc_mem_pipe {
+    struct nc_mem_ring ring[2];  /**< client-to-server and server-to-client ring */
+    ATOMIC_T closed;             /**< set once any of the sessions is freed */
+    ATOMIC_T refcount;           /**< number of sessions using the pipe */
+};
+
+/* ring a session reads from and the one it writes into */
+#define NC_MEM_RX(session) (&(session)->ti.mem.pipe->ring[((session)->side == NC_SERVER) ? 0 : 1])
+#define NC_MEM_TX(session) (&(session)->ti.mem.pipe->ring[((session)->side == NC_SERVER) ? 1 : 0])
+
+#ifdef NC_ENABLED_SSH
+
+/**
+ * @brief Lock of an SSH session shared by all the NETCONF sessions on it.
+ *
+ * Only one of the threads waiting for channel data waits on the socket, the others wait on @p cond. Whenever
+ * the lock is released, the data of any channel may have been read from the socket, so all the waiting
+ * threads check their channels again.
+ */
+struct nc_ssh_lock {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;         /**< broadcast whenever @p lock is released */
+    int wake[2];                 /**< pipe waking up the thread waiting on the socket */
+    pthread_t poll_thread;       /**< thread waiting on the socket, if @p polling is set */
+    uint8_t polling;             /**< whether a thread is waiting on the socket */
+    uint8_t woken;               /**< whether @p wake was written to since the socket wait started */
+};
+
+#endif
+
+/**
+ * @brief Stage of a resumable server handshake.
+ */
+enum nc_handshake_stage {
+    NC_HANDSHAKE_TRANSPORT = 0,  /**< SSH key exchange or TLS accept */
+    NC_HANDSHAKE_SSH_AUTH,       /**< SSH user authentication */
+    NC_HANDSHAKE_SSH_CHANNEL,    /**< opening an SSH channel with the "netconf" subsystem */
+    NC_HANDSHAKE_HELLO           /**< waiting for the client \<hello\> */
+};
+
+/**
+ * @brief State of a resumable handshake of a server session accepted by nc_accept_nonblock().
+ */
+struct nc_handshake {
+    enum nc_handshake_stage stage;
+    char *endpt_name;            /**< endpoint the session was accepted on, its options are used in every step */
+    struct timespec ts_timeout;  /**< monotonic deadline of the current stage, if has_timeout is set */
+    int has_timeout;
+    int pending;                 /**< the last step made some progress so another one may, even without new data */
+    void *ti_opts;               /**< transport options of the Call Home endpoint while its client is locked, NULL to
+                                      use the options of @p endpt_name */
+};
+
+/**
+ * @brief Server capabilities received in a \<hello\>, shared by all the client sessions with the same capabilities.
+ *
+ * ACCESS locked with the lock of the set table for @p refcount and @p next, immutable otherwise
+ */
+struct nc_client_cpblts {
+    uint32_t refcount;           /**< number of sessions using the capabilities */
+    uint32_t hash;               /**< hash of all the capabilities */
+    uint32_t count;              /**< number of capabilities */
+    uint32_t idx_size;           /**< size of @p idx, a power of 2, 0 if it could not be created */
+    uint32_t *idx;               /**< hash set of capability indices + 1, keyed by the capability without parameters */
+    char **cpblts;               /**< NULL-terminated capabilities in the order they were received */
+    struct nc_client_cpblts *next; /**< next set in the table */
+};
+
 /**
  * @brief NETCONF session structure
+ *
+ * Memory budget of an idle session (excluding the transport library state): the structure itself takes roughly 0.5
+ * kB on x86_64 glibc, about half of it being the IO lock and either the RPC lock and condition (server side) or the
+ * message queue lock (client side), no other synchronization is allocated per session. The receive and send buffers
+ * are allocated on the first use and polled server sessions free them again once idle for
+ * ::NC_SESSION_BUF_IDLE_TIMEOUT, any RPC trace or handshake state is allocated only when used. Client sessions share
+ * their capabilities with all the sessions that received the same ones (::nc_client_cpblts) and, with the context
+ * pool enabled, their context, too.
  */
 struct nc_session {
     NC_STATUS status;            /**< status of the session */
@@ -401,8 +873,22 @@ struct nc_session {
 
     /* Transport implementation */
     NC_TRANSPORT_IMPL ti_type;   /**< transport implementation type to select items from ti union */
-    pthread_mutex_t *io_lock;    /**< input/output lock, note that in case of libssh TI, it will be shared with
-                                      other NETCONF sessions on the same SSH session (but different SSH channel) */
+    pthread_mutex_t io_lock;     /**< input/output lock of the session buffers and message framing, in case of
+                                      libssh TI the SSH session has its own lock, see ti.libssh.ssh_lock */
+
+    /* receive and send buffers, IO LOCK */
+    char *rbuf;                  /**< data read from the transport but not yet processed, allocated on first read */
+    size_t rbuf_start;           /**< offset of the first unprocessed byte in rbuf */
+    size_t rbuf_len;             /**< number of unprocessed bytes in rbuf */
+    char *wbuf;                  /**< buffer for coalescing data of a message being sent, allocated on first write */
+    char *obuf;                  /**< output queue of messages not yet accepted by the transport, server side only */
+    size_t obuf_start;           /**< offset of the first queued byte in obuf */
+    size_t obuf_len;             /**< number of queued bytes in obuf */
+    size_t obuf_size;            /**< allocated size of obuf */
+    char *mbuf;                  /**< buffer of the last received message kept for the next one, server side only,
+                                      used with the session RPC lock held */
+    size_t mbuf_size;            /**< allocated size of mbuf */
+    struct ly_in *mbuf_in;       /**< input of the message read into mbuf and not yet freed, NULL if mbuf is unused */
 
     union {
         struct {
@@ -412,10 +898,17 @@ struct nc_session {
         struct {
             int sock;            /**< socket file descriptor */
         } unixsock;              /**< NC_TI_UNIX transport implementation structure */
+        struct {
+            struct nc_mem_pipe *pipe; /**< pipe shared with the peer session */
+        } mem;                   /**< NC_TI_MEM transport implementation structure */
 #ifdef NC_ENABLED_SSH
         struct {
             ssh_channel channel;
             ssh_session session;
+            struct nc_ssh_lock *ssh_lock; /**< lock of @p session shared by all the NETCONF sessions on it, held
+                                          only for the libssh calls, they buffer the data of every channel read from
+                                          the socket in the channel so the sessions can be processed concurrently,
+                                          protects also the ring list, lock order is io_lock -> ssh_lock */
             struct nc_session *next; /**< pointer to the next NETCONF session on the same
                                           SSH session, but different SSH channel. If no such session exists, it is NULL.
                                           otherwise there is a ring list of the NETCONF sessions */
@@ -435,16 +928,39 @@ struct nc_session {
     void *data;                    /**< arbitrary user data */
     uint8_t flags;                 /**< various flags of the session */
 #define NC_SESSION_SHAREDCTX 0x01
-#define NC_SESSION_CALLHOME 0x02    /**< session is Call Home and ch_lock is initialized */
-#define NC_SESSION_CH_THREAD 0x04   /**< protected by ch_lock */
+#define NC_SESSION_CALLHOME 0x02    /**< session is Call Home */
+#define NC_SESSION_CH_THREAD 0x04   /**< session is tracked by the Call Home scheduler, protected by its lock */
+
+    /* statistics, updated without any lock */
+    struct {
+        ATOMIC_T in_rpcs;          /**< server side only */
+        ATOMIC_T in_bad_rpcs;      /**< server side only */
+        ATOMIC_T out_rpc_errors;   /**< server side only */
+        ATOMIC_T out_notifications; /**< server side only */
+        ATOMIC64_T in_bytes;
+        ATOMIC64_T out_bytes;
+    } stats;
+
+    /* rate limiting of printed messages, updated without any lock */
+    struct {
+        ATOMIC_T window;           /**< monotonic time (seconds) of the current rate-limiting window */
+        ATOMIC_T count;            /**< messages printed in the current window */
+        ATOMIC_T dropped;          /**< messages dropped since they were last reported */
+    } log;
 
     union {
         struct {
             /* client side only data */
             uint64_t msgid;
-            char **cpblts;                 /**< list of server's capabilities on client side */
+            struct nc_client_cpblts *cpblts; /**< server's capabilities, shared with other sessions */
             pthread_mutex_t msgs_lock;     /**< lock for the msgs buffer */
             struct nc_msg_cont *msgs;      /**< queue for messages received of different type than expected */
+            struct nc_notif_reactor_session *ntf_reactor; /**< notification reactor registration, if any, protected
+                                                               by the reactor lock */
+            struct nc_rpc_pending *rpcs;   /**< hash table of RPCs waiting for their reply by message-id, protected
+                                                by msgs_lock */
+            uint32_t rpc_size;             /**< size of the rpcs hash table */
+            uint32_t rpc_count;            /**< number of RPCs in the rpcs hash table */
             ATOMIC_T ntf_thread_count;     /**< number of running notification threads */
             ATOMIC_T ntf_thread_running;   /**< flag whether there are notification threads for this session running or not */
             struct lyd_node *ext_data;     /**< LY ext data used in the context callback */
@@ -452,24 +968,31 @@ struct nc_session {
             /* client flags */
             /* some server modules failed to load so the data from them will be ignored - not use strict flag for parsing */
 #           define NC_SESSION_CLIENT_NOT_STRICT 0x08
+            /* the context is shared from the client context pool (NC_SESSION_SHAREDCTX is set, too) */
+#           define NC_SESSION_CLIENT_POOLCTX 0x10
         } client;
         struct {
             /* server side only data */
             time_t session_start;          /**< real time the session was created */
             time_t last_rpc;               /**< monotonic time (seconds) the last RPC was received on this session */
 
-            pthread_mutex_t ntf_status_lock;    /**< lock for ntf_status */
-            uint32_t ntf_status;                /**< flag (count) whether the session is subscribed to notifications */
+            ATOMIC_T ntf_status;           /**< flag (count) whether the session is subscribed to notifications */
 
             pthread_mutex_t rpc_lock;    /**< lock indicating RPC processing, this lock is always locked before io_lock!! */
             pthread_cond_t rpc_cond;     /**< RPC condition (tied with rpc_lock and rpc_inuse) */
             int rpc_inuse;               /**< variable indicating whether there is RPC being processed or not (tied with
                                               rpc_cond and rpc_lock) */
 
-            pthread_mutex_t ch_lock;       /**< Call Home thread lock */
-            pthread_cond_t ch_cond;        /**< Call Home thread condition */
+            struct nc_rpc_trace *trace;    /**< stage latencies of the processed RPC, allocated once they are
+                                                measured */
+            struct nc_handshake *handshake; /**< state of the handshake in progress if the session was accepted
+                                                 without blocking (status is NC_STATUS_STARTING) */
+            int out_batch;                 /**< whether all the written messages are collected in obuf until
+                                                the current batch of RPCs is processed, IO LOCK */
 
             /* server flags */
+            /* hello exchange was successful and the session is counted in the statistics */
+#           define NC_SESSION_SERVER_COUNTED 0x08
 #ifdef NC_ENABLED_SSH
             /* SSH session authenticated */
 #           define NC_SESSION_SSH_AUTHENTICATED 0x10
@@ -498,6 +1021,35 @@ enum nc_ps_session_state {
 struct nc_ps_session {
     struct nc_session *session;
     enum nc_ps_session_state state;
+#ifdef HAVE_EPOLL
+    int fd;                    /**< transport file descriptor registered in the pollsession epoll set */
+    uint8_t ready;             /**< epoll reported some data on fd since the session was last polled */
+    uint8_t out_wait;          /**< fd is registered for EPOLLOUT because the session output queue is not empty */
+    uint8_t parked;            /**< fd is not waited for while another thread works with the session */
+#endif
+#ifdef HAVE_IO_URING
+    uint8_t uring_op;          /**< io_uring request on the transport in progress, if any, the transport and the
+                                    receive buffer must not be used until it completes */
+#define NC_PS_URING_READ 0x01  /**< reading the transport into the free space of the session receive buffer */
+#define NC_PS_URING_POLL 0x02  /**< waiting for the transport to become readable */
+#endif
+    time_t timer_expire;       /**< monotonic time in sec of the idle or handshake timeout, 0 if not scheduled */
+    struct nc_ps_session **timer_list; /**< timer wheel slot or expired list with the session, NULL if none */
+    struct nc_ps_session *timer_prev;
+    struct nc_ps_session *timer_next;
+};
+
+/**
+ * @brief Hierarchical timer wheel of the idle and handshake timeouts of pollsession sessions.
+ *
+ * The timers are rescheduled lazily, only when they expire, so processing an RPC does not update the wheel.
+ */
+struct nc_ps_wheel {
+    struct nc_ps_session *slots[NC_PS_WHEEL_LEVELS][NC_PS_WHEEL_SLOTS]; /**< lists of the scheduled sessions */
+    struct nc_ps_session *expired;   /**< sessions with expired timers not handled yet */
+    time_t now;                      /**< monotonic time in sec up to which all the timers expired */
+    uint32_t count;                  /**< number of the sessions in the slots */
+    uint16_t idle_timeout;           /**< server idle timeout the timers were scheduled with */
 };
 
 /* ACCESS locked */
@@ -511,16 +1063,262 @@ struct nc_pollsession {
     uint8_t queue[NC_PS_QUEUE_SIZE]; /**< round buffer, queue is empty when queue_len == 0 */
     uint8_t queue_begin;             /**< queue starts on queue[queue_begin] */
     uint8_t queue_len;               /**< queue ends on queue[(queue_begin + queue_len - 1) % NC_PS_QUEUE_SIZE] */
+
+    struct nc_ps_wheel wheel;        /**< timeouts of the sessions */
+
+#ifdef HAVE_EPOLL
+    int epfd;                        /**< epoll instance with all the session transports, -1 if not used */
+    int wakefd;                      /**< eventfd used to interrupt a thread waiting in epoll */
+    uint16_t parked_count;           /**< number of parked sessions */
+#endif
+#ifdef HAVE_IO_URING
+    struct io_uring uring;           /**< io_uring instance reading FD and UNIX socket sessions, the other sessions
+                                          are waited for by a poll request on epfd so there is a single wait */
+    int uring_used;                  /**< whether uring is initialized and used */
+    int uring_epoll;                 /**< whether a poll request on epfd is in progress in uring */
+#endif
+};
+
+/**
+ * @brief Event detected on a pollsession session waiting for a dispatcher worker.
+ */
+struct nc_ps_dispatch_event {
+    struct nc_session *session;
+    struct nc_ps_session *ps_session;
+    int ret;                         /**< NC_PSPOLL_* bits of the event */
+    time_t now_mono;                 /**< monotonic time the event was detected at */
+};
+
+struct nc_ps_dispatcher {
+    struct nc_pollsession *ps;
+    void (*event_clb)(struct nc_pollsession *ps, struct nc_session *session, int ret, void *user_data);
+    void *user_data;
+
+    pthread_t io_tid;                /**< thread detecting events on the sessions */
+    pthread_t *worker_tids;          /**< threads processing the events */
+    uint16_t worker_count;
+
+    /* ACCESS locked - lock */
+    pthread_mutex_t lock;
+    pthread_cond_t event_cond;       /**< signalled when an event was queued or when stopping */
+    pthread_cond_t space_cond;       /**< signalled when an event was dequeued or when stopping */
+    struct nc_ps_dispatch_event *queue; /**< round buffer, queue is empty when queue_len == 0 */
+    uint16_t queue_size;
+    uint16_t queue_begin;
+    uint16_t queue_len;
+    int stop;                        /**< flag for all the threads to terminate */
+};
+
+/**
+ * @brief Connection accepted by an acceptor thread waiting for a handshake worker.
+ */
+struct nc_acceptor_conn {
+    int sock;
+    char *host;
+    uint16_t port;
+    uint16_t bind_idx;               /**< index of the bind (endpoint) the connection was accepted on */
+    char *bind_address;              /**< address of the bind to check it has not changed meanwhile */
+    uint16_t bind_port;
+};
+
+/**
+ * @brief Acceptor thread waiting for new connections.
+ */
+struct nc_acceptor_thread {
+    struct nc_acceptor *acc;
+    pthread_t tid;
+    int own_binds;                   /**< whether the thread listens on its own SO_REUSEPORT sockets */
+    struct nc_bind *binds;           /**< own listening sockets, the same index as the server binds */
+    uint16_t bind_count;
+    struct nc_bind_pollset pollset;  /**< poll set of the own listening sockets or a copy of the server one */
+};
+
+struct nc_acceptor {
+    const struct ly_ctx *ctx;
+    void (*session_clb)(struct nc_session *session, void *user_data);
+    void *user_data;
+
+    struct nc_acceptor_thread *threads;
+    uint16_t thread_count;
+    pthread_t *worker_tids;          /**< threads performing the handshakes */
+    uint16_t worker_count;
+
+    /* ACCESS locked - lock */
+    pthread_mutex_t lock;
+    pthread_cond_t conn_cond;        /**< signalled when a connection was queued or when stopping */
+    pthread_cond_t space_cond;       /**< signalled when a connection was dequeued or when stopping */
+    struct nc_acceptor_conn *queue;  /**< round buffer, queue is empty when queue_len == 0 */
+    uint16_t queue_size;
+    uint16_t queue_begin;
+    uint16_t queue_len;
+    int stop;                        /**< flag for all the threads to terminate */
+};
+
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+
+/**
+ * @brief State of a Call Home client job of the Call Home scheduler.
+ */
+enum nc_ch_job_state {
+    NC_CH_JOB_WAIT = 0,      /**< waiting in the timer queue and for its connecting socket, if any */
+    NC_CH_JOB_QUEUED,        /**< waiting for a worker */
+    NC_CH_JOB_BUSY           /**< next step being performed by a worker */
+};
+
+/**
+ * @brief Call Home client dispatched by the Call Home scheduler.
+ */
+struct nc_ch_job {
+    char *client_name;
+    uint32_t client_id;              /**< ID of the client, 0 until it is first found */
+    nc_server_ch_session_acquire_ctx_cb acquire_ctx_cb;
+    nc_server_ch_session_release_ctx_cb release_ctx_cb;
+    void *ctx_cb_data;
+    nc_server_ch_new_session_cb new_session_cb;
+
+    /* ACCESS locked - scheduler lock */
+    enum nc_ch_job_state state;
+    uint32_t heap_idx;               /**< index in the timer queue while waiting */
+    struct timespec ts_due;          /**< monotonic time of the next step */
+    int again;                       /**< the session was freed during a step, perform the next one immediately */
+    struct nc_session *session;      /**< established session still tracked, NULL if none */
+    struct nc_ch_job *next;          /**< next in the worker queue */
+
+    /* ACCESS only the worker performing a step, except for the sock read by the scheduler thread while waiting */
+    char *endpt_name;                /**< current endpoint, NULL before the first connect */
+    uint8_t attempts;                /**< failed connection attempts to the current endpoint */
+    int sock;                        /**< pending socket of the endpoint being connected or the socket of the starting
+                                          session, -1 if none */
+    short sock_events;               /**< poll events to wait for on @p sock */
+    struct nc_session *starting;     /**< session with a handshake in progress, NULL if none */
+    int established;                 /**< whether a session was established and its termination not yet handled */
+    unsigned int seed;               /**< seed of the random delays and endpoints */
+};
+
+/**
+ * @brief Call Home scheduler, one thread waiting for the due jobs and the connecting sockets of all the clients.
+ */
+struct nc_ch_sched {
+    int wakefd[2];                   /**< pipe used to interrupt the scheduler thread */
+    pthread_t tid;
+    pthread_t *worker_tids;          /**< threads performing the job steps */
+    uint16_t worker_count;
+    struct pollfd *pfds;             /**< poll set of the scheduler thread, accessed only by it */
+    struct nc_ch_job **pjobs;        /**< jobs of the connecting sockets in the poll set */
+    uint32_t pfd_size;
+
+    /* ACCESS locked - lock */
+    pthread_mutex_t lock;
+    pthread_cond_t job_cond;         /**< signalled when a job was queued or when stopping */
+    struct nc_ch_job **jobs;         /**< all the jobs */
+    uint32_t job_count;
+    struct nc_ch_job **heap;         /**< waiting jobs, binary min-heap ordered by their due time */
+    uint32_t heap_count;
+    struct nc_ch_job *queue_head;    /**< jobs waiting for a worker */
+    struct nc_ch_job *queue_tail;
+    int stop;                        /**< flag for all the threads to terminate */
+};
+
+#endif /* NC_ENABLED_SSH || NC_ENABLED_TLS */
+
+struct nc_ps_group {
+    struct nc_pollsession **shards;
+    uint16_t shard_count;
+    pthread_mutex_t rebalance_lock;  /**< only one thread can be moving sessions between shards */
+};
+
+struct nc_ntf_thread_arg {
+    struct nc_session *session;
+    nc_notif_dispatch_clb notif_clb;
+    void *user_data;
+
+    void (*free_data)(void *);
+};
+
+/**
+ * @brief State of a session dispatched by the client notification reactor.
+ */
+enum nc_notif_reactor_state {
+    NC_NTF_REACTOR_IDLE = 0,   /**< waiting for data, transport file descriptor armed in epoll */
+    NC_NTF_REACTOR_QUEUED,     /**< waiting for a worker */
+    NC_NTF_REACTOR_BUSY,       /**< notifications being processed by a worker */
+    NC_NTF_REACTOR_REMOVED     /**< no longer dispatched, only waiting to be freed */
+};
+
+/**
+ * @brief Session dispatched by the client notification reactor.
+ */
+struct nc_notif_reactor_session {
+    struct nc_session *session;
+    nc_notif_dispatch_clb notif_clb;
+    void *user_data;
+    void (*free_data)(void *);
+
+    int fd;                          /**< transport file descriptor registered in epoll */
+    uint32_t idx;                    /**< index in the reactor sessions */
+    enum nc_notif_reactor_state state;
+    int again;                       /**< new data may have arrived while being processed */
+    int stop;                        /**< session is being freed, stop dispatching it */
+    struct nc_notif_reactor_session *next; /**< next in the reactor queue or garbage */
+};
+
+/* ACCESS locked - notification reactor lock */
+struct nc_notif_reactor {
+    int epfd;                        /**< epoll instance with all the session transports */
+    int wakefd;                      /**< eventfd used to interrupt the I/O thread */
+    pthread_t io_tid;                /**< thread waiting for data on the sessions */
+    pthread_t *worker_tids;          /**< threads receiving the notifications and calling the callbacks */
+    uint16_t worker_count;
+
+    pthread_cond_t event_cond;       /**< signalled when a session was queued or when stopping */
+    struct nc_notif_reactor_session **sessions;
+    uint32_t session_count;
+    struct nc_notif_reactor_session *queue_head; /**< sessions waiting for a worker */
+    struct nc_notif_reactor_session *queue_tail;
+    struct nc_notif_reactor_session *garbage; /**< removed sessions, freed by the I/O thread once no epoll event
+                                                   can refer to them */
+    int stop;                        /**< flag for all the threads to terminate */
+};
+
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+
+/**
+ * @brief Target of a batch connect whose TCP connection is being established or waits for a handshake.
+ */
+struct nc_connect_batch_conn {
+    uint32_t idx;                    /**< index of the target */
+    const char *host;                /**< hostname of the target */
+    uint16_t port;                   /**< port of the target */
+    struct addrinfo *res_list;       /**< resolved addresses of the target */
+    struct addrinfo *res;            /**< address being connected to */
+    int sock;                        /**< socket being connected or connected, -1 if none */
+    struct timespec ts_timeout;      /**< monotonic time the connect to res times out, zero if never */
+    char *ip_host;                   /**< IP address of the connected socket */
+    struct nc_connect_batch_conn *next; /**< next in the worker queue or in the resolved list */
 };
 
-struct nc_ntf_thread_arg {
-    struct nc_session *session;
-    nc_notif_dispatch_clb notif_clb;
+/* ACCESS locked - batch lock */
+struct nc_connect_batch {
+    const struct nc_connect_target *targets;
+    struct ly_ctx *ctx;
+    nc_connect_batch_clb clb;
     void *user_data;
+    struct nc_client_context *context; /**< client context of the thread driving the batch, used by the workers */
 
-    void (*free_data)(void *);
+    pthread_mutex_t lock;
+    pthread_cond_t cond;             /**< signalled when a connection was queued, taken, or resolved and when
+                                          stopping */
+    struct nc_connect_batch_conn *queue_head; /**< connected targets waiting for a worker for their handshake and
+                                                   targets (without a socket) waiting for a worker to resolve them */
+    struct nc_connect_batch_conn *queue_tail;
+    uint32_t queued;                 /**< number of connected targets in the queue */
+    struct nc_connect_batch_conn *resolved; /**< targets resolved by the workers, without any addresses on error */
+    int wakefd[2];                   /**< pipe waking up the thread driving the connects once a target is resolved */
+    int stop;                        /**< no more connections will be queued */
 };
 
+#endif
+
 #ifdef NC_ENABLED_SSH
 
 /**
@@ -575,11 +1373,33 @@ int32_t nc_difftimespec_real_cur(const struct timespec *ts);
  */
 int32_t nc_difftimespec_mono_cur(const struct timespec *ts);
 
+/**
+ * @brief Get the current monotonic time in microseconds.
+ *
+ * @return Monotonic time in usec.
+ */
+uint64_t nc_time_mono_usec(void);
+
+/**
+ * @brief Initial value of an FNV-1a hash.
+ */
+#define NC_HASH_FNV1A_INIT 2166136261U
+
+/**
+ * @brief Add data to an FNV-1a hash.
+ *
+ * @param[in] hash Hash of the previous data, ::NC_HASH_FNV1A_INIT for none.
+ * @param[in] data Data to add.
+ * @param[in] len Length of @p data.
+ * @return Updated hash.
+ */
+uint32_t nc_hash_fnv1a(uint32_t hash, const void *data, size_t len);
+
 const char *nc_keytype2str(NC_SSH_KEY_TYPE type);
 
 int nc_sock_enable_keepalive(int sock, struct nc_keepalives *ka);
 
-struct nc_session *nc_new_session(NC_SIDE side, int shared_ti);
+struct nc_session *nc_new_session(NC_SIDE side);
 
 int nc_session_rpc_lock(struct nc_session *session, int timeout, const char *func);
 
@@ -607,6 +1427,47 @@ int nc_session_io_lock(struct nc_session *session, int timeout, const char *func
  */
 int nc_session_io_unlock(struct nc_session *session, const char *func);
 
+#ifdef NC_ENABLED_SSH
+
+/**
+ * @brief Create the lock of a new SSH session.
+ *
+ * @param[in] session First NETCONF session on the SSH session.
+ * @return 0 on success, -1 on error.
+ */
+int nc_session_ssh_lock_new(struct nc_session *session);
+
+/**
+ * @brief Free the lock of an SSH session, it must not be used by any thread.
+ *
+ * @param[in] session Last NETCONF session on the SSH session.
+ */
+void nc_session_ssh_lock_free(struct nc_session *session);
+
+/**
+ * @brief Lock the SSH session of a session, shared with the other NETCONF sessions on it.
+ *
+ * @param[in] session Session to lock.
+ * @param[in] timeout Timeout in msec to use.
+ * @param[in] func Caller function for logging.
+ * @return 1 on success;
+ * @return 0 on timeout;
+ * @return -1 on error.
+ */
+int nc_session_ssh_lock(struct nc_session *session, int timeout, const char *func);
+
+/**
+ * @brief Unlock the SSH session of a session and wake up all the threads waiting for channel data.
+ *
+ * @param[in] session Session to unlock.
+ * @param[in] func Caller function for logging.
+ * @return 1 on success;
+ * @return -1 on error.
+ */
+int nc_session_ssh_unlock(struct nc_session *session, const char *func);
+
+#endif /* NC_ENABLED_SSH */
+
 /**
  * @brief Lock MSGS lock on a session.
  *
@@ -654,6 +1515,99 @@ int nc_ctx_check_and_fill(struct nc_session *session);
  */
 NC_MSG_TYPE nc_handshake_io(struct nc_session *session);
 
+/**
+ * @brief Send the server \<hello\> on @p session, the first part of a server-side NETCONF handshake.
+ *
+ * @param[in] session NETCONF server session to use.
+ * @return NC_MSG_HELLO on success, NC_MSG_WOULDBLOCK on timeout, NC_MSG_ERROR on other error.
+ */
+NC_MSG_TYPE nc_handshake_send_io(struct nc_session *session);
+
+/**
+ * @brief Receive the client \<hello\> on @p session, the second part of a server-side NETCONF handshake.
+ *
+ * @param[in] session NETCONF server session to use.
+ * @param[in] timeout Timeout for the message to arrive in msec, 0 to only check it is available.
+ * @return NC_MSG_HELLO on success, NC_MSG_BAD_HELLO on client \<hello\> message parsing fail,
+ * NC_MSG_WOULDBLOCK on timeout, NC_MSG_ERROR on other error.
+ */
+NC_MSG_TYPE nc_handshake_recv_io(struct nc_session *session, int timeout);
+
+/**
+ * @brief Learn the length of the \<hello\> message a server session would send.
+ *
+ * @param[in] ctx Context of the server session.
+ * @param[in] sid Session ID of the server session.
+ * @return Length of the message including its end tag, 0 on error.
+ */
+size_t nc_server_hello_len(const struct ly_ctx *ctx, uint32_t sid);
+
+/**
+ * @brief Perform NETCONF handshake of a pair of in-memory transport sessions in a single thread.
+ *
+ * Both \<hello\> messages are written before any is read (the received one changes the NETCONF version used for
+ * sending) so the server-to-client ring must be large enough for the server \<hello\>, see nc_server_hello_len().
+ *
+ * @param[in] server Server session to use.
+ * @param[in] client Client session connected to @p server.
+ * @return NC_MSG_HELLO on success, NC_MSG_BAD_HELLO on \<hello\> message parsing fail, NC_MSG_ERROR on other error.
+ */
+NC_MSG_TYPE nc_handshake_mem_io(struct nc_session *server, struct nc_session *client);
+
+/**
+ * @brief Release a context of a client session taken from the client context pool.
+ *
+ * @param[in] ctx Context to release, kept in the pool for future sessions.
+ */
+void nc_client_ctx_pool_release(const struct ly_ctx *ctx);
+
+/**
+ * @brief Get shared server capabilities of a client session.
+ *
+ * @param[in] cpblts NULL-terminated received capabilities, spent.
+ * @return Referenced capabilities shared by all the sessions with the same ones, NULL on error.
+ */
+struct nc_client_cpblts *nc_client_cpblts_get(char **cpblts);
+
+/**
+ * @brief Release shared server capabilities of a client session, freed with the last reference.
+ *
+ * @param[in] cpblts Capabilities to release.
+ */
+void nc_client_cpblts_release(struct nc_client_cpblts *cpblts);
+
+/**
+ * @brief Free all RPCs of a client session waiting for their reply, their callbacks are called with an error.
+ *
+ * The callbacks are called with the session unlocked and the RPCs detached from it. Any RPCs sent asynchronously
+ * by the callbacks are freed the same way.
+ *
+ * @param[in] session Session to use, MSGS lock must not be held.
+ */
+void nc_client_rpc_pending_free(struct nc_session *session);
+
+/**
+ * @brief Stop dispatching notifications of a client session by the notification reactor, if it is.
+ *
+ * @param[in] session Session being freed.
+ */
+void nc_client_notif_reactor_del(struct nc_session *session);
+
+/**
+ * @brief Get the file descriptor signalling new data on a session transport.
+ *
+ * @param[in] session Session to use.
+ * @return Transport file descriptor, -1 if there is none.
+ */
+int nc_session_ti_fd(const struct nc_session *session);
+
+/**
+ * @brief Drop the cached server capabilities so that they are created again for the next session.
+ *
+ * @param[in] ctx Drop them only if created from this context, NULL to drop them always.
+ */
+void nc_server_cpblts_invalidate(const struct ly_ctx *ctx);
+
 /**
  * @brief Create a socket connection.
  *
@@ -686,9 +1640,10 @@ int nc_sock_accept(int sock, int timeout, char **peer_host, uint16_t *peer_port)
  * @param[in] address IP address to listen on.
  * @param[in] port Port to listen on.
  * @param[in] ka Keepalives parameters.
+ * @param[in] reuseport Whether to set SO_REUSEPORT so that more sockets can listen on the same address and port.
  * @return Listening socket, -1 on error.
  */
-int nc_sock_listen_inet(const char *address, uint16_t port, struct nc_keepalives *ka);
+int nc_sock_listen_inet(const char *address, uint16_t port, struct nc_keepalives *ka, int reuseport);
 
 /**
  * @brief Create a listening socket (AF_UNIX).
@@ -704,13 +1659,16 @@ int nc_sock_listen_unix(const char *address, const struct nc_server_unix_opts *o
  *
  * @param[in] binds Structure with the listening sockets.
  * @param[in] bind_count Number of @p binds.
+ * @param[in] pollset Poll set of @p binds kept between the calls, updated if the sockets changed.
+ * Can be NULL, a temporary one is used then.
  * @param[in] timeout Timeout for accepting.
  * @param[out] host Host of the remote peer. Can be NULL.
  * @param[out] port Port of the new connection. Can be NULL.
  * @param[out] idx Index of the bind that was accepted. Can be NULL.
- * @return Accepted socket of the new connection, -1 on error.
+ * @return Accepted socket of the new connection, 0 on timeout, -1 on error.
  */
-int nc_sock_accept_binds(struct nc_bind *binds, uint16_t bind_count, int timeout, char **host, uint16_t *port, uint16_t *idx);
+int nc_sock_accept_binds(struct nc_bind *binds, uint16_t bind_count, struct nc_bind_pollset *pollset, int timeout,
+        char **host, uint16_t *port, uint16_t *idx);
 
 /**
  * @brief Lock endpoint structures for reading and the specific endpoint.
@@ -722,6 +1680,26 @@ int nc_sock_accept_binds(struct nc_bind *binds, uint16_t bind_count, int timeout
  */
 struct nc_endpt *nc_server_endpt_lock_get(const char *name, NC_TRANSPORT_IMPL ti, uint16_t *idx);
 
+/**
+ * @brief Unlock endpoint structures locked by nc_server_endpt_lock_get().
+ */
+void nc_server_endpt_unlock(void);
+
+/**
+ * @brief Get the server configuration modified by the calling thread.
+ *
+ * @param[out] cfg Staged configuration if the calling thread started a configuration batch, the current one otherwise.
+ * @return 1 if the calling thread started a configuration batch and so needs no configuration locks, 0 otherwise.
+ */
+int nc_server_config_batch_get(struct nc_server_config **cfg);
+
+/**
+ * @brief Check whether the calling thread started a configuration batch and so modifies a staged configuration.
+ *
+ * @return 1 if it did, 0 otherwise.
+ */
+int nc_server_config_batch_owner(void);
+
 /**
  * @brief Lock CH client structures for reading and lock the specific client.
  *
@@ -741,6 +1719,25 @@ struct nc_ch_endpt *nc_server_ch_client_lock(const char *name, const char *endpt
  */
 void nc_server_ch_client_unlock(struct nc_ch_client *client);
 
+/**
+ * @brief Make the Call Home scheduler stop tracking a session being freed and reconnect its client.
+ *
+ * @param[in] session Call Home session with the ::NC_SESSION_CH_THREAD flag.
+ */
+void nc_ch_sched_session_free(struct nc_session *session);
+
+/**
+ * @brief Make the Call Home scheduler apply the changed configuration of a client right away.
+ *
+ * @param[in] client_name Name of the changed client, NULL for all the clients.
+ */
+void nc_ch_sched_client_changed(const char *client_name);
+
+/**
+ * @brief Stop the Call Home scheduler and free it, no Call Home client is connected anymore.
+ */
+void nc_ch_sched_destroy(void);
+
 /**
  * @brief Add a client Call Home bind, listen on it.
  *
@@ -792,6 +1789,18 @@ void nc_destroy(void);
  */
 struct nc_session *nc_accept_callhome_ssh_sock(int sock, const char *host, uint16_t port, struct ly_ctx *ctx, int timeout);
 
+/**
+ * @brief Connect to a NETCONF server using SSH on a connected socket.
+ *
+ * @param[in] host Hostname of the server.
+ * @param[in] port Port of the server.
+ * @param[in] sock Connected socket, is assigned to the session or closed.
+ * @param[in] ip_host IP address of the server, is assigned to the session or freed.
+ * @param[in] ctx Context for the session. Can be NULL.
+ * @return New session, NULL on error.
+ */
+struct nc_session *nc_connect_ssh_sock(const char *host, uint16_t port, int sock, char *ip_host, struct ly_ctx *ctx);
+
 /**
  * @brief Establish SSH transport on a socket.
  *
@@ -802,6 +1811,26 @@ struct nc_session *nc_accept_callhome_ssh_sock(int sock, const char *host, uint1
  */
 int nc_accept_ssh_session(struct nc_session *session, int sock, int timeout);
 
+/**
+ * @brief Start establishing SSH transport on a socket without blocking.
+ *
+ * @param[in] session Session structure of the new connection.
+ * @param[in] sock Socket of the new connection, is assigned to the session or closed.
+ * @return 1 on success, -1 on error.
+ */
+int nc_accept_ssh_session_start(struct nc_session *session, int sock);
+
+/**
+ * @brief Perform a non-blocking step of establishing SSH transport started by nc_accept_ssh_session_start().
+ *
+ * Stage timeouts are not checked, only their deadlines set in @p hs.
+ *
+ * @param[in] session Session structure of the new connection.
+ * @param[in] hs Handshake state with the SSH stage, is updated.
+ * @return 1 if the transport is established, 0 if still in progress, -1 on error.
+ */
+int nc_accept_ssh_session_step(struct nc_session *session, struct nc_handshake *hs);
+
 /**
  * @brief Callback called when a new SSH message is received.
  *
@@ -812,8 +1841,31 @@ int nc_accept_ssh_session(struct nc_session *session, int sock, int timeout);
  */
 int nc_sshcb_msg(ssh_session sshsession, ssh_message msg, void *data);
 
+/**
+ * @brief Create new SSH options with the default values.
+ *
+ * @return New options, NULL on error.
+ */
+struct nc_server_ssh_opts *nc_server_ssh_opts_new(void);
+
 void nc_server_ssh_clear_opts(struct nc_server_ssh_opts *opts);
 
+/**
+ * @brief Copy SSH options to be staged by a configuration batch, without their cached data.
+ *
+ * @param[in] opts SSH options to copy.
+ * @return Copied options, NULL on error.
+ */
+struct nc_server_ssh_opts *nc_server_ssh_opts_dup(const struct nc_server_ssh_opts *opts);
+
+/**
+ * @brief Finish staged SSH options on commit, take over the cached data of the current options that did not change.
+ *
+ * @param[in] opts Staged SSH options.
+ * @param[in] cur Current options of the same endpoint, NULL if none.
+ */
+void nc_server_ssh_opts_take(struct nc_server_ssh_opts *opts, struct nc_server_ssh_opts *cur);
+
 void nc_client_ssh_destroy_opts(void);
 void _nc_client_ssh_destroy_opts(struct nc_client_ssh_opts *opts);
 
@@ -824,6 +1876,26 @@ void _nc_client_ssh_destroy_opts(struct nc_client_ssh_opts *opts);
 struct nc_session *nc_accept_callhome_tls_sock(int sock, const char *host, uint16_t port, struct ly_ctx *ctx,
         int timeout, const char *peername);
 
+/**
+ * @brief Check the client TLS options and create or update the TLS context before connecting.
+ *
+ * @param[in] host Hostname of the server verified by the context, if it is created.
+ * @return 0 on success, -1 on error.
+ */
+int nc_connect_tls_prepare(const char *host);
+
+/**
+ * @brief Connect to a NETCONF server using TLS on a connected socket, nc_connect_tls_prepare() must have been called.
+ *
+ * @param[in] host Hostname of the server, it is verified.
+ * @param[in] port Port of the server.
+ * @param[in] sock Connected socket, is assigned to the session or closed.
+ * @param[in] ip_host IP address of the server, is assigned to the session or freed.
+ * @param[in] ctx Context for the session. Can be NULL.
+ * @return New session, NULL on error.
+ */
+struct nc_session *nc_connect_tls_sock(const char *host, uint16_t port, int sock, char *ip_host, struct ly_ctx *ctx);
+
 /**
  * @brief Establish TLS transport on a socket.
  *
@@ -834,8 +1906,73 @@ struct nc_session *nc_accept_callhome_tls_sock(int sock, const char *host, uint1
  */
 int nc_accept_tls_session(struct nc_session *session, int sock, int timeout);
 
+/**
+ * @brief Request kernel TLS offload for a TLS connection, must be called before its handshake.
+ * Does nothing if OpenSSL does not support it.
+ *
+ * @param[in] tls TLS connection.
+ */
+void nc_tls_ktls_enable(SSL *tls);
+
+/**
+ * @brief Get the kernel TLS offload of an established TLS connection.
+ *
+ * @param[in] tls TLS connection.
+ * @return Bitmask of ::NC_TLS_KTLS values.
+ */
+int nc_tls_ktls_get(SSL *tls);
+
+/**
+ * @brief Print whether the requested kernel TLS offload is active for an established TLS connection.
+ *
+ * @param[in] session Session of the connection, if any.
+ * @param[in] tls TLS connection.
+ */
+void nc_tls_ktls_print(const struct nc_session *session, SSL *tls);
+
+/**
+ * @brief Start establishing TLS transport on a socket without blocking.
+ *
+ * @param[in] session Session structure of the new connection.
+ * @param[in] sock Socket of the new connection, is assigned to the session or closed.
+ * @return 1 on success, -1 on error.
+ */
+int nc_accept_tls_session_start(struct nc_session *session, int sock);
+
+/**
+ * @brief Perform a non-blocking step of establishing TLS transport started by nc_accept_tls_session_start().
+ *
+ * @param[in] session Session structure of the new connection.
+ * @return 1 if the transport is established, 0 if still in progress, -1 on error.
+ */
+int nc_accept_tls_session_step(struct nc_session *session);
+
 void nc_server_tls_clear_opts(struct nc_server_tls_opts *opts);
 
+/**
+ * @brief Copy TLS options to be staged by a configuration batch, without their cached data.
+ *
+ * @param[in] opts TLS options to copy.
+ * @return Copied options, NULL on error.
+ */
+struct nc_server_tls_opts *nc_server_tls_opts_dup(const struct nc_server_tls_opts *opts);
+
+/**
+ * @brief Load the CRL store of staged TLS options if their CRL locations changed.
+ *
+ * @param[in] opts Staged TLS options.
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_tls_opts_load(struct nc_server_tls_opts *opts);
+
+/**
+ * @brief Finish staged TLS options on commit, take over the cached data of the current options that did not change.
+ *
+ * @param[in] opts Staged TLS options.
+ * @param[in] cur Current options of the same endpoint, NULL if none.
+ */
+void nc_server_tls_opts_take(struct nc_server_tls_opts *opts, struct nc_server_tls_opts *cur);
+
 void nc_client_tls_destroy_opts(void);
 void _nc_client_tls_destroy_opts(struct nc_client_tls_opts *opts);
 
@@ -879,6 +2016,51 @@ int nc_read_msg_poll_io(struct nc_session *session, int io_timeout, struct ly_in
  */
 int nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **msg, int passing_io_lock);
 
+/**
+ * @brief Read a message from the wire into the message buffer of the session,
+ * the buffer is reused for the next message once the message is freed.
+ *
+ * Falls back to nc_read_msg_io() if the previous message read into the buffer was not freed yet.
+ *
+ * @param[in] session NETCONF session from which the message is being read.
+ * @param[in] io_timeout Timeout in milliseconds. Negative value means infinite timeout,
+ *            zero value causes to return immediately.
+ * @param[out] msg Input handled with the NETCONF message (application layer data), free with nc_read_msg_free().
+ * @return 1 on success.
+ * @return 0 on timeout.
+ * @return -1 on error.
+ * @return -2 on malformed message error.
+ */
+int nc_read_msg_buf_io(struct nc_session *session, int io_timeout, struct ly_in **msg);
+
+/**
+ * @brief Free a message read by nc_read_msg_buf_io() and release the message buffer of the session.
+ *
+ * The buffer is freed as well if it grew larger than NC_SESSION_MBUF_KEEP_SIZE.
+ *
+ * @param[in] session NETCONF session the message was read from.
+ * @param[in] msg Message to free, may be NULL.
+ */
+void nc_read_msg_free(struct nc_session *session, struct ly_in *msg);
+
+/**
+ * @brief Free the receive, send, and message buffers of a session not being used, they are allocated again
+ * once needed. Session IO lock is expected to be held.
+ *
+ * @param[in] session Session to use.
+ */
+void nc_session_buf_trim(struct nc_session *session);
+
+/**
+ * @brief Get the free space at the end of the session receive buffer for reading more data, the buffer is allocated
+ * if needed. Session IO lock is expected to be held.
+ *
+ * @param[in] session Session to use.
+ * @param[out] size Size of the free space.
+ * @return Free space to read into, the read data are then added by increasing rbuf_len, NULL on error.
+ */
+char *nc_session_rbuf_space(struct nc_session *session, size_t *size);
+
 /**
  * @brief Write message into wire.
  *
@@ -905,6 +2087,52 @@ int nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **ms
  */
 NC_MSG_TYPE nc_write_msg_io(struct nc_session *session, int io_timeout, int type, ...);
 
+/**
+ * @brief Write an already printed message into wire, framed according to the session version.
+ *
+ * @param[in] session NETCONF session to which the message will be written.
+ * @param[in] io_timeout Timeout in milliseconds. Negative value means infinite timeout,
+ *            zero value causes to return immediately.
+ * @param[in] type The type of the message, returned on success.
+ * @param[in] buf Whole message without any framing.
+ * @param[in] len Length of @p buf.
+ * @return @p type on success, #NC_MSG_WOULDBLOCK if IO lock could not be acquired in time, #NC_MSG_ERROR on error.
+ */
+NC_MSG_TYPE nc_write_msg_buf_io(struct nc_session *session, int io_timeout, NC_MSG_TYPE type, const char *buf,
+        size_t len);
+
+/**
+ * @brief Write an already printed RPC into wire, framed according to the session version.
+ *
+ * @param[in] session NETCONF client session to which the RPC will be written.
+ * @param[in] io_timeout Timeout in milliseconds. Negative value means infinite timeout,
+ *            zero value causes to return immediately.
+ * @param[in] buf Content of the \<rpc\> element.
+ * @param[in] len Length of @p buf.
+ * @return #NC_MSG_RPC on success, #NC_MSG_WOULDBLOCK if IO lock could not be acquired in time, #NC_MSG_ERROR on error.
+ */
+NC_MSG_TYPE nc_write_rpc_buf_io(struct nc_session *session, int io_timeout, const char *buf, size_t len);
+
+/**
+ * @brief Write data from the output queue of a session into the transport. IO lock must be held.
+ *
+ * @param[in] session Server session with the output queue.
+ * @param[in] block Whether to wait until all the data are written or to write only what the transport accepts.
+ * @return 0 on success, -1 on error (session status is changed).
+ */
+int nc_session_out_queue_flush(struct nc_session *session, int block);
+
+/**
+ * @brief Start or end collecting all the messages written into a server session so that they are
+ * written together once a batch of RPCs is processed. Acquires the IO lock.
+ *
+ * @param[in] session Server session, RPC lock is expected to be held.
+ * @param[in] start Whether to start collecting the messages or to write the collected ones.
+ * @return 0 on success, -1 on error (session status is changed when ending the batch, also if the IO lock
+ * could not be acquired).
+ */
+int nc_session_out_batch(struct nc_session *session, int start);
+
 /**
  * @brief Check whether a session is still connected (on transport layer).
  *
@@ -913,4 +2141,31 @@ NC_MSG_TYPE nc_write_msg_io(struct nc_session *session, int io_timeout, int type
  */
 int nc_session_is_connected(struct nc_session *session);
 
+/**
+ * @brief Create a new in-memory transport pipe to be shared by 2 sessions.
+ *
+ * Rings have NC_MEM_RING_SIZE bytes, the server-to-client one more if needed for @p hello_len.
+ *
+ * @param[in] hello_len Length of the server \<hello\> message that must fit into the server-to-client ring.
+ * @return Created pipe, NULL on error.
+ */
+struct nc_mem_pipe *nc_mem_pipe_new(size_t hello_len);
+
+/**
+ * @brief Stop using an in-memory transport pipe by a session, the peer learns it is closed.
+ *
+ * @param[in] pipe Pipe to release, freed by the last session using it.
+ */
+void nc_mem_pipe_release(struct nc_mem_pipe *pipe);
+
+/**
+ * @brief Check whether an in-memory transport session has any data to read. IO lock must be held.
+ *
+ * If not, the transport file descriptor is reset so that it can be waited on until there are some.
+ *
+ * @param[in] session In-memory transport session to check.
+ * @return 1 if there are data to read, 0 if not.
+ */
+int nc_mem_readable(struct nc_session *session);
+
 #endif /* NC_SESSION_PRIVATE_H_ */
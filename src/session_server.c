@@ -17,6 +17,7 @@
 
 #include <arpa/inet.h>
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
@@ -39,42 +40,185 @@
 #include "session_server.h"
 #include "session_server_ch.h"
 
+#ifdef HAVE_EPOLL
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+#endif
+
 struct nc_server_opts server_opts = {
 #ifdef NC_ENABLED_SSH
     .authkey_lock = PTHREAD_MUTEX_INITIALIZER,
 #endif
     .bind_lock = PTHREAD_MUTEX_INITIALIZER,
+    .config_lock = PTHREAD_MUTEX_INITIALIZER,
+    .cpblts_lock = PTHREAD_MUTEX_INITIALIZER,
+    .schema_cache.lock = PTHREAD_MUTEX_INITIALIZER,
+    .rpc_clb_lock = PTHREAD_MUTEX_INITIALIZER,
+    .rpc_latency.lock = PTHREAD_RWLOCK_INITIALIZER,
     .endpt_lock = PTHREAD_RWLOCK_INITIALIZER,
     .ch_client_lock = PTHREAD_RWLOCK_INITIALIZER
 };
 
 static nc_rpc_clb global_rpc_clb = NULL;
 
+#define NC_NAME_INDEX_ITEM_NAME(items, item_size, idx) (*(char **)((char *)(items) + (size_t)(idx) * (item_size)))
+
+static uint32_t
+nc_name_hash(const char *name)
+{
+    return nc_hash_fnv1a(NC_HASH_FNV1A_INIT, name, strlen(name));
+}
+
+static void
+nc_name_index_insert(struct nc_name_index *index, const void *items, size_t item_size, uint16_t idx)
+{
+    uint32_t slot;
+
+    slot = nc_name_hash(NC_NAME_INDEX_ITEM_NAME(items, item_size, idx)) & (index->size - 1);
+    while (index->slots[slot]) {
+        slot = (slot + 1) & (index->size - 1);
+    }
+    index->slots[slot] = idx + 1;
+}
+
+/**
+ * @brief Create a name index of all the items in an array from scratch.
+ *
+ * @param[in] index Index to rebuild.
+ * @param[in] items Array of items.
+ * @param[in] item_size Size of one item.
+ * @param[in] count Number of items.
+ * @return 0 on success, -1 on error (the index is empty and all the lookups fall back to a linear search).
+ */
+static int
+nc_name_index_rebuild(struct nc_name_index *index, const void *items, size_t item_size, uint16_t count)
+{
+    uint32_t size = NC_NAME_INDEX_MIN_SIZE;
+    uint16_t i;
+
+    /* keep the load factor at most 1/2 */
+    while (size < 2 * (uint32_t)count) {
+        size <<= 1;
+    }
+
+    if (size != index->size) {
+        free(index->slots);
+        index->slots = calloc(size, sizeof *index->slots);
+        if (!index->slots) {
+            ERRMEM;
+            index->size = 0;
+            return -1;
+        }
+        index->size = size;
+    } else {
+        memset(index->slots, 0, size * sizeof *index->slots);
+    }
+
+    for (i = 0; i < count; ++i) {
+        nc_name_index_insert(index, items, item_size, i);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Add the last item of an array into a name index.
+ *
+ * @param[in] index Index to modify.
+ * @param[in] items Array of items.
+ * @param[in] item_size Size of one item.
+ * @param[in] count Number of items including the new one.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_name_index_add(struct nc_name_index *index, const void *items, size_t item_size, uint16_t count)
+{
+    if (!index->slots || (2 * (uint32_t)count > index->size)) {
+        return nc_name_index_rebuild(index, items, item_size, count);
+    }
+
+    nc_name_index_insert(index, items, item_size, count - 1);
+    return 0;
+}
+
+/**
+ * @brief Find an item in an array using its name index.
+ *
+ * @param[in] index Index of @p items.
+ * @param[in] items Array of items.
+ * @param[in] item_size Size of one item.
+ * @param[in] count Number of items.
+ * @param[in] name Name of the item to find.
+ * @return Index of the found item, -1 if not found.
+ */
+static int
+nc_name_index_find(const struct nc_name_index *index, const void *items, size_t item_size, uint16_t count,
+        const char *name)
+{
+    uint32_t slot;
+    uint16_t i;
+
+    if (!index->slots) {
+        /* index could not be created */
+        for (i = 0; i < count; ++i) {
+            if (!strcmp(NC_NAME_INDEX_ITEM_NAME(items, item_size, i), name)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    slot = nc_name_hash(name) & (index->size - 1);
+    while (index->slots[slot]) {
+        i = index->slots[slot] - 1;
+        if (!strcmp(NC_NAME_INDEX_ITEM_NAME(items, item_size, i), name)) {
+            return i;
+        }
+        slot = (slot + 1) & (index->size - 1);
+    }
+
+    return -1;
+}
+
+static void
+nc_name_index_clear(struct nc_name_index *index)
+{
+    free(index->slots);
+    index->slots = NULL;
+    index->size = 0;
+}
+
+#define NC_ENDPT_FIND(cfg, name) nc_name_index_find(&(cfg)->endpt_index, (cfg)->endpts, sizeof *(cfg)->endpts, \
+        (cfg)->endpt_count, name)
+#define NC_CH_CLIENT_FIND(cfg, name) nc_name_index_find(&(cfg)->ch_client_index, (cfg)->ch_clients, \
+        sizeof *(cfg)->ch_clients, (cfg)->ch_client_count, name)
+
 struct nc_endpt *
 nc_server_endpt_lock_get(const char *name, NC_TRANSPORT_IMPL ti, uint16_t *idx)
 {
-    uint16_t i;
+    int i;
     struct nc_endpt *endpt = NULL;
+    struct nc_server_config *cfg;
 
     if (!name) {
         ERRARG("endpt_name");
         return NULL;
     }
 
-    /* WRITE LOCK */
-    pthread_rwlock_wrlock(&server_opts.endpt_lock);
+    if (!nc_server_config_batch_get(&cfg)) {
+        /* WRITE LOCK */
+        pthread_rwlock_wrlock(&server_opts.endpt_lock);
+    }
 
-    for (i = 0; i < server_opts.endpt_count; ++i) {
-        if (!strcmp(server_opts.endpts[i].name, name) && (!ti || (server_opts.endpts[i].ti == ti))) {
-            endpt = &server_opts.endpts[i];
-            break;
-        }
+    i = NC_ENDPT_FIND(cfg, name);
+    if ((i > -1) && (!ti || (cfg->endpts[i].ti == ti))) {
+        endpt = &cfg->endpts[i];
     }
 
     if (!endpt) {
         ERR(NULL, "Endpoint \"%s\" was not found.", name);
         /* UNLOCK */
-        pthread_rwlock_unlock(&server_opts.endpt_lock);
+        nc_server_endpt_unlock();
         return NULL;
     }
 
@@ -85,12 +229,41 @@ nc_server_endpt_lock_get(const char *name, NC_TRANSPORT_IMPL ti, uint16_t *idx)
     return endpt;
 }
 
+void
+nc_server_endpt_unlock(void)
+{
+    if (!nc_server_config_batch_owner()) {
+        /* UNLOCK */
+        pthread_rwlock_unlock(&server_opts.endpt_lock);
+    }
+}
+
+int
+nc_server_config_batch_get(struct nc_server_config **cfg)
+{
+    *cfg = pthread_getspecific(server_opts.config_key);
+    if (*cfg) {
+        return 1;
+    }
+
+    *cfg = &server_opts.config;
+    return 0;
+}
+
+int
+nc_server_config_batch_owner(void)
+{
+    return pthread_getspecific(server_opts.config_key) ? 1 : 0;
+}
+
 struct nc_ch_endpt *
 nc_server_ch_client_lock(const char *name, const char *endpt_name, NC_TRANSPORT_IMPL ti, struct nc_ch_client **client_p)
 {
-    uint16_t i, j;
+    uint16_t j;
+    int i, batch;
     struct nc_ch_client *client = NULL;
     struct nc_ch_endpt *endpt = NULL;
+    struct nc_server_config *cfg;
 
     *client_p = NULL;
 
@@ -99,16 +272,16 @@ nc_server_ch_client_lock(const char *name, const char *endpt_name, NC_TRANSPORT_
         return NULL;
     }
 
-    /* READ LOCK */
-    pthread_rwlock_rdlock(&server_opts.ch_client_lock);
+    batch = nc_server_config_batch_get(&cfg);
+    if (!batch) {
+        /* READ LOCK */
+        pthread_rwlock_rdlock(&server_opts.ch_client_lock);
+    }
 
-    for (i = 0; i < server_opts.ch_client_count; ++i) {
-        if (!strcmp(server_opts.ch_clients[i].name, name)) {
-            client = &server_opts.ch_clients[i];
-            if (!endpt_name && !ti) {
-                /* return only client */
-                break;
-            }
+    i = NC_CH_CLIENT_FIND(cfg, name);
+    if (i > -1) {
+        client = &cfg->ch_clients[i];
+        if (endpt_name || ti) {
             for (j = 0; j < client->ch_endpt_count; ++j) {
                 if ((!endpt_name || !strcmp(client->ch_endpts[j].name, endpt_name)) &&
                         (!ti || (ti == client->ch_endpts[j].ti))) {
@@ -116,20 +289,23 @@ nc_server_ch_client_lock(const char *name, const char *endpt_name, NC_TRANSPORT_
                     break;
                 }
             }
-            break;
         }
     }
 
     if (!client) {
         ERR(NULL, "Call Home client \"%s\" was not found.", name);
 
-        /* READ UNLOCK */
-        pthread_rwlock_unlock(&server_opts.ch_client_lock);
+        if (!batch) {
+            /* READ UNLOCK */
+            pthread_rwlock_unlock(&server_opts.ch_client_lock);
+        }
     } else if (endpt_name && ti && !endpt) {
         ERR(NULL, "Call Home client \"%s\" endpoint \"%s\" was not found.", name, endpt_name);
 
-        /* READ UNLOCK */
-        pthread_rwlock_unlock(&server_opts.ch_client_lock);
+        if (!batch) {
+            /* READ UNLOCK */
+            pthread_rwlock_unlock(&server_opts.ch_client_lock);
+        }
     } else {
         /* CH CLIENT LOCK */
         pthread_mutex_lock(&client->lock);
@@ -146,8 +322,10 @@ nc_server_ch_client_unlock(struct nc_ch_client *client)
     /* CH CLIENT UNLOCK */
     pthread_mutex_unlock(&client->lock);
 
-    /* READ UNLOCK */
-    pthread_rwlock_unlock(&server_opts.ch_client_lock);
+    if (!nc_server_config_batch_owner()) {
+        /* READ UNLOCK */
+        pthread_rwlock_unlock(&server_opts.ch_client_lock);
+    }
 }
 
 API void
@@ -196,7 +374,7 @@ nc_session_set_status(struct nc_session *session, NC_STATUS status)
 }
 
 int
-nc_sock_listen_inet(const char *address, uint16_t port, struct nc_keepalives *ka)
+nc_sock_listen_inet(const char *address, uint16_t port, struct nc_keepalives *ka, int reuseport)
 {
     int opt;
     int is_ipv4, sock;
@@ -227,6 +405,17 @@ nc_sock_listen_inet(const char *address, uint16_t port, struct nc_keepalives *ka
         ERR(NULL, "Could not set TCP_NODELAY socket option (%s).", strerror(errno));
         goto fail;
     }
+    if (reuseport) {
+#ifdef SO_REUSEPORT
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof opt) == -1) {
+            ERR(NULL, "Could not set SO_REUSEPORT socket option (%s).", strerror(errno));
+            goto fail;
+        }
+#else
+        ERRINT;
+        goto fail;
+#endif
+    }
 
     if (nc_sock_enable_keepalive(sock, ka)) {
         goto fail;
@@ -432,59 +621,109 @@ sock_host_inet6(const struct sockaddr_in6 *addr, char **host, uint16_t *port)
     return 0;
 }
 
+/**
+ * @brief Update a poll set of listening sockets if they changed.
+ *
+ * @param[in] pollset Poll set to update.
+ * @param[in] binds Structure with the listening sockets.
+ * @param[in] bind_count Number of @p binds.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_bind_pollset_update(struct nc_bind_pollset *pollset, struct nc_bind *binds, uint16_t bind_count)
+{
+    uint16_t i, j;
+
+    /* check whether the poll set still matches the valid sockets */
+    for (i = 0, j = 0; i < bind_count; ++i) {
+        if (binds[i].sock < 0) {
+            continue;
+        }
+        if ((j == pollset->count) || (pollset->pfds[j].fd != binds[i].sock)) {
+            break;
+        }
+        ++j;
+    }
+    if ((i == bind_count) && (j == pollset->count)) {
+        return 0;
+    }
+
+    /* rebuild it */
+    if (pollset->size < bind_count) {
+        pollset->pfds = nc_realloc(pollset->pfds, bind_count * sizeof *pollset->pfds);
+        if (!pollset->pfds) {
+            ERRMEM;
+            pollset->count = 0;
+            pollset->size = 0;
+            return -1;
+        }
+        pollset->size = bind_count;
+    }
+    for (i = 0, j = 0; i < bind_count; ++i) {
+        if (binds[i].sock < 0) {
+            /* invalid socket */
+            continue;
+        }
+        pollset->pfds[j].fd = binds[i].sock;
+        pollset->pfds[j].events = POLLIN;
+        ++j;
+    }
+    pollset->count = j;
+
+    return 0;
+}
+
 int
-nc_sock_accept_binds(struct nc_bind *binds, uint16_t bind_count, int timeout, char **host, uint16_t *port, uint16_t *idx)
+nc_sock_accept_binds(struct nc_bind *binds, uint16_t bind_count, struct nc_bind_pollset *pollset, int timeout,
+        char **host, uint16_t *port, uint16_t *idx)
 {
     sigset_t sigmask, origmask;
-    uint16_t i, j, pfd_count, client_port;
+    uint16_t i, j, client_port;
     char *client_address;
+    struct nc_bind_pollset tmp_pollset = {0};
     struct pollfd *pfd;
     struct sockaddr_storage saddr;
     socklen_t saddr_len = sizeof(saddr);
     int ret, client_sock, sock = -1, flags;
 
-    pfd = malloc(bind_count * sizeof *pfd);
-    if (!pfd) {
-        ERRMEM;
-        return -1;
-    }
-
-    for (i = 0, pfd_count = 0; i < bind_count; ++i) {
-        if (binds[i].sock < 0) {
-            /* invalid socket */
-            continue;
-        }
-        if (binds[i].pollin) {
+    for (i = 0; i < bind_count; ++i) {
+        if ((binds[i].sock > -1) && binds[i].pollin) {
             binds[i].pollin = 0;
             /* leftover pollin */
             sock = binds[i].sock;
             break;
         }
-        pfd[pfd_count].fd = binds[i].sock;
-        pfd[pfd_count].events = POLLIN;
-        pfd[pfd_count].revents = 0;
-
-        ++pfd_count;
     }
 
     if (sock == -1) {
+        if (!pollset) {
+            pollset = &tmp_pollset;
+        }
+        if (nc_bind_pollset_update(pollset, binds, bind_count)) {
+            return -1;
+        }
+        pfd = pollset->pfds;
+        for (j = 0; j < pollset->count; ++j) {
+            pfd[j].revents = 0;
+        }
+
         /* poll for a new connection */
         sigfillset(&sigmask);
         pthread_sigmask(SIG_SETMASK, &sigmask, &origmask);
-        ret = poll(pfd, pfd_count, timeout);
+        ret = poll(pfd, pollset->count, timeout);
         pthread_sigmask(SIG_SETMASK, &origmask, NULL);
 
         if (!ret) {
             /* we timeouted */
-            free(pfd);
+            free(tmp_pollset.pfds);
             return 0;
         } else if (ret == -1) {
             ERR(NULL, "Poll failed (%s).", strerror(errno));
-            free(pfd);
+            free(tmp_pollset.pfds);
             return -1;
         }
 
-        for (i = 0, j = 0; j < pfd_count; ++i, ++j) {
+        for (i = 0, j = 0; j < pollset->count; ++i, ++j) {
             /* adjust i so that indices in binds and pfd always match */
             while (binds[i].sock != pfd[j].fd) {
                 ++i;
@@ -503,8 +742,8 @@ nc_sock_accept_binds(struct nc_bind *binds, uint16_t bind_count, int timeout, ch
                 }
             }
         }
+        free(tmp_pollset.pfds);
     }
-    free(pfd);
 
     if (sock == -1) {
         ERRINT;
@@ -567,6 +806,157 @@ fail:
     return -1;
 }
 
+static uint32_t
+nc_server_schema_hash(const void *mod, LYS_OUTFORMAT format)
+{
+    uintptr_t key = (uintptr_t)mod;
+
+    /* pointers are aligned */
+    return (uint32_t)((key >> 4) ^ (key >> 20)) * 2654435761U + format;
+}
+
+/**
+ * @brief Free all the cached printed (sub)modules. Schema cache lock is expected to be held.
+ */
+static void
+nc_server_schema_cache_clear(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < server_opts.schema_cache.size; ++i) {
+        free(server_opts.schema_cache.schemas[i].data);
+    }
+    free(server_opts.schema_cache.schemas);
+    server_opts.schema_cache.schemas = NULL;
+    server_opts.schema_cache.size = 0;
+    server_opts.schema_cache.count = 0;
+    server_opts.schema_cache.mem = 0;
+    server_opts.schema_cache.ctx = NULL;
+}
+
+static struct nc_server_schema *
+nc_server_schema_cache_slot(const void *mod, LYS_OUTFORMAT format)
+{
+    uint32_t slot, mask = server_opts.schema_cache.size - 1;
+    struct nc_server_schema *schema;
+
+    slot = nc_server_schema_hash(mod, format) & mask;
+    for (schema = &server_opts.schema_cache.schemas[slot]; schema->mod; schema = &server_opts.schema_cache.schemas[slot]) {
+        if ((schema->mod == mod) && (schema->format == format)) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return schema;
+}
+
+/**
+ * @brief Get a cached printed (sub)module.
+ *
+ * @param[in] ctx Context of the (sub)module.
+ * @param[in] mod Module or submodule.
+ * @param[in] format Printed format.
+ * @return Printed (sub)module copy, NULL if not cached.
+ */
+static char *
+nc_server_schema_cache_get(const struct ly_ctx *ctx, const void *mod, LYS_OUTFORMAT format)
+{
+    struct nc_server_schema *schema;
+    char *data = NULL;
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.schema_cache.lock);
+
+    if ((server_opts.schema_cache.ctx != ctx) || (server_opts.schema_cache.change_count != ly_ctx_get_change_count(ctx))) {
+        /* the printed (sub)modules may no longer be valid */
+        nc_server_schema_cache_clear();
+        goto cleanup;
+    } else if (!server_opts.schema_cache.size) {
+        goto cleanup;
+    }
+
+    schema = nc_server_schema_cache_slot(mod, format);
+    if (schema->mod) {
+        data = strdup(schema->data);
+    }
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.schema_cache.lock);
+    return data;
+}
+
+/**
+ * @brief Store a printed (sub)module in the cache, if there is enough memory left for it.
+ *
+ * @param[in] ctx Context of the (sub)module.
+ * @param[in] mod Module or submodule.
+ * @param[in] format Printed format.
+ * @param[in] data Printed (sub)module, it is copied.
+ */
+static void
+nc_server_schema_cache_add(const struct ly_ctx *ctx, const void *mod, LYS_OUTFORMAT format, const char *data)
+{
+    struct nc_server_schema *schema, *old_schemas;
+    uint32_t i, old_size;
+    size_t len = strlen(data) + 1;
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.schema_cache.lock);
+
+    if ((server_opts.schema_cache.ctx != ctx) || (server_opts.schema_cache.change_count != ly_ctx_get_change_count(ctx))) {
+        /* start caching the (sub)modules of this context */
+        nc_server_schema_cache_clear();
+        server_opts.schema_cache.ctx = ctx;
+        server_opts.schema_cache.change_count = ly_ctx_get_change_count(ctx);
+    }
+    if (server_opts.schema_cache.mem + len > NC_SERVER_SCHEMA_CACHE_MAX_MEM) {
+        /* cache full */
+        goto cleanup;
+    }
+
+    if (2 * (server_opts.schema_cache.count + 1) > server_opts.schema_cache.size) {
+        /* keep the load factor at most 1/2 */
+        old_schemas = server_opts.schema_cache.schemas;
+        old_size = server_opts.schema_cache.size;
+
+        server_opts.schema_cache.size = old_size ? old_size * 2 : NC_NAME_INDEX_MIN_SIZE;
+        server_opts.schema_cache.schemas = calloc(server_opts.schema_cache.size, sizeof *server_opts.schema_cache.schemas);
+        if (!server_opts.schema_cache.schemas) {
+            ERRMEM;
+            server_opts.schema_cache.schemas = old_schemas;
+            server_opts.schema_cache.size = old_size;
+            goto cleanup;
+        }
+        for (i = 0; i < old_size; ++i) {
+            if (old_schemas[i].mod) {
+                *nc_server_schema_cache_slot(old_schemas[i].mod, old_schemas[i].format) = old_schemas[i];
+            }
+        }
+        free(old_schemas);
+    }
+
+    schema = nc_server_schema_cache_slot(mod, format);
+    if (schema->mod) {
+        /* printed by another thread meanwhile */
+        goto cleanup;
+    }
+    schema->data = strdup(data);
+    if (!schema->data) {
+        ERRMEM;
+        goto cleanup;
+    }
+    schema->mod = mod;
+    schema->format = format;
+    ++server_opts.schema_cache.count;
+    server_opts.schema_cache.mem += len;
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.schema_cache.lock);
+}
+
 API struct nc_server_reply *
 nc_clb_default_get_schema(struct lyd_node *rpc, struct nc_session *session)
 {
@@ -632,17 +1022,22 @@ nc_clb_default_get_schema(struct lyd_node *rpc, struct nc_session *session)
         return nc_server_reply_err(err);
     }
 
-    /* print */
-    ly_out_new_memory(&model_data, 0, &out);
-    if (module) {
-        lys_print_module(out, module, outformat, 0, 0);
-    } else {
-        lys_print_submodule(out, submodule, outformat, 0, 0);
-    }
-    ly_out_free(out, NULL, 0);
+    /* print, unless printed already */
+    model_data = nc_server_schema_cache_get(session->ctx, module ? (void *)module : (void *)submodule, outformat);
     if (!model_data) {
-        ERRINT;
-        return NULL;
+        ly_out_new_memory(&model_data, 0, &out);
+        if (module) {
+            lys_print_module(out, module, outformat, 0, 0);
+        } else {
+            lys_print_submodule(out, submodule, outformat, 0, 0);
+        }
+        ly_out_free(out, NULL, 0);
+        if (!model_data) {
+            ERRINT;
+            return NULL;
+        }
+
+        nc_server_schema_cache_add(session->ctx, module ? (void *)module : (void *)submodule, outformat, model_data);
     }
 
     /* create reply */
@@ -700,6 +1095,26 @@ nc_server_init_ctx(const struct ly_ctx *ctx)
     }
 }
 
+API void
+nc_server_ctx_release(const struct ly_ctx *ctx)
+{
+    if (!ctx) {
+        ERRARG("ctx");
+        return;
+    }
+
+    /* another context may later be created at the same address */
+    nc_server_cpblts_invalidate(ctx);
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.schema_cache.lock);
+    if (server_opts.schema_cache.ctx == ctx) {
+        nc_server_schema_cache_clear();
+    }
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.schema_cache.lock);
+}
+
 API int
 nc_server_init(void)
 {
@@ -710,6 +1125,7 @@ nc_server_init(void)
 
     server_opts.new_session_id = 1;
     server_opts.new_client_id = 1;
+    server_opts.start_time = time(NULL);
 
 #ifdef HAVE_PTHREAD_RWLOCKATTR_SETKIND_NP
     if ((r = pthread_rwlockattr_init(&attr))) {
@@ -731,6 +1147,10 @@ nc_server_init(void)
         ERR(NULL, "%s: failed to init rwlock(%s).", __func__, strerror(r));
         goto error;
     }
+    if ((r = pthread_key_create(&server_opts.config_key, NULL))) {
+        ERR(NULL, "%s: failed to create a thread key (%s).", __func__, strerror(r));
+        goto error;
+    }
 
     if (attr_p) {
         pthread_rwlockattr_destroy(attr_p);
@@ -744,10 +1164,148 @@ error:
     return -1;
 }
 
-API void
-nc_server_destroy(void)
-{
-    uint32_t i;
+/**
+ * @brief Free a list of RPC processing callbacks.
+ *
+ * @param[in] clb First callback to free.
+ */
+static void
+nc_server_rpc_clb_free(struct nc_server_rpc_clb *clb)
+{
+    struct nc_server_rpc_clb *next;
+
+    for (; clb; clb = next) {
+        next = clb->next;
+        if (clb->user_data && clb->free_user_data) {
+            clb->free_user_data(clb->user_data);
+        }
+        free(clb);
+    }
+}
+
+/**
+ * @brief Take the replaced RPC processing callbacks if no thread can be using them. Callback lock must be held.
+ *
+ * @return Replaced callbacks to free, NULL if none or they may still be used.
+ */
+static struct nc_server_rpc_clb *
+nc_server_rpc_clb_take_replaced(void)
+{
+    struct nc_server_rpc_clb *replaced;
+
+    /* pairs with the fences in nc_server_rpc_clb_get() and nc_server_rpc_clb_release() */
+    ATOMIC_FENCE();
+    if (ATOMIC_LOAD_RELAXED(server_opts.rpc_clb_users)) {
+        /* freed by the last thread using a callback */
+        return NULL;
+    }
+
+    replaced = ATOMIC_LOAD_RELAXED(server_opts.rpc_clb_replaced);
+    ATOMIC_STORE_RELAXED(server_opts.rpc_clb_replaced, NULL);
+    return replaced;
+}
+
+/**
+ * @brief Replace an RPC processing callback, the previous one is freed once no thread can be using it.
+ *
+ * @param[in] cur Current callback to replace.
+ * @param[in] clb New callback, NULL to unset it.
+ */
+static void
+nc_server_rpc_clb_set(ATOMIC_PTR_T(struct nc_server_rpc_clb *) *cur, const struct nc_server_rpc_clb *clb)
+{
+    struct nc_server_rpc_clb *new_clb = NULL, *old_clb, *replaced;
+
+    if (clb) {
+        new_clb = malloc(sizeof *new_clb);
+        if (!new_clb) {
+            ERRMEM;
+            return;
+        }
+        *new_clb = *clb;
+        new_clb->next = NULL;
+    }
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.rpc_clb_lock);
+
+    /* the previous callback may still be being called by other threads */
+    old_clb = ATOMIC_LOAD_RELAXED(*cur);
+    ATOMIC_STORE_RELEASE(*cur, new_clb);
+    if (old_clb) {
+        old_clb->next = ATOMIC_LOAD_RELAXED(server_opts.rpc_clb_replaced);
+        ATOMIC_STORE_RELAXED(server_opts.rpc_clb_replaced, old_clb);
+    }
+    replaced = nc_server_rpc_clb_take_replaced();
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.rpc_clb_lock);
+
+    nc_server_rpc_clb_free(replaced);
+}
+
+/**
+ * @brief Stop using an RPC processing callback returned by nc_server_rpc_clb_get().
+ */
+static void
+nc_server_rpc_clb_release(void)
+{
+    struct nc_server_rpc_clb *replaced;
+
+    /* the callback is not used after the thread stops being counted */
+    ATOMIC_FENCE();
+    if (ATOMIC_DEC_RELAXED(server_opts.rpc_clb_users) > 1) {
+        return;
+    }
+
+    /* either this thread sees a callback replaced meanwhile or the replacing thread sees no user */
+    ATOMIC_FENCE();
+    if (!ATOMIC_LOAD_RELAXED(server_opts.rpc_clb_replaced)) {
+        return;
+    }
+
+    /* last thread using a callback, free the callbacks replaced meanwhile */
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.rpc_clb_lock);
+    replaced = nc_server_rpc_clb_take_replaced();
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.rpc_clb_lock);
+
+    nc_server_rpc_clb_free(replaced);
+}
+
+/**
+ * @brief Get an RPC processing callback to call, it is not freed until nc_server_rpc_clb_release() is called.
+ *
+ * @param[in] cur Current callback.
+ * @return Callback to call, NULL if not set.
+ */
+static const struct nc_server_rpc_clb *
+nc_server_rpc_clb_get(ATOMIC_PTR_T(struct nc_server_rpc_clb *) *cur)
+{
+    const struct nc_server_rpc_clb *clb;
+
+    if (!ATOMIC_LOAD_RELAXED(*cur)) {
+        /* not set, nothing to keep */
+        return NULL;
+    }
+
+    ATOMIC_INC_RELAXED(server_opts.rpc_clb_users);
+    /* the loaded callback cannot be freed once the thread is counted */
+    ATOMIC_FENCE();
+    clb = ATOMIC_LOAD_ACQUIRE(*cur);
+    if (!clb) {
+        /* unset meanwhile */
+        nc_server_rpc_clb_release();
+    }
+
+    return clb;
+}
+
+API void
+nc_server_destroy(void)
+{
+    uint32_t i;
 
     for (i = 0; i < server_opts.capabilities_count; i++) {
         free(server_opts.capabilities[i]);
@@ -758,11 +1316,31 @@ nc_server_destroy(void)
     if (server_opts.content_id_data && server_opts.content_id_data_free) {
         server_opts.content_id_data_free(server_opts.content_id_data);
     }
+    nc_server_cpblts_invalidate(NULL);
+
+    /* LOCK */
+    pthread_mutex_lock(&server_opts.schema_cache.lock);
+    nc_server_schema_cache_clear();
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.schema_cache.lock);
+
+    nc_server_reset_rpc_latency();
+    nc_server_set_rpc_trace_clb(NULL, NULL, NULL);
+    nc_server_set_rpc_envelope_clb(NULL, NULL, NULL);
+    nc_server_rpc_clb_free(ATOMIC_LOAD_RELAXED(server_opts.rpc_clb_replaced));
+    ATOMIC_STORE_RELAXED(server_opts.rpc_clb_replaced, NULL);
+    server_opts.rpc_latency_enabled = 0;
 
 #if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+    nc_ch_sched_destroy();
     nc_server_del_endpt(NULL, 0);
     nc_server_ch_del_client(NULL);
 #endif
+    free(server_opts.bind_pollset.pfds);
+    server_opts.bind_pollset.pfds = NULL;
+    server_opts.bind_pollset.count = 0;
+    server_opts.bind_pollset.size = 0;
+    server_opts.reuseport = 0;
 #ifdef NC_ENABLED_SSH
     if (server_opts.passwd_auth_data && server_opts.passwd_auth_data_free) {
         server_opts.passwd_auth_data_free(server_opts.passwd_auth_data);
@@ -796,6 +1374,7 @@ nc_server_destroy(void)
     server_opts.trusted_cert_list_data = NULL;
     server_opts.trusted_cert_list_data_free = NULL;
 #endif
+    pthread_key_delete(server_opts.config_key);
     nc_destroy();
 }
 
@@ -812,6 +1391,7 @@ nc_server_set_capab_withdefaults(NC_WD_MODE basic_mode, int also_supported)
 
     server_opts.wd_basic_mode = basic_mode;
     server_opts.wd_also_supported = also_supported;
+    nc_server_cpblts_invalidate(NULL);
     return 0;
 }
 
@@ -850,6 +1430,7 @@ nc_server_set_capability(const char *value)
 
     server_opts.capabilities[server_opts.capabilities_count] = strdup(value);
     server_opts.capabilities_count++;
+    nc_server_cpblts_invalidate(NULL);
 
     return EXIT_SUCCESS;
 }
@@ -861,6 +1442,7 @@ nc_server_set_content_id_clb(char *(*content_id_clb)(void *user_data), void *use
     server_opts.content_id_clb = content_id_clb;
     server_opts.content_id_data = user_data;
     server_opts.content_id_data_free = free_user_data;
+    nc_server_cpblts_invalidate(NULL);
 }
 
 API void
@@ -887,2861 +1469,8041 @@ nc_server_get_idle_timeout(void)
     return server_opts.idle_timeout;
 }
 
-API NC_MSG_TYPE
-nc_accept_inout(int fdin, int fdout, const char *username, const struct ly_ctx *ctx, struct nc_session **session)
+API void
+nc_server_get_stats(struct nc_server_stats *stats)
 {
-    NC_MSG_TYPE msgtype;
-    struct timespec ts_cur;
-
-    if (!ctx) {
-        ERRARG("ctx");
-        return NC_MSG_ERROR;
-    } else if (fdin < 0) {
-        ERRARG("fdin");
-        return NC_MSG_ERROR;
-    } else if (fdout < 0) {
-        ERRARG("fdout");
-        return NC_MSG_ERROR;
-    } else if (!username) {
-        ERRARG("username");
-        return NC_MSG_ERROR;
-    } else if (!session) {
-        ERRARG("session");
-        return NC_MSG_ERROR;
+    if (!stats) {
+        ERRARG("stats");
+        return;
     }
 
-    /* init ctx as needed */
-    nc_server_init_ctx(ctx);
+    stats->start_time = server_opts.start_time;
+    stats->in_bad_hellos = ATOMIC_LOAD_RELAXED(server_opts.stats.in_bad_hellos);
+    stats->in_sessions = ATOMIC_LOAD_RELAXED(server_opts.stats.in_sessions);
+    stats->dropped_sessions = ATOMIC_LOAD_RELAXED(server_opts.stats.dropped_sessions);
+    stats->in_rpcs = ATOMIC_LOAD_RELAXED(server_opts.stats.in_rpcs);
+    stats->in_bad_rpcs = ATOMIC_LOAD_RELAXED(server_opts.stats.in_bad_rpcs);
+    stats->out_rpc_errors = ATOMIC_LOAD_RELAXED(server_opts.stats.out_rpc_errors);
+    stats->out_notifications = ATOMIC_LOAD_RELAXED(server_opts.stats.out_notifications);
+}
 
-    /* prepare session structure */
-    *session = nc_new_session(NC_SERVER, 0);
-    if (!(*session)) {
-        ERRMEM;
-        return NC_MSG_ERROR;
+/**
+ * @brief Get the latency histogram bucket of a latency.
+ *
+ * @param[in] usec Latency in usec.
+ * @return Bucket index.
+ */
+static uint32_t
+nc_latency_bucket(uint64_t usec)
+{
+    uint32_t exp, idx;
+
+    if (usec < NC_LATENCY_SUB_BUCKETS) {
+        /* exact values */
+        return usec;
     }
-    (*session)->status = NC_STATUS_STARTING;
 
-    /* transport specific data */
-    (*session)->ti_type = NC_TI_FD;
-    (*session)->ti.fd.in = fdin;
-    (*session)->ti.fd.out = fdout;
+    /* highest bit set */
+    for (exp = 3; (exp < 63) && (usec >> (exp + 1)); ++exp) {}
 
-    /* assign context */
-    (*session)->flags = NC_SESSION_SHAREDCTX;
-    (*session)->ctx = (struct ly_ctx *)ctx;
+    /* the power of 2 and the 3 following bits selecting the linear sub-bucket */
+    idx = (exp - 2) * NC_LATENCY_SUB_BUCKETS + ((usec >> (exp - 3)) & (NC_LATENCY_SUB_BUCKETS - 1));
+    if (idx >= NC_LATENCY_BUCKETS) {
+        idx = NC_LATENCY_BUCKETS - 1;
+    }
+    return idx;
+}
 
-    /* assign new SID atomically */
-    (*session)->id = ATOMIC_INC_RELAXED(server_opts.new_session_id);
+/**
+ * @brief Get the highest latency counted in a latency histogram bucket.
+ *
+ * @param[in] idx Bucket index.
+ * @return Latency in usec.
+ */
+static uint64_t
+nc_latency_bucket_max(uint32_t idx)
+{
+    uint32_t exp;
 
-    /* NETCONF handshake */
-    msgtype = nc_handshake_io(*session);
-    if (msgtype != NC_MSG_HELLO) {
-        nc_session_free(*session, NULL);
-        *session = NULL;
-        return msgtype;
+    if (idx < NC_LATENCY_SUB_BUCKETS) {
+        return idx;
     }
 
-    nc_gettimespec_mono_add(&ts_cur, 0);
-    (*session)->opts.server.last_rpc = ts_cur.tv_sec;
-    nc_gettimespec_real_add(&ts_cur, 0);
-    (*session)->opts.server.session_start = ts_cur.tv_sec;
+    exp = idx / NC_LATENCY_SUB_BUCKETS + 2;
+    return ((uint64_t)(NC_LATENCY_SUB_BUCKETS + idx % NC_LATENCY_SUB_BUCKETS + 1) << (exp - 3)) - 1;
+}
 
-    (*session)->status = NC_STATUS_RUNNING;
+static void
+nc_latency_acc_init(struct nc_latency_acc *acc)
+{
+    memset(acc, 0, sizeof *acc);
+    ATOMIC_STORE_RELAXED(acc->min, UINT64_MAX);
+}
 
-    return msgtype;
+static void
+nc_latency_acc_add(struct nc_latency_acc *acc, uint64_t usec)
+{
+    uint_fast64_t cur;
+
+    do {
+        cur = ATOMIC_LOAD_RELAXED(acc->min);
+    } while ((usec < cur) && !ATOMIC_CAS_RELAXED(acc->min, cur, usec));
+    do {
+        cur = ATOMIC_LOAD_RELAXED(acc->max);
+    } while ((usec > cur) && !ATOMIC_CAS_RELAXED(acc->max, cur, usec));
+    ATOMIC_INC_RELAXED(acc->count);
+    ATOMIC_ADD_RELAXED(acc->sum, usec);
+    ATOMIC_INC_RELAXED(acc->buckets[nc_latency_bucket(usec)]);
 }
 
 static void
-nc_ps_queue_add_id(struct nc_pollsession *ps, uint8_t *id)
+nc_latency_hist_merge(struct nc_latency_hist *hist, struct nc_latency_acc *src)
 {
-    uint8_t q_last;
+    uint64_t count, min, max;
+    uint32_t i;
 
-    if (ps->queue_len == NC_PS_QUEUE_SIZE) {
-        ERRINT;
+    count = ATOMIC_LOAD_RELAXED(src->count);
+    if (!count) {
         return;
     }
 
-    /* get a unique queue value (by adding 1 to the last added value, if any) */
-    if (ps->queue_len) {
-        q_last = (ps->queue_begin + ps->queue_len - 1) % NC_PS_QUEUE_SIZE;
-        *id = ps->queue[q_last] + 1;
-    } else {
-        *id = 0;
+    min = ATOMIC_LOAD_RELAXED(src->min);
+    max = ATOMIC_LOAD_RELAXED(src->max);
+    if (!hist->count || (min < hist->min)) {
+        hist->min = min;
+    }
+    if (max > hist->max) {
+        hist->max = max;
+    }
+    hist->count += count;
+    hist->sum += ATOMIC_LOAD_RELAXED(src->sum);
+    for (i = 0; i < NC_LATENCY_BUCKETS; ++i) {
+        hist->buckets[i] += ATOMIC_LOAD_RELAXED(src->buckets[i]);
     }
-
-    /* add the id into the queue */
-    ++ps->queue_len;
-    q_last = (ps->queue_begin + ps->queue_len - 1) % NC_PS_QUEUE_SIZE;
-    ps->queue[q_last] = *id;
 }
 
-static void
-nc_ps_queue_remove_id(struct nc_pollsession *ps, uint8_t id)
+/**
+ * @brief Get a percentile of a latency histogram.
+ *
+ * @param[in] hist Histogram to use.
+ * @param[in] permille Percentile in permille.
+ * @return Highest latency of the bucket with the percentile, in usec.
+ */
+static uint64_t
+nc_latency_hist_percentile(const struct nc_latency_hist *hist, uint32_t permille)
 {
-    uint8_t i, q_idx, found = 0;
+    uint64_t rank, cum = 0, usec;
+    uint32_t i;
 
-    for (i = 0; i < ps->queue_len; ++i) {
-        /* get the actual queue idx */
-        q_idx = (ps->queue_begin + i) % NC_PS_QUEUE_SIZE;
+    if (!hist->count) {
+        return 0;
+    }
 
-        if (found) {
-            if (ps->queue[q_idx] == id) {
-                /* another equal value, simply cannot be */
-                ERRINT;
-            }
-            if (found == 2) {
-                /* move the following values */
-                ps->queue[q_idx ? q_idx - 1 : NC_PS_QUEUE_SIZE - 1] = ps->queue[q_idx];
-            }
-        } else if (ps->queue[q_idx] == id) {
-            /* found our id, there can be no more equal valid values */
-            if (i == 0) {
-                found = 1;
-            } else {
-                /* this is not okay, our id is in the middle of the queue */
-                found = 2;
-            }
+    rank = (hist->count * permille + 999) / 1000;
+    for (i = 0; i < NC_LATENCY_BUCKETS - 1; ++i) {
+        cum += hist->buckets[i];
+        if (cum >= rank) {
+            break;
         }
     }
-    if (!found) {
-        ERRINT;
-        return;
-    }
 
-    --ps->queue_len;
-    if (found == 1) {
-        /* remove the id by moving the queue, otherwise all the values in the queue were moved */
-        ps->queue_begin = (ps->queue_begin + 1) % NC_PS_QUEUE_SIZE;
-    }
+    usec = nc_latency_bucket_max(i);
+    return (usec > hist->max) ? hist->max : usec;
 }
 
-int
-nc_ps_lock(struct nc_pollsession *ps, uint8_t *id, const char *func)
+/**
+ * @brief Add the stage latencies of a processed RPC into its histograms.
+ *
+ * @param[in] rpc_act RPC or action schema node.
+ * @param[in] trace Measured stage latencies.
+ */
+static void
+nc_server_rpc_latency_add(const struct lysc_node *rpc_act, const struct nc_rpc_trace *trace)
 {
-    int ret;
-    struct timespec ts;
+    struct nc_server_rpc_latency *lat = &server_opts.rpc_latency;
+    struct nc_rpc_latency_entry *entry;
+    char name[256];
+    int idx, i;
 
-    nc_gettimespec_real_add(&ts, NC_PS_LOCK_TIMEOUT);
+    snprintf(name, sizeof name, "%s:%s", rpc_act->module->name, rpc_act->name);
 
-    /* LOCK */
-    ret = pthread_mutex_timedlock(&ps->lock, &ts);
-    if (ret) {
-        ERR(NULL, "%s: failed to lock a pollsession (%s).", func, strerror(ret));
-        return -1;
-    }
+    /* READ LOCK, the histograms are updated atomically so the poll threads do not wait for each other */
+    pthread_rwlock_rdlock(&lat->lock);
 
-    /* check that the queue is long enough */
-    if (ps->queue_len == NC_PS_QUEUE_SIZE) {
-        ERR(NULL, "%s: pollsession queue size (%d) too small.", func, NC_PS_QUEUE_SIZE);
-        pthread_mutex_unlock(&ps->lock);
-        return -1;
+    idx = nc_name_index_find(&lat->index, lat->rpcs, sizeof *lat->rpcs, lat->count, name);
+    if (idx == -1) {
+        /* UNLOCK */
+        pthread_rwlock_unlock(&lat->lock);
+
+        /* WRITE LOCK */
+        pthread_rwlock_wrlock(&lat->lock);
+
+        /* the RPC may have been added meanwhile */
+        idx = nc_name_index_find(&lat->index, lat->rpcs, sizeof *lat->rpcs, lat->count, name);
     }
+    if (idx == -1) {
+        if (lat->count == UINT16_MAX) {
+            goto cleanup;
+        }
 
-    /* add ourselves into the queue */
-    nc_ps_queue_add_id(ps, id);
-    DBL(NULL, "PS 0x%p TID %lu queue: added %u, head %u, length %u", ps, (long unsigned int)pthread_self(), *id,
-            ps->queue[ps->queue_begin], ps->queue_len);
+        /* new RPC */
+        entry = realloc(lat->rpcs, (lat->count + 1) * sizeof *lat->rpcs);
+        if (!entry) {
+            ERRMEM;
+            goto cleanup;
+        }
+        lat->rpcs = entry;
+        entry = &lat->rpcs[lat->count];
+        for (i = 0; i < NC_RPC_STAGE_COUNT; ++i) {
+            nc_latency_acc_init(&entry->stages[i]);
+        }
+        entry->name = strdup(name);
+        if (!entry->name) {
+            ERRMEM;
+            goto cleanup;
+        }
 
-    /* is it our turn? */
-    while (ps->queue[ps->queue_begin] != *id) {
-        nc_gettimespec_real_add(&ts, NC_PS_QUEUE_TIMEOUT);
+        idx = lat->count++;
+        nc_name_index_add(&lat->index, lat->rpcs, sizeof *lat->rpcs, lat->count);
+    }
 
-        ret = pthread_cond_timedwait(&ps->cond, &ps->lock, &ts);
-        if (ret) {
-            /**
-             * This may happen when another thread releases the lock and broadcasts the condition
-             * and this thread had already timed out. When this thread is scheduled, it returns timed out error
-             * but when actually this thread was ready for condition.
-             */
-            if ((ETIMEDOUT == ret) && (ps->queue[ps->queue_begin] == *id)) {
-                break;
-            }
-
-            ERR(NULL, "%s: failed to wait for a pollsession condition (%s).", func, strerror(ret));
-            /* remove ourselves from the queue */
-            nc_ps_queue_remove_id(ps, *id);
-            pthread_mutex_unlock(&ps->lock);
-            return -1;
-        }
-    }
+    entry = &lat->rpcs[idx];
+    for (i = 0; i < NC_RPC_STAGE_COUNT; ++i) {
+        nc_latency_acc_add(&entry->stages[i], trace->stage_usec[i]);
+    }
 
+cleanup:
     /* UNLOCK */
-    pthread_mutex_unlock(&ps->lock);
-
-    return 0;
+    pthread_rwlock_unlock(&lat->lock);
 }
 
-int
-nc_ps_unlock(struct nc_pollsession *ps, uint8_t id, const char *func)
+/**
+ * @brief Clear all the RPC latency histograms.
+ *
+ * Must be called holding the RPC latency write lock.
+ */
+static void
+nc_server_rpc_latency_clear(void)
 {
-    int ret;
-    struct timespec ts;
-
-    nc_gettimespec_real_add(&ts, NC_PS_LOCK_TIMEOUT);
-
-    /* LOCK */
-    ret = pthread_mutex_timedlock(&ps->lock, &ts);
-    if (ret) {
-        ERR(NULL, "%s: failed to lock a pollsession (%s).", func, strerror(ret));
-        ret = -1;
-    }
+    struct nc_server_rpc_latency *lat = &server_opts.rpc_latency;
+    uint16_t i;
 
-    /* we must be the first, it was our turn after all, right? */
-    if (ps->queue[ps->queue_begin] != id) {
-        ERRINT;
-        /* UNLOCK */
-        if (!ret) {
-            pthread_mutex_unlock(&ps->lock);
-        }
-        return -1;
+    for (i = 0; i < lat->count; ++i) {
+        free(lat->rpcs[i].name);
     }
+    free(lat->rpcs);
+    lat->rpcs = NULL;
+    lat->count = 0;
+    nc_name_index_clear(&lat->index);
+}
 
-    /* remove ourselves from the queue */
-    nc_ps_queue_remove_id(ps, id);
-    DBL(NULL, "PS 0x%p TID %lu queue: removed %u, head %u, length %u", ps, (long unsigned int)pthread_self(), id,
-            ps->queue[ps->queue_begin], ps->queue_len);
-
-    /* broadcast to all other threads that the queue moved */
-    pthread_cond_broadcast(&ps->cond);
+/**
+ * @brief Begin an RPC processing stage.
+ *
+ * @param[in] session Session processing the RPC, if known.
+ * @param[in] rpc Parsed RPC, if available.
+ * @param[in] stage Stage to begin.
+ * @return Monotonic time in usec the stage began, 0 if the latencies are not measured.
+ */
+static uint64_t
+nc_rpc_stage_begin(const struct nc_session *session, const struct lyd_node *rpc, NC_RPC_STAGE stage)
+{
+    const struct nc_server_rpc_clb *trace = nc_server_rpc_clb_get(&server_opts.rpc_trace);
 
-    /* UNLOCK */
-    if (!ret) {
-        pthread_mutex_unlock(&ps->lock);
+    if (trace) {
+        trace->clb.trace(session, rpc, stage, 0, trace->user_data);
+        nc_server_rpc_clb_release();
     }
 
-    return ret;
+    return server_opts.rpc_latency_enabled ? nc_time_mono_usec() : 0;
 }
 
-API struct nc_pollsession *
-nc_ps_new(void)
+/**
+ * @brief End an RPC processing stage.
+ *
+ * @param[in] session Session processing the RPC, if known.
+ * @param[in] rpc Parsed RPC, if available.
+ * @param[in] stage Stage to end.
+ * @param[in] start Time returned by nc_rpc_stage_begin().
+ * @return Stage latency in usec, 0 if not measured.
+ */
+static uint64_t
+nc_rpc_stage_end(const struct nc_session *session, const struct lyd_node *rpc, NC_RPC_STAGE stage, uint64_t start)
 {
-    struct nc_pollsession *ps;
+    const struct nc_server_rpc_clb *trace = nc_server_rpc_clb_get(&server_opts.rpc_trace);
 
-    ps = calloc(1, sizeof(struct nc_pollsession));
-    if (!ps) {
-        ERRMEM;
-        return NULL;
+    if (trace) {
+        trace->clb.trace(session, rpc, stage, 1, trace->user_data);
+        nc_server_rpc_clb_release();
     }
-    pthread_cond_init(&ps->cond, NULL);
-    pthread_mutex_init(&ps->lock, NULL);
 
-    return ps;
+    return start ? nc_time_mono_usec() - start : 0;
 }
 
 API void
-nc_ps_free(struct nc_pollsession *ps)
+nc_server_set_rpc_latency(int enable)
 {
-    uint16_t i;
-
-    if (!ps) {
-        return;
-    }
-
-    if (ps->queue_len) {
-        ERR(NULL, "FATAL: Freeing a pollsession structure that is currently being worked with!");
-    }
-
-    for (i = 0; i < ps->session_count; i++) {
-        free(ps->sessions[i]);
-    }
-
-    free(ps->sessions);
-    pthread_mutex_destroy(&ps->lock);
-    pthread_cond_destroy(&ps->cond);
-
-    free(ps);
+    server_opts.rpc_latency_enabled = enable ? 1 : 0;
 }
 
 API int
-nc_ps_add_session(struct nc_pollsession *ps, struct nc_session *session)
+nc_server_get_rpc_latency(const char *rpc_name, NC_RPC_STAGE stage, struct nc_rpc_latency *latency)
 {
-    uint8_t q_id;
+    struct nc_server_rpc_latency *lat = &server_opts.rpc_latency;
+    struct nc_latency_hist hist;
+    int idx;
+    uint16_t i;
 
-    if (!ps) {
-        ERRARG("ps");
+    if ((unsigned)stage >= NC_RPC_STAGE_COUNT) {
+        ERRARG("stage");
         return -1;
-    } else if (!session) {
-        ERRARG("session");
+    } else if (!latency) {
+        ERRARG("latency");
         return -1;
     }
 
-    /* LOCK */
-    if (nc_ps_lock(ps, &q_id, __func__)) {
-        return -1;
-    }
+    memset(&hist, 0, sizeof hist);
 
-    ++ps->session_count;
-    ps->sessions = nc_realloc(ps->sessions, ps->session_count * sizeof *ps->sessions);
-    if (!ps->sessions) {
-        ERRMEM;
-        /* UNLOCK */
-        nc_ps_unlock(ps, q_id, __func__);
-        return -1;
-    }
-    ps->sessions[ps->session_count - 1] = calloc(1, sizeof **ps->sessions);
-    if (!ps->sessions[ps->session_count - 1]) {
-        ERRMEM;
-        --ps->session_count;
-        /* UNLOCK */
-        nc_ps_unlock(ps, q_id, __func__);
-        return -1;
+    /* READ LOCK */
+    pthread_rwlock_rdlock(&lat->lock);
+
+    if (rpc_name) {
+        idx = nc_name_index_find(&lat->index, lat->rpcs, sizeof *lat->rpcs, lat->count, rpc_name);
+        if (idx > -1) {
+            nc_latency_hist_merge(&hist, &lat->rpcs[idx].stages[stage]);
+        }
+    } else {
+        for (i = 0; i < lat->count; ++i) {
+            nc_latency_hist_merge(&hist, &lat->rpcs[i].stages[stage]);
+        }
     }
-    ps->sessions[ps->session_count - 1]->session = session;
-    ps->sessions[ps->session_count - 1]->state = NC_PS_STATE_NONE;
 
     /* UNLOCK */
-    return nc_ps_unlock(ps, q_id, __func__);
+    pthread_rwlock_unlock(&lat->lock);
+
+    latency->count = hist.count;
+    latency->sum = hist.sum;
+    latency->min = hist.min;
+    latency->max = hist.max;
+    latency->p50 = nc_latency_hist_percentile(&hist, 500);
+    latency->p90 = nc_latency_hist_percentile(&hist, 900);
+    latency->p99 = nc_latency_hist_percentile(&hist, 990);
+    latency->p999 = nc_latency_hist_percentile(&hist, 999);
+    return 0;
 }
 
-static int
-_nc_ps_del_session(struct nc_pollsession *ps, struct nc_session *session, int index)
+API int
+nc_server_get_rpc_latency_names(char ***names)
 {
+    struct nc_server_rpc_latency *lat = &server_opts.rpc_latency;
+    int ret = 0;
     uint16_t i;
 
-    if (index >= 0) {
-        i = (uint16_t)index;
-        goto remove;
+    if (!names) {
+        ERRARG("names");
+        return -1;
     }
-    for (i = 0; i < ps->session_count; ++i) {
-        if (ps->sessions[i]->session == session) {
-remove:
-            --ps->session_count;
-            if (i <= ps->session_count) {
-                free(ps->sessions[i]);
-                ps->sessions[i] = ps->sessions[ps->session_count];
-            }
-            if (!ps->session_count) {
-                free(ps->sessions);
-                ps->sessions = NULL;
+
+    /* READ LOCK */
+    pthread_rwlock_rdlock(&lat->lock);
+
+    *names = calloc(lat->count + 1, sizeof **names);
+    if (!*names) {
+        ERRMEM;
+        ret = -1;
+        goto cleanup;
+    }
+    for (i = 0; i < lat->count; ++i) {
+        (*names)[i] = strdup(lat->rpcs[i].name);
+        if (!(*names)[i]) {
+            ERRMEM;
+            for ( ; i; --i) {
+                free((*names)[i - 1]);
             }
-            ps->last_event_session = 0;
-            return 0;
+            free(*names);
+            *names = NULL;
+            ret = -1;
+            goto cleanup;
         }
     }
 
-    return -1;
+cleanup:
+    /* UNLOCK */
+    pthread_rwlock_unlock(&lat->lock);
+    return ret;
 }
 
-API int
-nc_ps_del_session(struct nc_pollsession *ps, struct nc_session *session)
+API void
+nc_server_reset_rpc_latency(void)
 {
-    uint8_t q_id;
-    int ret, ret2;
-
-    if (!ps) {
-        ERRARG("ps");
-        return -1;
-    } else if (!session) {
-        ERRARG("session");
-        return -1;
-    }
-
-    /* LOCK */
-    if (nc_ps_lock(ps, &q_id, __func__)) {
-        return -1;
-    }
+    /* WRITE LOCK */
+    pthread_rwlock_wrlock(&server_opts.rpc_latency.lock);
 
-    ret = _nc_ps_del_session(ps, session, -1);
+    nc_server_rpc_latency_clear();
 
     /* UNLOCK */
-    ret2 = nc_ps_unlock(ps, q_id, __func__);
+    pthread_rwlock_unlock(&server_opts.rpc_latency.lock);
+}
 
-    return ret || ret2 ? -1 : 0;
+API void
+nc_server_set_rpc_trace_clb(nc_rpc_trace_clb trace_clb, void *user_data, void (*free_user_data)(void *user_data))
+{
+    struct nc_server_rpc_clb clb = {0};
+
+    clb.clb.trace = trace_clb;
+    clb.user_data = user_data;
+    clb.free_user_data = free_user_data;
+    nc_server_rpc_clb_set(&server_opts.rpc_trace, trace_clb ? &clb : NULL);
 }
 
-API struct nc_session *
-nc_ps_get_session(const struct nc_pollsession *ps, uint16_t idx)
+API void
+nc_server_set_rpc_envelope_clb(nc_rpc_envelope_clb envelope_clb, void *user_data, void (*free_user_data)(void *user_data))
 {
-    uint8_t q_id;
-    struct nc_session *ret = NULL;
+    struct nc_server_rpc_clb clb = {0};
 
-    if (!ps) {
-        ERRARG("ps");
-        return NULL;
-    }
+    clb.clb.envelope = envelope_clb;
+    clb.user_data = user_data;
+    clb.free_user_data = free_user_data;
+    nc_server_rpc_clb_set(&server_opts.rpc_envelope, envelope_clb ? &clb : NULL);
+}
 
-    /* LOCK */
-    if (nc_ps_lock((struct nc_pollsession *)ps, &q_id, __func__)) {
-        return NULL;
-    }
+API void
+nc_server_set_out_queue_size(uint32_t size)
+{
+    server_opts.out_queue_size = size;
+}
 
-    if (idx < ps->session_count) {
-        ret = ps->sessions[idx]->session;
-    }
+API uint32_t
+nc_server_get_out_queue_size(void)
+{
+    return server_opts.out_queue_size;
+}
 
-    /* UNLOCK */
-    nc_ps_unlock((struct nc_pollsession *)ps, q_id, __func__);
+API void
+nc_server_set_rpc_batch(uint16_t count)
+{
+    server_opts.rpc_batch = count;
+}
 
-    return ret;
+API uint16_t
+nc_server_get_rpc_batch(void)
+{
+    return server_opts.rpc_batch;
 }
 
-API struct nc_session *
-nc_ps_find_session(const struct nc_pollsession *ps, nc_ps_session_match_cb match_cb, void *cb_data)
+API int
+nc_server_set_reuseport(int enable)
 {
-    uint8_t q_id;
+#ifdef SO_REUSEPORT
     uint16_t i;
-    struct nc_session *ret = NULL;
+    int ret = 0;
 
-    if (!ps) {
-        ERRARG("ps");
-        return NULL;
-    }
+    enable = enable ? 1 : 0;
 
-    /* LOCK */
-    if (nc_ps_lock((struct nc_pollsession *)ps, &q_id, __func__)) {
-        return NULL;
-    }
+    /* BIND LOCK */
+    pthread_mutex_lock(&server_opts.bind_lock);
 
-    for (i = 0; i < ps->session_count; ++i) {
-        if (match_cb(ps->sessions[i]->session, cb_data)) {
-            ret = ps->sessions[i]->session;
-            break;
+    /* ENDPT READ LOCK */
+    pthread_rwlock_rdlock(&server_opts.endpt_lock);
+
+    if (enable != server_opts.reuseport) {
+        /* the existing sockets would not match the setting */
+        for (i = 0; i < server_opts.config.endpt_count; ++i) {
+            if ((server_opts.config.endpts[i].ti != NC_TI_UNIX) && (server_opts.config.binds[i].sock > -1)) {
+                ERR(NULL, "Endpoint \"%s\" is already listening, SO_REUSEPORT must be set before.",
+                        server_opts.config.endpts[i].name);
+                ret = -1;
+                break;
+            }
         }
     }
+    if (!ret) {
+        server_opts.reuseport = enable;
+    }
 
-    /* UNLOCK */
-    nc_ps_unlock((struct nc_pollsession *)ps, q_id, __func__);
+    /* ENDPT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    /* BIND UNLOCK */
+    pthread_mutex_unlock(&server_opts.bind_lock);
 
     return ret;
+#else
+    (void)enable;
+
+    ERR(NULL, "SO_REUSEPORT socket option is not supported.");
+    return -1;
+#endif
 }
 
-API uint16_t
-nc_ps_session_count(struct nc_pollsession *ps)
+API NC_MSG_TYPE
+nc_accept_inout(int fdin, int fdout, const char *username, const struct ly_ctx *ctx, struct nc_session **session)
 {
-    uint8_t q_id;
-    uint16_t session_count;
+    NC_MSG_TYPE msgtype;
+    struct timespec ts_cur;
 
-    if (!ps) {
-        ERRARG("ps");
-        return 0;
-    }
-
-    /* LOCK (just for memory barrier so that we read the current value) */
-    if (nc_ps_lock((struct nc_pollsession *)ps, &q_id, __func__)) {
-        return 0;
+    if (!ctx) {
+        ERRARG("ctx");
+        return NC_MSG_ERROR;
+    } else if (fdin < 0) {
+        ERRARG("fdin");
+        return NC_MSG_ERROR;
+    } else if (fdout < 0) {
+        ERRARG("fdout");
+        return NC_MSG_ERROR;
+    } else if (!username) {
+        ERRARG("username");
+        return NC_MSG_ERROR;
+    } else if (!session) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
     }
 
-    session_count = ps->session_count;
+    /* init ctx as needed */
+    nc_server_init_ctx(ctx);
 
-    /* UNLOCK */
-    nc_ps_unlock((struct nc_pollsession *)ps, q_id, __func__);
+    /* prepare session structure */
+    *session = nc_new_session(NC_SERVER);
+    if (!(*session)) {
+        ERRMEM;
+        return NC_MSG_ERROR;
+    }
+    (*session)->status = NC_STATUS_STARTING;
 
-    return session_count;
-}
+    /* transport specific data */
+    (*session)->ti_type = NC_TI_FD;
+    (*session)->ti.fd.in = fdin;
+    (*session)->ti.fd.out = fdout;
 
-static NC_MSG_TYPE
-recv_rpc_check_msgid(struct nc_session *session, const struct lyd_node *envp)
-{
-    struct lyd_attr *attr;
+    /* assign context */
+    (*session)->flags = NC_SESSION_SHAREDCTX;
+    (*session)->ctx = (struct ly_ctx *)ctx;
 
-    assert(envp && !envp->schema);
+    /* assign new SID atomically */
+    (*session)->id = ATOMIC_INC_RELAXED(server_opts.new_session_id);
 
-    /* find the message-id attribute */
-    LY_LIST_FOR(((struct lyd_node_opaq *)envp)->attr, attr) {
-        if (!strcmp(attr->name.name, "message-id")) {
-            break;
-        }
+    /* NETCONF handshake */
+    msgtype = nc_handshake_io(*session);
+    if (msgtype != NC_MSG_HELLO) {
+        nc_session_free(*session, NULL);
+        *session = NULL;
+        return msgtype;
     }
 
-    if (!attr) {
-        ERR(session, "Received an <rpc> without a message-id.");
-        return NC_MSG_REPLY_ERR_MSGID;
-    }
+    nc_gettimespec_mono_add(&ts_cur, 0);
+    (*session)->opts.server.last_rpc = ts_cur.tv_sec;
+    nc_gettimespec_real_add(&ts_cur, 0);
+    (*session)->opts.server.session_start = ts_cur.tv_sec;
 
-    return NC_MSG_RPC;
+    (*session)->status = NC_STATUS_RUNNING;
+
+    return msgtype;
 }
 
-/* should be called holding the session RPC lock! IO lock will be acquired as needed
- * returns: NC_PSPOLL_ERROR,
- *          NC_PSPOLL_TIMEOUT,
- *          NC_PSPOLL_BAD_RPC,
- *          NC_PSPOLL_RPC
- */
-static int
-nc_server_recv_rpc_io(struct nc_session *session, int io_timeout, struct nc_server_rpc **rpc)
+API NC_MSG_TYPE
+nc_accept_mem(const char *username, const struct ly_ctx *ctx, struct nc_session **server, struct nc_session **client)
 {
-    struct ly_in *msg;
-    struct nc_server_reply *reply = NULL;
-    struct lyd_node *e;
-    int r, ret;
+    NC_MSG_TYPE msgtype = NC_MSG_ERROR;
+    struct nc_mem_pipe *mp;
+    size_t hello_len;
+    struct timespec ts_cur;
 
-    if (!session) {
-        ERRARG("session");
-        return NC_PSPOLL_ERROR;
-    } else if (!rpc) {
-        ERRARG("rpc");
-        return NC_PSPOLL_ERROR;
-    } else if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_SERVER)) {
-        ERR(session, "Invalid session to receive RPCs.");
-        return NC_PSPOLL_ERROR;
+    if (!username) {
+        ERRARG("username");
+        return NC_MSG_ERROR;
+    } else if (!ctx) {
+        ERRARG("ctx");
+        return NC_MSG_ERROR;
+    } else if (!server) {
+        ERRARG("server");
+        return NC_MSG_ERROR;
+    } else if (!client) {
+        ERRARG("client");
+        return NC_MSG_ERROR;
     }
 
-    *rpc = NULL;
+    /* init ctx as needed */
+    nc_server_init_ctx(ctx);
 
-    /* get a message */
-    r = nc_read_msg_io(session, io_timeout, &msg, 0);
-    if (r == -2) {
-        /* malformed message */
-        ret = NC_PSPOLL_BAD_RPC;
-        reply = nc_server_reply_err(nc_err(session->ctx, NC_ERR_MALFORMED_MSG));
+    /* prepare session structures */
+    *server = nc_new_session(NC_SERVER);
+    *client = nc_new_session(NC_CLIENT);
+    if (!*server || !*client) {
+        ERRMEM;
         goto cleanup;
     }
-    if (r == -1) {
-        return NC_PSPOLL_ERROR;
-    } else if (!r) {
-        return NC_PSPOLL_TIMEOUT;
+    (*server)->status = NC_STATUS_STARTING;
+    (*client)->status = NC_STATUS_STARTING;
+
+    /* transport specific data, the pipe is referenced by both of the sessions */
+    /* assign new SID atomically */
+    (*server)->id = ATOMIC_INC_RELAXED(server_opts.new_session_id);
+
+    hello_len = nc_server_hello_len(ctx, (*server)->id);
+    if (!hello_len) {
+        goto cleanup;
     }
+    mp = nc_mem_pipe_new(hello_len);
+    if (!mp) {
+        goto cleanup;
+    }
+    (*server)->ti_type = NC_TI_MEM;
+    (*server)->ti.mem.pipe = mp;
+    (*client)->ti_type = NC_TI_MEM;
+    (*client)->ti.mem.pipe = mp;
 
-    *rpc = calloc(1, sizeof **rpc);
-    if (!*rpc) {
+    (*server)->username = strdup(username);
+    if (!(*server)->username) {
         ERRMEM;
-        ret = NC_PSPOLL_BAD_RPC;
         goto cleanup;
     }
 
-    /* parse the RPC */
-    if (!lyd_parse_op(session->ctx, NULL, msg, LYD_XML, LYD_TYPE_RPC_NETCONF, &(*rpc)->envp, &(*rpc)->rpc)) {
-        /* check message-id */
-        if (recv_rpc_check_msgid(session, (*rpc)->envp) == NC_MSG_RPC) {
-            /* valid RPC */
-            ret = NC_PSPOLL_RPC;
-        } else {
-            /* no message-id */
-            ret = NC_PSPOLL_BAD_RPC;
-            reply = nc_server_reply_err(nc_err(session->ctx, NC_ERR_MISSING_ATTR, NC_ERR_TYPE_RPC, "message-id", "rpc"));
-        }
-    } else {
-        /* bad RPC received */
-        ret = NC_PSPOLL_BAD_RPC;
+    /* assign context */
+    (*server)->flags = NC_SESSION_SHAREDCTX;
+    (*server)->ctx = (struct ly_ctx *)ctx;
+    (*client)->flags = NC_SESSION_SHAREDCTX;
+    (*client)->ctx = (struct ly_ctx *)ctx;
 
-        if ((*rpc)->envp) {
-            /* at least the envelopes were parsed */
-            e = nc_err(session->ctx, NC_ERR_OP_FAILED, NC_ERR_TYPE_APP);
-            nc_err_set_msg(e, ly_errmsg(session->ctx), "en");
-            reply = nc_server_reply_err(e);
-        } else if (session->version == NC_VERSION_11) {
-            /* completely malformed message, NETCONF version 1.1 defines sending error reply from
-             * the server (RFC 6241 sec. 3) */
-            reply = nc_server_reply_err(nc_err(session->ctx, NC_ERR_MALFORMED_MSG));
-        }
+    /* NETCONF handshake */
+    msgtype = nc_handshake_mem_io(*server, *client);
+    if (msgtype != NC_MSG_HELLO) {
+        goto cleanup;
     }
 
-cleanup:
-    if (reply) {
-        /* send error reply */
-        r = nc_write_msg_io(session, io_timeout, NC_MSG_REPLY, *rpc ? (*rpc)->envp : NULL, reply);
-        nc_server_reply_free(reply);
-        if (r != NC_MSG_REPLY) {
-            ERR(session, "Failed to write reply (%s), terminating session.", nc_msgtype2str[r]);
-            if (session->status != NC_STATUS_INVALID) {
-                session->status = NC_STATUS_INVALID;
-                session->term_reason = NC_SESSION_TERM_OTHER;
-            }
-        }
-    }
+    nc_gettimespec_mono_add(&ts_cur, 0);
+    (*server)->opts.server.last_rpc = ts_cur.tv_sec;
+    nc_gettimespec_real_add(&ts_cur, 0);
+    (*server)->opts.server.session_start = ts_cur.tv_sec;
 
-    ly_in_free(msg, 1);
-    if (ret != NC_PSPOLL_RPC) {
-        nc_server_rpc_free(*rpc);
-        *rpc = NULL;
-    }
-    return ret;
-}
+    (*server)->status = NC_STATUS_RUNNING;
+    (*client)->status = NC_STATUS_RUNNING;
 
-API void
-nc_set_global_rpc_clb(nc_rpc_clb clb)
-{
-    global_rpc_clb = clb;
+cleanup:
+    if (msgtype != NC_MSG_HELLO) {
+        nc_session_free(*server, NULL);
+        *server = NULL;
+        nc_session_free(*client, NULL);
+        *client = NULL;
+    }
+    return msgtype;
 }
 
-API NC_MSG_TYPE
-nc_server_notif_send(struct nc_session *session, struct nc_server_notif *notif, int timeout)
+static void
+nc_ps_queue_add_id(struct nc_pollsession *ps, uint8_t *id)
 {
-    NC_MSG_TYPE ret;
+    uint8_t q_last;
 
-    /* check parameters */
-    if (!session || (session->side != NC_SERVER) || !nc_session_get_notif_status(session)) {
-        ERRARG("session");
-        return NC_MSG_ERROR;
-    } else if (!notif || !notif->ntf || !notif->eventtime) {
-        ERRARG("notif");
-        return NC_MSG_ERROR;
+    if (ps->queue_len == NC_PS_QUEUE_SIZE) {
+        ERRINT;
+        return;
     }
 
-    /* we do not need RPC lock for this, IO lock will be acquired properly */
-    ret = nc_write_msg_io(session, timeout, NC_MSG_NOTIF, notif);
-    if (ret != NC_MSG_NOTIF) {
-        ERR(session, "Failed to write notification (%s).", nc_msgtype2str[ret]);
+    /* get a unique queue value (by adding 1 to the last added value, if any) */
+    if (ps->queue_len) {
+        q_last = (ps->queue_begin + ps->queue_len - 1) % NC_PS_QUEUE_SIZE;
+        *id = ps->queue[q_last] + 1;
+    } else {
+        *id = 0;
     }
 
-    return ret;
+    /* add the id into the queue */
+    ++ps->queue_len;
+    q_last = (ps->queue_begin + ps->queue_len - 1) % NC_PS_QUEUE_SIZE;
+    ps->queue[q_last] = *id;
 }
 
-/* must be called holding the session RPC lock! IO lock will be acquired as needed
- * returns: NC_PSPOLL_ERROR,
- *          NC_PSPOLL_ERROR | NC_PSPOLL_REPLY_ERROR,
- *          NC_PSPOLL_REPLY_ERROR,
- *          0
- */
-static int
-nc_server_send_reply_io(struct nc_session *session, int io_timeout, const struct nc_server_rpc *rpc)
+static void
+nc_ps_queue_remove_id(struct nc_pollsession *ps, uint8_t id)
 {
-    nc_rpc_clb clb;
-    struct nc_server_reply *reply;
-    const struct lysc_node *rpc_act = NULL;
-    struct lyd_node *elem;
-    int ret = 0;
-    NC_MSG_TYPE r;
+    uint8_t i, q_idx, found = 0;
 
-    if (!rpc) {
-        ERRINT;
-        return NC_PSPOLL_ERROR;
-    }
+    for (i = 0; i < ps->queue_len; ++i) {
+        /* get the actual queue idx */
+        q_idx = (ps->queue_begin + i) % NC_PS_QUEUE_SIZE;
 
-    if (rpc->rpc->schema->nodetype == LYS_RPC) {
-        /* RPC */
-        rpc_act = rpc->rpc->schema;
-    } else {
-        /* action */
-        LYD_TREE_DFS_BEGIN(rpc->rpc, elem) {
-            if (elem->schema->nodetype == LYS_ACTION) {
-                rpc_act = elem->schema;
-                break;
+        if (found) {
+            if (ps->queue[q_idx] == id) {
+                /* another equal value, simply cannot be */
+                ERRINT;
+            }
+            if (found == 2) {
+                /* move the following values */
+                ps->queue[q_idx ? q_idx - 1 : NC_PS_QUEUE_SIZE - 1] = ps->queue[q_idx];
+            }
+        } else if (ps->queue[q_idx] == id) {
+            /* found our id, there can be no more equal valid values */
+            if (i == 0) {
+                found = 1;
+            } else {
+                /* this is not okay, our id is in the middle of the queue */
+                found = 2;
             }
-            LYD_TREE_DFS_END(rpc->rpc, elem);
         }
-        if (!rpc_act) {
-            ERRINT;
-            return NC_PSPOLL_ERROR;
-        }
-    }
-
-    if (!rpc_act->priv) {
-        if (!global_rpc_clb) {
-            /* no callback, reply with a not-implemented error */
-            reply = nc_server_reply_err(nc_err(session->ctx, NC_ERR_OP_NOT_SUPPORTED, NC_ERR_TYPE_PROT));
-        } else {
-            reply = global_rpc_clb(rpc->rpc, session);
-        }
-    } else {
-        clb = (nc_rpc_clb)rpc_act->priv;
-        reply = clb(rpc->rpc, session);
     }
-
-    if (!reply) {
-        reply = nc_server_reply_err(nc_err(session->ctx, NC_ERR_OP_FAILED, NC_ERR_TYPE_APP));
-    }
-    r = nc_write_msg_io(session, io_timeout, NC_MSG_REPLY, rpc->envp, reply);
-    if (reply->type == NC_RPL_ERROR) {
-        ret |= NC_PSPOLL_REPLY_ERROR;
-    }
-    nc_server_reply_free(reply);
-
-    if (r != NC_MSG_REPLY) {
-        ERR(session, "Failed to write reply (%s).", nc_msgtype2str[r]);
-        ret |= NC_PSPOLL_ERROR;
+    if (!found) {
+        ERRINT;
+        return;
     }
 
-    /* special case if term_reason was set in callback, last reply was sent (needed for <close-session> if nothing else) */
-    if ((session->status == NC_STATUS_RUNNING) && (session->term_reason != NC_SESSION_TERM_NONE)) {
-        session->status = NC_STATUS_INVALID;
+    --ps->queue_len;
+    if (found == 1) {
+        /* remove the id by moving the queue, otherwise all the values in the queue were moved */
+        ps->queue_begin = (ps->queue_begin + 1) % NC_PS_QUEUE_SIZE;
     }
-
-    return ret;
 }
 
-/* session must be running and session RPC lock held!
- * returns: NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR, (msg filled)
- *          NC_PSPOLL_ERROR, (msg filled)
- *          NC_PSPOLL_TIMEOUT,
- *          NC_PSPOLL_RPC (some application data available),
- *          NC_PSPOLL_SSH_CHANNEL,
- *          NC_PSPOLL_SSH_MSG
- */
-static int
-nc_ps_poll_session_io(struct nc_session *session, int io_timeout, time_t now_mono, char *msg)
+int
+nc_ps_lock(struct nc_pollsession *ps, uint8_t *id, const char *func)
 {
-    struct pollfd pfd;
-    int r, ret = 0;
+    int ret;
+    struct timespec ts;
 
-#ifdef NC_ENABLED_SSH
-    struct nc_session *new;
-#endif
+    nc_gettimespec_real_add(&ts, NC_PS_LOCK_TIMEOUT);
 
-    /* check timeout first */
-    if (!(session->flags & NC_SESSION_CALLHOME) && !nc_session_get_notif_status(session) && server_opts.idle_timeout &&
-            (now_mono >= session->opts.server.last_rpc + server_opts.idle_timeout)) {
-        sprintf(msg, "session idle timeout elapsed");
-        session->status = NC_STATUS_INVALID;
-        session->term_reason = NC_SESSION_TERM_TIMEOUT;
-        return NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
+    /* LOCK */
+    ret = pthread_mutex_timedlock(&ps->lock, &ts);
+    if (ret) {
+        ERR(NULL, "%s: failed to lock a pollsession (%s).", func, strerror(ret));
+        return -1;
     }
 
-    r = nc_session_io_lock(session, io_timeout, __func__);
-    if (r < 0) {
-        sprintf(msg, "session IO lock failed to be acquired");
-        return NC_PSPOLL_ERROR;
-    } else if (!r) {
-        return NC_PSPOLL_TIMEOUT;
+    /* check that the queue is long enough */
+    if (ps->queue_len == NC_PS_QUEUE_SIZE) {
+        ERR(NULL, "%s: pollsession queue size (%d) too small.", func, NC_PS_QUEUE_SIZE);
+        pthread_mutex_unlock(&ps->lock);
+        return -1;
     }
 
-    switch (session->ti_type) {
-#ifdef NC_ENABLED_SSH
-    case NC_TI_LIBSSH:
-        r = ssh_channel_poll_timeout(session->ti.libssh.channel, 0, 0);
-        if (r == SSH_EOF) {
-            sprintf(msg, "SSH channel unexpected EOF");
-            session->status = NC_STATUS_INVALID;
-            session->term_reason = NC_SESSION_TERM_DROPPED;
-            ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
-        } else if (r == SSH_ERROR) {
-            sprintf(msg, "SSH channel poll error (%s)", ssh_get_error(session->ti.libssh.session));
-            session->status = NC_STATUS_INVALID;
-            session->term_reason = NC_SESSION_TERM_OTHER;
-            ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
-        } else if (!r) {
-            if (session->flags & NC_SESSION_SSH_NEW_MSG) {
-                /* new SSH message */
-                session->flags &= ~NC_SESSION_SSH_NEW_MSG;
-                if (session->ti.libssh.next) {
-                    for (new = session->ti.libssh.next; new != session; new = new->ti.libssh.next) {
-                        if ((new->status == NC_STATUS_STARTING) && new->ti.libssh.channel &&
-                                (new->flags & NC_SESSION_SSH_SUBSYS_NETCONF)) {
-                            /* new NETCONF SSH channel */
-                            ret = NC_PSPOLL_SSH_CHANNEL;
-                            break;
-                        }
-                    }
-                    if (new != session) {
-                        break;
-                    }
-                }
+    /* add ourselves into the queue */
+    nc_ps_queue_add_id(ps, id);
+    DBL(NULL, "PS 0x%p TID %lu queue: added %u, head %u, length %u", ps, (long unsigned int)pthread_self(), *id,
+            ps->queue[ps->queue_begin], ps->queue_len);
 
-                /* just some SSH message */
-                ret = NC_PSPOLL_SSH_MSG;
-            } else {
-                ret = NC_PSPOLL_TIMEOUT;
-            }
-        } else {
-            /* we have some application data */
-            ret = NC_PSPOLL_RPC;
-        }
-        break;
-#endif
-#ifdef NC_ENABLED_TLS
-    case NC_TI_OPENSSL:
-        r = SSL_pending(session->ti.tls);
-        if (!r) {
-            /* no data pending in the SSL buffer, poll fd */
-            pfd.fd = SSL_get_rfd(session->ti.tls);
-            if (pfd.fd < 0) {
-                sprintf(msg, "internal error (%s:%d)", __FILE__, __LINE__);
-                ret = NC_PSPOLL_ERROR;
-                break;
-            }
-            pfd.events = POLLIN;
-            pfd.revents = 0;
-            r = poll(&pfd, 1, 0);
+    /* is it our turn? */
+    while (ps->queue[ps->queue_begin] != *id) {
+        nc_gettimespec_real_add(&ts, NC_PS_QUEUE_TIMEOUT);
 
-            if ((r < 0) && (errno != EINTR)) {
-                sprintf(msg, "poll failed (%s)", strerror(errno));
-                session->status = NC_STATUS_INVALID;
-                ret = NC_PSPOLL_ERROR;
-            } else if (r > 0) {
-                if (pfd.revents & (POLLHUP | POLLNVAL)) {
-                    sprintf(msg, "communication socket unexpectedly closed");
-                    session->status = NC_STATUS_INVALID;
-                    session->term_reason = NC_SESSION_TERM_DROPPED;
-                    ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
-                } else if (pfd.revents & POLLERR) {
-                    sprintf(msg, "communication socket error");
-                    session->status = NC_STATUS_INVALID;
-                    session->term_reason = NC_SESSION_TERM_OTHER;
-                    ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
-                } else {
-                    ret = NC_PSPOLL_RPC;
-                }
-            } else {
-                ret = NC_PSPOLL_TIMEOUT;
+        ret = pthread_cond_timedwait(&ps->cond, &ps->lock, &ts);
+        if (ret) {
+            /**
+             * This may happen when another thread releases the lock and broadcasts the condition
+             * and this thread had already timed out. When this thread is scheduled, it returns timed out error
+             * but when actually this thread was ready for condition.
+             */
+            if ((ETIMEDOUT == ret) && (ps->queue[ps->queue_begin] == *id)) {
+                break;
             }
-        } else {
-            ret = NC_PSPOLL_RPC;
-        }
-        break;
-#endif
-    case NC_TI_FD:
-    case NC_TI_UNIX:
-        pfd.fd = (session->ti_type == NC_TI_FD) ? session->ti.fd.in : session->ti.unixsock.sock;
-        pfd.events = POLLIN;
-        pfd.revents = 0;
-        r = poll(&pfd, 1, 0);
 
-        if ((r < 0) && (errno != EINTR)) {
-            sprintf(msg, "poll failed (%s)", strerror(errno));
-            session->status = NC_STATUS_INVALID;
-            ret = NC_PSPOLL_ERROR;
-        } else if (r > 0) {
-            if (pfd.revents & (POLLHUP | POLLNVAL)) {
-                sprintf(msg, "communication socket unexpectedly closed");
-                session->status = NC_STATUS_INVALID;
-                session->term_reason = NC_SESSION_TERM_DROPPED;
-                ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
-            } else if (pfd.revents & POLLERR) {
-                sprintf(msg, "communication socket error");
-                session->status = NC_STATUS_INVALID;
-                session->term_reason = NC_SESSION_TERM_OTHER;
-                ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
-            } else {
-                ret = NC_PSPOLL_RPC;
-            }
-        } else {
-            ret = NC_PSPOLL_TIMEOUT;
+            ERR(NULL, "%s: failed to wait for a pollsession condition (%s).", func, strerror(ret));
+            /* remove ourselves from the queue */
+            nc_ps_queue_remove_id(ps, *id);
+            pthread_mutex_unlock(&ps->lock);
+            return -1;
         }
-        break;
-    case NC_TI_NONE:
-        sprintf(msg, "internal error (%s:%d)", __FILE__, __LINE__);
-        ret = NC_PSPOLL_ERROR;
-        break;
     }
 
-    nc_session_io_unlock(session, __func__);
-    return ret;
+    /* UNLOCK */
+    pthread_mutex_unlock(&ps->lock);
+
+    return 0;
 }
 
-API int
-nc_ps_poll(struct nc_pollsession *ps, int timeout, struct nc_session **session)
+int
+nc_ps_unlock(struct nc_pollsession *ps, uint8_t id, const char *func)
 {
-    int ret = NC_PSPOLL_ERROR, r;
-    uint8_t q_id;
-    uint16_t i, j;
-    char msg[256];
-    struct timespec ts_timeout, ts_cur;
-    struct nc_session *cur_session;
-    struct nc_ps_session *cur_ps_session;
-    struct nc_server_rpc *rpc = NULL;
+    int ret;
+    struct timespec ts;
 
-    if (!ps) {
-        ERRARG("ps");
-        return NC_PSPOLL_ERROR;
-    }
+    nc_gettimespec_real_add(&ts, NC_PS_LOCK_TIMEOUT);
 
-    /* PS LOCK */
-    if (nc_ps_lock(ps, &q_id, __func__)) {
-        return NC_PSPOLL_ERROR;
+    /* LOCK */
+    ret = pthread_mutex_timedlock(&ps->lock, &ts);
+    if (ret) {
+        ERR(NULL, "%s: failed to lock a pollsession (%s).", func, strerror(ret));
+        ret = -1;
     }
 
-    if (!ps->session_count) {
-        nc_ps_unlock(ps, q_id, __func__);
-        return NC_PSPOLL_NOSESSIONS;
+    /* we must be the first, it was our turn after all, right? */
+    if (ps->queue[ps->queue_begin] != id) {
+        ERRINT;
+        /* UNLOCK */
+        if (!ret) {
+            pthread_mutex_unlock(&ps->lock);
+        }
+        return -1;
     }
 
-    /* fill timespecs */
-    nc_gettimespec_mono_add(&ts_cur, 0);
-    if (timeout > -1) {
-        nc_gettimespec_mono_add(&ts_timeout, timeout);
-    }
+    /* remove ourselves from the queue */
+    nc_ps_queue_remove_id(ps, id);
+    DBL(NULL, "PS 0x%p TID %lu queue: removed %u, head %u, length %u", ps, (long unsigned int)pthread_self(), id,
+            ps->queue[ps->queue_begin], ps->queue_len);
+
+    /* broadcast to all other threads that the queue moved */
+    pthread_cond_broadcast(&ps->cond);
+
+    /* UNLOCK */
+    if (!ret) {
+        pthread_mutex_unlock(&ps->lock);
+    }
+
+    return ret;
+}
+
+static void
+nc_ps_timer_unlink(struct nc_pollsession *ps, struct nc_ps_session *ps_session)
+{
+    if (!ps_session->timer_list) {
+        return;
+    }
+
+    if (ps_session->timer_prev) {
+        ps_session->timer_prev->timer_next = ps_session->timer_next;
+    } else {
+        *ps_session->timer_list = ps_session->timer_next;
+    }
+    if (ps_session->timer_next) {
+        ps_session->timer_next->timer_prev = ps_session->timer_prev;
+    }
+    if (ps_session->timer_list != &ps->wheel.expired) {
+        --ps->wheel.count;
+    }
+
+    ps_session->timer_list = NULL;
+    ps_session->timer_prev = NULL;
+    ps_session->timer_next = NULL;
+}
+
+static void
+nc_ps_timer_link(struct nc_pollsession *ps, struct nc_ps_session *ps_session, struct nc_ps_session **list)
+{
+    ps_session->timer_list = list;
+    ps_session->timer_prev = NULL;
+    ps_session->timer_next = *list;
+    if (*list) {
+        (*list)->timer_prev = ps_session;
+    }
+    *list = ps_session;
+    if (list != &ps->wheel.expired) {
+        ++ps->wheel.count;
+    }
+}
+
+/**
+ * @brief Schedule the timer of a pollsession session, any previous one is cancelled.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[in] ps_session Pollsession session.
+ * @param[in] expire Monotonic time in sec the timer expires, 0 to only cancel it.
+ */
+static void
+nc_ps_timer_set(struct nc_pollsession *ps, struct nc_ps_session *ps_session, time_t expire)
+{
+    struct nc_ps_wheel *wheel = &ps->wheel;
+    const time_t range = (time_t)1 << (NC_PS_WHEEL_BITS * NC_PS_WHEEL_LEVELS);
+    time_t delta, slot_expire;
+    int level;
+
+    nc_ps_timer_unlink(ps, ps_session);
+    ps_session->timer_expire = expire;
+    if (!expire) {
+        return;
+    }
+
+    if (expire <= wheel->now) {
+        nc_ps_timer_link(ps, ps_session, &wheel->expired);
+        return;
+    }
+
+    slot_expire = expire;
+    delta = expire - wheel->now;
+    if (delta >= range) {
+        /* out of the wheel range, it gets to a lower level when its slot is reached */
+        slot_expire = wheel->now + range - 1;
+        delta = range - 1;
+    }
+
+    /* the lowest level with the slots long enough */
+    for (level = 0; delta >= ((time_t)1 << (NC_PS_WHEEL_BITS * (level + 1))); ++level) {}
+    nc_ps_timer_link(ps, ps_session,
+            &wheel->slots[level][(slot_expire >> (NC_PS_WHEEL_BITS * level)) & (NC_PS_WHEEL_SLOTS - 1)]);
+}
+
+/**
+ * @brief Advance the timer wheel of a pollsession, move all the expired timers to the expired list.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[in] now Current monotonic time in sec.
+ */
+static void
+nc_ps_timer_advance(struct nc_pollsession *ps, time_t now)
+{
+    struct nc_ps_wheel *wheel = &ps->wheel;
+    struct nc_ps_session *ps_session, *next;
+    time_t t;
+    int level;
+
+    while (wheel->now < now) {
+        if (!wheel->count) {
+            /* nothing scheduled */
+            wheel->now = now;
+            break;
+        }
+
+        t = ++wheel->now;
+
+        /* redistribute the slots starting now, of the highest level first, the lowest level slot expires */
+        for (level = NC_PS_WHEEL_LEVELS - 1; level >= 0; --level) {
+            if (t & (((time_t)1 << (NC_PS_WHEEL_BITS * level)) - 1)) {
+                continue;
+            }
+
+            ps_session = wheel->slots[level][(t >> (NC_PS_WHEEL_BITS * level)) & (NC_PS_WHEEL_SLOTS - 1)];
+            while (ps_session) {
+                next = ps_session->timer_next;
+                nc_ps_timer_set(ps, ps_session, ps_session->timer_expire);
+                ps_session = next;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Learn when the timer of a pollsession session should expire.
+ *
+ * @param[in] ps_session RPC locked pollsession session.
+ * @return Monotonic time in sec, 0 for no timer.
+ */
+static time_t
+nc_ps_timer_deadline(const struct nc_ps_session *ps_session)
+{
+    const struct nc_session *session = ps_session->session;
+    const struct nc_handshake *hs = session->opts.server.handshake;
+
+    if (session->status == NC_STATUS_RUNNING) {
+#ifdef HAVE_IO_URING
+        if ((ps_session->uring_op == NC_PS_URING_READ) && (!server_opts.idle_timeout ||
+                (NC_SESSION_BUF_IDLE_TIMEOUT < server_opts.idle_timeout) || (session->flags & NC_SESSION_CALLHOME))) {
+            /* the pending read must be canceled once the session is idle so that its buffers can be freed */
+            return session->opts.server.last_rpc + NC_SESSION_BUF_IDLE_TIMEOUT;
+        }
+#endif
+        if (!(session->flags & NC_SESSION_CALLHOME) && server_opts.idle_timeout) {
+            return session->opts.server.last_rpc + server_opts.idle_timeout;
+        }
+    } else if ((session->status == NC_STATUS_STARTING) && hs && hs->has_timeout) {
+        /* the stage timeout rounded up */
+        return hs->ts_timeout.tv_sec + 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Learn the time until the next timer of a pollsession may expire.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @return Time in msec, -1 if there are no timers.
+ */
+static int32_t
+nc_ps_timer_wait(struct nc_pollsession *ps)
+{
+    struct nc_ps_wheel *wheel = &ps->wheel;
+    struct timespec ts_cur;
+    int64_t wait_ms;
+    time_t t;
+
+    if (wheel->expired) {
+        /* the sessions are being worked with by other threads */
+        return NC_PS_TIMER_BUSY_WAIT;
+    } else if (!wheel->count) {
+        return -1;
+    }
+
+    /* the next non-empty lowest level slot or the next redistribution of higher levels */
+    for (t = wheel->now + 1; !wheel->slots[0][t & (NC_PS_WHEEL_SLOTS - 1)] && (t & (NC_PS_WHEEL_SLOTS - 1)); ++t) {}
+
+    nc_gettimespec_mono_add(&ts_cur, 0);
+    wait_ms = ((int64_t)t - ts_cur.tv_sec) * 1000 - ts_cur.tv_nsec / 1000000;
+    return (wait_ms < 0) ? 0 : wait_ms;
+}
+
+#ifdef HAVE_IO_URING
+
+/**
+ * @brief Get a submission queue entry of a pollsession io_uring instance, the queued requests are submitted
+ * if the queue is full.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @return Submission queue entry, NULL on error.
+ */
+static struct io_uring_sqe *
+nc_ps_uring_sqe(struct nc_pollsession *ps)
+{
+    struct io_uring_sqe *sqe;
+
+    sqe = io_uring_get_sqe(&ps->uring);
+    if (!sqe) {
+        /* submit the whole batch to make space */
+        io_uring_submit(&ps->uring);
+        sqe = io_uring_get_sqe(&ps->uring);
+    }
+
+    return sqe;
+}
+
+/**
+ * @brief Process all the completions of a pollsession io_uring instance.
+ *
+ * The data read are added into the session receive buffers, the sessions are then marked ready.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[out] epoll_ready Set if the poll request on the pollsession epoll instance completed.
+ * @return Number of sessions marked ready.
+ */
+static int
+nc_ps_uring_reap(struct nc_pollsession *ps, int *epoll_ready)
+{
+    struct io_uring_cqe *cqe;
+    struct nc_ps_session *ps_session;
+    unsigned head, count = 0;
+    int ready = 0;
+
+    io_uring_for_each_cqe(&ps->uring, head, cqe) {
+        ++count;
+        ps_session = io_uring_cqe_get_data(cqe);
+        if (!ps_session) {
+            /* NULL data pointer marks the poll request on epfd */
+            ps->uring_epoll = 0;
+            *epoll_ready = 1;
+            continue;
+        } else if ((void *)ps_session == (void *)&ps->uring) {
+            /* cancel request */
+            continue;
+        }
+
+        if ((ps_session->uring_op == NC_PS_URING_READ) && (cqe->res > 0)) {
+            ps_session->session->rbuf_len += cqe->res;
+            ATOMIC_ADD_RELAXED(ps_session->session->stats.in_bytes, cqe->res);
+        }
+
+        /* EOF and errors are detected by reading the transport again */
+        ps_session->uring_op = 0;
+        ps_session->ready = 1;
+        ++ready;
+    }
+    io_uring_cq_advance(&ps->uring, count);
+
+    return ready;
+}
+
+/**
+ * @brief Cancel the io_uring request of a pollsession session and wait for its completion.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[in] ps_session Pollsession session to use.
+ * @return 0 on success, -1 if the request could not be canceled and io_uring must be stopped for @p ps.
+ */
+static int
+nc_ps_uring_cancel(struct nc_pollsession *ps, struct nc_ps_session *ps_session)
+{
+    struct io_uring_sqe *sqe;
+    int r, epoll_ready;
+
+    if (!ps->uring_used || !ps_session->uring_op) {
+        return 0;
+    }
+
+    sqe = nc_ps_uring_sqe(ps);
+    if (!sqe) {
+        /* the request may never complete, do not wait for it */
+        ERR(ps_session->session, "No io_uring submission queue entry available to cancel a request.");
+        return -1;
+    }
+    io_uring_prep_cancel(sqe, ps_session, 0);
+    io_uring_sqe_set_data(sqe, &ps->uring);
+
+    /* the transport and the receive buffer may be used by the kernel until the request completes */
+    while (ps_session->uring_op) {
+        r = io_uring_submit_and_wait(&ps->uring, 1);
+        if ((r < 0) && (r != -EINTR)) {
+            ERR(ps_session->session, "Waiting for a canceled io_uring request failed (%s).", strerror(-r));
+            return -1;
+        }
+        nc_ps_uring_reap(ps, &epoll_ready);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Stop using io_uring for a pollsession, all the requests are canceled.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ */
+static void
+nc_ps_uring_disable(struct nc_pollsession *ps)
+{
+    uint16_t i;
+    int epoll_ready;
+
+    if (!ps->uring_used) {
+        return;
+    }
+
+    for (i = 0; i < ps->session_count; ++i) {
+        if (nc_ps_uring_cancel(ps, ps->sessions[i])) {
+            /* keep the data of the already completed requests, the rest is canceled with the instance */
+            io_uring_submit(&ps->uring);
+            nc_ps_uring_reap(ps, &epoll_ready);
+            break;
+        }
+    }
+
+    /* a poll request on epfd may still be in progress, it is canceled with the instance */
+    io_uring_queue_exit(&ps->uring);
+    for (i = 0; i < ps->session_count; ++i) {
+        ps->sessions[i]->uring_op = 0;
+    }
+    ps->uring_used = 0;
+    ps->uring_epoll = 0;
+}
+
+/**
+ * @brief Create the io_uring instance of a new pollsession, it is not used if it cannot be created.
+ *
+ * @param[in] ps Pollsession to use, its epoll instance must exist.
+ */
+static void
+nc_ps_uring_init(struct nc_pollsession *ps)
+{
+    int r;
+
+    r = io_uring_queue_init(NC_PS_URING_ENTRIES, &ps->uring, 0);
+    if (r < 0) {
+        WRN(NULL, "Failed to create an io_uring instance (%s), sessions will be waited for by epoll.", strerror(-r));
+        return;
+    }
+
+    ps->uring_used = 1;
+}
+
+/**
+ * @brief Wait for the next data on an idle FD or UNIX socket pollsession session using io_uring.
+ *
+ * A session that received an RPC recently and has an allocated receive buffer has the data read directly into it.
+ * Other sessions (new or idle for ::NC_SESSION_BUF_IDLE_TIMEOUT) only wait for the transport to become readable so
+ * that their buffers can be freed. A pending read is canceled by the session timer once the session becomes idle.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[in] ps_session RPC locked pollsession session without any data in its receive buffer.
+ * @param[in] now Current monotonic time in seconds.
+ * @return 0 on success (even if the session is not read by io_uring), -1 on error.
+ */
+static int
+nc_ps_uring_arm(struct nc_pollsession *ps, struct nc_ps_session *ps_session, time_t now)
+{
+    struct nc_session *session = ps_session->session;
+    struct io_uring_sqe *sqe;
+    char *space = NULL;
+    size_t size;
+    int fd;
+
+    if (!ps->uring_used || ps_session->uring_op || session->rbuf_len) {
+        return 0;
+    }
+
+    if (session->ti_type == NC_TI_FD) {
+        fd = session->ti.fd.in;
+    } else if (session->ti_type == NC_TI_UNIX) {
+        fd = session->ti.unixsock.sock;
+    } else {
+        return 0;
+    }
+
+    sqe = nc_ps_uring_sqe(ps);
+    if (!sqe) {
+        WRN(session, "No io_uring submission queue entry available, sessions will be waited for by epoll.");
+        return -1;
+    }
+
+    if ((session->status == NC_STATUS_RUNNING) && session->rbuf &&
+            (now < session->opts.server.last_rpc + NC_SESSION_BUF_IDLE_TIMEOUT)) {
+        /* SESSION IO LOCK, the buffer is not resized while being written to, just in case */
+        if (nc_session_io_lock(session, 0, __func__) == 1) {
+            space = nc_session_rbuf_space(session, &size);
+
+            /* SESSION IO UNLOCK */
+            nc_session_io_unlock(session, __func__);
+        }
+    }
+
+    if (space) {
+        io_uring_prep_read(sqe, fd, space, size, -1);
+        ps_session->uring_op = NC_PS_URING_READ;
+    } else {
+        io_uring_prep_poll_add(sqe, fd, POLLIN);
+        ps_session->uring_op = NC_PS_URING_POLL;
+    }
+    io_uring_sqe_set_data(sqe, ps_session);
+
+    /* submitted in a batch with all the other requests once the pollsession waits */
+    return 0;
+}
+
+/**
+ * @brief Wait for completions on a pollsession io_uring instance.
+ *
+ * The pollsession epoll instance is waited for by a poll request in the same queue, so there is a single wait.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[in] timeout Timeout in msec, -1 for infinite.
+ * @param[out] epoll_ready Set if there are some events on the pollsession epoll instance.
+ * @return Number of sessions with data, -1 on error.
+ */
+static int
+nc_ps_uring_wait(struct nc_pollsession *ps, int timeout, int *epoll_ready)
+{
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe *cqe;
+    struct __kernel_timespec ts;
+    int r;
+
+    *epoll_ready = 0;
+
+    if (!ps->uring_epoll) {
+        sqe = nc_ps_uring_sqe(ps);
+        if (!sqe) {
+            ERR(NULL, "No io_uring submission queue entry available, sessions will be waited for by epoll.");
+            return -1;
+        }
+        io_uring_prep_poll_add(sqe, ps->epfd, POLLIN);
+        io_uring_sqe_set_data(sqe, NULL);
+        ps->uring_epoll = 1;
+    }
+
+    if (timeout) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000;
+        r = io_uring_submit_and_wait_timeout(&ps->uring, &cqe, 1, (timeout > 0) ? &ts : NULL, NULL);
+    } else {
+        r = io_uring_submit(&ps->uring);
+    }
+    if ((r < 0) && (r != -ETIME) && (r != -EINTR)) {
+        ERR(NULL, "io_uring wait failed (%s), sessions will be waited for by epoll.", strerror(-r));
+        return -1;
+    }
+
+    return nc_ps_uring_reap(ps, epoll_ready);
+}
+
+#endif /* HAVE_IO_URING */
+
+#ifdef HAVE_EPOLL
+
+/**
+ * @brief Stop using epoll for a pollsession, sessions are then polled one-by-one.
+ *
+ * The wake-up eventfd is kept until the pollsession is freed because other threads may be using it.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ */
+static void
+nc_ps_epoll_disable(struct nc_pollsession *ps)
+{
+#ifdef HAVE_IO_URING
+    /* io_uring waits for epoll */
+    nc_ps_uring_disable(ps);
+#endif
+
+    if (ps->epfd > -1) {
+        close(ps->epfd);
+        ps->epfd = -1;
+    }
+    ps->parked_count = 0;
+}
+
+/**
+ * @brief Create the epoll instance of a new pollsession.
+ *
+ * @param[in] ps Pollsession to use.
+ */
+static void
+nc_ps_epoll_init(struct nc_pollsession *ps)
+{
+    struct epoll_event ev = {0};
+
+    ps->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (ps->epfd == -1) {
+        WRN(NULL, "Failed to create an epoll instance (%s), sessions will be polled one-by-one.", strerror(errno));
+        ps->wakefd = -1;
+        return;
+    }
+
+    ps->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ps->wakefd == -1) {
+        WRN(NULL, "Failed to create an eventfd (%s), sessions will be polled one-by-one.", strerror(errno));
+        nc_ps_epoll_disable(ps);
+        return;
+    }
+
+    /* NULL data pointer marks the wake-up event */
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(ps->epfd, EPOLL_CTL_ADD, ps->wakefd, &ev) == -1) {
+        WRN(NULL, "Failed to add an eventfd into epoll (%s), sessions will be polled one-by-one.", strerror(errno));
+        nc_ps_epoll_disable(ps);
+        return;
+    }
+
+#ifdef HAVE_IO_URING
+    nc_ps_uring_init(ps);
+#endif
+}
+
+/**
+ * @brief Register a new pollsession session with the pollsession epoll instance.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[in] ps_session Pollsession session to register.
+ */
+static void
+nc_ps_epoll_add(struct nc_pollsession *ps, struct nc_ps_session *ps_session)
+{
+    struct epoll_event ev = {0};
+
+    ps_session->fd = nc_session_ti_fd(ps_session->session);
+    ps_session->ready = 0;
+    ps_session->out_wait = 0;
+    ps_session->parked = 0;
+    if (ps->epfd == -1) {
+        return;
+    }
+#ifdef HAVE_IO_URING
+    if (ps->uring_used && ((ps_session->session->ti_type == NC_TI_FD) ||
+            (ps_session->session->ti_type == NC_TI_UNIX))) {
+        /* waited for by io_uring */
+        ps_session->fd = -1;
+        return;
+    }
+#endif
+    if (ps_session->fd == -1) {
+        WRN(ps_session->session, "Session without a transport file descriptor, sessions will be polled one-by-one.");
+        nc_ps_epoll_disable(ps);
+        return;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = ps_session;
+    if (epoll_ctl(ps->epfd, EPOLL_CTL_ADD, ps_session->fd, &ev) == -1) {
+#ifdef NC_ENABLED_SSH
+        if ((errno == EEXIST) && (ps_session->session->ti_type == NC_TI_LIBSSH)) {
+            /* SSH socket shared by several NETCONF sessions, already registered */
+            return;
+        }
+#endif
+
+        WRN(ps_session->session, "Failed to add a session into epoll (%s), sessions will be polled one-by-one.",
+                strerror(errno));
+        nc_ps_epoll_disable(ps);
+    }
+}
+
+/**
+ * @brief Unregister a pollsession session from the pollsession epoll instance.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[in] ps_session Pollsession session to unregister, must still be in @p ps.
+ */
+static void
+nc_ps_epoll_del(struct nc_pollsession *ps, struct nc_ps_session *ps_session)
+{
+    struct epoll_event ev = {0};
+    uint16_t i;
+
+    if ((ps->epfd == -1) || (ps_session->fd == -1)) {
+        return;
+    }
+    if (ps_session->parked) {
+        --ps->parked_count;
+    }
+
+    for (i = 0; i < ps->session_count; ++i) {
+        if ((ps->sessions[i] != ps_session) && (ps->sessions[i]->fd == ps_session->fd)) {
+            break;
+        }
+    }
+
+    if (i < ps->session_count) {
+        /* the socket is still used by another session, let its events point to it */
+        ev.events = EPOLLIN;
+        ev.data.ptr = ps->sessions[i];
+        epoll_ctl(ps->epfd, EPOLL_CTL_MOD, ps_session->fd, &ev);
+    } else {
+        /* may fail if the file descriptor was already closed, which is fine */
+        epoll_ctl(ps->epfd, EPOLL_CTL_DEL, ps_session->fd, &ev);
+    }
+}
+
+/**
+ * @brief Wait for a pollsession session to become writable only while its output queue is not empty.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[in] ps_session Pollsession session, must be RPC locked.
+ * @return 0 on success, 1 if the queued output cannot be waited for by epoll and must be retried.
+ */
+static int
+nc_ps_epoll_out(struct nc_pollsession *ps, struct nc_ps_session *ps_session)
+{
+    struct epoll_event ev = {0};
+    uint8_t out_wait;
+
+    out_wait = ps_session->session->obuf_len ? 1 : 0;
+    if ((ps->epfd == -1) || (ps_session->fd == -1)) {
+        return out_wait;
+    } else if ((ps_session->session->ti_type == NC_TI_FD) &&
+            (ps_session->session->ti.fd.in != ps_session->session->ti.fd.out)) {
+        /* only the input file descriptor is waited on */
+        return out_wait;
+#ifdef NC_ENABLED_SSH
+    } else if (ps_session->session->ti_type == NC_TI_LIBSSH) {
+        /* a writable socket does not mean the peer opened the channel window */
+        return out_wait;
+#endif
+    } else if (out_wait == ps_session->out_wait) {
+        /* no change */
+        return 0;
+    }
+
+    ev.events = out_wait ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    ev.data.ptr = ps_session;
+    if (epoll_ctl(ps->epfd, EPOLL_CTL_MOD, ps_session->fd, &ev) == -1) {
+        WRN(ps_session->session, "Failed to modify a session in epoll (%s).", strerror(errno));
+        return out_wait;
+    }
+    ps_session->out_wait = out_wait;
+
+    return 0;
+}
+
+/**
+ * @brief Stop waiting for the sessions with events that are being worked with by other threads.
+ *
+ * Their transports would otherwise stay readable and keep waking up the waiting thread until the data are read.
+ * Every session is released by nc_ps_poll_rpc() or nc_ps_poll_handshake(), which wake the waiting thread up.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ */
+static void
+nc_ps_epoll_park(struct nc_pollsession *ps)
+{
+    struct epoll_event ev = {0};
+    struct nc_ps_session *ps_session;
+    uint16_t i;
+
+    for (i = 0; i < ps->session_count; ++i) {
+        ps_session = ps->sessions[i];
+        if (!ps_session->ready || ps_session->parked || (ps_session->fd == -1)) {
+            continue;
+        }
+
+        /* SESSION RPC LOCK */
+        if (nc_session_rpc_lock(ps_session->session, 0, __func__) == 1) {
+            /* released meanwhile, it is polled again after the wake-up */
+            nc_session_rpc_unlock(ps_session->session, NC_SESSION_LOCK_TIMEOUT, __func__);
+            continue;
+        }
+
+        /* SSH sockets shared by several sessions are not waited for either, all of them are polled once woken up */
+        ev.events = 0;
+        ev.data.ptr = ps_session;
+        if (epoll_ctl(ps->epfd, EPOLL_CTL_MOD, ps_session->fd, &ev) == -1) {
+            WRN(ps_session->session, "Failed to modify a session in epoll (%s).", strerror(errno));
+            continue;
+        }
+        ps_session->parked = 1;
+        ++ps->parked_count;
+    }
+}
+
+/**
+ * @brief Wait again for the parked sessions no longer worked with by other threads.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ */
+static void
+nc_ps_epoll_unpark(struct nc_pollsession *ps)
+{
+    struct epoll_event ev = {0};
+    struct nc_ps_session *ps_session;
+    uint16_t i;
+
+    for (i = 0; ps->parked_count && (i < ps->session_count); ++i) {
+        ps_session = ps->sessions[i];
+        if (!ps_session->parked) {
+            continue;
+        }
+
+        /* SESSION RPC LOCK */
+        if (nc_session_rpc_lock(ps_session->session, 0, __func__) != 1) {
+            /* still being worked with */
+            continue;
+        }
+
+        ev.events = ps_session->out_wait ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        ev.data.ptr = ps_session;
+        if (epoll_ctl(ps->epfd, EPOLL_CTL_MOD, ps_session->fd, &ev) == -1) {
+            WRN(ps_session->session, "Failed to modify a session in epoll (%s).", strerror(errno));
+        }
+        ps_session->parked = 0;
+        --ps->parked_count;
+
+        /* some data may have arrived while parked */
+        ps_session->ready = 1;
+
+        /* SESSION RPC UNLOCK */
+        nc_session_rpc_unlock(ps_session->session, NC_SESSION_LOCK_TIMEOUT, __func__);
+    }
+}
+
+/**
+ * @brief Wait for events on a pollsession epoll instance and mark the ready sessions.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[in] timeout Timeout in msec, -1 for infinite.
+ * @return Number of events received, -1 on error (epoll is then disabled for @p ps).
+ */
+static int
+nc_ps_epoll_wait(struct nc_pollsession *ps, int timeout)
+{
+    struct epoll_event events[NC_PS_EPOLL_EVENTS];
+    struct nc_ps_session *ps_session;
+    uint64_t val;
+    int i, count;
+
+    count = epoll_wait(ps->epfd, events, NC_PS_EPOLL_EVENTS, timeout);
+    if (count == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+
+        ERR(NULL, "epoll_wait() failed (%s), sessions will be polled one-by-one.", strerror(errno));
+        nc_ps_epoll_disable(ps);
+        return -1;
+    }
+
+    for (i = 0; i < count; ++i) {
+        ps_session = events[i].data.ptr;
+        if (!ps_session) {
+            /* consume the wake-up event */
+            if (read(ps->wakefd, &val, sizeof val) == -1) {
+                /* nothing to do, someone else consumed it first */
+            }
+            continue;
+        }
+
+        ps_session->ready = 1;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Wake up a thread waiting on a pollsession epoll instance.
+ *
+ * Used when a session is released after its RPC was processed because some of its data may have
+ * been read into the transport library buffers that epoll cannot see.
+ *
+ * @param[in] ps Pollsession to use, does not need to be locked.
+ */
+static void
+nc_ps_epoll_wake(struct nc_pollsession *ps)
+{
+    uint64_t val = 1;
+
+    if (ps->wakefd == -1) {
+        return;
+    }
+
+    if (write(ps->wakefd, &val, sizeof val) == -1) {
+        /* counter overflow is not possible in practice, nothing to do */
+    }
+}
+
+/**
+ * @brief Learn the time to wait in epoll for pollsession events.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[in] timeout nc_ps_poll() timeout.
+ * @param[in] ts_timeout Absolute nc_ps_poll() timeout, if @p timeout > -1.
+ * @param[in] out_pending Whether the output queue of some session cannot be waited for by epoll.
+ * @return Timeout in msec to use for epoll_wait().
+ */
+static int
+nc_ps_epoll_wait_time(struct nc_pollsession *ps, int timeout, const struct timespec *ts_timeout, int out_pending)
+{
+    int32_t wait_ms = -1, timer_ms;
+
+    if (timeout > -1) {
+        wait_ms = nc_difftimespec_mono_cur(ts_timeout);
+        if (wait_ms < 0) {
+            wait_ms = 0;
+        }
+    }
+
+    /* wake up exactly when the next session timer expires */
+    timer_ms = nc_ps_timer_wait(ps);
+    if ((timer_ms > -1) && ((wait_ms == -1) || (wait_ms > timer_ms))) {
+        wait_ms = timer_ms;
+    }
+
+    /* retry writing the queued output */
+    if (out_pending && ((wait_ms == -1) || (wait_ms > NC_PS_EPOLL_OUT_WAIT))) {
+        wait_ms = NC_PS_EPOLL_OUT_WAIT;
+    }
+
+    return wait_ms;
+}
+
+#ifdef HAVE_IO_URING
+
+/**
+ * @brief Stop using io_uring for a pollsession after an error, its FD and UNIX socket sessions are then waited for
+ * by epoll.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ */
+static void
+nc_ps_uring_stop(struct nc_pollsession *ps)
+{
+    uint16_t i;
+
+    nc_ps_uring_disable(ps);
+
+    for (i = 0; i < ps->session_count; ++i) {
+        if (ps->sessions[i]->fd == -1) {
+            nc_ps_epoll_add(ps, ps->sessions[i]);
+        }
+    }
+}
+
+#endif /* HAVE_IO_URING */
+
+/**
+ * @brief Wait for events on a pollsession and mark the ready sessions, using io_uring if available.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[in] timeout Timeout in msec, -1 for infinite.
+ * @return Number of events received, -1 on error (epoll is then disabled for @p ps).
+ */
+static int
+nc_ps_wait(struct nc_pollsession *ps, int timeout)
+{
+#ifdef HAVE_IO_URING
+    int count, r, epoll_ready;
+
+    if (ps->uring_used) {
+        count = nc_ps_uring_wait(ps, timeout, &epoll_ready);
+        if (count == -1) {
+            nc_ps_uring_stop(ps);
+            return 0;
+        }
+
+        if (epoll_ready) {
+            /* collect the events of the other sessions */
+            r = nc_ps_epoll_wait(ps, 0);
+            if (r == -1) {
+                return -1;
+            }
+            count += r;
+        }
+        return count;
+    }
+#endif
+
+    return nc_ps_epoll_wait(ps, timeout);
+}
+
+#endif /* HAVE_EPOLL */
+
+API struct nc_pollsession *
+nc_ps_new(void)
+{
+    struct nc_pollsession *ps;
+    struct timespec ts_cur;
+
+    ps = calloc(1, sizeof(struct nc_pollsession));
+    if (!ps) {
+        ERRMEM;
+        return NULL;
+    }
+    pthread_cond_init(&ps->cond, NULL);
+    pthread_mutex_init(&ps->lock, NULL);
+    nc_gettimespec_mono_add(&ts_cur, 0);
+    ps->wheel.now = ts_cur.tv_sec;
+#ifdef HAVE_EPOLL
+    nc_ps_epoll_init(ps);
+#endif
+
+    return ps;
+}
+
+API void
+nc_ps_free(struct nc_pollsession *ps)
+{
+    uint16_t i;
+
+    if (!ps) {
+        return;
+    }
+
+    if (ps->queue_len) {
+        ERR(NULL, "FATAL: Freeing a pollsession structure that is currently being worked with!");
+    }
+
+#ifdef HAVE_IO_URING
+    /* the requests reference the sessions */
+    nc_ps_uring_disable(ps);
+#endif
+
+    for (i = 0; i < ps->session_count; i++) {
+        free(ps->sessions[i]);
+    }
+
+    free(ps->sessions);
+    pthread_mutex_destroy(&ps->lock);
+    pthread_cond_destroy(&ps->cond);
+#ifdef HAVE_EPOLL
+    nc_ps_epoll_disable(ps);
+    if (ps->wakefd > -1) {
+        close(ps->wakefd);
+    }
+#endif
+
+    free(ps);
+}
+
+API int
+nc_ps_add_session(struct nc_pollsession *ps, struct nc_session *session)
+{
+    uint8_t q_id;
+
+    if (!ps) {
+        ERRARG("ps");
+        return -1;
+    } else if (!session) {
+        ERRARG("session");
+        return -1;
+    }
+
+    /* LOCK */
+    if (nc_ps_lock(ps, &q_id, __func__)) {
+        return -1;
+    }
+
+    ++ps->session_count;
+    ps->sessions = nc_realloc(ps->sessions, ps->session_count * sizeof *ps->sessions);
+    if (!ps->sessions) {
+        ERRMEM;
+        /* UNLOCK */
+        nc_ps_unlock(ps, q_id, __func__);
+        return -1;
+    }
+    ps->sessions[ps->session_count - 1] = calloc(1, sizeof **ps->sessions);
+    if (!ps->sessions[ps->session_count - 1]) {
+        ERRMEM;
+        --ps->session_count;
+        /* UNLOCK */
+        nc_ps_unlock(ps, q_id, __func__);
+        return -1;
+    }
+    ps->sessions[ps->session_count - 1]->session = session;
+    ps->sessions[ps->session_count - 1]->state = NC_PS_STATE_NONE;
+#ifdef HAVE_EPOLL
+    nc_ps_epoll_add(ps, ps->sessions[ps->session_count - 1]);
+#endif
+
+    /* UNLOCK */
+    return nc_ps_unlock(ps, q_id, __func__);
+}
+
+static int
+_nc_ps_del_session(struct nc_pollsession *ps, struct nc_session *session, int index)
+{
+    uint16_t i;
+
+    if (index >= 0) {
+        i = (uint16_t)index;
+        goto remove;
+    }
+    for (i = 0; i < ps->session_count; ++i) {
+        if (ps->sessions[i]->session == session) {
+remove:
+#ifdef HAVE_IO_URING
+            if (nc_ps_uring_cancel(ps, ps->sessions[i])) {
+                nc_ps_uring_stop(ps);
+            }
+#endif
+#ifdef HAVE_EPOLL
+            nc_ps_epoll_del(ps, ps->sessions[i]);
+#endif
+            nc_ps_timer_set(ps, ps->sessions[i], 0);
+            --ps->session_count;
+            if (i <= ps->session_count) {
+                free(ps->sessions[i]);
+                ps->sessions[i] = ps->sessions[ps->session_count];
+            }
+            if (!ps->session_count) {
+                free(ps->sessions);
+                ps->sessions = NULL;
+            }
+            ps->last_event_session = 0;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+API int
+nc_ps_del_session(struct nc_pollsession *ps, struct nc_session *session)
+{
+    uint8_t q_id;
+    int ret, ret2;
+
+    if (!ps) {
+        ERRARG("ps");
+        return -1;
+    } else if (!session) {
+        ERRARG("session");
+        return -1;
+    }
+
+    /* LOCK */
+    if (nc_ps_lock(ps, &q_id, __func__)) {
+        return -1;
+    }
+
+    ret = _nc_ps_del_session(ps, session, -1);
+
+    /* UNLOCK */
+    ret2 = nc_ps_unlock(ps, q_id, __func__);
+
+    return ret || ret2 ? -1 : 0;
+}
+
+API struct nc_session *
+nc_ps_get_session(const struct nc_pollsession *ps, uint16_t idx)
+{
+    uint8_t q_id;
+    struct nc_session *ret = NULL;
+
+    if (!ps) {
+        ERRARG("ps");
+        return NULL;
+    }
+
+    /* LOCK */
+    if (nc_ps_lock((struct nc_pollsession *)ps, &q_id, __func__)) {
+        return NULL;
+    }
+
+    if (idx < ps->session_count) {
+        ret = ps->sessions[idx]->session;
+    }
+
+    /* UNLOCK */
+    nc_ps_unlock((struct nc_pollsession *)ps, q_id, __func__);
+
+    return ret;
+}
+
+API struct nc_session *
+nc_ps_find_session(const struct nc_pollsession *ps, nc_ps_session_match_cb match_cb, void *cb_data)
+{
+    uint8_t q_id;
+    uint16_t i;
+    struct nc_session *ret = NULL;
+
+    if (!ps) {
+        ERRARG("ps");
+        return NULL;
+    }
+
+    /* LOCK */
+    if (nc_ps_lock((struct nc_pollsession *)ps, &q_id, __func__)) {
+        return NULL;
+    }
+
+    for (i = 0; i < ps->session_count; ++i) {
+        if (match_cb(ps->sessions[i]->session, cb_data)) {
+            ret = ps->sessions[i]->session;
+            break;
+        }
+    }
+
+    /* UNLOCK */
+    nc_ps_unlock((struct nc_pollsession *)ps, q_id, __func__);
+
+    return ret;
+}
+
+API uint16_t
+nc_ps_session_count(struct nc_pollsession *ps)
+{
+    uint8_t q_id;
+    uint16_t session_count;
+
+    if (!ps) {
+        ERRARG("ps");
+        return 0;
+    }
+
+    /* LOCK (just for memory barrier so that we read the current value) */
+    if (nc_ps_lock((struct nc_pollsession *)ps, &q_id, __func__)) {
+        return 0;
+    }
+
+    session_count = ps->session_count;
+
+    /* UNLOCK */
+    nc_ps_unlock((struct nc_pollsession *)ps, q_id, __func__);
+
+    return session_count;
+}
+
+static NC_MSG_TYPE
+recv_rpc_check_msgid(struct nc_session *session, const struct lyd_node *envp)
+{
+    struct lyd_attr *attr;
+
+    assert(envp && !envp->schema);
+
+    /* find the message-id attribute */
+    LY_LIST_FOR(((struct lyd_node_opaq *)envp)->attr, attr) {
+        if (!strcmp(attr->name.name, "message-id")) {
+            break;
+        }
+    }
+
+    if (!attr) {
+        ERR(session, "Received an <rpc> without a message-id.");
+        return NC_MSG_REPLY_ERR_MSGID;
+    }
+
+    return NC_MSG_RPC;
+}
+
+/**
+ * @brief Name or attribute read from the envelope of an RPC, the strings point into the message.
+ */
+struct nc_rpc_peek_attr {
+    const char *prefix;     /**< prefix, NULL if there is none */
+    size_t prefix_len;
+    const char *name;       /**< local name */
+    size_t name_len;
+    const char *value;      /**< attribute value, not used for element names */
+    size_t value_len;
+};
+
+/**
+ * @brief Start tag read from the envelope of an RPC.
+ */
+struct nc_rpc_peek_tag {
+    struct nc_rpc_peek_attr name;                       /**< element name */
+    struct nc_rpc_peek_attr attrs[NC_RPC_ENVELOPE_ATTR_MAX]; /**< attributes including namespace declarations */
+    uint8_t attr_count;
+    int empty;                                          /**< whether the element is empty */
+};
+
+/**
+ * @brief Skip any whitespace, XML declaration, processing instructions and comments.
+ *
+ * @param[in] str String to read.
+ * @return Start of the next element, NULL if there is none or there is anything else.
+ */
+static const char *
+recv_rpc_peek_misc(const char *str)
+{
+    while (1) {
+        while (isspace(*str)) {
+            ++str;
+        }
+
+        if (!strncmp(str, "<?", 2)) {
+            if (!(str = strstr(str + 2, "?>"))) {
+                return NULL;
+            }
+            str += 2;
+        } else if (!strncmp(str, "<!--", 4)) {
+            if (!(str = strstr(str + 4, "-->"))) {
+                return NULL;
+            }
+            str += 3;
+        } else {
+            break;
+        }
+    }
+
+    if ((str[0] != '<') || (str[1] == '!') || (str[1] == '/')) {
+        return NULL;
+    }
+    return str;
+}
+
+/**
+ * @brief Read a qualified name.
+ *
+ * @param[in] str String to read.
+ * @param[out] qname Read name.
+ * @return End of the name, NULL if there is no valid name.
+ */
+static const char *
+recv_rpc_peek_qname(const char *str, struct nc_rpc_peek_attr *qname)
+{
+    const char *start = str;
+
+    qname->prefix = NULL;
+    qname->prefix_len = 0;
+    while (*str && !isspace(*str) && !strchr("=/>:<\"'&", *str)) {
+        ++str;
+    }
+    if (*str == ':') {
+        qname->prefix = start;
+        qname->prefix_len = str - start;
+
+        start = ++str;
+        while (*str && !isspace(*str) && !strchr("=/>:<\"'&", *str)) {
+            ++str;
+        }
+    }
+
+    if ((str == start) || (qname->prefix && !qname->prefix_len)) {
+        return NULL;
+    }
+    qname->name = start;
+    qname->name_len = str - start;
+
+    return str;
+}
+
+/**
+ * @brief Read a start tag. Attribute values with any references are not supported.
+ *
+ * @param[in] str Start of the tag.
+ * @param[out] tag Read tag.
+ * @return End of the tag, NULL if it could not be read.
+ */
+static const char *
+recv_rpc_peek_tag(const char *str, struct nc_rpc_peek_tag *tag)
+{
+    struct nc_rpc_peek_attr *attr;
+    char quot;
+
+    assert(*str == '<');
+
+    if (!(str = recv_rpc_peek_qname(str + 1, &tag->name))) {
+        return NULL;
+    }
+
+    tag->attr_count = 0;
+    while (isspace(*str)) {
+        while (isspace(*str)) {
+            ++str;
+        }
+        if ((*str == '>') || (*str == '/')) {
+            break;
+        }
+
+        if (tag->attr_count == NC_RPC_ENVELOPE_ATTR_MAX) {
+            return NULL;
+        }
+        attr = &tag->attrs[tag->attr_count++];
+
+        if (!(str = recv_rpc_peek_qname(str, attr))) {
+            return NULL;
+        }
+        while (isspace(*str)) {
+            ++str;
+        }
+        if (*str != '=') {
+            return NULL;
+        }
+        ++str;
+        while (isspace(*str)) {
+            ++str;
+        }
+        if ((*str != '\"') && (*str != '\'')) {
+            return NULL;
+        }
+
+        quot = *str;
+        attr->value = ++str;
+        while (*str != quot) {
+            if (!*str || (*str == '&') || (*str == '<')) {
+                return NULL;
+            }
+            ++str;
+        }
+        attr->value_len = str - attr->value;
+        ++str;
+    }
+
+    if (*str == '>') {
+        tag->empty = 0;
+        return str + 1;
+    } else if (!strncmp(str, "/>", 2)) {
+        tag->empty = 1;
+        return str + 2;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Learn the namespace of a prefix from the namespace declarations of the element and its parents.
+ *
+ * @param[in] tags Tags of the element and all its parents, the element is the last one.
+ * @param[in] tag_count Count of @p tags.
+ * @param[in] qname Name with the prefix to resolve.
+ * @param[out] ns_len Length of the namespace.
+ * @return Namespace of the prefix, NULL if it is not declared.
+ */
+static const char *
+recv_rpc_peek_ns(const struct nc_rpc_peek_tag *tags, int tag_count, const struct nc_rpc_peek_attr *qname, size_t *ns_len)
+{
+    const struct nc_rpc_peek_attr *attr;
+    int i, j;
+
+    for (i = tag_count - 1; i > -1; --i) {
+        for (j = 0; j < tags[i].attr_count; ++j) {
+            attr = &tags[i].attrs[j];
+            if (qname->prefix) {
+                /* xmlns:<prefix> */
+                if (!attr->prefix || (attr->prefix_len != 5) || strncmp(attr->prefix, "xmlns", 5) ||
+                        (attr->name_len != qname->prefix_len) || strncmp(attr->name, qname->prefix, qname->prefix_len)) {
+                    continue;
+                }
+            } else {
+                /* xmlns */
+                if (attr->prefix || (attr->name_len != 5) || strncmp(attr->name, "xmlns", 5)) {
+                    continue;
+                }
+            }
+
+            if (!attr->value_len) {
+                /* no namespace */
+                return NULL;
+            }
+            *ns_len = attr->value_len;
+            return attr->value;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Check whether an attribute is a namespace declaration.
+ *
+ * @param[in] attr Attribute to check.
+ * @return Whether it is a namespace declaration.
+ */
+static int
+recv_rpc_peek_is_xmlns(const struct nc_rpc_peek_attr *attr)
+{
+    if (attr->prefix) {
+        return (attr->prefix_len == 5) && !strncmp(attr->prefix, "xmlns", 5);
+    }
+    return (attr->name_len == 5) && !strncmp(attr->name, "xmlns", 5);
+}
+
+/**
+ * @brief Read the envelope of a received RPC and the name of its operation without parsing it.
+ *
+ * @param[in] session Session the RPC was received on.
+ * @param[in] msg Received message.
+ * @param[out] envp Opaque \<rpc\> envelope with all its attributes.
+ * @param[out] msgid Message-id of the RPC, points into @p envp.
+ * @param[out] module_ns Namespace of the operation element, of the top-level data node for actions.
+ * @param[out] name Name of the operation element, of the top-level data node for actions.
+ * @return 0 on success;
+ * @return 1 if the envelope could not be read;
+ * @return -1 on error.
+ */
+static int
+recv_rpc_peek_envelope(struct nc_session *session, struct ly_in *msg, struct lyd_node **envp, const char **msgid,
+        char **module_ns, char **name)
+{
+    struct nc_rpc_peek_tag tags[3];
+    struct nc_rpc_peek_attr *attr;
+    struct lyd_attr *a;
+    const char *str, *ns;
+    char *prefix = NULL, *aname = NULL, *aval = NULL, *ans = NULL;
+    size_t ns_len;
+    int i, op_tag = 1, rc = 1;
+
+    *envp = NULL;
+    *msgid = NULL;
+    *module_ns = NULL;
+    *name = NULL;
+
+    /* <rpc> */
+    if (!(str = recv_rpc_peek_misc(ly_in_memory(msg, NULL))) || !(str = recv_rpc_peek_tag(str, &tags[0])) ||
+            tags[0].empty || (tags[0].name.name_len != 3) || strncmp(tags[0].name.name, "rpc", 3)) {
+        return 1;
+    }
+    if (!(ns = recv_rpc_peek_ns(tags, 1, &tags[0].name, &ns_len)) || (ns_len != strlen(NC_NS_BASE)) ||
+            strncmp(ns, NC_NS_BASE, ns_len)) {
+        return 1;
+    }
+
+    /* operation */
+    if (!(str = recv_rpc_peek_misc(str)) || !(str = recv_rpc_peek_tag(str, &tags[1]))) {
+        return 1;
+    }
+    if (!(ns = recv_rpc_peek_ns(tags, 2, &tags[1].name, &ns_len))) {
+        return 1;
+    }
+    if ((ns_len == strlen(NC_NS_YANG)) && !strncmp(ns, NC_NS_YANG, ns_len) && (tags[1].name.name_len == 6) &&
+            !strncmp(tags[1].name.name, "action", 6)) {
+        /* action, its top-level data node */
+        if (tags[1].empty || !(str = recv_rpc_peek_misc(str)) || !recv_rpc_peek_tag(str, &tags[2])) {
+            return 1;
+        }
+        if (!(ns = recv_rpc_peek_ns(tags, 3, &tags[2].name, &ns_len))) {
+            return 1;
+        }
+        op_tag = 2;
+    }
+
+    /* opaque envelope with the same attributes the parsed one would have */
+    if (tags[0].name.prefix && !(prefix = strndup(tags[0].name.prefix, tags[0].name.prefix_len))) {
+        ERRMEM;
+        return -1;
+    }
+    if (lyd_new_opaq2(NULL, session->ctx, "rpc", NULL, prefix, NC_NS_BASE, envp)) {
+        rc = -1;
+        goto cleanup;
+    }
+    for (i = 0; i < tags[0].attr_count; ++i) {
+        attr = &tags[0].attrs[i];
+        if (recv_rpc_peek_is_xmlns(attr)) {
+            continue;
+        }
+
+        free(aname);
+        free(aval);
+        free(ans);
+        aname = aval = ans = NULL;
+        if (attr->prefix) {
+            if (!(str = recv_rpc_peek_ns(tags, 1, attr, &ns_len))) {
+                goto cleanup;
+            }
+            if (!(ans = strndup(str, ns_len)) || (asprintf(&aname, "%.*s:%.*s", (int)attr->prefix_len, attr->prefix,
+                    (int)attr->name_len, attr->name) == -1)) {
+                aname = NULL;
+                ERRMEM;
+                rc = -1;
+                goto cleanup;
+            }
+        } else if (!(aname = strndup(attr->name, attr->name_len))) {
+            ERRMEM;
+            rc = -1;
+            goto cleanup;
+        }
+        if (!(aval = strndup(attr->value, attr->value_len))) {
+            ERRMEM;
+            rc = -1;
+            goto cleanup;
+        }
+
+        if (lyd_new_attr2(*envp, ans, aname, aval, &a)) {
+            rc = -1;
+            goto cleanup;
+        }
+        if (!attr->prefix && !strcmp(aname, "message-id")) {
+            *msgid = a->value;
+        }
+    }
+    if (!*msgid) {
+        /* reported when parsing the RPC */
+        goto cleanup;
+    }
+
+    *module_ns = strndup(ns, ns_len);
+    *name = strndup(tags[op_tag].name.name, tags[op_tag].name.name_len);
+    if (!*module_ns || !*name) {
+        ERRMEM;
+        rc = -1;
+        goto cleanup;
+    }
+    rc = 0;
+
+cleanup:
+    free(prefix);
+    free(aname);
+    free(aval);
+    free(ans);
+    if (rc) {
+        lyd_free_tree(*envp);
+        *envp = NULL;
+        *msgid = NULL;
+        free(*module_ns);
+        *module_ns = NULL;
+        free(*name);
+        *name = NULL;
+    }
+    return rc;
+}
+
+/* should be called holding the session RPC lock! IO lock will be acquired as needed
+ * returns: NC_PSPOLL_ERROR,
+ *          NC_PSPOLL_TIMEOUT,
+ *          NC_PSPOLL_BAD_RPC,
+ *          NC_PSPOLL_RPC (rpc NULL if it was already replied to, possibly with NC_PSPOLL_REPLY_ERROR
+ *                         or NC_PSPOLL_ERROR)
+ */
+static int
+nc_server_recv_rpc_io(struct nc_session *session, int io_timeout, struct nc_server_rpc **rpc)
+{
+    struct ly_in *msg;
+    struct nc_server_reply *reply = NULL;
+    struct lyd_node *e, *top;
+    struct lyd_attr *attr;
+    struct nc_rpc_trace *trace;
+    const struct nc_server_rpc_clb *envelope;
+    const char *msgid;
+    char *module_ns, *name;
+    uint64_t usec;
+    int r, ret, peeked = 0, replied = 0;
+    LY_ERR lyrc;
+
+    if (!session) {
+        ERRARG("session");
+        return NC_PSPOLL_ERROR;
+    } else if (!rpc) {
+        ERRARG("rpc");
+        return NC_PSPOLL_ERROR;
+    } else if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_SERVER)) {
+        ERR(session, "Invalid session to receive RPCs.");
+        return NC_PSPOLL_ERROR;
+    }
+
+    *rpc = NULL;
+    trace = server_opts.rpc_latency_enabled ? session->opts.server.trace : NULL;
+
+    /* get a message */
+    usec = nc_rpc_stage_begin(session, NULL, NC_RPC_STAGE_READ);
+    r = nc_read_msg_buf_io(session, io_timeout, &msg);
+    usec = nc_rpc_stage_end(session, NULL, NC_RPC_STAGE_READ, usec);
+    if (trace) {
+        trace->stage_usec[NC_RPC_STAGE_READ] = usec;
+    }
+    if (r == -2) {
+        /* malformed message */
+        ret = NC_PSPOLL_BAD_RPC;
+        reply = nc_server_reply_err(nc_err(session->ctx, NC_ERR_MALFORMED_MSG));
+        goto cleanup;
+    }
+    if (r == -1) {
+        return NC_PSPOLL_ERROR;
+    } else if (!r) {
+        return NC_PSPOLL_TIMEOUT;
+    }
+
+    *rpc = calloc(1, sizeof **rpc);
+    if (!*rpc) {
+        ERRMEM;
+        ret = NC_PSPOLL_BAD_RPC;
+        goto cleanup;
+    }
+
+    envelope = nc_server_rpc_clb_get(&server_opts.rpc_envelope);
+    if (envelope) {
+        /* read only the envelope and let the callback decide before parsing the RPC */
+        r = recv_rpc_peek_envelope(session, msg, &(*rpc)->envp, &msgid, &module_ns, &name);
+        if (!r) {
+            reply = envelope->clb.envelope(session, msgid, module_ns, name, envelope->user_data);
+        }
+        nc_server_rpc_clb_release();
+
+        if (r == -1) {
+            ret = NC_PSPOLL_BAD_RPC;
+            goto cleanup;
+        } else if (!r) {
+            peeked = 1;
+            free(module_ns);
+            free(name);
+            if (reply) {
+                ret = NC_PSPOLL_RPC;
+                goto cleanup;
+            }
+            lyd_free_tree((*rpc)->envp);
+            (*rpc)->envp = NULL;
+        }
+    }
+
+    /* parse the RPC */
+    usec = nc_rpc_stage_begin(session, NULL, NC_RPC_STAGE_PARSE);
+    lyrc = lyd_parse_op(session->ctx, NULL, msg, LYD_XML, LYD_TYPE_RPC_NETCONF, &(*rpc)->envp, &(*rpc)->rpc);
+    usec = nc_rpc_stage_end(session, lyrc ? NULL : (*rpc)->rpc, NC_RPC_STAGE_PARSE, usec);
+    if (trace) {
+        trace->stage_usec[NC_RPC_STAGE_PARSE] = usec;
+    }
+    if (!lyrc) {
+        /* check message-id */
+        if (recv_rpc_check_msgid(session, (*rpc)->envp) == NC_MSG_RPC) {
+            /* valid RPC */
+            ret = NC_PSPOLL_RPC;
+
+            if (envelope && !peeked) {
+                /* the envelope could not be read before, decide now */
+                LY_LIST_FOR(((struct lyd_node_opaq *)(*rpc)->envp)->attr, attr) {
+                    if (!strcmp(attr->name.name, "message-id")) {
+                        break;
+                    }
+                }
+
+                /* the top-level data node for actions */
+                for (top = (*rpc)->rpc; lyd_parent(top) && lyd_parent(top)->schema; top = lyd_parent(top)) {}
+                reply = envelope->clb.envelope(session, attr->value, top->schema->module->ns, top->schema->name,
+                        envelope->user_data);
+            }
+        } else {
+            /* no message-id */
+            ret = NC_PSPOLL_BAD_RPC;
+            reply = nc_server_reply_err(nc_err(session->ctx, NC_ERR_MISSING_ATTR, NC_ERR_TYPE_RPC, "message-id", "rpc"));
+        }
+    } else {
+        /* bad RPC received */
+        ret = NC_PSPOLL_BAD_RPC;
+
+        if ((*rpc)->envp) {
+            /* at least the envelopes were parsed */
+            e = nc_err(session->ctx, NC_ERR_OP_FAILED, NC_ERR_TYPE_APP);
+            nc_err_set_msg(e, ly_errmsg(session->ctx), "en");
+            reply = nc_server_reply_err(e);
+        } else if (session->version == NC_VERSION_11) {
+            /* completely malformed message, NETCONF version 1.1 defines sending error reply from
+             * the server (RFC 6241 sec. 3) */
+            reply = nc_server_reply_err(nc_err(session->ctx, NC_ERR_MALFORMED_MSG));
+        }
+    }
+
+cleanup:
+    if (ret == NC_PSPOLL_RPC) {
+        NC_SERVER_STATS_INC(session, in_rpcs);
+    } else {
+        NC_SERVER_STATS_INC(session, in_bad_rpcs);
+    }
+
+    if (reply) {
+        /* send error reply */
+        r = nc_write_msg_io(session, io_timeout, NC_MSG_REPLY, *rpc ? (*rpc)->envp : NULL, reply);
+        if (reply->type == NC_RPL_ERROR) {
+            if (ret == NC_PSPOLL_RPC) {
+                ret |= NC_PSPOLL_REPLY_ERROR;
+            }
+            if (r == NC_MSG_REPLY) {
+                NC_SERVER_STATS_INC(session, out_rpc_errors);
+            }
+        }
+        nc_server_reply_free(reply);
+        replied = 1;
+        if (r != NC_MSG_REPLY) {
+            ERR(session, "Failed to write reply (%s), terminating session.", nc_msgtype2str[r]);
+            if (session->status != NC_STATUS_INVALID) {
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_OTHER;
+            }
+            if (ret & NC_PSPOLL_RPC) {
+                ret |= NC_PSPOLL_ERROR;
+            }
+        }
+    }
+
+    nc_read_msg_free(session, msg);
+    if ((ret != NC_PSPOLL_RPC) || replied) {
+        nc_server_rpc_free(*rpc);
+        *rpc = NULL;
+    }
+    return ret;
+}
+
+API void
+nc_set_global_rpc_clb(nc_rpc_clb clb)
+{
+    global_rpc_clb = clb;
+}
+
+API NC_MSG_TYPE
+nc_server_notif_send(struct nc_session *session, struct nc_server_notif *notif, int timeout)
+{
+    NC_MSG_TYPE ret;
+
+    /* check parameters */
+    if (!session || (session->side != NC_SERVER) || !nc_session_get_notif_status(session)) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
+    } else if (!notif || !notif->ntf || !notif->eventtime) {
+        ERRARG("notif");
+        return NC_MSG_ERROR;
+    }
+
+    /* we do not need RPC lock for this, IO lock will be acquired properly */
+    ret = nc_write_msg_io(session, timeout, NC_MSG_NOTIF, notif);
+    if (ret == NC_MSG_NOTIF) {
+        NC_SERVER_STATS_INC(session, out_notifications);
+    } else {
+        ERR(session, "Failed to write notification (%s).", nc_msgtype2str[ret]);
+    }
+
+    return ret;
+}
+
+API int
+nc_server_notif_broadcast(struct nc_session **sessions, uint32_t session_count, struct nc_server_notif *notif,
+        int timeout)
+{
+    char *data = NULL, *buf;
+    uint32_t i;
+    NC_MSG_TYPE r;
+    int len, ret = 0;
+
+    /* check parameters */
+    if (!sessions && session_count) {
+        ERRARG("sessions");
+        return -1;
+    } else if (!notif || !notif->ntf || !notif->eventtime) {
+        ERRARG("notif");
+        return -1;
+    }
+
+    /* print the notification only once */
+    if (lyd_print_mem(&data, notif->ntf, LYD_XML, LYD_PRINT_SHRINK)) {
+        return -1;
+    }
+    len = asprintf(&buf, "<notification xmlns=\"" NC_NS_NOTIF "\"><eventTime>%s</eventTime>%s</notification>",
+            notif->eventtime, data ? data : "");
+    free(data);
+    if (len == -1) {
+        ERRMEM;
+        return -1;
+    }
+
+    for (i = 0; i < session_count; ++i) {
+        if (!sessions[i] || (sessions[i]->side != NC_SERVER) || !nc_session_get_notif_status(sessions[i])) {
+            continue;
+        }
+
+        /* we do not need RPC lock for this, IO lock will be acquired properly */
+        r = nc_write_msg_buf_io(sessions[i], timeout, NC_MSG_NOTIF, buf, len);
+        if (r == NC_MSG_NOTIF) {
+            NC_SERVER_STATS_INC(sessions[i], out_notifications);
+            ++ret;
+        } else {
+            ERR(sessions[i], "Failed to write notification (%s).", nc_msgtype2str[r]);
+        }
+    }
+
+    free(buf);
+    return ret;
+}
+
+/* must be called holding the session RPC lock! IO lock will be acquired as needed
+ * returns: NC_PSPOLL_ERROR,
+ *          NC_PSPOLL_ERROR | NC_PSPOLL_REPLY_ERROR,
+ *          NC_PSPOLL_REPLY_ERROR,
+ *          0
+ */
+static int
+nc_server_send_reply_io(struct nc_session *session, int io_timeout, const struct nc_server_rpc *rpc)
+{
+    nc_rpc_clb clb;
+    struct nc_server_reply *reply;
+    const struct lysc_node *rpc_act = NULL;
+    struct lyd_node *elem;
+    struct nc_rpc_trace *trace;
+    uint64_t usec;
+    int ret = 0;
+    NC_MSG_TYPE r;
+
+    if (!rpc) {
+        ERRINT;
+        return NC_PSPOLL_ERROR;
+    }
+
+    trace = server_opts.rpc_latency_enabled ? session->opts.server.trace : NULL;
+
+    if (rpc->rpc->schema->nodetype == LYS_RPC) {
+        /* RPC */
+        rpc_act = rpc->rpc->schema;
+    } else {
+        /* action */
+        LYD_TREE_DFS_BEGIN(rpc->rpc, elem) {
+            if (elem->schema->nodetype == LYS_ACTION) {
+                rpc_act = elem->schema;
+                break;
+            }
+            LYD_TREE_DFS_END(rpc->rpc, elem);
+        }
+        if (!rpc_act) {
+            ERRINT;
+            return NC_PSPOLL_ERROR;
+        }
+    }
+
+    usec = nc_rpc_stage_begin(session, rpc->rpc, NC_RPC_STAGE_CALLBACK);
+    if (!rpc_act->priv) {
+        if (!global_rpc_clb) {
+            /* no callback, reply with a not-implemented error */
+            reply = nc_server_reply_err(nc_err(session->ctx, NC_ERR_OP_NOT_SUPPORTED, NC_ERR_TYPE_PROT));
+        } else {
+            reply = global_rpc_clb(rpc->rpc, session);
+        }
+    } else {
+        clb = (nc_rpc_clb)rpc_act->priv;
+        reply = clb(rpc->rpc, session);
+    }
+    usec = nc_rpc_stage_end(session, rpc->rpc, NC_RPC_STAGE_CALLBACK, usec);
+    if (trace) {
+        trace->stage_usec[NC_RPC_STAGE_CALLBACK] = usec;
+    }
+
+    if (!reply) {
+        reply = nc_server_reply_err(nc_err(session->ctx, NC_ERR_OP_FAILED, NC_ERR_TYPE_APP));
+    }
+
+    /* the reply is printed and written at once, the time spent writing is measured separately */
+    usec = nc_rpc_stage_begin(session, rpc->rpc, NC_RPC_STAGE_PRINT);
+    if (trace) {
+        trace->stage_usec[NC_RPC_STAGE_WRITE] = 0;
+    }
+    r = nc_write_msg_io(session, io_timeout, NC_MSG_REPLY, rpc->envp, reply);
+    usec = nc_rpc_stage_end(session, rpc->rpc, NC_RPC_STAGE_PRINT, usec);
+    if (trace) {
+        trace->stage_usec[NC_RPC_STAGE_PRINT] = (usec > trace->stage_usec[NC_RPC_STAGE_WRITE]) ?
+                usec - trace->stage_usec[NC_RPC_STAGE_WRITE] : 0;
+        if (r == NC_MSG_REPLY) {
+            nc_server_rpc_latency_add(rpc_act, trace);
+        }
+    }
+    if (reply->type == NC_RPL_ERROR) {
+        ret |= NC_PSPOLL_REPLY_ERROR;
+        if (r == NC_MSG_REPLY) {
+            NC_SERVER_STATS_INC(session, out_rpc_errors);
+        }
+    }
+    nc_server_reply_free(reply);
+
+    if (r != NC_MSG_REPLY) {
+        ERR(session, "Failed to write reply (%s).", nc_msgtype2str[r]);
+        ret |= NC_PSPOLL_ERROR;
+    }
+
+    /* special case if term_reason was set in callback, last reply was sent (needed for <close-session> if nothing else) */
+    if ((session->status == NC_STATUS_RUNNING) && (session->term_reason != NC_SESSION_TERM_NONE)) {
+        session->status = NC_STATUS_INVALID;
+    }
+
+    return ret;
+}
+
+/* session must be running and session RPC lock held!
+ * no_data set means the transport socket is known to have no data so it is not polled (only buffers are checked)
+ * returns: NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR, (msg filled)
+ *          NC_PSPOLL_ERROR, (msg filled)
+ *          NC_PSPOLL_TIMEOUT,
+ *          NC_PSPOLL_RPC (some application data available),
+ *          NC_PSPOLL_SSH_CHANNEL,
+ *          NC_PSPOLL_SSH_MSG
+ */
+static int
+nc_ps_poll_session_io(struct nc_session *session, int io_timeout, int no_data, char *msg)
+{
+    struct pollfd pfd;
+    int r, ret = 0;
+
+#ifdef NC_ENABLED_SSH
+    struct nc_session *new;
+#endif
+
+    /* idle timeout is checked by the pollsession timer wheel */
+    if (no_data && !session->rbuf_len && !session->obuf_len &&
+            ((session->ti_type == NC_TI_FD) || (session->ti_type == NC_TI_UNIX) || (session->ti_type == NC_TI_MEM))) {
+        /* there are no other buffers to check */
+        return NC_PSPOLL_TIMEOUT;
+    }
+
+    r = nc_session_io_lock(session, io_timeout, __func__);
+    if (r < 0) {
+        sprintf(msg, "session IO lock failed to be acquired");
+        return NC_PSPOLL_ERROR;
+    } else if (!r) {
+        return NC_PSPOLL_TIMEOUT;
+    }
+
+    if (session->obuf_len && nc_session_out_queue_flush(session, 0)) {
+        /* writing some previous messages failed */
+        sprintf(msg, "writing queued messages failed");
+        nc_session_io_unlock(session, __func__);
+        return NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
+    }
+
+    if (session->rbuf_len) {
+        /* (part of) the next message was already received */
+        nc_session_io_unlock(session, __func__);
+        return NC_PSPOLL_RPC;
+    }
+
+    if (no_data &&
+            ((session->ti_type == NC_TI_FD) || (session->ti_type == NC_TI_UNIX) || (session->ti_type == NC_TI_MEM))) {
+        /* only the queued output was to be written, the transport may even be being read by io_uring */
+        nc_session_io_unlock(session, __func__);
+        return NC_PSPOLL_TIMEOUT;
+    }
+
+    switch (session->ti_type) {
+#ifdef NC_ENABLED_SSH
+    case NC_TI_LIBSSH:
+        /* SSH LOCK, held only for the libssh calls, the other sessions on the SSH session can be polled meanwhile */
+        if (nc_session_ssh_lock(session, io_timeout, __func__) != 1) {
+            ret = NC_PSPOLL_TIMEOUT;
+            break;
+        }
+        r = ssh_channel_poll_timeout(session->ti.libssh.channel, 0, 0);
+        if (r == SSH_EOF) {
+            sprintf(msg, "SSH channel unexpected EOF");
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_DROPPED;
+            ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
+        } else if (r == SSH_ERROR) {
+            sprintf(msg, "SSH channel poll error (%s)", ssh_get_error(session->ti.libssh.session));
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_OTHER;
+            ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
+        } else if (!r) {
+            if (session->flags & NC_SESSION_SSH_NEW_MSG) {
+                /* new SSH message */
+                session->flags &= ~NC_SESSION_SSH_NEW_MSG;
+
+                /* just some SSH message unless there is a new NETCONF SSH channel */
+                ret = NC_PSPOLL_SSH_MSG;
+                if (session->ti.libssh.next) {
+                    for (new = session->ti.libssh.next; new != session; new = new->ti.libssh.next) {
+                        if ((new->status == NC_STATUS_STARTING) && new->ti.libssh.channel &&
+                                (new->flags & NC_SESSION_SSH_SUBSYS_NETCONF)) {
+                            /* new NETCONF SSH channel */
+                            ret = NC_PSPOLL_SSH_CHANNEL;
+                            break;
+                        }
+                    }
+                }
+            } else {
+                ret = NC_PSPOLL_TIMEOUT;
+            }
+        } else {
+            /* we have some application data */
+            ret = NC_PSPOLL_RPC;
+        }
+
+        /* SSH UNLOCK */
+        nc_session_ssh_unlock(session, __func__);
+        break;
+#endif
+#ifdef NC_ENABLED_TLS
+    case NC_TI_OPENSSL:
+        r = SSL_pending(session->ti.tls);
+        if (!r && no_data) {
+            /* no data pending in the SSL buffer nor on the socket */
+            ret = NC_PSPOLL_TIMEOUT;
+        } else if (!r) {
+            /* no data pending in the SSL buffer, poll fd */
+            pfd.fd = SSL_get_rfd(session->ti.tls);
+            if (pfd.fd < 0) {
+                sprintf(msg, "internal error (%s:%d)", __FILE__, __LINE__);
+                ret = NC_PSPOLL_ERROR;
+                break;
+            }
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            r = poll(&pfd, 1, 0);
+
+            if ((r < 0) && (errno != EINTR)) {
+                sprintf(msg, "poll failed (%s)", strerror(errno));
+                session->status = NC_STATUS_INVALID;
+                ret = NC_PSPOLL_ERROR;
+            } else if (r > 0) {
+                if (pfd.revents & (POLLHUP | POLLNVAL)) {
+                    sprintf(msg, "communication socket unexpectedly closed");
+                    session->status = NC_STATUS_INVALID;
+                    session->term_reason = NC_SESSION_TERM_DROPPED;
+                    ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
+                } else if (pfd.revents & POLLERR) {
+                    sprintf(msg, "communication socket error");
+                    session->status = NC_STATUS_INVALID;
+                    session->term_reason = NC_SESSION_TERM_OTHER;
+                    ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
+                } else {
+                    ret = NC_PSPOLL_RPC;
+                }
+            } else {
+                ret = NC_PSPOLL_TIMEOUT;
+            }
+        } else {
+            ret = NC_PSPOLL_RPC;
+        }
+        break;
+#endif
+    case NC_TI_FD:
+    case NC_TI_UNIX:
+        pfd.fd = (session->ti_type == NC_TI_FD) ? session->ti.fd.in : session->ti.unixsock.sock;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        r = poll(&pfd, 1, 0);
+
+        if ((r < 0) && (errno != EINTR)) {
+            sprintf(msg, "poll failed (%s)", strerror(errno));
+            session->status = NC_STATUS_INVALID;
+            ret = NC_PSPOLL_ERROR;
+        } else if (r > 0) {
+            if (pfd.revents & (POLLHUP | POLLNVAL)) {
+                sprintf(msg, "communication socket unexpectedly closed");
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_DROPPED;
+                ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
+            } else if (pfd.revents & POLLERR) {
+                sprintf(msg, "communication socket error");
+                session->status = NC_STATUS_INVALID;
+                session->term_reason = NC_SESSION_TERM_OTHER;
+                ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
+            } else {
+                ret = NC_PSPOLL_RPC;
+            }
+        } else {
+            ret = NC_PSPOLL_TIMEOUT;
+        }
+        break;
+    case NC_TI_MEM:
+        if (nc_mem_readable(session)) {
+            ret = NC_PSPOLL_RPC;
+        } else if (ATOMIC_LOAD_RELAXED(session->ti.mem.pipe->closed)) {
+            sprintf(msg, "in-memory transport unexpectedly closed");
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_DROPPED;
+            ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
+        } else {
+            ret = NC_PSPOLL_TIMEOUT;
+        }
+        break;
+    case NC_TI_NONE:
+        sprintf(msg, "internal error (%s:%d)", __FILE__, __LINE__);
+        ret = NC_PSPOLL_ERROR;
+        break;
+    }
+
+    nc_session_io_unlock(session, __func__);
+    return ret;
+}
+
+/**
+ * @brief Check whether the handshake in progress of a session can be advanced.
+ *
+ * @param[in] ps Pollsession of the session, must be locked.
+ * @param[in] ps_session Pollsession session of a starting session with a handshake.
+ * @return Whether there are new data, the last step made progress, or the stage timeout elapsed.
+ */
+static int
+nc_ps_handshake_ready(struct nc_pollsession *ps, struct nc_ps_session *ps_session)
+{
+    struct nc_session *session = ps_session->session;
+    struct nc_handshake *hs = session->opts.server.handshake;
+    struct pollfd pfd;
+
+    if (hs->pending || session->rbuf_len ||
+            (hs->has_timeout && (nc_difftimespec_mono_cur(&hs->ts_timeout) < 1))) {
+        return 1;
+    }
+#ifdef NC_ENABLED_TLS
+    if ((session->ti_type == NC_TI_OPENSSL) && SSL_pending(session->ti.tls)) {
+        return 1;
+    }
+#endif
+
+#ifdef HAVE_EPOLL
+    if ((ps->epfd > -1) && (ps_session->fd > -1)) {
+        /* the socket is waited for by epoll, which reported any new data */
+        return ps_session->ready;
+    }
+#else
+    (void)ps;
+#endif
+
+    pfd.fd = nc_session_ti_fd(session);
+    if (pfd.fd < 0) {
+        /* let the handshake fail */
+        return 1;
+    }
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    /* errors are detected by the handshake, too */
+    return poll(&pfd, 1, 0) ? 1 : 0;
+}
+
+/**
+ * @brief Free the buffers of an RPC locked session that has not received any RPC for a while.
+ *
+ * @param[in] session Session to use.
+ * @param[in] now Current monotonic time in seconds.
+ */
+static void
+nc_ps_session_buf_idle(struct nc_session *session, time_t now)
+{
+    if ((!session->rbuf && !session->wbuf && !session->obuf && !session->mbuf) ||
+            (now < session->opts.server.last_rpc + NC_SESSION_BUF_IDLE_TIMEOUT)) {
+        /* nothing to free or not idle */
+        return;
+    }
+
+    /* SESSION IO LOCK */
+    if (nc_session_io_lock(session, 0, __func__) != 1) {
+        /* being written to, try next time */
+        return;
+    }
+
+    nc_session_buf_trim(session);
+
+    /* SESSION IO UNLOCK */
+    nc_session_io_unlock(session, __func__);
+}
+
+/**
+ * @brief Handle a session of a pollsession with an expired timer.
+ *
+ * @param[in] ps Pollsession to use, must be locked.
+ * @param[in] now Current monotonic time in sec.
+ * @param[out] ps_session Pollsession session with an event.
+ * @return NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR if its idle timeout elapsed;
+ * @return NC_PSPOLL_HANDSHAKE if its handshake can be advanced, the session is left RPC locked;
+ * @return NC_PSPOLL_TIMEOUT if there is no such session.
+ */
+static int
+nc_ps_timer_poll(struct nc_pollsession *ps, time_t now, struct nc_ps_session **ps_session)
+{
+    struct nc_ps_session *cur, *next;
+    struct nc_session *session;
+    time_t deadline;
+    uint16_t i;
+    int ret = NC_PSPOLL_TIMEOUT;
+
+    if (ps->wheel.idle_timeout != server_opts.idle_timeout) {
+        /* all the idle timers are scheduled again once the sessions are visited */
+        ps->wheel.idle_timeout = server_opts.idle_timeout;
+        for (i = 0; i < ps->session_count; ++i) {
+            nc_ps_timer_set(ps, ps->sessions[i], 0);
+        }
+    }
+
+    nc_ps_timer_advance(ps, now);
+
+    for (cur = ps->wheel.expired; cur && (ret == NC_PSPOLL_TIMEOUT); cur = next) {
+        next = cur->timer_next;
+        session = cur->session;
+
+        /* SESSION RPC LOCK */
+        if (nc_session_rpc_lock(session, 0, __func__) != 1) {
+            /* being worked with, try again next time */
+            continue;
+        }
+
+        deadline = 0;
+        if (cur->state != NC_PS_STATE_NONE) {
+            /* the session will be freed */
+        } else if (session->status == NC_STATUS_RUNNING) {
+#ifdef HAVE_IO_URING
+            if ((cur->uring_op == NC_PS_URING_READ) &&
+                    (now >= session->opts.server.last_rpc + NC_SESSION_BUF_IDLE_TIMEOUT)) {
+                /* idle, stop reading into the receive buffer and only wait for the transport to become readable */
+                if (nc_ps_uring_cancel(ps, cur)) {
+                    nc_ps_uring_stop(ps);
+                } else if (!session->rbuf_len) {
+                    nc_ps_session_buf_idle(session, now);
+                    if (nc_ps_uring_arm(ps, cur, now)) {
+                        nc_ps_uring_stop(ps);
+                    }
+                }
+            }
+#endif
+            deadline = nc_ps_timer_deadline(cur);
+            if (deadline && (deadline <= now)) {
+                if (!nc_session_get_notif_status(session)) {
+                    ERR(session, "session idle timeout elapsed.");
+                    session->status = NC_STATUS_INVALID;
+                    session->term_reason = NC_SESSION_TERM_TIMEOUT;
+                    cur->state = NC_PS_STATE_INVALID;
+                    ret = NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
+                    deadline = 0;
+                } else {
+                    /* subscribed sessions do not time out, check it again later */
+                    deadline = now + server_opts.idle_timeout;
+                }
+            }
+        } else if ((session->status == NC_STATUS_STARTING) && session->opts.server.handshake) {
+            if (nc_ps_handshake_ready(ps, cur)) {
+                cur->state = NC_PS_STATE_BUSY;
+#ifdef HAVE_EPOLL
+                cur->ready = 0;
+#endif
+                ret = NC_PSPOLL_HANDSHAKE;
+            } else {
+                deadline = nc_ps_timer_deadline(cur);
+            }
+        }
+        nc_ps_timer_set(ps, cur, deadline);
+
+        if (ret != NC_PSPOLL_HANDSHAKE) {
+            /* SESSION RPC UNLOCK */
+            nc_session_rpc_unlock(session, NC_SESSION_LOCK_TIMEOUT, __func__);
+        }
+        if (ret != NC_PSPOLL_TIMEOUT) {
+            *ps_session = cur;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Start measuring the stage latencies of an RPC on a session.
+ *
+ * @param[in] session RPC locked session with an RPC to process.
+ * @param[in] lock_usec Latency of waiting for the pollsession lock.
+ */
+static void
+nc_rpc_trace_start(struct nc_session *session, uint64_t lock_usec)
+{
+    if (!session->opts.server.trace) {
+        session->opts.server.trace = malloc(sizeof *session->opts.server.trace);
+        if (!session->opts.server.trace) {
+            ERRMEM;
+            return;
+        }
+    }
+
+    memset(session->opts.server.trace, 0, sizeof *session->opts.server.trace);
+    session->opts.server.trace->stage_usec[NC_RPC_STAGE_PS_LOCK] = lock_usec;
+}
+
+/**
+ * @brief Wait for an event on any of the sessions in a pollsession.
+ *
+ * @param[in] ps Pollsession structure to use.
+ * @param[in] timeout Poll timeout in milliseconds, -1 for infinite waiting.
+ * @param[out] session Session the event concerns, if any.
+ * @param[out] ps_session Pollsession session the event concerns, if any.
+ * @param[out] now_mono Monotonic time the event was detected.
+ * @return Bitfield of NC_PSPOLL_* macros, on NC_PSPOLL_RPC the session is left RPC locked
+ * and must be passed to nc_ps_poll_rpc(), on NC_PSPOLL_HANDSHAKE to nc_ps_poll_handshake().
+ */
+static int
+nc_ps_poll_event(struct nc_pollsession *ps, int timeout, struct nc_session **session,
+        struct nc_ps_session **ps_session, time_t *now_mono)
+{
+    int ret = NC_PSPOLL_ERROR, r, no_data = 0;
+    uint8_t q_id;
+    uint16_t i, j;
+    char msg[256];
+    struct timespec ts_timeout, ts_cur;
+    struct nc_session *cur_session;
+    struct nc_ps_session *cur_ps_session;
+    uint64_t lock_usec;
+
+#ifdef HAVE_EPOLL
+    int ev_count = 0, out_pending;
+#endif
+
+    /* PS LOCK */
+    lock_usec = nc_rpc_stage_begin(NULL, NULL, NC_RPC_STAGE_PS_LOCK);
+    r = nc_ps_lock(ps, &q_id, __func__);
+    lock_usec = nc_rpc_stage_end(NULL, NULL, NC_RPC_STAGE_PS_LOCK, lock_usec);
+    if (r) {
+        return NC_PSPOLL_ERROR;
+    }
+
+    if (!ps->session_count) {
+        nc_ps_unlock(ps, q_id, __func__);
+        return NC_PSPOLL_NOSESSIONS;
+    }
+
+    /* fill timespecs */
+    nc_gettimespec_mono_add(&ts_cur, 0);
+    if (timeout > -1) {
+        nc_gettimespec_mono_add(&ts_timeout, timeout);
+    }
+
+#ifdef HAVE_EPOLL
+    /* learn which sessions have some data */
+    if (ps->epfd > -1) {
+        ev_count = nc_ps_wait(ps, 0);
+        if ((ps->epfd > -1) && ps->parked_count) {
+            nc_ps_epoll_unpark(ps);
+        }
+    }
+#endif
+
+    /* poll all the sessions one-by-one */
+    do {
+        /* sessions with expired timers first */
+        ret = nc_ps_timer_poll(ps, ts_cur.tv_sec, &cur_ps_session);
+        if (ret != NC_PSPOLL_TIMEOUT) {
+            cur_session = cur_ps_session->session;
+            i = ps->last_event_session;
+            break;
+        }
+
+        /* loop from i to j once (all sessions) */
+        if (ps->last_event_session == ps->session_count - 1) {
+            i = j = 0;
+        } else {
+            i = j = ps->last_event_session + 1;
+        }
+#ifdef HAVE_EPOLL
+        out_pending = 0;
+#endif
+        do {
+            cur_ps_session = ps->sessions[i];
+            cur_session = cur_ps_session->session;
+
+            /* SESSION RPC LOCK */
+            r = nc_session_rpc_lock(cur_session, 0, __func__);
+            if (r == -1) {
+                ret = NC_PSPOLL_ERROR;
+            } else if (r == 1) {
+                /* no one else is currently working with the session, so we can, otherwise skip it */
+                switch (cur_ps_session->state) {
+                case NC_PS_STATE_NONE:
+                    if (cur_session->status == NC_STATUS_RUNNING) {
+                        /* session is fine, work with it */
+                        cur_ps_session->state = NC_PS_STATE_BUSY;
+
+#ifdef HAVE_EPOLL
+                        no_data = (ps->epfd > -1) && !cur_ps_session->ready;
+#ifdef NC_ENABLED_SSH
+                        /* SSH sockets are shared and libssh reads data of other channels, they must be polled */
+                        no_data = no_data && (cur_session->ti_type != NC_TI_LIBSSH);
+#endif
+                        cur_ps_session->ready = 0;
+#endif
+                        if (!cur_ps_session->timer_list) {
+                            /* schedule the idle timeout */
+                            nc_ps_timer_set(ps, cur_ps_session, nc_ps_timer_deadline(cur_ps_session));
+                        }
+
+                        ret = nc_ps_poll_session_io(cur_session, NC_SESSION_LOCK_TIMEOUT, no_data, msg);
+#ifdef HAVE_EPOLL
+                        /* write the rest of the queued output once the transport is writable */
+                        out_pending |= nc_ps_epoll_out(ps, cur_ps_session);
+#endif
+                        switch (ret) {
+                        case NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR:
+                            ERR(cur_session, "%s.", msg);
+                            cur_ps_session->state = NC_PS_STATE_INVALID;
+                            break;
+                        case NC_PSPOLL_ERROR:
+                            ERR(cur_session, "%s.", msg);
+                            cur_ps_session->state = NC_PS_STATE_NONE;
+                            break;
+                        case NC_PSPOLL_TIMEOUT:
+#ifdef HAVE_IO_URING
+                            if (cur_ps_session->uring_op) {
+                                /* still waited for by io_uring */
+                                cur_ps_session->state = NC_PS_STATE_NONE;
+                                break;
+                            }
+#endif
+                            /* nothing received, the buffers are not needed while the session stays idle */
+                            nc_ps_session_buf_idle(cur_session, ts_cur.tv_sec);
+#ifdef HAVE_IO_URING
+                            if (nc_ps_uring_arm(ps, cur_ps_session, ts_cur.tv_sec)) {
+                                nc_ps_uring_stop(ps);
+                            } else if (cur_ps_session->timer_expire != nc_ps_timer_deadline(cur_ps_session)) {
+                                /* a pending read must be canceled once the session is idle */
+                                nc_ps_timer_set(ps, cur_ps_session, nc_ps_timer_deadline(cur_ps_session));
+                            }
+#endif
+                            cur_ps_session->state = NC_PS_STATE_NONE;
+                            break;
+#ifdef NC_ENABLED_SSH
+                        case NC_PSPOLL_SSH_CHANNEL:
+                        case NC_PSPOLL_SSH_MSG:
+                            cur_ps_session->state = NC_PS_STATE_NONE;
+                            break;
+#endif
+                        case NC_PSPOLL_RPC:
+                            /* let's keep the state busy, we are not done with this session */
+                            if (server_opts.rpc_latency_enabled) {
+                                nc_rpc_trace_start(cur_session, lock_usec);
+                            }
+                            break;
+                        }
+                    } else if ((cur_session->status == NC_STATUS_STARTING) && cur_session->opts.server.handshake) {
+                        if (cur_ps_session->timer_expire != nc_ps_timer_deadline(cur_ps_session)) {
+                            /* schedule the timeout of the current handshake stage */
+                            nc_ps_timer_set(ps, cur_ps_session, nc_ps_timer_deadline(cur_ps_session));
+                        }
+
+                        /* handshake in progress, keep it busy if it can be advanced */
+                        if (nc_ps_handshake_ready(ps, cur_ps_session)) {
+                            cur_ps_session->state = NC_PS_STATE_BUSY;
+                            ret = NC_PSPOLL_HANDSHAKE;
+                        } else {
+                            ret = NC_PSPOLL_TIMEOUT;
+#ifdef HAVE_IO_URING
+                            if (nc_ps_uring_arm(ps, cur_ps_session, ts_cur.tv_sec)) {
+                                nc_ps_uring_stop(ps);
+                            }
+#endif
+                        }
+#ifdef HAVE_EPOLL
+                        cur_ps_session->ready = 0;
+#endif
+                    } else {
+                        /* session is not fine, let the caller know */
+                        ret = NC_PSPOLL_SESSION_TERM;
+                        if (cur_session->term_reason != NC_SESSION_TERM_CLOSED) {
+                            ret |= NC_PSPOLL_SESSION_ERROR;
+                        }
+                        cur_ps_session->state = NC_PS_STATE_INVALID;
+                    }
+                    break;
+                case NC_PS_STATE_BUSY:
+                    /* it definitely should not be busy because we have the lock */
+                    ERRINT;
+                    ret = NC_PSPOLL_ERROR;
+                    break;
+                case NC_PS_STATE_INVALID:
+                    /* we got it locked, but it will be freed, let it be */
+                    ret = NC_PSPOLL_TIMEOUT;
+                    break;
+                }
+
+                /* keep RPC lock in these cases */
+                if ((ret != NC_PSPOLL_RPC) && (ret != NC_PSPOLL_HANDSHAKE)) {
+                    /* SESSION RPC UNLOCK */
+                    nc_session_rpc_unlock(cur_session, NC_SESSION_LOCK_TIMEOUT, __func__);
+                }
+            } else {
+                /* timeout */
+                ret = NC_PSPOLL_TIMEOUT;
+            }
+
+            /* something happened */
+            if (ret != NC_PSPOLL_TIMEOUT) {
+                break;
+            }
+
+            if (i == ps->session_count - 1) {
+                i = 0;
+            } else {
+                ++i;
+            }
+        } while (i != j);
+
+        /* no event, no session remains locked */
+        if (ret == NC_PSPOLL_TIMEOUT) {
+#ifdef HAVE_EPOLL
+            if (ps->epfd > -1) {
+                if (ev_count > 0) {
+                    /* the sessions with events are being worked with by other threads, do not busy-wait on them */
+                    nc_ps_epoll_park(ps);
+                }
+
+                /* block until there are some data on any session or a session is released */
+                ev_count = nc_ps_wait(ps, nc_ps_epoll_wait_time(ps, timeout, &ts_timeout, out_pending));
+                if ((ps->epfd > -1) && ps->parked_count) {
+                    nc_ps_epoll_unpark(ps);
+                }
+            } else
+#endif
+            {
+                usleep(NC_TIMEOUT_STEP);
+            }
+            nc_gettimespec_mono_add(&ts_cur, 0);
+
+            if ((timeout > -1) && (nc_difftimespec_mono_cur(&ts_timeout) < 1)) {
+                /* final timeout */
+                break;
+            }
+        }
+    } while (ret == NC_PSPOLL_TIMEOUT);
+
+    /* do we want to return the session? */
+    switch (ret) {
+    case NC_PSPOLL_RPC:
+    case NC_PSPOLL_HANDSHAKE:
+    case NC_PSPOLL_SESSION_TERM:
+    case NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR:
+#ifdef NC_ENABLED_SSH
+    case NC_PSPOLL_SSH_CHANNEL:
+    case NC_PSPOLL_SSH_MSG:
+#endif
+        *session = cur_session;
+        *ps_session = cur_ps_session;
+        *now_mono = ts_cur.tv_sec;
+        ps->last_event_session = i;
+        break;
+    default:
+        break;
+    }
+
+    /* PS UNLOCK */
+    nc_ps_unlock(ps, q_id, __func__);
+
+    return ret;
+}
+
+/**
+ * @brief Receive an RPC on a session with an event and send its reply.
+ *
+ * @param[in] ps Pollsession structure of the session.
+ * @param[in] ps_session RPC locked pollsession session, is unlocked.
+ * @param[in] timeout Timeout in milliseconds for the session IO.
+ * @param[in] now_mono Monotonic time the event was detected.
+ * @return Bitfield of NC_PSPOLL_* macros.
+ */
+static int
+nc_ps_poll_rpc(struct nc_pollsession *ps, struct nc_ps_session *ps_session, int timeout, time_t now_mono)
+{
+    int ret = 0, r;
+    uint16_t count = 0, batch;
+    struct nc_session *session = ps_session->session;
+    struct nc_server_rpc *rpc;
+    char msg[256];
+
+    batch = server_opts.rpc_batch ? server_opts.rpc_batch : 1;
+    if ((batch > 1) && nc_session_out_batch(session, 1)) {
+        batch = 1;
+    }
+
+    do {
+        /* we have some data available and the session is RPC locked (but not IO locked) */
+        rpc = NULL;
+        r = nc_server_recv_rpc_io(session, timeout, &rpc);
+        if (!(r & (NC_PSPOLL_ERROR | NC_PSPOLL_BAD_RPC))) {
+            session->opts.server.last_rpc = now_mono;
+
+            /* process RPC, unless it was already replied to based on its envelope */
+            if (rpc) {
+                r |= nc_server_send_reply_io(session, timeout, rpc);
+            }
+        }
+        nc_server_rpc_free(rpc);
+        ret |= r;
+
+        if ((++count == batch) || (session->status != NC_STATUS_RUNNING) || (r & NC_PSPOLL_ERROR)) {
+            break;
+        }
+
+        /* continue only with the RPCs already received */
+#ifdef NC_ENABLED_SSH
+        if (session->ti_type == NC_TI_LIBSSH) {
+            /* polling the SSH channel could consume SSH messages meant to be returned by the next poll */
+            r = session->rbuf_len ? NC_PSPOLL_RPC : NC_PSPOLL_TIMEOUT;
+            continue;
+        }
+#endif
+        r = nc_ps_poll_session_io(session, 0, 0, msg);
+        if (r & (NC_PSPOLL_ERROR | NC_PSPOLL_SESSION_ERROR)) {
+            ERR(session, "%s.", msg);
+        }
+    } while (r == NC_PSPOLL_RPC);
+
+    if ((batch > 1) && nc_session_out_batch(session, 0)) {
+        ERR(session, "Failed to write replies, terminating session.");
+        r |= NC_PSPOLL_ERROR;
+        ret |= NC_PSPOLL_ERROR;
+    }
+
+    if (session->status != NC_STATUS_RUNNING) {
+        ret |= NC_PSPOLL_SESSION_TERM;
+        if ((r & (NC_PSPOLL_ERROR | NC_PSPOLL_BAD_RPC | NC_PSPOLL_SESSION_ERROR)) ||
+                !(session->term_reason & (NC_SESSION_TERM_CLOSED | NC_SESSION_TERM_KILLED))) {
+            ret |= NC_PSPOLL_SESSION_ERROR;
+        }
+        ps_session->state = NC_PS_STATE_INVALID;
+    } else {
+        ps_session->state = NC_PS_STATE_NONE;
+    }
+
+    /* SESSION RPC UNLOCK */
+    nc_session_rpc_unlock(session, NC_SESSION_LOCK_TIMEOUT, __func__);
+
+#ifdef HAVE_EPOLL
+    /* let any waiting thread check this session again */
+    nc_ps_epoll_wake(ps);
+#else
+    (void)ps;
+#endif
+
+    return ret;
+}
+
+/**
+ * @brief Advance the handshake of a session with an event.
+ *
+ * @param[in] ps Pollsession structure of the session.
+ * @param[in] ps_session RPC locked pollsession session, is unlocked.
+ * @return Bitfield of NC_PSPOLL_* macros.
+ */
+static int
+nc_ps_poll_handshake(struct nc_pollsession *ps, struct nc_ps_session *ps_session)
+{
+    int ret = NC_PSPOLL_HANDSHAKE;
+    struct nc_session *session = ps_session->session;
+    NC_MSG_TYPE msgtype;
+
+    msgtype = nc_session_handshake(session);
+    if ((msgtype == NC_MSG_HELLO) || (msgtype == NC_MSG_NONE)) {
+        ps_session->state = NC_PS_STATE_NONE;
+    } else {
+        ret |= NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
+        ps_session->state = NC_PS_STATE_INVALID;
+    }
+
+    /* SESSION RPC UNLOCK */
+    nc_session_rpc_unlock(session, NC_SESSION_LOCK_TIMEOUT, __func__);
+
+#ifdef HAVE_EPOLL
+    /* let any waiting thread check this session again */
+    nc_ps_epoll_wake(ps);
+#else
+    (void)ps;
+#endif
+
+    return ret;
+}
+
+API int
+nc_ps_poll(struct nc_pollsession *ps, int timeout, struct nc_session **session)
+{
+    int ret;
+    time_t now_mono = 0;
+    struct nc_session *cur_session = NULL;
+    struct nc_ps_session *cur_ps_session = NULL;
+
+    if (!ps) {
+        ERRARG("ps");
+        return NC_PSPOLL_ERROR;
+    }
+
+    ret = nc_ps_poll_event(ps, timeout, &cur_session, &cur_ps_session, &now_mono);
+    if (cur_session && session) {
+        *session = cur_session;
+    }
+
+    if (ret == NC_PSPOLL_RPC) {
+        ret = nc_ps_poll_rpc(ps, cur_ps_session, timeout, now_mono);
+    } else if (ret == NC_PSPOLL_HANDSHAKE) {
+        ret = nc_ps_poll_handshake(ps, cur_ps_session);
+    }
+
+    return ret;
+}
+
+API void
+nc_ps_clear(struct nc_pollsession *ps, int all, void (*data_free)(void *))
+{
+    uint8_t q_id;
+    uint16_t i;
+    struct nc_session *session;
+
+    if (!ps) {
+        ERRARG("ps");
+        return;
+    }
+
+    /* LOCK */
+    if (nc_ps_lock(ps, &q_id, __func__)) {
+        return;
+    }
+
+    if (all) {
+#ifdef HAVE_EPOLL
+        /* the sessions may not own their file descriptors, unregister them all first */
+        for (i = 0; i < ps->session_count; i++) {
+#ifdef HAVE_IO_URING
+            if (nc_ps_uring_cancel(ps, ps->sessions[i])) {
+                /* the sessions are all removed, they need not be waited for by epoll instead */
+                nc_ps_uring_disable(ps);
+            }
+#endif
+            if ((ps->epfd > -1) && (ps->sessions[i]->fd > -1)) {
+                epoll_ctl(ps->epfd, EPOLL_CTL_DEL, ps->sessions[i]->fd, NULL);
+            }
+        }
+        ps->parked_count = 0;
+#endif
+        for (i = 0; i < ps->session_count; i++) {
+            nc_session_free(ps->sessions[i]->session, data_free);
+            free(ps->sessions[i]);
+        }
+        free(ps->sessions);
+        ps->sessions = NULL;
+        ps->session_count = 0;
+        ps->last_event_session = 0;
+        memset(ps->wheel.slots, 0, sizeof ps->wheel.slots);
+        ps->wheel.expired = NULL;
+        ps->wheel.count = 0;
+    } else {
+        for (i = 0; i < ps->session_count; ) {
+            session = ps->sessions[i]->session;
+            if ((session->status != NC_STATUS_RUNNING) &&
+                    ((session->status != NC_STATUS_STARTING) || !session->opts.server.handshake)) {
+                /* not running nor starting with a handshake in progress */
+                _nc_ps_del_session(ps, NULL, i);
+                nc_session_free(session, data_free);
+                continue;
+            }
+
+            ++i;
+        }
+    }
+
+    /* UNLOCK */
+    nc_ps_unlock(ps, q_id, __func__);
+}
+
+static void *
+nc_ps_dispatcher_io_thread(void *arg)
+{
+    struct nc_ps_dispatcher *disp = arg;
+    struct nc_ps_dispatch_event ev;
+    uint16_t idx;
+
+    while (1) {
+        memset(&ev, 0, sizeof ev);
+        ev.ret = nc_ps_poll_event(disp->ps, NC_PS_DISPATCH_TIMEOUT, &ev.session, &ev.ps_session, &ev.now_mono);
+        if (ev.ret & NC_PSPOLL_NOSESSIONS) {
+            usleep(NC_TIMEOUT_STEP);
+        }
+
+        /* LOCK */
+        pthread_mutex_lock(&disp->lock);
+
+        if (ev.session && !(ev.ret & (NC_PSPOLL_NOSESSIONS | NC_PSPOLL_TIMEOUT))) {
+            /* wait for space in the queue, the event must not be dropped (the session may be RPC locked) */
+            while (disp->queue_len == disp->queue_size) {
+                pthread_cond_wait(&disp->space_cond, &disp->lock);
+            }
+
+            idx = (disp->queue_begin + disp->queue_len) % disp->queue_size;
+            disp->queue[idx] = ev;
+            ++disp->queue_len;
+            pthread_cond_signal(&disp->event_cond);
+        }
+
+        if (disp->stop) {
+            /* UNLOCK */
+            pthread_mutex_unlock(&disp->lock);
+            break;
+        }
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&disp->lock);
+    }
+
+    return NULL;
+}
+
+static void *
+nc_ps_dispatcher_worker_thread(void *arg)
+{
+    struct nc_ps_dispatcher *disp = arg;
+    struct nc_ps_dispatch_event ev;
+
+    while (1) {
+        /* LOCK */
+        pthread_mutex_lock(&disp->lock);
+
+        while (!disp->queue_len && !disp->stop) {
+            pthread_cond_wait(&disp->event_cond, &disp->lock);
+        }
+        if (!disp->queue_len) {
+            /* stopping and all the events processed */
+            pthread_mutex_unlock(&disp->lock);
+            break;
+        }
+
+        ev = disp->queue[disp->queue_begin];
+        disp->queue_begin = (disp->queue_begin + 1) % disp->queue_size;
+        --disp->queue_len;
+        pthread_cond_signal(&disp->space_cond);
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&disp->lock);
+
+        if (ev.ret == NC_PSPOLL_RPC) {
+            /* the session was left RPC locked for us */
+            ev.ret = nc_ps_poll_rpc(disp->ps, ev.ps_session, NC_PS_DISPATCH_TIMEOUT, ev.now_mono);
+        } else if (ev.ret == NC_PSPOLL_HANDSHAKE) {
+            /* the same */
+            ev.ret = nc_ps_poll_handshake(disp->ps, ev.ps_session);
+        }
+        if (disp->event_clb) {
+            disp->event_clb(disp->ps, ev.session, ev.ret, disp->user_data);
+        }
+    }
+
+    return NULL;
+}
+
+static void
+nc_ps_dispatcher_stop(struct nc_ps_dispatcher *disp, uint16_t worker_count, int io_thread)
+{
+    uint16_t i;
+
+    /* LOCK */
+    pthread_mutex_lock(&disp->lock);
+    disp->stop = 1;
+    pthread_cond_broadcast(&disp->event_cond);
+    pthread_cond_broadcast(&disp->space_cond);
+    /* UNLOCK */
+    pthread_mutex_unlock(&disp->lock);
+
+    /* the I/O thread first so that the workers can process all its queued events */
+    if (io_thread) {
+        pthread_join(disp->io_tid, NULL);
+    }
+    for (i = 0; i < worker_count; ++i) {
+        pthread_join(disp->worker_tids[i], NULL);
+    }
+}
+
+static void
+nc_ps_dispatcher_destroy(struct nc_ps_dispatcher *disp)
+{
+    pthread_cond_destroy(&disp->space_cond);
+    pthread_cond_destroy(&disp->event_cond);
+    pthread_mutex_destroy(&disp->lock);
+    free(disp->queue);
+    free(disp->worker_tids);
+    free(disp);
+}
+
+API struct nc_ps_dispatcher *
+nc_ps_dispatcher_new(struct nc_pollsession *ps, uint16_t worker_count, nc_ps_dispatch_clb event_clb, void *user_data)
+{
+    struct nc_ps_dispatcher *disp;
+    uint16_t i;
+    int r;
+
+    if (!ps) {
+        ERRARG("ps");
+        return NULL;
+    } else if (!worker_count) {
+        ERRARG("worker_count");
+        return NULL;
+    }
+
+    disp = calloc(1, sizeof *disp);
+    if (!disp) {
+        ERRMEM;
+        return NULL;
+    }
+    disp->ps = ps;
+    disp->event_clb = event_clb;
+    disp->user_data = user_data;
+    pthread_mutex_init(&disp->lock, NULL);
+    pthread_cond_init(&disp->event_cond, NULL);
+    pthread_cond_init(&disp->space_cond, NULL);
+
+    disp->queue_size = worker_count * NC_PS_DISPATCH_QUEUE_FACTOR;
+    disp->queue = malloc(disp->queue_size * sizeof *disp->queue);
+    disp->worker_tids = malloc(worker_count * sizeof *disp->worker_tids);
+    if (!disp->queue || !disp->worker_tids) {
+        ERRMEM;
+        nc_ps_dispatcher_destroy(disp);
+        return NULL;
+    }
+
+    /* workers */
+    for (i = 0; i < worker_count; ++i) {
+        r = pthread_create(&disp->worker_tids[i], NULL, nc_ps_dispatcher_worker_thread, disp);
+        if (r) {
+            ERR(NULL, "Creating a new thread failed (%s).", strerror(r));
+            nc_ps_dispatcher_stop(disp, i, 0);
+            nc_ps_dispatcher_destroy(disp);
+            return NULL;
+        }
+    }
+    disp->worker_count = worker_count;
+
+    /* event detection */
+    r = pthread_create(&disp->io_tid, NULL, nc_ps_dispatcher_io_thread, disp);
+    if (r) {
+        ERR(NULL, "Creating a new thread failed (%s).", strerror(r));
+        nc_ps_dispatcher_stop(disp, disp->worker_count, 0);
+        nc_ps_dispatcher_destroy(disp);
+        return NULL;
+    }
+
+    return disp;
+}
+
+API void
+nc_ps_dispatcher_free(struct nc_ps_dispatcher *disp)
+{
+    if (!disp) {
+        return;
+    }
+
+    nc_ps_dispatcher_stop(disp, disp->worker_count, 1);
+    nc_ps_dispatcher_destroy(disp);
+}
+
+API struct nc_ps_group *
+nc_ps_group_new(uint16_t shard_count)
+{
+    struct nc_ps_group *group;
+    uint16_t i;
+
+    if (!shard_count) {
+        ERRARG("shard_count");
+        return NULL;
+    }
+
+    group = calloc(1, sizeof *group);
+    if (!group) {
+        ERRMEM;
+        return NULL;
+    }
+    pthread_mutex_init(&group->rebalance_lock, NULL);
+
+    group->shards = calloc(shard_count, sizeof *group->shards);
+    if (!group->shards) {
+        ERRMEM;
+        nc_ps_group_free(group);
+        return NULL;
+    }
+    group->shard_count = shard_count;
+
+    for (i = 0; i < shard_count; ++i) {
+        group->shards[i] = nc_ps_new();
+        if (!group->shards[i]) {
+            nc_ps_group_free(group);
+            return NULL;
+        }
+    }
+
+    return group;
+}
+
+API void
+nc_ps_group_free(struct nc_ps_group *group)
+{
+    uint16_t i;
+
+    if (!group) {
+        return;
+    }
+
+    for (i = 0; i < group->shard_count; ++i) {
+        nc_ps_free(group->shards[i]);
+    }
+    free(group->shards);
+    pthread_mutex_destroy(&group->rebalance_lock);
+    free(group);
+}
+
+API struct nc_pollsession *
+nc_ps_group_get_shard(const struct nc_ps_group *group, uint16_t idx)
+{
+    if (!group) {
+        ERRARG("group");
+        return NULL;
+    } else if (idx >= group->shard_count) {
+        return NULL;
+    }
+
+    return group->shards[idx];
+}
+
+API uint16_t
+nc_ps_group_shard_count(const struct nc_ps_group *group)
+{
+    if (!group) {
+        ERRARG("group");
+        return 0;
+    }
+
+    return group->shard_count;
+}
+
+/**
+ * @brief Find the most and the least loaded shards of a pollsession group, does not lock the shards.
+ *
+ * @param[in] group Pollsession group.
+ * @param[out] max Index of the shard with the most sessions, optional.
+ * @param[out] min Index of the shard with the fewest sessions, optional.
+ */
+static void
+nc_ps_group_load(const struct nc_ps_group *group, uint16_t *max, uint16_t *min)
+{
+    uint16_t i, imax = 0, imin = 0;
+
+    for (i = 1; i < group->shard_count; ++i) {
+        if (group->shards[i]->session_count > group->shards[imax]->session_count) {
+            imax = i;
+        }
+        if (group->shards[i]->session_count < group->shards[imin]->session_count) {
+            imin = i;
+        }
+    }
+
+    if (max) {
+        *max = imax;
+    }
+    if (min) {
+        *min = imin;
+    }
+}
+
+API int
+nc_ps_group_add_session(struct nc_ps_group *group, struct nc_session *session)
+{
+    uint16_t idx, min;
+
+    if (!group) {
+        ERRARG("group");
+        return -1;
+    } else if (!session) {
+        ERRARG("session");
+        return -1;
+    }
+
+    /* shard based on the session ID, unless it is much more loaded than another one */
+    idx = session->id % group->shard_count;
+    nc_ps_group_load(group, NULL, &min);
+    if (group->shards[idx]->session_count > group->shards[min]->session_count + NC_PS_GROUP_SKEW) {
+        idx = min;
+    }
+
+    return nc_ps_add_session(group->shards[idx], session);
+}
+
+API int
+nc_ps_group_del_session(struct nc_ps_group *group, struct nc_session *session)
+{
+    uint16_t idx, i, max, min;
+    int ret = -1;
+
+    if (!group) {
+        ERRARG("group");
+        return -1;
+    } else if (!session) {
+        ERRARG("session");
+        return -1;
+    }
+
+    /* most likely in its original shard, but it could have been moved */
+    idx = session->id % group->shard_count;
+    for (i = 0; i < group->shard_count; ++i) {
+        if (!nc_ps_del_session(group->shards[(idx + i) % group->shard_count], session)) {
+            ret = 0;
+            break;
+        }
+    }
+    if (ret) {
+        return ret;
+    }
+
+    nc_ps_group_load(group, &max, &min);
+    if (group->shards[max]->session_count > group->shards[min]->session_count + NC_PS_GROUP_SKEW) {
+        nc_ps_group_rebalance(group);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Move one idle session from a pollsession structure to another.
+ *
+ * @param[in] src Pollsession structure to move the session from.
+ * @param[in] dst Pollsession structure to move the session to.
+ * @return 1 if a session was moved, 0 if there is no idle session, -1 on error.
+ */
+static int
+nc_ps_group_move_session(struct nc_pollsession *src, struct nc_pollsession *dst)
+{
+    uint8_t q_id;
+    uint16_t i;
+    struct nc_session *session = NULL;
+    int ret = 0;
+
+    /* PS LOCK */
+    if (nc_ps_lock(src, &q_id, __func__)) {
+        return -1;
+    }
+
+    for (i = 0; i < src->session_count; ++i) {
+        if ((src->sessions[i]->state != NC_PS_STATE_NONE) || (src->sessions[i]->session->status != NC_STATUS_RUNNING)) {
+            continue;
+        }
+
+        /* SESSION RPC LOCK, no one can be working with the session while it is being moved */
+        if (nc_session_rpc_lock(src->sessions[i]->session, 0, __func__) == 1) {
+            session = src->sessions[i]->session;
+            _nc_ps_del_session(src, NULL, i);
+            break;
+        }
+    }
+
+    /* PS UNLOCK */
+    nc_ps_unlock(src, q_id, __func__);
+
+    if (!session) {
+        return 0;
+    }
+
+    if (!nc_ps_add_session(dst, session)) {
+        ret = 1;
+    } else if (nc_ps_add_session(src, session)) {
+        /* keep it at least in the original pollsession */
+        ERR(session, "Failed to add the session back to its pollsession.");
+        ret = -1;
+    }
+
+    /* SESSION RPC UNLOCK */
+    nc_session_rpc_unlock(session, NC_SESSION_LOCK_TIMEOUT, __func__);
+
+    return ret;
+}
+
+API int
+nc_ps_group_rebalance(struct nc_ps_group *group)
+{
+    uint16_t max, min;
+    int r, moved = 0;
+
+    if (!group) {
+        ERRARG("group");
+        return -1;
+    }
+
+    /* REBALANCE LOCK */
+    pthread_mutex_lock(&group->rebalance_lock);
+
+    while (1) {
+        nc_ps_group_load(group, &max, &min);
+        if (group->shards[max]->session_count <= group->shards[min]->session_count + 1) {
+            /* balanced */
+            break;
+        }
+
+        r = nc_ps_group_move_session(group->shards[max], group->shards[min]);
+        if (r < 0) {
+            moved = -1;
+            break;
+        } else if (!r) {
+            /* no idle session to move */
+            break;
+        }
+        ++moved;
+    }
+
+    /* REBALANCE UNLOCK */
+    pthread_mutex_unlock(&group->rebalance_lock);
+
+    return moved;
+}
+
+static int
+nc_get_uid(int sock, uid_t *uid)
+{
+    int ret;
+
+#ifdef SO_PEERCRED
+    struct ucred ucred;
+    socklen_t len;
+    len = sizeof(ucred);
+    ret = getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &ucred, &len);
+    if (!ret) {
+        *uid = ucred.uid;
+    }
+#else
+    ret = getpeereid(sock, uid, NULL);
+#endif
+
+    if (ret < 0) {
+        ERR(NULL, "Failed to get credentials from unix socket (%s).", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int
+nc_accept_unix(struct nc_session *session, int sock)
+{
+#if defined (SO_PEERCRED) || defined (HAVE_GETPEEREID)
+    struct passwd *pw, pw_buf;
+    char *username;
+    session->ti_type = NC_TI_UNIX;
+    uid_t uid = 0;
+    char *buf = NULL;
+    size_t buf_len = 0;
+
+    if (nc_get_uid(sock, &uid)) {
+        close(sock);
+        return -1;
+    }
+
+    pw = nc_getpwuid(uid, &pw_buf, &buf, &buf_len);
+    if (pw == NULL) {
+        ERR(NULL, "Failed to find username for uid=%u (%s).\n", uid, strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    username = strdup(pw->pw_name);
+    free(buf);
+    if (username == NULL) {
+        ERRMEM;
+        close(sock);
+        return -1;
+    }
+    session->username = username;
+
+    session->ti.unixsock.sock = sock;
+
+    return 1;
+#else
+    return -1;
+#endif
+}
+
+API int
+nc_server_add_endpt(const char *name, NC_TRANSPORT_IMPL ti)
+{
+    int ret = 0, batch;
+    struct nc_server_config *cfg;
+
+    if (!name) {
+        ERRARG("name");
+        return -1;
+    }
+
+    batch = nc_server_config_batch_get(&cfg);
+    if (!batch) {
+        /* BIND LOCK */
+        pthread_mutex_lock(&server_opts.bind_lock);
+
+        /* ENDPT WRITE LOCK */
+        pthread_rwlock_wrlock(&server_opts.endpt_lock);
+    }
+
+    /* check name uniqueness */
+    if (NC_ENDPT_FIND(cfg, name) > -1) {
+        ERR(NULL, "Endpoint \"%s\" already exists.", name);
+        ret = -1;
+        goto cleanup;
+    }
+
+    cfg->endpts = nc_realloc(cfg->endpts, (cfg->endpt_count + 1) * sizeof *cfg->endpts);
+    if (!cfg->endpts) {
+        ERRMEM;
+        ret = -1;
+        goto cleanup;
+    }
+    memset(&cfg->endpts[cfg->endpt_count], 0, sizeof *cfg->endpts);
+    cfg->endpts[cfg->endpt_count].name = strdup(name);
+    if (!cfg->endpts[cfg->endpt_count].name) {
+        ERRMEM;
+        ret = -1;
+        goto cleanup;
+    }
+    ++cfg->endpt_count;
+
+    cfg->endpts[cfg->endpt_count - 1].ti = ti;
+    nc_name_index_add(&cfg->endpt_index, cfg->endpts, sizeof *cfg->endpts, cfg->endpt_count);
+    cfg->endpts[cfg->endpt_count - 1].ka.idle_time = 1;
+    cfg->endpts[cfg->endpt_count - 1].ka.max_probes = 10;
+    cfg->endpts[cfg->endpt_count - 1].ka.probe_interval = 5;
+
+    cfg->binds = nc_realloc(cfg->binds, cfg->endpt_count * sizeof *cfg->binds);
+    if (!cfg->binds) {
+        ERRMEM;
+        ret = -1;
+        goto cleanup;
+    }
+
+    memset(&cfg->binds[cfg->endpt_count - 1], 0, sizeof *cfg->binds);
+    cfg->binds[cfg->endpt_count - 1].sock = -1;
+
+    switch (ti) {
+#ifdef NC_ENABLED_SSH
+    case NC_TI_LIBSSH:
+        cfg->endpts[cfg->endpt_count - 1].opts.ssh = nc_server_ssh_opts_new();
+        if (!cfg->endpts[cfg->endpt_count - 1].opts.ssh) {
+            ret = -1;
+            goto cleanup;
+        }
+        break;
+#endif
+#ifdef NC_ENABLED_TLS
+    case NC_TI_OPENSSL:
+        cfg->endpts[cfg->endpt_count - 1].opts.tls = calloc(1, sizeof(struct nc_server_tls_opts));
+        if (!cfg->endpts[cfg->endpt_count - 1].opts.tls) {
+            ERRMEM;
+            ret = -1;
+            goto cleanup;
+        }
+        break;
+#endif
+    case NC_TI_UNIX:
+        cfg->endpts[cfg->endpt_count - 1].opts.unixsock = calloc(1, sizeof(struct nc_server_unix_opts));
+        if (!cfg->endpts[cfg->endpt_count - 1].opts.unixsock) {
+            ERRMEM;
+            ret = -1;
+            goto cleanup;
+        }
+        cfg->endpts[cfg->endpt_count - 1].opts.unixsock->mode = (mode_t)-1;
+        cfg->endpts[cfg->endpt_count - 1].opts.unixsock->uid = (uid_t)-1;
+        cfg->endpts[cfg->endpt_count - 1].opts.unixsock->gid = (gid_t)-1;
+        break;
+    default:
+        ERRINT;
+        ret = -1;
+        goto cleanup;
+    }
+
+cleanup:
+    if (!batch) {
+        /* ENDPT UNLOCK */
+        pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+        /* BIND UNLOCK */
+        pthread_mutex_unlock(&server_opts.bind_lock);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Remove endpoints with their listening sockets.
+ *
+ * @param[in] cfg Configuration to modify.
+ * @param[in] name Name of the endpoint to remove, NULL for all the endpoints of @p ti.
+ * @param[in] ti Transport of the endpoints to remove, 0 with NULL @p name for all the endpoints.
+ * @return 0 on success, -1 if no endpoint was removed.
+ */
+static int
+_nc_server_del_endpt(struct nc_server_config *cfg, const char *name, NC_TRANSPORT_IMPL ti)
+{
+    uint32_t i;
+    int ret = -1;
+
+    if (!name && !ti) {
+        /* remove all endpoints */
+        for (i = 0; i < cfg->endpt_count; ++i) {
+            free(cfg->endpts[i].name);
+            switch (cfg->endpts[i].ti) {
+#ifdef NC_ENABLED_SSH
+            case NC_TI_LIBSSH:
+                nc_server_ssh_clear_opts(cfg->endpts[i].opts.ssh);
+                free(cfg->endpts[i].opts.ssh);
+                break;
+#endif
+#ifdef NC_ENABLED_TLS
+            case NC_TI_OPENSSL:
+                nc_server_tls_clear_opts(cfg->endpts[i].opts.tls);
+                free(cfg->endpts[i].opts.tls);
+                break;
+#endif
+            case NC_TI_UNIX:
+                free(cfg->endpts[i].opts.unixsock);
+                break;
+            default:
+                ERRINT;
+                /* won't get here ...*/
+                break;
+            }
+            ret = 0;
+        }
+        free(cfg->endpts);
+        cfg->endpts = NULL;
+
+        /* remove all binds */
+        for (i = 0; i < cfg->endpt_count; ++i) {
+            free(cfg->binds[i].address);
+            if (cfg->binds[i].sock > -1) {
+                close(cfg->binds[i].sock);
+            }
+        }
+        free(cfg->binds);
+        cfg->binds = NULL;
+
+        cfg->endpt_count = 0;
+
+    } else {
+        /* remove one endpoint with bind(s) or all endpoints using one transport protocol */
+        for (i = 0; i < cfg->endpt_count; ++i) {
+            if ((name && !strcmp(cfg->endpts[i].name, name)) || (!name && (cfg->endpts[i].ti == ti))) {
+                /* remove endpt */
+                free(cfg->endpts[i].name);
+                switch (cfg->endpts[i].ti) {
+#ifdef NC_ENABLED_SSH
+                case NC_TI_LIBSSH:
+                    nc_server_ssh_clear_opts(cfg->endpts[i].opts.ssh);
+                    free(cfg->endpts[i].opts.ssh);
+                    break;
+#endif
+#ifdef NC_ENABLED_TLS
+                case NC_TI_OPENSSL:
+                    nc_server_tls_clear_opts(cfg->endpts[i].opts.tls);
+                    free(cfg->endpts[i].opts.tls);
+                    break;
+#endif
+                case NC_TI_UNIX:
+                    free(cfg->endpts[i].opts.unixsock);
+                    break;
+                default:
+                    ERRINT;
+                    break;
+                }
+
+                /* remove bind(s) */
+                free(cfg->binds[i].address);
+                if (cfg->binds[i].sock > -1) {
+                    close(cfg->binds[i].sock);
+                }
+
+                /* move last endpt and bind(s) to the empty space */
+                --cfg->endpt_count;
+                if (!cfg->endpt_count) {
+                    free(cfg->binds);
+                    cfg->binds = NULL;
+                    free(cfg->endpts);
+                    cfg->endpts = NULL;
+                } else if (i < cfg->endpt_count) {
+                    memcpy(&cfg->binds[i], &cfg->binds[cfg->endpt_count], sizeof *cfg->binds);
+                    memcpy(&cfg->endpts[i], &cfg->endpts[cfg->endpt_count], sizeof *cfg->endpts);
+                }
+
+                ret = 0;
+                if (name) {
+                    break;
+                }
+            }
+        }
+    }
+
+    /* items may have been moved */
+    if (cfg->endpt_count) {
+        nc_name_index_rebuild(&cfg->endpt_index, cfg->endpts, sizeof *cfg->endpts,
+                cfg->endpt_count);
+    } else {
+        nc_name_index_clear(&cfg->endpt_index);
+    }
+
+    return ret;
+}
+
+API int
+nc_server_del_endpt(const char *name, NC_TRANSPORT_IMPL ti)
+{
+    int ret;
+    struct nc_server_config *cfg;
+
+    if (nc_server_config_batch_get(&cfg)) {
+        return _nc_server_del_endpt(cfg, name, ti);
+    }
+
+    /* BIND LOCK */
+    pthread_mutex_lock(&server_opts.bind_lock);
+
+    /* ENDPT WRITE LOCK */
+    pthread_rwlock_wrlock(&server_opts.endpt_lock);
+
+    ret = _nc_server_del_endpt(cfg, name, ti);
+
+    /* ENDPT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    /* BIND UNLOCK */
+    pthread_mutex_unlock(&server_opts.bind_lock);
+
+    return ret;
+}
+
+API int
+nc_server_endpt_count(void)
+{
+    struct nc_server_config *cfg;
+
+    nc_server_config_batch_get(&cfg);
+    return cfg->endpt_count;
+}
+
+API int
+nc_server_is_endpt(const char *name)
+{
+    int found = 0;
+    struct nc_server_config *cfg;
+
+    if (!name) {
+        return found;
+    } else if (nc_server_config_batch_get(&cfg)) {
+        /* staged configuration */
+        return (NC_ENDPT_FIND(cfg, name) > -1) ? 1 : 0;
+    }
+
+    /* ENDPT READ LOCK */
+    pthread_rwlock_rdlock(&server_opts.endpt_lock);
+
+    found = (NC_ENDPT_FIND(cfg, name) > -1) ? 1 : 0;
+
+    /* ENDPT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    return found;
+}
+
+/**
+ * @brief Create a new listening socket of an endpoint, the previous one is closed on success.
+ *
+ * BIND LOCK and ENDPT WRITE LOCK are expected to be held.
+ *
+ * @param[in] endpt Endpoint to listen on.
+ * @param[in] bind Bind of @p endpt.
+ * @param[in] address Listening address.
+ * @param[in] port Listening port, ignored for UNIX endpoints.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_server_endpt_bind(struct nc_endpt *endpt, struct nc_bind *bind, const char *address, uint16_t port)
+{
+    int sock;
+
+    if (endpt->ti == NC_TI_UNIX) {
+        sock = nc_sock_listen_unix(address, endpt->opts.unixsock);
+    } else {
+        sock = nc_sock_listen_inet(address, port, &endpt->ka, server_opts.reuseport);
+    }
+    if (sock == -1) {
+        return -1;
+    }
+
+    if (bind->sock > -1) {
+        close(bind->sock);
+    }
+    bind->sock = sock;
+
+    switch (endpt->ti) {
+    case NC_TI_UNIX:
+        VRB(NULL, "Listening on %s for UNIX connections.", address);
+        break;
+#ifdef NC_ENABLED_SSH
+    case NC_TI_LIBSSH:
+        VRB(NULL, "Listening on %s:%u for SSH connections.", address, port);
+        break;
+#endif
+#ifdef NC_ENABLED_TLS
+    case NC_TI_OPENSSL:
+        VRB(NULL, "Listening on %s:%u for TLS connections.", address, port);
+        break;
+#endif
+    default:
+        ERRINT;
+        break;
+    }
+
+    return 0;
+}
+
+int
+nc_server_endpt_set_address_port(const char *endpt_name, const char *address, uint16_t port)
+{
+    struct nc_endpt *endpt;
+    struct nc_bind *bind = NULL;
+    uint16_t i;
+    int set_addr, batch, ret = 0;
+    struct nc_server_config *cfg;
+
+    if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    } else if ((!address && !port) || (address && port)) {
+        ERRARG("address and port");
+        return -1;
+    }
+
+    if (address) {
+        set_addr = 1;
+    } else {
+        set_addr = 0;
+    }
+
+    batch = nc_server_config_batch_get(&cfg);
+    if (!batch) {
+        /* BIND LOCK */
+        pthread_mutex_lock(&server_opts.bind_lock);
+    }
+
+    /* ENDPT LOCK */
+    endpt = nc_server_endpt_lock_get(endpt_name, 0, &i);
+    if (!endpt) {
+        if (!batch) {
+            /* BIND UNLOCK */
+            pthread_mutex_unlock(&server_opts.bind_lock);
+        }
+        return -1;
+    }
+
+    bind = &cfg->binds[i];
+
+    if (set_addr) {
+        port = bind->port;
+    } else {
+        address = bind->address;
+    }
+
+    if (!set_addr && (endpt->ti == NC_TI_UNIX)) {
+        ret = -1;
+        goto cleanup;
+    }
+
+    /* we have all the information we need to create a listening socket, a staged one is created on commit */
+    if (!batch && address && (port || (endpt->ti == NC_TI_UNIX))) {
+        if (nc_server_endpt_bind(endpt, bind, address, port)) {
+            ret = -1;
+            goto cleanup;
+        }
+    } /* else we are just setting address or port */
+
+    if (set_addr) {
+        free(bind->address);
+        bind->address = strdup(address);
+    } else {
+        bind->port = port;
+    }
+
+cleanup:
+    /* ENDPT UNLOCK */
+    nc_server_endpt_unlock();
+
+    if (!batch) {
+        /* BIND UNLOCK */
+        pthread_mutex_unlock(&server_opts.bind_lock);
+    }
+
+    return ret;
+}
+
+API int
+nc_server_endpt_set_address(const char *endpt_name, const char *address)
+{
+    return nc_server_endpt_set_address_port(endpt_name, address, 0);
+}
+
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+
+API int
+nc_server_endpt_set_port(const char *endpt_name, uint16_t port)
+{
+    return nc_server_endpt_set_address_port(endpt_name, NULL, port);
+}
+
+#endif
+
+API int
+nc_server_endpt_set_perms(const char *endpt_name, mode_t mode, uid_t uid, gid_t gid)
+{
+    struct nc_endpt *endpt;
+    uint16_t i;
+    int ret = 0;
+
+    if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    } else if (mode == 0) {
+        ERRARG("mode");
+        return -1;
+    }
+
+    /* ENDPT LOCK */
+    endpt = nc_server_endpt_lock_get(endpt_name, 0, &i);
+    if (!endpt) {
+        return -1;
+    }
+
+    if (endpt->ti != NC_TI_UNIX) {
+        ret = -1;
+        goto cleanup;
+    }
+
+    endpt->opts.unixsock->mode = mode;
+    endpt->opts.unixsock->uid = uid;
+    endpt->opts.unixsock->gid = gid;
+
+cleanup:
+    /* ENDPT UNLOCK */
+    nc_server_endpt_unlock();
+
+    return ret;
+}
+
+API int
+nc_server_endpt_enable_keepalives(const char *endpt_name, int enable)
+{
+    struct nc_endpt *endpt;
+    int ret = 0;
+
+    if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    }
+
+    /* ENDPT LOCK */
+    endpt = nc_server_endpt_lock_get(endpt_name, 0, NULL);
+    if (!endpt) {
+        return -1;
+    }
+
+    endpt->ka.enabled = (enable ? 1 : 0);
+
+    /* ENDPT UNLOCK */
+    nc_server_endpt_unlock();
+
+    return ret;
+}
+
+API int
+nc_server_endpt_set_keepalives(const char *endpt_name, int idle_time, int max_probes, int probe_interval)
+{
+    struct nc_endpt *endpt;
+    int ret = 0;
+
+    if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    }
+
+    /* ENDPT LOCK */
+    endpt = nc_server_endpt_lock_get(endpt_name, 0, NULL);
+    if (!endpt) {
+        return -1;
+    }
+
+    if (idle_time > -1) {
+        endpt->ka.idle_time = idle_time;
+    }
+    if (max_probes > -1) {
+        endpt->ka.max_probes = max_probes;
+    }
+    if (probe_interval > -1) {
+        endpt->ka.probe_interval = probe_interval;
+    }
+
+    /* ENDPT UNLOCK */
+    nc_server_endpt_unlock();
+
+    return ret;
+}
+
+/**
+ * @brief Create a new server session on an accepted socket of a bind and perform the transport and NETCONF handshake.
+ *
+ * ENDPT READ LOCK is expected to be held and it is always released.
+ *
+ * @param[in] sock Accepted socket, is assigned to the session or closed.
+ * @param[in] host Client host, is assigned to the session or freed.
+ * @param[in] port Client port.
+ * @param[in] bind_idx Index of the bind (endpoint) the socket was accepted on.
+ * @param[in] ctx Context for the session.
+ * @param[out] session New session.
+ * @return NC_MSG_HELLO on success, NC_MSG_BAD_HELLO, NC_MSG_WOULDBLOCK, or NC_MSG_ERROR.
+ */
+static NC_MSG_TYPE
+nc_accept_bind_sock(int sock, char *host, uint16_t port, uint16_t bind_idx, const struct ly_ctx *ctx,
+        struct nc_session **session)
+{
+    NC_MSG_TYPE msgtype;
+    int ret;
+    struct timespec ts_cur;
+
+    *session = nc_new_session(NC_SERVER);
+    if (!(*session)) {
+        ERRMEM;
+        close(sock);
+        free(host);
+        msgtype = NC_MSG_ERROR;
+        goto cleanup;
+    }
+    (*session)->status = NC_STATUS_STARTING;
+    (*session)->ctx = (struct ly_ctx *)ctx;
+    (*session)->flags = NC_SESSION_SHAREDCTX;
+    (*session)->host = host;
+    (*session)->port = port;
+
+    /* sock gets assigned to session or closed */
+#ifdef NC_ENABLED_SSH
+    if (server_opts.config.endpts[bind_idx].ti == NC_TI_LIBSSH) {
+        (*session)->data = server_opts.config.endpts[bind_idx].opts.ssh;
+        ret = nc_accept_ssh_session(*session, sock, NC_TRANSPORT_TIMEOUT);
+        if (ret < 0) {
+            msgtype = NC_MSG_ERROR;
+            goto cleanup;
+        } else if (!ret) {
+            msgtype = NC_MSG_WOULDBLOCK;
+            goto cleanup;
+        }
+    } else
+#endif
+#ifdef NC_ENABLED_TLS
+    if (server_opts.config.endpts[bind_idx].ti == NC_TI_OPENSSL) {
+        (*session)->data = server_opts.config.endpts[bind_idx].opts.tls;
+        ret = nc_accept_tls_session(*session, sock, NC_TRANSPORT_TIMEOUT);
+        if (ret < 0) {
+            msgtype = NC_MSG_ERROR;
+            goto cleanup;
+        } else if (!ret) {
+            msgtype = NC_MSG_WOULDBLOCK;
+            goto cleanup;
+        }
+    } else
+#endif
+    if (server_opts.config.endpts[bind_idx].ti == NC_TI_UNIX) {
+        (*session)->data = server_opts.config.endpts[bind_idx].opts.unixsock;
+        ret = nc_accept_unix(*session, sock);
+        if (ret < 0) {
+            msgtype = NC_MSG_ERROR;
+            goto cleanup;
+        }
+    } else {
+        ERRINT;
+        close(sock);
+        msgtype = NC_MSG_ERROR;
+        goto cleanup;
+    }
+
+    (*session)->data = NULL;
+
+    /* ENDPT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    /* assign new SID atomically */
+    (*session)->id = ATOMIC_INC_RELAXED(server_opts.new_session_id);
+
+    /* NETCONF handshake */
+    msgtype = nc_handshake_io(*session);
+    if (msgtype != NC_MSG_HELLO) {
+        nc_session_free(*session, NULL);
+        *session = NULL;
+        return msgtype;
+    }
+
+    nc_gettimespec_mono_add(&ts_cur, 0);
+    (*session)->opts.server.last_rpc = ts_cur.tv_sec;
+    nc_gettimespec_real_add(&ts_cur, 0);
+    (*session)->opts.server.session_start = ts_cur.tv_sec;
+    (*session)->status = NC_STATUS_RUNNING;
+
+    return msgtype;
+
+cleanup:
+    /* ENDPT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    nc_session_free(*session, NULL);
+    *session = NULL;
+    return msgtype;
+}
+
+/**
+ * @brief Wait for a new connection on any of the endpoints.
+ *
+ * @param[in] timeout Timeout for a connection to arrive in msec.
+ * @param[out] host Client host.
+ * @param[out] port Client port.
+ * @param[out] bind_idx Index of the bind (endpoint) the connection was accepted on.
+ * @return Accepted socket with ENDPT READ LOCK held, 0 on timeout, -1 on error.
+ */
+static int
+nc_accept_bind_wait(int timeout, char **host, uint16_t *port, uint16_t *bind_idx)
+{
+    int ret;
+
+    *host = NULL;
+
+    /* BIND LOCK */
+    pthread_mutex_lock(&server_opts.bind_lock);
+
+    if (!server_opts.config.endpt_count) {
+        ERR(NULL, "No endpoints to accept sessions on.");
+        /* BIND UNLOCK */
+        pthread_mutex_unlock(&server_opts.bind_lock);
+        return -1;
+    }
+
+    ret = nc_sock_accept_binds(server_opts.config.binds, server_opts.config.endpt_count, &server_opts.bind_pollset,
+            timeout, host, port, bind_idx);
+    if (ret < 1) {
+        /* BIND UNLOCK */
+        pthread_mutex_unlock(&server_opts.bind_lock);
+        free(*host);
+        *host = NULL;
+        return ret;
+    }
+
+    /* switch bind_lock for endpt_lock, so that another thread can accept another session */
+    /* ENDPT READ LOCK */
+    pthread_rwlock_rdlock(&server_opts.endpt_lock);
+
+    /* BIND UNLOCK */
+    pthread_mutex_unlock(&server_opts.bind_lock);
+
+    return ret;
+}
+
+API NC_MSG_TYPE
+nc_accept(int timeout, const struct ly_ctx *ctx, struct nc_session **session)
+{
+    int ret;
+    char *host;
+    uint16_t port, bind_idx;
+
+    if (!ctx) {
+        ERRARG("ctx");
+        return NC_MSG_ERROR;
+    } else if (!session) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
+    }
+
+    /* init ctx as needed */
+    nc_server_init_ctx(ctx);
+
+    ret = nc_accept_bind_wait(timeout, &host, &port, &bind_idx);
+    if (ret < 1) {
+        return ret ? NC_MSG_ERROR : NC_MSG_WOULDBLOCK;
+    }
+
+    return nc_accept_bind_sock(ret, host, port, bind_idx, ctx, session);
+}
+
+/**
+ * @brief Start the NETCONF handshake of a session with established transport by sending the server \<hello\>.
+ *
+ * @param[in] session Starting session.
+ * @param[in] hs Handshake state of @p session.
+ * @return NC_MSG_NONE on success, NC_MSG_WOULDBLOCK or NC_MSG_ERROR on error.
+ */
+static NC_MSG_TYPE
+nc_handshake_hello_start(struct nc_session *session, struct nc_handshake *hs)
+{
+    NC_MSG_TYPE msgtype;
+
+    /* assign new SID atomically */
+    session->id = ATOMIC_INC_RELAXED(server_opts.new_session_id);
+
+    msgtype = nc_handshake_send_io(session);
+    if (msgtype != NC_MSG_HELLO) {
+        return msgtype;
+    }
+
+    hs->stage = NC_HANDSHAKE_HELLO;
+    hs->has_timeout = 1;
+    nc_gettimespec_mono_add(&hs->ts_timeout, server_opts.hello_timeout ?
+            server_opts.hello_timeout * 1000 : NC_SERVER_HELLO_TIMEOUT * 1000);
+    hs->pending = 1;
+    return NC_MSG_NONE;
+}
+
+/**
+ * @brief Perform a non-blocking step of establishing the transport of a resumable handshake.
+ *
+ * @param[in] session Starting session.
+ * @param[in] hs Handshake state of @p session.
+ * @param[in] ti_opts Transport options of the endpoint @p session is connected to.
+ * @return 1 if the transport was established, 0 if it is still in progress, -1 on error.
+ */
+static int
+nc_handshake_step_ti(struct nc_session *session, struct nc_handshake *hs, void *ti_opts)
+{
+    int r = -1;
+
+    (void)hs;
+
+    session->data = ti_opts;
+#ifdef NC_ENABLED_SSH
+    if (session->ti_type == NC_TI_LIBSSH) {
+        r = nc_accept_ssh_session_step(session, hs);
+    } else
+#endif
+#ifdef NC_ENABLED_TLS
+    if (session->ti_type == NC_TI_OPENSSL) {
+        r = nc_accept_tls_session_step(session);
+    } else
+#endif
+    {
+        ERRINT;
+    }
+    session->data = NULL;
+
+    return r;
+}
+
+/**
+ * @brief Perform a non-blocking step of a resumable handshake.
+ *
+ * @param[in] session Starting session.
+ * @param[in] hs Handshake state of @p session.
+ * @return NC_MSG_HELLO if the handshake finished, NC_MSG_NONE if it is still in progress,
+ * NC_MSG_BAD_HELLO, NC_MSG_WOULDBLOCK, or NC_MSG_ERROR on failure.
+ */
+static NC_MSG_TYPE
+nc_handshake_step(struct nc_session *session, struct nc_handshake *hs)
+{
+    NC_MSG_TYPE msgtype;
+    void *ti_opts = NULL;
+    int i, r;
+
+    hs->pending = 0;
+
+    if (hs->stage == NC_HANDSHAKE_HELLO) {
+        msgtype = nc_handshake_recv_io(session, 0);
+        return (msgtype == NC_MSG_WOULDBLOCK) ? NC_MSG_NONE : msgtype;
+    }
+
+    if (hs->ti_opts) {
+        /* Call Home endpoint options, its client is locked */
+        r = nc_handshake_step_ti(session, hs, hs->ti_opts);
+    } else {
+        /* the transport needs the current endpoint options */
+        /* ENDPT READ LOCK */
+        pthread_rwlock_rdlock(&server_opts.endpt_lock);
+
+        i = NC_ENDPT_FIND(&server_opts.config, hs->endpt_name);
+        if ((i < 0) || (server_opts.config.endpts[i].ti != session->ti_type)) {
+            ERR(session, "Endpoint \"%s\" of the starting session was removed.", hs->endpt_name);
+            /* ENDPT UNLOCK */
+            pthread_rwlock_unlock(&server_opts.endpt_lock);
+            return NC_MSG_ERROR;
+        }
+
+#ifdef NC_ENABLED_SSH
+        if (session->ti_type == NC_TI_LIBSSH) {
+            ti_opts = server_opts.config.endpts[i].opts.ssh;
+        }
+#endif
+#ifdef NC_ENABLED_TLS
+        if (session->ti_type == NC_TI_OPENSSL) {
+            ti_opts = server_opts.config.endpts[i].opts.tls;
+        }
+#endif
+        r = nc_handshake_step_ti(session, hs, ti_opts);
+
+        /* ENDPT UNLOCK */
+        pthread_rwlock_unlock(&server_opts.endpt_lock);
+    }
+
+    if (r < 0) {
+        return NC_MSG_ERROR;
+    } else if (!r) {
+        return NC_MSG_NONE;
+    }
+
+    /* transport established */
+    return nc_handshake_hello_start(session, hs);
+}
+
+/**
+ * @brief Print the error of an elapsed handshake stage timeout.
+ *
+ * @param[in] session Starting session.
+ * @param[in] hs Handshake state of @p session.
+ */
+static void
+nc_handshake_timeout_err(struct nc_session *session, const struct nc_handshake *hs)
+{
+    switch (hs->stage) {
+    case NC_HANDSHAKE_TRANSPORT:
+#ifdef NC_ENABLED_SSH
+        if (session->ti_type == NC_TI_LIBSSH) {
+            ERR(session, "SSH key exchange timeout.");
+            break;
+        }
+#endif
+        ERR(session, "SSL accept timeout.");
+        break;
+    case NC_HANDSHAKE_SSH_AUTH:
+        if (session->username) {
+            ERR(session, "User \"%s\" failed to authenticate for too long, disconnecting.", session->username);
+        } else {
+            ERR(session, "User failed to authenticate for too long, disconnecting.");
+        }
+        break;
+    case NC_HANDSHAKE_SSH_CHANNEL:
+        ERR(session, "Failed to start \"netconf\" SSH subsystem for too long, disconnecting.");
+        break;
+    case NC_HANDSHAKE_HELLO:
+        ERR(session, "Client <hello> timeout elapsed.");
+        break;
+    }
+}
+
+API NC_MSG_TYPE
+nc_session_handshake(struct nc_session *session)
+{
+    struct nc_handshake *hs;
+    NC_MSG_TYPE msgtype;
+    struct timespec ts_cur;
+
+    if (!session) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
+    } else if ((session->side != NC_SERVER) || (session->status != NC_STATUS_STARTING) ||
+            !session->opts.server.handshake) {
+        ERR(session, "Session does not have a handshake in progress.");
+        return NC_MSG_ERROR;
+    }
+    hs = session->opts.server.handshake;
+
+    /* process everything available */
+    do {
+        msgtype = nc_handshake_step(session, hs);
+    } while ((msgtype == NC_MSG_NONE) && hs->pending);
+
+    if ((msgtype == NC_MSG_NONE) && hs->has_timeout && (nc_difftimespec_mono_cur(&hs->ts_timeout) < 1)) {
+        nc_handshake_timeout_err(session, hs);
+        msgtype = NC_MSG_WOULDBLOCK;
+    }
+    if (msgtype == NC_MSG_NONE) {
+        return msgtype;
+    }
+
+    /* handshake finished */
+    free(hs->endpt_name);
+    free(hs);
+    session->opts.server.handshake = NULL;
+
+    if (msgtype != NC_MSG_HELLO) {
+        session->status = NC_STATUS_INVALID;
+        if (msgtype == NC_MSG_BAD_HELLO) {
+            session->term_reason = NC_SESSION_TERM_BADHELLO;
+        } else if (msgtype == NC_MSG_WOULDBLOCK) {
+            session->term_reason = NC_SESSION_TERM_TIMEOUT;
+        } else {
+            session->term_reason = NC_SESSION_TERM_OTHER;
+        }
+        return msgtype;
+    }
+
+    nc_gettimespec_mono_add(&ts_cur, 0);
+    session->opts.server.last_rpc = ts_cur.tv_sec;
+    nc_gettimespec_real_add(&ts_cur, 0);
+    session->opts.server.session_start = ts_cur.tv_sec;
+    session->status = NC_STATUS_RUNNING;
+
+    return msgtype;
+}
+
+API NC_MSG_TYPE
+nc_accept_nonblock(int timeout, const struct ly_ctx *ctx, struct nc_session **session)
+{
+    NC_MSG_TYPE msgtype;
+    struct nc_handshake *hs;
+    int sock, ret = -1;
+    char *host;
+    uint16_t port, bind_idx;
+
+    if (!ctx) {
+        ERRARG("ctx");
+        return NC_MSG_ERROR;
+    } else if (!session) {
+        ERRARG("session");
+        return NC_MSG_ERROR;
+    }
+
+    /* init ctx as needed */
+    nc_server_init_ctx(ctx);
+
+    sock = nc_accept_bind_wait(timeout, &host, &port, &bind_idx);
+    if (sock < 1) {
+        return sock ? NC_MSG_ERROR : NC_MSG_WOULDBLOCK;
+    }
+
+    *session = nc_new_session(NC_SERVER);
+    if (!(*session)) {
+        ERRMEM;
+        close(sock);
+        free(host);
+        goto cleanup;
+    }
+    (*session)->status = NC_STATUS_STARTING;
+    (*session)->ctx = (struct ly_ctx *)ctx;
+    (*session)->flags = NC_SESSION_SHAREDCTX;
+    (*session)->host = host;
+    (*session)->port = port;
+
+    hs = calloc(1, sizeof *hs);
+    if (hs) {
+        (*session)->opts.server.handshake = hs;
+        hs->endpt_name = strdup(server_opts.config.endpts[bind_idx].name);
+    }
+    if (!hs || !hs->endpt_name) {
+        ERRMEM;
+        close(sock);
+        goto cleanup;
+    }
+    hs->stage = NC_HANDSHAKE_TRANSPORT;
+    hs->has_timeout = 1;
+    nc_gettimespec_mono_add(&hs->ts_timeout, NC_TRANSPORT_TIMEOUT);
+    hs->pending = 1;
+
+    /* sock gets assigned to session or closed */
+#ifdef NC_ENABLED_SSH
+    if (server_opts.config.endpts[bind_idx].ti == NC_TI_LIBSSH) {
+        (*session)->data = server_opts.config.endpts[bind_idx].opts.ssh;
+        ret = nc_accept_ssh_session_start(*session, sock);
+    } else
+#endif
+#ifdef NC_ENABLED_TLS
+    if (server_opts.config.endpts[bind_idx].ti == NC_TI_OPENSSL) {
+        (*session)->data = server_opts.config.endpts[bind_idx].opts.tls;
+        ret = nc_accept_tls_session_start(*session, sock);
+    } else
+#endif
+    if (server_opts.config.endpts[bind_idx].ti == NC_TI_UNIX) {
+        (*session)->data = server_opts.config.endpts[bind_idx].opts.unixsock;
+        ret = nc_accept_unix(*session, sock);
+    } else {
+        ERRINT;
+        close(sock);
+    }
+    (*session)->data = NULL;
+
+cleanup:
+    /* ENDPT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    if (ret < 0) {
+        nc_session_free(*session, NULL);
+        *session = NULL;
+        return NC_MSG_ERROR;
+    }
+
+    if ((*session)->ti_type == NC_TI_UNIX) {
+        /* no transport handshake */
+        msgtype = nc_handshake_hello_start(*session, hs);
+        if (msgtype != NC_MSG_NONE) {
+            nc_session_free(*session, NULL);
+            *session = NULL;
+            return msgtype;
+        }
+    }
+
+    /* make all the progress possible right away */
+    msgtype = nc_session_handshake(*session);
+    if ((msgtype != NC_MSG_HELLO) && (msgtype != NC_MSG_NONE)) {
+        nc_session_free(*session, NULL);
+        *session = NULL;
+    }
+    return msgtype;
+}
+
+/**
+ * @brief Synchronize the own listening sockets of an acceptor thread with the server binds.
+ *
+ * BIND LOCK and ENDPT READ LOCK are expected to be held.
+ *
+ * @param[in] thr Acceptor thread with own binds.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_acceptor_sync_binds(struct nc_acceptor_thread *thr)
+{
+    struct nc_bind *bind, *sbind;
+    uint16_t i;
+    void *tmp;
+
+    /* close the sockets of removed endpoints */
+    for (i = server_opts.config.endpt_count; i < thr->bind_count; ++i) {
+        if (thr->binds[i].sock > -1) {
+            close(thr->binds[i].sock);
+        }
+        free(thr->binds[i].address);
+    }
+    if (thr->bind_count < server_opts.config.endpt_count) {
+        tmp = nc_realloc(thr->binds, server_opts.config.endpt_count * sizeof *thr->binds);
+        if (!tmp) {
+            ERRMEM;
+            thr->binds = NULL;
+            thr->bind_count = 0;
+            return -1;
+        }
+        thr->binds = tmp;
+        memset(thr->binds + thr->bind_count, 0,
+                (server_opts.config.endpt_count - thr->bind_count) * sizeof *thr->binds);
+        for (i = thr->bind_count; i < server_opts.config.endpt_count; ++i) {
+            thr->binds[i].sock = -1;
+        }
+    }
+    thr->bind_count = server_opts.config.endpt_count;
+
+    for (i = 0; i < thr->bind_count; ++i) {
+        bind = &thr->binds[i];
+        sbind = &server_opts.config.binds[i];
+
+        if ((server_opts.config.endpts[i].ti == NC_TI_UNIX) || (sbind->sock < 0) || !sbind->address) {
+            /* UNIX sockets cannot be shared, accepted only on the server binds */
+            if (bind->sock > -1) {
+                close(bind->sock);
+                bind->sock = -1;
+            }
+            free(bind->address);
+            bind->address = NULL;
+            continue;
+        }
+
+        if (bind->address && !strcmp(bind->address, sbind->address) && (bind->port == sbind->port)) {
+            /* no change */
+            continue;
+        }
+
+        /* (re)open the socket, on failure it is not retried until the bind changes */
+        if (bind->sock > -1) {
+            close(bind->sock);
+        }
+        free(bind->address);
+        bind->address = strdup(sbind->address);
+        if (!bind->address) {
+            ERRMEM;
+            bind->sock = -1;
+            return -1;
+        }
+        bind->port = sbind->port;
+        bind->pollin = 0;
+        bind->sock = nc_sock_listen_inet(bind->address, bind->port, &server_opts.config.endpts[i].ka, 1);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Wait for a new connection on the server binds without holding BIND LOCK.
+ *
+ * BIND LOCK is expected to be held, it is released for the wait and acquired again before returning.
+ * The sockets are closed only under BIND LOCK so at worst the wait is woken up spuriously, the connection
+ * must then be accepted by ::nc_sock_accept_binds() under the lock.
+ *
+ * @param[in] thr Acceptor thread sharing the server binds.
+ * @param[in] timeout Timeout for the wait in msec.
+ * @return 1 if a connection may be waiting, 0 on timeout, -1 on error.
+ */
+static int
+nc_acceptor_wait_binds(struct nc_acceptor_thread *thr, int timeout)
+{
+    sigset_t sigmask, origmask;
+    uint16_t i;
+    int ret;
+
+    for (i = 0; i < server_opts.config.endpt_count; ++i) {
+        if ((server_opts.config.binds[i].sock > -1) && server_opts.config.binds[i].pollin) {
+            /* leftover pollin */
+            return 1;
+        }
+    }
+
+    /* the thread's own copy of the poll set, the server one may be rebuilt meanwhile */
+    if (nc_bind_pollset_update(&thr->pollset, server_opts.config.binds, server_opts.config.endpt_count)) {
+        return -1;
+    }
+
+    /* BIND UNLOCK */
+    pthread_mutex_unlock(&server_opts.bind_lock);
+
+    sigfillset(&sigmask);
+    pthread_sigmask(SIG_SETMASK, &sigmask, &origmask);
+    ret = poll(thr->pollset.pfds, thr->pollset.count, timeout);
+    pthread_sigmask(SIG_SETMASK, &origmask, NULL);
+    if (ret == -1) {
+        ERR(NULL, "Poll failed (%s).", strerror(errno));
+    }
+
+    /* BIND LOCK */
+    pthread_mutex_lock(&server_opts.bind_lock);
+
+    return (ret > 0) ? 1 : ret;
+}
+
+/**
+ * @brief Add an accepted connection into the acceptor queue.
+ *
+ * @param[in] acc Acceptor.
+ * @param[in] conn Connection to queue, its members are spent.
+ */
+static void
+nc_acceptor_queue_conn(struct nc_acceptor *acc, struct nc_acceptor_conn *conn)
+{
+    uint16_t idx;
 
-    /* poll all the sessions one-by-one */
-    do {
-        /* loop from i to j once (all sessions) */
-        if (ps->last_event_session == ps->session_count - 1) {
-            i = j = 0;
+    /* LOCK */
+    pthread_mutex_lock(&acc->lock);
+
+    /* wait for space in the queue, the connection would otherwise have to be closed */
+    while ((acc->queue_len == acc->queue_size) && !acc->stop) {
+        pthread_cond_wait(&acc->space_cond, &acc->lock);
+    }
+    if (acc->stop) {
+        /* UNLOCK */
+        pthread_mutex_unlock(&acc->lock);
+
+        close(conn->sock);
+        free(conn->host);
+        free(conn->bind_address);
+        return;
+    }
+
+    idx = (acc->queue_begin + acc->queue_len) % acc->queue_size;
+    acc->queue[idx] = *conn;
+    ++acc->queue_len;
+    pthread_cond_signal(&acc->conn_cond);
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&acc->lock);
+}
+
+static void *
+nc_acceptor_thread(void *arg)
+{
+    struct nc_acceptor_thread *thr = arg;
+    struct nc_acceptor *acc = thr->acc;
+    struct nc_acceptor_conn conn;
+    int ret, stop, no_endpts;
+
+    while (1) {
+        /* LOCK */
+        pthread_mutex_lock(&acc->lock);
+        stop = acc->stop;
+        /* UNLOCK */
+        pthread_mutex_unlock(&acc->lock);
+        if (stop) {
+            break;
+        }
+
+        memset(&conn, 0, sizeof conn);
+
+        /* BIND LOCK */
+        pthread_mutex_lock(&server_opts.bind_lock);
+
+        if (thr->own_binds) {
+            /* ENDPT READ LOCK */
+            pthread_rwlock_rdlock(&server_opts.endpt_lock);
+
+            ret = nc_acceptor_sync_binds(thr);
+
+            /* ENDPT UNLOCK */
+            pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+            /* BIND UNLOCK */
+            pthread_mutex_unlock(&server_opts.bind_lock);
+
+            if (!ret) {
+                /* only this thread uses its own binds */
+                ret = nc_sock_accept_binds(thr->binds, thr->bind_count, &thr->pollset, NC_ACCEPTOR_TIMEOUT,
+                        &conn.host, &conn.port, &conn.bind_idx);
+            }
+            if (ret > 0) {
+                conn.bind_address = strdup(thr->binds[conn.bind_idx].address);
+                conn.bind_port = thr->binds[conn.bind_idx].port;
+            }
         } else {
-            i = j = ps->last_event_session + 1;
+            no_endpts = !server_opts.config.endpt_count;
+            if (no_endpts) {
+                ret = 0;
+            } else {
+                /* do not block the other threads and the configuration while waiting */
+                ret = nc_acceptor_wait_binds(thr, NC_ACCEPTOR_TIMEOUT);
+                if ((ret > 0) && server_opts.config.endpt_count) {
+                    /* the connection may have been accepted by another thread meanwhile */
+                    ret = nc_sock_accept_binds(server_opts.config.binds, server_opts.config.endpt_count,
+                            &server_opts.bind_pollset, 0, &conn.host, &conn.port, &conn.bind_idx);
+                } else if (ret > 0) {
+                    ret = 0;
+                }
+            }
+            if (ret > 0) {
+                conn.bind_address = strdup(server_opts.config.binds[conn.bind_idx].address);
+                conn.bind_port = server_opts.config.binds[conn.bind_idx].port;
+            }
+
+            /* BIND UNLOCK */
+            pthread_mutex_unlock(&server_opts.bind_lock);
+
+            if (no_endpts) {
+                /* no endpoints yet */
+                usleep(NC_ACCEPTOR_TIMEOUT * 1000);
+            }
         }
-        do {
-            cur_ps_session = ps->sessions[i];
-            cur_session = cur_ps_session->session;
 
-            /* SESSION RPC LOCK */
-            r = nc_session_rpc_lock(cur_session, 0, __func__);
-            if (r == -1) {
-                ret = NC_PSPOLL_ERROR;
-            } else if (r == 1) {
-                /* no one else is currently working with the session, so we can, otherwise skip it */
-                switch (cur_ps_session->state) {
-                case NC_PS_STATE_NONE:
-                    if (cur_session->status == NC_STATUS_RUNNING) {
-                        /* session is fine, work with it */
-                        cur_ps_session->state = NC_PS_STATE_BUSY;
+        if (ret < 1) {
+            free(conn.host);
+            if (ret < 0) {
+                /* do not spin on a persistent error */
+                usleep(NC_ACCEPTOR_TIMEOUT * 1000);
+            }
+            continue;
+        }
+        conn.sock = ret;
+        if (!conn.bind_address) {
+            ERRMEM;
+            close(conn.sock);
+            free(conn.host);
+            continue;
+        }
 
-                        ret = nc_ps_poll_session_io(cur_session, NC_SESSION_LOCK_TIMEOUT, ts_cur.tv_sec, msg);
-                        switch (ret) {
-                        case NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR:
-                            ERR(cur_session, "%s.", msg);
-                            cur_ps_session->state = NC_PS_STATE_INVALID;
-                            break;
-                        case NC_PSPOLL_ERROR:
-                            ERR(cur_session, "%s.", msg);
-                            cur_ps_session->state = NC_PS_STATE_NONE;
-                            break;
-                        case NC_PSPOLL_TIMEOUT:
+        nc_acceptor_queue_conn(acc, &conn);
+    }
+
+    return NULL;
+}
+
+static void *
+nc_acceptor_worker_thread(void *arg)
+{
+    struct nc_acceptor *acc = arg;
+    struct nc_acceptor_conn conn;
+    struct nc_session *session;
+    NC_MSG_TYPE msgtype;
+
+    while (1) {
+        /* LOCK */
+        pthread_mutex_lock(&acc->lock);
+
+        while (!acc->queue_len && !acc->stop) {
+            pthread_cond_wait(&acc->conn_cond, &acc->lock);
+        }
+        if (acc->stop) {
+            /* UNLOCK */
+            pthread_mutex_unlock(&acc->lock);
+            break;
+        }
+
+        conn = acc->queue[acc->queue_begin];
+        acc->queue_begin = (acc->queue_begin + 1) % acc->queue_size;
+        --acc->queue_len;
+        pthread_cond_signal(&acc->space_cond);
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&acc->lock);
+
+        /* BIND LOCK */
+        pthread_mutex_lock(&server_opts.bind_lock);
+
+        /* the endpoint may have been changed or removed meanwhile */
+        if ((conn.bind_idx >= server_opts.config.endpt_count) || !server_opts.config.binds[conn.bind_idx].address ||
+                strcmp(server_opts.config.binds[conn.bind_idx].address, conn.bind_address) ||
+                (server_opts.config.binds[conn.bind_idx].port != conn.bind_port)) {
+            /* BIND UNLOCK */
+            pthread_mutex_unlock(&server_opts.bind_lock);
+
+            VRB(NULL, "Endpoint of a new connection from %s was changed, closing it.", conn.host);
+            close(conn.sock);
+            free(conn.host);
+            free(conn.bind_address);
+            continue;
+        }
+        free(conn.bind_address);
+
+        /* ENDPT READ LOCK */
+        pthread_rwlock_rdlock(&server_opts.endpt_lock);
+
+        /* BIND UNLOCK */
+        pthread_mutex_unlock(&server_opts.bind_lock);
+
+        /* releases ENDPT READ LOCK */
+        msgtype = nc_accept_bind_sock(conn.sock, conn.host, conn.port, conn.bind_idx, acc->ctx, &session);
+        if ((msgtype == NC_MSG_HELLO) && acc->session_clb) {
+            acc->session_clb(session, acc->user_data);
+        } else if (msgtype == NC_MSG_HELLO) {
+            nc_session_free(session, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+static void
+nc_acceptor_stop(struct nc_acceptor *acc, uint16_t thread_count, uint16_t worker_count)
+{
+    uint16_t i;
+
+    /* LOCK */
+    pthread_mutex_lock(&acc->lock);
+    acc->stop = 1;
+    pthread_cond_broadcast(&acc->conn_cond);
+    pthread_cond_broadcast(&acc->space_cond);
+    /* UNLOCK */
+    pthread_mutex_unlock(&acc->lock);
+
+    for (i = 0; i < thread_count; ++i) {
+        pthread_join(acc->threads[i].tid, NULL);
+    }
+    for (i = 0; i < worker_count; ++i) {
+        pthread_join(acc->worker_tids[i], NULL);
+    }
+}
+
+static void
+nc_acceptor_destroy(struct nc_acceptor *acc)
+{
+    uint16_t i, j;
+
+    /* close the connections that were not handshaken */
+    for (i = 0; i < acc->queue_len; ++i) {
+        j = (acc->queue_begin + i) % acc->queue_size;
+        close(acc->queue[j].sock);
+        free(acc->queue[j].host);
+        free(acc->queue[j].bind_address);
+    }
+
+    if (acc->threads) {
+        for (i = 0; i < acc->thread_count; ++i) {
+            for (j = 0; j < acc->threads[i].bind_count; ++j) {
+                if (acc->threads[i].binds[j].sock > -1) {
+                    close(acc->threads[i].binds[j].sock);
+                }
+                free(acc->threads[i].binds[j].address);
+            }
+            free(acc->threads[i].binds);
+            free(acc->threads[i].pollset.pfds);
+        }
+    }
+
+    pthread_cond_destroy(&acc->space_cond);
+    pthread_cond_destroy(&acc->conn_cond);
+    pthread_mutex_destroy(&acc->lock);
+    free(acc->queue);
+    free(acc->threads);
+    free(acc->worker_tids);
+    free(acc);
+}
+
+API struct nc_acceptor *
+nc_acceptor_new(const struct ly_ctx *ctx, uint16_t thread_count, uint16_t worker_count, nc_acceptor_clb session_clb,
+        void *user_data)
+{
+    struct nc_acceptor *acc;
+    uint16_t i;
+    int r;
+
+    if (!ctx) {
+        ERRARG("ctx");
+        return NULL;
+    } else if (!thread_count) {
+        ERRARG("thread_count");
+        return NULL;
+    } else if (!worker_count) {
+        ERRARG("worker_count");
+        return NULL;
+    }
+
+    /* init ctx as needed */
+    nc_server_init_ctx(ctx);
+
+    acc = calloc(1, sizeof *acc);
+    if (!acc) {
+        ERRMEM;
+        return NULL;
+    }
+    acc->ctx = ctx;
+    acc->session_clb = session_clb;
+    acc->user_data = user_data;
+    pthread_mutex_init(&acc->lock, NULL);
+    pthread_cond_init(&acc->conn_cond, NULL);
+    pthread_cond_init(&acc->space_cond, NULL);
+
+    acc->queue_size = worker_count * NC_ACCEPTOR_QUEUE_FACTOR;
+    acc->queue = malloc(acc->queue_size * sizeof *acc->queue);
+    acc->threads = calloc(thread_count, sizeof *acc->threads);
+    acc->worker_tids = malloc(worker_count * sizeof *acc->worker_tids);
+    if (!acc->queue || !acc->threads || !acc->worker_tids) {
+        ERRMEM;
+        nc_acceptor_destroy(acc);
+        return NULL;
+    }
+    acc->thread_count = thread_count;
+
+    /* workers */
+    for (i = 0; i < worker_count; ++i) {
+        r = pthread_create(&acc->worker_tids[i], NULL, nc_acceptor_worker_thread, acc);
+        if (r) {
+            ERR(NULL, "Creating a new thread failed (%s).", strerror(r));
+            nc_acceptor_stop(acc, 0, i);
+            nc_acceptor_destroy(acc);
+            return NULL;
+        }
+    }
+    acc->worker_count = worker_count;
+
+    /* BIND LOCK */
+    pthread_mutex_lock(&server_opts.bind_lock);
+
+    /* the first thread always shares the server binds, the others only without SO_REUSEPORT */
+    for (i = 0; i < thread_count; ++i) {
+        acc->threads[i].acc = acc;
+        acc->threads[i].own_binds = (i && server_opts.reuseport) ? 1 : 0;
+    }
+
+    /* BIND UNLOCK */
+    pthread_mutex_unlock(&server_opts.bind_lock);
+
+    /* connection acceptors */
+    for (i = 0; i < thread_count; ++i) {
+        r = pthread_create(&acc->threads[i].tid, NULL, nc_acceptor_thread, &acc->threads[i]);
+        if (r) {
+            ERR(NULL, "Creating a new thread failed (%s).", strerror(r));
+            nc_acceptor_stop(acc, i, acc->worker_count);
+            nc_acceptor_destroy(acc);
+            return NULL;
+        }
+    }
+
+    return acc;
+}
+
+API void
+nc_acceptor_free(struct nc_acceptor *acc)
+{
+    if (!acc) {
+        return;
+    }
+
+    nc_acceptor_stop(acc, acc->thread_count, acc->worker_count);
+    nc_acceptor_destroy(acc);
+}
+
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+
+/* client is expected to be locked */
+static int
+_nc_server_ch_client_del_endpt(struct nc_ch_client *client, const char *endpt_name, NC_TRANSPORT_IMPL ti)
+{
+    uint16_t i;
+    int ret = -1;
+
+    if (!endpt_name) {
+        /* remove all endpoints */
+        for (i = 0; i < client->ch_endpt_count; ++i) {
+            free(client->ch_endpts[i].name);
+            free(client->ch_endpts[i].address);
+            if (client->ch_endpts[i].sock_pending != -1) {
+                close(client->ch_endpts[i].sock_pending);
+            }
+            switch (client->ch_endpts[i].ti) {
 #ifdef NC_ENABLED_SSH
-                        case NC_PSPOLL_SSH_CHANNEL:
-                        case NC_PSPOLL_SSH_MSG:
+            case NC_TI_LIBSSH:
+                nc_server_ssh_clear_opts(client->ch_endpts[i].opts.ssh);
+                free(client->ch_endpts[i].opts.ssh);
+                break;
 #endif
-                            cur_ps_session->state = NC_PS_STATE_NONE;
-                            break;
-                        case NC_PSPOLL_RPC:
-                            /* let's keep the state busy, we are not done with this session */
-                            break;
-                        }
-                    } else {
-                        /* session is not fine, let the caller know */
-                        ret = NC_PSPOLL_SESSION_TERM;
-                        if (cur_session->term_reason != NC_SESSION_TERM_CLOSED) {
-                            ret |= NC_PSPOLL_SESSION_ERROR;
-                        }
-                        cur_ps_session->state = NC_PS_STATE_INVALID;
-                    }
+#ifdef NC_ENABLED_TLS
+            case NC_TI_OPENSSL:
+                nc_server_tls_clear_opts(client->ch_endpts[i].opts.tls);
+                free(client->ch_endpts[i].opts.tls);
+                break;
+#endif
+            default:
+                ERRINT;
+                /* won't get here ...*/
+                break;
+            }
+        }
+        free(client->ch_endpts);
+        client->ch_endpts = NULL;
+        client->ch_endpt_count = 0;
+
+        ret = 0;
+    } else {
+        for (i = 0; i < client->ch_endpt_count; ++i) {
+            if (!strcmp(client->ch_endpts[i].name, endpt_name) && (!ti || (ti == client->ch_endpts[i].ti))) {
+                free(client->ch_endpts[i].name);
+                free(client->ch_endpts[i].address);
+                if (client->ch_endpts[i].sock_pending != -1) {
+                    close(client->ch_endpts[i].sock_pending);
+                }
+                switch (client->ch_endpts[i].ti) {
+#ifdef NC_ENABLED_SSH
+                case NC_TI_LIBSSH:
+                    nc_server_ssh_clear_opts(client->ch_endpts[i].opts.ssh);
+                    free(client->ch_endpts[i].opts.ssh);
                     break;
-                case NC_PS_STATE_BUSY:
-                    /* it definitely should not be busy because we have the lock */
-                    ERRINT;
-                    ret = NC_PSPOLL_ERROR;
+#endif
+#ifdef NC_ENABLED_TLS
+                case NC_TI_OPENSSL:
+                    nc_server_tls_clear_opts(client->ch_endpts[i].opts.tls);
+                    free(client->ch_endpts[i].opts.tls);
                     break;
-                case NC_PS_STATE_INVALID:
-                    /* we got it locked, but it will be freed, let it be */
-                    ret = NC_PSPOLL_TIMEOUT;
+#endif
+                default:
+                    ERRINT;
+                    /* won't get here ...*/
                     break;
                 }
 
-                /* keep RPC lock in this one case */
-                if (ret != NC_PSPOLL_RPC) {
-                    /* SESSION RPC UNLOCK */
-                    nc_session_rpc_unlock(cur_session, NC_SESSION_LOCK_TIMEOUT, __func__);
+                /* move last endpoint to the empty space */
+                --client->ch_endpt_count;
+                if (i < client->ch_endpt_count) {
+                    memcpy(&client->ch_endpts[i], &client->ch_endpts[client->ch_endpt_count], sizeof *client->ch_endpts);
+                } else if (!client->ch_endpt_count) {
+                    free(client->ch_endpts);
+                    client->ch_endpts = NULL;
                 }
-            } else {
-                /* timeout */
-                ret = NC_PSPOLL_TIMEOUT;
-            }
 
-            /* something happened */
-            if (ret != NC_PSPOLL_TIMEOUT) {
+                ret = 0;
                 break;
             }
+        }
+    }
 
-            if (i == ps->session_count - 1) {
-                i = 0;
-            } else {
-                ++i;
-            }
-        } while (i != j);
+    return ret;
+}
 
-        /* no event, no session remains locked */
-        if (ret == NC_PSPOLL_TIMEOUT) {
-            usleep(NC_TIMEOUT_STEP);
+/**
+ * @brief Lock CH client structures, unless the calling thread modifies a staged configuration of a batch.
+ *
+ * @param[in] write Whether to lock for writing, otherwise for reading.
+ * @return Configuration with the CH clients to access.
+ */
+static struct nc_server_config *
+nc_server_ch_clients_lock(int write)
+{
+    struct nc_server_config *cfg;
 
-            if ((timeout > -1) && (nc_difftimespec_mono_cur(&ts_timeout) < 1)) {
-                /* final timeout */
-                break;
-            }
-        }
-    } while (ret == NC_PSPOLL_TIMEOUT);
+    if (nc_server_config_batch_get(&cfg)) {
+        return cfg;
+    }
 
-    /* do we want to return the session? */
-    switch (ret) {
-    case NC_PSPOLL_RPC:
-    case NC_PSPOLL_SESSION_TERM:
-    case NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR:
-#ifdef NC_ENABLED_SSH
-    case NC_PSPOLL_SSH_CHANNEL:
-    case NC_PSPOLL_SSH_MSG:
-#endif
-        if (session) {
-            *session = cur_session;
-        }
-        ps->last_event_session = i;
-        break;
-    default:
-        break;
+    if (write) {
+        pthread_rwlock_wrlock(&server_opts.ch_client_lock);
+    } else {
+        pthread_rwlock_rdlock(&server_opts.ch_client_lock);
     }
+    return cfg;
+}
 
-    /* PS UNLOCK */
-    nc_ps_unlock(ps, q_id, __func__);
+/**
+ * @brief Unlock CH client structures locked by nc_server_ch_clients_lock().
+ */
+static void
+nc_server_ch_clients_unlock(void)
+{
+    if (!nc_server_config_batch_owner()) {
+        pthread_rwlock_unlock(&server_opts.ch_client_lock);
+    }
+}
 
-    /* we have some data available and the session is RPC locked (but not IO locked) */
-    if (ret == NC_PSPOLL_RPC) {
-        ret = nc_server_recv_rpc_io(cur_session, timeout, &rpc);
-        if (ret & (NC_PSPOLL_ERROR | NC_PSPOLL_BAD_RPC)) {
-            if (cur_session->status != NC_STATUS_RUNNING) {
-                ret |= NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR;
-                cur_ps_session->state = NC_PS_STATE_INVALID;
-            } else {
-                cur_ps_session->state = NC_PS_STATE_NONE;
-            }
-        } else {
-            cur_session->opts.server.last_rpc = ts_cur.tv_sec;
-
-            /* process RPC */
-            ret |= nc_server_send_reply_io(cur_session, timeout, rpc);
-            if (cur_session->status != NC_STATUS_RUNNING) {
-                ret |= NC_PSPOLL_SESSION_TERM;
-                if (!(cur_session->term_reason & (NC_SESSION_TERM_CLOSED | NC_SESSION_TERM_KILLED))) {
-                    ret |= NC_PSPOLL_SESSION_ERROR;
-                }
-                cur_ps_session->state = NC_PS_STATE_INVALID;
-            } else {
-                cur_ps_session->state = NC_PS_STATE_NONE;
-            }
-        }
-        nc_server_rpc_free(rpc);
+API int
+nc_server_ch_add_client(const char *name)
+{
+    struct nc_ch_client *client;
+    struct nc_server_config *cfg;
 
-        /* SESSION RPC UNLOCK */
-        nc_session_rpc_unlock(cur_session, NC_SESSION_LOCK_TIMEOUT, __func__);
+    if (!name) {
+        ERRARG("name");
+        return -1;
     }
 
-    return ret;
+    /* WRITE LOCK */
+    cfg = nc_server_ch_clients_lock(1);
+
+    /* check name uniqueness */
+    if (NC_CH_CLIENT_FIND(cfg, name) > -1) {
+        ERR(NULL, "Call Home client \"%s\" already exists.", name);
+        /* WRITE UNLOCK */
+        nc_server_ch_clients_unlock();
+        return -1;
+    }
+
+    ++cfg->ch_client_count;
+    cfg->ch_clients = nc_realloc(cfg->ch_clients, cfg->ch_client_count * sizeof *cfg->ch_clients);
+    if (!cfg->ch_clients) {
+        ERRMEM;
+        /* WRITE UNLOCK */
+        nc_server_ch_clients_unlock();
+        return -1;
+    }
+    client = &cfg->ch_clients[cfg->ch_client_count - 1];
+
+    client->name = strdup(name);
+    if (!client->name) {
+        ERRMEM;
+        --cfg->ch_client_count;
+        /* WRITE UNLOCK */
+        nc_server_ch_clients_unlock();
+        return -1;
+    }
+    client->id = ATOMIC_INC_RELAXED(server_opts.new_client_id);
+    nc_name_index_add(&cfg->ch_client_index, cfg->ch_clients, sizeof *cfg->ch_clients, cfg->ch_client_count);
+    client->ch_endpts = NULL;
+    client->ch_endpt_count = 0;
+    client->conn_type = 0;
+
+    /* set CH default options */
+    client->start_with = NC_CH_FIRST_LISTED;
+    client->max_attempts = 3;
+
+    pthread_mutex_init(&client->lock, NULL);
+
+    /* WRITE UNLOCK */
+    nc_server_ch_clients_unlock();
+
+    return 0;
 }
 
-API void
-nc_ps_clear(struct nc_pollsession *ps, int all, void (*data_free)(void *))
+/**
+ * @brief Remove CH clients with their endpoints.
+ *
+ * @param[in] cfg Configuration to modify.
+ * @param[in] name Name of the CH client to remove, NULL for all the clients.
+ * @return 0 on success, -1 if no client was removed.
+ */
+static int
+_nc_server_ch_del_client(struct nc_server_config *cfg, const char *name)
 {
-    uint8_t q_id;
     uint16_t i;
-    struct nc_session *session;
+    int idx, ret = -1;
 
-    if (!ps) {
-        ERRARG("ps");
-        return;
-    }
+    if (!name) {
+        /* remove all CH clients with endpoints */
+        for (i = 0; i < cfg->ch_client_count; ++i) {
+            free(cfg->ch_clients[i].name);
 
-    /* LOCK */
-    if (nc_ps_lock(ps, &q_id, __func__)) {
-        return;
-    }
+            /* remove all endpoints */
+            _nc_server_ch_client_del_endpt(&cfg->ch_clients[i], NULL, 0);
 
-    if (all) {
-        for (i = 0; i < ps->session_count; i++) {
-            nc_session_free(ps->sessions[i]->session, data_free);
-            free(ps->sessions[i]);
+            pthread_mutex_destroy(&cfg->ch_clients[i].lock);
+            ret = 0;
         }
-        free(ps->sessions);
-        ps->sessions = NULL;
-        ps->session_count = 0;
-        ps->last_event_session = 0;
-    } else {
-        for (i = 0; i < ps->session_count; ) {
-            if (ps->sessions[i]->session->status != NC_STATUS_RUNNING) {
-                session = ps->sessions[i]->session;
-                _nc_ps_del_session(ps, NULL, i);
-                nc_session_free(session, data_free);
-                continue;
-            }
+        free(cfg->ch_clients);
+        cfg->ch_clients = NULL;
 
-            ++i;
+        cfg->ch_client_count = 0;
+        nc_name_index_clear(&cfg->ch_client_index);
+
+    } else if ((idx = NC_CH_CLIENT_FIND(cfg, name)) > -1) {
+        /* remove one client with endpoints */
+        free(cfg->ch_clients[idx].name);
+
+        /* remove all endpoints */
+        _nc_server_ch_client_del_endpt(&cfg->ch_clients[idx], NULL, 0);
+
+        pthread_mutex_destroy(&cfg->ch_clients[idx].lock);
+
+        /* move last client and endpoint(s) to the empty space */
+        --cfg->ch_client_count;
+        if (idx < cfg->ch_client_count) {
+            memcpy(&cfg->ch_clients[idx], &cfg->ch_clients[cfg->ch_client_count], sizeof *cfg->ch_clients);
+        } else if (!cfg->ch_client_count) {
+            free(cfg->ch_clients);
+            cfg->ch_clients = NULL;
+        }
+
+        /* the last client may have been moved */
+        if (cfg->ch_client_count) {
+            nc_name_index_rebuild(&cfg->ch_client_index, cfg->ch_clients, sizeof *cfg->ch_clients,
+                    cfg->ch_client_count);
+        } else {
+            nc_name_index_clear(&cfg->ch_client_index);
         }
+
+        ret = 0;
     }
 
-    /* UNLOCK */
-    nc_ps_unlock(ps, q_id, __func__);
+    return ret;
 }
 
-static int
-nc_get_uid(int sock, uid_t *uid)
+API int
+nc_server_ch_del_client(const char *name)
 {
     int ret;
+    struct nc_server_config *cfg;
 
-#ifdef SO_PEERCRED
-    struct ucred ucred;
-    socklen_t len;
-    len = sizeof(ucred);
-    ret = getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &ucred, &len);
-    if (!ret) {
-        *uid = ucred.uid;
-    }
-#else
-    ret = getpeereid(sock, uid, NULL);
-#endif
+    /* WRITE LOCK */
+    cfg = nc_server_ch_clients_lock(1);
 
-    if (ret < 0) {
-        ERR(NULL, "Failed to get credentials from unix socket (%s).", strerror(errno));
-        return -1;
+    ret = _nc_server_ch_del_client(cfg, name);
+
+    /* WRITE UNLOCK */
+    nc_server_ch_clients_unlock();
+
+    if (!ret) {
+        /* finish the jobs of the removed clients */
+        nc_ch_sched_client_changed(name);
     }
-    return 0;
+    return ret;
 }
 
-static int
-nc_accept_unix(struct nc_session *session, int sock)
+API int
+nc_server_ch_is_client(const char *name)
 {
-#if defined (SO_PEERCRED) || defined (HAVE_GETPEEREID)
-    struct passwd *pw, pw_buf;
-    char *username;
-    session->ti_type = NC_TI_UNIX;
-    uid_t uid = 0;
-    char *buf = NULL;
-    size_t buf_len = 0;
+    int found = 0;
+    struct nc_server_config *cfg;
 
-    if (nc_get_uid(sock, &uid)) {
-        close(sock);
-        return -1;
+    if (!name) {
+        return found;
     }
 
-    pw = nc_getpwuid(uid, &pw_buf, &buf, &buf_len);
-    if (pw == NULL) {
-        ERR(NULL, "Failed to find username for uid=%u (%s).\n", uid, strerror(errno));
-        close(sock);
-        return -1;
-    }
+    /* READ LOCK */
+    cfg = nc_server_ch_clients_lock(0);
 
-    username = strdup(pw->pw_name);
-    free(buf);
-    if (username == NULL) {
-        ERRMEM;
-        close(sock);
-        return -1;
-    }
-    session->username = username;
+    found = (NC_CH_CLIENT_FIND(cfg, name) > -1) ? 1 : 0;
 
-    session->ti.unixsock.sock = sock;
+    /* UNLOCK */
+    nc_server_ch_clients_unlock();
 
-    return 1;
-#else
-    return -1;
-#endif
+    return found;
 }
 
 API int
-nc_server_add_endpt(const char *name, NC_TRANSPORT_IMPL ti)
+nc_server_ch_client_add_endpt(const char *client_name, const char *endpt_name, NC_TRANSPORT_IMPL ti)
 {
     uint16_t i;
-    int ret = 0;
+    struct nc_ch_client *client;
+    struct nc_ch_endpt *endpt;
+    int ret = -1;
 
-    if (!name) {
-        ERRARG("name");
+    if (!client_name) {
+        ERRARG("client_name");
+        return -1;
+    } else if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    } else if (!ti) {
+        ERRARG("ti");
         return -1;
     }
 
-    /* BIND LOCK */
-    pthread_mutex_lock(&server_opts.bind_lock);
-
-    /* ENDPT WRITE LOCK */
-    pthread_rwlock_wrlock(&server_opts.endpt_lock);
+    /* LOCK */
+    nc_server_ch_client_lock(client_name, NULL, 0, &client);
+    if (!client) {
+        return -1;
+    }
 
-    /* check name uniqueness */
-    for (i = 0; i < server_opts.endpt_count; ++i) {
-        if (!strcmp(server_opts.endpts[i].name, name)) {
-            ERR(NULL, "Endpoint \"%s\" already exists.", name);
-            ret = -1;
+    for (i = 0; i < client->ch_endpt_count; ++i) {
+        if (!strcmp(client->ch_endpts[i].name, endpt_name)) {
+            ERR(NULL, "Call Home client \"%s\" endpoint \"%s\" already exists.", client_name, endpt_name);
             goto cleanup;
         }
     }
 
-    server_opts.endpts = nc_realloc(server_opts.endpts, (server_opts.endpt_count + 1) * sizeof *server_opts.endpts);
-    if (!server_opts.endpts) {
+    ++client->ch_endpt_count;
+    client->ch_endpts = realloc(client->ch_endpts, client->ch_endpt_count * sizeof *client->ch_endpts);
+    if (!client->ch_endpts) {
         ERRMEM;
-        ret = -1;
         goto cleanup;
     }
-    memset(&server_opts.endpts[server_opts.endpt_count], 0, sizeof *server_opts.endpts);
-    ++server_opts.endpt_count;
-
-    server_opts.endpts[server_opts.endpt_count - 1].name = strdup(name);
-    server_opts.endpts[server_opts.endpt_count - 1].ti = ti;
-    server_opts.endpts[server_opts.endpt_count - 1].ka.idle_time = 1;
-    server_opts.endpts[server_opts.endpt_count - 1].ka.max_probes = 10;
-    server_opts.endpts[server_opts.endpt_count - 1].ka.probe_interval = 5;
+    endpt = &client->ch_endpts[client->ch_endpt_count - 1];
 
-    server_opts.binds = nc_realloc(server_opts.binds, server_opts.endpt_count * sizeof *server_opts.binds);
-    if (!server_opts.binds) {
+    memset(endpt, 0, sizeof *client->ch_endpts);
+    endpt->name = strdup(endpt_name);
+    if (!endpt->name) {
         ERRMEM;
-        ret = -1;
+        --client->ch_endpt_count;
         goto cleanup;
     }
-
-    memset(&server_opts.binds[server_opts.endpt_count - 1], 0, sizeof *server_opts.binds);
-    server_opts.binds[server_opts.endpt_count - 1].sock = -1;
+    endpt->ti = ti;
+    endpt->sock_pending = -1;
+    endpt->ka.idle_time = 1;
+    endpt->ka.max_probes = 10;
+    endpt->ka.probe_interval = 5;
 
     switch (ti) {
 #ifdef NC_ENABLED_SSH
     case NC_TI_LIBSSH:
-        server_opts.endpts[server_opts.endpt_count - 1].opts.ssh = calloc(1, sizeof(struct nc_server_ssh_opts));
-        if (!server_opts.endpts[server_opts.endpt_count - 1].opts.ssh) {
-            ERRMEM;
-            ret = -1;
+        endpt->opts.ssh = nc_server_ssh_opts_new();
+        if (!endpt->opts.ssh) {
             goto cleanup;
         }
-        server_opts.endpts[server_opts.endpt_count - 1].opts.ssh->auth_methods =
-                NC_SSH_AUTH_PUBLICKEY | NC_SSH_AUTH_PASSWORD;
-        server_opts.endpts[server_opts.endpt_count - 1].opts.ssh->auth_attempts = 3;
-        server_opts.endpts[server_opts.endpt_count - 1].opts.ssh->auth_timeout = 30;
         break;
 #endif
 #ifdef NC_ENABLED_TLS
     case NC_TI_OPENSSL:
-        server_opts.endpts[server_opts.endpt_count - 1].opts.tls = calloc(1, sizeof(struct nc_server_tls_opts));
-        if (!server_opts.endpts[server_opts.endpt_count - 1].opts.tls) {
+        endpt->opts.tls = calloc(1, sizeof(struct nc_server_tls_opts));
+        if (!endpt->opts.tls) {
             ERRMEM;
-            ret = -1;
             goto cleanup;
         }
         break;
 #endif
-    case NC_TI_UNIX:
-        server_opts.endpts[server_opts.endpt_count - 1].opts.unixsock = calloc(1, sizeof(struct nc_server_unix_opts));
-        if (!server_opts.endpts[server_opts.endpt_count - 1].opts.unixsock) {
-            ERRMEM;
-            ret = -1;
-            goto cleanup;
-        }
-        server_opts.endpts[server_opts.endpt_count - 1].opts.unixsock->mode = (mode_t)-1;
-        server_opts.endpts[server_opts.endpt_count - 1].opts.unixsock->uid = (uid_t)-1;
-        server_opts.endpts[server_opts.endpt_count - 1].opts.unixsock->gid = (gid_t)-1;
-        break;
     default:
         ERRINT;
-        ret = -1;
         goto cleanup;
     }
 
-cleanup:
-    /* ENDPT UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    /* success */
+    ret = 0;
 
-    /* BIND UNLOCK */
-    pthread_mutex_unlock(&server_opts.bind_lock);
+cleanup:
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
 
+    if (!ret) {
+        /* connect if the client was waiting for an endpoint */
+        nc_ch_sched_client_changed(client_name);
+    }
     return ret;
 }
 
 API int
-nc_server_del_endpt(const char *name, NC_TRANSPORT_IMPL ti)
+nc_server_ch_client_del_endpt(const char *client_name, const char *endpt_name, NC_TRANSPORT_IMPL ti)
 {
-    uint32_t i;
-    int ret = -1;
+    int ret;
+    struct nc_ch_client *client;
 
-    /* BIND LOCK */
-    pthread_mutex_lock(&server_opts.bind_lock);
+    if (!client_name) {
+        ERRARG("client_name");
+        return -1;
+    }
 
-    /* ENDPT WRITE LOCK */
-    pthread_rwlock_wrlock(&server_opts.endpt_lock);
+    /* LOCK */
+    nc_server_ch_client_lock(client_name, NULL, 0, &client);
+    if (!client) {
+        return -1;
+    }
 
-    if (!name && !ti) {
-        /* remove all endpoints */
-        for (i = 0; i < server_opts.endpt_count; ++i) {
-            free(server_opts.endpts[i].name);
-            switch (server_opts.endpts[i].ti) {
-#ifdef NC_ENABLED_SSH
-            case NC_TI_LIBSSH:
-                nc_server_ssh_clear_opts(server_opts.endpts[i].opts.ssh);
-                free(server_opts.endpts[i].opts.ssh);
-                break;
-#endif
-#ifdef NC_ENABLED_TLS
-            case NC_TI_OPENSSL:
-                nc_server_tls_clear_opts(server_opts.endpts[i].opts.tls);
-                free(server_opts.endpts[i].opts.tls);
-                break;
-#endif
-            case NC_TI_UNIX:
-                free(server_opts.endpts[i].opts.unixsock);
-                break;
-            default:
-                ERRINT;
-                /* won't get here ...*/
-                break;
-            }
-            ret = 0;
-        }
-        free(server_opts.endpts);
-        server_opts.endpts = NULL;
+    ret = _nc_server_ch_client_del_endpt(client, endpt_name, ti);
 
-        /* remove all binds */
-        for (i = 0; i < server_opts.endpt_count; ++i) {
-            free(server_opts.binds[i].address);
-            if (server_opts.binds[i].sock > -1) {
-                close(server_opts.binds[i].sock);
-            }
-        }
-        free(server_opts.binds);
-        server_opts.binds = NULL;
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
 
-        server_opts.endpt_count = 0;
+    if (!ret) {
+        /* abort a handshake on a removed endpoint */
+        nc_ch_sched_client_changed(client_name);
+    }
+    return ret;
+}
 
-    } else {
-        /* remove one endpoint with bind(s) or all endpoints using one transport protocol */
-        for (i = 0; i < server_opts.endpt_count; ++i) {
-            if ((name && !strcmp(server_opts.endpts[i].name, name)) || (!name && (server_opts.endpts[i].ti == ti))) {
-                /* remove endpt */
-                free(server_opts.endpts[i].name);
-                switch (server_opts.endpts[i].ti) {
-#ifdef NC_ENABLED_SSH
-                case NC_TI_LIBSSH:
-                    nc_server_ssh_clear_opts(server_opts.endpts[i].opts.ssh);
-                    free(server_opts.endpts[i].opts.ssh);
-                    break;
-#endif
-#ifdef NC_ENABLED_TLS
-                case NC_TI_OPENSSL:
-                    nc_server_tls_clear_opts(server_opts.endpts[i].opts.tls);
-                    free(server_opts.endpts[i].opts.tls);
-                    break;
-#endif
-                case NC_TI_UNIX:
-                    free(server_opts.endpts[i].opts.unixsock);
-                    break;
-                default:
-                    ERRINT;
-                    break;
-                }
+API int
+nc_server_ch_client_is_endpt(const char *client_name, const char *endpt_name)
+{
+    int i;
+    struct nc_ch_client *client = NULL;
+    struct nc_server_config *cfg;
+    int found = 0;
 
-                /* remove bind(s) */
-                free(server_opts.binds[i].address);
-                if (server_opts.binds[i].sock > -1) {
-                    close(server_opts.binds[i].sock);
-                }
+    if (!client_name || !endpt_name) {
+        return found;
+    }
 
-                /* move last endpt and bind(s) to the empty space */
-                --server_opts.endpt_count;
-                if (!server_opts.endpt_count) {
-                    free(server_opts.binds);
-                    server_opts.binds = NULL;
-                    free(server_opts.endpts);
-                    server_opts.endpts = NULL;
-                } else if (i < server_opts.endpt_count) {
-                    memcpy(&server_opts.binds[i], &server_opts.binds[server_opts.endpt_count], sizeof *server_opts.binds);
-                    memcpy(&server_opts.endpts[i], &server_opts.endpts[server_opts.endpt_count], sizeof *server_opts.endpts);
-                }
+    /* READ LOCK */
+    cfg = nc_server_ch_clients_lock(0);
 
-                ret = 0;
-                if (name) {
-                    break;
-                }
-            }
-        }
+    i = NC_CH_CLIENT_FIND(cfg, client_name);
+    if (i < 0) {
+        goto cleanup;
     }
+    client = &cfg->ch_clients[i];
 
-    /* ENDPT UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
-
-    /* BIND UNLOCK */
-    pthread_mutex_unlock(&server_opts.bind_lock);
+    for (i = 0; i < client->ch_endpt_count; ++i) {
+        if (!strcmp(client->ch_endpts[i].name, endpt_name)) {
+            found = 1;
+            break;
+        }
+    }
 
-    return ret;
+cleanup:
+    /* UNLOCK */
+    nc_server_ch_clients_unlock();
+    return found;
 }
 
 API int
-nc_server_endpt_count(void)
+nc_server_ch_client_endpt_set_address(const char *client_name, const char *endpt_name, const char *address)
 {
-    return server_opts.endpt_count;
+    struct nc_ch_client *client;
+    struct nc_ch_endpt *endpt;
+
+    if (!client_name) {
+        ERRARG("client_name");
+        return -1;
+    } else if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    } else if (!address) {
+        ERRARG("address");
+        return -1;
+    }
+
+    /* LOCK */
+    endpt = nc_server_ch_client_lock(client_name, endpt_name, 0, &client);
+    if (!endpt) {
+        return -1;
+    }
+
+    free(endpt->address);
+    endpt->address = strdup(address);
+
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
+
+    /* connect to the new address right away */
+    nc_ch_sched_client_changed(client_name);
+    return 0;
 }
 
 API int
-nc_server_is_endpt(const char *name)
+nc_server_ch_client_endpt_set_port(const char *client_name, const char *endpt_name, uint16_t port)
 {
-    uint16_t i;
-    int found = 0;
+    struct nc_ch_client *client;
+    struct nc_ch_endpt *endpt;
 
-    if (!name) {
-        return found;
+    if (!client_name) {
+        ERRARG("client_name");
+        return -1;
+    } else if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    } else if (!port) {
+        ERRARG("port");
+        return -1;
     }
 
-    /* ENDPT READ LOCK */
-    pthread_rwlock_rdlock(&server_opts.endpt_lock);
-
-    /* check name uniqueness */
-    for (i = 0; i < server_opts.endpt_count; ++i) {
-        if (!strcmp(server_opts.endpts[i].name, name)) {
-            found = 1;
-            break;
-        }
+    /* LOCK */
+    endpt = nc_server_ch_client_lock(client_name, endpt_name, 0, &client);
+    if (!endpt) {
+        return -1;
     }
 
-    /* ENDPT UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    endpt->port = port;
 
-    return found;
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
+
+    /* connect to the new port right away */
+    nc_ch_sched_client_changed(client_name);
+    return 0;
 }
 
-int
-nc_server_endpt_set_address_port(const char *endpt_name, const char *address, uint16_t port)
+API int
+nc_server_ch_client_endpt_enable_keepalives(const char *client_name, const char *endpt_name, int enable)
 {
-    struct nc_endpt *endpt;
-    struct nc_bind *bind = NULL;
-    uint16_t i;
-    int sock = -1, set_addr, ret = 0;
+    struct nc_ch_client *client;
+    struct nc_ch_endpt *endpt;
 
-    if (!endpt_name) {
+    if (!client_name) {
+        ERRARG("client_name");
+        return -1;
+    } else if (!endpt_name) {
         ERRARG("endpt_name");
         return -1;
-    } else if ((!address && !port) || (address && port)) {
-        ERRARG("address and port");
+    }
+
+    /* LOCK */
+    endpt = nc_server_ch_client_lock(client_name, endpt_name, 0, &client);
+    if (!endpt) {
         return -1;
     }
 
-    if (address) {
-        set_addr = 1;
-    } else {
-        set_addr = 0;
+    endpt->ka.enabled = (enable ? 1 : 0);
+
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
+
+    return 0;
+}
+
+API int
+nc_server_ch_client_endpt_set_keepalives(const char *client_name, const char *endpt_name, int idle_time, int max_probes,
+        int probe_interval)
+{
+    struct nc_ch_client *client;
+    struct nc_ch_endpt *endpt;
+
+    if (!client_name) {
+        ERRARG("client_name");
+        return -1;
+    } else if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
     }
 
-    /* BIND LOCK */
-    pthread_mutex_lock(&server_opts.bind_lock);
-
-    /* ENDPT LOCK */
-    endpt = nc_server_endpt_lock_get(endpt_name, 0, &i);
+    /* LOCK */
+    endpt = nc_server_ch_client_lock(client_name, endpt_name, 0, &client);
     if (!endpt) {
-        /* BIND UNLOCK */
-        pthread_mutex_unlock(&server_opts.bind_lock);
         return -1;
     }
 
-    bind = &server_opts.binds[i];
-
-    if (set_addr) {
-        port = bind->port;
-    } else {
-        address = bind->address;
+    if (idle_time > -1) {
+        endpt->ka.idle_time = idle_time;
     }
-
-    if (!set_addr && (endpt->ti == NC_TI_UNIX)) {
-        ret = -1;
-        goto cleanup;
+    if (max_probes > -1) {
+        endpt->ka.max_probes = max_probes;
+    }
+    if (probe_interval > -1) {
+        endpt->ka.probe_interval = probe_interval;
     }
 
-    /* we have all the information we need to create a listening socket */
-    if (address && (port || (endpt->ti == NC_TI_UNIX))) {
-        /* create new socket, close the old one */
-        if (endpt->ti == NC_TI_UNIX) {
-            sock = nc_sock_listen_unix(address, endpt->opts.unixsock);
-        } else {
-            sock = nc_sock_listen_inet(address, port, &endpt->ka);
-        }
-        if (sock == -1) {
-            ret = -1;
-            goto cleanup;
-        }
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
 
-        if (bind->sock > -1) {
-            close(bind->sock);
-        }
-        bind->sock = sock;
-    } /* else we are just setting address or port */
+    return 0;
+}
 
-    if (set_addr) {
-        free(bind->address);
-        bind->address = strdup(address);
-    } else {
-        bind->port = port;
+API int
+nc_server_ch_client_set_conn_type(const char *client_name, NC_CH_CONN_TYPE conn_type)
+{
+    struct nc_ch_client *client;
+
+    if (!client_name) {
+        ERRARG("client_name");
+        return -1;
+    } else if (!conn_type) {
+        ERRARG("conn_type");
+        return -1;
     }
 
-    if (sock > -1) {
-        switch (endpt->ti) {
-        case NC_TI_UNIX:
-            VRB(NULL, "Listening on %s for UNIX connections.", address);
-            break;
-#ifdef NC_ENABLED_SSH
-        case NC_TI_LIBSSH:
-            VRB(NULL, "Listening on %s:%u for SSH connections.", address, port);
+    /* LOCK */
+    nc_server_ch_client_lock(client_name, NULL, 0, &client);
+    if (!client) {
+        return -1;
+    }
+
+    if (client->conn_type != conn_type) {
+        client->conn_type = conn_type;
+
+        /* set default options */
+        switch (conn_type) {
+        case NC_CH_PERSIST:
+            /* no options */
             break;
-#endif
-#ifdef NC_ENABLED_TLS
-        case NC_TI_OPENSSL:
-            VRB(NULL, "Listening on %s:%u for TLS connections.", address, port);
+        case NC_CH_PERIOD:
+            client->conn.period.period = 60;
+            client->conn.period.anchor_time = 0;
+            client->conn.period.idle_timeout = 120;
             break;
-#endif
         default:
             ERRINT;
             break;
         }
     }
 
-cleanup:
-    /* ENDPT UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
-
-    /* BIND UNLOCK */
-    pthread_mutex_unlock(&server_opts.bind_lock);
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
 
-    return ret;
+    /* an established session may now have an idle timeout */
+    nc_ch_sched_client_changed(client_name);
+    return 0;
 }
 
 API int
-nc_server_endpt_set_address(const char *endpt_name, const char *address)
+nc_server_ch_client_periodic_set_period(const char *client_name, uint16_t period)
 {
-    return nc_server_endpt_set_address_port(endpt_name, address, 0);
-}
+    struct nc_ch_client *client;
 
-#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+    if (!client_name) {
+        ERRARG("client_name");
+        return -1;
+    } else if (!period) {
+        ERRARG("period");
+        return -1;
+    }
 
-API int
-nc_server_endpt_set_port(const char *endpt_name, uint16_t port)
-{
-    return nc_server_endpt_set_address_port(endpt_name, NULL, port);
-}
+    /* LOCK */
+    nc_server_ch_client_lock(client_name, NULL, 0, &client);
+    if (!client) {
+        return -1;
+    }
 
-#endif
+    if (client->conn_type != NC_CH_PERIOD) {
+        ERR(NULL, "Call Home client \"%s\" is not of periodic connection type.", client_name);
+        /* UNLOCK */
+        nc_server_ch_client_unlock(client);
+        return -1;
+    }
+
+    client->conn.period.period = period;
+
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
+
+    return 0;
+}
 
 API int
-nc_server_endpt_set_perms(const char *endpt_name, mode_t mode, uid_t uid, gid_t gid)
+nc_server_ch_client_periodic_set_anchor_time(const char *client_name, time_t anchor_time)
 {
-    struct nc_endpt *endpt;
-    uint16_t i;
-    int ret = 0;
+    struct nc_ch_client *client;
 
-    if (!endpt_name) {
-        ERRARG("endpt_name");
-        return -1;
-    } else if (mode == 0) {
-        ERRARG("mode");
+    if (!client_name) {
+        ERRARG("client_name");
         return -1;
     }
 
-    /* ENDPT LOCK */
-    endpt = nc_server_endpt_lock_get(endpt_name, 0, &i);
-    if (!endpt) {
+    /* LOCK */
+    nc_server_ch_client_lock(client_name, NULL, 0, &client);
+    if (!client) {
         return -1;
     }
 
-    if (endpt->ti != NC_TI_UNIX) {
-        ret = -1;
-        goto cleanup;
+    if (client->conn_type != NC_CH_PERIOD) {
+        ERR(NULL, "Call Home client \"%s\" is not of periodic connection type.", client_name);
+        /* UNLOCK */
+        nc_server_ch_client_unlock(client);
+        return -1;
     }
 
-    endpt->opts.unixsock->mode = mode;
-    endpt->opts.unixsock->uid = uid;
-    endpt->opts.unixsock->gid = gid;
+    client->conn.period.anchor_time = anchor_time;
 
-cleanup:
-    /* ENDPT UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
 
-    return ret;
+    return 0;
 }
 
 API int
-nc_server_endpt_enable_keepalives(const char *endpt_name, int enable)
+nc_server_ch_client_periodic_set_idle_timeout(const char *client_name, uint16_t idle_timeout)
 {
-    struct nc_endpt *endpt;
-    int ret = 0;
+    struct nc_ch_client *client;
 
-    if (!endpt_name) {
-        ERRARG("endpt_name");
+    if (!client_name) {
+        ERRARG("client_name");
         return -1;
     }
 
-    /* ENDPT LOCK */
-    endpt = nc_server_endpt_lock_get(endpt_name, 0, NULL);
-    if (!endpt) {
+    /* LOCK */
+    nc_server_ch_client_lock(client_name, NULL, 0, &client);
+    if (!client) {
         return -1;
     }
 
-    endpt->ka.enabled = (enable ? 1 : 0);
+    if (client->conn_type != NC_CH_PERIOD) {
+        ERR(NULL, "Call Home client \"%s\" is not of periodic connection type.", client_name);
+        /* UNLOCK */
+        nc_server_ch_client_unlock(client);
+        return -1;
+    }
 
-    /* ENDPT UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    client->conn.period.idle_timeout = idle_timeout;
 
-    return ret;
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
+
+    nc_ch_sched_client_changed(client_name);
+    return 0;
 }
 
 API int
-nc_server_endpt_set_keepalives(const char *endpt_name, int idle_time, int max_probes, int probe_interval)
+nc_server_ch_client_set_start_with(const char *client_name, NC_CH_START_WITH start_with)
 {
-    struct nc_endpt *endpt;
-    int ret = 0;
+    struct nc_ch_client *client;
 
-    if (!endpt_name) {
-        ERRARG("endpt_name");
+    if (!client_name) {
+        ERRARG("client_name");
         return -1;
     }
 
-    /* ENDPT LOCK */
-    endpt = nc_server_endpt_lock_get(endpt_name, 0, NULL);
-    if (!endpt) {
+    /* LOCK */
+    nc_server_ch_client_lock(client_name, NULL, 0, &client);
+    if (!client) {
         return -1;
     }
 
-    if (idle_time > -1) {
-        endpt->ka.idle_time = idle_time;
-    }
-    if (max_probes > -1) {
-        endpt->ka.max_probes = max_probes;
-    }
-    if (probe_interval > -1) {
-        endpt->ka.probe_interval = probe_interval;
-    }
+    client->start_with = start_with;
 
-    /* ENDPT UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
 
-    return ret;
+    return 0;
 }
 
-API NC_MSG_TYPE
-nc_accept(int timeout, const struct ly_ctx *ctx, struct nc_session **session)
+API int
+nc_server_ch_client_set_max_attempts(const char *client_name, uint8_t max_attempts)
 {
-    NC_MSG_TYPE msgtype;
-    int sock, ret;
-    char *host = NULL;
-    uint16_t port, bind_idx;
-    struct timespec ts_cur;
+    struct nc_ch_client *client;
 
-    if (!ctx) {
-        ERRARG("ctx");
-        return NC_MSG_ERROR;
-    } else if (!session) {
-        ERRARG("session");
-        return NC_MSG_ERROR;
+    if (!client_name) {
+        ERRARG("client_name");
+        return -1;
+    } else if (!max_attempts) {
+        ERRARG("max_attempts");
+        return -1;
+    }
+
+    /* LOCK */
+    nc_server_ch_client_lock(client_name, NULL, 0, &client);
+    if (!client) {
+        return -1;
     }
 
-    /* init ctx as needed */
-    nc_server_init_ctx(ctx);
+    client->max_attempts = max_attempts;
 
-    /* BIND LOCK */
-    pthread_mutex_lock(&server_opts.bind_lock);
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
 
-    if (!server_opts.endpt_count) {
-        ERR(NULL, "No endpoints to accept sessions on.");
-        /* BIND UNLOCK */
-        pthread_mutex_unlock(&server_opts.bind_lock);
-        return NC_MSG_ERROR;
-    }
+    return 0;
+}
 
-    ret = nc_sock_accept_binds(server_opts.binds, server_opts.endpt_count, timeout, &host, &port, &bind_idx);
-    if (ret < 1) {
-        /* BIND UNLOCK */
-        pthread_mutex_unlock(&server_opts.bind_lock);
-        free(host);
-        if (!ret) {
-            return NC_MSG_WOULDBLOCK;
-        }
-        return NC_MSG_ERROR;
-    }
+/* ACCESS locked with ch_sched_lock, the scheduler itself has its own lock */
+static struct nc_ch_sched *ch_sched;
+static pthread_mutex_t ch_sched_lock = PTHREAD_MUTEX_INITIALIZER;
 
-    /* switch bind_lock for endpt_lock, so that another thread can accept another session */
-    /* ENDPT READ LOCK */
-    pthread_rwlock_rdlock(&server_opts.endpt_lock);
+/**
+ * @brief Get a random delay.
+ *
+ * @param[in] job Job to use the random seed of.
+ * @param[in] max_msec Maximum delay in msec.
+ * @return Delay in msec.
+ */
+static uint32_t
+nc_ch_jitter(struct nc_ch_job *job, uint32_t max_msec)
+{
+    return max_msec ? (uint32_t)rand_r(&job->seed) % (max_msec + 1) : 0;
+}
 
-    /* BIND UNLOCK */
-    pthread_mutex_unlock(&server_opts.bind_lock);
+/**
+ * @brief Learn whether a job is due before another one.
+ */
+static int
+nc_ch_sched_heap_before(const struct nc_ch_job *job1, const struct nc_ch_job *job2)
+{
+    if (job1->ts_due.tv_sec != job2->ts_due.tv_sec) {
+        return job1->ts_due.tv_sec < job2->ts_due.tv_sec;
+    }
+    return job1->ts_due.tv_nsec < job2->ts_due.tv_nsec;
+}
 
-    sock = ret;
+static void
+nc_ch_sched_heap_set(struct nc_ch_sched *sched, uint32_t idx, struct nc_ch_job *job)
+{
+    sched->heap[idx] = job;
+    job->heap_idx = idx;
+}
 
-    *session = nc_new_session(NC_SERVER, 0);
-    if (!(*session)) {
-        ERRMEM;
-        close(sock);
-        free(host);
-        msgtype = NC_MSG_ERROR;
-        goto cleanup;
+/**
+ * @brief Move a job in the timer queue to its position.
+ *
+ * @param[in] sched Call Home scheduler.
+ * @param[in] idx Index of the job in the timer queue.
+ */
+static void
+nc_ch_sched_heap_fix(struct nc_ch_sched *sched, uint32_t idx)
+{
+    struct nc_ch_job *job = sched->heap[idx];
+    uint32_t child;
+
+    /* up */
+    while (idx && nc_ch_sched_heap_before(job, sched->heap[(idx - 1) / 2])) {
+        nc_ch_sched_heap_set(sched, idx, sched->heap[(idx - 1) / 2]);
+        idx = (idx - 1) / 2;
     }
-    (*session)->status = NC_STATUS_STARTING;
-    (*session)->ctx = (struct ly_ctx *)ctx;
-    (*session)->flags = NC_SESSION_SHAREDCTX;
-    (*session)->host = host;
-    (*session)->port = port;
 
-    /* sock gets assigned to session or closed */
-#ifdef NC_ENABLED_SSH
-    if (server_opts.endpts[bind_idx].ti == NC_TI_LIBSSH) {
-        (*session)->data = server_opts.endpts[bind_idx].opts.ssh;
-        ret = nc_accept_ssh_session(*session, sock, NC_TRANSPORT_TIMEOUT);
-        if (ret < 0) {
-            msgtype = NC_MSG_ERROR;
-            goto cleanup;
-        } else if (!ret) {
-            msgtype = NC_MSG_WOULDBLOCK;
-            goto cleanup;
-        }
-    } else
-#endif
-#ifdef NC_ENABLED_TLS
-    if (server_opts.endpts[bind_idx].ti == NC_TI_OPENSSL) {
-        (*session)->data = server_opts.endpts[bind_idx].opts.tls;
-        ret = nc_accept_tls_session(*session, sock, NC_TRANSPORT_TIMEOUT);
-        if (ret < 0) {
-            msgtype = NC_MSG_ERROR;
-            goto cleanup;
-        } else if (!ret) {
-            msgtype = NC_MSG_WOULDBLOCK;
-            goto cleanup;
+    /* down */
+    while ((child = 2 * idx + 1) < sched->heap_count) {
+        if ((child + 1 < sched->heap_count) && nc_ch_sched_heap_before(sched->heap[child + 1], sched->heap[child])) {
+            ++child;
         }
-    } else
-#endif
-    if (server_opts.endpts[bind_idx].ti == NC_TI_UNIX) {
-        (*session)->data = server_opts.endpts[bind_idx].opts.unixsock;
-        ret = nc_accept_unix(*session, sock);
-        if (ret < 0) {
-            msgtype = NC_MSG_ERROR;
-            goto cleanup;
+        if (!nc_ch_sched_heap_before(sched->heap[child], job)) {
+            break;
         }
-    } else {
-        ERRINT;
-        close(sock);
-        msgtype = NC_MSG_ERROR;
-        goto cleanup;
+        nc_ch_sched_heap_set(sched, idx, sched->heap[child]);
+        idx = child;
     }
 
-    (*session)->data = NULL;
+    nc_ch_sched_heap_set(sched, idx, job);
+}
 
-    /* ENDPT UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+/**
+ * @brief Remove a waiting job from the timer queue.
+ *
+ * @param[in] sched Call Home scheduler.
+ * @param[in] job Waiting job.
+ */
+static void
+nc_ch_sched_heap_remove(struct nc_ch_sched *sched, struct nc_ch_job *job)
+{
+    uint32_t idx = job->heap_idx;
 
-    /* assign new SID atomically */
-    (*session)->id = ATOMIC_INC_RELAXED(server_opts.new_session_id);
+    --sched->heap_count;
+    if (idx < sched->heap_count) {
+        nc_ch_sched_heap_set(sched, idx, sched->heap[sched->heap_count]);
+        nc_ch_sched_heap_fix(sched, idx);
+    }
+}
 
-    /* NETCONF handshake */
-    msgtype = nc_handshake_io(*session);
-    if (msgtype != NC_MSG_HELLO) {
-        nc_session_free(*session, NULL);
-        *session = NULL;
-        return msgtype;
+/**
+ * @brief Interrupt the scheduler thread waiting so that it learns about a new due time or socket.
+ *
+ * @param[in] sched Call Home scheduler.
+ */
+static void
+nc_ch_sched_wake(struct nc_ch_sched *sched)
+{
+    char c = 0;
+
+    if (write(sched->wakefd[1], &c, 1) == -1) {
+        /* the pipe is full so the thread will wake up anyway */
     }
+}
 
-    nc_gettimespec_mono_add(&ts_cur, 0);
-    (*session)->opts.server.last_rpc = ts_cur.tv_sec;
-    nc_gettimespec_real_add(&ts_cur, 0);
-    (*session)->opts.server.session_start = ts_cur.tv_sec;
-    (*session)->status = NC_STATUS_RUNNING;
+/**
+ * @brief Let a job wait for its due time in the timer queue. Scheduler lock is expected to be held.
+ *
+ * @param[in] sched Call Home scheduler.
+ * @param[in] job Job to wait, there is always space for it in the timer queue.
+ */
+static void
+nc_ch_sched_wait(struct nc_ch_sched *sched, struct nc_ch_job *job)
+{
+    job->state = NC_CH_JOB_WAIT;
+    nc_ch_sched_heap_set(sched, sched->heap_count++, job);
+    nc_ch_sched_heap_fix(sched, job->heap_idx);
+    nc_ch_sched_wake(sched);
+}
 
-    return msgtype;
+/**
+ * @brief Make a job perform its next step right away. Scheduler lock is expected to be held.
+ *
+ * @param[in] sched Call Home scheduler.
+ * @param[in] job Job to use.
+ */
+static void
+nc_ch_sched_job_now(struct nc_ch_sched *sched, struct nc_ch_job *job)
+{
+    if (job->state == NC_CH_JOB_WAIT) {
+        nc_gettimespec_mono_add(&job->ts_due, 0);
+        nc_ch_sched_heap_fix(sched, job->heap_idx);
+        nc_ch_sched_wake(sched);
+    } else {
+        /* the step is queued or in progress, perform another one after it */
+        job->again = 1;
+    }
+}
 
-cleanup:
-    /* ENDPT UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+/**
+ * @brief Queue a job for a worker. Scheduler lock is expected to be held.
+ *
+ * @param[in] sched Call Home scheduler.
+ * @param[in] job Job not waiting in the timer queue.
+ */
+static void
+nc_ch_sched_queue(struct nc_ch_sched *sched, struct nc_ch_job *job)
+{
+    job->state = NC_CH_JOB_QUEUED;
+    job->next = NULL;
+    if (sched->queue_tail) {
+        sched->queue_tail->next = job;
+    } else {
+        sched->queue_head = job;
+    }
+    sched->queue_tail = job;
+    pthread_cond_signal(&sched->job_cond);
+}
 
-    nc_session_free(*session, NULL);
-    *session = NULL;
-    return msgtype;
+/**
+ * @brief Free the starting session of a job and release its context.
+ *
+ * @param[in] job Job with a starting session.
+ */
+static void
+nc_ch_job_starting_free(struct nc_ch_job *job)
+{
+    nc_session_free(job->starting, NULL);
+    job->starting = NULL;
+    job->release_ctx_cb(job->ctx_cb_data);
 }
 
-#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+static void
+nc_ch_job_free(struct nc_ch_job *job)
+{
+    if (!job) {
+        return;
+    }
 
-/* client is expected to be locked */
+    if (job->starting) {
+        nc_ch_job_starting_free(job);
+    }
+    free(job->client_name);
+    free(job->endpt_name);
+    free(job);
+}
+
+/**
+ * @brief Check the established session of a job, stop tracking it once it is not running.
+ *
+ * The job is woken by nc_ch_sched_session_free() once the session is freed so it needs to be checked only
+ * for the idle timeout.
+ *
+ * @param[in] sched Call Home scheduler.
+ * @param[in] job Job with an established session.
+ * @param[in] idle_timeout Idle timeout of the session in seconds, 0 for none.
+ * @param[out] delay Delay of the next check in msec if the session is running.
+ * @return 0 if the session is running, 1 if it terminated.
+ */
 static int
-_nc_server_ch_client_del_endpt(struct nc_ch_client *client, const char *endpt_name, NC_TRANSPORT_IMPL ti)
+nc_ch_job_session_check(struct nc_ch_sched *sched, struct nc_ch_job *job, uint16_t idle_timeout, uint32_t *delay)
 {
-    uint16_t i;
-    int ret = -1;
-
-    if (!endpt_name) {
-        /* remove all endpoints */
-        for (i = 0; i < client->ch_endpt_count; ++i) {
-            free(client->ch_endpts[i].name);
-            free(client->ch_endpts[i].address);
-            if (client->ch_endpts[i].sock_pending != -1) {
-                close(client->ch_endpts[i].sock_pending);
-            }
-            switch (client->ch_endpts[i].ti) {
-#ifdef NC_ENABLED_SSH
-            case NC_TI_LIBSSH:
-                nc_server_ssh_clear_opts(client->ch_endpts[i].opts.ssh);
-                free(client->ch_endpts[i].opts.ssh);
-                break;
-#endif
-#ifdef NC_ENABLED_TLS
-            case NC_TI_OPENSSL:
-                nc_server_tls_clear_opts(client->ch_endpts[i].opts.tls);
-                free(client->ch_endpts[i].opts.tls);
-                break;
-#endif
-            default:
-                ERRINT;
-                /* won't get here ...*/
-                break;
-            }
-        }
-        free(client->ch_endpts);
-        client->ch_endpts = NULL;
-        client->ch_endpt_count = 0;
+    struct nc_session *session;
+    struct timespec ts;
+    int terminated = 1;
 
-        ret = 0;
-    } else {
-        for (i = 0; i < client->ch_endpt_count; ++i) {
-            if (!strcmp(client->ch_endpts[i].name, endpt_name) && (!ti || (ti == client->ch_endpts[i].ti))) {
-                free(client->ch_endpts[i].name);
-                free(client->ch_endpts[i].address);
-                if (client->ch_endpts[i].sock_pending != -1) {
-                    close(client->ch_endpts[i].sock_pending);
-                }
-                switch (client->ch_endpts[i].ti) {
-#ifdef NC_ENABLED_SSH
-                case NC_TI_LIBSSH:
-                    nc_server_ssh_clear_opts(client->ch_endpts[i].opts.ssh);
-                    free(client->ch_endpts[i].opts.ssh);
-                    break;
-#endif
-#ifdef NC_ENABLED_TLS
-                case NC_TI_OPENSSL:
-                    nc_server_tls_clear_opts(client->ch_endpts[i].opts.tls);
-                    free(client->ch_endpts[i].opts.tls);
-                    break;
-#endif
-                default:
-                    ERRINT;
-                    /* won't get here ...*/
-                    break;
-                }
+    *delay = NC_CH_SCHED_MAX_WAIT;
 
-                /* move last endpoint to the empty space */
-                --client->ch_endpt_count;
-                if (i < client->ch_endpt_count) {
-                    memcpy(&client->ch_endpts[i], &client->ch_endpts[client->ch_endpt_count], sizeof *client->ch_endpts);
-                } else if (!server_opts.ch_client_count) {
-                    free(server_opts.ch_clients);
-                    server_opts.ch_clients = NULL;
-                }
+    /* SCHED LOCK */
+    pthread_mutex_lock(&sched->lock);
 
-                ret = 0;
-                break;
-            }
+    session = job->session;
+    if (session && (session->status == NC_STATUS_RUNNING)) {
+        nc_gettimespec_mono_add(&ts, 0);
+        if (!idle_timeout) {
+            terminated = 0;
+        } else if (nc_session_get_notif_status(session)) {
+            /* idle timeout does not apply while subscribed, check again later */
+            *delay = idle_timeout * 1000;
+            terminated = 0;
+        } else if (ts.tv_sec >= session->opts.server.last_rpc + idle_timeout) {
+            VRB(session, "Call Home client \"%s\": session idle timeout elapsed.", job->client_name);
+            session->status = NC_STATUS_INVALID;
+            session->term_reason = NC_SESSION_TERM_TIMEOUT;
+        } else {
+            /* when the idle timeout would elapse without any new RPC */
+            *delay = (session->opts.server.last_rpc + idle_timeout - ts.tv_sec) * 1000;
+            terminated = 0;
         }
     }
 
-    return ret;
+    if (terminated && session) {
+        session->flags &= ~NC_SESSION_CH_THREAD;
+        job->session = NULL;
+    }
+
+    /* SCHED UNLOCK */
+    pthread_mutex_unlock(&sched->lock);
+
+    return terminated;
 }
 
-API int
-nc_server_ch_add_client(const char *name)
+/**
+ * @brief Stop tracking the established session of a job that finishes.
+ *
+ * @param[in] sched Call Home scheduler.
+ * @param[in] job Finishing job.
+ */
+static void
+nc_ch_job_session_detach(struct nc_ch_sched *sched, struct nc_ch_job *job)
 {
-    uint16_t i;
-    struct nc_ch_client *client;
+    /* SCHED LOCK */
+    pthread_mutex_lock(&sched->lock);
 
-    if (!name) {
-        ERRARG("name");
-        return -1;
+    if (job->session) {
+        VRB(job->session, "Call Home client \"%s\" removed, but an established session will not be terminated.",
+                job->client_name);
+        job->session->flags &= ~NC_SESSION_CH_THREAD;
+        job->session = NULL;
     }
 
-    /* WRITE LOCK */
-    pthread_rwlock_wrlock(&server_opts.ch_client_lock);
+    /* SCHED UNLOCK */
+    pthread_mutex_unlock(&sched->lock);
+}
 
-    /* check name uniqueness */
-    for (i = 0; i < server_opts.ch_client_count; ++i) {
-        if (!strcmp(server_opts.ch_clients[i].name, name)) {
-            ERR(NULL, "Call Home client \"%s\" already exists.", name);
-            /* WRITE UNLOCK */
-            pthread_rwlock_unlock(&server_opts.ch_client_lock);
-            return -1;
+/**
+ * @brief Get the current endpoint of a job, select the first one if it was removed.
+ *
+ * @param[in] job Job connecting a client.
+ * @param[in] client Locked client with some endpoints.
+ * @param[out] idx Index of the endpoint.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_ch_job_endpt(struct nc_ch_job *job, struct nc_ch_client *client, uint16_t *idx)
+{
+    if (job->endpt_name) {
+        for (*idx = 0; *idx < client->ch_endpt_count; ++*idx) {
+            if (!strcmp(client->ch_endpts[*idx].name, job->endpt_name)) {
+                return 0;
+            }
         }
+
+        /* endpoint was removed, start with the first one */
+        VRB(NULL, "Call Home client \"%s\" endpoint \"%s\" removed.", job->client_name, job->endpt_name);
+        job->attempts = 0;
+        job->sock = -1;
     }
 
-    ++server_opts.ch_client_count;
-    server_opts.ch_clients = nc_realloc(server_opts.ch_clients, server_opts.ch_client_count * sizeof *server_opts.ch_clients);
-    if (!server_opts.ch_clients) {
+    *idx = 0;
+    free(job->endpt_name);
+    job->endpt_name = strdup(client->ch_endpts[0].name);
+    if (!job->endpt_name) {
         ERRMEM;
-        /* WRITE UNLOCK */
-        pthread_rwlock_unlock(&server_opts.ch_client_lock);
         return -1;
     }
-    client = &server_opts.ch_clients[server_opts.ch_client_count - 1];
-
-    client->name = strdup(name);
-    client->id = ATOMIC_INC_RELAXED(server_opts.new_client_id);
-    client->ch_endpts = NULL;
-    client->ch_endpt_count = 0;
-    client->conn_type = 0;
-
-    /* set CH default options */
-    client->start_with = NC_CH_FIRST_LISTED;
-    client->max_attempts = 3;
-
-    pthread_mutex_init(&client->lock, NULL);
-
-    /* WRITE UNLOCK */
-    pthread_rwlock_unlock(&server_opts.ch_client_lock);
-
     return 0;
 }
 
-API int
-nc_server_ch_del_client(const char *name)
+/**
+ * @brief Set the current endpoint of a job.
+ *
+ * @param[in] job Job connecting a client.
+ * @param[in] client Locked client.
+ * @param[in] idx Index of the new current endpoint.
+ */
+static void
+nc_ch_job_set_endpt(struct nc_ch_job *job, struct nc_ch_client *client, uint16_t idx)
 {
-    uint16_t i;
-    int ret = -1;
-
-    /* WRITE LOCK */
-    pthread_rwlock_wrlock(&server_opts.ch_client_lock);
+    free(job->endpt_name);
+    job->endpt_name = strdup(client->ch_endpts[idx].name);
+    if (!job->endpt_name) {
+        /* the first endpoint will be used */
+        ERRMEM;
+    }
+}
 
-    if (!name) {
-        /* remove all CH clients with endpoints */
-        for (i = 0; i < server_opts.ch_client_count; ++i) {
-            free(server_opts.ch_clients[i].name);
+/**
+ * @brief Handle the termination of the established session of a job.
+ *
+ * Persistent connection immediately tries to reconnect, periodic connects at specific times.
+ *
+ * @param[in] job Job to reconnect.
+ * @param[in] client Locked client.
+ * @return Delay of the reconnect in msec.
+ */
+static uint32_t
+nc_ch_job_session_terminated(struct nc_ch_job *job, struct nc_ch_client *client)
+{
+    uint32_t reconnect_in;
+    uint16_t idx;
 
-            /* remove all endpoints */
-            _nc_server_ch_client_del_endpt(&server_opts.ch_clients[i], NULL, 0);
+    VRB(NULL, "Call Home client \"%s\" session terminated.", job->client_name);
+    job->established = 0;
+    job->attempts = 0;
 
-            pthread_mutex_destroy(&server_opts.ch_clients[i].lock);
-            ret = 0;
+    if (client->conn_type == NC_CH_PERIOD) {
+        if (client->conn.period.anchor_time) {
+            /* anchored */
+            reconnect_in = (time(NULL) - client->conn.period.anchor_time) % (client->conn.period.period * 60);
+        } else {
+            /* fixed timeout */
+            reconnect_in = client->conn.period.period * 60;
         }
-        free(server_opts.ch_clients);
-        server_opts.ch_clients = NULL;
-
-        server_opts.ch_client_count = 0;
-
+        VRB(NULL, "Call Home client \"%s\" reconnecting in %" PRIu32 " seconds.", job->client_name, reconnect_in);
+        reconnect_in *= 1000;
     } else {
-        /* remove one client with endpoints */
-        for (i = 0; i < server_opts.ch_client_count; ++i) {
-            if (!strcmp(server_opts.ch_clients[i].name, name)) {
-                free(server_opts.ch_clients[i].name);
-
-                /* remove all endpoints */
-                _nc_server_ch_client_del_endpt(&server_opts.ch_clients[i], NULL, 0);
-
-                pthread_mutex_destroy(&server_opts.ch_clients[i].lock);
-
-                /* move last client and endpoint(s) to the empty space */
-                --server_opts.ch_client_count;
-                if (i < server_opts.ch_client_count) {
-                    memcpy(&server_opts.ch_clients[i], &server_opts.ch_clients[server_opts.ch_client_count],
-                            sizeof *server_opts.ch_clients);
-                } else if (!server_opts.ch_client_count) {
-                    free(server_opts.ch_clients);
-                    server_opts.ch_clients = NULL;
-                }
-
-                ret = 0;
-                break;
-            }
-        }
+        /* spread the reconnects of the clients of a restarted peer */
+        reconnect_in = nc_ch_jitter(job, NC_CH_RECONNECT_JITTER);
+    }
+
+    /* set next endpoint to try */
+    if (!client->ch_endpt_count) {
+        /* the first one once some are defined */
+        free(job->endpt_name);
+        job->endpt_name = NULL;
+    } else if (client->start_with == NC_CH_FIRST_LISTED) {
+        nc_ch_job_set_endpt(job, client, 0);
+    } else if (client->start_with == NC_CH_LAST_CONNECTED) {
+        /* we keep the current one, it is found again before connecting */
+    } else {
+        /* just get a random index */
+        idx = rand_r(&job->seed) % client->ch_endpt_count;
+        nc_ch_job_set_endpt(job, client, idx);
     }
 
-    /* WRITE UNLOCK */
-    pthread_rwlock_unlock(&server_opts.ch_client_lock);
-
-    return ret;
+    return reconnect_in;
 }
 
-API int
-nc_server_ch_is_client(const char *name)
+/**
+ * @brief Handle a failed connection attempt of a job.
+ *
+ * @param[in] job Job connecting a client.
+ * @param[in] client Locked client.
+ * @param[in] idx Index of the current endpoint.
+ * @return Delay of the next attempt in msec.
+ */
+static uint32_t
+nc_ch_job_connect_failed(struct nc_ch_job *job, struct nc_ch_client *client, uint16_t idx)
 {
-    uint16_t i;
-    int found = 0;
+    struct nc_ch_endpt *endpt = &client->ch_endpts[idx];
 
-    if (!name) {
-        return found;
-    }
+    job->sock = -1;
+    ++job->attempts;
 
-    /* READ LOCK */
-    pthread_rwlock_rdlock(&server_opts.ch_client_lock);
+    if (job->attempts == client->max_attempts) {
+        /* we have tried to connect to this endpoint enough times */
+        VRB(NULL, "Call Home client \"%s\" endpoint \"%s\" failed connection attempt limit %" PRIu8 " reached.",
+                job->client_name, job->endpt_name, client->max_attempts);
 
-    /* check name uniqueness */
-    for (i = 0; i < server_opts.ch_client_count; ++i) {
-        if (!strcmp(server_opts.ch_clients[i].name, name)) {
-            found = 1;
-            break;
+        /* clear a pending socket, if any */
+        if (endpt->sock_pending > -1) {
+            close(endpt->sock_pending);
+            endpt->sock_pending = -1;
         }
-    }
 
-    /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.ch_client_lock);
+        if (idx < client->ch_endpt_count - 1) {
+            /* just go to the next endpoint */
+            ++idx;
+        } else {
+            /* cur_endpoint is the last, start with the first one */
+            idx = 0;
+        }
+        nc_ch_job_set_endpt(job, client, idx);
+        job->attempts = 0;
+    } /* else we keep the current one */
 
-    return found;
+    /* back off with some randomness so that the failed clients do not retry all at once */
+    return NC_CH_ENDPT_BACKOFF_WAIT * 1000 + nc_ch_jitter(job, NC_CH_ENDPT_BACKOFF_WAIT * 500);
 }
 
-API int
-nc_server_ch_client_add_endpt(const char *client_name, const char *endpt_name, NC_TRANSPORT_IMPL ti)
+/**
+ * @brief Start a session on a connected socket of an endpoint, its handshake is performed by nc_ch_job_handshake().
+ *
+ * @param[in] job Job connecting a client.
+ * @param[in] endpt Endpoint of the locked client.
+ * @param[in] sock Connected socket, it gets assigned to the session or closed.
+ * @param[in] ip_host Connected host, it gets assigned to the session or freed.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_ch_job_session_start(struct nc_ch_job *job, struct nc_ch_endpt *endpt, int sock, char *ip_host)
 {
-    uint16_t i;
-    struct nc_ch_client *client;
-    struct nc_ch_endpt *endpt;
+    const struct ly_ctx *ctx;
+    struct nc_session *session;
+    struct nc_handshake *hs;
     int ret = -1;
 
-    if (!client_name) {
-        ERRARG("client_name");
-        return -1;
-    } else if (!endpt_name) {
-        ERRARG("endpt_name");
-        return -1;
-    } else if (!ti) {
-        ERRARG("ti");
+    /* acquire context */
+    ctx = job->acquire_ctx_cb(job->ctx_cb_data);
+    if (!ctx) {
+        ERR(NULL, "Failed to acquire context for a new Call Home session.");
+        close(sock);
+        free(ip_host);
         return -1;
     }
 
-    /* LOCK */
-    nc_server_ch_client_lock(client_name, NULL, 0, &client);
-    if (!client) {
+    /* create session */
+    session = nc_new_session(NC_SERVER);
+    hs = calloc(1, sizeof *hs);
+    if (!session || !hs) {
+        ERRMEM;
+        close(sock);
+        free(ip_host);
+        free(hs);
+        nc_session_free(session, NULL);
+        job->release_ctx_cb(job->ctx_cb_data);
         return -1;
     }
+    session->status = NC_STATUS_STARTING;
+    session->ctx = (struct ly_ctx *)ctx;
+    session->flags = NC_SESSION_SHAREDCTX;
+    session->host = ip_host;
+    session->port = endpt->port;
+    session->opts.server.handshake = hs;
+    job->starting = session;
 
-    for (i = 0; i < client->ch_endpt_count; ++i) {
-        if (!strcmp(client->ch_endpts[i].name, endpt_name)) {
-            ERR(NULL, "Call Home client \"%s\" endpoint \"%s\" already exists.", client_name, endpt_name);
-            goto cleanup;
-        }
+    hs->stage = NC_HANDSHAKE_TRANSPORT;
+    hs->has_timeout = 1;
+    nc_gettimespec_mono_add(&hs->ts_timeout, NC_TRANSPORT_TIMEOUT);
+    hs->pending = 1;
+
+    /* sock gets assigned to session or closed */
+#ifdef NC_ENABLED_SSH
+    if (endpt->ti == NC_TI_LIBSSH) {
+        session->data = endpt->opts.ssh;
+        ret = nc_accept_ssh_session_start(session, sock);
+    } else
+#endif
+#ifdef NC_ENABLED_TLS
+    if (endpt->ti == NC_TI_OPENSSL) {
+        session->data = endpt->opts.tls;
+        ret = nc_accept_tls_session_start(session, sock);
+    } else
+#endif
+    {
+        ERRINT;
+        close(sock);
     }
+    session->data = NULL;
 
-    ++client->ch_endpt_count;
-    client->ch_endpts = realloc(client->ch_endpts, client->ch_endpt_count * sizeof *client->ch_endpts);
-    if (!client->ch_endpts) {
-        ERRMEM;
-        goto cleanup;
+    if (ret < 0) {
+        nc_ch_job_starting_free(job);
+        return -1;
     }
-    endpt = &client->ch_endpts[client->ch_endpt_count - 1];
+    return 0;
+}
 
-    memset(endpt, 0, sizeof *client->ch_endpts);
-    endpt->name = strdup(endpt_name);
-    endpt->ti = ti;
-    endpt->sock_pending = -1;
-    endpt->ka.idle_time = 1;
-    endpt->ka.max_probes = 10;
-    endpt->ka.probe_interval = 5;
+/**
+ * @brief Advance the handshake of the starting session of a job as far as possible without blocking.
+ *
+ * @param[in] job Job with a starting session.
+ * @param[in] endpt Endpoint of the locked client the session is connected to.
+ * @param[out] session Established session on success.
+ * @return 1 if the handshake is still in progress, its due time and socket are set;
+ * @return 0 if the session was established;
+ * @return -1 if the handshake failed and the session was freed.
+ */
+static int
+nc_ch_job_handshake(struct nc_ch_job *job, struct nc_ch_endpt *endpt, struct nc_session **session)
+{
+    struct nc_handshake *hs = job->starting->opts.server.handshake;
+    NC_MSG_TYPE msgtype;
 
-    switch (ti) {
+    /* the transport steps use the options of the Call Home endpoint */
 #ifdef NC_ENABLED_SSH
-    case NC_TI_LIBSSH:
-        endpt->opts.ssh = calloc(1, sizeof(struct nc_server_ssh_opts));
-        if (!endpt->opts.ssh) {
-            ERRMEM;
-            goto cleanup;
-        }
-        endpt->opts.ssh->auth_methods = NC_SSH_AUTH_PUBLICKEY | NC_SSH_AUTH_PASSWORD;
-        endpt->opts.ssh->auth_attempts = 3;
-        endpt->opts.ssh->auth_timeout = 30;
-        break;
+    if (endpt->ti == NC_TI_LIBSSH) {
+        hs->ti_opts = endpt->opts.ssh;
+    }
 #endif
 #ifdef NC_ENABLED_TLS
-    case NC_TI_OPENSSL:
-        endpt->opts.tls = calloc(1, sizeof(struct nc_server_tls_opts));
-        if (!endpt->opts.tls) {
-            ERRMEM;
-            goto cleanup;
-        }
-        break;
+    if (endpt->ti == NC_TI_OPENSSL) {
+        hs->ti_opts = endpt->opts.tls;
+    }
 #endif
-    default:
-        ERRINT;
-        goto cleanup;
+
+    msgtype = nc_session_handshake(job->starting);
+    if (msgtype == NC_MSG_NONE) {
+        /* wait for more data or the stage timeout */
+        hs->ti_opts = NULL;
+        job->sock = nc_session_ti_fd(job->starting);
+        job->sock_events = POLLIN;
+        if (hs->has_timeout) {
+            job->ts_due = hs->ts_timeout;
+        } else {
+            nc_gettimespec_mono_add(&job->ts_due, NC_CH_SCHED_MAX_WAIT);
+        }
+        return 1;
     }
 
-    /* success */
-    ret = 0;
+    job->sock = -1;
+    if (msgtype != NC_MSG_HELLO) {
+        nc_ch_job_starting_free(job);
+        return -1;
+    }
 
-cleanup:
-    /* UNLOCK */
-    nc_server_ch_client_unlock(client);
+    *session = job->starting;
+    job->starting = NULL;
+    return 0;
+}
 
-    return ret;
+/**
+ * @brief Find the endpoint of the starting session of a job.
+ *
+ * @param[in] job Job with a starting session.
+ * @param[in] client Locked client.
+ * @param[out] idx Index of the endpoint.
+ * @return 0 on success, -1 if the endpoint was removed or changed.
+ */
+static int
+nc_ch_job_starting_endpt(struct nc_ch_job *job, struct nc_ch_client *client, uint16_t *idx)
+{
+    for (*idx = 0; *idx < client->ch_endpt_count; ++*idx) {
+        if (!strcmp(client->ch_endpts[*idx].name, job->endpt_name)) {
+            return (client->ch_endpts[*idx].ti == job->starting->ti_type) ? 0 : -1;
+        }
+    }
+    return -1;
 }
 
-API int
-nc_server_ch_client_del_endpt(const char *client_name, const char *endpt_name, NC_TRANSPORT_IMPL ti)
+/**
+ * @brief Perform the next step of a job, connect its client, advance the handshake of its starting session,
+ * or check its established session.
+ *
+ * None of the steps blocks so the client is locked only briefly.
+ *
+ * @param[in] sched Call Home scheduler.
+ * @param[in] job Job owned by the calling worker, its next due time is set.
+ * @return 0 if the job continues, 1 if it finished.
+ */
+static int
+nc_ch_job_step(struct nc_ch_sched *sched, struct nc_ch_job *job)
 {
-    int ret;
     struct nc_ch_client *client;
+    struct nc_ch_endpt *endpt;
+    struct nc_session *session = NULL;
+    uint32_t delay = NC_CH_SCHED_MAX_WAIT;
+    uint16_t idx;
+    char *ip_host = NULL;
+    int sock, r;
 
-    if (!client_name) {
-        ERRARG("client_name");
-        return -1;
+    /* LOCK */
+    nc_server_ch_client_lock(job->client_name, NULL, 0, &client);
+    if (!client || (job->client_id && (client->id != job->client_id))) {
+        if (client) {
+            /* UNLOCK */
+            nc_server_ch_client_unlock(client);
+        }
+
+        /* client was removed, finish the job */
+        nc_ch_job_session_detach(sched, job);
+        return 1;
     }
+    job->client_id = client->id;
 
-    /* LOCK */
-    nc_server_ch_client_lock(client_name, NULL, 0, &client);
-    if (!client) {
-        return -1;
+    if (job->established) {
+        if (!nc_ch_job_session_check(sched, job,
+                (client->conn_type == NC_CH_PERIOD) ? client->conn.period.idle_timeout : 0, &delay)) {
+            /* still running */
+            goto unlock;
+        }
+
+        delay = nc_ch_job_session_terminated(job, client);
+        goto unlock;
     }
 
-    ret = _nc_server_ch_client_del_endpt(client, endpt_name, ti);
+    if (job->starting) {
+        /* handshake in progress */
+        if (!nc_ch_job_starting_endpt(job, client, &idx)) {
+            endpt = &client->ch_endpts[idx];
+            goto handshake;
+        }
+
+        ERR(job->starting, "Call Home client \"%s\" endpoint \"%s\" of the starting session was removed.",
+                job->client_name, job->endpt_name);
+        nc_ch_job_starting_free(job);
+        job->sock = -1;
+    }
+
+    if (!client->ch_endpt_count) {
+        /* no endpoints defined yet, the job is woken once they are */
+        goto unlock;
+    }
+    if (nc_ch_job_endpt(job, client, &idx)) {
+        delay = NC_CH_ENDPT_BACKOFF_WAIT * 1000;
+        goto unlock;
+    }
+    endpt = &client->ch_endpts[idx];
+
+    if (!job->attempts && (job->sock == -1)) {
+        VRB(NULL, "Call Home client \"%s\" endpoint \"%s\" connecting...", job->client_name, job->endpt_name);
+    }
+
+    /* never blocks, a pending socket is returned to be waited on */
+    sock = nc_sock_connect(endpt->address, endpt->port, 0, &endpt->ka, &endpt->sock_pending, &ip_host);
+    if (sock > -1) {
+        job->sock = -1;
+        if (nc_ch_job_session_start(job, endpt, sock, ip_host)) {
+            delay = nc_ch_job_connect_failed(job, client, idx);
+            goto unlock;
+        }
+        goto handshake;
+    } else if ((endpt->sock_pending > -1) && ((job->sock == -1) || (nc_difftimespec_mono_cur(&job->ts_due) > 0))) {
+        /* connecting, wait until the socket is writable or the connect timeout elapses */
+        if (job->sock == -1) {
+            nc_gettimespec_mono_add(&job->ts_due, NC_CH_CONNECT_TIMEOUT);
+        }
+        job->sock = endpt->sock_pending;
+        job->sock_events = POLLOUT;
+
+        /* UNLOCK */
+        nc_server_ch_client_unlock(client);
+        return 0;
+    } else {
+        delay = nc_ch_job_connect_failed(job, client, idx);
+        goto unlock;
+    }
+
+handshake:
+    r = nc_ch_job_handshake(job, endpt, &session);
+    if (r == 1) {
+        /* UNLOCK */
+        nc_server_ch_client_unlock(client);
+        return 0;
+    } else if (r == -1) {
+        delay = nc_ch_job_connect_failed(job, client, idx);
+    }
 
+unlock:
     /* UNLOCK */
     nc_server_ch_client_unlock(client);
 
-    return ret;
+    if (session) {
+        VRB(NULL, "Call Home client \"%s\" session %u established.", job->client_name, session->id);
+
+        /* SCHED LOCK */
+        pthread_mutex_lock(&sched->lock);
+        session->flags |= NC_SESSION_CH_THREAD;
+        job->session = session;
+        job->established = 1;
+        job->attempts = 0;
+        /* SCHED UNLOCK */
+        pthread_mutex_unlock(&sched->lock);
+
+        /* give the session to the user */
+        if (job->new_session_cb(job->client_name, session)) {
+            /* something is wrong, free the session and release its context, the client is reconnected */
+            nc_session_free(session, NULL);
+            job->release_ctx_cb(job->ctx_cb_data);
+        } else {
+            /* check the idle timeout, if any, once it could elapse */
+            delay = 0;
+        }
+    }
+
+    nc_gettimespec_mono_add(&job->ts_due, delay);
+    return 0;
 }
 
-API int
-nc_server_ch_client_is_endpt(const char *client_name, const char *endpt_name)
+static void *
+nc_ch_sched_worker_thread(void *arg)
 {
-    uint16_t i;
-    struct nc_ch_client *client = NULL;
-    int found = 0;
-
-    if (!client_name || !endpt_name) {
-        return found;
-    }
+    struct nc_ch_sched *sched = arg;
+    struct nc_ch_job *job;
+    uint32_t i;
+    int finished;
 
-    /* READ LOCK */
-    pthread_rwlock_rdlock(&server_opts.ch_client_lock);
+    while (1) {
+        /* SCHED LOCK */
+        pthread_mutex_lock(&sched->lock);
 
-    for (i = 0; i < server_opts.ch_client_count; ++i) {
-        if (!strcmp(server_opts.ch_clients[i].name, client_name)) {
-            client = &server_opts.ch_clients[i];
+        while (!sched->queue_head && !sched->stop) {
+            pthread_cond_wait(&sched->job_cond, &sched->lock);
+        }
+        if (sched->stop) {
+            /* SCHED UNLOCK */
+            pthread_mutex_unlock(&sched->lock);
             break;
         }
-    }
-
-    if (!client) {
-        goto cleanup;
-    }
 
-    for (i = 0; i < client->ch_endpt_count; ++i) {
-        if (!strcmp(client->ch_endpts[i].name, endpt_name)) {
-            found = 1;
-            break;
+        job = sched->queue_head;
+        sched->queue_head = job->next;
+        if (!sched->queue_head) {
+            sched->queue_tail = NULL;
         }
-    }
+        job->state = NC_CH_JOB_BUSY;
+        job->again = 0;
 
-cleanup:
-    /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.ch_client_lock);
-    return found;
-}
+        /* SCHED UNLOCK */
+        pthread_mutex_unlock(&sched->lock);
 
-API int
-nc_server_ch_client_endpt_set_address(const char *client_name, const char *endpt_name, const char *address)
-{
-    struct nc_ch_client *client;
-    struct nc_ch_endpt *endpt;
+        /* only this thread works with the job */
+        finished = nc_ch_job_step(sched, job);
 
-    if (!client_name) {
-        ERRARG("client_name");
-        return -1;
-    } else if (!endpt_name) {
-        ERRARG("endpt_name");
-        return -1;
-    } else if (!address) {
-        ERRARG("address");
-        return -1;
-    }
+        /* SCHED LOCK */
+        pthread_mutex_lock(&sched->lock);
 
-    /* LOCK */
-    endpt = nc_server_ch_client_lock(client_name, endpt_name, 0, &client);
-    if (!endpt) {
-        return -1;
-    }
+        if (finished) {
+            for (i = 0; sched->jobs[i] != job; ++i) {}
+            sched->jobs[i] = sched->jobs[--sched->job_count];
+        } else {
+            if (job->again) {
+                /* the session was freed, reconnect right away */
+                nc_gettimespec_mono_add(&job->ts_due, 0);
+            }
+            nc_ch_sched_wait(sched, job);
+        }
 
-    free(endpt->address);
-    endpt->address = strdup(address);
+        /* SCHED UNLOCK */
+        pthread_mutex_unlock(&sched->lock);
 
-    /* UNLOCK */
-    nc_server_ch_client_unlock(client);
+        if (finished) {
+            VRB(NULL, "Call Home client \"%s\" no longer scheduled.", job->client_name);
+            nc_ch_job_free(job);
+        }
+    }
 
-    return 0;
+    return NULL;
 }
 
-API int
-nc_server_ch_client_endpt_set_port(const char *client_name, const char *endpt_name, uint16_t port)
+/**
+ * @brief Get the poll timeout until the first job is due. Scheduler lock is expected to be held.
+ *
+ * @param[in] sched Call Home scheduler with no due job in the timer queue.
+ * @return Timeout in msec.
+ */
+static int
+nc_ch_sched_timeout(struct nc_ch_sched *sched)
 {
-    struct nc_ch_client *client;
-    struct nc_ch_endpt *endpt;
+    struct timespec ts_cur;
+    int64_t diff;
 
-    if (!client_name) {
-        ERRARG("client_name");
-        return -1;
-    } else if (!endpt_name) {
-        ERRARG("endpt_name");
-        return -1;
-    } else if (!port) {
-        ERRARG("port");
+    if (!sched->heap_count) {
         return -1;
     }
 
-    /* LOCK */
-    endpt = nc_server_ch_client_lock(client_name, endpt_name, 0, &client);
-    if (!endpt) {
-        return -1;
+    nc_gettimespec_mono_add(&ts_cur, 0);
+    diff = ((int64_t)sched->heap[0]->ts_due.tv_sec - ts_cur.tv_sec) * 1000 +
+            (sched->heap[0]->ts_due.tv_nsec - ts_cur.tv_nsec) / 1000000 + 1;
+    if (diff > NC_CH_SCHED_MAX_WAIT) {
+        diff = NC_CH_SCHED_MAX_WAIT;
     }
+    return diff < 0 ? 0 : diff;
+}
 
-    endpt->port = port;
+static void *
+nc_ch_sched_thread(void *arg)
+{
+    struct nc_ch_sched *sched = arg;
+    struct nc_ch_job *job;
+    struct pollfd *pfds;
+    struct nc_ch_job **pjobs;
+    char buf[64];
+    uint32_t i, count;
+    int timeout, ret;
 
-    /* UNLOCK */
-    nc_server_ch_client_unlock(client);
+    while (1) {
+        /* SCHED LOCK */
+        pthread_mutex_lock(&sched->lock);
+        if (sched->stop) {
+            /* SCHED UNLOCK */
+            pthread_mutex_unlock(&sched->lock);
+            break;
+        }
 
-    return 0;
-}
+        /* queue all the due jobs */
+        while (sched->heap_count && (nc_difftimespec_mono_cur(&sched->heap[0]->ts_due) < 1)) {
+            job = sched->heap[0];
+            nc_ch_sched_heap_remove(sched, job);
+            nc_ch_sched_queue(sched, job);
+        }
+        timeout = nc_ch_sched_timeout(sched);
+
+        /* wait for the wake-up pipe and all the connecting sockets */
+        if (sched->pfd_size < sched->heap_count + 1) {
+            pfds = realloc(sched->pfds, (sched->heap_count + 1) * sizeof *pfds);
+            pjobs = realloc(sched->pjobs, (sched->heap_count + 1) * sizeof *pjobs);
+            if (pfds) {
+                sched->pfds = pfds;
+            }
+            if (pjobs) {
+                sched->pjobs = pjobs;
+            }
+            if (pfds && pjobs) {
+                sched->pfd_size = sched->heap_count + 1;
+            } else {
+                ERRMEM;
+            }
+        }
+        if (!sched->pfd_size) {
+            /* SCHED UNLOCK */
+            pthread_mutex_unlock(&sched->lock);
+            usleep(NC_TIMEOUT_STEP);
+            continue;
+        }
+        sched->pfds[0].fd = sched->wakefd[0];
+        sched->pfds[0].events = POLLIN;
+        sched->pfds[0].revents = 0;
+        count = 1;
+        for (i = 0; (i < sched->heap_count) && (count < sched->pfd_size); ++i) {
+            if (sched->heap[i]->sock > -1) {
+                sched->pfds[count].fd = sched->heap[i]->sock;
+                sched->pfds[count].events = sched->heap[i]->sock_events;
+                sched->pfds[count].revents = 0;
+                sched->pjobs[count] = sched->heap[i];
+                ++count;
+            }
+        }
 
-API int
-nc_server_ch_client_endpt_enable_keepalives(const char *client_name, const char *endpt_name, int enable)
-{
-    struct nc_ch_client *client;
-    struct nc_ch_endpt *endpt;
+        /* SCHED UNLOCK */
+        pthread_mutex_unlock(&sched->lock);
 
-    if (!client_name) {
-        ERRARG("client_name");
-        return -1;
-    } else if (!endpt_name) {
-        ERRARG("endpt_name");
-        return -1;
-    }
+        ret = poll(sched->pfds, count, timeout);
+        if (ret == -1) {
+            if (errno != EINTR) {
+                ERR(NULL, "poll() failed (%s).", strerror(errno));
+                usleep(NC_TIMEOUT_STEP);
+            }
+            continue;
+        } else if (!ret) {
+            continue;
+        }
 
-    /* LOCK */
-    endpt = nc_server_ch_client_lock(client_name, endpt_name, 0, &client);
-    if (!endpt) {
-        return -1;
-    }
+        if (sched->pfds[0].revents) {
+            /* consume the wake-up events */
+            while (read(sched->wakefd[0], buf, sizeof buf) > 0) {}
+        }
 
-    endpt->ka.enabled = (enable ? 1 : 0);
+        /* SCHED LOCK */
+        pthread_mutex_lock(&sched->lock);
 
-    /* UNLOCK */
-    nc_server_ch_client_unlock(client);
+        /* only the workers can free the jobs, these are still waiting */
+        for (i = 1; i < count; ++i) {
+            job = sched->pjobs[i];
+            if (sched->pfds[i].revents && (job->state == NC_CH_JOB_WAIT) && (job->sock == sched->pfds[i].fd)) {
+                /* connected, new handshake data, or failed, the timeout stays in the due time */
+                nc_ch_sched_heap_remove(sched, job);
+                nc_ch_sched_queue(sched, job);
+            }
+        }
 
-    return 0;
+        /* SCHED UNLOCK */
+        pthread_mutex_unlock(&sched->lock);
+    }
+
+    return NULL;
 }
 
-API int
-nc_server_ch_client_endpt_set_keepalives(const char *client_name, const char *endpt_name, int idle_time, int max_probes,
-        int probe_interval)
+/**
+ * @brief Stop the threads of a Call Home scheduler and free it.
+ *
+ * @param[in] sched Call Home scheduler, not accessible by other threads.
+ * @param[in] worker_count Number of the worker threads running.
+ * @param[in] thread Whether the scheduler thread is running.
+ */
+static void
+nc_ch_sched_free(struct nc_ch_sched *sched, uint16_t worker_count, int thread)
 {
-    struct nc_ch_client *client;
-    struct nc_ch_endpt *endpt;
+    uint32_t i;
 
-    if (!client_name) {
-        ERRARG("client_name");
-        return -1;
-    } else if (!endpt_name) {
-        ERRARG("endpt_name");
-        return -1;
-    }
+    /* SCHED LOCK */
+    pthread_mutex_lock(&sched->lock);
+    sched->stop = 1;
+    pthread_cond_broadcast(&sched->job_cond);
+    /* SCHED UNLOCK */
+    pthread_mutex_unlock(&sched->lock);
 
-    /* LOCK */
-    endpt = nc_server_ch_client_lock(client_name, endpt_name, 0, &client);
-    if (!endpt) {
-        return -1;
+    if (thread) {
+        nc_ch_sched_wake(sched);
+        pthread_join(sched->tid, NULL);
     }
-
-    if (idle_time > -1) {
-        endpt->ka.idle_time = idle_time;
+    for (i = 0; i < worker_count; ++i) {
+        pthread_join(sched->worker_tids[i], NULL);
     }
-    if (max_probes > -1) {
-        endpt->ka.max_probes = max_probes;
+
+    for (i = 0; i < sched->job_count; ++i) {
+        nc_ch_job_free(sched->jobs[i]);
     }
-    if (probe_interval > -1) {
-        endpt->ka.probe_interval = probe_interval;
+    for (i = 0; i < 2; ++i) {
+        if (sched->wakefd[i] > -1) {
+            close(sched->wakefd[i]);
+        }
     }
-
-    /* UNLOCK */
-    nc_server_ch_client_unlock(client);
-
-    return 0;
+    pthread_cond_destroy(&sched->job_cond);
+    pthread_mutex_destroy(&sched->lock);
+    free(sched->pfds);
+    free(sched->pjobs);
+    free(sched->jobs);
+    free(sched->heap);
+    free(sched->worker_tids);
+    free(sched);
 }
 
-API int
-nc_server_ch_client_set_conn_type(const char *client_name, NC_CH_CONN_TYPE conn_type)
+/**
+ * @brief Create and start a Call Home scheduler.
+ *
+ * @param[in] worker_count Number of the worker threads.
+ * @return Running Call Home scheduler, NULL on error.
+ */
+static struct nc_ch_sched *
+nc_ch_sched_new(uint16_t worker_count)
 {
-    struct nc_ch_client *client;
+    struct nc_ch_sched *sched;
+    uint16_t i;
+    int r, flags;
 
-    if (!client_name) {
-        ERRARG("client_name");
-        return -1;
-    } else if (!conn_type) {
-        ERRARG("conn_type");
-        return -1;
+    sched = calloc(1, sizeof *sched);
+    if (!sched) {
+        ERRMEM;
+        return NULL;
     }
+    pthread_mutex_init(&sched->lock, NULL);
+    pthread_cond_init(&sched->job_cond, NULL);
 
-    /* LOCK */
-    nc_server_ch_client_lock(client_name, NULL, 0, &client);
-    if (!client) {
-        return -1;
+    if (pipe(sched->wakefd) == -1) {
+        ERR(NULL, "Failed to create a Call Home scheduler pipe (%s).", strerror(errno));
+        sched->wakefd[0] = -1;
+        sched->wakefd[1] = -1;
+        nc_ch_sched_free(sched, 0, 0);
+        return NULL;
+    }
+    for (i = 0; i < 2; ++i) {
+        if (((flags = fcntl(sched->wakefd[i], F_GETFL)) == -1) ||
+                (fcntl(sched->wakefd[i], F_SETFL, flags | O_NONBLOCK) == -1)) {
+            ERR(NULL, "fcntl() failed (%s).", strerror(errno));
+            nc_ch_sched_free(sched, 0, 0);
+            return NULL;
+        }
     }
 
-    if (client->conn_type != conn_type) {
-        client->conn_type = conn_type;
+    sched->worker_tids = malloc(worker_count * sizeof *sched->worker_tids);
+    if (!sched->worker_tids) {
+        ERRMEM;
+        nc_ch_sched_free(sched, 0, 0);
+        return NULL;
+    }
 
-        /* set default options */
-        switch (conn_type) {
-        case NC_CH_PERSIST:
-            /* no options */
-            break;
-        case NC_CH_PERIOD:
-            client->conn.period.period = 60;
-            client->conn.period.anchor_time = 0;
-            client->conn.period.idle_timeout = 120;
-            break;
-        default:
-            ERRINT;
-            break;
+    /* workers */
+    for (i = 0; i < worker_count; ++i) {
+        r = pthread_create(&sched->worker_tids[i], NULL, nc_ch_sched_worker_thread, sched);
+        if (r) {
+            ERR(NULL, "Creating a new thread failed (%s).", strerror(r));
+            nc_ch_sched_free(sched, i, 0);
+            return NULL;
         }
     }
+    sched->worker_count = worker_count;
 
-    /* UNLOCK */
-    nc_server_ch_client_unlock(client);
+    /* waiting for the due jobs */
+    r = pthread_create(&sched->tid, NULL, nc_ch_sched_thread, sched);
+    if (r) {
+        ERR(NULL, "Creating a new thread failed (%s).", strerror(r));
+        nc_ch_sched_free(sched, sched->worker_count, 0);
+        return NULL;
+    }
 
-    return 0;
+    return sched;
 }
 
-API int
-nc_server_ch_client_periodic_set_period(const char *client_name, uint16_t period)
+void
+nc_ch_sched_session_free(struct nc_session *session)
 {
-    struct nc_ch_client *client;
-
-    if (!client_name) {
-        ERRARG("client_name");
-        return -1;
-    } else if (!period) {
-        ERRARG("period");
-        return -1;
-    }
+    struct nc_ch_sched *sched;
+    struct nc_ch_job *job;
+    uint32_t i;
 
     /* LOCK */
-    nc_server_ch_client_lock(client_name, NULL, 0, &client);
-    if (!client) {
-        return -1;
-    }
+    pthread_mutex_lock(&ch_sched_lock);
 
-    if (client->conn_type != NC_CH_PERIOD) {
-        ERR(NULL, "Call Home client \"%s\" is not of periodic connection type.", client_name);
-        /* UNLOCK */
-        nc_server_ch_client_unlock(client);
-        return -1;
-    }
+    sched = ch_sched;
+    if (sched) {
+        /* SCHED LOCK */
+        pthread_mutex_lock(&sched->lock);
 
-    client->conn.period.period = period;
+        for (i = 0; i < sched->job_count; ++i) {
+            job = sched->jobs[i];
+            if (job->session != session) {
+                continue;
+            }
+
+            session->flags &= ~NC_SESSION_CH_THREAD;
+            job->session = NULL;
+
+            /* handle the termination right away */
+            nc_ch_sched_job_now(sched, job);
+            break;
+        }
+
+        /* SCHED UNLOCK */
+        pthread_mutex_unlock(&sched->lock);
+    }
 
     /* UNLOCK */
-    nc_server_ch_client_unlock(client);
-
-    return 0;
+    pthread_mutex_unlock(&ch_sched_lock);
 }
 
-API int
-nc_server_ch_client_periodic_set_anchor_time(const char *client_name, time_t anchor_time)
+void
+nc_ch_sched_client_changed(const char *client_name)
 {
-    struct nc_ch_client *client;
+    struct nc_ch_sched *sched;
+    uint32_t i;
 
-    if (!client_name) {
-        ERRARG("client_name");
-        return -1;
+    /* LOCK */
+    pthread_mutex_lock(&ch_sched_lock);
+
+    sched = ch_sched;
+    if (sched) {
+        /* SCHED LOCK */
+        pthread_mutex_lock(&sched->lock);
+
+        for (i = 0; i < sched->job_count; ++i) {
+            if (!client_name || !strcmp(sched->jobs[i]->client_name, client_name)) {
+                nc_ch_sched_job_now(sched, sched->jobs[i]);
+            }
+        }
+
+        /* SCHED UNLOCK */
+        pthread_mutex_unlock(&sched->lock);
     }
 
+    /* UNLOCK */
+    pthread_mutex_unlock(&ch_sched_lock);
+}
+
+void
+nc_ch_sched_destroy(void)
+{
+    struct nc_ch_sched *sched;
+    uint32_t i;
+
     /* LOCK */
-    nc_server_ch_client_lock(client_name, NULL, 0, &client);
-    if (!client) {
-        return -1;
+    pthread_mutex_lock(&ch_sched_lock);
+    sched = ch_sched;
+    /* UNLOCK */
+    pthread_mutex_unlock(&ch_sched_lock);
+
+    if (!sched) {
+        return;
     }
 
-    if (client->conn_type != NC_CH_PERIOD) {
-        ERR(NULL, "Call Home client \"%s\" is not of periodic connection type.", client_name);
-        /* UNLOCK */
-        nc_server_ch_client_unlock(client);
-        return -1;
+    /* SCHED LOCK */
+    pthread_mutex_lock(&sched->lock);
+    sched->stop = 1;
+    pthread_cond_broadcast(&sched->job_cond);
+    /* SCHED UNLOCK */
+    pthread_mutex_unlock(&sched->lock);
+
+    /* the sessions can still be freed by the callbacks of the workers */
+    nc_ch_sched_wake(sched);
+    pthread_join(sched->tid, NULL);
+    for (i = 0; i < sched->worker_count; ++i) {
+        pthread_join(sched->worker_tids[i], NULL);
     }
+    sched->worker_count = 0;
 
-    client->conn.period.anchor_time = anchor_time;
+    /* LOCK */
+    pthread_mutex_lock(&ch_sched_lock);
+    /* SCHED LOCK */
+    pthread_mutex_lock(&sched->lock);
+
+    /* no sessions are tracked anymore */
+    for (i = 0; i < sched->job_count; ++i) {
+        if (sched->jobs[i]->session) {
+            sched->jobs[i]->session->flags &= ~NC_SESSION_CH_THREAD;
+        }
+    }
+    ch_sched = NULL;
 
+    /* SCHED UNLOCK */
+    pthread_mutex_unlock(&sched->lock);
     /* UNLOCK */
-    nc_server_ch_client_unlock(client);
+    pthread_mutex_unlock(&ch_sched_lock);
 
-    return 0;
+    nc_ch_sched_free(sched, 0, 0);
 }
 
 API int
-nc_server_ch_client_periodic_set_idle_timeout(const char *client_name, uint16_t idle_timeout)
+nc_connect_ch_client_dispatch(const char *client_name, nc_server_ch_session_acquire_ctx_cb acquire_ctx_cb,
+        nc_server_ch_session_release_ctx_cb release_ctx_cb, void *ctx_cb_data, nc_server_ch_new_session_cb new_session_cb)
 {
-    struct nc_ch_client *client;
+    int ret = -1;
+    struct nc_ch_sched *sched;
+    struct nc_ch_job *job, **jobs;
 
     if (!client_name) {
         ERRARG("client_name");
         return -1;
+    } else if (!acquire_ctx_cb) {
+        ERRARG("acquire_ctx_cb");
+        return -1;
+    } else if (!release_ctx_cb) {
+        ERRARG("release_ctx_cb");
+        return -1;
+    } else if (!new_session_cb) {
+        ERRARG("new_session_cb");
+        return -1;
     }
 
-    /* LOCK */
-    nc_server_ch_client_lock(client_name, NULL, 0, &client);
-    if (!client) {
+    job = calloc(1, sizeof *job);
+    if (!job) {
+        ERRMEM;
         return -1;
     }
-
-    if (client->conn_type != NC_CH_PERIOD) {
-        ERR(NULL, "Call Home client \"%s\" is not of periodic connection type.", client_name);
-        /* UNLOCK */
-        nc_server_ch_client_unlock(client);
+    job->client_name = strdup(client_name);
+    if (!job->client_name) {
+        ERRMEM;
+        free(job);
         return -1;
     }
+    job->acquire_ctx_cb = acquire_ctx_cb;
+    job->release_ctx_cb = release_ctx_cb;
+    job->ctx_cb_data = ctx_cb_data;
+    job->new_session_cb = new_session_cb;
+    job->sock = -1;
+    job->seed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)job;
 
-    client->conn.period.idle_timeout = idle_timeout;
-
-    /* UNLOCK */
-    nc_server_ch_client_unlock(client);
+    /* LOCK */
+    pthread_mutex_lock(&ch_sched_lock);
 
-    return 0;
-}
+    if (!ch_sched) {
+        /* the first Call Home client, start the scheduler */
+        ch_sched = nc_ch_sched_new(NC_CH_SCHED_WORKERS);
+        if (!ch_sched) {
+            goto cleanup;
+        }
+    }
+    sched = ch_sched;
 
-API int
-nc_server_ch_client_set_start_with(const char *client_name, NC_CH_START_WITH start_with)
-{
-    struct nc_ch_client *client;
+    /* SCHED LOCK */
+    pthread_mutex_lock(&sched->lock);
 
-    if (!client_name) {
-        ERRARG("client_name");
-        return -1;
+    /* the timer queue must always fit all the jobs */
+    jobs = realloc(sched->heap, (sched->job_count + 1) * sizeof *sched->heap);
+    if (jobs) {
+        sched->heap = jobs;
+        jobs = realloc(sched->jobs, (sched->job_count + 1) * sizeof *sched->jobs);
     }
+    if (!jobs) {
+        ERRMEM;
+    } else {
+        sched->jobs = jobs;
+        sched->jobs[sched->job_count++] = job;
 
-    /* LOCK */
-    nc_server_ch_client_lock(client_name, NULL, 0, &client);
-    if (!client) {
-        return -1;
+        /* connect right away */
+        nc_ch_sched_queue(sched, job);
+        job = NULL;
+        ret = 0;
     }
 
-    client->start_with = start_with;
+    /* SCHED UNLOCK */
+    pthread_mutex_unlock(&sched->lock);
 
+cleanup:
     /* UNLOCK */
-    nc_server_ch_client_unlock(client);
+    pthread_mutex_unlock(&ch_sched_lock);
 
-    return 0;
+    /* the scheduler now manages the job */
+    nc_ch_job_free(job);
+    return ret;
 }
 
-API int
-nc_server_ch_client_set_max_attempts(const char *client_name, uint8_t max_attempts)
+#endif /* NC_ENABLED_SSH || NC_ENABLED_TLS */
+
+/**
+ * @brief Copy an endpoint to be staged by a configuration batch.
+ *
+ * @param[in] src Endpoint to copy.
+ * @param[out] dst Copied endpoint.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_server_endpt_dup(const struct nc_endpt *src, struct nc_endpt *dst)
 {
-    struct nc_ch_client *client;
+    void *opts;
 
-    if (!client_name) {
-        ERRARG("client_name");
-        return -1;
-    } else if (!max_attempts) {
-        ERRARG("max_attempts");
+    dst->name = strdup(src->name);
+    if (!dst->name) {
+        ERRMEM;
         return -1;
     }
+    dst->ti = src->ti;
+    dst->ka = src->ka;
 
-    /* LOCK */
-    nc_server_ch_client_lock(client_name, NULL, 0, &client);
-    if (!client) {
+    switch (src->ti) {
+#ifdef NC_ENABLED_SSH
+    case NC_TI_LIBSSH:
+        opts = dst->opts.ssh = nc_server_ssh_opts_dup(src->opts.ssh);
+        break;
+#endif
+#ifdef NC_ENABLED_TLS
+    case NC_TI_OPENSSL:
+        opts = dst->opts.tls = nc_server_tls_opts_dup(src->opts.tls);
+        break;
+#endif
+    case NC_TI_UNIX:
+        opts = dst->opts.unixsock = malloc(sizeof *dst->opts.unixsock);
+        if (!opts) {
+            ERRMEM;
+            break;
+        }
+        *dst->opts.unixsock = *src->opts.unixsock;
+        break;
+    default:
+        ERRINT;
+        opts = NULL;
+        break;
+    }
+    if (!opts) {
+        free(dst->name);
         return -1;
     }
 
-    client->max_attempts = max_attempts;
-
-    /* UNLOCK */
-    nc_server_ch_client_unlock(client);
-
     return 0;
 }
 
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+
 /**
- * @brief Create a connection for an endpoint.
- *
- * Client lock is expected to be held.
+ * @brief Copy a CH client with its endpoints to be staged by a configuration batch.
  *
- * @param[in] endpt Endpoint to use.
- * @param[in] acquire_ctx_cb Callback for acquiring the libyang context.
- * @param[in] release_ctx_cb Callback for releasing the libyang context.
- * @param[in] ctx_cb_data Context callbacks data.
- * @param[out] session Created NC session.
- * @return NC_MSG values.
+ * @param[in] src CH client to copy.
+ * @param[out] dst Copied CH client, keeps the ID of @p src.
+ * @return 0 on success, -1 on error.
  */
-static NC_MSG_TYPE
-nc_connect_ch_endpt(struct nc_ch_endpt *endpt, nc_server_ch_session_acquire_ctx_cb acquire_ctx_cb,
-        nc_server_ch_session_release_ctx_cb release_ctx_cb, void *ctx_cb_data, struct nc_session **session)
+static int
+nc_server_ch_client_dup(const struct nc_ch_client *src, struct nc_ch_client *dst)
 {
-    NC_MSG_TYPE msgtype;
-    const struct ly_ctx *ctx = NULL;
-    int sock, ret;
-    struct timespec ts_cur;
-    char *ip_host;
+    const struct nc_ch_endpt *src_endpt;
+    struct nc_ch_endpt *endpt;
+    uint16_t i;
+    void *opts;
 
-    sock = nc_sock_connect(endpt->address, endpt->port, NC_CH_CONNECT_TIMEOUT, &endpt->ka, &endpt->sock_pending, &ip_host);
-    if (sock < 0) {
-        return NC_MSG_ERROR;
+    *dst = *src;
+    dst->ch_endpts = NULL;
+    dst->ch_endpt_count = 0;
+    dst->name = strdup(src->name);
+    if (!dst->name) {
+        ERRMEM;
+        return -1;
     }
 
-    /* acquire context */
-    ctx = acquire_ctx_cb(ctx_cb_data);
-    if (!ctx) {
-        ERR(NULL, "Failed to acquire context for a new Call Home session.");
-        close(sock);
-        free(ip_host);
-        return NC_MSG_ERROR;
+    if (src->ch_endpt_count) {
+        dst->ch_endpts = calloc(src->ch_endpt_count, sizeof *dst->ch_endpts);
+        if (!dst->ch_endpts) {
+            ERRMEM;
+            goto error;
+        }
     }
+    for (i = 0; i < src->ch_endpt_count; ++i) {
+        src_endpt = &src->ch_endpts[i];
+        endpt = &dst->ch_endpts[i];
 
-    /* create session */
-    *session = nc_new_session(NC_SERVER, 0);
-    if (!(*session)) {
-        ERRMEM;
-        close(sock);
-        free(ip_host);
-        msgtype = NC_MSG_ERROR;
-        goto fail;
-    }
-    (*session)->status = NC_STATUS_STARTING;
-    (*session)->ctx = (struct ly_ctx *)ctx;
-    (*session)->flags = NC_SESSION_SHAREDCTX;
-    (*session)->host = ip_host;
-    (*session)->port = endpt->port;
+        endpt->name = strdup(src_endpt->name);
+        endpt->address = src_endpt->address ? strdup(src_endpt->address) : NULL;
+        if (!endpt->name || (src_endpt->address && !endpt->address)) {
+            ERRMEM;
+            free(endpt->name);
+            free(endpt->address);
+            goto error;
+        }
+        endpt->ti = src_endpt->ti;
+        endpt->port = src_endpt->port;
+        endpt->sock_pending = -1;
+        endpt->ka = src_endpt->ka;
 
-    /* sock gets assigned to session or closed */
+        switch (src_endpt->ti) {
 #ifdef NC_ENABLED_SSH
-    if (endpt->ti == NC_TI_LIBSSH) {
-        (*session)->data = endpt->opts.ssh;
-        ret = nc_accept_ssh_session(*session, sock, NC_TRANSPORT_TIMEOUT);
-        (*session)->data = NULL;
-
-        if (ret < 0) {
-            msgtype = NC_MSG_ERROR;
-            goto fail;
-        } else if (!ret) {
-            msgtype = NC_MSG_WOULDBLOCK;
-            goto fail;
-        }
-    } else
+        case NC_TI_LIBSSH:
+            opts = endpt->opts.ssh = nc_server_ssh_opts_dup(src_endpt->opts.ssh);
+            break;
 #endif
 #ifdef NC_ENABLED_TLS
-    if (endpt->ti == NC_TI_OPENSSL) {
-        (*session)->data = endpt->opts.tls;
-        ret = nc_accept_tls_session(*session, sock, NC_TRANSPORT_TIMEOUT);
-        (*session)->data = NULL;
-
-        if (ret < 0) {
-            msgtype = NC_MSG_ERROR;
-            goto fail;
-        } else if (!ret) {
-            msgtype = NC_MSG_WOULDBLOCK;
-            goto fail;
-        }
-    } else
+        case NC_TI_OPENSSL:
+            opts = endpt->opts.tls = nc_server_tls_opts_dup(src_endpt->opts.tls);
+            break;
 #endif
-    {
-        ERRINT;
-        close(sock);
-        msgtype = NC_MSG_ERROR;
-        goto fail;
+        default:
+            ERRINT;
+            opts = NULL;
+            break;
+        }
+        if (!opts) {
+            free(endpt->name);
+            free(endpt->address);
+            goto error;
+        }
+        ++dst->ch_endpt_count;
     }
 
-    /* assign new SID atomically */
-    (*session)->id = ATOMIC_INC_RELAXED(server_opts.new_session_id);
+    pthread_mutex_init(&dst->lock, NULL);
+    return 0;
 
-    /* NETCONF handshake */
-    msgtype = nc_handshake_io(*session);
-    if (msgtype != NC_MSG_HELLO) {
-        goto fail;
-    }
+error:
+    _nc_server_ch_client_del_endpt(dst, NULL, 0);
+    free(dst->name);
+    return -1;
+}
 
-    nc_gettimespec_mono_add(&ts_cur, 0);
-    (*session)->opts.server.last_rpc = ts_cur.tv_sec;
-    nc_gettimespec_real_add(&ts_cur, 0);
-    (*session)->opts.server.session_start = ts_cur.tv_sec;
-    (*session)->status = NC_STATUS_RUNNING;
+#endif
 
-    return msgtype;
+/**
+ * @brief Free a configuration, closing all its sockets.
+ *
+ * @param[in] cfg Configuration to free.
+ */
+static void
+nc_server_config_clear(struct nc_server_config *cfg)
+{
+    _nc_server_del_endpt(cfg, NULL, 0);
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+    _nc_server_ch_del_client(cfg, NULL);
+#endif
+}
 
-fail:
-    nc_session_free(*session, NULL);
-    *session = NULL;
-    if (ctx) {
-        release_ctx_cb(ctx_cb_data);
+/**
+ * @brief Copy a configuration to be staged by a configuration batch, without any sockets.
+ *
+ * BIND LOCK, ENDPT READ LOCK, and CH CLIENT WRITE LOCK are expected to be held.
+ *
+ * @param[in] src Configuration to copy.
+ * @param[out] dst Copied configuration.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_server_config_dup(const struct nc_server_config *src, struct nc_server_config *dst)
+{
+    uint16_t i;
+
+    memset(dst, 0, sizeof *dst);
+
+    if (src->endpt_count) {
+        dst->endpts = calloc(src->endpt_count, sizeof *dst->endpts);
+        dst->binds = calloc(src->endpt_count, sizeof *dst->binds);
+        if (!dst->endpts || !dst->binds) {
+            ERRMEM;
+            goto error;
+        }
+    }
+    for (i = 0; i < src->endpt_count; ++i) {
+        if (src->binds[i].address && !(dst->binds[i].address = strdup(src->binds[i].address))) {
+            ERRMEM;
+            goto error;
+        }
+        dst->binds[i].port = src->binds[i].port;
+        dst->binds[i].sock = -1;
+
+        if (nc_server_endpt_dup(&src->endpts[i], &dst->endpts[i])) {
+            free(dst->binds[i].address);
+            goto error;
+        }
+        ++dst->endpt_count;
+    }
+    nc_name_index_rebuild(&dst->endpt_index, dst->endpts, sizeof *dst->endpts, dst->endpt_count);
+
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+    if (src->ch_client_count) {
+        dst->ch_clients = calloc(src->ch_client_count, sizeof *dst->ch_clients);
+        if (!dst->ch_clients) {
+            ERRMEM;
+            goto error;
+        }
+    }
+    for (i = 0; i < src->ch_client_count; ++i) {
+        if (nc_server_ch_client_dup(&src->ch_clients[i], &dst->ch_clients[i])) {
+            goto error;
+        }
+        ++dst->ch_client_count;
     }
-    return msgtype;
-}
+    nc_name_index_rebuild(&dst->ch_client_index, dst->ch_clients, sizeof *dst->ch_clients, dst->ch_client_count);
+#endif
 
-struct nc_ch_client_thread_arg {
-    char *client_name;
-    nc_server_ch_session_acquire_ctx_cb acquire_ctx_cb;
-    nc_server_ch_session_release_ctx_cb release_ctx_cb;
-    void *ctx_cb_data;
-    nc_server_ch_new_session_cb new_session_cb;
-};
+    return 0;
+
+error:
+    nc_server_config_clear(dst);
+    return -1;
+}
 
-static struct nc_ch_client *
-nc_server_ch_client_with_endpt_lock(const char *name)
+/**
+ * @brief Load what changed in the options of a staged configuration, before the current configuration is locked.
+ *
+ * @param[in] stage Staged configuration.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_server_config_load(struct nc_server_config *stage)
 {
+#ifdef NC_ENABLED_TLS
+    uint16_t i, j;
     struct nc_ch_client *client;
 
-    while (1) {
-        /* LOCK */
-        nc_server_ch_client_lock(name, NULL, 0, &client);
-        if (!client) {
-            return NULL;
+    for (i = 0; i < stage->endpt_count; ++i) {
+        if ((stage->endpts[i].ti == NC_TI_OPENSSL) && nc_server_tls_opts_load(stage->endpts[i].opts.tls)) {
+            ERR(NULL, "Endpoint \"%s\" failed to load its CRLs.", stage->endpts[i].name);
+            return -1;
         }
-        if (client->ch_endpt_count) {
-            return client;
+    }
+    for (i = 0; i < stage->ch_client_count; ++i) {
+        client = &stage->ch_clients[i];
+        for (j = 0; j < client->ch_endpt_count; ++j) {
+            if ((client->ch_endpts[j].ti == NC_TI_OPENSSL) && nc_server_tls_opts_load(client->ch_endpts[j].opts.tls)) {
+                ERR(NULL, "Call Home client \"%s\" endpoint \"%s\" failed to load its CRLs.", client->name,
+                        client->ch_endpts[j].name);
+                return -1;
+            }
         }
-        /* no endpoints defined yet */
-
-        /* UNLOCK */
-        nc_server_ch_client_unlock(client);
-
-        usleep(NC_CH_NO_ENDPT_WAIT * 1000);
     }
+#else
+    (void)stage;
+#endif
 
-    return NULL;
+    return 0;
 }
 
+/**
+ * @brief Check whether a staged bind can take over the listening socket of a current bind.
+ *
+ * @param[in] cur Current configuration.
+ * @param[in] taken Flags of the current binds whose sockets are already taken over.
+ * @param[in] idx Index of the current bind.
+ * @param[in] endpt Staged endpoint.
+ * @param[in] bind Bind of @p endpt.
+ * @return Whether the socket listens on the same address and can be taken over.
+ */
 static int
-nc_server_ch_client_thread_session_cond_wait(struct nc_session *session, struct nc_ch_client_thread_arg *data)
+nc_server_config_bind_match(const struct nc_server_config *cur, const uint8_t *taken, uint16_t idx,
+        const struct nc_endpt *endpt, const struct nc_bind *bind)
 {
-    int ret = 0, r;
-    uint32_t idle_timeout;
-    struct timespec ts;
-    struct nc_ch_client *client;
-
-    /* CH LOCK */
-    pthread_mutex_lock(&session->opts.server.ch_lock);
-
-    session->flags |= NC_SESSION_CH_THREAD;
+    return !taken[idx] && (cur->binds[idx].sock > -1) && cur->binds[idx].address &&
+           !strcmp(cur->binds[idx].address, bind->address) && (cur->binds[idx].port == bind->port) &&
+           ((cur->endpts[idx].ti == NC_TI_UNIX) == (endpt->ti == NC_TI_UNIX));
+}
 
-    /* give the session to the user */
-    if (data->new_session_cb(data->client_name, session)) {
-        /* something is wrong, free the session */
-        session->flags &= ~NC_SESSION_CH_THREAD;
+/**
+ * @brief Create the listening sockets of a staged configuration, those of the current configuration listening
+ * on the same address are taken over.
+ *
+ * BIND LOCK and ENDPT WRITE LOCK are expected to be held.
+ *
+ * @param[in] stage Staged configuration.
+ * @param[in] cur Current configuration, its sockets are moved to @p stage on success and kept on error.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_server_config_listen(struct nc_server_config *stage, struct nc_server_config *cur)
+{
+    struct nc_endpt *endpt;
+    struct nc_bind *bind;
+    uint8_t *taken = NULL;
+    int *reuse = NULL, j, ret = 0;
+    uint16_t i;
 
-        /* CH UNLOCK */
-        pthread_mutex_unlock(&session->opts.server.ch_lock);
+    if (!stage->endpt_count) {
+        return 0;
+    }
 
-        /* session terminated, free it and release its context */
-        nc_session_free(session, NULL);
-        data->release_ctx_cb(data->ctx_cb_data);
-        return ret;
+    taken = calloc(cur->endpt_count + 1, sizeof *taken);
+    reuse = malloc(stage->endpt_count * sizeof *reuse);
+    if (!taken || !reuse) {
+        ERRMEM;
+        ret = -1;
+        goto cleanup;
     }
 
-    do {
-        nc_gettimespec_real_add(&ts, NC_CH_NO_ENDPT_WAIT);
+    for (i = 0; i < stage->endpt_count; ++i) {
+        endpt = &stage->endpts[i];
+        bind = &stage->binds[i];
+        reuse[i] = -1;
+        if (!bind->address || (!bind->port && (endpt->ti != NC_TI_UNIX))) {
+            /* not listening yet */
+            continue;
+        }
 
-        /* CH COND WAIT */
-        r = pthread_cond_timedwait(&session->opts.server.ch_cond, &session->opts.server.ch_lock, &ts);
-        if (!r) {
-            /* we were woken up, something probably happened */
-            if (session->status != NC_STATUS_RUNNING) {
-                break;
+        /* most likely the same endpoint */
+        j = NC_ENDPT_FIND(cur, endpt->name);
+        if ((j < 0) || !nc_server_config_bind_match(cur, taken, j, endpt, bind)) {
+            for (j = 0; j < cur->endpt_count; ++j) {
+                if (nc_server_config_bind_match(cur, taken, j, endpt, bind)) {
+                    break;
+                }
             }
-        } else if (r != ETIMEDOUT) {
-            ERR(session, "Pthread condition timedwait failed (%s).", strerror(r));
-            ret = -1;
-            break;
         }
-
-        /* check whether the client was not removed */
-        /* LOCK */
-        nc_server_ch_client_lock(data->client_name, NULL, 0, &client);
-        if (!client) {
-            /* client was removed, finish thread */
-            VRB(session, "Call Home client \"%s\" removed, but an established session will not be terminated.",
-                    data->client_name);
-            ret = 1;
-            break;
+        if (j < cur->endpt_count) {
+            taken[j] = 1;
+            reuse[i] = j;
+            continue;
         }
 
-        if (client->conn_type == NC_CH_PERIOD) {
-            idle_timeout = client->conn.period.idle_timeout;
-        } else {
-            idle_timeout = 0;
-        }
+        if (nc_server_endpt_bind(endpt, bind, bind->address, bind->port)) {
+            ERR(NULL, "Endpoint \"%s\" failed to listen on the new address.", endpt->name);
 
-        nc_gettimespec_mono_add(&ts, 0);
-        if (!nc_session_get_notif_status(session) && idle_timeout && (ts.tv_sec >= session->opts.server.last_rpc + idle_timeout)) {
-            VRB(session, "Call Home client \"%s\": session idle timeout elapsed.", client->name);
-            session->status = NC_STATUS_INVALID;
-            session->term_reason = NC_SESSION_TERM_TIMEOUT;
+            /* close the sockets created so far */
+            while (i) {
+                --i;
+                if ((reuse[i] == -1) && (stage->binds[i].sock > -1)) {
+                    close(stage->binds[i].sock);
+                    stage->binds[i].sock = -1;
+                }
+            }
+            ret = -1;
+            goto cleanup;
         }
+    }
 
-        /* UNLOCK */
-        nc_server_ch_client_unlock(client);
-
-    } while (session->status == NC_STATUS_RUNNING);
-
-    /* signal to nc_session_free() that CH thread is terminating */
-    session->flags &= ~NC_SESSION_CH_THREAD;
-    pthread_cond_signal(&session->opts.server.ch_cond);
-
-    /* CH UNLOCK */
-    pthread_mutex_unlock(&session->opts.server.ch_lock);
+    /* success, move the sockets */
+    for (i = 0; i < stage->endpt_count; ++i) {
+        if (reuse[i] > -1) {
+            stage->binds[i].sock = cur->binds[reuse[i]].sock;
+            stage->binds[i].pollin = cur->binds[reuse[i]].pollin;
+            cur->binds[reuse[i]].sock = -1;
+        }
+    }
 
+cleanup:
+    free(taken);
+    free(reuse);
     return ret;
 }
 
-static void *
-nc_ch_client_thread(void *arg)
+/**
+ * @brief Let the options of a staged configuration take over the cached data of the current configuration
+ * that did not change, and the pending Call Home connections.
+ *
+ * BIND LOCK, ENDPT WRITE LOCK, and CH CLIENT WRITE LOCK are expected to be held.
+ *
+ * @param[in] stage Staged configuration.
+ * @param[in] cur Current configuration.
+ */
+static void
+nc_server_config_take(struct nc_server_config *stage, struct nc_server_config *cur)
 {
-    struct nc_ch_client_thread_arg *data = (struct nc_ch_client_thread_arg *)arg;
-    NC_MSG_TYPE msgtype;
-    uint8_t cur_attempts = 0;
-    uint16_t next_endpt_index;
-    char *cur_endpt_name = NULL;
-    struct nc_ch_endpt *cur_endpt;
-    struct nc_session *session;
-    struct nc_ch_client *client;
-    uint32_t client_id, reconnect_in;
+    struct nc_endpt *endpt, *cur_endpt;
+    uint16_t i;
+    int idx;
 
-    /* LOCK */
-    client = nc_server_ch_client_with_endpt_lock(data->client_name);
-    if (!client) {
-        goto cleanup;
-    }
-    client_id = client->id;
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+    struct nc_ch_client *client, *cur_client;
+    struct nc_ch_endpt *ch_endpt, *cur_ch_endpt;
+    uint16_t j, k;
+#endif
 
-    cur_endpt = &client->ch_endpts[0];
-    cur_endpt_name = strdup(cur_endpt->name);
+    for (i = 0; i < stage->endpt_count; ++i) {
+        endpt = &stage->endpts[i];
+        idx = NC_ENDPT_FIND(cur, endpt->name);
+        cur_endpt = ((idx > -1) && (cur->endpts[idx].ti == endpt->ti)) ? &cur->endpts[idx] : NULL;
 
-    while (1) {
-        if (!cur_attempts) {
-            VRB(NULL, "Call Home client \"%s\" endpoint \"%s\" connecting...", data->client_name, cur_endpt_name);
+        switch (endpt->ti) {
+#ifdef NC_ENABLED_SSH
+        case NC_TI_LIBSSH:
+            nc_server_ssh_opts_take(endpt->opts.ssh, cur_endpt ? cur_endpt->opts.ssh : NULL);
+            break;
+#endif
+#ifdef NC_ENABLED_TLS
+        case NC_TI_OPENSSL:
+            nc_server_tls_opts_take(endpt->opts.tls, cur_endpt ? cur_endpt->opts.tls : NULL);
+            break;
+#endif
+        default:
+            break;
         }
-        msgtype = nc_connect_ch_endpt(cur_endpt, data->acquire_ctx_cb, data->release_ctx_cb, data->ctx_cb_data, &session);
-
-        if (msgtype == NC_MSG_HELLO) {
-            /* UNLOCK */
-            nc_server_ch_client_unlock(client);
+    }
 
-            VRB(NULL, "Call Home client \"%s\" session %u established.", data->client_name, session->id);
-            if (nc_server_ch_client_thread_session_cond_wait(session, data)) {
-                goto cleanup;
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+    for (i = 0; i < stage->ch_client_count; ++i) {
+        client = &stage->ch_clients[i];
+        idx = NC_CH_CLIENT_FIND(cur, client->name);
+        cur_client = ((idx > -1) && (cur->ch_clients[idx].id == client->id)) ? &cur->ch_clients[idx] : NULL;
+
+        for (j = 0; j < client->ch_endpt_count; ++j) {
+            ch_endpt = &client->ch_endpts[j];
+            cur_ch_endpt = NULL;
+            for (k = 0; cur_client && (k < cur_client->ch_endpt_count); ++k) {
+                if (!strcmp(cur_client->ch_endpts[k].name, ch_endpt->name) &&
+                        (cur_client->ch_endpts[k].ti == ch_endpt->ti)) {
+                    cur_ch_endpt = &cur_client->ch_endpts[k];
+                    break;
+                }
             }
-            VRB(NULL, "Call Home client \"%s\" session terminated.", data->client_name);
 
-            /* LOCK */
-            client = nc_server_ch_client_with_endpt_lock(data->client_name);
-            if (!client) {
-                goto cleanup;
+            switch (ch_endpt->ti) {
+#ifdef NC_ENABLED_SSH
+            case NC_TI_LIBSSH:
+                nc_server_ssh_opts_take(ch_endpt->opts.ssh, cur_ch_endpt ? cur_ch_endpt->opts.ssh : NULL);
+                break;
+#endif
+#ifdef NC_ENABLED_TLS
+            case NC_TI_OPENSSL:
+                nc_server_tls_opts_take(ch_endpt->opts.tls, cur_ch_endpt ? cur_ch_endpt->opts.tls : NULL);
+                break;
+#endif
+            default:
+                break;
             }
-            if (client->id != client_id) {
-                nc_server_ch_client_unlock(client);
-                goto cleanup;
+
+            /* a connection in progress to the same address */
+            if (cur_ch_endpt && (cur_ch_endpt->sock_pending > -1) && ch_endpt->address && cur_ch_endpt->address &&
+                    !strcmp(ch_endpt->address, cur_ch_endpt->address) && (ch_endpt->port == cur_ch_endpt->port)) {
+                ch_endpt->sock_pending = cur_ch_endpt->sock_pending;
+                cur_ch_endpt->sock_pending = -1;
             }
+        }
+    }
+#endif
+}
 
-            /* session changed status -> it was disconnected for whatever reason,
-             * persistent connection immediately tries to reconnect, periodic connects at specific times */
-            if (client->conn_type == NC_CH_PERIOD) {
-                if (client->conn.period.anchor_time) {
-                    /* anchored */
-                    reconnect_in = (time(NULL) - client->conn.period.anchor_time) % (client->conn.period.period * 60);
-                } else {
-                    /* fixed timeout */
-                    reconnect_in = client->conn.period.period * 60;
-                }
+API int
+nc_server_config_begin(void)
+{
+    struct nc_server_config *stage;
+    int ret;
 
-                /* UNLOCK */
-                nc_server_ch_client_unlock(client);
+    if (nc_server_config_batch_owner()) {
+        ERR(NULL, "Configuration batch already started.");
+        return -1;
+    }
 
-                /* sleep until we should reconnect TODO wake up sometimes to check for new notifications */
-                VRB(NULL, "Call Home client \"%s\" reconnecting in %" PRIu32 " seconds.", data->client_name, reconnect_in);
-                sleep(reconnect_in);
+    stage = malloc(sizeof *stage);
+    if (!stage) {
+        ERRMEM;
+        return -1;
+    }
 
-                /* LOCK */
-                client = nc_server_ch_client_with_endpt_lock(data->client_name);
-                if (!client) {
-                    goto cleanup;
-                }
-                if (client->id != client_id) {
-                    nc_server_ch_client_unlock(client);
-                    goto cleanup;
-                }
-            }
+    /* LOCK, only one batch at a time */
+    pthread_mutex_lock(&server_opts.config_lock);
 
-            /* set next endpoint to try */
-            if (client->start_with == NC_CH_FIRST_LISTED) {
-                next_endpt_index = 0;
-            } else if (client->start_with == NC_CH_LAST_CONNECTED) {
-                /* we keep the current one but due to unlock/lock we have to find it again */
-                for (next_endpt_index = 0; next_endpt_index < client->ch_endpt_count; ++next_endpt_index) {
-                    if (!strcmp(client->ch_endpts[next_endpt_index].name, cur_endpt_name)) {
-                        break;
-                    }
-                }
-                if (next_endpt_index >= client->ch_endpt_count) {
-                    /* endpoint was removed, start with the first one */
-                    next_endpt_index = 0;
-                }
-            } else {
-                /* just get a random index */
-                next_endpt_index = rand() % client->ch_endpt_count;
-            }
+    /* BIND LOCK */
+    pthread_mutex_lock(&server_opts.bind_lock);
 
-        } else {
-            /* UNLOCK */
-            nc_server_ch_client_unlock(client);
+    /* ENDPT READ LOCK */
+    pthread_rwlock_rdlock(&server_opts.endpt_lock);
 
-            /* session was not created */
-            sleep(NC_CH_ENDPT_BACKOFF_WAIT);
+    /* CH CLIENT WRITE LOCK, the clients are modified with only their own locks */
+    pthread_rwlock_wrlock(&server_opts.ch_client_lock);
 
-            /* LOCK */
-            client = nc_server_ch_client_with_endpt_lock(data->client_name);
-            if (!client) {
-                goto cleanup;
-            }
-            if (client->id != client_id) {
-                nc_server_ch_client_unlock(client);
-                goto cleanup;
-            }
+    ret = nc_server_config_dup(&server_opts.config, stage);
 
-            ++cur_attempts;
+    /* CH CLIENT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.ch_client_lock);
 
-            /* try to find our endpoint again */
-            for (next_endpt_index = 0; next_endpt_index < client->ch_endpt_count; ++next_endpt_index) {
-                if (!strcmp(client->ch_endpts[next_endpt_index].name, cur_endpt_name)) {
-                    break;
-                }
-            }
+    /* ENDPT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
 
-            if (next_endpt_index >= client->ch_endpt_count) {
-                /* endpoint was removed, start with the first one */
-                VRB(NULL, "Call Home client \"%s\" endpoint \"%s\" removed.", data->client_name, cur_endpt_name);
-                next_endpt_index = 0;
-                cur_attempts = 0;
-            } else if (cur_attempts == client->max_attempts) {
-                /* we have tried to connect to this endpoint enough times */
-                VRB(NULL, "Call Home client \"%s\" endpoint \"%s\" failed connection attempt limit %" PRIu8 " reached.",
-                        data->client_name, cur_endpt_name, client->max_attempts);
-
-                /* clear a pending socket, if any */
-                cur_endpt = &client->ch_endpts[next_endpt_index];
-                if (cur_endpt->sock_pending > -1) {
-                    close(cur_endpt->sock_pending);
-                    cur_endpt->sock_pending = -1;
-                }
+    /* BIND UNLOCK */
+    pthread_mutex_unlock(&server_opts.bind_lock);
 
-                if (next_endpt_index < client->ch_endpt_count - 1) {
-                    /* just go to the next endpoint */
-                    ++next_endpt_index;
-                } else {
-                    /* cur_endpoint is the last, start with the first one */
-                    next_endpt_index = 0;
-                }
-                cur_attempts = 0;
-            } /* else we keep the current one */
-        }
+    if (ret) {
+        free(stage);
 
-        cur_endpt = &client->ch_endpts[next_endpt_index];
-        free(cur_endpt_name);
-        cur_endpt_name = strdup(cur_endpt->name);
+        /* UNLOCK */
+        pthread_mutex_unlock(&server_opts.config_lock);
+        return -1;
     }
 
-cleanup:
-    VRB(NULL, "Call Home client \"%s\" thread exit.", data->client_name);
-    free(cur_endpt_name);
-    free(data->client_name);
-    free(data);
-    return NULL;
+    /* all the configuration functions of this thread now modify the staged configuration */
+    pthread_setspecific(server_opts.config_key, stage);
+    return 0;
 }
 
 API int
-nc_connect_ch_client_dispatch(const char *client_name, nc_server_ch_session_acquire_ctx_cb acquire_ctx_cb,
-        nc_server_ch_session_release_ctx_cb release_ctx_cb, void *ctx_cb_data, nc_server_ch_new_session_cb new_session_cb)
+nc_server_config_commit(void)
 {
-    int ret;
-    pthread_t tid;
-    struct nc_ch_client_thread_arg *arg;
+    struct nc_server_config *stage, prev;
+    int ret = 0;
 
-    if (!client_name) {
-        ERRARG("client_name");
-        return -1;
-    } else if (!acquire_ctx_cb) {
-        ERRARG("acquire_ctx_cb");
-        return -1;
-    } else if (!release_ctx_cb) {
-        ERRARG("release_ctx_cb");
-        return -1;
-    } else if (!new_session_cb) {
-        ERRARG("new_session_cb");
+    if (!nc_server_config_batch_get(&stage)) {
+        ERR(NULL, "No configuration batch started.");
         return -1;
     }
 
-    arg = malloc(sizeof *arg);
-    if (!arg) {
-        ERRMEM;
-        return -1;
+    /* may take a while, nothing is locked yet */
+    if (nc_server_config_load(stage)) {
+        ret = -1;
+        goto cleanup;
     }
-    arg->client_name = strdup(client_name);
-    if (!arg->client_name) {
-        ERRMEM;
-        free(arg);
-        return -1;
+
+    /* BIND LOCK */
+    pthread_mutex_lock(&server_opts.bind_lock);
+
+    /* ENDPT WRITE LOCK */
+    pthread_rwlock_wrlock(&server_opts.endpt_lock);
+
+    /* CH CLIENT WRITE LOCK */
+    pthread_rwlock_wrlock(&server_opts.ch_client_lock);
+
+    if (nc_server_config_listen(stage, &server_opts.config)) {
+        /* the current configuration is kept */
+        ret = -1;
+    } else {
+        /* swap the configurations */
+        nc_server_config_take(stage, &server_opts.config);
+        prev = server_opts.config;
+        server_opts.config = *stage;
+        *stage = prev;
     }
-    arg->acquire_ctx_cb = acquire_ctx_cb;
-    arg->release_ctx_cb = release_ctx_cb;
-    arg->ctx_cb_data = ctx_cb_data;
-    arg->new_session_cb = new_session_cb;
 
-    ret = pthread_create(&tid, NULL, nc_ch_client_thread, arg);
-    if (ret) {
-        ERR(NULL, "Creating a new thread failed (%s).", strerror(ret));
-        free(arg->client_name);
-        free(arg);
-        return -1;
+    /* CH CLIENT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.ch_client_lock);
+
+    /* ENDPT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+
+    /* BIND UNLOCK */
+    pthread_mutex_unlock(&server_opts.bind_lock);
+
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+    if (!ret) {
+        /* the jobs of the changed and removed clients act on the new configuration right away */
+        nc_ch_sched_client_changed(NULL);
     }
-    /* the thread now manages arg */
+#endif
 
-    pthread_detach(tid);
+cleanup:
+    /* free the previous configuration, or the staged one on error, as any other configuration */
+    pthread_setspecific(server_opts.config_key, NULL);
+    nc_server_config_clear(stage);
+    free(stage);
 
-    return 0;
-}
+    /* UNLOCK */
+    pthread_mutex_unlock(&server_opts.config_lock);
 
-#endif /* NC_ENABLED_SSH || NC_ENABLED_TLS */
+    return ret;
+}
 
 API time_t
 nc_session_get_start_time(const struct nc_session *session)
@@ -3762,53 +9524,37 @@ nc_session_inc_notif_status(struct nc_session *session)
         return;
     }
 
-    /* NTF STATUS LOCK */
-    pthread_mutex_lock(&session->opts.server.ntf_status_lock);
-
-    ++session->opts.server.ntf_status;
-
-    /* NTF STATUS UNLOCK */
-    pthread_mutex_unlock(&session->opts.server.ntf_status_lock);
+    ATOMIC_INC_RELAXED(session->opts.server.ntf_status);
 }
 
 API void
 nc_session_dec_notif_status(struct nc_session *session)
 {
+    uint_fast32_t ntf_status;
+
     if (!session || (session->side != NC_SERVER)) {
         ERRARG("session");
         return;
     }
 
-    /* NTF STATUS LOCK */
-    pthread_mutex_lock(&session->opts.server.ntf_status_lock);
-
-    if (session->opts.server.ntf_status) {
-        --session->opts.server.ntf_status;
-    }
-
-    /* NTF STATUS UNLOCK */
-    pthread_mutex_unlock(&session->opts.server.ntf_status_lock);
+    /* never decrease below zero */
+    do {
+        ntf_status = ATOMIC_LOAD_RELAXED(session->opts.server.ntf_status);
+        if (!ntf_status) {
+            break;
+        }
+    } while (!ATOMIC_CAS_RELAXED(session->opts.server.ntf_status, ntf_status, ntf_status - 1));
 }
 
 API int
 nc_session_get_notif_status(const struct nc_session *session)
 {
-    uint32_t ntf_status;
-
     if (!session || (session->side != NC_SERVER)) {
         ERRARG("session");
         return 0;
     }
 
-    /* NTF STATUS LOCK */
-    pthread_mutex_lock(&((struct nc_session *)session)->opts.server.ntf_status_lock);
-
-    ntf_status = session->opts.server.ntf_status;
-
-    /* NTF STATUS UNLOCK */
-    pthread_mutex_unlock(&((struct nc_session *)session)->opts.server.ntf_status_lock);
-
-    return ntf_status;
+    return ATOMIC_LOAD_RELAXED(((struct nc_session *)session)->opts.server.ntf_status);
 }
 
 API int
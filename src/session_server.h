@@ -135,6 +135,18 @@ int nc_server_init(void);
  */
 void nc_server_destroy(void);
 
+/**
+ * @brief Drop all the data the server cached for a context.
+ *
+ * The server capabilities and the modules printed for \<get-schema\> are cached for the last context
+ * they were created from, which is identified by its address and change count. Call this function
+ * before destroying a context used by the server, a new context created at the same address would
+ * otherwise be served the cached data of the old one.
+ *
+ * @param[in] ctx Context about to be destroyed.
+ */
+void nc_server_ctx_release(const struct ly_ctx *ctx);
+
 /**
  * @brief Set the with-defaults capability extra parameters.
  *
@@ -213,6 +225,215 @@ void nc_server_set_idle_timeout(uint16_t idle_timeout);
  */
 uint16_t nc_server_get_idle_timeout(void);
 
+/**
+ * @brief Global statistics of all the server sessions, see ietf-netconf-monitoring for the meaning of the counters.
+ */
+struct nc_server_stats {
+    time_t start_time;              /**< real time the server was initialized (netconf-start-time) */
+    uint32_t in_bad_hellos;         /**< sessions dropped because of an invalid \<hello\> */
+    uint32_t in_sessions;           /**< sessions started */
+    uint32_t dropped_sessions;      /**< sessions terminated abnormally, not by \<close-session\> nor \<kill-session\> */
+    uint32_t in_rpcs;               /**< correct \<rpc\> messages received */
+    uint32_t in_bad_rpcs;           /**< messages received that were not correct \<rpc\> messages */
+    uint32_t out_rpc_errors;        /**< \<rpc-reply\> messages with \<rpc-error\> sent */
+    uint32_t out_notifications;     /**< \<notification\> messages sent */
+};
+
+/**
+ * @brief Get the global statistics of all the server sessions.
+ *
+ * The counters are updated without locking so they can be read any time. Statistics
+ * of a single session are available by ::nc_session_get_stats().
+ *
+ * @param[out] stats Current statistics.
+ */
+void nc_server_get_stats(struct nc_server_stats *stats);
+
+/**
+ * @brief Stages of processing an RPC by ::nc_ps_poll().
+ */
+typedef enum {
+    NC_RPC_STAGE_PS_LOCK = 0,   /**< waiting for the pollsession lock */
+    NC_RPC_STAGE_READ,          /**< reading the message from the transport */
+    NC_RPC_STAGE_PARSE,         /**< parsing the RPC */
+    NC_RPC_STAGE_CALLBACK,      /**< the RPC callback (#nc_rpc_clb) */
+    NC_RPC_STAGE_PRINT,         /**< printing the reply */
+    NC_RPC_STAGE_WRITE          /**< writing the reply into the transport */
+} NC_RPC_STAGE;
+
+/**
+ * @brief Number of the RPC processing stages.
+ */
+#define NC_RPC_STAGE_COUNT 6
+
+/**
+ * @brief Latency summary of an RPC processing stage, all the times are in microseconds.
+ *
+ * The percentiles are taken from a histogram with a relative precision of 12.5 %.
+ */
+struct nc_rpc_latency {
+    uint64_t count;                 /**< number of measurements */
+    uint64_t sum;                   /**< sum of all the measurements */
+    uint64_t min;                   /**< minimal measurement */
+    uint64_t max;                   /**< maximal measurement */
+    uint64_t p50;                   /**< median */
+    uint64_t p90;                   /**< 90th percentile */
+    uint64_t p99;                   /**< 99th percentile */
+    uint64_t p999;                  /**< 99.9th percentile */
+};
+
+/**
+ * @brief Enable or disable measuring the latency of the RPC processing stages.
+ *
+ * When enabled, the time spent in every #NC_RPC_STAGE is measured for every valid RPC processed
+ * by ::nc_ps_poll() and added into histograms kept for every RPC name. Disabling it keeps
+ * the collected histograms.
+ *
+ * @param[in] enable Whether to measure the latencies or not.
+ */
+void nc_server_set_rpc_latency(int enable);
+
+/**
+ * @brief Get the latency summary of an RPC processing stage.
+ *
+ * @param[in] rpc_name Name of the RPC in the form "<module>:<rpc>", for actions the name of the action.
+ * NULL for all the RPCs together.
+ * @param[in] stage Stage to summarize.
+ * @param[out] latency Latency summary, zeroed if nothing was measured for @p rpc_name.
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_get_rpc_latency(const char *rpc_name, NC_RPC_STAGE stage, struct nc_rpc_latency *latency);
+
+/**
+ * @brief Get the names of all the RPCs with some latency measured.
+ *
+ * @param[out] names NULL-terminated array of RPC names, the caller is supposed to free the names
+ * and the array.
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_get_rpc_latency_names(char ***names);
+
+/**
+ * @brief Discard all the collected RPC latency histograms.
+ */
+void nc_server_reset_rpc_latency(void);
+
+/**
+ * @brief Prototype of a callback called at the beginning and at the end of every RPC processing stage.
+ *
+ * The callback is meant for tracing and so it should return as fast as possible. The reply is written
+ * while it is being printed so #NC_RPC_STAGE_PRINT covers the whole reply output and the callback is never
+ * called for #NC_RPC_STAGE_WRITE, whose latency is only measured.
+ *
+ * @param[in] session Session processing the RPC, NULL for #NC_RPC_STAGE_PS_LOCK.
+ * @param[in] rpc Parsed RPC, NULL until the end of #NC_RPC_STAGE_PARSE and for invalid RPCs.
+ * @param[in] stage Current stage.
+ * @param[in] end 0 at the beginning of @p stage, 1 at its end.
+ * @param[in] user_data Arbitrary user data set with the callback.
+ */
+typedef void (*nc_rpc_trace_clb)(const struct nc_session *session, const struct lyd_node *rpc, NC_RPC_STAGE stage,
+        int end, void *user_data);
+
+/**
+ * @brief Set the callback for tracing the RPC processing stages of ::nc_ps_poll().
+ *
+ * The callback can be replaced while sessions are being polled, the previous one may still be called by threads
+ * that have already loaded it and so its user data are freed only once no thread is calling it.
+ *
+ * @param[in] trace_clb Callback to call around every stage, NULL to disable tracing.
+ * @param[in] user_data Optional arbitrary user data that will be passed to @p trace_clb.
+ * @param[in] free_user_data Optional callback that will be called during cleanup to free any @p user_data.
+ */
+void nc_server_set_rpc_trace_clb(nc_rpc_trace_clb trace_clb, void *user_data, void (*free_user_data)(void *user_data));
+
+/**
+ * @brief Prototype of a callback deciding about a received RPC before its content is parsed.
+ *
+ * Only the \<rpc\> element and the start tag of the operation are read before the callback is called,
+ * so rejecting an RPC or answering it without its parameters costs no parsing or validation.
+ *
+ * @param[in] session Session the RPC was received on.
+ * @param[in] msgid Message-id of the RPC.
+ * @param[in] module_ns Namespace of the operation element, which is the namespace of its YANG module
+ * for RPCs and the namespace of the top-level data node for actions.
+ * @param[in] name Name of the operation element, the top-level data node for actions.
+ * @param[in] user_data Arbitrary user data set with the callback.
+ * @return Reply to send right away, the RPC is then not parsed and its callback not called;
+ * @return NULL to parse the RPC and process it normally.
+ */
+typedef struct nc_server_reply *(*nc_rpc_envelope_clb)(const struct nc_session *session, const char *msgid,
+        const char *module_ns, const char *name, void *user_data);
+
+/**
+ * @brief Set the callback for deciding about every received RPC based only on its envelope.
+ *
+ * The envelope is read on its own only if the callback is set. Messages that cannot be reliably read this way,
+ * for example those with character references in the \<rpc\> attributes, are fully parsed first and
+ * the callback is called afterwards with the same information so it is called for every valid RPC.
+ * The callback can be replaced while sessions are being polled, the same way as ::nc_server_set_rpc_trace_clb().
+ *
+ * @param[in] envelope_clb Callback to call for every received RPC, NULL to always parse the whole RPCs (default).
+ * @param[in] user_data Optional arbitrary user data that will be passed to @p envelope_clb.
+ * @param[in] free_user_data Optional callback that will be called during cleanup to free any @p user_data.
+ */
+void nc_server_set_rpc_envelope_clb(nc_rpc_envelope_clb envelope_clb, void *user_data,
+        void (*free_user_data)(void *user_data));
+
+/**
+ * @brief Set the size of server session output queues.
+ *
+ * With a non-zero size, messages written into sessions with any but the in-memory transport
+ * are appended to a per-session output queue and written only as the transport accepts
+ * them so that a slow peer does not block the writing thread. The queues are written by every
+ * further message written into the session and by ::nc_ps_poll(), which waits for the transports
+ * to become writable. While the queue is full, no notification is sent and ::nc_server_notif_send()
+ * returns #NC_MSG_WOULDBLOCK. Replies are always queued, but a reply that does not fit into the queue
+ * blocks the writing thread until the queued data are written. Blocking file descriptors of
+ * ::nc_accept_inout() sessions are written only once writable, PIPE_BUF bytes at a time.
+ *
+ * @param[in] size Queue size in bytes, 0 to write all the messages directly (default).
+ */
+void nc_server_set_out_queue_size(uint32_t size);
+
+/**
+ * @brief Get the size of server session output queues.
+ *
+ * @return Queue size in bytes, 0 if the output queues are not used.
+ */
+uint32_t nc_server_get_out_queue_size(void);
+
+/**
+ * @brief Set the maximum number of RPCs of a session processed by a single ::nc_ps_poll() call.
+ *
+ * Once an RPC is processed, any further RPCs already received on the same session, pipelined by the client,
+ * are processed right away up to this count while the session stays locked. Their replies are written in order
+ * and together once all the RPCs are processed. The return value of ::nc_ps_poll() then combines the flags
+ * of all the processed RPCs.
+ *
+ * @param[in] count Maximum number of processed RPCs, 0 or 1 to always process a single RPC (default).
+ */
+void nc_server_set_rpc_batch(uint16_t count);
+
+/**
+ * @brief Get the maximum number of RPCs of a session processed by a single ::nc_ps_poll() call.
+ *
+ * @return Maximum number of processed RPCs.
+ */
+uint16_t nc_server_get_rpc_batch(void);
+
+/**
+ * @brief Set whether the listening TCP sockets of endpoints are created with SO_REUSEPORT.
+ *
+ * It allows every thread of an acceptor (::nc_acceptor_new()) to listen on its own sockets and the kernel
+ * then distributes the new connections among them. It must be set before any endpoint address and port
+ * are set, it cannot be changed once an endpoint listens on a TCP socket. Other processes of the same user
+ * can then also listen on the same ports.
+ *
+ * @param[in] enable Whether to use SO_REUSEPORT, disabled by default.
+ * @return 0 on success, -1 if not supported or an endpoint is already listening.
+ */
+int nc_server_set_reuseport(int enable);
+
 /**
  * @brief Get all the server capabilities including all the schemas.
  *
@@ -260,6 +481,24 @@ char **nc_server_get_cpblts_version(const struct ly_ctx *ctx, LYS_VERSION versio
 NC_MSG_TYPE nc_accept_inout(int fdin, int fdout, const char *username, const struct ly_ctx *ctx,
         struct nc_session **session);
 
+/**
+ * @brief Create a new pair of connected server and client sessions in this process (::NC_TI_MEM).
+ *
+ * The sessions exchange messages through shared in-memory ring buffers without any system calls
+ * except for waking up a session waiting for data, whose transport file descriptor can be polled
+ * as usual. The handshake of both sessions is performed by this function so no other thread
+ * is needed. The client session uses @p ctx as is, it is not filled with the server modules
+ * because it contains all of them. It must not be destroyed before both of the sessions are freed.
+ *
+ * @param[in] username NETCONF username of the client.
+ * @param[in] ctx Context for both of the sessions to use.
+ * @param[out] server New server session on success.
+ * @param[out] client New client session on success.
+ * @return NC_MSG_HELLO on success, NC_MSG_BAD_HELLO on \<hello\> message parsing fail, NC_MSG_ERROR on other errors.
+ */
+NC_MSG_TYPE nc_accept_mem(const char *username, const struct ly_ctx *ctx, struct nc_session **server,
+        struct nc_session **client);
+
 /**
  * @brief Create an empty structure for polling sessions.
  *
@@ -342,6 +581,8 @@ uint16_t nc_ps_session_count(struct nc_pollsession *ps);
 #define NC_PSPOLL_SESSION_TERM 0x0020  /**< Some session was terminated. */
 #define NC_PSPOLL_SESSION_ERROR 0x0040 /**< Some session was terminated incorrectly (not by a \<close-session\> or \<kill-session\> RPC). */
 #define NC_PSPOLL_ERROR 0x0080         /**< Other fatal errors (they are printed). */
+#define NC_PSPOLL_HANDSHAKE 0x0400     /**< Handshake of a session accepted by nc_accept_nonblock() progressed,
+                                            it finished if the session is running. */
 
 #ifdef NC_ENABLED_SSH
 # define NC_PSPOLL_SSH_MSG 0x00100      /**< SSH message received (and processed, if relevant, only with SSH support). */
@@ -353,7 +594,8 @@ uint16_t nc_ps_session_count(struct nc_pollsession *ps);
  *
  * Only one event on one session is handled in one function call. If this event
  * is a session termination (#NC_PSPOLL_SESSION_TERM returned), the session
- * should be removed from @p ps.
+ * should be removed from @p ps. Sessions accepted by ::nc_accept_nonblock() with
+ * their handshake in progress are advanced whenever they have new data (#NC_PSPOLL_HANDSHAKE).
  *
  * @param[in] ps Pollsession structure to use.
  * @param[in] timeout Poll timeout in milliseconds. 0 for non-blocking call, -1 for
@@ -376,6 +618,174 @@ int nc_ps_poll(struct nc_pollsession *ps, int timeout, struct nc_session **sessi
  */
 void nc_ps_clear(struct nc_pollsession *ps, int all, void (*data_free)(void *));
 
+/**
+ * @brief A pollsession dispatcher, has its own threads polling the sessions and processing RPCs.
+ */
+struct nc_ps_dispatcher;
+
+/**
+ * @brief Callback for an event processed by a pollsession dispatcher.
+ *
+ * Called from one of the dispatcher worker threads, possibly in parallel for different sessions.
+ * If the event is a session termination (#NC_PSPOLL_SESSION_TERM in @p ret), the session
+ * should be removed from @p ps and freed.
+ *
+ * @param[in] ps Pollsession structure of the dispatcher.
+ * @param[in] session Session the event concerns.
+ * @param[in] ret Bitfield of NC_PSPOLL_* macros the same as nc_ps_poll() would return.
+ * @param[in] user_data Arbitrary user data.
+ */
+typedef void (*nc_ps_dispatch_clb)(struct nc_pollsession *ps, struct nc_session *session, int ret, void *user_data);
+
+/**
+ * @brief Start dispatching events of sessions in a pollsession structure.
+ *
+ * One thread is waiting for events on the sessions in @p ps and passes them to @p worker_count
+ * threads, which receive the RPCs and send their replies as nc_ps_poll() would. Sessions can be
+ * added to and removed from @p ps while being dispatched.
+ *
+ * @param[in] ps Pollsession structure to dispatch.
+ * @param[in] worker_count Number of worker threads.
+ * @param[in] event_clb Callback called for every processed event, can be NULL.
+ * @param[in] user_data Arbitrary user data passed to @p event_clb.
+ * @return Running dispatcher, NULL on error.
+ */
+struct nc_ps_dispatcher *nc_ps_dispatcher_new(struct nc_pollsession *ps, uint16_t worker_count,
+        nc_ps_dispatch_clb event_clb, void *user_data);
+
+/**
+ * @brief Stop a pollsession dispatcher and free it.
+ *
+ * Waits for all the threads to finish processing their events. The pollsession structure
+ * is not freed.
+ *
+ * @param[in] disp Dispatcher to stop.
+ */
+void nc_ps_dispatcher_free(struct nc_ps_dispatcher *disp);
+
+/**
+ * @brief An acceptor, has its own threads accepting new sessions on all the endpoints.
+ */
+struct nc_acceptor;
+
+/**
+ * @brief Callback for a new session accepted by an acceptor.
+ *
+ * Called from one of the acceptor worker threads, possibly in parallel. The session is then owned
+ * by the callback, typically it is added into a pollsession.
+ *
+ * @param[in] session New running session.
+ * @param[in] user_data Arbitrary user data.
+ */
+typedef void (*nc_acceptor_clb)(struct nc_session *session, void *user_data);
+
+/**
+ * @brief Start accepting new sessions on all the endpoints by dedicated threads.
+ *
+ * Every one of @p thread_count threads waits for new connections on the endpoints and passes them
+ * to @p worker_count threads, which perform the transport (SSH, TLS) and NETCONF handshakes
+ * so that a slow handshake does not delay accepting other connections. If SO_REUSEPORT is enabled
+ * (::nc_server_set_reuseport()), all the threads except the first one listen on their own TCP sockets,
+ * otherwise they share the endpoint sockets. Endpoints can be changed while the acceptor is running
+ * and ::nc_accept() can be used at the same time.
+ *
+ * @param[in] ctx Context for the sessions to use.
+ * @param[in] thread_count Number of threads accepting connections.
+ * @param[in] worker_count Number of threads performing handshakes.
+ * @param[in] session_clb Callback called for every new session.
+ * @param[in] user_data Arbitrary user data passed to @p session_clb.
+ * @return Running acceptor, NULL on error.
+ */
+struct nc_acceptor *nc_acceptor_new(const struct ly_ctx *ctx, uint16_t thread_count, uint16_t worker_count,
+        nc_acceptor_clb session_clb, void *user_data);
+
+/**
+ * @brief Stop an acceptor and free it.
+ *
+ * Waits for all the threads to finish their handshakes in progress. Connections not yet handshaken are closed.
+ *
+ * @param[in] acc Acceptor to stop.
+ */
+void nc_acceptor_free(struct nc_acceptor *acc);
+
+/**
+ * @brief A group of pollsession structures (shards) with the sessions distributed among them.
+ *
+ * Each shard is a standard pollsession with its own lock so threads polling different shards
+ * do not contend with each other. Sessions are assigned to shards based on their ID and moved
+ * between them if the shards become unbalanced.
+ */
+struct nc_ps_group;
+
+/**
+ * @brief Create a pollsession group.
+ *
+ * @param[in] shard_count Number of shards, typically the number of polling threads.
+ * @return Empty pollsession group, NULL on error.
+ */
+struct nc_ps_group *nc_ps_group_new(uint16_t shard_count);
+
+/**
+ * @brief Free a pollsession group including all its shards.
+ *
+ * !IMPORTANT! Make sure that @p group is not accessible (is not used)
+ * by any thread before and after this call!
+ *
+ * @param[in] group Pollsession group to free.
+ */
+void nc_ps_group_free(struct nc_ps_group *group);
+
+/**
+ * @brief Get a shard of a pollsession group.
+ *
+ * The shard can be used with nc_ps_poll() or nc_ps_dispatcher_new(), but sessions must be added
+ * and removed only using the group functions.
+ *
+ * @param[in] group Pollsession group to read from.
+ * @param[in] idx Index of the shard.
+ * @return Shard pollsession structure, NULL if out-of-bounds.
+ */
+struct nc_pollsession *nc_ps_group_get_shard(const struct nc_ps_group *group, uint16_t idx);
+
+/**
+ * @brief Learn the number of shards of a pollsession group.
+ *
+ * @param[in] group Pollsession group to check.
+ * @return Number of shards.
+ */
+uint16_t nc_ps_group_shard_count(const struct nc_ps_group *group);
+
+/**
+ * @brief Add a session to a pollsession group.
+ *
+ * @param[in] group Pollsession group to modify.
+ * @param[in] session Session to add to @p group.
+ * @return 0 on success, -1 on error.
+ */
+int nc_ps_group_add_session(struct nc_ps_group *group, struct nc_session *session);
+
+/**
+ * @brief Remove a session from a pollsession group.
+ *
+ * If the shards become unbalanced after the removal, some idle sessions are moved between them.
+ *
+ * @param[in] group Pollsession group to modify.
+ * @param[in] session Session to remove from @p group.
+ * @return 0 on success, -1 on not found.
+ */
+int nc_ps_group_del_session(struct nc_ps_group *group, struct nc_session *session);
+
+/**
+ * @brief Move idle sessions from the most loaded shards to the least loaded shards of a pollsession group
+ * until the number of sessions in all of them is similar.
+ *
+ * Sessions that are being worked with are never moved.
+ *
+ * @param[in] group Pollsession group to rebalance.
+ * @return Number of moved sessions, -1 on error.
+ */
+int nc_ps_group_rebalance(struct nc_ps_group *group);
+
 /** @} Server Session */
 
 /**
@@ -484,6 +894,34 @@ int nc_server_endpt_enable_keepalives(const char *endpt_name, int enable);
  */
 int nc_server_endpt_set_keepalives(const char *endpt_name, int idle_time, int max_probes, int probe_interval);
 
+/**
+ * @brief Start a batch of server configuration changes.
+ *
+ * The endpoint and Call Home client configuration is copied and all the server configuration
+ * functions called by this thread until ::nc_server_config_commit() modify only the staged copy,
+ * without taking any configuration locks. Other threads keep accepting sessions and calling home
+ * with the current configuration meanwhile. Only one batch can be in progress at a time, another
+ * thread starting a batch waits for the commit. The configuration changes made by other threads
+ * without a batch are overwritten by the commit.
+ *
+ * @return 0 on success, -1 if a batch was already started by this thread or on error.
+ */
+int nc_server_config_begin(void);
+
+/**
+ * @brief Apply a batch of server configuration changes started by ::nc_server_config_begin().
+ *
+ * The CRLs whose locations changed are loaded and the listening sockets of the endpoints whose
+ * address or port changed are created, the sockets of the others are kept. Then the staged
+ * configuration replaces the current one at once, keeping the SSH binds, TLS contexts, and
+ * cert-to-name indices of what did not change. On error, the staged configuration is discarded
+ * and the current one is kept as a whole. The batch is finished in both cases.
+ *
+ * @return 0 on success, -1 if no batch was started by this thread, an endpoint failed to listen,
+ * or on another error.
+ */
+int nc_server_config_commit(void);
+
 /** @} Server */
 
 /**
@@ -516,6 +954,39 @@ int nc_server_endpt_set_keepalives(const char *endpt_name, int idle_time, int ma
  */
 NC_MSG_TYPE nc_accept(int timeout, const struct ly_ctx *ctx, struct nc_session **session);
 
+/**
+ * @brief Accept a new session on a pre-configured endpoint without waiting for its handshake.
+ *
+ * Only waits for a new connection, its transport (SSH, TLS) and NETCONF handshakes are then
+ * advanced with the data available. If not yet finished, the session is returned in
+ * #NC_STATUS_STARTING status and its handshake must be continued by ::nc_session_handshake()
+ * or by adding the session into a pollsession, which advances it whenever there are new data
+ * (#NC_PSPOLL_HANDSHAKE). This way a few threads can handle many concurrent handshakes.
+ *
+ * @param[in] timeout Timeout for receiving a new connection in milliseconds, 0 for
+ * non-blocking call, -1 for infinite waiting.
+ * @param[in] ctx Context for the session to use.
+ * @param[out] session New session.
+ * @return NC_MSG_HELLO if the handshake finished, NC_MSG_NONE if it is in progress,
+ *         NC_MSG_BAD_HELLO on client \<hello\> message parsing fail, NC_MSG_WOULDBLOCK on timeout,
+ *         NC_MSG_ERROR on other errors.
+ */
+NC_MSG_TYPE nc_accept_nonblock(int timeout, const struct ly_ctx *ctx, struct nc_session **session);
+
+/**
+ * @brief Continue the handshake of a session accepted by ::nc_accept_nonblock().
+ *
+ * Processes all the handshake data available without blocking. Once the handshake finishes,
+ * the session is running. On failure, including an elapsed timeout of any handshake stage,
+ * the session is invalid and should be freed.
+ *
+ * @param[in] session Session with a handshake in progress.
+ * @return NC_MSG_HELLO if the handshake finished, NC_MSG_NONE if it is still in progress,
+ *         NC_MSG_BAD_HELLO on client \<hello\> message parsing fail, NC_MSG_WOULDBLOCK on a handshake
+ *         timeout, NC_MSG_ERROR on other errors.
+ */
+NC_MSG_TYPE nc_session_handshake(struct nc_session *session);
+
 #ifdef NC_ENABLED_SSH
 
 /**
@@ -844,6 +1315,18 @@ int nc_server_tls_endpt_set_trusted_ca_paths(const char *endpt_name, const char
  */
 int nc_server_tls_endpt_set_crl_paths(const char *endpt_name, const char *crl_file, const char *crl_dir);
 
+/**
+ * @brief Set whether to request kernel TLS (kTLS) offload of the sessions accepted on an endpoint.
+ *        The kernel then encrypts and decrypts the records once the handshake is finished,
+ *        if OpenSSL (3.0 or newer), the kernel, and the negotiated cipher support it,
+ *        otherwise the session silently falls back to OpenSSL. Check the result with nc_session_get_ktls().
+ *
+ * @param[in] endpt_name Existing endpoint name.
+ * @param[in] enable Whether to request the offload, disabled by default.
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_tls_endpt_set_ktls(const char *endpt_name, int enable);
+
 /**
  * @brief Destroy and clean CRLs. Certificates, private keys, and CTN entries are
  *        not affected.
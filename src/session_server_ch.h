@@ -219,14 +219,21 @@ typedef void (*nc_server_ch_session_release_ctx_cb)(void *cb_data);
 typedef int (*nc_server_ch_new_session_cb)(const char *client_name, struct nc_session *new_session);
 
 /**
- * @brief Dispatch a thread connecting to a listening NETCONF client and creating Call Home sessions.
+ * @brief Dispatch connecting to a listening NETCONF client and creating Call Home sessions.
+ *
+ * All the dispatched clients are handled by a single Call Home scheduler started with the first one. Its thread
+ * waits for the next connection attempts of all the clients and for the sockets of their connections and handshakes
+ * in progress, a few worker threads then perform the non-blocking steps of the connections and handshakes. Failed
+ * attempts are retried after a slightly randomized backoff. Established sessions are checked only for the periodic
+ * idle timeout and once they are freed. The scheduler stops dispatching the client once it is removed and it is
+ * stopped by ::nc_server_destroy().
  *
  * @param[in] client_name Existing client name.
  * @param[in] acquire_ctx_cb Callback for acquiring new session context.
  * @param[in] release_ctx_cb Callback for releasing session context.
  * @param[in] ctx_cb_data Arbitrary user data passed to @p acquire_ctx_cb and @p release_ctx_cb.
  * @param[in] new_session_cb Callback called for every established session on the client.
- * @return 0 if the thread was successfully created, -1 on error.
+ * @return 0 if the client was successfully dispatched, -1 on error.
  */
 int nc_connect_ch_client_dispatch(const char *client_name, nc_server_ch_session_acquire_ctx_cb acquire_ctx_cb,
         nc_server_ch_session_release_ctx_cb release_ctx_cb, void *ctx_cb_data, nc_server_ch_new_session_cb new_session_cb);
@@ -395,6 +402,17 @@ int nc_server_tls_ch_client_endpt_set_trusted_ca_paths(const char *client_name,
 int nc_server_tls_ch_client_endpt_set_crl_paths(const char *client_name, const char *endpt_name, const char *crl_file,
         const char *crl_dir);
 
+/**
+ * @brief Set whether to request kernel TLS (kTLS) offload of Call Home sessions,
+ *        see nc_server_tls_endpt_set_ktls().
+ *
+ * @param[in] client_name Existing Call Home client name.
+ * @param[in] endpt_name Existing endpoint name of the client.
+ * @param[in] enable Whether to request the offload, disabled by default.
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_tls_ch_client_endpt_set_ktls(const char *client_name, const char *endpt_name, int enable);
+
 /**
  * @brief Destroy and clean Call Home CRLs. Call Home certificates, private keys,
  *        and CTN entries are not affected.
@@ -48,6 +48,9 @@ pthread_mutex_t crypt_lock = PTHREAD_MUTEX_INITIALIZER;
 
 extern struct nc_server_opts server_opts;
 
+/* cached SSH binds, increasing the generation invalidates all of them */
+static ATOMIC_T sbind_gen;
+
 static char *
 base64der_key_to_tmp_file(const char *in, const char *key_str)
 {
@@ -103,6 +106,25 @@ base64der_key_to_tmp_file(const char *in, const char *key_str)
     return strdup(path);
 }
 
+/**
+ * @brief Free the cached SSH bind of options so that the host keys are loaded again on the next accept.
+ *
+ * @param[in] opts SSH options.
+ */
+static void
+nc_server_ssh_bind_invalidate(struct nc_server_ssh_opts *opts)
+{
+    /* SBIND LOCK */
+    pthread_mutex_lock(&opts->sbind_lock);
+
+    ssh_bind_free(opts->sbind);
+    opts->sbind = NULL;
+    opts->sbind_keep = 0;
+
+    /* SBIND UNLOCK */
+    pthread_mutex_unlock(&opts->sbind_lock);
+}
+
 static int
 nc_server_ssh_add_hostkey(const char *name, int16_t idx, struct nc_server_ssh_opts *opts)
 {
@@ -123,6 +145,8 @@ nc_server_ssh_add_hostkey(const char *name, int16_t idx, struct nc_server_ssh_op
         }
     }
 
+    nc_server_ssh_bind_invalidate(opts);
+
     ++opts->hostkey_count;
     opts->hostkeys = nc_realloc(opts->hostkeys, opts->hostkey_count * sizeof *opts->hostkeys);
     if (!opts->hostkeys) {
@@ -156,7 +180,7 @@ nc_server_ssh_endpt_add_hostkey(const char *endpt_name, const char *name, int16_
     ret = nc_server_ssh_add_hostkey(name, idx, endpt->opts.ssh);
 
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -262,6 +286,9 @@ nc_server_ssh_set_hostkey_clb(int (*hostkey_clb)(const char *name, void *user_da
     server_opts.hostkey_clb = hostkey_clb;
     server_opts.hostkey_data = user_data;
     server_opts.hostkey_data_free = free_user_data;
+
+    /* invalidate all the cached binds */
+    ATOMIC_INC_RELAXED(sbind_gen);
 }
 
 static int
@@ -276,6 +303,8 @@ nc_server_ssh_del_hostkey(const char *name, int16_t idx, struct nc_server_ssh_op
         ERRARG("idx");
     }
 
+    nc_server_ssh_bind_invalidate(opts);
+
     if (!name && (idx < 0)) {
         for (i = 0; i < opts->hostkey_count; ++i) {
             free(opts->hostkeys[i]);
@@ -324,7 +353,7 @@ nc_server_ssh_endpt_del_hostkey(const char *endpt_name, const char *name, int16_
     ret = nc_server_ssh_del_hostkey(name, idx, endpt->opts.ssh);
 
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -388,6 +417,9 @@ nc_server_ssh_mov_hostkey(const char *key_mov, const char *key_after, struct nc_
         return 0;
     }
 
+    /* the first key of a type is used */
+    nc_server_ssh_bind_invalidate(opts);
+
     /* finally move the key */
     bckup = opts->hostkeys[mov_idx];
     if (mov_idx > after_idx) {
@@ -417,7 +449,7 @@ nc_server_ssh_endpt_mov_hostkey(const char *endpt_name, const char *key_mov, con
     ret = nc_server_ssh_mov_hostkey(key_mov, key_after, endpt->opts.ssh);
 
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -471,7 +503,7 @@ nc_server_ssh_endpt_set_auth_methods(const char *endpt_name, int auth_methods)
     ret = nc_server_ssh_set_auth_methods(auth_methods, endpt->opts.ssh);
 
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -512,7 +544,7 @@ nc_server_ssh_endpt_get_auth_methods(const char *endpt_name)
     ret = endpt->opts.ssh->auth_methods;
 
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -565,7 +597,7 @@ nc_server_ssh_endpt_set_auth_attempts(const char *endpt_name, uint16_t auth_atte
     ret = nc_server_ssh_set_auth_attempts(auth_attempts, endpt->opts.ssh);
 
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -618,7 +650,7 @@ nc_server_ssh_endpt_set_auth_timeout(const char *endpt_name, uint16_t auth_timeo
     ret = nc_server_ssh_set_auth_timeout(auth_timeout, endpt->opts.ssh);
 
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -644,25 +676,226 @@ nc_server_ssh_ch_client_endpt_set_auth_timeout(const char *client_name, const ch
     return ret;
 }
 
+/**
+ * @brief Learn the hash of an SSH key fingerprint.
+ *
+ * @param[in] key SSH key.
+ * @param[out] hash Fingerprint hash.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_server_ssh_key_hash(const ssh_key key, uint32_t *hash)
+{
+    unsigned char *fp;
+    size_t fp_len;
+
+    if (ssh_get_publickey_hash(key, SSH_PUBLICKEY_HASH_SHA1, &fp, &fp_len)) {
+        return -1;
+    }
+
+    *hash = nc_hash_fnv1a(NC_HASH_FNV1A_INIT, fp, fp_len);
+
+    ssh_clean_pubkey_hash(&fp);
+    return 0;
+}
+
+/**
+ * @brief Remember the version of an authorized key file.
+ *
+ * @param[out] file Authorized key file version to set.
+ * @param[in] st Current file status.
+ */
+static void
+nc_server_ssh_authkey_file_set(struct nc_authkey_file *file, const struct stat *st)
+{
+    struct timespec ts_cur;
+
+    file->mtime = st->st_mtim;
+    file->ctime = st->st_ctim;
+    file->size = st->st_size;
+    file->ino = st->st_ino;
+
+    /* the timestamps have a coarse granularity, another change right after this one could keep them the same */
+    clock_gettime(CLOCK_REALTIME, &ts_cur);
+    file->racy = (st->st_ctim.tv_sec + NC_AUTHKEY_RACY_TIME > ts_cur.tv_sec) ? 1 : 0;
+}
+
+/**
+ * @brief Check whether an authorized key file may have changed since its version was remembered.
+ *
+ * @param[in] file Remembered authorized key file version.
+ * @param[in] st Current file status.
+ * @return Whether the file may have changed.
+ */
+static int
+nc_server_ssh_authkey_file_changed(const struct nc_authkey_file *file, const struct stat *st)
+{
+    if (file->racy) {
+        return 1;
+    }
+
+    /* the change time cannot be set by anyone, unlike the modification time (cp -p, rsync -t) */
+    return (file->mtime.tv_sec != st->st_mtim.tv_sec) || (file->mtime.tv_nsec != st->st_mtim.tv_nsec) ||
+            (file->ctime.tv_sec != st->st_ctim.tv_sec) || (file->ctime.tv_nsec != st->st_ctim.tv_nsec) ||
+            (file->size != st->st_size) || (file->ino != st->st_ino);
+}
+
+/**
+ * @brief Import an authorized key, keeping the previous one on error. Authkey lock is expected to be held.
+ *
+ * @param[in] idx Index of the authorized key.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_server_ssh_authkey_import(uint16_t idx)
+{
+    ssh_key pub_key = NULL;
+    struct stat st;
+    int ret = 0;
+
+    switch (server_opts.authkeys[idx].type) {
+    case NC_SSH_KEY_UNKNOWN:
+        /* remember the file version even when the import fails, it will not be retried until it changes */
+        if (stat(server_opts.authkeys[idx].path, &st)) {
+            memset(&server_opts.authkeys[idx].file, 0, sizeof server_opts.authkeys[idx].file);
+        } else {
+            nc_server_ssh_authkey_file_set(&server_opts.authkeys[idx].file, &st);
+        }
+        ret = ssh_pki_import_pubkey_file(server_opts.authkeys[idx].path, &pub_key);
+        break;
+    case NC_SSH_KEY_DSA:
+        ret = ssh_pki_import_pubkey_base64(server_opts.authkeys[idx].base64, SSH_KEYTYPE_DSS, &pub_key);
+        break;
+    case NC_SSH_KEY_RSA:
+        ret = ssh_pki_import_pubkey_base64(server_opts.authkeys[idx].base64, SSH_KEYTYPE_RSA, &pub_key);
+        break;
+    case NC_SSH_KEY_ECDSA:
+        ret = ssh_pki_import_pubkey_base64(server_opts.authkeys[idx].base64, SSH_KEYTYPE_ECDSA, &pub_key);
+        break;
+    }
+
+    if (ret == SSH_EOF) {
+        WRN(NULL, "Failed to import a public key of \"%s\" (File access problem).", server_opts.authkeys[idx].username);
+        return -1;
+    } else if (ret == SSH_ERROR) {
+        WRN(NULL, "Failed to import a public key of \"%s\" (SSH error).", server_opts.authkeys[idx].username);
+        return -1;
+    }
+
+    if (nc_server_ssh_key_hash(pub_key, &server_opts.authkeys[idx].hash)) {
+        WRN(NULL, "Failed to get a public key fingerprint of \"%s\".", server_opts.authkeys[idx].username);
+        ssh_key_free(pub_key);
+        return -1;
+    }
+
+    ssh_key_free(server_opts.authkeys[idx].key);
+    server_opts.authkeys[idx].key = pub_key;
+    return 0;
+}
+
+static void
+nc_server_ssh_authkey_index_insert(uint16_t idx)
+{
+    uint32_t slot, mask = server_opts.authkey_index_size - 1;
+
+    slot = server_opts.authkeys[idx].hash & mask;
+    while (server_opts.authkey_index[slot]) {
+        slot = (slot + 1) & mask;
+    }
+    server_opts.authkey_index[slot] = idx + 1;
+}
+
+/**
+ * @brief Create the authorized key index from scratch. Authkey lock is expected to be held.
+ *
+ * @return 0 on success, -1 on error (the index is empty and lookups fall back to a linear search).
+ */
+static int
+nc_server_ssh_authkey_index_rebuild(void)
+{
+    uint32_t size = NC_NAME_INDEX_MIN_SIZE;
+    uint16_t i;
+
+    free(server_opts.authkey_index);
+    server_opts.authkey_index = NULL;
+    server_opts.authkey_index_size = 0;
+    if (!server_opts.authkey_count) {
+        return 0;
+    }
+
+    /* keep the load factor at most 1/2 */
+    while (size < 2 * (uint32_t)server_opts.authkey_count) {
+        size <<= 1;
+    }
+    server_opts.authkey_index = calloc(size, sizeof *server_opts.authkey_index);
+    if (!server_opts.authkey_index) {
+        ERRMEM;
+        return -1;
+    }
+    server_opts.authkey_index_size = size;
+
+    for (i = 0; i < server_opts.authkey_count; ++i) {
+        if (server_opts.authkeys[i].key) {
+            nc_server_ssh_authkey_index_insert(i);
+        }
+    }
+
+    return 0;
+}
+
 static int
 _nc_server_ssh_add_authkey(const char *pubkey_path, const char *pubkey_base64, NC_SSH_KEY_TYPE type, const char *username)
 {
     int ret = 0;
+    uint16_t idx;
+    char *path = NULL, *base64 = NULL, *user;
+    void *tmp;
+
+    /* copy the strings first so that no incomplete key is indexed */
+    user = strdup(username);
+    if (!user || (pubkey_path && !(path = strdup(pubkey_path))) ||
+            (pubkey_base64 && !(base64 = strdup(pubkey_base64)))) {
+        ERRMEM;
+        free(user);
+        free(path);
+        return -1;
+    }
 
     /* LOCK */
     pthread_mutex_lock(&server_opts.authkey_lock);
 
-    ++server_opts.authkey_count;
-    server_opts.authkeys = nc_realloc(server_opts.authkeys, server_opts.authkey_count * sizeof *server_opts.authkeys);
-    if (!server_opts.authkeys) {
+    tmp = realloc(server_opts.authkeys, (server_opts.authkey_count + 1) * sizeof *server_opts.authkeys);
+    if (!tmp) {
         ERRMEM;
+        free(user);
+        free(path);
+        free(base64);
         ret = -1;
         goto cleanup;
     }
-    server_opts.authkeys[server_opts.authkey_count - 1].path = pubkey_path ? strdup(pubkey_path) : NULL;
-    server_opts.authkeys[server_opts.authkey_count - 1].base64 = pubkey_base64 ? strdup(pubkey_base64) : NULL;
-    server_opts.authkeys[server_opts.authkey_count - 1].type = type;
-    server_opts.authkeys[server_opts.authkey_count - 1].username = strdup(username);
+    server_opts.authkeys = tmp;
+    idx = server_opts.authkey_count++;
+    server_opts.authkeys[idx].path = path;
+    server_opts.authkeys[idx].base64 = base64;
+    server_opts.authkeys[idx].type = type;
+    server_opts.authkeys[idx].username = user;
+    server_opts.authkeys[idx].key = NULL;
+    server_opts.authkeys[idx].hash = 0;
+    memset(&server_opts.authkeys[idx].file, 0, sizeof server_opts.authkeys[idx].file);
+    if (pubkey_path) {
+        ++server_opts.authkey_path_count;
+    }
+
+    /* import the key only once now, it is not an error if it fails, as before */
+    if (nc_server_ssh_authkey_import(idx)) {
+        goto cleanup;
+    }
+
+    if (!server_opts.authkey_index || (2 * (uint32_t)server_opts.authkey_count > server_opts.authkey_index_size)) {
+        nc_server_ssh_authkey_index_rebuild();
+    } else {
+        nc_server_ssh_authkey_index_insert(idx);
+    }
 
 cleanup:
     /* UNLOCK */
@@ -716,21 +949,27 @@ nc_server_ssh_del_authkey(const char *pubkey_path, const char *pubkey_base64, NC
             free(server_opts.authkeys[i].path);
             free(server_opts.authkeys[i].base64);
             free(server_opts.authkeys[i].username);
+            ssh_key_free(server_opts.authkeys[i].key);
 
             ret = 0;
         }
         free(server_opts.authkeys);
         server_opts.authkeys = NULL;
         server_opts.authkey_count = 0;
+        server_opts.authkey_path_count = 0;
     } else {
         for (i = 0; i < server_opts.authkey_count; ++i) {
             if ((!pubkey_path || !strcmp(server_opts.authkeys[i].path, pubkey_path)) &&
                     (!pubkey_base64 || !strcmp(server_opts.authkeys[i].base64, pubkey_base64)) &&
                     (!type || (server_opts.authkeys[i].type == type)) &&
                     (!username || !strcmp(server_opts.authkeys[i].username, username))) {
+                if (server_opts.authkeys[i].path) {
+                    --server_opts.authkey_path_count;
+                }
                 free(server_opts.authkeys[i].path);
                 free(server_opts.authkeys[i].base64);
                 free(server_opts.authkeys[i].username);
+                ssh_key_free(server_opts.authkeys[i].key);
 
                 --server_opts.authkey_count;
                 if (i < server_opts.authkey_count) {
@@ -746,16 +985,88 @@ nc_server_ssh_del_authkey(const char *pubkey_path, const char *pubkey_base64, NC
         }
     }
 
+    /* keys may have been moved */
+    nc_server_ssh_authkey_index_rebuild();
+
     /* UNLOCK */
     pthread_mutex_unlock(&server_opts.authkey_lock);
 
     return ret;
 }
 
+struct nc_server_ssh_opts *
+nc_server_ssh_opts_new(void)
+{
+    struct nc_server_ssh_opts *opts;
+
+    opts = calloc(1, sizeof *opts);
+    if (!opts) {
+        ERRMEM;
+        return NULL;
+    }
+
+    pthread_mutex_init(&opts->sbind_lock, NULL);
+    opts->auth_methods = NC_SSH_AUTH_PUBLICKEY | NC_SSH_AUTH_PASSWORD;
+    opts->auth_attempts = 3;
+    opts->auth_timeout = 30;
+
+    return opts;
+}
+
 void
 nc_server_ssh_clear_opts(struct nc_server_ssh_opts *opts)
 {
     nc_server_ssh_del_hostkey(NULL, -1, opts);
+    pthread_mutex_destroy(&opts->sbind_lock);
+}
+
+struct nc_server_ssh_opts *
+nc_server_ssh_opts_dup(const struct nc_server_ssh_opts *opts)
+{
+    struct nc_server_ssh_opts *dup;
+    uint8_t i;
+
+    dup = nc_server_ssh_opts_new();
+    if (!dup) {
+        return NULL;
+    }
+
+    if (opts->hostkey_count) {
+        dup->hostkeys = calloc(opts->hostkey_count, sizeof *dup->hostkeys);
+        if (!dup->hostkeys) {
+            goto error;
+        }
+        for (i = 0; i < opts->hostkey_count; ++i) {
+            if (!(dup->hostkeys[i] = strdup(opts->hostkeys[i]))) {
+                goto error;
+            }
+            ++dup->hostkey_count;
+        }
+    }
+    dup->auth_methods = opts->auth_methods;
+    dup->auth_attempts = opts->auth_attempts;
+    dup->auth_timeout = opts->auth_timeout;
+
+    /* the bind is created on the next accept only if the host keys change */
+    dup->sbind_keep = 1;
+    return dup;
+
+error:
+    ERRMEM;
+    nc_server_ssh_clear_opts(dup);
+    free(dup);
+    return NULL;
+}
+
+void
+nc_server_ssh_opts_take(struct nc_server_ssh_opts *opts, struct nc_server_ssh_opts *cur)
+{
+    if (cur && opts->sbind_keep) {
+        opts->sbind = cur->sbind;
+        opts->sbind_gen = cur->sbind_gen;
+        cur->sbind = NULL;
+    }
+    opts->sbind_keep = 0;
 }
 
 #ifdef HAVE_SHADOW
@@ -1268,57 +1579,111 @@ nc_sshcb_auth_kbdint(struct nc_session *session, ssh_message msg)
     }
 }
 
+/**
+ * @brief Reload the authorized keys from the files that were changed or removed. Authkey lock is expected to be held.
+ */
+static void
+nc_server_ssh_authkeys_reload(void)
+{
+    struct stat st;
+    uint16_t i;
+    int reloaded = 0;
+
+    for (i = 0; server_opts.authkey_path_count && (i < server_opts.authkey_count); ++i) {
+        if (!server_opts.authkeys[i].path) {
+            continue;
+        }
+
+        if (stat(server_opts.authkeys[i].path, &st)) {
+            if (server_opts.authkeys[i].key) {
+                /* the file was removed or can no longer be accessed, the key is revoked */
+                ssh_key_free(server_opts.authkeys[i].key);
+                server_opts.authkeys[i].key = NULL;
+                memset(&server_opts.authkeys[i].file, 0, sizeof server_opts.authkeys[i].file);
+                reloaded = 1;
+            }
+            continue;
+        }
+
+        if (nc_server_ssh_authkey_file_changed(&server_opts.authkeys[i].file, &st)) {
+            if (nc_server_ssh_authkey_import(i)) {
+                /* the file is no longer valid */
+                ssh_key_free(server_opts.authkeys[i].key);
+                server_opts.authkeys[i].key = NULL;
+            }
+            reloaded = 1;
+        }
+    }
+    if (reloaded) {
+        nc_server_ssh_authkey_index_rebuild();
+    }
+}
+
+/**
+ * @brief Find the first configured authorized key matching a key. Authkey lock is expected to be held.
+ *
+ * @param[in] key SSH key to find.
+ * @param[in] hash Hash of the @p key fingerprint.
+ * @return Index of the authorized key, UINT16_MAX if there is none.
+ */
+static uint16_t
+nc_server_ssh_authkey_find(ssh_key key, uint32_t hash)
+{
+    uint32_t i, slot, mask;
+    uint16_t idx, match = UINT16_MAX;
+
+    if (server_opts.authkey_index) {
+        mask = server_opts.authkey_index_size - 1;
+        for (slot = hash & mask; server_opts.authkey_index[slot]; slot = (slot + 1) & mask) {
+            idx = server_opts.authkey_index[slot] - 1;
+            if ((idx < match) && (server_opts.authkeys[idx].hash == hash) &&
+                    !ssh_key_cmp(key, server_opts.authkeys[idx].key, SSH_KEY_CMP_PUBLIC)) {
+                match = idx;
+            }
+        }
+    } else {
+        /* index could not be created */
+        for (i = 0; i < server_opts.authkey_count; ++i) {
+            if (server_opts.authkeys[i].key && (server_opts.authkeys[i].hash == hash) &&
+                    !ssh_key_cmp(key, server_opts.authkeys[i].key, SSH_KEY_CMP_PUBLIC)) {
+                match = i;
+                break;
+            }
+        }
+    }
+
+    return match;
+}
+
 /**
  * @brief Compare SSH key with configured authorized keys and return the username of the matching one, if any.
  *
+ * The files of the authorized keys are checked for changes every time, but only the changed ones are imported again.
+ *
  * @param[in] key Presented SSH key to compare.
  * @return Authorized key username, NULL if no match was found.
  */
 static const char *
 auth_pubkey_compare_key(ssh_key key)
 {
-    uint32_t i;
-    ssh_key pub_key;
+    uint32_t hash;
+    uint16_t match;
     const char *username = NULL;
-    int ret = 0;
+
+    if (nc_server_ssh_key_hash(key, &hash)) {
+        WRN(NULL, "Failed to get the fingerprint of a presented public key.");
+        return NULL;
+    }
 
     /* LOCK */
     pthread_mutex_lock(&server_opts.authkey_lock);
 
-    for (i = 0; i < server_opts.authkey_count; ++i) {
-        switch (server_opts.authkeys[i].type) {
-        case NC_SSH_KEY_UNKNOWN:
-            ret = ssh_pki_import_pubkey_file(server_opts.authkeys[i].path, &pub_key);
-            break;
-        case NC_SSH_KEY_DSA:
-            ret = ssh_pki_import_pubkey_base64(server_opts.authkeys[i].base64, SSH_KEYTYPE_DSS, &pub_key);
-            break;
-        case NC_SSH_KEY_RSA:
-            ret = ssh_pki_import_pubkey_base64(server_opts.authkeys[i].base64, SSH_KEYTYPE_RSA, &pub_key);
-            break;
-        case NC_SSH_KEY_ECDSA:
-            ret = ssh_pki_import_pubkey_base64(server_opts.authkeys[i].base64, SSH_KEYTYPE_ECDSA, &pub_key);
-            break;
-        }
+    /* the files may have been changed meanwhile, including keys being removed */
+    nc_server_ssh_authkeys_reload();
 
-        if (ret == SSH_EOF) {
-            WRN(NULL, "Failed to import a public key of \"%s\" (File access problem).", server_opts.authkeys[i].username);
-            continue;
-        } else if (ret == SSH_ERROR) {
-            WRN(NULL, "Failed to import a public key of \"%s\" (SSH error).", server_opts.authkeys[i].username);
-            continue;
-        }
-
-        if (!ssh_key_cmp(key, pub_key, SSH_KEY_CMP_PUBLIC)) {
-            ssh_key_free(pub_key);
-            break;
-        }
-
-        ssh_key_free(pub_key);
-    }
-
-    if (i < server_opts.authkey_count) {
-        username = server_opts.authkeys[i].username;
+    match = nc_server_ssh_authkey_find(key, hash);
+    if (match < server_opts.authkey_count) {
+        username = server_opts.authkeys[match].username;
     }
 
     /* UNLOCK */
@@ -1421,7 +1786,7 @@ nc_sshcb_channel_subsystem(struct nc_session *session, ssh_channel channel, cons
         session->flags |= NC_SESSION_SSH_SUBSYS_NETCONF;
     } else {
         /* additional channel subsystem request, new session is ready as far as SSH is concerned */
-        new_session = nc_new_session(NC_SERVER, 1);
+        new_session = nc_new_session(NC_SERVER);
         if (!new_session) {
             ERRMEM;
             return -1;
@@ -1437,9 +1802,9 @@ nc_sshcb_channel_subsystem(struct nc_session *session, ssh_channel channel, cons
 
         new_session->status = NC_STATUS_STARTING;
         new_session->ti_type = NC_TI_LIBSSH;
-        new_session->io_lock = session->io_lock;
         new_session->ti.libssh.channel = channel;
         new_session->ti.libssh.session = session->ti.libssh.session;
+        new_session->ti.libssh.ssh_lock = session->ti.libssh.ssh_lock;
         new_session->username = strdup(session->username);
         new_session->host = strdup(session->host);
         new_session->port = session->port;
@@ -1773,11 +2138,9 @@ nc_ssh_bind_add_hostkeys(ssh_bind sbind, char **hostkeys, uint8_t hostkey_count)
     return 0;
 }
 
-static int
-nc_accept_ssh_session_auth(struct nc_session *session, const struct nc_server_ssh_opts *opts)
+static void
+nc_accept_ssh_session_auth_methods(struct nc_session *session, const struct nc_server_ssh_opts *opts)
 {
-    struct timespec ts_timeout;
-    ssh_message msg;
     int libssh_auth_methods = 0;
 
     /* configure accepted auth methods */
@@ -1791,32 +2154,59 @@ nc_accept_ssh_session_auth(struct nc_session *session, const struct nc_server_ss
         libssh_auth_methods |= SSH_AUTH_METHOD_INTERACTIVE;
     }
     ssh_set_auth_methods(session->ti.libssh.session, libssh_auth_methods);
+}
 
-    /* authenticate */
-    if (opts->auth_timeout) {
-        nc_gettimespec_mono_add(&ts_timeout, opts->auth_timeout * 1000);
+/* ret 1 on success, 0 if not yet authenticated, -1 on error, progress set if an SSH message was processed */
+static int
+nc_accept_ssh_session_auth_step(struct nc_session *session, const struct nc_server_ssh_opts *opts, int *progress)
+{
+    ssh_message msg;
+
+    if (!nc_session_is_connected(session)) {
+        ERR(session, "Communication SSH socket unexpectedly closed.");
+        return -1;
     }
-    while (1) {
-        if (!nc_session_is_connected(session)) {
-            ERR(session, "Communication SSH socket unexpectedly closed.");
-            return -1;
-        }
 
-        msg = ssh_message_get(session->ti.libssh.session);
-        if (msg) {
-            if (nc_sshcb_msg(session->ti.libssh.session, msg, (void *) session)) {
-                ssh_message_reply_default(msg);
-            }
-            ssh_message_free(msg);
+    msg = ssh_message_get(session->ti.libssh.session);
+    if (msg) {
+        if (nc_sshcb_msg(session->ti.libssh.session, msg, (void *) session)) {
+            ssh_message_reply_default(msg);
         }
-
-        if (session->flags & NC_SESSION_SSH_AUTHENTICATED) {
-            break;
+        ssh_message_free(msg);
+        if (progress) {
+            *progress = 1;
         }
+    }
 
-        if (session->opts.server.ssh_auth_attempts >= opts->auth_attempts) {
-            ERR(session, "Too many failed authentication attempts of user \"%s\".", session->username);
-            return -1;
+    if (session->flags & NC_SESSION_SSH_AUTHENTICATED) {
+        return 1;
+    }
+
+    if (session->opts.server.ssh_auth_attempts >= opts->auth_attempts) {
+        ERR(session, "Too many failed authentication attempts of user \"%s\".", session->username);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+nc_accept_ssh_session_auth(struct nc_session *session, const struct nc_server_ssh_opts *opts)
+{
+    struct timespec ts_timeout;
+    int r;
+
+    /* configure accepted auth methods */
+    nc_accept_ssh_session_auth_methods(session, opts);
+
+    /* authenticate */
+    if (opts->auth_timeout) {
+        nc_gettimespec_mono_add(&ts_timeout, opts->auth_timeout * 1000);
+    }
+    while (1) {
+        r = nc_accept_ssh_session_auth_step(session, opts, NULL);
+        if (r) {
+            return r;
         }
 
         usleep(NC_TIMEOUT_STEP);
@@ -1826,30 +2216,29 @@ nc_accept_ssh_session_auth(struct nc_session *session, const struct nc_server_ss
         }
     }
 
-    if (!(session->flags & NC_SESSION_SSH_AUTHENTICATED)) {
-        /* timeout */
-        if (session->username) {
-            ERR(session, "User \"%s\" failed to authenticate for too long, disconnecting.", session->username);
-        } else {
-            ERR(session, "User failed to authenticate for too long, disconnecting.");
-        }
-        return 0;
+    /* timeout */
+    if (session->username) {
+        ERR(session, "User \"%s\" failed to authenticate for too long, disconnecting.", session->username);
+    } else {
+        ERR(session, "User failed to authenticate for too long, disconnecting.");
     }
-
-    return 1;
+    return 0;
 }
 
 int
-nc_accept_ssh_session(struct nc_session *session, int sock, int timeout)
+nc_accept_ssh_session_start(struct nc_session *session, int sock)
 {
     ssh_bind sbind = NULL;
     struct nc_server_ssh_opts *opts;
-    int rc = 1, r;
-    struct timespec ts_timeout;
+    int rc = 1;
 
     opts = session->data;
 
     /* other transport-specific data */
+    if (nc_session_ssh_lock_new(session)) {
+        rc = -1;
+        goto cleanup;
+    }
     session->ti_type = NC_TI_LIBSSH;
     session->ti.libssh.session = ssh_new();
     if (!session->ti.libssh.session) {
@@ -1858,28 +2247,127 @@ nc_accept_ssh_session(struct nc_session *session, int sock, int timeout)
         goto cleanup;
     }
 
-    sbind = ssh_bind_new();
-    if (!sbind) {
-        ERR(session, "Failed to create an SSH bind.");
-        rc = -1;
-        goto cleanup;
+    /* SBIND LOCK, the options themselves are not changed while ENDPT READ LOCK or CH CLIENT LOCK is held,
+     * only concurrent accepts on the same endpoint wait for each other */
+    pthread_mutex_lock(&opts->sbind_lock);
+
+    if (opts->sbind && (opts->sbind_gen != ATOMIC_LOAD_RELAXED(sbind_gen))) {
+        /* host key callback changed */
+        ssh_bind_free(opts->sbind);
+        opts->sbind = NULL;
     }
+    if (!opts->sbind) {
+        sbind = ssh_bind_new();
+        if (!sbind) {
+            ERR(session, "Failed to create an SSH bind.");
+            rc = -1;
+            goto unlock;
+        }
 
-    /* configure host keys */
-    if (nc_ssh_bind_add_hostkeys(sbind, opts->hostkeys, opts->hostkey_count)) {
-        rc = -1;
-        goto cleanup;
+        /* configure host keys, they are parsed only once */
+        if (nc_ssh_bind_add_hostkeys(sbind, opts->hostkeys, opts->hostkey_count)) {
+            ssh_bind_free(sbind);
+            rc = -1;
+            goto unlock;
+        }
+        opts->sbind = sbind;
+        opts->sbind_gen = ATOMIC_LOAD_RELAXED(sbind_gen);
     }
+    sbind = opts->sbind;
 
-    /* accept new connection on the bind */
+    /* accept new connection on the bind, host keys are copied into the session */
     if (ssh_bind_accept_fd(sbind, session->ti.libssh.session, sock) == SSH_ERROR) {
         ERR(session, "SSH failed to accept a new connection (%s).", ssh_get_error(sbind));
         rc = -1;
-        goto cleanup;
+        goto unlock;
     }
     sock = -1;
 
-    ssh_set_blocking(session->ti.libssh.session, 0);
+unlock:
+    /* SBIND UNLOCK */
+    pthread_mutex_unlock(&opts->sbind_lock);
+    if (rc == 1) {
+        ssh_set_blocking(session->ti.libssh.session, 0);
+    }
+
+cleanup:
+    if (sock > -1) {
+        close(sock);
+    }
+    return rc;
+}
+
+int
+nc_accept_ssh_session_step(struct nc_session *session, struct nc_handshake *hs)
+{
+    struct nc_server_ssh_opts *opts;
+    int r, progress = 0;
+
+    opts = session->data;
+
+    switch (hs->stage) {
+    case NC_HANDSHAKE_TRANSPORT:
+        r = ssh_handle_key_exchange(session->ti.libssh.session);
+        if (r == SSH_AGAIN) {
+            return 0;
+        } else if (r != SSH_OK) {
+            ERR(session, "SSH key exchange error (%s).", ssh_get_error(session->ti.libssh.session));
+            return -1;
+        }
+
+        /* authenticate next */
+        nc_accept_ssh_session_auth_methods(session, opts);
+        hs->stage = NC_HANDSHAKE_SSH_AUTH;
+        hs->has_timeout = opts->auth_timeout ? 1 : 0;
+        if (opts->auth_timeout) {
+            nc_gettimespec_mono_add(&hs->ts_timeout, opts->auth_timeout * 1000);
+        }
+        hs->pending = 1;
+        return 0;
+    case NC_HANDSHAKE_SSH_AUTH:
+        r = nc_accept_ssh_session_auth_step(session, opts, &progress);
+        if (r < 1) {
+            hs->pending = progress;
+            return r;
+        }
+
+        /* set the message callback after a successful authentication */
+        ssh_set_message_callback(session->ti.libssh.session, nc_sshcb_msg, session);
+        session->flags |= NC_SESSION_SSH_MSG_CB;
+
+        /* open channel and request 'netconf' subsystem next */
+        hs->stage = NC_HANDSHAKE_SSH_CHANNEL;
+        hs->has_timeout = 1;
+        nc_gettimespec_mono_add(&hs->ts_timeout, NC_TRANSPORT_TIMEOUT);
+        hs->pending = 1;
+        return 0;
+    case NC_HANDSHAKE_SSH_CHANNEL:
+        r = nc_accept_ssh_session_open_netconf_channel(session, 0);
+        if (r == 1) {
+            /* all SSH messages were processed */
+            session->flags &= ~NC_SESSION_SSH_NEW_MSG;
+        }
+        return r;
+    case NC_HANDSHAKE_HELLO:
+        break;
+    }
+
+    ERRINT;
+    return -1;
+}
+
+int
+nc_accept_ssh_session(struct nc_session *session, int sock, int timeout)
+{
+    struct nc_server_ssh_opts *opts;
+    int rc, r;
+    struct timespec ts_timeout;
+
+    opts = session->data;
+
+    if (nc_accept_ssh_session_start(session, sock) != 1) {
+        return -1;
+    }
 
     if (timeout > -1) {
         nc_gettimespec_mono_add(&ts_timeout, timeout);
@@ -1893,17 +2381,15 @@ nc_accept_ssh_session(struct nc_session *session, int sock, int timeout)
     }
     if (r == SSH_AGAIN) {
         ERR(session, "SSH key exchange timeout.");
-        rc = 0;
-        goto cleanup;
+        return 0;
     } else if (r != SSH_OK) {
         ERR(session, "SSH key exchange error (%s).", ssh_get_error(session->ti.libssh.session));
-        rc = -1;
-        goto cleanup;
+        return -1;
     }
 
     /* authenticate */
     if ((rc = nc_accept_ssh_session_auth(session, opts)) != 1) {
-        goto cleanup;
+        return rc;
     }
 
     /* set the message callback after a successful authentication */
@@ -1914,18 +2400,13 @@ nc_accept_ssh_session(struct nc_session *session, int sock, int timeout)
 
     /* open channel and request 'netconf' subsystem */
     if ((rc = nc_accept_ssh_session_open_netconf_channel(session, timeout)) != 1) {
-        goto cleanup;
+        return rc;
     }
 
     /* all SSH messages were processed */
     session->flags &= ~NC_SESSION_SSH_NEW_MSG;
 
-cleanup:
-    if (sock > -1) {
-        close(sock);
-    }
-    ssh_bind_free(sbind);
-    return rc;
+    return 1;
 }
 
 API NC_MSG_TYPE
@@ -1943,20 +2424,29 @@ nc_session_accept_ssh_channel(struct nc_session *orig_session, struct nc_session
         return NC_MSG_ERROR;
     }
 
-    if ((orig_session->status == NC_STATUS_RUNNING) && (orig_session->ti_type == NC_TI_LIBSSH) &&
-            orig_session->ti.libssh.next) {
-        for (new_session = orig_session->ti.libssh.next;
-                new_session != orig_session;
-                new_session = new_session->ti.libssh.next) {
-            if ((new_session->status == NC_STATUS_STARTING) && new_session->ti.libssh.channel &&
-                    (new_session->flags & NC_SESSION_SSH_SUBSYS_NETCONF)) {
-                /* we found our session */
-                break;
-            }
+    if ((orig_session->status == NC_STATUS_RUNNING) && (orig_session->ti_type == NC_TI_LIBSSH)) {
+        /* SSH LOCK */
+        if (nc_session_ssh_lock(orig_session, -1, __func__) != 1) {
+            return NC_MSG_ERROR;
         }
-        if (new_session == orig_session) {
-            new_session = NULL;
+
+        if (orig_session->ti.libssh.next) {
+            for (new_session = orig_session->ti.libssh.next;
+                    new_session != orig_session;
+                    new_session = new_session->ti.libssh.next) {
+                if ((new_session->status == NC_STATUS_STARTING) && new_session->ti.libssh.channel &&
+                        (new_session->flags & NC_SESSION_SSH_SUBSYS_NETCONF)) {
+                    /* we found our session */
+                    break;
+                }
+            }
+            if (new_session == orig_session) {
+                new_session = NULL;
+            }
         }
+
+        /* SSH UNLOCK */
+        nc_session_ssh_unlock(orig_session, __func__);
     }
 
     if (!new_session) {
@@ -2007,8 +2497,16 @@ nc_ps_accept_ssh_channel(struct nc_pollsession *ps, struct nc_session **session)
 
     for (i = 0; i < ps->session_count; ++i) {
         cur_session = ps->sessions[i]->session;
-        if ((cur_session->status == NC_STATUS_RUNNING) && (cur_session->ti_type == NC_TI_LIBSSH) &&
-                cur_session->ti.libssh.next) {
+        if ((cur_session->status != NC_STATUS_RUNNING) || (cur_session->ti_type != NC_TI_LIBSSH)) {
+            continue;
+        }
+
+        /* SSH LOCK */
+        if (nc_session_ssh_lock(cur_session, -1, __func__) != 1) {
+            continue;
+        }
+
+        if (cur_session->ti.libssh.next) {
             /* an SSH session with more channels */
             for (new_session = cur_session->ti.libssh.next;
                     new_session != cur_session;
@@ -2019,11 +2517,16 @@ nc_ps_accept_ssh_channel(struct nc_pollsession *ps, struct nc_session **session)
                     break;
                 }
             }
-            if (new_session != cur_session) {
-                break;
+            if (new_session == cur_session) {
+                new_session = NULL;
             }
+        }
 
-            new_session = NULL;
+        /* SSH UNLOCK */
+        nc_session_ssh_unlock(cur_session, __func__);
+
+        if (new_session) {
+            break;
         }
     }
 
@@ -15,6 +15,7 @@
 
 #define _GNU_SOURCE
 
+#include <ctype.h>
 #include <poll.h>
 #include <string.h>
 #include <unistd.h>
@@ -41,6 +42,10 @@ extern struct nc_server_opts server_opts;
 static pthread_key_t verify_key;
 static pthread_once_t verify_once = PTHREAD_ONCE_INIT;
 
+/* cached TLS contexts, increasing the generation invalidates all of them */
+static pthread_mutex_t tls_ctx_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t tls_ctx_gen;
+
 static char *
 asn1time_to_str(const ASN1_TIME *t)
 {
@@ -312,178 +317,249 @@ nc_tls_ctn_get_username_from_cert(X509 *client_cert, NC_TLS_CTN_MAPTYPE map_type
     return 0;
 }
 
-/* return: 0 - OK, 1 - no match, -1 - error */
-static int
-nc_tls_cert_to_name(struct nc_ctn *ctn_first, X509 *cert, NC_TLS_CTN_MAPTYPE *map_type, const char **name)
+/**
+ * @brief Learn the fingerprint algorithm code of a ctn fingerprint.
+ *
+ * @param[in] fingerprint CTN fingerprint.
+ * @return Algorithm code (1 - MD5, 2 - SHA-1, 3 - SHA-224, 4 - SHA-256, 5 - SHA-384, 6 - SHA-512),
+ * 0 for an unknown algorithm.
+ */
+static uint8_t
+nc_tls_ctn_fingerprint_alg(const char *fingerprint)
+{
+    if ((fingerprint[0] != '0') || (fingerprint[1] < '1') || (fingerprint[1] > '6') || (fingerprint[2] != ':')) {
+        return 0;
+    }
+
+    return fingerprint[1] - '0';
+}
+
+/**
+ * @brief Hash a digest string of a fingerprint, case-insensitive.
+ *
+ * @param[in] alg Fingerprint algorithm code.
+ * @param[in] digest Digest string.
+ * @return Digest hash.
+ */
+static uint32_t
+nc_tls_ctn_digest_hash(uint8_t alg, const char *digest)
+{
+    uint32_t hash;
+    char c;
+
+    hash = nc_hash_fnv1a(NC_HASH_FNV1A_INIT, &alg, 1);
+    for ( ; *digest; ++digest) {
+        c = tolower(*digest);
+        hash = nc_hash_fnv1a(hash, &c, 1);
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Create the ctn index from scratch, after the ctn entries were changed.
+ *
+ * @param[in] opts TLS options.
+ */
+static void
+nc_server_tls_ctn_index_rebuild(struct nc_server_tls_opts *opts)
 {
-    char *digest_md5 = NULL, *digest_sha1 = NULL, *digest_sha224 = NULL;
-    char *digest_sha256 = NULL, *digest_sha384 = NULL, *digest_sha512 = NULL;
-    unsigned char *buf = malloc(64);
-    unsigned int buf_len = 64;
-    int ret = 0;
     struct nc_ctn *ctn;
+    uint32_t count = 0, size = 16, slot, mask;
+    uint8_t alg;
 
-    if (!buf) {
-        ERRMEM;
-        return -1;
+    free(opts->ctn_index);
+    opts->ctn_index = NULL;
+    opts->ctn_index_size = 0;
+    opts->ctn_algs = 0;
+
+    for (ctn = opts->ctn; ctn; ctn = ctn->next) {
+        ++count;
+    }
+    if (!count) {
+        return;
     }
 
-    if (!ctn_first || !cert || !map_type || !name) {
-        free(buf);
-        return -1;
+    /* keep the load factor at most 1/2 */
+    while (size < 2 * count) {
+        size <<= 1;
     }
+    opts->ctn_index = calloc(size, sizeof *opts->ctn_index);
+    if (!opts->ctn_index) {
+        /* cert-to-name falls back to a linear search */
+        ERRMEM;
+        return;
+    }
+    opts->ctn_index_size = size;
+    mask = size - 1;
 
-    for (ctn = ctn_first; ctn; ctn = ctn->next) {
-        /* first make sure the entry is valid */
+    for (ctn = opts->ctn; ctn; ctn = ctn->next) {
+        /* only valid entries can match */
         if (!ctn->fingerprint || !ctn->map_type || ((ctn->map_type == NC_TLS_CTN_SPECIFIED) && !ctn->name)) {
             VRB(NULL, "Cert verify CTN: entry with id %u not valid, skipping.", ctn->id);
             continue;
         }
+        alg = nc_tls_ctn_fingerprint_alg(ctn->fingerprint);
+        if (!alg) {
+            WRN(NULL, "Unknown fingerprint algorithm used (%s), skipping.", ctn->fingerprint);
+            continue;
+        }
 
-        /* MD5 */
-        if (!strncmp(ctn->fingerprint, "01", 2)) {
-            if (!digest_md5) {
-                if (X509_digest(cert, EVP_md5(), buf, &buf_len) != 1) {
-                    ERR(NULL, "Calculating MD5 digest failed (%s).", ERR_reason_error_string(ERR_get_error()));
-                    ret = -1;
-                    goto cleanup;
-                }
-                digest_to_str(buf, buf_len, &digest_md5);
-            }
+        slot = nc_tls_ctn_digest_hash(alg, ctn->fingerprint + 3) & mask;
+        while (opts->ctn_index[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        opts->ctn_index[slot] = ctn;
+        opts->ctn_algs |= 1 << alg;
+    }
+}
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_md5)) {
-                /* we got ourselves a winner! */
-                VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
-                *map_type = ctn->map_type;
-                if (ctn->map_type == NC_TLS_CTN_SPECIFIED) {
-                    *name = ctn->name;
-                }
-                break;
-            }
+/**
+ * @brief Update the ctn index after the ctn entries were changed.
+ *
+ * Options staged by a configuration batch are not indexed, the index is built only once on commit.
+ *
+ * @param[in] opts TLS options.
+ */
+static void
+nc_server_tls_ctn_index_update(struct nc_server_tls_opts *opts)
+{
+    if (!nc_server_config_batch_owner()) {
+        nc_server_tls_ctn_index_rebuild(opts);
+    }
+    opts->keep &= ~NC_TLS_KEEP_CTN;
+}
 
-            /* SHA-1 */
-        } else if (!strncmp(ctn->fingerprint, "02", 2)) {
-            if (!digest_sha1) {
-                if (X509_digest(cert, EVP_sha1(), buf, &buf_len) != 1) {
-                    ERR(NULL, "Calculating SHA-1 digest failed (%s).", ERR_reason_error_string(ERR_get_error()));
-                    ret = -1;
-                    goto cleanup;
-                }
-                digest_to_str(buf, buf_len, &digest_sha1);
-            }
+/**
+ * @brief Get a digest string of a certificate.
+ *
+ * @param[in] cert Certificate to hash.
+ * @param[in] alg Fingerprint algorithm code.
+ * @param[out] digest Digest string.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_tls_cert_digest(X509 *cert, uint8_t alg, char **digest)
+{
+    unsigned char buf[EVP_MAX_MD_SIZE];
+    unsigned int buf_len = EVP_MAX_MD_SIZE;
+    const EVP_MD *md = NULL;
+    const char *md_name = NULL;
+
+    switch (alg) {
+    case 1:
+        md = EVP_md5();
+        md_name = "MD5";
+        break;
+    case 2:
+        md = EVP_sha1();
+        md_name = "SHA-1";
+        break;
+    case 3:
+        md = EVP_sha224();
+        md_name = "SHA-224";
+        break;
+    case 4:
+        md = EVP_sha256();
+        md_name = "SHA-256";
+        break;
+    case 5:
+        md = EVP_sha384();
+        md_name = "SHA-384";
+        break;
+    case 6:
+        md = EVP_sha512();
+        md_name = "SHA-512";
+        break;
+    default:
+        ERRINT;
+        return -1;
+    }
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha1)) {
-                /* we got ourselves a winner! */
-                VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
-                *map_type = ctn->map_type;
-                if (ctn->map_type == NC_TLS_CTN_SPECIFIED) {
-                    *name = ctn->name;
-                }
-                break;
-            }
+    if (X509_digest(cert, md, buf, &buf_len) != 1) {
+        ERR(NULL, "Calculating %s digest failed (%s).", md_name, ERR_reason_error_string(ERR_get_error()));
+        return -1;
+    }
+    digest_to_str(buf, buf_len, digest);
+    if (!*digest) {
+        return -1;
+    }
 
-            /* SHA-224 */
-        } else if (!strncmp(ctn->fingerprint, "03", 2)) {
-            if (!digest_sha224) {
-                if (X509_digest(cert, EVP_sha224(), buf, &buf_len) != 1) {
-                    ERR(NULL, "Calculating SHA-224 digest failed (%s).", ERR_reason_error_string(ERR_get_error()));
-                    ret = -1;
-                    goto cleanup;
-                }
-                digest_to_str(buf, buf_len, &digest_sha224);
-            }
+    return 0;
+}
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha224)) {
-                /* we got ourselves a winner! */
-                VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
-                *map_type = ctn->map_type;
-                if (ctn->map_type == NC_TLS_CTN_SPECIFIED) {
-                    *name = ctn->name;
-                }
-                break;
-            }
+/* return: 0 - OK, 1 - no match, -1 - error */
+static int
+nc_tls_cert_to_name(const struct nc_server_tls_opts *opts, X509 *cert, NC_TLS_CTN_MAPTYPE *map_type, const char **name)
+{
+    char *digests[7] = {NULL};
+    int ret = 1;
+    uint8_t alg;
+    uint32_t slot, mask;
+    struct nc_ctn *ctn, *match = NULL;
 
-            /* SHA-256 */
-        } else if (!strncmp(ctn->fingerprint, "04", 2)) {
-            if (!digest_sha256) {
-                if (X509_digest(cert, EVP_sha256(), buf, &buf_len) != 1) {
-                    ERR(NULL, "Calculating SHA-256 digest failed (%s).", ERR_reason_error_string(ERR_get_error()));
-                    ret = -1;
-                    goto cleanup;
-                }
-                digest_to_str(buf, buf_len, &digest_sha256);
-            }
+    if (!opts->ctn || !cert || !map_type || !name) {
+        return -1;
+    }
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha256)) {
-                /* we got ourselves a winner! */
-                VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
-                *map_type = ctn->map_type;
-                if (ctn->map_type == NC_TLS_CTN_SPECIFIED) {
-                    *name = ctn->name;
-                }
-                break;
+    if (opts->ctn_index) {
+        /* hash the certificate only once for every algorithm in use */
+        mask = opts->ctn_index_size - 1;
+        for (alg = 1; alg < 7; ++alg) {
+            if (!(opts->ctn_algs & (1 << alg))) {
+                continue;
             }
-
-            /* SHA-384 */
-        } else if (!strncmp(ctn->fingerprint, "05", 2)) {
-            if (!digest_sha384) {
-                if (X509_digest(cert, EVP_sha384(), buf, &buf_len) != 1) {
-                    ERR(NULL, "Calculating SHA-384 digest failed (%s).", ERR_reason_error_string(ERR_get_error()));
-                    ret = -1;
-                    goto cleanup;
-                }
-                digest_to_str(buf, buf_len, &digest_sha384);
+            if (nc_tls_cert_digest(cert, alg, &digests[alg])) {
+                ret = -1;
+                goto cleanup;
             }
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha384)) {
-                /* we got ourselves a winner! */
-                VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
-                *map_type = ctn->map_type;
-                if (ctn->map_type == NC_TLS_CTN_SPECIFIED) {
-                    *name = ctn->name;
+            /* the entry with the lowest id wins */
+            slot = nc_tls_ctn_digest_hash(alg, digests[alg]) & mask;
+            for ( ; opts->ctn_index[slot]; slot = (slot + 1) & mask) {
+                ctn = opts->ctn_index[slot];
+                if ((!match || (ctn->id < match->id)) && (nc_tls_ctn_fingerprint_alg(ctn->fingerprint) == alg) &&
+                        !strcasecmp(ctn->fingerprint + 3, digests[alg])) {
+                    match = ctn;
                 }
-                break;
             }
-
-            /* SHA-512 */
-        } else if (!strncmp(ctn->fingerprint, "06", 2)) {
-            if (!digest_sha512) {
-                if (X509_digest(cert, EVP_sha512(), buf, &buf_len) != 1) {
-                    ERR(NULL, "Calculating SHA-512 digest failed (%s).", ERR_reason_error_string(ERR_get_error()));
-                    ret = -1;
-                    goto cleanup;
-                }
-                digest_to_str(buf, buf_len, &digest_sha512);
+        }
+    } else {
+        /* index could not be created */
+        for (ctn = opts->ctn; ctn; ctn = ctn->next) {
+            if (!ctn->fingerprint || !ctn->map_type || ((ctn->map_type == NC_TLS_CTN_SPECIFIED) && !ctn->name)) {
+                continue;
+            }
+            alg = nc_tls_ctn_fingerprint_alg(ctn->fingerprint);
+            if (!alg) {
+                continue;
             }
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha512)) {
-                /* we got ourselves a winner! */
-                VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
-                *map_type = ctn->map_type;
-                if (ctn->map_type == NC_TLS_CTN_SPECIFIED) {
-                    *name = ctn->name;
-                }
+            if (!digests[alg] && nc_tls_cert_digest(cert, alg, &digests[alg])) {
+                ret = -1;
+                goto cleanup;
+            }
+            if (!strcasecmp(ctn->fingerprint + 3, digests[alg])) {
+                match = ctn;
                 break;
             }
-
-            /* unknown */
-        } else {
-            WRN(NULL, "Unknown fingerprint algorithm used (%s), skipping.", ctn->fingerprint);
         }
     }
 
-    if (!ctn) {
-        ret = 1;
+    if (match) {
+        /* we got ourselves a winner! */
+        VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
+        *map_type = match->map_type;
+        if (match->map_type == NC_TLS_CTN_SPECIFIED) {
+            *name = match->name;
+        }
+        ret = 0;
     }
 
 cleanup:
-    free(digest_md5);
-    free(digest_sha1);
-    free(digest_sha224);
-    free(digest_sha256);
-    free(digest_sha384);
-    free(digest_sha512);
-    free(buf);
+    for (alg = 1; alg < 7; ++alg) {
+        free(digests[alg]);
+    }
     return ret;
 }
 
@@ -655,7 +731,7 @@ nc_tlsclb_verify(int preverify_ok, X509_STORE_CTX *x509_ctx)
     }
 
     /* cert-to-name */
-    rc = nc_tls_cert_to_name(opts->ctn, cert, &map_type, &username);
+    rc = nc_tls_cert_to_name(opts, cert, &map_type, &username);
 
     if (rc) {
         if (rc == -1) {
@@ -869,7 +945,7 @@ nc_tlsclb_verify(int preverify_ok, X509_STORE_CTX *x509_ctx)
     }
 
     /* cert-to-name */
-    rc = nc_tls_cert_to_name(opts->ctn, cert, &map_type, &username);
+    rc = nc_tls_cert_to_name(opts, cert, &map_type, &username);
 
     if (rc) {
         if (rc == -1) {
@@ -917,9 +993,46 @@ fail:
 
 #endif
 
+/**
+ * @brief Free the cached TLS context of options so that it is created again on the next accept.
+ *
+ * @param[in] opts TLS options.
+ */
+static void
+nc_server_tls_ctx_invalidate(struct nc_server_tls_opts *opts)
+{
+    /* LOCK */
+    pthread_mutex_lock(&tls_ctx_lock);
+
+    /* sessions created from the context hold their own reference */
+    SSL_CTX_free(opts->tls_ctx);
+    opts->tls_ctx = NULL;
+    opts->keep &= ~NC_TLS_KEEP_CTX;
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tls_ctx_lock);
+}
+
+/**
+ * @brief Invalidate all the cached TLS contexts, after a global callback was changed.
+ */
+static void
+nc_server_tls_ctx_invalidate_all(void)
+{
+    /* LOCK */
+    pthread_mutex_lock(&tls_ctx_lock);
+
+    ++tls_ctx_gen;
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tls_ctx_lock);
+}
+
 static int
 nc_server_tls_set_server_cert(const char *name, struct nc_server_tls_opts *opts)
 {
+    nc_server_tls_ctx_invalidate(opts);
+
     if (!name) {
         if (opts->server_cert) {
             free(opts->server_cert);
@@ -954,7 +1067,7 @@ nc_server_tls_endpt_set_server_cert(const char *endpt_name, const char *name)
     }
     ret = nc_server_tls_set_server_cert(name, endpt->opts.tls);
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -993,6 +1106,7 @@ nc_server_tls_set_server_cert_clb(int (*cert_clb)(const char *name, void *user_d
     server_opts.server_cert_clb = cert_clb;
     server_opts.server_cert_data = user_data;
     server_opts.server_cert_data_free = free_user_data;
+    nc_server_tls_ctx_invalidate_all();
 }
 
 API void
@@ -1007,6 +1121,7 @@ nc_server_tls_set_server_cert_chain_clb(int (*cert_chain_clb)(const char *name,
     server_opts.server_cert_chain_clb = cert_chain_clb;
     server_opts.server_cert_chain_data = user_data;
     server_opts.server_cert_chain_data_free = free_user_data;
+    nc_server_tls_ctx_invalidate_all();
 }
 
 static int
@@ -1017,6 +1132,8 @@ nc_server_tls_add_trusted_cert_list(const char *name, struct nc_server_tls_opts
         return -1;
     }
 
+    nc_server_tls_ctx_invalidate(opts);
+
     ++opts->trusted_cert_list_count;
     opts->trusted_cert_lists = nc_realloc(opts->trusted_cert_lists,
             opts->trusted_cert_list_count * sizeof *opts->trusted_cert_lists);
@@ -1047,7 +1164,7 @@ nc_server_tls_endpt_add_trusted_cert_list(const char *endpt_name, const char *na
     }
     ret = nc_server_tls_add_trusted_cert_list(name, endpt->opts.tls);
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -1086,6 +1203,7 @@ nc_server_tls_set_trusted_cert_list_clb(int (*cert_list_clb)(const char *name, v
     server_opts.trusted_cert_list_clb = cert_list_clb;
     server_opts.trusted_cert_list_data = user_data;
     server_opts.trusted_cert_list_data_free = free_user_data;
+    nc_server_tls_ctx_invalidate_all();
 }
 
 static int
@@ -1093,6 +1211,8 @@ nc_server_tls_del_trusted_cert_list(const char *name, struct nc_server_tls_opts
 {
     uint16_t i;
 
+    nc_server_tls_ctx_invalidate(opts);
+
     if (!name) {
         for (i = 0; i < opts->trusted_cert_list_count; ++i) {
             free(opts->trusted_cert_lists[i]);
@@ -1138,7 +1258,7 @@ nc_server_tls_endpt_del_trusted_cert_list(const char *endpt_name, const char *na
     }
     ret = nc_server_tls_del_trusted_cert_list(name, endpt->opts.tls);
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -1172,6 +1292,8 @@ nc_server_tls_set_trusted_ca_paths(const char *ca_file, const char *ca_dir, stru
         return -1;
     }
 
+    nc_server_tls_ctx_invalidate(opts);
+
     if (ca_file) {
         free(opts->trusted_ca_file);
         opts->trusted_ca_file = strdup(ca_file);
@@ -1203,7 +1325,7 @@ nc_server_tls_endpt_set_trusted_ca_paths(const char *endpt_name, const char *ca_
     }
     ret = nc_server_tls_set_trusted_ca_paths(ca_file, ca_dir, endpt->opts.tls);
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -1230,50 +1352,85 @@ nc_server_tls_ch_client_endpt_set_trusted_ca_paths(const char *client_name, cons
     return ret;
 }
 
+/**
+ * @brief Load CRL locations into a store.
+ *
+ * @param[in] store Store to load into.
+ * @param[in] crl_file CRL file, if any.
+ * @param[in] crl_dir CRL directory, if any.
+ * @return 0 on success, -1 on error.
+ */
 static int
-nc_server_tls_set_crl_paths(const char *crl_file, const char *crl_dir, struct nc_server_tls_opts *opts)
+nc_server_tls_crl_load(X509_STORE *store, const char *crl_file, const char *crl_dir)
 {
     X509_LOOKUP *lookup;
 
-    if (!crl_file && !crl_dir) {
-        ERRARG("crl_file and crl_dir");
-        return -1;
-    }
-
-    if (!opts->crl_store) {
-        opts->crl_store = X509_STORE_new();
-    }
-
     if (crl_file) {
-        lookup = X509_STORE_add_lookup(opts->crl_store, X509_LOOKUP_file());
+        lookup = X509_STORE_add_lookup(store, X509_LOOKUP_file());
         if (!lookup) {
             ERR(NULL, "Failed to add a lookup method.");
-            goto fail;
+            return -1;
         }
 
         if (X509_LOOKUP_load_file(lookup, crl_file, X509_FILETYPE_PEM) != 1) {
             ERR(NULL, "Failed to add a revocation lookup file (%s).", ERR_reason_error_string(ERR_get_error()));
-            goto fail;
+            return -1;
         }
     }
 
     if (crl_dir) {
-        lookup = X509_STORE_add_lookup(opts->crl_store, X509_LOOKUP_hash_dir());
+        lookup = X509_STORE_add_lookup(store, X509_LOOKUP_hash_dir());
         if (!lookup) {
             ERR(NULL, "Failed to add a lookup method.");
-            goto fail;
+            return -1;
         }
 
         if (X509_LOOKUP_add_dir(lookup, crl_dir, X509_FILETYPE_PEM) != 1) {
             ERR(NULL, "Failed to add a revocation lookup directory (%s).", ERR_reason_error_string(ERR_get_error()));
-            goto fail;
+            return -1;
         }
     }
 
     return 0;
+}
 
-fail:
-    return -1;
+static int
+nc_server_tls_set_crl_paths(const char *crl_file, const char *crl_dir, struct nc_server_tls_opts *opts)
+{
+    void *mem;
+
+    if (!crl_file && !crl_dir) {
+        ERRARG("crl_file and crl_dir");
+        return -1;
+    }
+
+    if (!nc_server_config_batch_owner()) {
+        /* staged options load the store on commit */
+        if (!opts->crl_store) {
+            opts->crl_store = X509_STORE_new();
+            if (!opts->crl_store) {
+                ERRMEM;
+                return -1;
+            }
+        }
+        if (nc_server_tls_crl_load(opts->crl_store, crl_file, crl_dir)) {
+            return -1;
+        }
+    }
+    opts->keep &= ~NC_TLS_KEEP_CRL;
+
+    /* remember the locations so that the options can be copied */
+    mem = realloc(opts->crl_paths, (opts->crl_path_count + 1) * sizeof *opts->crl_paths);
+    if (!mem) {
+        ERRMEM;
+        return -1;
+    }
+    opts->crl_paths = mem;
+    opts->crl_paths[opts->crl_path_count].file = crl_file ? strdup(crl_file) : NULL;
+    opts->crl_paths[opts->crl_path_count].dir = crl_dir ? strdup(crl_dir) : NULL;
+    ++opts->crl_path_count;
+
+    return 0;
 }
 
 API int
@@ -1294,7 +1451,7 @@ nc_server_tls_endpt_set_crl_paths(const char *endpt_name, const char *crl_file,
     }
     ret = nc_server_tls_set_crl_paths(crl_file, crl_dir, endpt->opts.tls);
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -1324,6 +1481,17 @@ nc_server_tls_ch_client_set_crl_paths(const char *client_name, const char *endpt
 static void
 nc_server_tls_clear_crls(struct nc_server_tls_opts *opts)
 {
+    uint16_t i;
+
+    for (i = 0; i < opts->crl_path_count; ++i) {
+        free(opts->crl_paths[i].file);
+        free(opts->crl_paths[i].dir);
+    }
+    free(opts->crl_paths);
+    opts->crl_paths = NULL;
+    opts->crl_path_count = 0;
+    opts->keep &= ~NC_TLS_KEEP_CRL;
+
     if (!opts->crl_store) {
         return;
     }
@@ -1349,7 +1517,7 @@ nc_server_tls_endpt_clear_crls(const char *endpt_name)
     }
     nc_server_tls_clear_crls(endpt->opts.tls);
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 }
 
 API void
@@ -1375,12 +1543,22 @@ nc_server_tls_add_ctn(uint32_t id, const char *fingerprint, NC_TLS_CTN_MAPTYPE m
         struct nc_server_tls_opts *opts)
 {
     struct nc_ctn *ctn, *new;
+    char *fp_dup = NULL, *name_dup = NULL;
+
+    /* copy the strings first, the indexed entry must always have them */
+    if ((fingerprint && !(fp_dup = strdup(fingerprint))) || (name && !(name_dup = strdup(name)))) {
+        ERRMEM;
+        free(fp_dup);
+        return -1;
+    }
 
     if (!opts->ctn) {
         /* the first item */
         opts->ctn = new = calloc(1, sizeof *new);
         if (!new) {
             ERRMEM;
+            free(fp_dup);
+            free(name_dup);
             return -1;
         }
     } else if (opts->ctn->id > id) {
@@ -1388,6 +1566,8 @@ nc_server_tls_add_ctn(uint32_t id, const char *fingerprint, NC_TLS_CTN_MAPTYPE m
         new = calloc(1, sizeof *new);
         if (!new) {
             ERRMEM;
+            free(fp_dup);
+            free(name_dup);
             return -1;
         }
         new->next = opts->ctn;
@@ -1402,6 +1582,8 @@ nc_server_tls_add_ctn(uint32_t id, const char *fingerprint, NC_TLS_CTN_MAPTYPE m
             new = calloc(1, sizeof *new);
             if (!new) {
                 ERRMEM;
+                free(fp_dup);
+                free(name_dup);
                 return -1;
             }
             new->next = ctn->next;
@@ -1412,16 +1594,17 @@ nc_server_tls_add_ctn(uint32_t id, const char *fingerprint, NC_TLS_CTN_MAPTYPE m
     new->id = id;
     if (fingerprint) {
         free(new->fingerprint);
-        new->fingerprint = strdup(fingerprint);
+        new->fingerprint = fp_dup;
     }
     if (map_type) {
         new->map_type = map_type;
     }
     if (name) {
         free(new->name);
-        new->name = strdup(name);
+        new->name = name_dup;
     }
 
+    nc_server_tls_ctn_index_update(opts);
     return 0;
 }
 
@@ -1444,7 +1627,7 @@ nc_server_tls_endpt_add_ctn(const char *endpt_name, uint32_t id, const char *fin
     }
     ret = nc_server_tls_add_ctn(id, fingerprint, map_type, name, endpt->opts.tls);
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -1520,6 +1703,7 @@ nc_server_tls_del_ctn(int64_t id, const char *fingerprint, NC_TLS_CTN_MAPTYPE ma
         }
     }
 
+    nc_server_tls_ctn_index_update(opts);
     return ret;
 }
 
@@ -1542,7 +1726,7 @@ nc_server_tls_endpt_del_ctn(const char *endpt_name, int64_t id, const char *fing
     }
     ret = nc_server_tls_del_ctn(id, fingerprint, map_type, name, endpt->opts.tls);
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -1630,7 +1814,7 @@ nc_server_tls_endpt_get_ctn(const char *endpt_name, uint32_t *id, char **fingerp
     }
     ret = nc_server_tls_get_ctn(id, fingerprint, map_type, name, endpt->opts.tls);
     /* UNLOCK */
-    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    nc_server_endpt_unlock();
 
     return ret;
 }
@@ -1657,6 +1841,61 @@ nc_server_tls_ch_client_endpt_get_ctn(const char *client_name, const char *endpt
     return ret;
 }
 
+static void
+nc_server_tls_set_ktls(int enable, struct nc_server_tls_opts *opts)
+{
+#ifndef SSL_OP_ENABLE_KTLS
+    if (enable) {
+        WRN(NULL, "Kernel TLS offload not supported by OpenSSL %s, ignoring.", OPENSSL_VERSION_TEXT);
+    }
+#endif
+
+    /* used by the next accepted sessions, the context is not affected */
+    opts->ktls = enable ? 1 : 0;
+}
+
+API int
+nc_server_tls_endpt_set_ktls(const char *endpt_name, int enable)
+{
+    struct nc_endpt *endpt;
+
+    if (!endpt_name) {
+        ERRARG("endpt_name");
+        return -1;
+    }
+
+    /* LOCK */
+    endpt = nc_server_endpt_lock_get(endpt_name, NC_TI_OPENSSL, NULL);
+    if (!endpt) {
+        return -1;
+    }
+    nc_server_tls_set_ktls(enable, endpt->opts.tls);
+    /* UNLOCK */
+    nc_server_endpt_unlock();
+
+    return 0;
+}
+
+API int
+nc_server_tls_ch_client_endpt_set_ktls(const char *client_name, const char *endpt_name, int enable)
+{
+    struct nc_ch_client *client;
+    struct nc_ch_endpt *endpt;
+
+    /* LOCK */
+    endpt = nc_server_ch_client_lock(client_name, endpt_name, NC_TI_OPENSSL, &client);
+    if (!endpt) {
+        return -1;
+    }
+
+    nc_server_tls_set_ktls(enable, endpt->opts.tls);
+
+    /* UNLOCK */
+    nc_server_ch_client_unlock(client);
+
+    return 0;
+}
+
 API const X509 *
 nc_session_get_client_cert(const struct nc_session *session)
 {
@@ -1683,6 +1922,143 @@ nc_server_tls_clear_opts(struct nc_server_tls_opts *opts)
     free(opts->trusted_ca_dir);
     nc_server_tls_clear_crls(opts);
     nc_server_tls_del_ctn(-1, NULL, 0, NULL, opts);
+    nc_server_tls_ctx_invalidate(opts);
+}
+
+struct nc_server_tls_opts *
+nc_server_tls_opts_dup(const struct nc_server_tls_opts *opts)
+{
+    struct nc_server_tls_opts *dup;
+    struct nc_ctn *ctn, **next;
+    uint16_t i;
+
+    dup = calloc(1, sizeof *dup);
+    if (!dup) {
+        ERRMEM;
+        return NULL;
+    }
+
+    if (opts->server_cert && !(dup->server_cert = strdup(opts->server_cert))) {
+        goto error;
+    }
+    if (opts->trusted_cert_list_count) {
+        dup->trusted_cert_lists = calloc(opts->trusted_cert_list_count, sizeof *dup->trusted_cert_lists);
+        if (!dup->trusted_cert_lists) {
+            goto error;
+        }
+        for (i = 0; i < opts->trusted_cert_list_count; ++i) {
+            if (!(dup->trusted_cert_lists[i] = strdup(opts->trusted_cert_lists[i]))) {
+                goto error;
+            }
+            ++dup->trusted_cert_list_count;
+        }
+    }
+    if (opts->trusted_ca_file && !(dup->trusted_ca_file = strdup(opts->trusted_ca_file))) {
+        goto error;
+    }
+    if (opts->trusted_ca_dir && !(dup->trusted_ca_dir = strdup(opts->trusted_ca_dir))) {
+        goto error;
+    }
+
+    if (opts->crl_path_count) {
+        dup->crl_paths = calloc(opts->crl_path_count, sizeof *dup->crl_paths);
+        if (!dup->crl_paths) {
+            goto error;
+        }
+        for (i = 0; i < opts->crl_path_count; ++i) {
+            ++dup->crl_path_count;
+            if (opts->crl_paths[i].file && !(dup->crl_paths[i].file = strdup(opts->crl_paths[i].file))) {
+                goto error;
+            }
+            if (opts->crl_paths[i].dir && !(dup->crl_paths[i].dir = strdup(opts->crl_paths[i].dir))) {
+                goto error;
+            }
+        }
+    }
+
+    /* the copy is not indexed */
+    next = &dup->ctn;
+    for (ctn = opts->ctn; ctn; ctn = ctn->next) {
+        *next = calloc(1, sizeof **next);
+        if (!*next) {
+            goto error;
+        }
+        (*next)->id = ctn->id;
+        (*next)->map_type = ctn->map_type;
+        if ((ctn->fingerprint && !((*next)->fingerprint = strdup(ctn->fingerprint))) ||
+                (ctn->name && !((*next)->name = strdup(ctn->name)))) {
+            goto error;
+        }
+        next = &(*next)->next;
+    }
+
+    dup->ktls = opts->ktls;
+
+    /* the cached data are created on commit only if the copy changes */
+    dup->keep = NC_TLS_KEEP_CTX | NC_TLS_KEEP_CRL | NC_TLS_KEEP_CTN;
+    return dup;
+
+error:
+    ERRMEM;
+    nc_server_tls_clear_opts(dup);
+    free(dup);
+    return NULL;
+}
+
+int
+nc_server_tls_opts_load(struct nc_server_tls_opts *opts)
+{
+    uint16_t i;
+
+    if ((opts->keep & NC_TLS_KEEP_CRL) || !opts->crl_path_count) {
+        return 0;
+    }
+
+    opts->crl_store = X509_STORE_new();
+    if (!opts->crl_store) {
+        ERRMEM;
+        return -1;
+    }
+    for (i = 0; i < opts->crl_path_count; ++i) {
+        if (nc_server_tls_crl_load(opts->crl_store, opts->crl_paths[i].file, opts->crl_paths[i].dir)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void
+nc_server_tls_opts_take(struct nc_server_tls_opts *opts, struct nc_server_tls_opts *cur)
+{
+    struct nc_ctn *ctn;
+
+    if (cur && (opts->keep & NC_TLS_KEEP_CTX)) {
+        opts->tls_ctx = cur->tls_ctx;
+        opts->tls_ctx_gen = cur->tls_ctx_gen;
+        cur->tls_ctx = NULL;
+    }
+    if (cur && (opts->keep & NC_TLS_KEEP_CRL)) {
+        opts->crl_store = cur->crl_store;
+        cur->crl_store = NULL;
+    }
+    if (cur && (opts->keep & NC_TLS_KEEP_CTN)) {
+        /* the same entries, swap them for the indexed ones */
+        ctn = opts->ctn;
+        opts->ctn = cur->ctn;
+        cur->ctn = ctn;
+
+        opts->ctn_index = cur->ctn_index;
+        opts->ctn_index_size = cur->ctn_index_size;
+        opts->ctn_algs = cur->ctn_algs;
+        cur->ctn_index = NULL;
+        cur->ctn_index_size = 0;
+        cur->ctn_algs = 0;
+    } else {
+        nc_server_tls_ctn_index_rebuild(opts);
+    }
+
+    opts->keep = 0;
 }
 
 static void
@@ -1897,6 +2273,7 @@ nc_server_tls_accept_check(int accept_ret, struct nc_session *session)
     case X509_V_OK:
         if (accept_ret == 1) {
             VRB(session, "Client certificate verified.");
+            nc_tls_ktls_print(session, session->ti.tls);
         }
         break;
     default:
@@ -1920,17 +2297,18 @@ nc_server_tls_accept_check(int accept_ret, struct nc_session *session)
     return accept_ret;
 }
 
-int
-nc_accept_tls_session(struct nc_session *session, int sock, int timeout)
+/**
+ * @brief Create a new server TLS context for options.
+ *
+ * @param[in] opts TLS options.
+ * @return Created context, NULL on error.
+ */
+static SSL_CTX *
+nc_server_tls_ctx_new(struct nc_server_tls_opts *opts)
 {
     X509_STORE *cert_store;
     SSL_CTX *tls_ctx;
     X509_LOOKUP *lookup;
-    struct nc_server_tls_opts *opts;
-    int ret;
-    struct timespec ts_timeout;
-
-    opts = session->data;
 
     /* SSL_CTX */
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L // >= 1.1.0
@@ -1939,7 +2317,7 @@ nc_accept_tls_session(struct nc_session *session, int sock, int timeout)
     tls_ctx = SSL_CTX_new(TLSv1_2_server_method());
 #endif
     if (!tls_ctx) {
-        ERR(session, "Failed to create TLS context.");
+        ERR(NULL, "Failed to create TLS context.");
         goto error;
     }
     SSL_CTX_set_verify(tls_ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, nc_tlsclb_verify);
@@ -1947,6 +2325,11 @@ nc_accept_tls_session(struct nc_session *session, int sock, int timeout)
         goto error;
     }
 
+    /* the context is shared by all the sessions, but the cert-to-name resolution is performed in the verify
+     * callback, which is skipped for resumed sessions, so always perform a full handshake */
+    SSL_CTX_set_session_cache_mode(tls_ctx, SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_options(tls_ctx, SSL_OP_NO_TICKET);
+
     /* X509_STORE, managed (freed) with the context */
     cert_store = X509_STORE_new();
     SSL_CTX_set_cert_store(tls_ctx, cert_store);
@@ -1958,12 +2341,12 @@ nc_accept_tls_session(struct nc_session *session, int sock, int timeout)
     if (opts->trusted_ca_file) {
         lookup = X509_STORE_add_lookup(cert_store, X509_LOOKUP_file());
         if (!lookup) {
-            ERR(session, "Failed to add a lookup method.");
+            ERR(NULL, "Failed to add a lookup method.");
             goto error;
         }
 
         if (X509_LOOKUP_load_file(lookup, opts->trusted_ca_file, X509_FILETYPE_PEM) != 1) {
-            ERR(session, "Failed to add a trusted cert file (%s).", ERR_reason_error_string(ERR_get_error()));
+            ERR(NULL, "Failed to add a trusted cert file (%s).", ERR_reason_error_string(ERR_get_error()));
             goto error;
         }
     }
@@ -1971,31 +2354,98 @@ nc_accept_tls_session(struct nc_session *session, int sock, int timeout)
     if (opts->trusted_ca_dir) {
         lookup = X509_STORE_add_lookup(cert_store, X509_LOOKUP_hash_dir());
         if (!lookup) {
-            ERR(session, "Failed to add a lookup method.");
+            ERR(NULL, "Failed to add a lookup method.");
             goto error;
         }
 
         if (X509_LOOKUP_add_dir(lookup, opts->trusted_ca_dir, X509_FILETYPE_PEM) != 1) {
-            ERR(session, "Failed to add a trusted cert directory (%s).", ERR_reason_error_string(ERR_get_error()));
+            ERR(NULL, "Failed to add a trusted cert directory (%s).", ERR_reason_error_string(ERR_get_error()));
             goto error;
         }
     }
 
-    session->ti_type = NC_TI_OPENSSL;
-    session->ti.tls = SSL_new(tls_ctx);
+    return tls_ctx;
 
-    /* context can be freed already, trusted certs must be freed manually */
+error:
     SSL_CTX_free(tls_ctx);
-    tls_ctx = NULL;
+    return NULL;
+}
+
+int
+nc_accept_tls_session_start(struct nc_session *session, int sock)
+{
+    struct nc_server_tls_opts *opts;
+
+    opts = session->data;
+
+    /* LOCK */
+    pthread_mutex_lock(&tls_ctx_lock);
+
+    if (opts->tls_ctx && (opts->tls_ctx_gen != tls_ctx_gen)) {
+        /* global callbacks changed */
+        SSL_CTX_free(opts->tls_ctx);
+        opts->tls_ctx = NULL;
+    }
+    if (!opts->tls_ctx) {
+        opts->tls_ctx = nc_server_tls_ctx_new(opts);
+        opts->tls_ctx_gen = tls_ctx_gen;
+    }
+    if (opts->tls_ctx) {
+        /* the session holds its own reference to the context */
+        session->ti_type = NC_TI_OPENSSL;
+        session->ti.tls = SSL_new(opts->tls_ctx);
+        if (session->ti.tls && opts->ktls) {
+            nc_tls_ktls_enable(session->ti.tls);
+        }
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tls_ctx_lock);
 
     if (!session->ti.tls) {
         ERR(session, "Failed to create TLS structure from context.");
-        goto error;
+        close(sock);
+        return -1;
     }
 
     SSL_set_fd(session->ti.tls, sock);
-    sock = -1;
-    SSL_set_mode(session->ti.tls, SSL_MODE_AUTO_RETRY);
+    /* the output queue writes whatever the socket accepts and retries from where its data were moved */
+    SSL_set_mode(session->ti.tls, SSL_MODE_AUTO_RETRY | SSL_MODE_ENABLE_PARTIAL_WRITE |
+            SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    return 1;
+}
+
+int
+nc_accept_tls_session_step(struct nc_session *session)
+{
+    int ret;
+
+    /* store session on per-thread basis, every step may be performed by a different thread */
+    pthread_once(&verify_once, nc_tls_make_verify_key);
+    pthread_setspecific(verify_key, session);
+
+    ret = SSL_accept(session->ti.tls);
+    if ((ret == -1) && ((SSL_get_error(session->ti.tls, ret) == SSL_ERROR_WANT_READ) ||
+            (SSL_get_error(session->ti.tls, ret) == SSL_ERROR_WANT_WRITE))) {
+        return 0;
+    }
+    if (nc_server_tls_accept_check(ret, session) != 1) {
+        return -1;
+    }
+
+    return 1;
+}
+
+int
+nc_accept_tls_session(struct nc_session *session, int sock, int timeout)
+{
+    int ret;
+    struct timespec ts_timeout;
+
+    if (nc_accept_tls_session_start(session, sock) != 1) {
+        return -1;
+    }
 
     /* store session on per-thread basis */
     pthread_once(&verify_once, nc_tls_make_verify_key);
@@ -2016,11 +2466,4 @@ nc_accept_tls_session(struct nc_session *session, int sock, int timeout)
     }
 
     return 1;
-
-error:
-    if (sock > -1) {
-        close(sock);
-    }
-    SSL_CTX_free(tls_ctx);
-    return -1;
 }
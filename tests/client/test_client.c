@@ -1,14 +1,22 @@
+#include <arpa/inet.h>
 #include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
 #include <setjmp.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <cmocka.h>
 #include <libyang/libyang.h>
 #include <log.h>
 #include <session_client.h>
+#include <session_p.h>
 #include "tests/config.h"
 
 static int
@@ -113,12 +121,244 @@ test_nc_client_setting_schema_callback(void **state)
     nc_client_destroy();
 }
 
+static const char *test_cpblts[] = {
+    "urn:ietf:params:netconf:base:1.0",
+    "urn:ietf:params:netconf:base:1.1",
+    "urn:ietf:params:netconf:capability:with-defaults:1.0?basic-mode=explicit",
+    "urn:ietf:params:xml:ns:yang:ietf-netconf-monitoring?module=ietf-netconf-monitoring&revision=2010-10-04",
+    "urn:ietf:params:xml:ns:yang:ietf-netconf-monitoring?module=other",
+    NULL
+};
+
+/**
+ * @brief Create a received capability list.
+ *
+ * @param[in] skip Number of the first capabilities to skip.
+ */
+static char **
+test_cpblts_list(int skip)
+{
+    char **list;
+    int i;
+
+    list = calloc(sizeof test_cpblts / sizeof *test_cpblts, sizeof *list);
+    assert_non_null(list);
+    for (i = 0; test_cpblts[i + skip]; ++i) {
+        list[i] = strdup(test_cpblts[i + skip]);
+        assert_non_null(list[i]);
+    }
+
+    return list;
+}
+
+static void
+test_nc_client_cpblts_shared(void **state)
+{
+    struct nc_client_cpblts *set1, *set2, *set3;
+
+    (void)state;
+
+    /* the same capabilities are shared */
+    set1 = nc_client_cpblts_get(test_cpblts_list(0));
+    assert_non_null(set1);
+    set2 = nc_client_cpblts_get(test_cpblts_list(0));
+    assert_ptr_equal(set1, set2);
+    assert_int_equal(set1->refcount, 2);
+    assert_int_equal(set1->count, 5);
+
+    /* different ones are not */
+    set3 = nc_client_cpblts_get(test_cpblts_list(1));
+    assert_non_null(set3);
+    assert_ptr_not_equal(set1, set3);
+    assert_int_equal(set3->refcount, 1);
+    assert_int_equal(set3->count, 4);
+
+    /* freed with the last reference */
+    nc_client_cpblts_release(set2);
+    assert_int_equal(set1->refcount, 1);
+    assert_string_equal(set1->cpblts[0], test_cpblts[0]);
+    nc_client_cpblts_release(set1);
+    nc_client_cpblts_release(set3);
+}
+
+static void
+test_cpblt_lookups(const struct nc_session *session, char **cpblts)
+{
+    /* whole capabilities */
+    assert_ptr_equal(nc_session_cpblt(session, test_cpblts[1]), cpblts[1]);
+    assert_ptr_equal(nc_session_cpblt(session, test_cpblts[2]), cpblts[2]);
+
+    /* prefixes, the first capability is returned */
+    assert_ptr_equal(nc_session_cpblt(session, "urn:ietf:params:netconf:base"), cpblts[0]);
+    assert_ptr_equal(nc_session_cpblt(session, "urn:ietf:params:netconf:capability:with-defaults:1.0"), cpblts[2]);
+    assert_ptr_equal(nc_session_cpblt(session, "urn:ietf:params:xml:ns:yang:ietf-netconf-monitoring?module=ietf"),
+            cpblts[3]);
+
+    /* the same URI with other parameters */
+    assert_ptr_equal(nc_session_cpblt(session, test_cpblts[4]), cpblts[4]);
+    assert_null(nc_session_cpblt(session, "urn:ietf:params:xml:ns:yang:ietf-netconf-monitoring?module=missing"));
+    assert_null(nc_session_cpblt(session, "urn:ietf:params:netconf:capability:with-defaults:1.0?basic-mode=trim"));
+
+    /* unknown */
+    assert_null(nc_session_cpblt(session, "urn:ietf:params:netconf:capability:startup:1.0"));
+    assert_null(nc_session_cpblt(session, "urn:ietf:params:netconf:capability:startup:1.0?x=y"));
+}
+
+static void
+test_nc_session_cpblt(void **state)
+{
+    struct nc_session session = {0};
+    struct nc_client_cpblts *set;
+    uint32_t *idx;
+
+    (void)state;
+
+    session.side = NC_CLIENT;
+
+    /* no capabilities */
+    assert_null(nc_session_cpblt(&session, test_cpblts[0]));
+
+    set = nc_client_cpblts_get(test_cpblts_list(0));
+    assert_non_null(set);
+    assert_non_null(set->idx);
+    session.opts.client.cpblts = set;
+    test_cpblt_lookups(&session, set->cpblts);
+
+    /* the same results without the hash set */
+    idx = set->idx;
+    set->idx = NULL;
+    test_cpblt_lookups(&session, set->cpblts);
+    set->idx = idx;
+
+    nc_client_cpblts_release(set);
+}
+
+static void
+test_nc_session_size(void **state)
+{
+    (void)state;
+
+#if defined (__x86_64__) && defined (__GLIBC__)
+    /* the memory budget of an idle session documented with the structure */
+    assert_true(sizeof(struct nc_session) <= 512);
+#endif
+}
+
+#ifdef NC_ENABLED_SSH
+
+static pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+test_batch_clb(const struct nc_connect_target *target, struct nc_session *session, void *user_data)
+{
+    int *reported = user_data;
+
+    /* nothing listens on the ports or it never accepts */
+    assert_null(session);
+
+    pthread_mutex_lock(&batch_lock);
+    ++reported[(intptr_t)target->user_data];
+    pthread_mutex_unlock(&batch_lock);
+}
+
+static void
+test_nc_connect_batch_refused(void **state)
+{
+    struct nc_connect_target targets[5];
+    int reported[5] = {0}, i;
+
+    (void)state;
+
+    nc_client_init();
+
+    for (i = 0; i < 5; ++i) {
+        targets[i].ti = NC_TI_LIBSSH;
+        targets[i].host = "127.0.0.1";
+        targets[i].port = 1 + i;
+        targets[i].user_data = (void *)(intptr_t)i;
+    }
+
+    assert_int_equal(nc_connect_batch(targets, 5, NULL, 0, 1, 1000, test_batch_clb, reported), -1);
+
+    /* fewer slots than targets */
+    assert_int_equal(nc_connect_batch(targets, 5, NULL, 2, 2, 1000, test_batch_clb, reported), 0);
+    for (i = 0; i < 5; ++i) {
+        assert_int_equal(reported[i], 1);
+    }
+
+    nc_client_destroy();
+}
+
+static void
+test_nc_connect_batch_timeout(void **state)
+{
+    struct nc_connect_target targets[2];
+    struct sockaddr_in addr = {0};
+    socklen_t len = sizeof addr;
+    struct timespec ts_start, ts_end;
+    int reported[2] = {0}, lsock, sock[4], i;
+    long msec;
+
+    (void)state;
+
+    nc_client_init();
+
+    /* a server with a full accept queue, further SYNs are dropped and connects hang */
+    lsock = socket(AF_INET, SOCK_STREAM, 0);
+    assert_int_not_equal(lsock, -1);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert_int_equal(bind(lsock, (struct sockaddr *)&addr, sizeof addr), 0);
+    assert_int_equal(listen(lsock, 0), 0);
+    assert_int_equal(getsockname(lsock, (struct sockaddr *)&addr, &len), 0);
+    for (i = 0; i < 4; ++i) {
+        sock[i] = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        assert_int_not_equal(sock[i], -1);
+        connect(sock[i], (struct sockaddr *)&addr, sizeof addr);
+    }
+    usleep(100000);
+
+    for (i = 0; i < 2; ++i) {
+        targets[i].ti = NC_TI_LIBSSH;
+        targets[i].host = "127.0.0.1";
+        targets[i].port = ntohs(addr.sin_port);
+        targets[i].user_data = (void *)(intptr_t)i;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    assert_int_equal(nc_connect_batch(targets, 2, NULL, 2, 1, 300, test_batch_clb, reported), 0);
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+
+    /* both connects timed out at once, not one after the other or after the kernel gave up */
+    msec = (ts_end.tv_sec - ts_start.tv_sec) * 1000 + (ts_end.tv_nsec - ts_start.tv_nsec) / 1000000;
+    assert_true(msec >= 250);
+    assert_true(msec < 2000);
+    for (i = 0; i < 2; ++i) {
+        assert_int_equal(reported[i], 1);
+    }
+
+    for (i = 0; i < 4; ++i) {
+        close(sock[i]);
+    }
+    close(lsock);
+    nc_client_destroy();
+}
+
+#endif /* NC_ENABLED_SSH */
+
 int
 main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_nc_client_setting_schema_searchpath, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_nc_client_setting_schema_callback, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_nc_client_cpblts_shared, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_nc_session_cpblt, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_nc_session_size, setup_f, teardown_f),
+#ifdef NC_ENABLED_SSH
+        cmocka_unit_test_setup_teardown(test_nc_connect_batch_refused, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_nc_connect_batch_timeout, setup_f, teardown_f),
+#endif
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -190,20 +190,23 @@ __wrap_ssh_userauth_publickey(ssh_session session, const char *username, const s
 }
 
 MOCK int
-__wrap_nc_sock_listen_inet(const char *address, uint16_t port, struct nc_keepalives *ka)
+__wrap_nc_sock_listen_inet(const char *address, uint16_t port, struct nc_keepalives *ka, int reuseport)
 {
     (void)address;
     (void)port;
     (void)ka;
+    (void)reuseport;
 
     return (int)mock();
 }
 
 MOCK int
-__wrap_nc_sock_accept_binds(struct nc_bind *binds, uint16_t bind_count, int timeout, char **host, uint16_t *port, uint16_t *idx)
+__wrap_nc_sock_accept_binds(struct nc_bind *binds, uint16_t bind_count, struct nc_bind_pollset *pollset, int timeout,
+        char **host, uint16_t *port, uint16_t *idx)
 {
     (void)binds;
     (void)bind_count;
+    (void)pollset;
     (void)timeout;
     (void)host;
     (void)port;
@@ -742,7 +745,7 @@ test_nc_accept_callhome(void **state)
     assert_int_equal(ret, -1);
 
     /* create session structure to fake a successful server call home connection */
-    session = nc_new_session(NC_CLIENT, 0);
+    session = nc_new_session(NC_CLIENT);
     assert_non_null(session);
     will_return(__wrap_nc_sock_accept_binds, 2);
     will_return(__wrap_nc_accept_callhome_ssh_sock, session);
@@ -766,7 +769,7 @@ test_nc_client_ssh_callhome_successful(void **state)
     int ret;
 
     /* create session structure */
-    session = nc_new_session(NC_CLIENT, 0);
+    session = nc_new_session(NC_CLIENT);
     assert_non_null(session);
 
     /* prepare to fake return values for functions used by nc_accept_callhome */
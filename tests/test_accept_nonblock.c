@@ -0,0 +1,233 @@
+/**
+ * \file test_accept_nonblock.c
+ * \brief libnetconf2 tests - non-blocking accept and resumable handshakes
+ *
+ * Copyright (c) 2015 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <poll.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+#include <libyang/libyang.h>
+
+#include <session_server.h>
+#include "tests/config.h"
+
+#define TEST_SOCK BUILD_DIR "/test_accept_nonblock.sock"
+
+/* client <hello> split into two parts */
+#define HELLO_START "<hello xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\"><capabilities>"
+#define HELLO_END "<capability>urn:ietf:params:netconf:base:1.0</capability></capabilities></hello>]]>]]>"
+
+struct ly_ctx *ctx;
+
+static int
+setup_f(void **state)
+{
+    (void)state;
+
+    unlink(TEST_SOCK);
+    assert_int_equal(nc_server_add_endpt("unix", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_endpt_set_address("unix", TEST_SOCK), 0);
+
+    return 0;
+}
+
+static int
+teardown_f(void **state)
+{
+    (void)state;
+
+    assert_int_equal(nc_server_del_endpt(NULL, 0), 0);
+    unlink(TEST_SOCK);
+
+    return 0;
+}
+
+/**
+ * @brief Connect to the server.
+ */
+static int
+test_connect(void)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    int sock;
+
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert_int_not_equal(sock, -1);
+    strcpy(addr.sun_path, TEST_SOCK);
+    assert_int_equal(connect(sock, (struct sockaddr *)&addr, sizeof addr), 0);
+
+    return sock;
+}
+
+/**
+ * @brief Read the server \<hello\>.
+ */
+static void
+test_read_hello(int sock)
+{
+    struct pollfd pfd = {.fd = sock, .events = POLLIN};
+    char buf[4096];
+
+    /* sent right after accepting */
+    assert_int_equal(poll(&pfd, 1, 1000), 1);
+    assert_true(read(sock, buf, sizeof buf) > 0);
+}
+
+static void
+test_accept_timeout(void **state)
+{
+    struct nc_session *session = NULL;
+
+    (void)state;
+
+    /* nothing to accept */
+    assert_int_equal(nc_accept_nonblock(0, ctx, &session), NC_MSG_WOULDBLOCK);
+    assert_null(session);
+}
+
+static void
+test_handshake(void **state)
+{
+    struct nc_session *session;
+    int sock;
+
+    (void)state;
+
+    sock = test_connect();
+
+    /* the client has not sent its <hello> yet */
+    assert_int_equal(nc_accept_nonblock(1000, ctx, &session), NC_MSG_NONE);
+    assert_non_null(session);
+    assert_int_equal(nc_session_get_status(session), NC_STATUS_STARTING);
+    test_read_hello(sock);
+    assert_int_equal(nc_session_handshake(session), NC_MSG_NONE);
+
+    /* partial <hello> */
+    assert_int_equal(write(sock, HELLO_START, strlen(HELLO_START)), strlen(HELLO_START));
+    usleep(10000);
+    assert_int_equal(nc_session_handshake(session), NC_MSG_NONE);
+    assert_int_equal(nc_session_get_status(session), NC_STATUS_STARTING);
+
+    /* finished */
+    assert_int_equal(write(sock, HELLO_END, strlen(HELLO_END)), strlen(HELLO_END));
+    usleep(10000);
+    assert_int_equal(nc_session_handshake(session), NC_MSG_HELLO);
+    assert_int_equal(nc_session_get_status(session), NC_STATUS_RUNNING);
+
+    /* no handshake anymore */
+    assert_int_equal(nc_session_handshake(session), NC_MSG_ERROR);
+
+    nc_session_free(session, NULL);
+    close(sock);
+}
+
+static void
+test_handshake_bad_hello(void **state)
+{
+    struct nc_session *session;
+    const char *msg = "<hello xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\">"
+            "<session-id>1</session-id></hello>]]>]]>";
+    int sock;
+
+    (void)state;
+
+    sock = test_connect();
+    assert_int_equal(nc_accept_nonblock(1000, ctx, &session), NC_MSG_NONE);
+    test_read_hello(sock);
+
+    /* only the server sends its session ID */
+    assert_int_equal(write(sock, msg, strlen(msg)), strlen(msg));
+    usleep(10000);
+    assert_int_equal(nc_session_handshake(session), NC_MSG_BAD_HELLO);
+    assert_int_equal(nc_session_get_status(session), NC_STATUS_INVALID);
+    assert_int_equal(nc_session_get_term_reason(session), NC_SESSION_TERM_BADHELLO);
+
+    nc_session_free(session, NULL);
+    close(sock);
+}
+
+static void
+test_handshake_ps(void **state)
+{
+    struct nc_pollsession *ps;
+    struct nc_session *session, *polled;
+    int sock;
+
+    (void)state;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+
+    sock = test_connect();
+    assert_int_equal(nc_accept_nonblock(1000, ctx, &session), NC_MSG_NONE);
+    test_read_hello(sock);
+    assert_int_equal(nc_ps_add_session(ps, session), 0);
+
+    /* the handshake is not advanced without new data */
+    assert_int_equal(nc_ps_poll(ps, 0, &polled), NC_PSPOLL_TIMEOUT);
+    assert_int_equal(nc_ps_poll(ps, 50, &polled), NC_PSPOLL_TIMEOUT);
+    assert_int_equal(nc_session_get_status(session), NC_STATUS_STARTING);
+
+    /* partial <hello> */
+    assert_int_equal(write(sock, HELLO_START, strlen(HELLO_START)), strlen(HELLO_START));
+    assert_int_equal(nc_ps_poll(ps, 1000, &polled), NC_PSPOLL_HANDSHAKE);
+    assert_ptr_equal(polled, session);
+    assert_int_equal(nc_session_get_status(session), NC_STATUS_STARTING);
+    assert_int_equal(nc_ps_poll(ps, 50, &polled), NC_PSPOLL_TIMEOUT);
+
+    /* the rest finishes the handshake */
+    assert_int_equal(write(sock, HELLO_END, strlen(HELLO_END)), strlen(HELLO_END));
+    assert_int_equal(nc_ps_poll(ps, 1000, &polled), NC_PSPOLL_HANDSHAKE);
+    assert_ptr_equal(polled, session);
+    assert_int_equal(nc_session_get_status(session), NC_STATUS_RUNNING);
+
+    /* the client closing the session is a normal session event now */
+    close(sock);
+    assert_true(nc_ps_poll(ps, 1000, &polled) & NC_PSPOLL_SESSION_TERM);
+
+    nc_ps_clear(ps, 1, NULL);
+    nc_ps_free(ps);
+}
+
+int
+main(void)
+{
+    int ret;
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
+    assert_non_null(ctx);
+
+    nc_server_init();
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_accept_timeout, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_handshake, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_handshake_bad_hello, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_handshake_ps, setup_f, teardown_f),
+    };
+
+    ret = cmocka_run_group_tests(tests, NULL, NULL);
+
+    nc_server_destroy();
+    ly_ctx_destroy(ctx);
+
+    return ret;
+}
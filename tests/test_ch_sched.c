@@ -0,0 +1,271 @@
+/**
+ * \file test_ch_sched.c
+ * \brief libnetconf2 tests - Call Home scheduler connecting, reconnecting, and handshakes in progress
+ *
+ * Copyright (c) 2015 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+#include <libyang/libyang.h>
+
+#include <session_p.h>
+#include <session_server.h>
+#include <session_server_ch.h>
+#include "tests/config.h"
+
+/* more clients than there are scheduler workers */
+#define CLIENT_COUNT (2 * NC_CH_SCHED_WORKERS)
+
+struct ly_ctx *ctx;
+ATOMIC_T ctx_acquired;
+ATOMIC_T ctx_released;
+
+static int
+clb_server_cert(const char *name, void *user_data, char **cert_path, char **cert_data, char **privkey_path,
+        char **privkey_data, NC_SSH_KEY_TYPE *privkey_type)
+{
+    (void)user_data;
+    (void)cert_data;
+    (void)privkey_data;
+    (void)privkey_type;
+
+    assert_string_equal(name, "server_cert");
+    *cert_path = strdup(TESTS_DIR "/data/server.crt");
+    *privkey_path = strdup(TESTS_DIR "/data/server.key");
+    return 0;
+}
+
+static const struct ly_ctx *
+acquire_ctx_clb(void *cb_data)
+{
+    (void)cb_data;
+
+    ATOMIC_INC_RELAXED(ctx_acquired);
+    return ctx;
+}
+
+static void
+release_ctx_clb(void *cb_data)
+{
+    (void)cb_data;
+
+    ATOMIC_INC_RELAXED(ctx_released);
+}
+
+static int
+new_session_clb(const char *client_name, struct nc_session *new_session)
+{
+    (void)client_name;
+    (void)new_session;
+
+    /* the peers never finish the handshake */
+    fail();
+    return 1;
+}
+
+/**
+ * @brief Create a listening socket on a random localhost port.
+ */
+static int
+test_listen(uint16_t *port)
+{
+    struct sockaddr_in addr = {0};
+    socklen_t len = sizeof addr;
+    int sock;
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    assert_int_not_equal(sock, -1);
+
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert_int_equal(bind(sock, (struct sockaddr *)&addr, sizeof addr), 0);
+    assert_int_equal(listen(sock, 8), 0);
+    assert_int_equal(getsockname(sock, (struct sockaddr *)&addr, &len), 0);
+    *port = ntohs(addr.sin_port);
+
+    return sock;
+}
+
+/**
+ * @brief Accept a connection of the server, fail if it does not come in time.
+ */
+static int
+test_accept(int lsock, int timeout)
+{
+    struct pollfd pfd = {.fd = lsock, .events = POLLIN};
+    int sock;
+
+    assert_int_equal(poll(&pfd, 1, timeout), 1);
+    sock = accept(lsock, NULL, NULL);
+    assert_int_not_equal(sock, -1);
+
+    return sock;
+}
+
+/**
+ * @brief Wait until the server closes a connection, fail if it does not in time.
+ */
+static void
+test_closed(int sock, int timeout)
+{
+    struct pollfd pfd = {.fd = sock, .events = POLLIN};
+    char buf[512];
+    ssize_t r;
+
+    do {
+        assert_int_equal(poll(&pfd, 1, timeout), 1);
+        r = read(sock, buf, sizeof buf);
+    } while (r > 0);
+    assert_int_equal(r, 0);
+}
+
+static void
+test_add_client(const char *name, uint16_t port)
+{
+    assert_int_equal(nc_server_ch_add_client(name), 0);
+    assert_int_equal(nc_server_ch_client_add_endpt(name, "endpt", NC_TI_OPENSSL), 0);
+    assert_int_equal(nc_server_ch_client_endpt_set_address(name, "endpt", "127.0.0.1"), 0);
+    assert_int_equal(nc_server_ch_client_endpt_set_port(name, "endpt", port), 0);
+    assert_int_equal(nc_server_tls_ch_client_endpt_set_server_cert(name, "endpt", "server_cert"), 0);
+}
+
+static void
+test_ch_saturation(void **state)
+{
+    int lsock[CLIENT_COUNT], sock[CLIENT_COUNT], i;
+    uint16_t port;
+    char name[16];
+
+    (void)state;
+
+    for (i = 0; i < CLIENT_COUNT; ++i) {
+        lsock[i] = test_listen(&port);
+        sprintf(name, "client%d", i);
+        test_add_client(name, port);
+        assert_int_equal(nc_connect_ch_client_dispatch(name, acquire_ctx_clb, release_ctx_clb, NULL,
+                new_session_clb), 0);
+    }
+
+    /* the peers never send anything, the handshakes in progress must not occupy the workers */
+    for (i = 0; i < CLIENT_COUNT; ++i) {
+        sock[i] = test_accept(lsock[i], NC_TRANSPORT_TIMEOUT / 2);
+    }
+    assert_int_equal(ATOMIC_LOAD_RELAXED(ctx_acquired), CLIENT_COUNT);
+
+    /* removed clients abort their handshakes right away */
+    assert_int_equal(nc_server_ch_del_client(NULL), 0);
+    for (i = 0; i < CLIENT_COUNT; ++i) {
+        test_closed(sock[i], 1000);
+        close(sock[i]);
+        close(lsock[i]);
+    }
+
+    /* the job of a removed client may still be finishing */
+    for (i = 0; (i < 100) && (ATOMIC_LOAD_RELAXED(ctx_released) != ATOMIC_LOAD_RELAXED(ctx_acquired)); ++i) {
+        usleep(10000);
+    }
+    assert_int_equal(ATOMIC_LOAD_RELAXED(ctx_released), ATOMIC_LOAD_RELAXED(ctx_acquired));
+}
+
+static void
+test_ch_reconnect(void **state)
+{
+    int lsock, sock;
+    uint16_t port;
+    uint64_t usec;
+
+    (void)state;
+
+    lsock = test_listen(&port);
+    test_add_client("client", port);
+    assert_int_equal(nc_connect_ch_client_dispatch("client", acquire_ctx_clb, release_ctx_clb, NULL,
+            new_session_clb), 0);
+
+    /* failed handshake */
+    sock = test_accept(lsock, 1000);
+    close(sock);
+    usec = nc_time_mono_usec();
+
+    /* the next attempt is backed off with some jitter */
+    sock = test_accept(lsock, NC_CH_ENDPT_BACKOFF_WAIT * 1500 + 1000);
+    usec = nc_time_mono_usec() - usec;
+    assert_true(usec >= (NC_CH_ENDPT_BACKOFF_WAIT * 1000 - 100) * 1000);
+    close(sock);
+
+    assert_int_equal(nc_server_ch_del_client("client"), 0);
+    close(lsock);
+}
+
+static void
+test_ch_endpt_added(void **state)
+{
+    int lsock, sock;
+    uint16_t port;
+
+    (void)state;
+
+    /* a client without endpoints is not polled */
+    assert_int_equal(nc_server_ch_add_client("client"), 0);
+    assert_int_equal(nc_connect_ch_client_dispatch("client", acquire_ctx_clb, release_ctx_clb, NULL,
+            new_session_clb), 0);
+    usleep(100000);
+
+    /* it connects as soon as an endpoint is added */
+    lsock = test_listen(&port);
+    assert_int_equal(nc_server_ch_client_add_endpt("client", "endpt", NC_TI_OPENSSL), 0);
+    assert_int_equal(nc_server_ch_client_endpt_set_address("client", "endpt", "127.0.0.1"), 0);
+    assert_int_equal(nc_server_ch_client_endpt_set_port("client", "endpt", port), 0);
+    assert_int_equal(nc_server_tls_ch_client_endpt_set_server_cert("client", "endpt", "server_cert"), 0);
+    sock = test_accept(lsock, 500);
+
+    assert_int_equal(nc_server_ch_del_client("client"), 0);
+    test_closed(sock, 1000);
+    close(sock);
+    close(lsock);
+}
+
+int
+main(void)
+{
+    int ret;
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
+    assert_non_null(ctx);
+
+    nc_server_init();
+    nc_server_tls_set_server_cert_clb(clb_server_cert, NULL, NULL);
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_ch_saturation),
+        cmocka_unit_test(test_ch_reconnect),
+        cmocka_unit_test(test_ch_endpt_added),
+    };
+
+    ret = cmocka_run_group_tests(tests, NULL, NULL);
+
+    nc_server_destroy();
+    ly_ctx_destroy(ctx);
+
+    return ret;
+}
@@ -0,0 +1,257 @@
+/**
+ * \file test_ctx_pool.c
+ * \brief libnetconf2 tests - client contexts shared by sessions to servers with the same modules
+ *
+ * Copyright (c) 2015 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+#include <libyang/libyang.h>
+
+#include <session_client.h>
+#include <session_p.h>
+#include <session_server.h>
+#include "tests/config.h"
+
+#define TEST_SOCK BUILD_DIR "/test_ctx_pool.sock"
+
+/* server contexts with different modules, one more than the unused client contexts kept */
+#define SERVER_CTX_COUNT (NC_CLIENT_CTX_POOL_IDLE_MAX + 2)
+
+struct ly_ctx *server_ctx[SERVER_CTX_COUNT];
+ATOMIC_T server_ctx_idx;
+ATOMIC_T server_stop;
+ATOMIC_T getschema_count;
+pthread_t server_tid;
+
+static struct nc_server_reply *
+getschema_clb(struct lyd_node *rpc, struct nc_session *session)
+{
+    ATOMIC_INC_RELAXED(getschema_count);
+
+    return nc_clb_default_get_schema(rpc, session);
+}
+
+static void *
+server_thread(void *arg)
+{
+    struct nc_pollsession *ps;
+    struct nc_session *session;
+    NC_MSG_TYPE msgtype;
+
+    (void)arg;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+
+    while (!ATOMIC_LOAD_RELAXED(server_stop)) {
+        msgtype = nc_accept(10, server_ctx[ATOMIC_LOAD_RELAXED(server_ctx_idx)], &session);
+        if (msgtype == NC_MSG_HELLO) {
+            assert_int_equal(nc_ps_add_session(ps, session), 0);
+        }
+
+        /* <get-schema>, <close-session> and the closed sessions */
+        nc_ps_poll(ps, 10, NULL);
+        nc_ps_clear(ps, 0, NULL);
+    }
+
+    nc_ps_clear(ps, 1, NULL);
+    nc_ps_free(ps);
+    return NULL;
+}
+
+/**
+ * @brief Connect a new client session to a server with the modules of a server context.
+ *
+ * @param[in] idx Index of the server context.
+ * @param[out] rebuilt Whether the client context was created from scratch.
+ * @return Client session.
+ */
+static struct nc_session *
+test_connect(uint32_t idx, int *rebuilt)
+{
+    struct nc_session *session;
+
+    ATOMIC_STORE_RELAXED(server_ctx_idx, idx);
+    ATOMIC_STORE_RELAXED(getschema_count, 0);
+
+    session = nc_connect_unix(TEST_SOCK, NULL);
+    assert_non_null(session);
+    assert_non_null(ly_ctx_get_module_implemented(nc_session_get_ctx(session), "module-a"));
+
+    /* a shared context is never filled again */
+    *rebuilt = ATOMIC_LOAD_RELAXED(getschema_count) ? 1 : 0;
+    return session;
+}
+
+/**
+ * @brief Connect a new client session and close it right away.
+ *
+ * @param[in] idx Index of the server context.
+ * @return Whether the client context was created from scratch.
+ */
+static int
+test_connect_close(uint32_t idx)
+{
+    struct nc_session *session;
+    int rebuilt;
+
+    session = test_connect(idx, &rebuilt);
+    nc_session_free(session, NULL);
+    return rebuilt;
+}
+
+static int
+setup_f(void **state)
+{
+    (void)state;
+
+    ATOMIC_STORE_RELAXED(server_stop, 0);
+    assert_int_equal(pthread_create(&server_tid, NULL, server_thread, NULL), 0);
+
+    return 0;
+}
+
+static int
+teardown_f(void **state)
+{
+    (void)state;
+
+    ATOMIC_STORE_RELAXED(server_stop, 1);
+    pthread_join(server_tid, NULL);
+
+    /* all the unused contexts destroyed */
+    nc_client_destroy();
+    nc_client_set_ctx_pool(1);
+
+    return 0;
+}
+
+static void
+test_ctx_pool_shared(void **state)
+{
+    struct nc_session *session1, *session2;
+    int rebuilt;
+
+    (void)state;
+
+    session1 = test_connect(0, &rebuilt);
+    assert_true(rebuilt);
+
+    /* the same modules, the same context */
+    session2 = test_connect(0, &rebuilt);
+    assert_false(rebuilt);
+    assert_ptr_equal(nc_session_get_ctx(session1), nc_session_get_ctx(session2));
+
+    /* other modules, another context */
+    assert_true(test_connect_close(1));
+
+    /* the context is kept after all its sessions are freed */
+    nc_session_free(session1, NULL);
+    nc_session_free(session2, NULL);
+    assert_false(test_connect_close(0));
+}
+
+static void
+test_ctx_pool_lru(void **state)
+{
+    struct nc_session *session, *session2;
+    uint32_t i;
+    int rebuilt;
+
+    (void)state;
+
+    /* used context */
+    session = test_connect(0, &rebuilt);
+    assert_true(rebuilt);
+
+    /* one more unused context than kept, the least recently used one is evicted */
+    for (i = 1; i < SERVER_CTX_COUNT; ++i) {
+        assert_true(test_connect_close(i));
+    }
+
+    /* the used context is never evicted, dropping its second reference does not make it unused */
+    session2 = test_connect(0, &rebuilt);
+    assert_false(rebuilt);
+    nc_session_free(session2, NULL);
+
+    /* kept and used again, the most recently used now */
+    assert_false(test_connect_close(2));
+
+    /* evicted, the context of 3 is evicted by this one */
+    assert_true(test_connect_close(1));
+    assert_true(test_connect_close(3));
+
+    /* the rest was kept */
+    for (i = 5; i < SERVER_CTX_COUNT; ++i) {
+        assert_false(test_connect_close(i));
+    }
+
+    nc_session_free(session, NULL);
+}
+
+int
+main(void)
+{
+    int ret;
+    uint32_t i;
+    struct lysc_node *node;
+    const char *features[SERVER_CTX_COUNT][3] = {
+        {NULL}, {"candidate", NULL}, {"startup", NULL}, {"url", NULL}, {"xpath", NULL}, {"validate", NULL},
+        {"writable-running", NULL}, {"rollback-on-error", NULL}, {"candidate", "startup", NULL}, {"url", "xpath", NULL}
+    };
+
+    /* every context with different ietf-netconf features */
+    for (i = 0; i < SERVER_CTX_COUNT; ++i) {
+        ly_ctx_new(TESTS_DIR "/data/modules", 0, &server_ctx[i]);
+        assert_non_null(server_ctx[i]);
+        assert_non_null(ly_ctx_load_module(server_ctx[i], "ietf-netconf", NULL, features[i]));
+        assert_non_null(ly_ctx_load_module(server_ctx[i], "ietf-netconf-monitoring", NULL, NULL));
+        assert_non_null(ly_ctx_load_module(server_ctx[i], "module-a", NULL, NULL));
+
+        /* counts the RPCs, otherwise the default callback */
+        node = (struct lysc_node *)lys_find_path(server_ctx[i], NULL, "/ietf-netconf-monitoring:get-schema", 0);
+        assert_non_null(node);
+        node->priv = getschema_clb;
+    }
+
+    nc_server_init();
+
+    unlink(TEST_SOCK);
+    assert_int_equal(nc_server_add_endpt("unix", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_endpt_set_address("unix", TEST_SOCK), 0);
+
+    nc_client_set_ctx_pool(1);
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_ctx_pool_shared, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_ctx_pool_lru, setup_f, teardown_f),
+    };
+
+    ret = cmocka_run_group_tests(tests, NULL, NULL);
+
+    assert_int_equal(nc_server_del_endpt(NULL, 0), 0);
+    unlink(TEST_SOCK);
+    nc_client_destroy();
+    nc_server_destroy();
+    for (i = 0; i < SERVER_CTX_COUNT; ++i) {
+        ly_ctx_destroy(server_ctx[i]);
+    }
+
+    return ret;
+}
@@ -24,6 +24,7 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <cmocka.h>
@@ -39,6 +40,7 @@ struct nc_session *server_session;
 struct nc_session *client_session;
 struct ly_ctx *ctx;
 pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t state_cond = PTHREAD_COND_INITIALIZER;
 pthread_barrier_t barrier;
 int glob_state;
 
@@ -104,17 +106,9 @@ test_new_session(NC_SIDE side)
         sess->opts.server.rpc_inuse = 0;
     }
 
-    sess->io_lock = malloc(sizeof *sess->io_lock);
-    if (!sess->io_lock) {
-        goto error;
-    }
-    pthread_mutex_init(sess->io_lock, NULL);
+    pthread_mutex_init(&sess->io_lock, NULL);
 
     return sess;
-
-error:
-    free(sess);
-    return NULL;
 }
 
 static int
@@ -166,6 +160,35 @@ teardown_sessions(void **state)
     return 0;
 }
 
+static int
+setup_mem_sessions(void **state)
+{
+    (void)state;
+
+    /* create connected sessions with the handshake done */
+    assert_int_equal(nc_accept_mem("test", ctx, &server_session, &client_session), NC_MSG_HELLO);
+    assert_int_equal(nc_session_get_ti(server_session), NC_TI_MEM);
+    assert_int_equal(nc_session_get_ti(client_session), NC_TI_MEM);
+    assert_string_equal(nc_session_get_username(server_session), "test");
+    assert_int_equal(server_session->version, NC_VERSION_11);
+    assert_int_equal(client_session->version, NC_VERSION_11);
+
+    return 0;
+}
+
+static int
+teardown_mem_sessions(void **state)
+{
+    (void)state;
+
+    /* the client learns that the server session is gone and does not wait for a reply to its <close-session> */
+    nc_session_free(server_session, NULL);
+    assert_int_equal(nc_session_is_connected(client_session), 0);
+    nc_session_free(client_session, NULL);
+
+    return 0;
+}
+
 static void
 test_send_recv_ok(void)
 {
@@ -175,6 +198,10 @@ test_send_recv_ok(void)
     struct nc_rpc *rpc;
     struct lyd_node *envp, *op;
     struct nc_pollsession *ps;
+    struct nc_session_stats server_stats, client_stats;
+    struct nc_server_stats stats, stats2;
+
+    nc_server_get_stats(&stats);
 
     /* client RPC */
     rpc = nc_rpc_get(NULL, 0, 0);
@@ -202,6 +229,21 @@ test_send_recv_ok(void)
     assert_null(op);
     assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
     lyd_free_tree(envp);
+
+    /* statistics */
+    assert_int_equal(nc_session_get_stats(server_session, &server_stats), 0);
+    assert_int_equal(nc_session_get_stats(client_session, &client_stats), 0);
+    assert_int_equal(server_stats.in_rpcs, 1);
+    assert_int_equal(server_stats.in_bad_rpcs, 0);
+    assert_int_equal(server_stats.out_rpc_errors, 0);
+    assert_int_not_equal(server_stats.in_bytes, 0);
+    assert_int_equal(server_stats.in_bytes, client_stats.out_bytes);
+    assert_int_not_equal(server_stats.out_bytes, 0);
+    assert_int_equal(server_stats.out_bytes, client_stats.in_bytes);
+
+    nc_server_get_stats(&stats2);
+    assert_int_equal(stats2.in_rpcs, stats.in_rpcs + 1);
+    assert_int_equal(stats2.out_rpc_errors, stats.out_rpc_errors);
 }
 
 static void
@@ -328,244 +370,1883 @@ test_send_recv_data(void)
     lyd_free_tree(op);
 }
 
-static void
-test_send_recv_data_10(void **state)
+static int
+stream_data_clb(struct nc_session *session, void *user_data, struct lyd_node **data)
 {
-    (void)state;
+    int *batch = user_data;
+    char path[64];
 
-    server_session->version = NC_VERSION_10;
-    client_session->version = NC_VERSION_10;
+    assert_ptr_equal(session, server_session);
 
-    test_send_recv_data();
+    if (*batch == 3) {
+        /* no more data */
+        *data = NULL;
+        return 0;
+    }
+
+    /* one NACM group per batch */
+    ++(*batch);
+    sprintf(path, "/ietf-netconf-acm:nacm/groups/group[name='group%d']", *batch);
+    assert_int_equal(lyd_new_path(NULL, session->ctx, path, NULL, 0, data), LY_SUCCESS);
+    return 0;
 }
 
-static void
-test_send_recv_data_11(void **state)
+struct nc_server_reply *
+my_getconfig_stream_rpc_clb(struct lyd_node *rpc, struct nc_session *session)
 {
-    (void)state;
+    const struct lysc_node *anydata;
 
-    server_session->version = NC_VERSION_11;
-    client_session->version = NC_VERSION_11;
+    assert_string_equal(rpc->schema->name, "get-config");
+    assert_ptr_equal(session, server_session);
 
-    test_send_recv_data();
+    anydata = lys_find_path(session->ctx, NULL, "/ietf-netconf:get-config/data", 1);
+    assert_non_null(anydata);
+
+    return nc_server_reply_data_stream(anydata, stream_data_clb, &glob_state, NULL, NC_WD_EXPLICIT);
 }
 
-static void *
-server_send_notif_thread(void *arg)
+static void
+test_send_recv_data_stream_11(void **state)
 {
-    NC_MSG_TYPE msg_type;
-    struct lyd_node *notif_tree;
-    struct nc_server_notif *notif;
-    struct timespec ts;
-    char *buf;
+    struct lysc_node *node;
+    struct nc_pollsession *ps;
+    const char *msg;
+    char buf[4096];
+    ssize_t len;
 
-    (void)arg;
+    (void)state;
 
-    /* wait for the RPC callback to be called */
-    pthread_mutex_lock(&state_lock);
-    while (glob_state != 1) {
-        pthread_mutex_unlock(&state_lock);
-        usleep(1000);
-        pthread_mutex_lock(&state_lock);
-    }
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
 
-    /* create notif */
-    lyd_new_path(NULL, ctx, "/nc-notifications:notificationComplete", NULL, 0, &notif_tree);
-    assert_non_null(notif_tree);
-    clock_gettime(CLOCK_REALTIME, &ts);
-    ly_time_ts2str(&ts, &buf);
-    notif = nc_server_notif_new(notif_tree, buf, NC_PARAMTYPE_FREE);
-    assert_non_null(notif);
+    node = (struct lysc_node *)lys_find_path(ctx, NULL, "/ietf-netconf:get-config", 0);
+    assert_non_null(node);
+    node->priv = my_getconfig_stream_rpc_clb;
+    glob_state = 0;
 
-    /* send notif */
-    nc_session_inc_notif_status(server_session);
-    msg_type = nc_server_notif_send(server_session, notif, 100);
-    nc_server_notif_free(notif);
-    assert_int_equal(msg_type, NC_MSG_NOTIF);
+    /* reply data produced in 3 batches */
+    test_send_recv_data();
+    assert_int_equal(glob_state, 3);
 
-    /* update state */
-    glob_state = 2;
-    pthread_barrier_wait(&barrier);
-    pthread_mutex_unlock(&state_lock);
+    /* prefixed envelope with a prefixed attribute that needs escaping */
+    msg = "<nc:rpc xmlns:nc=\"urn:ietf:params:xml:ns:netconf:base:1.0\" xmlns:t=\"urn:test\" message-id=\"5\" "
+            "t:note=\"a&quot;b&lt;c\"><nc:get-config><nc:source><nc:running/></nc:source></nc:get-config></nc:rpc>";
+    sprintf(buf, "\n#%d\n%s\n##\n", (int)strlen(msg), msg);
+    assert_int_equal(write(client_session->ti.fd.out, buf, strlen(buf)), strlen(buf));
 
-    return NULL;
+    glob_state = 0;
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+    assert_int_equal(nc_ps_poll(ps, 0, NULL), NC_PSPOLL_RPC);
+    nc_ps_free(ps);
+    assert_int_equal(glob_state, 3);
+
+    /* the rpc-reply start tag is printed with all the attributes */
+    len = read(client_session->ti.fd.in, buf, sizeof buf - 1);
+    assert_true(len > 0);
+    buf[len] = '\0';
+    assert_non_null(strstr(buf, "<nc:rpc-reply xmlns:nc=\"urn:ietf:params:xml:ns:netconf:base:1.0\" message-id=\"5\" "
+            "xmlns:t=\"urn:test\" t:note=\"a&quot;b&lt;c\">"));
+    assert_non_null(strstr(buf, "</nc:rpc-reply>"));
+
+    node->priv = my_getconfig_rpc_clb;
 }
 
-static void *
-thread_recv_notif(void *arg)
+static void
+test_send_recv_prepared_11(void **state)
 {
-    struct nc_session *session = (struct nc_session *)arg;
-    struct lyd_node *envp;
-    struct lyd_node *op;
+    int ret, i;
+    uint64_t msgid, last_msgid;
     NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct nc_rpc_prepared *prepared;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+    const char *slots[] = {"running"};
+    const char *values[] = {"candidate"};
 
-    pthread_barrier_wait(&barrier);
-    msgtype = nc_recv_notif(session, 1000, &envp, &op);
-    assert_int_equal(msgtype, NC_MSG_NOTIF);
-    assert_string_equal(op->schema->name, "notificationComplete");
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    /* client RPC */
+    rpc = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL, 0, 0);
+    assert_non_null(rpc);
+    prepared = nc_rpc_prepare(client_session, rpc, slots, 1);
+    assert_non_null(prepared);
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
 
+    /* send it normally first */
+    msgtype = nc_send_rpc(client_session, rpc, 0, &last_msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+    msgtype = nc_recv_reply(client_session, rpc, last_msgid, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
     lyd_free_tree(envp);
     lyd_free_tree(op);
 
-    pthread_mutex_lock(&state_lock);
-    glob_state = 3;
-    pthread_mutex_unlock(&state_lock);
+    /* then as prepared and with a different datastore, the message-ids follow */
+    for (i = 0; i < 2; ++i) {
+        msgtype = nc_send_rpc_prepared(client_session, prepared, i ? values : NULL, 0, &msgid);
+        assert_int_equal(msgtype, NC_MSG_RPC);
+        assert_int_equal(msgid, last_msgid + 1);
+        last_msgid = msgid;
+
+        ret = nc_ps_poll(ps, 0, NULL);
+        assert_int_equal(ret, NC_PSPOLL_RPC);
+
+        msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+        assert_int_equal(msgtype, NC_MSG_REPLY);
+        assert_non_null(envp);
+        lyd_free_tree(envp);
+        assert_non_null(op);
+        lyd_free_tree(op);
+    }
 
-    return (void *)0;
+    nc_ps_free(ps);
+    nc_rpc_prepared_free(prepared);
+    nc_rpc_free(rpc);
 }
 
 static void
-test_send_recv_notif(void)
+print_sent_clb(const struct nc_session *session, NC_VERB_LEVEL level, const char *msg)
+{
+    if ((session == client_session) && (level == NC_VERB_DEBUG) && !strncmp(msg, "Sending message:", 16)) {
+        /* the whole message including the framing */
+        assert_non_null(strstr(msg, "\n#"));
+        assert_non_null(strstr(msg, "<get-config"));
+        assert_non_null(strstr(msg, "\n##\n"));
+        ++glob_state;
+    }
+}
+
+static void
+test_send_prepared_dump_11(void **state)
 {
     int ret;
-    pthread_t tid[2];
     uint64_t msgid;
     NC_MSG_TYPE msgtype;
     struct nc_rpc *rpc;
+    struct nc_rpc_prepared *prepared;
     struct lyd_node *envp, *op;
     struct nc_pollsession *ps;
+    const char *slots[] = {"running"};
 
-    /* client RPC */
-    rpc = nc_rpc_commit(0, 0, NULL, NULL, 0);
+    (void)state;
+
+    rpc = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL, 0, 0);
     assert_non_null(rpc);
+    prepared = nc_rpc_prepare(client_session, rpc, slots, 1);
+    assert_non_null(prepared);
 
-    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    /* the message written in several parts is printed once */
+    glob_state = 0;
+    nc_set_print_clb_session(print_sent_clb);
+    nc_verbosity(NC_VERB_DEBUG);
+    msgtype = nc_send_rpc_prepared(client_session, prepared, NULL, 0, &msgid);
+    nc_verbosity(NC_VERB_ERROR);
+    nc_set_print_clb_session(NULL);
     assert_int_equal(msgtype, NC_MSG_RPC);
+    assert_int_equal(glob_state, 1);
 
-    /* client subscription */
-    pthread_create(&tid[0], NULL, thread_recv_notif, client_session);
-
-    /* create server */
     ps = nc_ps_new();
     assert_non_null(ps);
     nc_ps_add_session(ps, server_session);
-
-    /* server will send a notification */
-    pthread_mutex_lock(&state_lock);
-    glob_state = 0;
-    pthread_mutex_unlock(&state_lock);
-    ret = pthread_create(&tid[1], NULL, server_send_notif_thread, NULL);
-    assert_int_equal(ret, 0);
-
-    /* server blocked on RPC */
     ret = nc_ps_poll(ps, 0, NULL);
     assert_int_equal(ret, NC_PSPOLL_RPC);
-
-    /* RPC, notification finished fine */
-    pthread_mutex_lock(&state_lock);
-    assert_int_equal(glob_state, 3);
-    pthread_mutex_unlock(&state_lock);
-
-    /* server finished */
-    ret = 0;
-    ret |= pthread_join(tid[0], NULL);
-    ret |= pthread_join(tid[1], NULL);
-    assert_int_equal(ret, 0);
     nc_ps_free(ps);
 
-    /* client reply */
     msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
     assert_int_equal(msgtype, NC_MSG_REPLY);
-    nc_rpc_free(rpc);
-
-    assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
     lyd_free_tree(envp);
-    assert_null(op);
-}
-
-static void
-test_send_recv_notif_10(void **state)
-{
-    (void)state;
-
-    server_session->version = NC_VERSION_10;
-    client_session->version = NC_VERSION_10;
+    lyd_free_tree(op);
 
-    test_send_recv_notif();
+    nc_rpc_prepared_free(prepared);
+    nc_rpc_free(rpc);
 }
 
 static void
-test_send_recv_notif_11(void **state)
+test_mem_hello_11(void **state)
 {
+    struct nc_mem_ring *ring;
+    size_t hello_len;
+
     (void)state;
 
-    server_session->version = NC_VERSION_11;
-    client_session->version = NC_VERSION_11;
+    assert_int_equal(nc_accept_mem("test", ctx, &server_session, &client_session), NC_MSG_HELLO);
 
-    test_send_recv_notif();
+    /* the server-to-client ring holds the whole server hello and nothing else was sent yet */
+    ring = NC_MEM_TX(server_session);
+    hello_len = nc_server_hello_len(ctx, server_session->id);
+    assert_int_not_equal(hello_len, 0);
+    assert_int_equal(ATOMIC_LOAD_RELAXED(ring->head), hello_len);
+    assert_true(ring->size >= hello_len);
+    assert_int_equal(ring->size & (ring->size - 1), 0);
+    assert_int_equal(NC_MEM_TX(client_session)->size, NC_MEM_RING_SIZE);
+
+    nc_session_free(server_session, NULL);
+    nc_session_free(client_session, NULL);
 }
 
 static void
-test_send_recv_malformed_10(void **state)
+test_idle_timeout_11(void **state)
 {
     int ret;
     struct nc_pollsession *ps;
-    struct nc_rpc *rpc;
-    struct lyd_node *envp, *op, *node;
-    NC_MSG_TYPE msgtype;
-    const char *msg;
 
     (void)state;
 
-    server_session->version = NC_VERSION_10;
-    client_session->version = NC_VERSION_10;
-
-    /* write malformed message */
-    msg =
-            "<nc:rpc xmlns:nc=\"urn:ietf:params:xml:ns:netconf:base:1.0\">"
-            "  <nc:commit/>"
-            "</nc:rpc>"
-            "]]>]]>";
-    assert_int_equal(write(client_session->ti.fd.out, msg, strlen(msg)), strlen(msg));
-    rpc = nc_rpc_commit(0, 0, NULL, NULL, 0);
-    assert_non_null(rpc);
+    nc_server_set_idle_timeout(1);
 
-    /* server RPC, send reply */
     ps = nc_ps_new();
     assert_non_null(ps);
     nc_ps_add_session(ps, server_session);
 
+    /* the idle timer is scheduled */
     ret = nc_ps_poll(ps, 0, NULL);
-    assert_int_equal(ret, NC_PSPOLL_BAD_RPC);
+    assert_int_equal(ret, NC_PSPOLL_TIMEOUT);
+
+    /* and expires without any RPC */
+    ret = nc_ps_poll(ps, 3000, NULL);
+    assert_int_equal(ret, NC_PSPOLL_SESSION_TERM | NC_PSPOLL_SESSION_ERROR);
+    assert_int_equal(server_session->term_reason, NC_SESSION_TERM_TIMEOUT);
 
-    /* server finished */
     nc_ps_free(ps);
+    nc_server_set_idle_timeout(0);
+}
 
-    /* client reply */
-    msgtype = nc_recv_reply(client_session, rpc, 0, 0, &envp, &op);
-    assert_int_equal(msgtype, NC_MSG_REPLY_ERR_MSGID);
+static void
+my_rpc_trace_clb(const struct nc_session *session, const struct lyd_node *rpc, NC_RPC_STAGE stage, int end,
+        void *user_data)
+{
+    int *calls = user_data;
 
-    nc_rpc_free(rpc);
-    assert_string_equal(LYD_NAME(lyd_child(envp)), "rpc-error");
-    lyd_find_sibling_opaq_next(lyd_child(lyd_child(envp)), "error-tag", &node);
-    assert_non_null(node);
-    assert_string_equal(((struct lyd_node_opaq *)node)->value, "missing-attribute");
-    lyd_free_tree(envp);
-    assert_null(op);
+    assert_true(stage < NC_RPC_STAGE_COUNT);
+    if (stage == NC_RPC_STAGE_PS_LOCK) {
+        assert_null(session);
+    } else {
+        assert_ptr_equal(session, server_session);
+    }
+    if ((stage > NC_RPC_STAGE_PARSE) || ((stage == NC_RPC_STAGE_PARSE) && end)) {
+        assert_non_null(rpc);
+    }
+
+    /* count the beginnings and the ends of every stage */
+    ++calls[stage * 2 + end];
 }
 
-int
-main(void)
+static int clb_free_count;
+
+static void
+clb_user_data_free(void *user_data)
 {
-    int ret;
-    const struct lys_module *module;
-    struct lysc_node *node;
-    const char *nc_features[] = {"candidate", NULL};
+    (void)user_data;
 
-    pthread_barrier_init(&barrier, NULL, 2);
+    ++clb_free_count;
+}
 
-    /* create ctx */
-    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
-    assert_non_null(ctx);
+static void
+replacing_rpc_trace_clb(const struct nc_session *session, const struct lyd_node *rpc, NC_RPC_STAGE stage, int end,
+        void *user_data)
+{
+    int *replaced = user_data;
 
-    /* load modules */
-    module = ly_ctx_load_module(ctx, "ietf-netconf-acm", NULL, NULL);
-    assert_non_null(module);
+    (void)session;
+    (void)rpc;
+    (void)stage;
+    (void)end;
 
-    module = ly_ctx_load_module(ctx, "ietf-netconf", NULL, nc_features);
-    assert_non_null(module);
+    if (!*replaced) {
+        *replaced = 1;
 
-    module = ly_ctx_load_module(ctx, "nc-notifications", NULL, NULL);
+        /* the callback being called is not freed */
+        nc_server_set_rpc_trace_clb(NULL, NULL, NULL);
+        assert_int_equal(clb_free_count, 1);
+    }
+}
+
+static void
+test_rpc_clb_replace_11(void **state)
+{
+    int ret, replaced = 0;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    /* not being called, freed right away */
+    clb_free_count = 0;
+    nc_server_set_rpc_trace_clb(replacing_rpc_trace_clb, &replaced, clb_user_data_free);
+    nc_server_set_rpc_trace_clb(replacing_rpc_trace_clb, &replaced, clb_user_data_free);
+    assert_int_equal(clb_free_count, 1);
+
+    /* replaced by itself, freed once it returns */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+    nc_ps_free(ps);
+
+    assert_true(replaced);
+    assert_int_equal(clb_free_count, 2);
+
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    nc_rpc_free(rpc);
+    assert_null(op);
+    lyd_free_tree(envp);
+}
+
+static void
+test_send_recv_latency_11(void **state)
+{
+    int ret, i, calls[NC_RPC_STAGE_COUNT * 2] = {0};
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+    struct nc_rpc_latency lat;
+    char **names;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    nc_server_set_rpc_latency(1);
+    nc_server_set_rpc_trace_clb(my_rpc_trace_clb, calls, NULL);
+
+    /* client RPC */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* server RPC, send reply */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+
+    nc_ps_free(ps);
+
+    /* client reply */
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    nc_rpc_free(rpc);
+    assert_null(op);
+    lyd_free_tree(envp);
+
+    nc_server_set_rpc_trace_clb(NULL, NULL, NULL);
+    nc_server_set_rpc_latency(0);
+
+    /* every stage traced once, except the write that is not */
+    for (i = 0; i < NC_RPC_STAGE_WRITE; ++i) {
+        assert_int_equal(calls[i * 2], 1);
+        assert_int_equal(calls[i * 2 + 1], 1);
+    }
+    assert_int_equal(calls[NC_RPC_STAGE_WRITE * 2], 0);
+
+    /* every stage measured once */
+    for (i = 0; i < NC_RPC_STAGE_COUNT; ++i) {
+        assert_int_equal(nc_server_get_rpc_latency("ietf-netconf:get", i, &lat), 0);
+        assert_int_equal(lat.count, 1);
+        assert_int_equal(lat.min, lat.max);
+        assert_int_equal(lat.sum, lat.max);
+        assert_true(lat.p50 <= lat.max);
+        assert_int_equal(lat.p999, lat.max);
+
+        assert_int_equal(nc_server_get_rpc_latency(NULL, i, &lat), 0);
+        assert_int_equal(lat.count, 1);
+    }
+
+    assert_int_equal(nc_server_get_rpc_latency("ietf-netconf:get-config", NC_RPC_STAGE_READ, &lat), 0);
+    assert_int_equal(lat.count, 0);
+
+    assert_int_equal(nc_server_get_rpc_latency_names(&names), 0);
+    assert_string_equal(names[0], "ietf-netconf:get");
+    assert_null(names[1]);
+    free(names[0]);
+    free(names);
+
+    nc_server_reset_rpc_latency();
+    assert_int_equal(nc_server_get_rpc_latency(NULL, NC_RPC_STAGE_CALLBACK, &lat), 0);
+    assert_int_equal(lat.count, 0);
+}
+
+static struct nc_server_reply *
+envelope_clb(const struct nc_session *session, const char *msgid, const char *module_ns, const char *name,
+        void *user_data)
+{
+    int *count = user_data;
+
+    assert_ptr_equal(session, server_session);
+    assert_non_null(msgid);
+    ++(*count);
+
+    if (!strcmp(name, "top")) {
+        /* action reported by its top-level data node */
+        assert_string_equal(module_ns, "urn:jmu:params:xml:ns:yang:module-act");
+        return nc_server_reply_err(nc_err(session->ctx, NC_ERR_ACCESS_DENIED, NC_ERR_TYPE_PROT));
+    }
+
+    assert_string_equal(module_ns, "urn:ietf:params:xml:ns:netconf:base:1.0");
+    if (!strcmp(name, "get-config")) {
+        /* rejected without parsing */
+        return nc_server_reply_err(nc_err(session->ctx, NC_ERR_ACCESS_DENIED, NC_ERR_TYPE_PROT));
+    }
+    return NULL;
+}
+
+static void
+test_send_recv_envelope_11(void **state)
+{
+    int ret, count = 0;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op, *node;
+    struct nc_pollsession *ps;
+    struct nc_session_stats stats;
+    const char *msg;
+    char buf[512];
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+    nc_server_set_rpc_envelope_clb(envelope_clb, &count, NULL);
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    /* rejected RPC */
+    rpc = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC | NC_PSPOLL_REPLY_ERROR);
+
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    nc_rpc_free(rpc);
+    assert_null(op);
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "rpc-error");
+    lyd_find_sibling_opaq_next(lyd_child(lyd_child(envp)), "error-tag", &node);
+    assert_non_null(node);
+    assert_string_equal(((struct lyd_node_opaq *)node)->value, "access-denied");
+    lyd_free_tree(envp);
+
+    /* allowed RPC */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    nc_rpc_free(rpc);
+    assert_null(op);
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+    lyd_free_tree(envp);
+
+    /* rejected action, the envelope is read on its own */
+    rpc = nc_rpc_act_generic_xml("<top xmlns=\"urn:jmu:params:xml:ns:yang:module-act\"><reset/></top>",
+            NC_PARAMTYPE_CONST);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC | NC_PSPOLL_REPLY_ERROR);
+    assert_int_equal(count, 3);
+
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_null(op);
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "rpc-error");
+    lyd_free_tree(envp);
+
+    /* rejected action, the envelope with a character reference is parsed with the RPC */
+    msg = "<rpc xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\" message-id=\"&#49;0\">"
+            "<action xmlns=\"urn:ietf:params:xml:ns:yang:1\">"
+            "<top xmlns=\"urn:jmu:params:xml:ns:yang:module-act\"><reset/></top>"
+            "</action></rpc>";
+    sprintf(buf, "\n#%d\n%s\n##\n", (int)strlen(msg), msg);
+    assert_int_equal(write(client_session->ti.fd.out, buf, strlen(buf)), strlen(buf));
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC | NC_PSPOLL_REPLY_ERROR);
+    assert_int_equal(count, 4);
+
+    msgtype = nc_recv_reply(client_session, rpc, 10, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    nc_rpc_free(rpc);
+    assert_null(op);
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "rpc-error");
+    lyd_free_tree(envp);
+
+    nc_ps_free(ps);
+    nc_server_set_rpc_envelope_clb(NULL, NULL, NULL);
+
+    assert_int_equal(nc_session_get_stats(server_session, &stats), 0);
+    assert_int_equal(stats.in_rpcs, 4);
+    assert_int_equal(stats.out_rpc_errors, 3);
+}
+
+static void
+test_send_recv_batch_11(void **state)
+{
+    int ret, i;
+    uint64_t msgids[3];
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+    struct nc_session_stats stats;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+    nc_server_set_rpc_batch(8);
+
+    /* pipelined RPCs */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    for (i = 0; i < 3; ++i) {
+        msgtype = nc_send_rpc(client_session, rpc, 0, &msgids[i]);
+        assert_int_equal(msgtype, NC_MSG_RPC);
+    }
+
+    /* all processed by a single poll */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+    assert_int_equal(nc_session_get_stats(server_session, &stats), 0);
+    assert_int_equal(stats.in_rpcs, 3);
+
+    /* nothing more to process */
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_TIMEOUT);
+    nc_ps_free(ps);
+    nc_server_set_rpc_batch(0);
+
+    /* replies in order */
+    for (i = 0; i < 3; ++i) {
+        msgtype = nc_recv_reply(client_session, rpc, msgids[i], 0, &envp, &op);
+        assert_int_equal(msgtype, NC_MSG_REPLY);
+        assert_null(op);
+        assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+        lyd_free_tree(envp);
+    }
+    nc_rpc_free(rpc);
+}
+
+static void
+print_async_clb(const struct nc_session *session, NC_VERB_LEVEL level, const char *msg)
+{
+    /* called from the printing thread with a placeholder session */
+    assert_ptr_not_equal(session, server_session);
+    assert_ptr_not_equal(session, client_session);
+
+    if ((level == NC_VERB_DEBUG) && !strncmp(msg, "Received message:", 17)) {
+        assert_non_null(session);
+        if ((nc_session_get_id(session) == server_session->id) && strstr(msg, "more bytes]")) {
+            pthread_mutex_lock(&state_lock);
+            ++glob_state;
+            pthread_mutex_unlock(&state_lock);
+        }
+    }
+}
+
+static void
+test_send_recv_print_async_11(void **state)
+{
+    int ret;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    glob_state = 0;
+    nc_set_print_clb_session(print_async_clb);
+    nc_set_print_msg_dump_limit(16);
+    assert_int_equal(nc_set_print_async(8192), 0);
+    nc_verbosity(NC_VERB_DEBUG);
+
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+    nc_ps_free(ps);
+
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    nc_rpc_free(rpc);
+    lyd_free_tree(envp);
+
+    /* all the messages are printed once disabled */
+    nc_verbosity(NC_VERB_ERROR);
+    assert_int_equal(nc_set_print_async(0), 0);
+    nc_set_print_msg_dump_limit(0);
+    nc_set_print_clb_session(NULL);
+
+    /* at least the truncated RPC received by the server */
+    assert_int_not_equal(glob_state, 0);
+}
+
+static void
+print_rate_clb(const struct nc_session *session, NC_VERB_LEVEL level, const char *msg)
+{
+    (void)level;
+
+    if (session != server_session) {
+        return;
+    }
+
+    pthread_mutex_lock(&state_lock);
+    if (!strcmp(msg, "Rate test.")) {
+        ++glob_state;
+    } else if (!strcmp(msg, "Rate test error.")) {
+        glob_state += 100;
+    } else if (!strcmp(msg, "3 messages dropped by the rate limit.")) {
+        glob_state += 10000;
+    }
+    pthread_mutex_unlock(&state_lock);
+}
+
+static void
+test_print_session_rate(void **state)
+{
+    struct timespec ts;
+    uint32_t sec;
+    int i;
+
+    (void)state;
+
+    glob_state = 0;
+    nc_set_print_clb_session(print_rate_clb);
+    nc_set_print_session_rate(2);
+    nc_verbosity(NC_VERB_VERBOSE);
+
+    /* 2 messages printed, 3 dropped, errors always printed */
+    do {
+        glob_state = 0;
+        ATOMIC_STORE_RELAXED(server_session->log.window, 0);
+        ATOMIC_STORE_RELAXED(server_session->log.dropped, 0);
+        nc_gettimespec_mono_add(&ts, 0);
+        sec = ts.tv_sec;
+        for (i = 0; i < 5; ++i) {
+            VRB(server_session, "Rate test.");
+        }
+        ERR(server_session, "Rate test error.");
+        nc_gettimespec_mono_add(&ts, 0);
+
+        /* repeated if a new window started meanwhile */
+    } while ((uint32_t)ts.tv_sec != sec);
+    assert_int_equal(glob_state, 102);
+
+    /* the dropped messages are reported in the next window */
+    while ((uint32_t)ts.tv_sec == sec) {
+        usleep(10000);
+        nc_gettimespec_mono_add(&ts, 0);
+    }
+    VRB(server_session, "Rate test.");
+    assert_int_equal(glob_state, 10103);
+
+    nc_verbosity(NC_VERB_ERROR);
+    nc_set_print_session_rate(0);
+    nc_set_print_clb_session(NULL);
+}
+
+static struct nc_server_reply *
+my_get_block_rpc_clb(struct lyd_node *rpc, struct nc_session *session)
+{
+    (void)rpc;
+    (void)session;
+
+    /* signal the RPC is being processed and wait until allowed to reply */
+    pthread_mutex_lock(&state_lock);
+    glob_state = 1;
+    pthread_cond_broadcast(&state_cond);
+    while (glob_state != 2) {
+        pthread_cond_wait(&state_cond, &state_lock);
+    }
+    pthread_mutex_unlock(&state_lock);
+
+    return nc_server_reply_ok();
+}
+
+static void *
+ps_poll_thread(void *arg)
+{
+    struct nc_pollsession *ps = arg;
+
+    assert_int_equal(nc_ps_poll(ps, 1000, NULL), NC_PSPOLL_RPC);
+    return NULL;
+}
+
+static void
+test_send_recv_ps_busy_11(void **state)
+{
+    uint64_t msgids[2];
+    int i;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+    struct lysc_node *node;
+    struct timespec cpu_start, cpu_end;
+    pthread_t tid;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    node = (struct lysc_node *)lys_find_path(ctx, NULL, "/ietf-netconf:get", 0);
+    assert_non_null(node);
+    node->priv = my_get_block_rpc_clb;
+    glob_state = 0;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+
+    /* the first RPC is being processed by another thread */
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgids[0]);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    assert_int_equal(pthread_create(&tid, NULL, ps_poll_thread, ps), 0);
+    pthread_mutex_lock(&state_lock);
+    while (glob_state != 1) {
+        pthread_cond_wait(&state_cond, &state_lock);
+    }
+    pthread_mutex_unlock(&state_lock);
+
+    /* the second RPC cannot be received meanwhile, the session is not busy-waited for */
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgids[1]);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+    assert_int_equal(nc_ps_poll(ps, 300, NULL), NC_PSPOLL_TIMEOUT);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+#ifdef HAVE_EPOLL
+    assert_true((cpu_end.tv_sec - cpu_start.tv_sec) * 1000000000L + (cpu_end.tv_nsec - cpu_start.tv_nsec) <
+            100000000L);
+#endif
+
+    /* it is received once the session is released */
+    pthread_mutex_lock(&state_lock);
+    glob_state = 2;
+    pthread_cond_broadcast(&state_cond);
+    pthread_mutex_unlock(&state_lock);
+    pthread_join(tid, NULL);
+    assert_int_equal(nc_ps_poll(ps, 1000, NULL), NC_PSPOLL_RPC);
+
+    for (i = 0; i < 2; ++i) {
+        msgtype = nc_recv_reply(client_session, rpc, msgids[i], 1000, &envp, &op);
+        assert_int_equal(msgtype, NC_MSG_REPLY);
+        assert_null(op);
+        assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+        lyd_free_tree(envp);
+    }
+
+    nc_rpc_free(rpc);
+    nc_ps_free(ps);
+    node->priv = my_get_rpc_clb;
+}
+
+static void
+test_send_recv_data_10(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_10;
+    client_session->version = NC_VERSION_10;
+
+    test_send_recv_data();
+}
+
+static void
+test_send_recv_data_11(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    test_send_recv_data();
+}
+
+static void *
+server_send_notif_thread(void *arg)
+{
+    NC_MSG_TYPE msg_type;
+    struct lyd_node *notif_tree;
+    struct nc_server_notif *notif;
+    struct timespec ts;
+    char *buf;
+
+    (void)arg;
+
+    /* wait for the RPC callback to be called */
+    pthread_mutex_lock(&state_lock);
+    while (glob_state != 1) {
+        pthread_mutex_unlock(&state_lock);
+        usleep(1000);
+        pthread_mutex_lock(&state_lock);
+    }
+
+    /* create notif */
+    lyd_new_path(NULL, ctx, "/nc-notifications:notificationComplete", NULL, 0, &notif_tree);
+    assert_non_null(notif_tree);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ly_time_ts2str(&ts, &buf);
+    notif = nc_server_notif_new(notif_tree, buf, NC_PARAMTYPE_FREE);
+    assert_non_null(notif);
+
+    /* send notif */
+    nc_session_inc_notif_status(server_session);
+    msg_type = nc_server_notif_send(server_session, notif, 100);
+    nc_server_notif_free(notif);
+    assert_int_equal(msg_type, NC_MSG_NOTIF);
+
+    /* update state */
+    glob_state = 2;
+    pthread_barrier_wait(&barrier);
+    pthread_mutex_unlock(&state_lock);
+
+    return NULL;
+}
+
+static void *
+thread_recv_notif(void *arg)
+{
+    struct nc_session *session = (struct nc_session *)arg;
+    struct lyd_node *envp;
+    struct lyd_node *op;
+    NC_MSG_TYPE msgtype;
+
+    pthread_barrier_wait(&barrier);
+    msgtype = nc_recv_notif(session, 1000, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_NOTIF);
+    assert_string_equal(op->schema->name, "notificationComplete");
+
+    lyd_free_tree(envp);
+    lyd_free_tree(op);
+
+    pthread_mutex_lock(&state_lock);
+    glob_state = 3;
+    pthread_mutex_unlock(&state_lock);
+
+    return (void *)0;
+}
+
+static void
+test_send_recv_notif(void)
+{
+    int ret;
+    pthread_t tid[2];
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+
+    /* client RPC */
+    rpc = nc_rpc_commit(0, 0, NULL, NULL, 0);
+    assert_non_null(rpc);
+
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* client subscription */
+    pthread_create(&tid[0], NULL, thread_recv_notif, client_session);
+
+    /* create server */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    /* server will send a notification */
+    pthread_mutex_lock(&state_lock);
+    glob_state = 0;
+    pthread_mutex_unlock(&state_lock);
+    ret = pthread_create(&tid[1], NULL, server_send_notif_thread, NULL);
+    assert_int_equal(ret, 0);
+
+    /* server blocked on RPC */
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+
+    /* RPC, notification finished fine */
+    pthread_mutex_lock(&state_lock);
+    assert_int_equal(glob_state, 3);
+    pthread_mutex_unlock(&state_lock);
+
+    /* server finished */
+    ret = 0;
+    ret |= pthread_join(tid[0], NULL);
+    ret |= pthread_join(tid[1], NULL);
+    assert_int_equal(ret, 0);
+    nc_ps_free(ps);
+
+    /* client reply */
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    nc_rpc_free(rpc);
+
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+    lyd_free_tree(envp);
+    assert_null(op);
+}
+
+static void
+test_send_recv_notif_10(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_10;
+    client_session->version = NC_VERSION_10;
+
+    test_send_recv_notif();
+}
+
+static void
+test_send_recv_notif_11(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    test_send_recv_notif();
+}
+
+#ifdef HAVE_EPOLL
+
+static void
+reactor_notif_clb(struct nc_session *session, const struct lyd_node *envp, const struct lyd_node *op, void *user_data)
+{
+    assert_ptr_equal(session, client_session);
+    assert_non_null(envp);
+    assert_string_equal(op->schema->name, "notificationComplete");
+    assert_null(user_data);
+
+    pthread_mutex_lock(&state_lock);
+    glob_state = 1;
+    pthread_mutex_unlock(&state_lock);
+}
+
+static void
+test_send_recv_notif_reactor_11(void **state)
+{
+    NC_MSG_TYPE msgtype;
+    struct lyd_node *notif_tree;
+    struct nc_server_notif *notif;
+    struct timespec ts;
+    char *buf;
+    int i;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    pthread_mutex_lock(&state_lock);
+    glob_state = 0;
+    pthread_mutex_unlock(&state_lock);
+
+    /* client dispatching notifications by the reactor */
+    assert_int_equal(nc_client_set_notif_reactor(2), 0);
+    assert_int_equal(nc_client_get_notif_reactor(), 2);
+    assert_int_equal(nc_recv_notif_dispatch_data(client_session, reactor_notif_clb, NULL, NULL), 0);
+    assert_true(nc_session_ntf_thread_running(client_session));
+
+    /* server notification */
+    lyd_new_path(NULL, ctx, "/nc-notifications:notificationComplete", NULL, 0, &notif_tree);
+    assert_non_null(notif_tree);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ly_time_ts2str(&ts, &buf);
+    notif = nc_server_notif_new(notif_tree, buf, NC_PARAMTYPE_FREE);
+    assert_non_null(notif);
+
+    nc_session_inc_notif_status(server_session);
+    msgtype = nc_server_notif_send(server_session, notif, 100);
+    nc_server_notif_free(notif);
+    assert_int_equal(msgtype, NC_MSG_NOTIF);
+
+    /* notification received and the session no longer dispatched after notificationComplete */
+    for (i = 0; i < 100; ++i) {
+        pthread_mutex_lock(&state_lock);
+        if ((glob_state == 1) && !ATOMIC_LOAD_RELAXED(client_session->opts.client.ntf_thread_count)) {
+            pthread_mutex_unlock(&state_lock);
+            break;
+        }
+        pthread_mutex_unlock(&state_lock);
+        usleep(10000);
+    }
+    assert_int_not_equal(i, 100);
+
+    assert_int_equal(nc_client_set_notif_reactor(0), 0);
+    assert_int_equal(nc_client_get_notif_reactor(), 0);
+}
+
+#endif /* HAVE_EPOLL */
+
+#ifdef HAVE_IO_URING
+
+static void
+test_send_recv_uring_rpc(struct nc_pollsession *ps)
+{
+    int ret;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* data received by the pending io_uring request */
+    ret = nc_ps_poll(ps, 1000, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 1000, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_null(op);
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+    lyd_free_tree(envp);
+    nc_rpc_free(rpc);
+}
+
+static void
+test_send_recv_uring_11(void **state)
+{
+    int ret;
+    struct nc_pollsession *ps;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+    if (!ps->uring_used) {
+        /* io_uring not available at runtime */
+        nc_ps_free(ps);
+        skip();
+    }
+
+    /* a new session without a receive buffer only waits for its transport */
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_TIMEOUT);
+    assert_int_equal(ps->sessions[0]->uring_op, NC_PS_URING_POLL);
+    test_send_recv_uring_rpc(ps);
+
+    /* an active session is read into its receive buffer */
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_TIMEOUT);
+    assert_int_equal(ps->sessions[0]->uring_op, NC_PS_URING_READ);
+    test_send_recv_uring_rpc(ps);
+
+    /* an idle session has its buffers freed and only waits for its transport again */
+    server_session->opts.server.last_rpc -= NC_SESSION_BUF_IDLE_TIMEOUT;
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_TIMEOUT);
+    assert_int_equal(ps->sessions[0]->uring_op, NC_PS_URING_POLL);
+    assert_null(server_session->rbuf);
+    test_send_recv_uring_rpc(ps);
+
+    /* removing the session cancels its request */
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_TIMEOUT);
+    assert_int_not_equal(ps->sessions[0]->uring_op, 0);
+    assert_int_equal(nc_ps_del_session(ps, server_session), 0);
+    assert_int_equal(nc_ps_session_count(ps), 0);
+
+    nc_ps_free(ps);
+}
+
+#endif /* HAVE_IO_URING */
+
+static void
+test_send_recv_notif_broadcast(void)
+{
+    NC_MSG_TYPE msgtype;
+    struct lyd_node *notif_tree, *envp, *op;
+    struct nc_server_notif *notif;
+    struct nc_session *sessions[2];
+    struct timespec ts;
+    char *buf;
+
+    /* server notification */
+    lyd_new_path(NULL, ctx, "/nc-notifications:notificationComplete", NULL, 0, &notif_tree);
+    assert_non_null(notif_tree);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ly_time_ts2str(&ts, &buf);
+    notif = nc_server_notif_new(notif_tree, buf, NC_PARAMTYPE_FREE);
+    assert_non_null(notif);
+
+    /* only the subscribed session receives it */
+    sessions[0] = server_session;
+    sessions[1] = client_session;
+    assert_int_equal(nc_server_notif_broadcast(sessions, 2, notif, 100), 0);
+    nc_session_inc_notif_status(server_session);
+    assert_int_equal(nc_server_notif_broadcast(sessions, 2, notif, 100), 1);
+    nc_server_notif_free(notif);
+
+    /* client notification */
+    msgtype = nc_recv_notif(client_session, 1000, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_NOTIF);
+    assert_string_equal(op->schema->name, "notificationComplete");
+    lyd_free_tree(envp);
+    lyd_free_tree(op);
+}
+
+static void
+test_send_recv_notif_broadcast_10(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_10;
+    client_session->version = NC_VERSION_10;
+
+    test_send_recv_notif_broadcast();
+}
+
+static void
+test_send_recv_notif_broadcast_11(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    test_send_recv_notif_broadcast();
+}
+
+static void *
+thread_recv_notif_count(void *arg)
+{
+    struct lyd_node *envp;
+    struct lyd_node *op;
+    NC_MSG_TYPE msgtype;
+    int i, count = *(int *)arg;
+
+    for (i = 0; i < count; ++i) {
+        msgtype = nc_recv_notif(client_session, 5000, &envp, &op);
+        assert_int_equal(msgtype, NC_MSG_NOTIF);
+        assert_string_equal(op->schema->name, "notificationComplete");
+
+        lyd_free_tree(envp);
+        lyd_free_tree(op);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Fill the output queue of the server session and receive all the queued notifications.
+ *
+ * @param[in] nonblock Whether the server output file descriptor is non-blocking.
+ */
+static void
+test_send_recv_notif_queue(int nonblock)
+{
+    NC_MSG_TYPE msgtype = NC_MSG_NOTIF;
+    struct lyd_node *notif_tree;
+    struct nc_server_notif *notif;
+    struct timespec ts;
+    pthread_t tid;
+    char *buf;
+    int count;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+    if (nonblock) {
+        fcntl(server_session->ti.fd.out, F_SETFL, fcntl(server_session->ti.fd.out, F_GETFL) | O_NONBLOCK);
+    }
+
+    nc_server_set_out_queue_size(1);
+    assert_int_equal(nc_server_get_out_queue_size(), 1);
+
+    /* server notification */
+    lyd_new_path(NULL, ctx, "/nc-notifications:notificationComplete", NULL, 0, &notif_tree);
+    assert_non_null(notif_tree);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ly_time_ts2str(&ts, &buf);
+    notif = nc_server_notif_new(notif_tree, buf, NC_PARAMTYPE_FREE);
+    assert_non_null(notif);
+
+    /* the client is not reading, the notifications are queued until the queue is full */
+    nc_session_inc_notif_status(server_session);
+    for (count = 0; (count < 100000) && (msgtype == NC_MSG_NOTIF); ++count) {
+        msgtype = nc_server_notif_send(server_session, notif, 0);
+    }
+    assert_int_equal(msgtype, NC_MSG_WOULDBLOCK);
+    assert_int_not_equal(server_session->obuf_len, 0);
+
+    /* all the sent notifications, without the rejected one but with the last one, are received */
+    assert_int_equal(pthread_create(&tid, NULL, thread_recv_notif_count, &count), 0);
+
+    /* without the queue, the last notification is written only after all the queued ones */
+    nc_server_set_out_queue_size(0);
+    msgtype = nc_server_notif_send(server_session, notif, 1000);
+    assert_int_equal(msgtype, NC_MSG_NOTIF);
+    assert_int_equal(server_session->obuf_len, 0);
+    nc_server_notif_free(notif);
+
+    pthread_join(tid, NULL);
+}
+
+static void
+test_send_recv_notif_queue_11(void **state)
+{
+    (void)state;
+
+    test_send_recv_notif_queue(1);
+}
+
+static void
+test_send_recv_notif_queue_blocking_11(void **state)
+{
+    (void)state;
+
+    /* the queue is written only as much as the blocking descriptor accepts without blocking */
+    test_send_recv_notif_queue(0);
+}
+
+static void
+dispatch_clb(struct nc_pollsession *ps, struct nc_session *session, int ret, void *user_data)
+{
+    (void)user_data;
+
+    assert_non_null(ps);
+    assert_ptr_equal(session, server_session);
+
+    pthread_mutex_lock(&state_lock);
+    glob_state = ret;
+    pthread_mutex_unlock(&state_lock);
+}
+
+static void
+test_send_recv_dispatch_11(void **state)
+{
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+    struct nc_ps_dispatcher *disp;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    /* server dispatching the session */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    pthread_mutex_lock(&state_lock);
+    glob_state = 0;
+    pthread_mutex_unlock(&state_lock);
+    disp = nc_ps_dispatcher_new(ps, 2, dispatch_clb, NULL);
+    assert_non_null(disp);
+
+    /* client RPC */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* client reply */
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 1000, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    nc_rpc_free(rpc);
+    assert_null(op);
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+    lyd_free_tree(envp);
+
+    /* server finished */
+    nc_ps_dispatcher_free(disp);
+    pthread_mutex_lock(&state_lock);
+    assert_int_equal(glob_state, NC_PSPOLL_RPC);
+    pthread_mutex_unlock(&state_lock);
+    nc_ps_free(ps);
+}
+
+static void
+async_reply_clb(struct nc_session *session, uint64_t msgid, NC_MSG_TYPE msgtype, const struct lyd_node *envp,
+        const struct lyd_node *op, void *user_data)
+{
+    assert_ptr_equal(session, client_session);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_null(op);
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+
+    /* user data are the expected message ID */
+    assert_int_equal(msgid, *(uint64_t *)user_data);
+    *(uint64_t *)user_data = 0;
+}
+
+static void
+test_send_recv_async_11(void **state)
+{
+    uint64_t msgid, msgids[2];
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc, *rpc_gc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+    struct nc_ps_dispatcher *disp;
+    int r, count;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+    disp = nc_ps_dispatcher_new(ps, 1, NULL, NULL);
+    assert_non_null(disp);
+
+    /* client RPCs sent without waiting for replies */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    rpc_gc = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL, 0, 0);
+    assert_non_null(rpc_gc);
+
+    msgtype = nc_send_rpc_async(client_session, rpc, 0, async_reply_clb, &msgids[0], &msgids[0]);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    msgtype = nc_send_rpc_async(client_session, rpc_gc, 0, NULL, NULL, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    msgtype = nc_send_rpc_async(client_session, rpc, 0, async_reply_clb, &msgids[1], &msgids[1]);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    nc_rpc_free(rpc);
+    nc_rpc_free(rpc_gc);
+
+    /* reply without a callback, the other ones are dispatched meanwhile */
+    msgtype = nc_recv_reply_async(client_session, msgid, 1000, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_non_null(envp);
+    assert_non_null(op);
+    assert_string_equal(LYD_NAME(lyd_child(op)), "data");
+    lyd_free_tree(envp);
+    lyd_free_tree(op);
+
+    /* replies with a callback */
+    count = 0;
+    while (msgids[0] || msgids[1]) {
+        r = nc_recv_reply_async_dispatch(client_session, 1000);
+        assert_int_not_equal(r, -1);
+        assert_true(++count < 5);
+    }
+
+    /* no more RPCs */
+    msgtype = nc_recv_reply_async(client_session, msgid, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_ERROR);
+
+    nc_ps_dispatcher_free(disp);
+    nc_ps_free(ps);
+}
+
+static void
+test_send_recv_malformed_10(void **state)
+{
+    int ret;
+    struct nc_pollsession *ps;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op, *node;
+    NC_MSG_TYPE msgtype;
+    const char *msg;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_10;
+    client_session->version = NC_VERSION_10;
+
+    /* write malformed message */
+    msg =
+            "<nc:rpc xmlns:nc=\"urn:ietf:params:xml:ns:netconf:base:1.0\">"
+            "  <nc:commit/>"
+            "</nc:rpc>"
+            "]]>]]>";
+    assert_int_equal(write(client_session->ti.fd.out, msg, strlen(msg)), strlen(msg));
+    rpc = nc_rpc_commit(0, 0, NULL, NULL, 0);
+    assert_non_null(rpc);
+
+    /* server RPC, send reply */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_BAD_RPC);
+
+    /* server finished */
+    nc_ps_free(ps);
+
+    /* client reply */
+    msgtype = nc_recv_reply(client_session, rpc, 0, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY_ERR_MSGID);
+
+    nc_rpc_free(rpc);
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "rpc-error");
+    lyd_find_sibling_opaq_next(lyd_child(lyd_child(envp)), "error-tag", &node);
+    assert_non_null(node);
+    assert_string_equal(((struct lyd_node_opaq *)node)->value, "missing-attribute");
+    lyd_free_tree(envp);
+    assert_null(op);
+}
+
+/* <get> RPC with a message-id of a single digit, written directly to the transport */
+#define FRAMING_RPC(msgid) "<rpc xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\" message-id=\"" msgid "\"><get/></rpc>"
+
+static void *
+write_thread(void *arg)
+{
+    const char *data = arg;
+
+    /* the server is reading the beginning of the message by now */
+    usleep(10000);
+    assert_int_equal(write(client_session->ti.fd.out, data, strlen(data)), strlen(data));
+
+    return NULL;
+}
+
+static void
+test_send_recv_framing(const char *data, const char *rest)
+{
+    int i;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+    pthread_t tid;
+
+    /* 2 whole messages and the beginning of another one in a single write */
+    assert_int_equal(write(client_session->ti.fd.out, data, strlen(data)), strlen(data));
+    assert_int_equal(pthread_create(&tid, NULL, write_thread, (void *)rest), 0);
+
+    /* the messages after the first one are buffered, nothing more is read from the socket for them */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+    for (i = 0; i < 3; ++i) {
+        assert_int_equal(nc_ps_poll(ps, 0, NULL), NC_PSPOLL_RPC);
+    }
+    assert_int_equal(nc_ps_poll(ps, 0, NULL), NC_PSPOLL_TIMEOUT);
+    nc_ps_free(ps);
+    pthread_join(tid, NULL);
+
+    /* all the replies are read by the client at once */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    for (msgid = 1; msgid < 4; ++msgid) {
+        msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+        assert_int_equal(msgtype, NC_MSG_REPLY);
+        assert_null(op);
+        assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+        lyd_free_tree(envp);
+    }
+    nc_rpc_free(rpc);
+}
+
+static void
+test_send_recv_framing_10(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_10;
+    client_session->version = NC_VERSION_10;
+
+    /* the end tag of the last message split */
+    test_send_recv_framing(FRAMING_RPC("1") "]]>]]>" FRAMING_RPC("2") "]]>]]>" FRAMING_RPC("3") "]]>]", "]>]]>");
+}
+
+static void
+test_send_recv_framing_11(void **state)
+{
+    char data[1024], rest[256];
+    int len;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    /* the chunk size of the last message split */
+    len = strlen(FRAMING_RPC("1"));
+    sprintf(data, "\n#%d\n%s\n##\n\n#%d\n%s\n##\n\n#%d", len, FRAMING_RPC("1"), len, FRAMING_RPC("2"), len / 10);
+    sprintf(rest, "%d\n%s\n##\n", len % 10, FRAMING_RPC("3"));
+    test_send_recv_framing(data, rest);
+}
+
+/* whitespace in a large chunked message, more than fits into the receive buffer */
+#define CHUNKED_PAD_LEN (300 * 1024)
+
+static void
+test_send_recv_chunked_11(void **state)
+{
+    const char *start = "<rpc xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\" message-id=\"1\">";
+    const char *end = "<get/></rpc>";
+    const size_t chunk_sizes[] = {1, 1000, 100000};
+    char *msg, *data;
+    size_t msg_len, len, size, i;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+    pthread_t tid;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    /* message with a lot of whitespace */
+    msg_len = strlen(start) + CHUNKED_PAD_LEN + strlen(end);
+    msg = malloc(msg_len + 1);
+    assert_non_null(msg);
+    strcpy(msg, start);
+    memset(msg + strlen(start), ' ', CHUNKED_PAD_LEN);
+    strcpy(msg + strlen(start) + CHUNKED_PAD_LEN, end);
+
+    /* split into chunks of very different sizes */
+    data = malloc(msg_len * 2);
+    assert_non_null(data);
+    len = 0;
+    for (i = 0, size = 0; size < msg_len; size += chunk_sizes[i % 3], ++i) {
+        if (size + chunk_sizes[i % 3] > msg_len) {
+            len += sprintf(data + len, "\n#%zu\n", msg_len - size);
+            memcpy(data + len, msg + size, msg_len - size);
+            len += msg_len - size;
+        } else {
+            len += sprintf(data + len, "\n#%zu\n", chunk_sizes[i % 3]);
+            memcpy(data + len, msg + size, chunk_sizes[i % 3]);
+            len += chunk_sizes[i % 3];
+        }
+    }
+    strcpy(data + len, "\n##\n");
+    free(msg);
+
+    /* does not fit into the socket buffer */
+    assert_int_equal(pthread_create(&tid, NULL, write_thread, data), 0);
+
+    /* the message is assembled from all the chunks */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+    assert_int_equal(nc_ps_poll(ps, 1000, NULL), NC_PSPOLL_RPC);
+    nc_ps_free(ps);
+    pthread_join(tid, NULL);
+    free(data);
+
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_recv_reply(client_session, rpc, 1, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_null(op);
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+    lyd_free_tree(envp);
+    nc_rpc_free(rpc);
+}
+
+/* NACM groups in a large reply, each with a long name, more than fits into the output and socket buffers */
+#define LARGE_GROUP_COUNT 2000
+
+static int
+large_data_clb(struct nc_session *session, void *user_data, struct lyd_node **data)
+{
+    int *group = user_data;
+    char path[256];
+
+    if (*group == LARGE_GROUP_COUNT) {
+        /* no more data */
+        *data = NULL;
+        return 0;
+    }
+
+    sprintf(path, "/ietf-netconf-acm:nacm/groups/group[name='group%0200d']", (*group)++);
+    assert_int_equal(lyd_new_path(NULL, session->ctx, path, NULL, 0, data), LY_SUCCESS);
+    return 0;
+}
+
+struct nc_server_reply *
+my_getconfig_large_rpc_clb(struct lyd_node *rpc, struct nc_session *session)
+{
+    const struct lysc_node *anydata;
+
+    (void)rpc;
+
+    anydata = lys_find_path(session->ctx, NULL, "/ietf-netconf:get-config/data", 1);
+    assert_non_null(anydata);
+
+    return nc_server_reply_data_stream(anydata, large_data_clb, &glob_state, NULL, NC_WD_EXPLICIT);
+}
+
+static void
+test_send_recv_large_11(void **state)
+{
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+    struct lysc_node *node;
+    struct nc_session_stats server_stats, client_stats;
+    char *str, name[256];
+    pthread_t tid;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    node = (struct lysc_node *)lys_find_path(ctx, NULL, "/ietf-netconf:get-config", 0);
+    assert_non_null(node);
+    node->priv = my_getconfig_large_rpc_clb;
+    glob_state = 0;
+
+    rpc = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* the server waits for the client to read the reply */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+    assert_int_equal(pthread_create(&tid, NULL, ps_poll_thread, ps), 0);
+
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 5000, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    pthread_join(tid, NULL);
+    nc_ps_free(ps);
+    assert_int_equal(glob_state, LARGE_GROUP_COUNT);
+
+    /* whole reply received */
+    assert_int_equal(nc_session_get_stats(server_session, &server_stats), 0);
+    assert_int_equal(nc_session_get_stats(client_session, &client_stats), 0);
+    assert_true(server_stats.out_bytes > LARGE_GROUP_COUNT * 200);
+    assert_int_equal(server_stats.out_bytes, client_stats.in_bytes);
+
+    assert_non_null(op);
+    assert_int_equal(lyd_print_mem(&str, op, LYD_XML, LYD_PRINT_WITHSIBLINGS), LY_SUCCESS);
+    sprintf(name, "group%0200d", LARGE_GROUP_COUNT - 1);
+    assert_non_null(strstr(str, name));
+    free(str);
+
+    lyd_free_tree(envp);
+    lyd_free_tree(op);
+    nc_rpc_free(rpc);
+    node->priv = my_getconfig_rpc_clb;
+}
+
+/* sessions in a pollsession group, enough for its shards to become unbalanced */
+#define GROUP_SESSION_COUNT (2 * NC_PS_GROUP_SKEW + 4)
+
+/**
+ * @brief Send a \<get\> RPC on a client session and check it is received only by one shard of a pollsession group.
+ */
+static void
+test_ps_group_rpc(struct nc_ps_group *group, uint16_t shard_idx, struct nc_session *server, struct nc_session *client)
+{
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_session *session;
+
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(client, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    assert_int_equal(nc_ps_poll(nc_ps_group_get_shard(group, !shard_idx), 0, NULL), NC_PSPOLL_TIMEOUT);
+    assert_int_equal(nc_ps_poll(nc_ps_group_get_shard(group, shard_idx), 0, &session), NC_PSPOLL_RPC);
+    assert_ptr_equal(session, server);
+
+    msgtype = nc_recv_reply(client, rpc, msgid, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_null(op);
+    lyd_free_tree(envp);
+    nc_rpc_free(rpc);
+}
+
+/**
+ * @brief Get the index of the shard of a pollsession group with a session, -1 if not found.
+ */
+static int
+test_ps_group_shard_idx(struct nc_ps_group *group, struct nc_session *session)
+{
+    struct nc_pollsession *shard;
+    uint16_t i, j;
+
+    for (i = 0; i < nc_ps_group_shard_count(group); ++i) {
+        shard = nc_ps_group_get_shard(group, i);
+        for (j = 0; j < nc_ps_session_count(shard); ++j) {
+            if (nc_ps_get_session(shard, j) == session) {
+                return i;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static void
+test_ps_group(void **state)
+{
+    struct nc_ps_group *group;
+    struct nc_session *servers[GROUP_SESSION_COUNT], *clients[GROUP_SESSION_COUNT];
+    struct nc_session *busy = NULL, *moved = NULL, *deleted = NULL;
+    int i, del_count;
+
+    (void)state;
+
+    group = nc_ps_group_new(2);
+    assert_non_null(group);
+    assert_int_equal(nc_ps_group_shard_count(group), 2);
+    assert_null(nc_ps_group_get_shard(group, 2));
+
+    /* sessions distributed based on their ID */
+    for (i = 0; i < GROUP_SESSION_COUNT; ++i) {
+        assert_int_equal(nc_accept_mem("test", ctx, &servers[i], &clients[i]), NC_MSG_HELLO);
+        assert_int_equal(nc_ps_group_add_session(group, servers[i]), 0);
+        assert_int_equal(test_ps_group_shard_idx(group, servers[i]), servers[i]->id % 2);
+    }
+    assert_int_equal(nc_ps_session_count(nc_ps_group_get_shard(group, 0)), GROUP_SESSION_COUNT / 2);
+    assert_int_equal(nc_ps_session_count(nc_ps_group_get_shard(group, 1)), GROUP_SESSION_COUNT / 2);
+
+    /* an RPC is received only by the shard with the session */
+    test_ps_group_rpc(group, servers[0]->id % 2, servers[0], clients[0]);
+    test_ps_group_rpc(group, servers[1]->id % 2, servers[1], clients[1]);
+
+    /* a session being worked with in the other shard */
+    for (i = 0; i < GROUP_SESSION_COUNT; ++i) {
+        if (servers[i]->id % 2) {
+            busy = servers[i];
+            break;
+        }
+    }
+    assert_int_equal(nc_session_rpc_lock(busy, 0, __func__), 1);
+
+    /* removing sessions from one shard until it is rebalanced */
+    del_count = 0;
+    for (i = 0; i < GROUP_SESSION_COUNT; ++i) {
+        if (!(servers[i]->id % 2) && (del_count < NC_PS_GROUP_SKEW + 1)) {
+            assert_int_equal(nc_ps_group_del_session(group, servers[i]), 0);
+            assert_int_equal(test_ps_group_shard_idx(group, servers[i]), -1);
+            deleted = servers[i];
+            ++del_count;
+        }
+    }
+    assert_int_equal(nc_ps_group_del_session(group, deleted), -1);
+    assert_int_equal(nc_ps_session_count(nc_ps_group_get_shard(group, 0)), GROUP_SESSION_COUNT / 4);
+    assert_int_equal(nc_ps_session_count(nc_ps_group_get_shard(group, 1)), GROUP_SESSION_COUNT / 4 + 1);
+
+    /* the busy session was not moved, it is not being polled */
+    assert_int_equal(test_ps_group_shard_idx(group, busy), 1);
+    assert_int_equal(nc_session_rpc_unlock(busy, NC_SESSION_LOCK_TIMEOUT, __func__), 1);
+    assert_int_equal(nc_ps_group_rebalance(group), 0);
+
+    /* a moved session is polled by its new shard */
+    for (i = 0; i < GROUP_SESSION_COUNT; ++i) {
+        if ((servers[i]->id % 2) && (test_ps_group_shard_idx(group, servers[i]) == 0)) {
+            moved = servers[i];
+            break;
+        }
+    }
+    assert_non_null(moved);
+    test_ps_group_rpc(group, 0, moved, clients[i]);
+
+    nc_ps_group_free(group);
+    for (i = 0; i < GROUP_SESSION_COUNT; ++i) {
+        nc_session_free(servers[i], NULL);
+        nc_session_free(clients[i], NULL);
+    }
+}
+
+int
+main(void)
+{
+    int ret;
+    const struct lys_module *module;
+    struct lysc_node *node;
+    const char *nc_features[] = {"candidate", NULL};
+
+    pthread_barrier_init(&barrier, NULL, 2);
+
+    /* create ctx */
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
+    assert_non_null(ctx);
+
+    /* load modules */
+    module = ly_ctx_load_module(ctx, "ietf-netconf-acm", NULL, NULL);
+    assert_non_null(module);
+
+    module = ly_ctx_load_module(ctx, "ietf-netconf", NULL, nc_features);
+    assert_non_null(module);
+
+    module = ly_ctx_load_module(ctx, "nc-notifications", NULL, NULL);
+    assert_non_null(module);
+
+    module = ly_ctx_load_module(ctx, "module-act", NULL, NULL);
     assert_non_null(module);
 
     /* set RPC callbacks */
@@ -588,11 +2269,45 @@ main(void)
         cmocka_unit_test_setup_teardown(test_send_recv_error_10, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_data_10, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_notif_10, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_notif_broadcast_10, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_malformed_10, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_framing_10, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_ok_11, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_error_11, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_data_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_data_stream_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_framing_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_chunked_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_large_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_prepared_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_latency_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_rpc_clb_replace_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_envelope_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_print_async_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_print_session_rate, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_ps_busy_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_batch_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_batch_11, setup_mem_sessions, teardown_mem_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_notif_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_notif_broadcast_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_notif_queue_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_notif_queue_blocking_11, setup_sessions, teardown_sessions),
+#ifdef HAVE_EPOLL
+        cmocka_unit_test_setup_teardown(test_send_recv_notif_reactor_11, setup_sessions, teardown_sessions),
+#endif
+#ifdef HAVE_IO_URING
+        cmocka_unit_test_setup_teardown(test_send_recv_uring_11, setup_sessions, teardown_sessions),
+#endif
+        cmocka_unit_test_setup_teardown(test_send_recv_dispatch_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_async_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_ok_11, setup_mem_sessions, teardown_mem_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_error_11, setup_mem_sessions, teardown_mem_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_data_11, setup_mem_sessions, teardown_mem_sessions),
+        cmocka_unit_test_setup_teardown(test_send_prepared_dump_11, setup_mem_sessions, teardown_mem_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_notif_11, setup_mem_sessions, teardown_mem_sessions),
+        cmocka_unit_test_setup_teardown(test_idle_timeout_11, setup_mem_sessions, teardown_mem_sessions),
+        cmocka_unit_test(test_mem_hello_11),
+        cmocka_unit_test(test_ps_group),
     };
 
     ret = cmocka_run_group_tests(comm, NULL, NULL);
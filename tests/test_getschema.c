@@ -0,0 +1,447 @@
+/**
+ * \file test_getschema.c
+ * \brief libnetconf2 tests - client context filled with modules retrieved via get-schema
+ *
+ * Copyright (c) 2015 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <dirent.h>
+#include <poll.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+#include <libyang/libyang.h>
+
+#include <messages_p.h>
+#include <session_client.h>
+#include <session_p.h>
+#include <session_server.h>
+#include "tests/config.h"
+
+#define TEST_SOCK BUILD_DIR "/test_getschema.sock"
+#define TEST_CACHE_DIR BUILD_DIR "/test_getschema_cache"
+
+/* content-id of the server YANG library and how it is encoded in the schema cache file names */
+#define TEST_CONTENT_ID "../id/1 2"
+#define TEST_CONTENT_ID_ENC "%2E%2E%2Fid%2F1%202"
+
+extern struct nc_server_opts server_opts;
+
+struct ly_ctx *ctx;
+struct ly_ctx *schema_ctx;
+ATOMIC_T getschema_count;
+ATOMIC_T getschema_pipelined;
+
+static struct nc_server_reply *
+getschema_clb(struct lyd_node *rpc, struct nc_session *session)
+{
+    struct pollfd pfd = {.fd = session->ti.unixsock.sock, .events = POLLIN};
+
+    ATOMIC_INC_RELAXED(getschema_count);
+
+    /* the next RPC can arrive before this reply only if the client does not wait for it */
+    if (session->rbuf_len || (poll(&pfd, 1, 100) == 1)) {
+        ATOMIC_STORE_RELAXED(getschema_pipelined, 1);
+    }
+
+    return nc_clb_default_get_schema(rpc, session);
+}
+
+static void *
+server_thread(void *arg)
+{
+    struct nc_pollsession *ps;
+    struct nc_session *session;
+    int ret;
+
+    (void)arg;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    assert_int_equal(nc_accept(2000, ctx, &session), NC_MSG_HELLO);
+    assert_int_equal(nc_ps_add_session(ps, session), 0);
+
+    /* until the client closes the session */
+    do {
+        ret = nc_ps_poll(ps, 1000, NULL);
+        assert_false(ret & NC_PSPOLL_ERROR);
+    } while (!(ret & NC_PSPOLL_SESSION_TERM));
+
+    nc_ps_clear(ps, 1, NULL);
+    nc_ps_free(ps);
+    return NULL;
+}
+
+static void
+test_getschema_pipelined(void **state)
+{
+    struct nc_session *session;
+    pthread_t tid;
+
+    (void)state;
+
+    assert_int_equal(pthread_create(&tid, NULL, server_thread, NULL), 0);
+
+    /* new client context filled with the server modules */
+    session = nc_connect_unix(TEST_SOCK, NULL);
+    assert_non_null(session);
+    assert_non_null(ly_ctx_get_module_implemented(nc_session_get_ctx(session), "nc-notifications"));
+    assert_non_null(ly_ctx_get_module_implemented(nc_session_get_ctx(session), "ietf-netconf-with-defaults"));
+
+    /* the modules were retrieved by several <get-schema> RPCs sent at once */
+    assert_true(ATOMIC_LOAD_RELAXED(getschema_count) > 1);
+    assert_true(ATOMIC_LOAD_RELAXED(getschema_pipelined));
+
+    nc_session_free(session, NULL);
+    pthread_join(tid, NULL);
+}
+
+static char *
+content_id_clb(void *user_data)
+{
+    (void)user_data;
+
+    return strdup(TEST_CONTENT_ID);
+}
+
+/**
+ * @brief Connect a new client session with a new context, filled via get-schema.
+ */
+static void
+test_connect(void)
+{
+    struct nc_session *session;
+    pthread_t tid;
+
+    assert_int_equal(pthread_create(&tid, NULL, server_thread, NULL), 0);
+
+    session = nc_connect_unix(TEST_SOCK, NULL);
+    assert_non_null(session);
+    assert_non_null(ly_ctx_get_module_implemented(nc_session_get_ctx(session), "module-a"));
+    assert_non_null(ly_ctx_get_module_implemented(nc_session_get_ctx(session), "module..c"));
+
+    nc_session_free(session, NULL);
+    pthread_join(tid, NULL);
+}
+
+/**
+ * @brief Remove all the files from the schema cache directory.
+ */
+static void
+test_cache_dir_clear(void)
+{
+    DIR *dir;
+    struct dirent *ent;
+    char path[512];
+
+    dir = opendir(TEST_CACHE_DIR);
+    if (!dir) {
+        return;
+    }
+    while ((ent = readdir(dir))) {
+        if (ent->d_name[0] == '.') {
+            continue;
+        }
+        snprintf(path, sizeof path, "%s/%s", TEST_CACHE_DIR, ent->d_name);
+        unlink(path);
+    }
+    closedir(dir);
+}
+
+static void
+test_getschema_cache_dir(void **state)
+{
+    (void)state;
+
+    mkdir(TEST_CACHE_DIR, 0700);
+    test_cache_dir_clear();
+    assert_int_equal(nc_client_set_schema_cache_dir(TEST_CACHE_DIR), 0);
+
+    /* modules without a revision */
+    assert_non_null(ly_ctx_load_module(ctx, "module-a", NULL, NULL));
+    assert_non_null(ly_ctx_load_module(ctx, "module..c", NULL, NULL));
+    nc_server_set_content_id_clb(content_id_clb, NULL, NULL);
+
+    /* all the modules retrieved and stored */
+    ATOMIC_STORE_RELAXED(getschema_count, 0);
+    test_connect();
+    assert_true(ATOMIC_LOAD_RELAXED(getschema_count) > 2);
+
+    /* with a revision, or with the whole content-id encoded */
+    assert_int_equal(access(TEST_CACHE_DIR "/ietf-netconf-with-defaults@2011-06-01.yang", R_OK), 0);
+    assert_int_equal(access(TEST_CACHE_DIR "/module-a#" TEST_CONTENT_ID_ENC ".yang", R_OK), 0);
+
+    /* name not safe to be used in a file name */
+    assert_int_equal(access(TEST_CACHE_DIR "/module..c#" TEST_CONTENT_ID_ENC ".yang", F_OK), -1);
+
+    /* the cached modules used, only the module not cached retrieved again */
+    ATOMIC_STORE_RELAXED(getschema_count, 0);
+    test_connect();
+    assert_int_equal(ATOMIC_LOAD_RELAXED(getschema_count), 1);
+
+    nc_server_set_content_id_clb(NULL, NULL, NULL);
+    nc_client_set_schema_cache_dir(NULL);
+    test_cache_dir_clear();
+    rmdir(TEST_CACHE_DIR);
+}
+
+static int
+setup_schema_ctx(void **state)
+{
+    (void)state;
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &schema_ctx);
+    assert_non_null(schema_ctx);
+    assert_non_null(ly_ctx_load_module(schema_ctx, "ietf-netconf-monitoring", NULL, NULL));
+    assert_non_null(ly_ctx_load_module(schema_ctx, "module-b", NULL, NULL));
+
+    return 0;
+}
+
+static int
+teardown_schema_ctx(void **state)
+{
+    (void)state;
+
+    nc_server_ctx_release(schema_ctx);
+    ly_ctx_destroy(schema_ctx);
+    schema_ctx = NULL;
+
+    return 0;
+}
+
+/**
+ * @brief Print a module or a submodule the same way the default \<get-schema\> callback should.
+ */
+static char *
+test_print(const char *identifier, LYS_OUTFORMAT format)
+{
+    const struct lys_module *module;
+    const struct lysp_submodule *submodule = NULL;
+    struct ly_out *out;
+    char *data = NULL;
+
+    module = ly_ctx_get_module_implemented(schema_ctx, identifier);
+    if (!module) {
+        submodule = ly_ctx_get_submodule_latest(schema_ctx, identifier);
+        assert_non_null(submodule);
+    }
+
+    assert_int_equal(ly_out_new_memory(&data, 0, &out), LY_SUCCESS);
+    if (module) {
+        assert_int_equal(lys_print_module(out, module, format, 0, 0), LY_SUCCESS);
+    } else {
+        assert_int_equal(lys_print_submodule(out, submodule, format, 0, 0), LY_SUCCESS);
+    }
+    ly_out_free(out, NULL, 0);
+    assert_non_null(data);
+
+    return data;
+}
+
+/**
+ * @brief Get a (sub)module by the default \<get-schema\> callback.
+ */
+static char *
+test_get_schema(const char *identifier, const char *format)
+{
+    struct nc_session session = {0};
+    struct lyd_node *rpc, *node;
+    struct nc_server_reply *reply;
+    char *data;
+
+    session.side = NC_SERVER;
+    session.ctx = schema_ctx;
+
+    assert_int_equal(lyd_new_path(NULL, schema_ctx, "/ietf-netconf-monitoring:get-schema/identifier", identifier, 0,
+            &rpc), LY_SUCCESS);
+    assert_int_equal(lyd_new_path(rpc, schema_ctx, "/ietf-netconf-monitoring:get-schema/format", format, 0, NULL),
+            LY_SUCCESS);
+
+    reply = nc_clb_default_get_schema(rpc, &session);
+    assert_non_null(reply);
+    assert_int_equal(reply->type, NC_RPL_DATA);
+
+    node = lyd_child(((struct nc_server_reply_data *)reply)->data);
+    assert_non_null(node);
+    assert_string_equal(node->schema->name, "data");
+    assert_int_equal(((struct lyd_node_any *)node)->value_type, LYD_ANYDATA_STRING);
+    data = strdup(((struct lyd_node_any *)node)->value.str);
+    assert_non_null(data);
+
+    nc_server_reply_free(reply);
+    lyd_free_tree(rpc);
+    return data;
+}
+
+/**
+ * @brief Check a (sub)module got by the default \<get-schema\> callback.
+ */
+static void
+test_get_schema_check(const char *identifier, LYS_OUTFORMAT format)
+{
+    char *printed, *data;
+
+    printed = test_print(identifier, format);
+    data = test_get_schema(identifier, (format == LYS_OUT_YIN) ? "yin" : "yang");
+    assert_string_equal(data, printed);
+    free(data);
+    free(printed);
+}
+
+static uint32_t
+test_schema_cache_count(void)
+{
+    uint32_t count;
+
+    pthread_mutex_lock(&server_opts.schema_cache.lock);
+    count = server_opts.schema_cache.count;
+    pthread_mutex_unlock(&server_opts.schema_cache.lock);
+
+    return count;
+}
+
+static void
+test_getschema_cache(void **state)
+{
+    (void)state;
+
+    /* printed and cached */
+    test_get_schema_check("ietf-netconf-monitoring", LYS_OUT_YANG);
+    test_get_schema_check("ietf-netconf-monitoring", LYS_OUT_YIN);
+    test_get_schema_check("module-b", LYS_OUT_YANG);
+    test_get_schema_check("module-b", LYS_OUT_YIN);
+    test_get_schema_check("module-b-sub", LYS_OUT_YANG);
+    test_get_schema_check("module-b-sub", LYS_OUT_YIN);
+    assert_ptr_equal(server_opts.schema_cache.ctx, schema_ctx);
+    assert_int_equal(test_schema_cache_count(), 6);
+
+    /* the same data from the cache */
+    test_get_schema_check("ietf-netconf-monitoring", LYS_OUT_YANG);
+    test_get_schema_check("ietf-netconf-monitoring", LYS_OUT_YIN);
+    test_get_schema_check("module-b", LYS_OUT_YANG);
+    test_get_schema_check("module-b", LYS_OUT_YIN);
+    test_get_schema_check("module-b-sub", LYS_OUT_YANG);
+    test_get_schema_check("module-b-sub", LYS_OUT_YIN);
+    assert_int_equal(test_schema_cache_count(), 6);
+}
+
+static void
+test_getschema_cache_mem(void **state)
+{
+    char *printed;
+    size_t mem;
+
+    (void)state;
+
+    /* cache almost full */
+    test_get_schema_check("module-b", LYS_OUT_YANG);
+    assert_int_equal(test_schema_cache_count(), 1);
+    pthread_mutex_lock(&server_opts.schema_cache.lock);
+    mem = server_opts.schema_cache.mem;
+    server_opts.schema_cache.mem = NC_SERVER_SCHEMA_CACHE_MAX_MEM - 1;
+    pthread_mutex_unlock(&server_opts.schema_cache.lock);
+
+    /* printed every time, but not cached */
+    test_get_schema_check("module-b-sub", LYS_OUT_YANG);
+    test_get_schema_check("module-b-sub", LYS_OUT_YANG);
+    assert_int_equal(test_schema_cache_count(), 1);
+    assert_int_equal(server_opts.schema_cache.mem, NC_SERVER_SCHEMA_CACHE_MAX_MEM - 1);
+
+    /* cached (sub)modules still returned */
+    test_get_schema_check("module-b", LYS_OUT_YANG);
+
+    pthread_mutex_lock(&server_opts.schema_cache.lock);
+    server_opts.schema_cache.mem = mem;
+    pthread_mutex_unlock(&server_opts.schema_cache.lock);
+
+    /* the memory of exactly the cached data is counted */
+    test_get_schema_check("module-b-sub", LYS_OUT_YANG);
+    assert_int_equal(test_schema_cache_count(), 2);
+    printed = test_print("module-b-sub", LYS_OUT_YANG);
+    assert_int_equal(server_opts.schema_cache.mem, mem + strlen(printed) + 1);
+    free(printed);
+}
+
+static void
+test_getschema_cache_ctx_change(void **state)
+{
+    (void)state;
+
+    test_get_schema_check("module-b", LYS_OUT_YANG);
+    test_get_schema_check("module-b-sub", LYS_OUT_YANG);
+    assert_int_equal(test_schema_cache_count(), 2);
+
+    /* context changed, cached data dropped */
+    assert_non_null(ly_ctx_load_module(schema_ctx, "module-a", NULL, NULL));
+    test_get_schema_check("module-b", LYS_OUT_YANG);
+    assert_int_equal(test_schema_cache_count(), 1);
+    assert_int_equal(server_opts.schema_cache.change_count, ly_ctx_get_change_count(schema_ctx));
+
+    /* another context released, cached data kept */
+    nc_server_ctx_release(ctx);
+    assert_int_equal(test_schema_cache_count(), 1);
+
+    /* context released */
+    nc_server_ctx_release(schema_ctx);
+    assert_int_equal(test_schema_cache_count(), 0);
+    assert_null(server_opts.schema_cache.ctx);
+}
+
+int
+main(void)
+{
+    int ret;
+    struct lysc_node *node;
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
+    assert_non_null(ctx);
+    assert_non_null(ly_ctx_load_module(ctx, "ietf-netconf", NULL, NULL));
+    assert_non_null(ly_ctx_load_module(ctx, "ietf-netconf-monitoring", NULL, NULL));
+    assert_non_null(ly_ctx_load_module(ctx, "ietf-netconf-with-defaults", NULL, NULL));
+    assert_non_null(ly_ctx_load_module(ctx, "nc-notifications", NULL, NULL));
+
+    /* counts the RPCs, otherwise the default callback */
+    node = (struct lysc_node *)lys_find_path(ctx, NULL, "/ietf-netconf-monitoring:get-schema", 0);
+    assert_non_null(node);
+    node->priv = getschema_clb;
+
+    nc_server_init();
+
+    unlink(TEST_SOCK);
+    assert_int_equal(nc_server_add_endpt("unix", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_endpt_set_address("unix", TEST_SOCK), 0);
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_getschema_pipelined),
+        cmocka_unit_test(test_getschema_cache_dir),
+        cmocka_unit_test_setup_teardown(test_getschema_cache, setup_schema_ctx, teardown_schema_ctx),
+        cmocka_unit_test_setup_teardown(test_getschema_cache_mem, setup_schema_ctx, teardown_schema_ctx),
+        cmocka_unit_test_setup_teardown(test_getschema_cache_ctx_change, setup_schema_ctx, teardown_schema_ctx),
+    };
+
+    ret = cmocka_run_group_tests(tests, NULL, NULL);
+
+    assert_int_equal(nc_server_del_endpt(NULL, 0), 0);
+    unlink(TEST_SOCK);
+    nc_client_destroy();
+    nc_server_destroy();
+    ly_ctx_destroy(ctx);
+
+    return ret;
+}
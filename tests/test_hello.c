@@ -0,0 +1,232 @@
+/**
+ * \file test_hello.c
+ * \brief libnetconf2 tests - server capabilities cached for the \<hello\> messages
+ *
+ * Copyright (c) 2015 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+#include <libyang/libyang.h>
+
+#include <session_client.h>
+#include <session_p.h>
+#include <session_server.h>
+#include "tests/config.h"
+
+#define TEST_SOCK BUILD_DIR "/test_hello.sock"
+
+#define CPBLT_TEST "urn:test:capability:1.0"
+#define CPBLT_MODULE_A "urn:jmu:params:xml:ns:yang:module-a?module=module-a"
+#define CPBLT_YANG_LIBRARY "urn:ietf:params:netconf:capability:yang-library:1.1"
+
+extern struct nc_server_opts server_opts;
+
+struct ly_ctx *ctx;
+struct ly_ctx *client_ctx;
+const char *content_id;
+
+static char *
+content_id_clb(void *user_data)
+{
+    (void)user_data;
+
+    return strdup(content_id);
+}
+
+static void *
+server_thread(void *arg)
+{
+    struct nc_session **session = arg;
+    NC_MSG_TYPE msgtype;
+
+    msgtype = nc_accept(2000, ctx, session);
+    assert_int_equal(msgtype, NC_MSG_HELLO);
+
+    return NULL;
+}
+
+/**
+ * @brief Connect a new client session and look for a capability in the server \<hello\>.
+ *
+ * @param[in] capab Capability to look for, capability with any additional suffix matches.
+ * @return Copy of the matching capability, NULL if not found.
+ */
+static char *
+test_hello_cpblt(const char *capab)
+{
+    struct nc_session *server_session = NULL, *client_session;
+    pthread_t server_tid;
+    const char *cpblt;
+    char *ret = NULL;
+
+    assert_int_equal(pthread_create(&server_tid, NULL, server_thread, &server_session), 0);
+    client_session = nc_connect_unix(TEST_SOCK, client_ctx);
+    assert_non_null(client_session);
+    pthread_join(server_tid, NULL);
+    assert_non_null(server_session);
+
+    cpblt = nc_session_cpblt(client_session, capab);
+    if (cpblt) {
+        ret = strdup(cpblt);
+        assert_non_null(ret);
+    }
+
+    nc_session_free(client_session, NULL);
+    nc_session_free(server_session, NULL);
+    return ret;
+}
+
+/**
+ * @brief Check whether a capability is in the server \<hello\>.
+ */
+static int
+test_hello_has(const char *capab)
+{
+    char *cpblt;
+    int found;
+
+    cpblt = test_hello_cpblt(capab);
+    found = cpblt ? 1 : 0;
+    free(cpblt);
+    return found;
+}
+
+static void
+test_hello_capability(void **state)
+{
+    (void)state;
+
+    assert_false(test_hello_has(CPBLT_TEST));
+
+    /* added capability is in the next hello */
+    assert_int_equal(nc_server_set_capability(CPBLT_TEST), 0);
+    assert_null(server_opts.cpblts_cache);
+    assert_true(test_hello_has(CPBLT_TEST));
+    assert_non_null(server_opts.cpblts_cache);
+
+    /* with-defaults capability parameters */
+    assert_int_equal(nc_server_set_capab_withdefaults(NC_WD_TRIM, NC_WD_EXPLICIT), 0);
+    assert_null(server_opts.cpblts_cache);
+    assert_true(test_hello_has("urn:ietf:params:netconf:capability:with-defaults:1.0?basic-mode=trim"));
+    assert_int_equal(nc_server_set_capab_withdefaults(NC_WD_EXPLICIT, NC_WD_TRIM), 0);
+    assert_true(test_hello_has("urn:ietf:params:netconf:capability:with-defaults:1.0?basic-mode=explicit"));
+}
+
+static void
+test_hello_content_id(void **state)
+{
+    char *cpblt;
+
+    (void)state;
+
+    content_id = "first";
+    nc_server_set_content_id_clb(content_id_clb, NULL, NULL);
+    cpblt = test_hello_cpblt(CPBLT_YANG_LIBRARY);
+    assert_non_null(cpblt);
+    assert_non_null(strstr(cpblt, "content-id=first"));
+    free(cpblt);
+
+    /* the callback is called for every session, its new value is not cached */
+    content_id = "second";
+    cpblt = test_hello_cpblt(CPBLT_YANG_LIBRARY);
+    assert_non_null(cpblt);
+    assert_non_null(strstr(cpblt, "content-id=second"));
+    free(cpblt);
+
+    nc_server_set_content_id_clb(NULL, NULL, NULL);
+}
+
+static void
+test_hello_ctx_change(void **state)
+{
+    (void)state;
+
+    assert_false(test_hello_has(CPBLT_MODULE_A));
+
+    /* module loaded into the same context */
+    assert_non_null(ly_ctx_load_module(ctx, "module-a", NULL, NULL));
+    assert_true(test_hello_has(CPBLT_MODULE_A));
+}
+
+static void
+test_hello_ctx_release(void **state)
+{
+    struct ly_ctx *other_ctx;
+
+    (void)state;
+
+    assert_true(test_hello_has(CPBLT_MODULE_A));
+    assert_ptr_equal(server_opts.cpblts_cache->ctx, ctx);
+
+    /* another context does not drop the cached capabilities */
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &other_ctx);
+    assert_non_null(other_ctx);
+    nc_server_ctx_release(other_ctx);
+    assert_non_null(server_opts.cpblts_cache);
+    ly_ctx_destroy(other_ctx);
+
+    /* context released and created again, possibly at the same address */
+    nc_server_ctx_release(ctx);
+    assert_null(server_opts.cpblts_cache);
+    ly_ctx_destroy(ctx);
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
+    assert_non_null(ctx);
+    assert_non_null(ly_ctx_load_module(ctx, "ietf-netconf", NULL, NULL));
+    assert_false(test_hello_has(CPBLT_MODULE_A));
+}
+
+int
+main(void)
+{
+    int ret;
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
+    assert_non_null(ctx);
+    assert_non_null(ly_ctx_load_module(ctx, "ietf-netconf", NULL, NULL));
+    assert_non_null(ly_ctx_load_module(ctx, "ietf-netconf-with-defaults", NULL, NULL));
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &client_ctx);
+    assert_non_null(client_ctx);
+    assert_non_null(ly_ctx_load_module(client_ctx, "ietf-netconf", NULL, NULL));
+
+    nc_server_init();
+
+    unlink(TEST_SOCK);
+    assert_int_equal(nc_server_add_endpt("unix", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_endpt_set_address("unix", TEST_SOCK), 0);
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_hello_capability),
+        cmocka_unit_test(test_hello_content_id),
+        cmocka_unit_test(test_hello_ctx_change),
+        cmocka_unit_test(test_hello_ctx_release),
+    };
+
+    ret = cmocka_run_group_tests(tests, NULL, NULL);
+
+    assert_int_equal(nc_server_del_endpt(NULL, 0), 0);
+    unlink(TEST_SOCK);
+    nc_client_destroy();
+    nc_server_ctx_release(ctx);
+    nc_server_destroy();
+    ly_ctx_destroy(client_ctx);
+    ly_ctx_destroy(ctx);
+
+    return ret;
+}
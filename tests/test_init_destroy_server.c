@@ -24,14 +24,19 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 #include <cmocka.h>
 #include <libyang/libyang.h>
 
+#include <session_p.h>
 #include <session_server.h>
+#include <session_server_ch.h>
 #include "tests/config.h"
 
+extern struct nc_server_opts server_opts;
+
 static int
 setup_server(void **state)
 {
@@ -58,11 +63,336 @@ test_dummy(void **state)
     (void)state;
 }
 
+static void
+test_config_batch(void **state)
+{
+    const char *path = BUILD_DIR "/test_config_batch.sock";
+
+    (void)state;
+
+    unlink(path);
+
+    /* no batch started */
+    assert_int_equal(nc_server_config_commit(), -1);
+
+    assert_int_equal(nc_server_config_begin(), 0);
+    assert_int_equal(nc_server_config_begin(), -1);
+
+    assert_int_equal(nc_server_add_endpt("batch", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_is_endpt("batch"), 1);
+    assert_int_equal(nc_server_endpt_set_perms("batch", 0600, -1, -1), 0);
+    assert_int_equal(nc_server_endpt_set_address("batch", path), 0);
+
+    /* the listening socket is created only on commit */
+    assert_int_equal(access(path, F_OK), -1);
+    assert_int_equal(nc_server_config_commit(), 0);
+    assert_int_equal(access(path, F_OK), 0);
+
+    assert_int_equal(nc_server_del_endpt("batch", 0), 0);
+    unlink(path);
+}
+
+static void *
+is_endpt_thread(void *arg)
+{
+    return (void *)(intptr_t)nc_server_is_endpt(arg);
+}
+
+static int
+is_endpt_other_thread(const char *name)
+{
+    pthread_t tid;
+    void *found;
+
+    assert_int_equal(pthread_create(&tid, NULL, is_endpt_thread, (void *)name), 0);
+    assert_int_equal(pthread_join(tid, &found), 0);
+    return (intptr_t)found;
+}
+
+static int
+connect_unix(const char *path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    int sock, r;
+
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert_int_not_equal(sock, -1);
+    strcpy(addr.sun_path, path);
+    r = connect(sock, (struct sockaddr *)&addr, sizeof addr);
+    close(sock);
+    return r;
+}
+
+static void
+test_config_batch_staged(void **state)
+{
+    const char *path = BUILD_DIR "/test_config_batch.sock";
+    const char *path2 = BUILD_DIR "/test_config_batch2.sock";
+    struct stat st;
+    ino_t ino;
+
+    (void)state;
+
+    unlink(path);
+    unlink(path2);
+    assert_int_equal(nc_server_add_endpt("kept", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_endpt_set_address("kept", path), 0);
+    assert_int_equal(stat(path, &st), 0);
+    ino = st.st_ino;
+
+    assert_int_equal(nc_server_config_begin(), 0);
+    assert_int_equal(nc_server_add_endpt("batch", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_endpt_set_address("batch", path2), 0);
+
+    /* other threads do not wait for the commit and see the current configuration */
+    assert_int_equal(nc_server_is_endpt("batch"), 1);
+    assert_int_equal(is_endpt_other_thread("batch"), 0);
+    assert_int_equal(is_endpt_other_thread("kept"), 1);
+    assert_int_equal(connect_unix(path), 0);
+
+    assert_int_equal(nc_server_config_commit(), 0);
+    assert_int_equal(is_endpt_other_thread("batch"), 1);
+    assert_int_equal(connect_unix(path2), 0);
+
+    /* the unchanged endpoint keeps its listening socket */
+    assert_int_equal(connect_unix(path), 0);
+    assert_int_equal(stat(path, &st), 0);
+    assert_int_equal(st.st_ino, ino);
+
+    assert_int_equal(nc_server_del_endpt(NULL, 0), 0);
+    unlink(path);
+    unlink(path2);
+}
+
+static void
+test_config_batch_rollback(void **state)
+{
+    const char *path = BUILD_DIR "/test_config_batch.sock";
+    const char *path2 = BUILD_DIR "/test_config_batch2.sock";
+
+    (void)state;
+
+    unlink(path);
+    unlink(path2);
+    assert_int_equal(nc_server_add_endpt("kept", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_endpt_set_address("kept", path), 0);
+
+    assert_int_equal(nc_server_config_begin(), 0);
+    assert_int_equal(nc_server_endpt_set_address("kept", path2), 0);
+    assert_int_equal(nc_server_add_endpt("batch", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_endpt_set_address("batch", BUILD_DIR "/nonexistent/test_config_batch.sock"), 0);
+
+    /* the new endpoint fails to listen, none of the changes is applied */
+    assert_int_equal(nc_server_config_commit(), -1);
+    assert_int_equal(nc_server_is_endpt("batch"), 0);
+    assert_int_equal(connect_unix(path), 0);
+    assert_int_not_equal(connect_unix(path2), 0);
+
+    /* the batch is finished */
+    assert_int_equal(nc_server_config_commit(), -1);
+
+    assert_int_equal(nc_server_del_endpt(NULL, 0), 0);
+    unlink(path);
+    unlink(path2);
+}
+
+/**
+ * @brief Check that an endpoint is found by its name.
+ */
+static void
+check_endpt_found(const char *name)
+{
+    struct nc_endpt *endpt;
+    uint16_t idx;
+
+    endpt = nc_server_endpt_lock_get(name, 0, &idx);
+    assert_non_null(endpt);
+    assert_string_equal(endpt->name, name);
+    nc_server_endpt_unlock();
+}
+
+static void
+test_endpt_index(void **state)
+{
+    (void)state;
+
+    assert_int_equal(nc_server_add_endpt("first", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_add_endpt("middle", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_add_endpt("last", NC_TI_UNIX), 0);
+
+    /* the last endpoint is moved into the slot of the deleted one */
+    assert_int_equal(nc_server_del_endpt("middle", 0), 0);
+    assert_int_equal(nc_server_is_endpt("middle"), 0);
+    check_endpt_found("first");
+    check_endpt_found("last");
+    assert_int_equal(nc_server_add_endpt("last", NC_TI_UNIX), -1);
+
+    /* the name can be used again */
+    assert_int_equal(nc_server_add_endpt("middle", NC_TI_UNIX), 0);
+    check_endpt_found("middle");
+    check_endpt_found("last");
+    assert_int_equal(nc_server_add_endpt("middle", NC_TI_UNIX), -1);
+
+    assert_int_equal(nc_server_del_endpt("last", 0), 0);
+    assert_int_equal(nc_server_is_endpt("last"), 0);
+    check_endpt_found("middle");
+
+    assert_int_equal(nc_server_del_endpt(NULL, 0), 0);
+}
+
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+
+/**
+ * @brief Check that a Call Home client is found by its name.
+ */
+static void
+check_ch_client_found(const char *name)
+{
+    struct nc_ch_client *client;
+
+    nc_server_ch_client_lock(name, NULL, 0, &client);
+    assert_non_null(client);
+    assert_string_equal(client->name, name);
+    nc_server_ch_client_unlock(client);
+}
+
+static void
+test_ch_client_index(void **state)
+{
+    (void)state;
+
+    assert_int_equal(nc_server_ch_add_client("first"), 0);
+    assert_int_equal(nc_server_ch_add_client("middle"), 0);
+    assert_int_equal(nc_server_ch_add_client("last"), 0);
+
+    /* the last client is moved into the slot of the deleted one */
+    assert_int_equal(nc_server_ch_del_client("middle"), 0);
+    assert_int_equal(nc_server_ch_is_client("middle"), 0);
+    check_ch_client_found("first");
+    check_ch_client_found("last");
+    assert_int_equal(nc_server_ch_add_client("last"), -1);
+
+    /* the name can be used again */
+    assert_int_equal(nc_server_ch_add_client("middle"), 0);
+    check_ch_client_found("middle");
+    check_ch_client_found("last");
+    assert_int_equal(nc_server_ch_add_client("middle"), -1);
+
+    assert_int_equal(nc_server_ch_del_client("last"), 0);
+    assert_int_equal(nc_server_ch_is_client("last"), 0);
+    check_ch_client_found("middle");
+
+    assert_int_equal(nc_server_ch_del_client(NULL), 0);
+}
+
+#endif
+
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+
+static void
+test_reuseport(void **state)
+{
+#ifdef NC_ENABLED_SSH
+    NC_TRANSPORT_IMPL ti = NC_TI_LIBSSH;
+#else
+    NC_TRANSPORT_IMPL ti = NC_TI_OPENSSL;
+#endif
+
+    (void)state;
+
+    /* a UNIX socket is not affected */
+    unlink(BUILD_DIR "/test_reuseport.sock");
+    assert_int_equal(nc_server_add_endpt("unix", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_endpt_set_address("unix", BUILD_DIR "/test_reuseport.sock"), 0);
+    assert_int_equal(nc_server_set_reuseport(1), 0);
+    assert_int_equal(nc_server_set_reuseport(0), 0);
+
+    /* the listening TCP socket was created without SO_REUSEPORT */
+    assert_int_equal(nc_server_add_endpt("tcp", ti), 0);
+    assert_int_equal(nc_server_endpt_set_address("tcp", "127.0.0.1"), 0);
+    assert_int_equal(nc_server_endpt_set_port("tcp", 6009), 0);
+    assert_int_equal(nc_server_set_reuseport(1), -1);
+    assert_int_equal(nc_server_set_reuseport(0), 0);
+
+    /* allowed again without it */
+    assert_int_equal(nc_server_del_endpt("tcp", 0), 0);
+    assert_int_equal(nc_server_set_reuseport(1), 0);
+    assert_int_equal(nc_server_set_reuseport(0), 0);
+
+    assert_int_equal(nc_server_del_endpt(NULL, 0), 0);
+    unlink(BUILD_DIR "/test_reuseport.sock");
+}
+
+#endif
+
+static void
+acceptor_clb(struct nc_session *session, void *user_data)
+{
+    (void)user_data;
+
+    /* the raw connections never finish the handshake */
+    nc_session_free(session, NULL);
+    fail();
+}
+
+static void
+test_acceptor_shared(void **state)
+{
+    const char *path = BUILD_DIR "/test_acceptor.sock";
+    struct ly_ctx *ctx;
+    struct nc_acceptor *acc;
+    int i;
+
+    (void)state;
+
+    assert_int_equal(ly_ctx_new(NULL, 0, &ctx), LY_SUCCESS);
+    unlink(path);
+    assert_int_equal(nc_server_add_endpt("main", NC_TI_UNIX), 0);
+    assert_int_equal(nc_server_endpt_set_address("main", path), 0);
+
+    /* all the threads share the endpoint socket */
+    acc = nc_acceptor_new(ctx, 4, 1, acceptor_clb, NULL);
+    assert_non_null(acc);
+    assert_int_equal(connect_unix(path), 0);
+
+    /* the threads waiting for connections hold no lock, the bind lock only briefly between the waits */
+    for (i = 0; (i < 10) && pthread_mutex_trylock(&server_opts.bind_lock); ++i) {
+        usleep(1000);
+    }
+    assert_int_not_equal(i, 10);
+    assert_int_equal(pthread_rwlock_trywrlock(&server_opts.endpt_lock), 0);
+    pthread_rwlock_unlock(&server_opts.endpt_lock);
+    pthread_mutex_unlock(&server_opts.bind_lock);
+
+    /* so they do not block the configuration */
+    for (i = 0; i < 20; ++i) {
+        assert_int_equal(nc_server_add_endpt("other", NC_TI_UNIX), 0);
+        assert_int_equal(nc_server_del_endpt("other", 0), 0);
+    }
+
+    /* and still accept */
+    assert_int_equal(connect_unix(path), 0);
+
+    nc_acceptor_free(acc);
+    assert_int_equal(nc_server_del_endpt(NULL, 0), 0);
+    unlink(path);
+    ly_ctx_destroy(ctx);
+}
+
 int
 main(void)
 {
     const struct CMUnitTest init_destroy[] = {
-        cmocka_unit_test_setup_teardown(test_dummy, setup_server, teardown_server)
+        cmocka_unit_test_setup_teardown(test_dummy, setup_server, teardown_server),
+        cmocka_unit_test_setup_teardown(test_config_batch, setup_server, teardown_server),
+        cmocka_unit_test_setup_teardown(test_config_batch_staged, setup_server, teardown_server),
+        cmocka_unit_test_setup_teardown(test_config_batch_rollback, setup_server, teardown_server),
+        cmocka_unit_test_setup_teardown(test_endpt_index, setup_server, teardown_server),
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+        cmocka_unit_test_setup_teardown(test_ch_client_index, setup_server, teardown_server),
+        cmocka_unit_test_setup_teardown(test_reuseport, setup_server, teardown_server),
+#endif
+        cmocka_unit_test_setup_teardown(test_acceptor_shared, setup_server, teardown_server)
     };
 
     return cmocka_run_group_tests(init_destroy, NULL, NULL);
@@ -64,8 +64,7 @@ setup_write(void **state)
     w->session->version = NC_VERSION_10;
     w->session->opts.client.msgid = 999;
     w->session->ti_type = NC_TI_FD;
-    w->session->io_lock = malloc(sizeof *w->session->io_lock);
-    pthread_mutex_init(w->session->io_lock, NULL);
+    pthread_mutex_init(&w->session->io_lock, NULL);
     w->session->ti.fd.in = pipes[0];
     w->session->ti.fd.out = pipes[1];
 
@@ -172,6 +171,87 @@ test_write_rpc_11_bad(void **state)
     return test_write_rpc_bad(state);
 }
 
+static void
+test_read_msg_buf_11(void **state)
+{
+    struct wr *w = (struct wr *)*state;
+    const char *data = "\n#4\n<a/>\n##\n\n#3\n<b>\n#4\n</b>\n##\n";
+    struct ly_in *msg;
+    char *mbuf;
+
+    w->session->version = NC_VERSION_11;
+    assert_int_equal(write(w->session->ti.fd.out, data, strlen(data)), strlen(data));
+
+    /* the message is read into the session buffer */
+    assert_int_equal(nc_read_msg_buf_io(w->session, 1000, &msg), 1);
+    assert_ptr_equal(w->session->mbuf_in, msg);
+    assert_string_equal(ly_in_memory(msg, NULL), "<a/>");
+    mbuf = w->session->mbuf;
+    nc_read_msg_free(w->session, msg);
+    assert_null(w->session->mbuf_in);
+    assert_ptr_equal(w->session->mbuf, mbuf);
+
+    /* the buffer is reused for the next message */
+    assert_int_equal(nc_read_msg_buf_io(w->session, 1000, &msg), 1);
+    assert_string_equal(ly_in_memory(msg, NULL), "<b></b>");
+    assert_ptr_equal(w->session->mbuf, ly_in_memory(msg, NULL));
+    nc_read_msg_free(w->session, msg);
+
+    /* all the buffers are freed on idle */
+    nc_session_buf_trim(w->session);
+    assert_null(w->session->rbuf);
+    assert_null(w->session->mbuf);
+    assert_int_equal(w->session->mbuf_size, 0);
+}
+
+static void
+test_write_timeout(void **state)
+{
+    struct wr *w = (struct wr *)*state;
+    struct nc_rpc *rpc;
+    struct timespec ts_start;
+    uint64_t msgid;
+    size_t len = 4 * 1024 * 1024;
+    char *filter;
+
+    w->session->side = NC_CLIENT;
+    assert_int_not_equal(fcntl(w->session->ti.fd.out, F_SETFL, O_NONBLOCK), -1);
+
+    /* larger than the pipe buffer and nobody reads it */
+    filter = malloc(len + 1);
+    assert_non_null(filter);
+    memset(filter, 'a', len);
+    memcpy(filter, "<a>", 3);
+    memcpy(filter + len - 4, "</a>", 5);
+    rpc = nc_rpc_get(filter, NC_WD_UNKNOWN, NC_PARAMTYPE_CONST);
+    assert_non_null(rpc);
+
+    nc_gettimespec_mono_add(&ts_start, 0);
+    assert_int_equal(nc_send_rpc(w->session, rpc, 1000, &msgid), NC_MSG_ERROR);
+    assert_true(-nc_difftimespec_mono_cur(&ts_start) >= NC_WRITE_TIMEOUT * 1000 - NC_TIMEOUT_STEP / 1000);
+    assert_int_equal(w->session->status, NC_STATUS_INVALID);
+
+    nc_rpc_free(rpc);
+    free(filter);
+}
+
+static void
+test_read_inact_timeout(void **state)
+{
+    struct wr *w = (struct wr *)*state;
+    const char *data = "<rpc";
+    struct ly_in *msg;
+    struct timespec ts_start;
+
+    /* incomplete message and no more data */
+    assert_int_equal(write(w->session->ti.fd.out, data, strlen(data)), strlen(data));
+
+    nc_gettimespec_mono_add(&ts_start, 0);
+    assert_int_equal(nc_read_msg_io(w->session, 1000, &msg, 0), -1);
+    assert_true(-nc_difftimespec_mono_cur(&ts_start) >= NC_READ_INACT_TIMEOUT * 1000 - NC_TIMEOUT_STEP / 1000);
+    assert_int_equal(w->session->status, NC_STATUS_INVALID);
+}
+
 int
 main(void)
 {
@@ -179,7 +259,10 @@ main(void)
         cmocka_unit_test_setup_teardown(test_write_rpc_10, setup_write, teardown_write),
         cmocka_unit_test_setup_teardown(test_write_rpc_10_bad, setup_write, teardown_write),
         cmocka_unit_test_setup_teardown(test_write_rpc_11, setup_write, teardown_write),
-        cmocka_unit_test_setup_teardown(test_write_rpc_11_bad, setup_write, teardown_write)
+        cmocka_unit_test_setup_teardown(test_write_rpc_11_bad, setup_write, teardown_write),
+        cmocka_unit_test_setup_teardown(test_read_msg_buf_11, setup_write, teardown_write),
+        cmocka_unit_test_setup_teardown(test_write_timeout, setup_write, teardown_write),
+        cmocka_unit_test_setup_teardown(test_read_inact_timeout, setup_write, teardown_write)
     };
 
     return cmocka_run_group_tests(io, NULL, NULL);
@@ -0,0 +1,179 @@
+/**
+ * \file test_ktls.c
+ * \brief libnetconf2 tests - kernel TLS offload settings and reporting
+ *
+ * Copyright (c) 2015 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <libyang/libyang.h>
+
+#include <session_client.h>
+#include <session_p.h>
+#include <session_server.h>
+#include "tests/config.h"
+
+#define TEST_PORT 6008
+
+struct ly_ctx *ctx;
+
+static int
+clb_server_cert(const char *name, void *user_data, char **cert_path, char **cert_data, char **privkey_path,
+        char **privkey_data, NC_SSH_KEY_TYPE *privkey_type)
+{
+    (void)user_data;
+    (void)cert_data;
+    (void)privkey_data;
+    (void)privkey_type;
+
+    assert_string_equal(name, "server_cert");
+    *cert_path = strdup(TESTS_DIR "/data/server.crt");
+    *privkey_path = strdup(TESTS_DIR "/data/server.key");
+    return 0;
+}
+
+static int
+clb_trusted_cert_lists(const char *name, void *user_data, char ***cert_paths, int *cert_path_count,
+        char ***cert_data, int *cert_data_count)
+{
+    (void)user_data;
+    (void)cert_data;
+    (void)cert_data_count;
+
+    assert_string_equal(name, "client_cert_list");
+    *cert_paths = malloc(sizeof **cert_paths);
+    (*cert_paths)[0] = strdup(TESTS_DIR "/data/client.crt");
+    *cert_path_count = 1;
+    return 0;
+}
+
+static void *
+server_thread(void *arg)
+{
+    struct nc_session **session = arg;
+    NC_MSG_TYPE msgtype;
+
+    msgtype = nc_accept(5000, ctx, session);
+    assert_int_equal(msgtype, NC_MSG_HELLO);
+
+    return NULL;
+}
+
+static void
+test_ktls_endpt_set(void **state)
+{
+    (void)state;
+
+    assert_int_equal(nc_server_tls_endpt_set_ktls(NULL, 1), -1);
+    assert_int_equal(nc_server_tls_endpt_set_ktls("unknown", 1), -1);
+#ifdef NC_ENABLED_SSH
+    assert_int_equal(nc_server_tls_endpt_set_ktls("main_ssh", 1), -1);
+#endif
+
+    assert_int_equal(nc_server_tls_endpt_set_ktls("main_tls", 1), 0);
+    assert_int_equal(nc_server_tls_endpt_set_ktls("main_tls", 0), 0);
+}
+
+static void
+test_ktls_not_tls(void **state)
+{
+    struct nc_session session = {0};
+
+    (void)state;
+
+    assert_int_equal(nc_session_get_ktls(NULL), -1);
+
+    session.ti_type = NC_TI_FD;
+    assert_int_equal(nc_session_get_ktls(&session), NC_TLS_KTLS_NONE);
+
+    /* TLS session without a connection */
+    session.ti_type = NC_TI_OPENSSL;
+    assert_int_equal(nc_session_get_ktls(&session), NC_TLS_KTLS_NONE);
+}
+
+static void
+test_ktls_disabled(void **state)
+{
+    struct nc_session *server_session = NULL, *client_session;
+    pthread_t server_tid;
+
+    (void)state;
+
+    /* enabled and disabled again */
+    assert_int_equal(nc_server_tls_endpt_set_ktls("main_tls", 1), 0);
+    assert_int_equal(nc_server_tls_endpt_set_ktls("main_tls", 0), 0);
+    nc_client_tls_set_ktls(1);
+    nc_client_tls_set_ktls(0);
+
+    assert_int_equal(pthread_create(&server_tid, NULL, server_thread, &server_session), 0);
+    client_session = nc_connect_tls("127.0.0.1", TEST_PORT, ctx);
+    assert_non_null(client_session);
+    pthread_join(server_tid, NULL);
+    assert_non_null(server_session);
+
+    /* all the records are processed by OpenSSL on both sides */
+    assert_int_equal(nc_session_get_ktls(server_session), NC_TLS_KTLS_NONE);
+    assert_int_equal(nc_session_get_ktls(client_session), NC_TLS_KTLS_NONE);
+
+    nc_session_free(client_session, NULL);
+    nc_session_free(server_session, NULL);
+}
+
+int
+main(void)
+{
+    int ret;
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
+    assert_non_null(ctx);
+    assert_non_null(ly_ctx_load_module(ctx, "ietf-netconf", NULL, NULL));
+
+    nc_server_init();
+
+    /* server */
+    nc_server_tls_set_server_cert_clb(clb_server_cert, NULL, NULL);
+    nc_server_tls_set_trusted_cert_list_clb(clb_trusted_cert_lists, NULL, NULL);
+    assert_int_equal(nc_server_add_endpt("main_tls", NC_TI_OPENSSL), 0);
+    assert_int_equal(nc_server_endpt_set_address("main_tls", "127.0.0.1"), 0);
+    assert_int_equal(nc_server_endpt_set_port("main_tls", TEST_PORT), 0);
+    assert_int_equal(nc_server_tls_endpt_set_server_cert("main_tls", "server_cert"), 0);
+    assert_int_equal(nc_server_tls_endpt_add_trusted_cert_list("main_tls", "client_cert_list"), 0);
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 0,
+            "02:B3:9F:26:65:76:6B:CC:FC:86:8E:D4:1A:81:64:0F:92:EB:18:AE:FF", NC_TLS_CTN_SPECIFIED, "test"), 0);
+#ifdef NC_ENABLED_SSH
+    assert_int_equal(nc_server_add_endpt("main_ssh", NC_TI_LIBSSH), 0);
+#endif
+
+    /* client */
+    assert_int_equal(nc_client_tls_set_cert_key_paths(TESTS_DIR "/data/client.crt", TESTS_DIR "/data/client.key"), 0);
+    assert_int_equal(nc_client_tls_set_trusted_ca_paths(NULL, TESTS_DIR "/data"), 0);
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_ktls_endpt_set),
+        cmocka_unit_test(test_ktls_not_tls),
+        cmocka_unit_test(test_ktls_disabled),
+    };
+
+    ret = cmocka_run_group_tests(tests, NULL, NULL);
+
+    nc_client_destroy();
+    nc_server_destroy();
+    ly_ctx_destroy(ctx);
+
+    return ret;
+}
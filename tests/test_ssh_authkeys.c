@@ -0,0 +1,246 @@
+/**
+ * \file test_ssh_authkeys.c
+ * \brief libnetconf2 tests - authorized SSH keys changed or revoked in their files
+ *
+ * Copyright (c) 2015 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+#include <libyang/libyang.h>
+
+#include <session_client.h>
+#include <session_p.h>
+#include <session_server.h>
+#include "tests/config.h"
+
+#define TEST_PORT 6010
+
+#define TEST_AUTHKEY BUILD_DIR "/test_ssh_authkeys.pub"
+#define TEST_AUTHKEY_TMP BUILD_DIR "/test_ssh_authkeys.pub.tmp"
+
+struct ly_ctx *ctx;
+ATOMIC_T server_stop;
+pthread_t server_tid;
+
+static int
+clb_hostkeys(const char *name, void *user_data, char **privkey_path, char **privkey_data, NC_SSH_KEY_TYPE *privkey_type)
+{
+    (void)user_data;
+    (void)privkey_data;
+    (void)privkey_type;
+
+    assert_string_equal(name, "key_rsa");
+    *privkey_path = strdup(TESTS_DIR "/data/key_rsa");
+    return 0;
+}
+
+static int
+ssh_hostkey_check_clb(const char *hostname, ssh_session session, void *priv)
+{
+    (void)hostname;
+    (void)session;
+    (void)priv;
+
+    return 0;
+}
+
+static void *
+server_thread(void *arg)
+{
+    struct nc_pollsession *ps;
+    struct nc_session *session;
+    NC_MSG_TYPE msgtype;
+
+    (void)arg;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+
+    while (!ATOMIC_LOAD_RELAXED(server_stop)) {
+        msgtype = nc_accept(10, ctx, &session);
+        if (msgtype == NC_MSG_HELLO) {
+            assert_int_equal(nc_ps_add_session(ps, session), 0);
+        }
+
+        /* <close-session> and the closed sessions */
+        nc_ps_poll(ps, 10, NULL);
+        nc_ps_clear(ps, 0, NULL);
+    }
+
+    nc_ps_clear(ps, 1, NULL);
+    nc_ps_free(ps);
+    return NULL;
+}
+
+static int
+setup_f(void **state)
+{
+    (void)state;
+
+    ATOMIC_STORE_RELAXED(server_stop, 0);
+    assert_int_equal(pthread_create(&server_tid, NULL, server_thread, NULL), 0);
+
+    return 0;
+}
+
+static int
+teardown_f(void **state)
+{
+    (void)state;
+
+    ATOMIC_STORE_RELAXED(server_stop, 1);
+    pthread_join(server_tid, NULL);
+
+    assert_int_equal(nc_server_ssh_del_authkey(NULL, NULL, 0, NULL), 0);
+    unlink(TEST_AUTHKEY);
+    unlink(TEST_AUTHKEY_TMP);
+
+    return 0;
+}
+
+/**
+ * @brief Copy a file, keep the modification time of another file if set.
+ */
+static void
+test_copy(const char *src, const char *dst, const char *mtime_path)
+{
+    char buf[4096];
+    ssize_t len;
+    int in, out;
+    struct stat st;
+    struct timespec times[2];
+
+    in = open(src, O_RDONLY);
+    assert_int_not_equal(in, -1);
+    out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert_int_not_equal(out, -1);
+    while ((len = read(in, buf, sizeof buf)) > 0) {
+        assert_int_equal(write(out, buf, len), len);
+    }
+    assert_int_equal(len, 0);
+    close(in);
+
+    if (mtime_path) {
+        assert_int_equal(stat(mtime_path, &st), 0);
+        times[0] = st.st_atim;
+        times[1] = st.st_mtim;
+        assert_int_equal(futimens(out, times), 0);
+    }
+    close(out);
+}
+
+/**
+ * @brief Try to connect with the client key.
+ *
+ * @return Whether the client was authenticated.
+ */
+static int
+test_connect(void)
+{
+    struct nc_session *session;
+
+    session = nc_connect_ssh("127.0.0.1", TEST_PORT, ctx);
+    if (!session) {
+        return 0;
+    }
+
+    nc_session_free(session, NULL);
+    return 1;
+}
+
+static void
+test_authkey_removed(void **state)
+{
+    (void)state;
+
+    test_copy(TESTS_DIR "/data/key_ecdsa.pub", TEST_AUTHKEY, NULL);
+    assert_int_equal(nc_server_ssh_add_authkey_path(TEST_AUTHKEY, "test"), 0);
+    assert_true(test_connect());
+
+    /* revoked right away */
+    assert_int_equal(unlink(TEST_AUTHKEY), 0);
+    assert_false(test_connect());
+
+    /* and authorized again */
+    test_copy(TESTS_DIR "/data/key_ecdsa.pub", TEST_AUTHKEY, NULL);
+    assert_true(test_connect());
+}
+
+static void
+test_authkey_replaced(void **state)
+{
+    (void)state;
+
+    test_copy(TESTS_DIR "/data/key_ecdsa.pub", TEST_AUTHKEY, NULL);
+    assert_int_equal(nc_server_ssh_add_authkey_path(TEST_AUTHKEY, "test"), 0);
+    assert_true(test_connect());
+
+    /* replaced by a prepared file with the same modification time */
+    test_copy(TESTS_DIR "/data/key_rsa.pub", TEST_AUTHKEY_TMP, TEST_AUTHKEY);
+    assert_int_equal(rename(TEST_AUTHKEY_TMP, TEST_AUTHKEY), 0);
+    assert_false(test_connect());
+
+    /* rewritten in place keeping the modification time */
+    test_copy(TESTS_DIR "/data/key_ecdsa.pub", TEST_AUTHKEY, TEST_AUTHKEY);
+    assert_true(test_connect());
+    test_copy(TESTS_DIR "/data/key_rsa.pub", TEST_AUTHKEY, TEST_AUTHKEY);
+    assert_false(test_connect());
+}
+
+int
+main(void)
+{
+    int ret;
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
+    assert_non_null(ctx);
+    assert_non_null(ly_ctx_load_module(ctx, "ietf-netconf", NULL, NULL));
+
+    nc_server_init();
+
+    /* server */
+    nc_server_ssh_set_hostkey_clb(clb_hostkeys, NULL, NULL);
+    assert_int_equal(nc_server_add_endpt("main_ssh", NC_TI_LIBSSH), 0);
+    assert_int_equal(nc_server_endpt_set_address("main_ssh", "127.0.0.1"), 0);
+    assert_int_equal(nc_server_endpt_set_port("main_ssh", TEST_PORT), 0);
+    assert_int_equal(nc_server_ssh_endpt_add_hostkey("main_ssh", "key_rsa", -1), 0);
+
+    /* client */
+    nc_client_ssh_set_auth_hostkey_check_clb(ssh_hostkey_check_clb, NULL);
+    assert_int_equal(nc_client_ssh_set_username("test"), 0);
+    assert_int_equal(nc_client_ssh_add_keypair(TESTS_DIR "/data/key_ecdsa.pub", TESTS_DIR "/data/key_ecdsa"), 0);
+    nc_client_ssh_set_auth_pref(NC_SSH_AUTH_PUBLICKEY, 1);
+    nc_client_ssh_set_auth_pref(NC_SSH_AUTH_PASSWORD, -1);
+    nc_client_ssh_set_auth_pref(NC_SSH_AUTH_INTERACTIVE, -1);
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_authkey_removed, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_authkey_replaced, setup_f, teardown_f),
+    };
+
+    ret = cmocka_run_group_tests(tests, NULL, NULL);
+
+    nc_client_destroy();
+    nc_server_destroy();
+    ly_ctx_destroy(ctx);
+
+    return ret;
+}
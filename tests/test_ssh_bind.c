@@ -0,0 +1,256 @@
+/**
+ * \file test_ssh_bind.c
+ * \brief libnetconf2 tests - SSH bind cached by the server endpoints
+ *
+ * Copyright (c) 2015 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <libyang/libyang.h>
+
+#include <session_client.h>
+#include <session_p.h>
+#include <session_server.h>
+#include "tests/config.h"
+
+#define TEST_PORT 6012
+
+struct ly_ctx *ctx;
+ATOMIC_T hostkey_clb_count;
+ATOMIC_T hostkey_clb2_count;
+
+static int
+clb_hostkeys(const char *name, void *user_data, char **privkey_path, char **privkey_data, NC_SSH_KEY_TYPE *privkey_type)
+{
+    (void)user_data;
+    (void)privkey_data;
+    (void)privkey_type;
+
+    ATOMIC_INC_RELAXED(hostkey_clb_count);
+
+    if (!strcmp(name, "key_rsa")) {
+        *privkey_path = strdup(TESTS_DIR "/data/key_rsa");
+    } else {
+        assert_string_equal(name, "key_ecdsa");
+        *privkey_path = strdup(TESTS_DIR "/data/key_ecdsa");
+    }
+    return 0;
+}
+
+static int
+clb_hostkeys2(const char *name, void *user_data, char **privkey_path, char **privkey_data, NC_SSH_KEY_TYPE *privkey_type)
+{
+    ATOMIC_INC_RELAXED(hostkey_clb2_count);
+
+    return clb_hostkeys(name, user_data, privkey_path, privkey_data, privkey_type);
+}
+
+static int
+ssh_hostkey_check_clb(const char *hostname, ssh_session session, void *priv)
+{
+    (void)hostname;
+    (void)session;
+    (void)priv;
+
+    return 0;
+}
+
+static void *
+server_thread(void *arg)
+{
+    struct nc_session **session = arg;
+    NC_MSG_TYPE msgtype;
+
+    msgtype = nc_accept(5000, ctx, session);
+    assert_int_equal(msgtype, NC_MSG_HELLO);
+
+    return NULL;
+}
+
+/**
+ * @brief Connect a new client session and close it right away.
+ */
+static void
+test_connect_close(void)
+{
+    struct nc_session *server_session = NULL, *client_session;
+    pthread_t server_tid;
+
+    assert_int_equal(pthread_create(&server_tid, NULL, server_thread, &server_session), 0);
+    client_session = nc_connect_ssh("127.0.0.1", TEST_PORT, ctx);
+    assert_non_null(client_session);
+    pthread_join(server_tid, NULL);
+    assert_non_null(server_session);
+
+    nc_session_free(client_session, NULL);
+    nc_session_free(server_session, NULL);
+}
+
+/**
+ * @brief Get the SSH bind cached by the endpoint.
+ *
+ * @param[out] gen Optional generation of the host key callback the bind was created with.
+ * @return Cached bind, NULL if none.
+ */
+static ssh_bind
+test_endpt_sbind(uint32_t *gen)
+{
+    struct nc_endpt *endpt;
+    ssh_bind sbind;
+
+    endpt = nc_server_endpt_lock_get("main_ssh", NC_TI_LIBSSH, NULL);
+    assert_non_null(endpt);
+    sbind = endpt->opts.ssh->sbind;
+    if (gen) {
+        *gen = endpt->opts.ssh->sbind_gen;
+    }
+    nc_server_endpt_unlock();
+
+    return sbind;
+}
+
+static void
+test_sbind_cached(void **state)
+{
+    ssh_bind sbind;
+    int count;
+
+    (void)state;
+
+    test_connect_close();
+    sbind = test_endpt_sbind(NULL);
+    assert_non_null(sbind);
+
+    /* the next session uses the same bind without loading the host keys again */
+    count = ATOMIC_LOAD_RELAXED(hostkey_clb_count);
+    test_connect_close();
+    assert_ptr_equal(test_endpt_sbind(NULL), sbind);
+    assert_int_equal(ATOMIC_LOAD_RELAXED(hostkey_clb_count), count);
+}
+
+static void
+test_sbind_hostkeys(void **state)
+{
+    int count;
+
+    (void)state;
+
+    test_connect_close();
+    assert_non_null(test_endpt_sbind(NULL));
+
+    /* added host key */
+    count = ATOMIC_LOAD_RELAXED(hostkey_clb_count);
+    assert_int_equal(nc_server_ssh_endpt_add_hostkey("main_ssh", "key_ecdsa", -1), 0);
+    assert_null(test_endpt_sbind(NULL));
+    test_connect_close();
+    assert_non_null(test_endpt_sbind(NULL));
+    assert_int_equal(ATOMIC_LOAD_RELAXED(hostkey_clb_count), count + 2);
+
+    /* moved host keys */
+    count = ATOMIC_LOAD_RELAXED(hostkey_clb_count);
+    assert_int_equal(nc_server_ssh_endpt_mov_hostkey("main_ssh", "key_ecdsa", NULL), 0);
+    assert_null(test_endpt_sbind(NULL));
+    test_connect_close();
+    assert_non_null(test_endpt_sbind(NULL));
+    assert_int_equal(ATOMIC_LOAD_RELAXED(hostkey_clb_count), count + 2);
+
+    assert_int_equal(nc_server_ssh_endpt_mov_hostkey("main_ssh", "key_rsa", NULL), 0);
+    assert_null(test_endpt_sbind(NULL));
+    test_connect_close();
+    assert_non_null(test_endpt_sbind(NULL));
+
+    /* moving a key to its own position changes nothing */
+    assert_int_equal(nc_server_ssh_endpt_mov_hostkey("main_ssh", "key_rsa", NULL), 0);
+    assert_non_null(test_endpt_sbind(NULL));
+
+    /* deleted host key */
+    count = ATOMIC_LOAD_RELAXED(hostkey_clb_count);
+    assert_int_equal(nc_server_ssh_endpt_del_hostkey("main_ssh", "key_ecdsa", -1), 0);
+    assert_null(test_endpt_sbind(NULL));
+    test_connect_close();
+    assert_non_null(test_endpt_sbind(NULL));
+    assert_int_equal(ATOMIC_LOAD_RELAXED(hostkey_clb_count), count + 1);
+}
+
+static void
+test_sbind_hostkey_clb(void **state)
+{
+    uint32_t gen, new_gen;
+    int count;
+
+    (void)state;
+
+    test_connect_close();
+    assert_non_null(test_endpt_sbind(&gen));
+
+    /* the bind is kept until the next session is accepted, created again with the new callback */
+    count = ATOMIC_LOAD_RELAXED(hostkey_clb2_count);
+    nc_server_ssh_set_hostkey_clb(clb_hostkeys2, NULL, NULL);
+    test_connect_close();
+    assert_non_null(test_endpt_sbind(&new_gen));
+    assert_int_not_equal(new_gen, gen);
+    assert_int_equal(ATOMIC_LOAD_RELAXED(hostkey_clb2_count), count + 1);
+
+    /* and used from then on */
+    test_connect_close();
+    assert_int_equal(ATOMIC_LOAD_RELAXED(hostkey_clb2_count), count + 1);
+
+    nc_server_ssh_set_hostkey_clb(clb_hostkeys, NULL, NULL);
+}
+
+int
+main(void)
+{
+    int ret;
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
+    assert_non_null(ctx);
+    assert_non_null(ly_ctx_load_module(ctx, "ietf-netconf", NULL, NULL));
+
+    nc_server_init();
+
+    /* server */
+    nc_server_ssh_set_hostkey_clb(clb_hostkeys, NULL, NULL);
+    assert_int_equal(nc_server_add_endpt("main_ssh", NC_TI_LIBSSH), 0);
+    assert_int_equal(nc_server_endpt_set_address("main_ssh", "127.0.0.1"), 0);
+    assert_int_equal(nc_server_endpt_set_port("main_ssh", TEST_PORT), 0);
+    assert_int_equal(nc_server_ssh_endpt_add_hostkey("main_ssh", "key_rsa", -1), 0);
+    assert_int_equal(nc_server_ssh_add_authkey_path(TESTS_DIR "/data/key_ecdsa.pub", "test"), 0);
+
+    /* client */
+    nc_client_ssh_set_auth_hostkey_check_clb(ssh_hostkey_check_clb, NULL);
+    assert_int_equal(nc_client_ssh_set_username("test"), 0);
+    assert_int_equal(nc_client_ssh_add_keypair(TESTS_DIR "/data/key_ecdsa.pub", TESTS_DIR "/data/key_ecdsa"), 0);
+    nc_client_ssh_set_auth_pref(NC_SSH_AUTH_PUBLICKEY, 1);
+    nc_client_ssh_set_auth_pref(NC_SSH_AUTH_PASSWORD, -1);
+    nc_client_ssh_set_auth_pref(NC_SSH_AUTH_INTERACTIVE, -1);
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_sbind_cached),
+        cmocka_unit_test(test_sbind_hostkeys),
+        cmocka_unit_test(test_sbind_hostkey_clb),
+    };
+
+    ret = cmocka_run_group_tests(tests, NULL, NULL);
+
+    nc_client_destroy();
+    nc_server_destroy();
+    ly_ctx_destroy(ctx);
+
+    return ret;
+}
@@ -0,0 +1,267 @@
+/**
+ * \file test_ssh_channels.c
+ * \brief libnetconf2 tests - concurrent NETCONF sessions on the channels of one SSH session and on many SSH sessions
+ *
+ * Copyright (c) 2015 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+#include <libyang/libyang.h>
+
+#include <session_client.h>
+#include <session_p.h>
+#include <session_server.h>
+#include "tests/config.h"
+
+#define TEST_PORT 6007
+
+/* NETCONF sessions on the SSH session */
+#define CHANNEL_COUNT 4
+
+/* RPCs sent on each of them */
+#define RPC_COUNT 50
+
+struct ly_ctx *ctx;
+ATOMIC_T server_stop;
+
+static int
+clb_hostkeys(const char *name, void *user_data, char **privkey_path, char **privkey_data, NC_SSH_KEY_TYPE *privkey_type)
+{
+    (void)user_data;
+    (void)privkey_data;
+    (void)privkey_type;
+
+    assert_string_equal(name, "key_rsa");
+    *privkey_path = strdup(TESTS_DIR "/data/key_rsa");
+    return 0;
+}
+
+static int
+ssh_hostkey_check_clb(const char *hostname, ssh_session session, void *priv)
+{
+    (void)hostname;
+    (void)session;
+    (void)priv;
+
+    return 0;
+}
+
+static struct nc_server_reply *
+rpc_clb(struct lyd_node *rpc, struct nc_session *session)
+{
+    (void)rpc;
+    (void)session;
+
+    return nc_server_reply_ok();
+}
+
+static void *
+server_thread(void *arg)
+{
+    struct nc_pollsession *ps = arg;
+    struct nc_session *session;
+    NC_MSG_TYPE msgtype;
+    int ret;
+
+    while (!ATOMIC_LOAD_RELAXED(server_stop)) {
+        msgtype = nc_accept(10, ctx, &session);
+        if (msgtype == NC_MSG_HELLO) {
+            assert_int_equal(nc_ps_add_session(ps, session), 0);
+        }
+
+        ret = nc_ps_poll(ps, 10, &session);
+        assert_false(ret & NC_PSPOLL_ERROR);
+        if (ret & NC_PSPOLL_SSH_CHANNEL) {
+            /* a new NETCONF session on the SSH session */
+            msgtype = nc_ps_accept_ssh_channel(ps, &session);
+            assert_int_equal(msgtype, NC_MSG_HELLO);
+            assert_int_equal(nc_ps_add_session(ps, session), 0);
+        }
+    }
+
+    return NULL;
+}
+
+static void *
+client_thread(void *arg)
+{
+    struct nc_session *session = arg;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    NC_MSG_TYPE msgtype;
+    uint64_t msgid;
+    int i;
+
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+
+    for (i = 0; i < RPC_COUNT; ++i) {
+        msgtype = nc_send_rpc(session, rpc, 1000, &msgid);
+        assert_int_equal(msgtype, NC_MSG_RPC);
+
+        /* the reply may be read from the socket by any of the other sessions */
+        msgtype = nc_recv_reply(session, rpc, msgid, 5000, &envp, &op);
+        assert_int_equal(msgtype, NC_MSG_REPLY);
+        assert_null(op);
+        assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+        lyd_free_tree(envp);
+    }
+
+    nc_rpc_free(rpc);
+    return NULL;
+}
+
+static void
+test_ssh_channels(void **state)
+{
+    struct nc_pollsession *ps;
+    struct nc_session *sessions[CHANNEL_COUNT];
+    pthread_t server_tid, tids[CHANNEL_COUNT];
+    int i;
+
+    (void)state;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    ATOMIC_STORE_RELAXED(server_stop, 0);
+    assert_int_equal(pthread_create(&server_tid, NULL, server_thread, ps), 0);
+
+    /* one SSH session with several channels */
+    sessions[0] = nc_connect_ssh("127.0.0.1", TEST_PORT, ctx);
+    assert_non_null(sessions[0]);
+    for (i = 1; i < CHANNEL_COUNT; ++i) {
+        sessions[i] = nc_connect_ssh_channel(sessions[0], ctx);
+        assert_non_null(sessions[i]);
+        assert_ptr_equal(sessions[i]->ti.libssh.ssh_lock, sessions[0]->ti.libssh.ssh_lock);
+    }
+
+    /* all of them communicating at once */
+    for (i = 0; i < CHANNEL_COUNT; ++i) {
+        assert_int_equal(pthread_create(&tids[i], NULL, client_thread, sessions[i]), 0);
+    }
+    for (i = 0; i < CHANNEL_COUNT; ++i) {
+        pthread_join(tids[i], NULL);
+    }
+
+    /* no thread is left waiting for its channel */
+    assert_int_equal(sessions[0]->ti.libssh.ssh_lock->polling, 0);
+
+    for (i = CHANNEL_COUNT - 1; i > -1; --i) {
+        nc_session_free(sessions[i], NULL);
+    }
+
+    ATOMIC_STORE_RELAXED(server_stop, 1);
+    pthread_join(server_tid, NULL);
+    nc_ps_clear(ps, 1, NULL);
+    nc_ps_free(ps);
+}
+
+static void
+batch_clb(const struct nc_connect_target *target, struct nc_session *session, void *user_data)
+{
+    struct nc_session **sessions = user_data;
+
+    assert_null(sessions[(intptr_t)target->user_data]);
+    sessions[(intptr_t)target->user_data] = session;
+}
+
+static void
+test_connect_batch(void **state)
+{
+    struct nc_pollsession *ps;
+    struct nc_connect_target targets[CHANNEL_COUNT];
+    struct nc_session *sessions[CHANNEL_COUNT] = {0};
+    pthread_t server_tid;
+    int i;
+
+    (void)state;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    ATOMIC_STORE_RELAXED(server_stop, 0);
+    assert_int_equal(pthread_create(&server_tid, NULL, server_thread, ps), 0);
+
+    /* an IP address connected to right away and a host name resolved by a worker */
+    for (i = 0; i < CHANNEL_COUNT; ++i) {
+        targets[i].ti = NC_TI_LIBSSH;
+        targets[i].host = (i % 2) ? "localhost" : "127.0.0.1";
+        targets[i].port = TEST_PORT;
+        targets[i].user_data = (void *)(intptr_t)i;
+    }
+    assert_int_equal(nc_connect_batch(targets, CHANNEL_COUNT, ctx, 2, 2, 1000, batch_clb, sessions), 0);
+
+    /* every target connected, each with its own SSH session */
+    for (i = 0; i < CHANNEL_COUNT; ++i) {
+        assert_non_null(sessions[i]);
+        assert_int_equal(nc_session_get_status(sessions[i]), NC_STATUS_RUNNING);
+        if (i) {
+            assert_ptr_not_equal(sessions[i]->ti.libssh.session, sessions[0]->ti.libssh.session);
+        }
+    }
+    for (i = 0; i < CHANNEL_COUNT; ++i) {
+        nc_session_free(sessions[i], NULL);
+    }
+
+    ATOMIC_STORE_RELAXED(server_stop, 1);
+    pthread_join(server_tid, NULL);
+    nc_ps_clear(ps, 1, NULL);
+    nc_ps_free(ps);
+}
+
+int
+main(void)
+{
+    int ret;
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
+    assert_non_null(ctx);
+    assert_non_null(ly_ctx_load_module(ctx, "ietf-netconf", NULL, NULL));
+
+    nc_server_init();
+    nc_set_global_rpc_clb(rpc_clb);
+
+    /* server */
+    nc_server_ssh_set_hostkey_clb(clb_hostkeys, NULL, NULL);
+    assert_int_equal(nc_server_add_endpt("main_ssh", NC_TI_LIBSSH), 0);
+    assert_int_equal(nc_server_endpt_set_address("main_ssh", "127.0.0.1"), 0);
+    assert_int_equal(nc_server_endpt_set_port("main_ssh", TEST_PORT), 0);
+    assert_int_equal(nc_server_ssh_endpt_add_hostkey("main_ssh", "key_rsa", -1), 0);
+    assert_int_equal(nc_server_ssh_add_authkey_path(TESTS_DIR "/data/key_ecdsa.pub", "test"), 0);
+
+    /* client */
+    nc_client_ssh_set_auth_hostkey_check_clb(ssh_hostkey_check_clb, NULL);
+    assert_int_equal(nc_client_ssh_set_username("test"), 0);
+    assert_int_equal(nc_client_ssh_add_keypair(TESTS_DIR "/data/key_ecdsa.pub", TESTS_DIR "/data/key_ecdsa"), 0);
+    nc_client_ssh_set_auth_pref(NC_SSH_AUTH_PUBLICKEY, 1);
+    nc_client_ssh_set_auth_pref(NC_SSH_AUTH_PASSWORD, -1);
+    nc_client_ssh_set_auth_pref(NC_SSH_AUTH_INTERACTIVE, -1);
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_ssh_channels),
+        cmocka_unit_test(test_connect_batch),
+    };
+
+    ret = cmocka_run_group_tests(tests, NULL, NULL);
+
+    nc_client_destroy();
+    nc_server_destroy();
+    ly_ctx_destroy(ctx);
+
+    return ret;
+}
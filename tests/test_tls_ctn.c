@@ -0,0 +1,316 @@
+/**
+ * \file test_tls_ctn.c
+ * \brief libnetconf2 tests - cert-to-name entries matched by the client certificate fingerprint
+ *
+ * Copyright (c) 2015 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <libyang/libyang.h>
+
+#include <session_client.h>
+#include <session_p.h>
+#include <session_server.h>
+#include "tests/config.h"
+
+#define TEST_PORT 6013
+
+/* client certificate fingerprints */
+#define FP_MD5 "01:EF:76:F1:5C:1C:EA:A4:2C:1A:6F:C5:4D:0F:36:B1:3C"
+#define FP_SHA1 "02:B3:9F:26:65:76:6B:CC:FC:86:8E:D4:1A:81:64:0F:92:EB:18:AE:FF"
+#define FP_SHA1_LOWER "02:b3:9f:26:65:76:6b:cc:fc:86:8e:d4:1a:81:64:0f:92:eb:18:ae:ff"
+#define FP_SHA256 "04:85:6B:75:D1:1A:86:E0:D8:FE:5B:BD:72:F5:73:1D:07:EA:32:BF:09:11:21:6A:6E:23:78:8E:B6:D5:73:C3:2D"
+#define FP_UNKNOWN "07:B3:9F:26:65:76:6B:CC:FC:86:8E:D4:1A:81:64:0F:92:EB:18:AE:FF"
+
+struct ly_ctx *ctx;
+
+static int
+clb_server_cert(const char *name, void *user_data, char **cert_path, char **cert_data, char **privkey_path,
+        char **privkey_data, NC_SSH_KEY_TYPE *privkey_type)
+{
+    (void)user_data;
+    (void)cert_data;
+    (void)privkey_data;
+    (void)privkey_type;
+
+    assert_string_equal(name, "server_cert");
+    *cert_path = strdup(TESTS_DIR "/data/server.crt");
+    *privkey_path = strdup(TESTS_DIR "/data/server.key");
+    return 0;
+}
+
+static int
+clb_trusted_cert_lists(const char *name, void *user_data, char ***cert_paths, int *cert_path_count,
+        char ***cert_data, int *cert_data_count)
+{
+    (void)user_data;
+    (void)cert_data;
+    (void)cert_data_count;
+
+    assert_string_equal(name, "client_cert_list");
+    *cert_paths = malloc(sizeof **cert_paths);
+    (*cert_paths)[0] = strdup(TESTS_DIR "/data/client.crt");
+    *cert_path_count = 1;
+    return 0;
+}
+
+static void *
+server_thread(void *arg)
+{
+    struct nc_session **session = arg;
+
+    if (nc_accept(5000, ctx, session) != NC_MSG_HELLO) {
+        *session = NULL;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Connect a new client session and learn the username it was mapped to.
+ *
+ * @return Username, NULL if the client was not authenticated.
+ */
+static char *
+test_connect_username(void)
+{
+    struct nc_session *server_session = NULL, *client_session;
+    pthread_t server_tid;
+    char *username = NULL;
+
+    assert_int_equal(pthread_create(&server_tid, NULL, server_thread, &server_session), 0);
+    client_session = nc_connect_tls("127.0.0.1", TEST_PORT, ctx);
+    pthread_join(server_tid, NULL);
+
+    if (server_session) {
+        assert_non_null(client_session);
+        username = strdup(nc_session_get_username(server_session));
+        assert_non_null(username);
+        nc_session_free(server_session, NULL);
+    }
+    nc_session_free(client_session, NULL);
+
+    return username;
+}
+
+/**
+ * @brief Check the username a new client session is mapped to.
+ *
+ * @param[in] expected Expected username, NULL if the client should not be authenticated.
+ */
+static void
+test_username(const char *expected)
+{
+    char *username;
+
+    username = test_connect_username();
+    if (expected) {
+        assert_non_null(username);
+        assert_string_equal(username, expected);
+    } else {
+        assert_null(username);
+    }
+    free(username);
+}
+
+/**
+ * @brief Count the entries in the ctn index of the endpoint.
+ *
+ * @return Number of the indexed entries, -1 if there is no index.
+ */
+static int
+test_ctn_index_count(void)
+{
+    struct nc_endpt *endpt;
+    uint32_t i;
+    int count = -1;
+
+    endpt = nc_server_endpt_lock_get("main_tls", NC_TI_OPENSSL, NULL);
+    assert_non_null(endpt);
+    if (endpt->opts.tls->ctn_index) {
+        count = 0;
+        for (i = 0; i < endpt->opts.tls->ctn_index_size; ++i) {
+            if (endpt->opts.tls->ctn_index[i]) {
+                ++count;
+            }
+        }
+    }
+    nc_server_endpt_unlock();
+
+    return count;
+}
+
+static int
+teardown_f(void **state)
+{
+    (void)state;
+
+    nc_server_tls_endpt_del_ctn("main_tls", -1, NULL, 0, NULL);
+    return 0;
+}
+
+static void
+test_ctn_lowest_id(void **state)
+{
+    (void)state;
+
+    /* every entry matches with a different algorithm */
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 5, FP_SHA256, NC_TLS_CTN_SPECIFIED, "sha256"), 0);
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 3, FP_MD5, NC_TLS_CTN_SPECIFIED, "md5"), 0);
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 7, FP_SHA1, NC_TLS_CTN_SPECIFIED, "sha1"), 0);
+    assert_int_equal(test_ctn_index_count(), 3);
+    test_username("md5");
+
+    /* lower id added later */
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 1, FP_SHA1, NC_TLS_CTN_SPECIFIED, "sha1-first"), 0);
+    test_username("sha1-first");
+}
+
+static void
+test_ctn_case(void **state)
+{
+    (void)state;
+
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 1, FP_SHA1_LOWER, NC_TLS_CTN_SPECIFIED, "lower"), 0);
+    test_username("lower");
+
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 1, FP_SHA1, NC_TLS_CTN_SPECIFIED, "upper"), 0);
+    test_username("upper");
+}
+
+static void
+test_ctn_skipped(void **state)
+{
+    (void)state;
+
+    /* unknown algorithm, no name, no map type */
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 1, FP_UNKNOWN, NC_TLS_CTN_SPECIFIED, "unknown"), 0);
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 2, FP_SHA1, NC_TLS_CTN_SPECIFIED, NULL), 0);
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 3, FP_SHA1, 0, "no-map-type"), 0);
+    assert_int_equal(test_ctn_index_count(), 0);
+    test_username(NULL);
+
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 4, FP_SHA256, NC_TLS_CTN_SPECIFIED, "valid"), 0);
+    assert_int_equal(test_ctn_index_count(), 1);
+    test_username("valid");
+}
+
+static void
+test_ctn_del(void **state)
+{
+    (void)state;
+
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 1, FP_SHA1, NC_TLS_CTN_SPECIFIED, "first"), 0);
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 2, FP_SHA256, NC_TLS_CTN_SPECIFIED, "second"), 0);
+    test_username("first");
+
+    assert_int_equal(nc_server_tls_endpt_del_ctn("main_tls", 1, NULL, 0, NULL), 0);
+    assert_int_equal(test_ctn_index_count(), 1);
+    test_username("second");
+
+    assert_int_equal(nc_server_tls_endpt_del_ctn("main_tls", -1, FP_SHA256, 0, NULL), 0);
+    assert_int_equal(test_ctn_index_count(), -1);
+    test_username(NULL);
+}
+
+static void
+test_ctn_batch(void **state)
+{
+    (void)state;
+
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 2, FP_SHA256, NC_TLS_CTN_SPECIFIED, "second"), 0);
+    test_username("second");
+
+    /* the staged entries are indexed on commit */
+    assert_int_equal(nc_server_config_begin(), 0);
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 1, FP_MD5, NC_TLS_CTN_SPECIFIED, "first"), 0);
+    assert_int_equal(nc_server_config_commit(), 0);
+    assert_int_equal(test_ctn_index_count(), 2);
+    test_username("first");
+
+    /* the index of unchanged entries is kept */
+    assert_int_equal(nc_server_config_begin(), 0);
+    assert_int_equal(nc_server_tls_endpt_set_ktls("main_tls", 0), 0);
+    assert_int_equal(nc_server_config_commit(), 0);
+    assert_int_equal(test_ctn_index_count(), 2);
+    test_username("first");
+}
+
+static void
+test_ctn_linear(void **state)
+{
+    struct nc_endpt *endpt;
+
+    (void)state;
+
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 2, FP_SHA1, NC_TLS_CTN_SPECIFIED, "second"), 0);
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 1, FP_SHA256, NC_TLS_CTN_SPECIFIED, "first"), 0);
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 0, FP_UNKNOWN, NC_TLS_CTN_SPECIFIED, "unknown"), 0);
+
+    /* as if the index could not be created */
+    endpt = nc_server_endpt_lock_get("main_tls", NC_TI_OPENSSL, NULL);
+    assert_non_null(endpt);
+    free(endpt->opts.tls->ctn_index);
+    endpt->opts.tls->ctn_index = NULL;
+    endpt->opts.tls->ctn_index_size = 0;
+    nc_server_endpt_unlock();
+
+    test_username("first");
+}
+
+int
+main(void)
+{
+    int ret;
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
+    assert_non_null(ctx);
+    assert_non_null(ly_ctx_load_module(ctx, "ietf-netconf", NULL, NULL));
+
+    nc_server_init();
+
+    /* server */
+    nc_server_tls_set_server_cert_clb(clb_server_cert, NULL, NULL);
+    nc_server_tls_set_trusted_cert_list_clb(clb_trusted_cert_lists, NULL, NULL);
+    assert_int_equal(nc_server_add_endpt("main_tls", NC_TI_OPENSSL), 0);
+    assert_int_equal(nc_server_endpt_set_address("main_tls", "127.0.0.1"), 0);
+    assert_int_equal(nc_server_endpt_set_port("main_tls", TEST_PORT), 0);
+    assert_int_equal(nc_server_tls_endpt_set_server_cert("main_tls", "server_cert"), 0);
+    assert_int_equal(nc_server_tls_endpt_add_trusted_cert_list("main_tls", "client_cert_list"), 0);
+
+    /* client */
+    assert_int_equal(nc_client_tls_set_cert_key_paths(TESTS_DIR "/data/client.crt", TESTS_DIR "/data/client.key"), 0);
+    assert_int_equal(nc_client_tls_set_trusted_ca_paths(NULL, TESTS_DIR "/data"), 0);
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_teardown(test_ctn_lowest_id, teardown_f),
+        cmocka_unit_test_teardown(test_ctn_case, teardown_f),
+        cmocka_unit_test_teardown(test_ctn_skipped, teardown_f),
+        cmocka_unit_test_teardown(test_ctn_del, teardown_f),
+        cmocka_unit_test_teardown(test_ctn_batch, teardown_f),
+        cmocka_unit_test_teardown(test_ctn_linear, teardown_f),
+    };
+
+    ret = cmocka_run_group_tests(tests, NULL, NULL);
+
+    nc_client_destroy();
+    nc_server_destroy();
+    ly_ctx_destroy(ctx);
+
+    return ret;
+}
@@ -0,0 +1,315 @@
+/**
+ * \file test_tls_ctx.c
+ * \brief libnetconf2 tests - TLS context cached by the server endpoints
+ *
+ * Copyright (c) 2015 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <libyang/libyang.h>
+
+#include <session_client.h>
+#include <session_p.h>
+#include <session_server.h>
+#include "tests/config.h"
+
+#define TEST_PORT 6011
+
+struct ly_ctx *ctx;
+ATOMIC_T cert_clb_count;
+
+static int
+clb_server_cert(const char *name, void *user_data, char **cert_path, char **cert_data, char **privkey_path,
+        char **privkey_data, NC_SSH_KEY_TYPE *privkey_type)
+{
+    (void)user_data;
+    (void)cert_data;
+    (void)privkey_data;
+    (void)privkey_type;
+
+    ATOMIC_INC_RELAXED(cert_clb_count);
+
+    assert_string_equal(name, "server_cert");
+    *cert_path = strdup(TESTS_DIR "/data/server.crt");
+    *privkey_path = strdup(TESTS_DIR "/data/server.key");
+    return 0;
+}
+
+static int
+clb_trusted_cert_lists(const char *name, void *user_data, char ***cert_paths, int *cert_path_count,
+        char ***cert_data, int *cert_data_count)
+{
+    (void)user_data;
+    (void)cert_data;
+    (void)cert_data_count;
+
+    assert_string_equal(name, "client_cert_list");
+    *cert_paths = malloc(sizeof **cert_paths);
+    (*cert_paths)[0] = strdup(TESTS_DIR "/data/client.crt");
+    *cert_path_count = 1;
+    return 0;
+}
+
+static struct nc_server_reply *
+my_get_rpc_clb(struct lyd_node *rpc, struct nc_session *session)
+{
+    (void)session;
+
+    assert_string_equal(rpc->schema->name, "get");
+    return nc_server_reply_ok();
+}
+
+static void *
+server_thread(void *arg)
+{
+    struct nc_session **session = arg;
+    NC_MSG_TYPE msgtype;
+
+    msgtype = nc_accept(5000, ctx, session);
+    assert_int_equal(msgtype, NC_MSG_HELLO);
+
+    return NULL;
+}
+
+/**
+ * @brief Connect a new client session.
+ *
+ * @param[out] server_session Accepted server session.
+ * @return Client session.
+ */
+static struct nc_session *
+test_connect(struct nc_session **server_session)
+{
+    struct nc_session *client_session;
+    pthread_t server_tid;
+
+    *server_session = NULL;
+    assert_int_equal(pthread_create(&server_tid, NULL, server_thread, server_session), 0);
+    client_session = nc_connect_tls("127.0.0.1", TEST_PORT, ctx);
+    assert_non_null(client_session);
+    pthread_join(server_tid, NULL);
+    assert_non_null(*server_session);
+
+    return client_session;
+}
+
+/**
+ * @brief Connect a new client session and close it right away.
+ */
+static void
+test_connect_close(void)
+{
+    struct nc_session *server_session, *client_session;
+
+    client_session = test_connect(&server_session);
+    nc_session_free(client_session, NULL);
+    nc_session_free(server_session, NULL);
+}
+
+/**
+ * @brief Get the TLS context cached by the endpoint.
+ *
+ * @param[out] gen Optional generation of the global callbacks the context was created with.
+ * @return Cached context, NULL if none.
+ */
+static SSL_CTX *
+test_endpt_ctx(uint32_t *gen)
+{
+    struct nc_endpt *endpt;
+    SSL_CTX *tls_ctx;
+
+    endpt = nc_server_endpt_lock_get("main_tls", NC_TI_OPENSSL, NULL);
+    assert_non_null(endpt);
+    tls_ctx = endpt->opts.tls->tls_ctx;
+    if (gen) {
+        *gen = endpt->opts.tls->tls_ctx_gen;
+    }
+    nc_server_endpt_unlock();
+
+    return tls_ctx;
+}
+
+static void
+test_ctx_cached(void **state)
+{
+    SSL_CTX *tls_ctx;
+    int count;
+
+    (void)state;
+
+    test_connect_close();
+    tls_ctx = test_endpt_ctx(NULL);
+    assert_non_null(tls_ctx);
+
+    /* the next session uses the same context without loading the certificates again */
+    count = ATOMIC_LOAD_RELAXED(cert_clb_count);
+    test_connect_close();
+    assert_ptr_equal(test_endpt_ctx(NULL), tls_ctx);
+    assert_int_equal(ATOMIC_LOAD_RELAXED(cert_clb_count), count);
+}
+
+static void
+test_ctx_setters(void **state)
+{
+    int count;
+
+    (void)state;
+
+    test_connect_close();
+    assert_non_null(test_endpt_ctx(NULL));
+
+    /* server certificate */
+    count = ATOMIC_LOAD_RELAXED(cert_clb_count);
+    assert_int_equal(nc_server_tls_endpt_set_server_cert("main_tls", "server_cert"), 0);
+    assert_null(test_endpt_ctx(NULL));
+    test_connect_close();
+    assert_non_null(test_endpt_ctx(NULL));
+    assert_int_equal(ATOMIC_LOAD_RELAXED(cert_clb_count), count + 1);
+
+    /* trusted certificate lists */
+    count = ATOMIC_LOAD_RELAXED(cert_clb_count);
+    assert_int_equal(nc_server_tls_endpt_del_trusted_cert_list("main_tls", "client_cert_list"), 0);
+    assert_null(test_endpt_ctx(NULL));
+    assert_int_equal(nc_server_tls_endpt_add_trusted_cert_list("main_tls", "client_cert_list"), 0);
+    assert_null(test_endpt_ctx(NULL));
+    test_connect_close();
+    assert_non_null(test_endpt_ctx(NULL));
+    assert_int_equal(ATOMIC_LOAD_RELAXED(cert_clb_count), count + 1);
+
+    /* trusted CA paths */
+    count = ATOMIC_LOAD_RELAXED(cert_clb_count);
+    assert_int_equal(nc_server_tls_endpt_set_trusted_ca_paths("main_tls", NULL, TESTS_DIR "/data"), 0);
+    assert_null(test_endpt_ctx(NULL));
+    test_connect_close();
+    assert_non_null(test_endpt_ctx(NULL));
+    assert_int_equal(ATOMIC_LOAD_RELAXED(cert_clb_count), count + 1);
+}
+
+static void
+test_ctx_global_clb(void **state)
+{
+    uint32_t gen, new_gen;
+    int count;
+
+    (void)state;
+
+    test_connect_close();
+    assert_non_null(test_endpt_ctx(&gen));
+
+    /* the context is kept until the next session is accepted, created again with the new callback */
+    count = ATOMIC_LOAD_RELAXED(cert_clb_count);
+    nc_server_tls_set_server_cert_clb(clb_server_cert, NULL, NULL);
+    test_connect_close();
+    assert_non_null(test_endpt_ctx(&new_gen));
+    assert_int_not_equal(new_gen, gen);
+    assert_int_equal(ATOMIC_LOAD_RELAXED(cert_clb_count), count + 1);
+
+    /* same for the trusted certificate lists callback */
+    gen = new_gen;
+    count = ATOMIC_LOAD_RELAXED(cert_clb_count);
+    nc_server_tls_set_trusted_cert_list_clb(clb_trusted_cert_lists, NULL, NULL);
+    test_connect_close();
+    assert_non_null(test_endpt_ctx(&new_gen));
+    assert_int_not_equal(new_gen, gen);
+    assert_int_equal(ATOMIC_LOAD_RELAXED(cert_clb_count), count + 1);
+}
+
+static void
+test_ctx_session_outlives(void **state)
+{
+    struct nc_session *server_session, *client_session;
+    struct nc_pollsession *ps;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    uint64_t msgid;
+
+    (void)state;
+
+    client_session = test_connect(&server_session);
+
+    /* free the context the session was created from */
+    assert_int_equal(nc_server_tls_endpt_set_server_cert("main_tls", "server_cert"), 0);
+    assert_null(test_endpt_ctx(NULL));
+    test_connect_close();
+
+    /* the session still works */
+    rpc = nc_rpc_get(NULL, 0, NC_PARAMTYPE_CONST);
+    assert_non_null(rpc);
+    assert_int_equal(nc_send_rpc(client_session, rpc, 1000, &msgid), NC_MSG_RPC);
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    assert_int_equal(nc_ps_add_session(ps, server_session), 0);
+    assert_int_equal(nc_ps_poll(ps, 1000, NULL), NC_PSPOLL_RPC);
+    nc_ps_free(ps);
+
+    assert_int_equal(nc_recv_reply(client_session, rpc, msgid, 1000, &envp, &op), NC_MSG_REPLY);
+    assert_null(op);
+    lyd_free_tree(envp);
+    nc_rpc_free(rpc);
+
+    nc_session_free(client_session, NULL);
+    nc_session_free(server_session, NULL);
+}
+
+int
+main(void)
+{
+    int ret;
+    struct lysc_node *node;
+
+    ly_ctx_new(TESTS_DIR "/data/modules", 0, &ctx);
+    assert_non_null(ctx);
+    assert_non_null(ly_ctx_load_module(ctx, "ietf-netconf", NULL, NULL));
+
+    node = (struct lysc_node *)lys_find_path(ctx, NULL, "/ietf-netconf:get", 0);
+    assert_non_null(node);
+    node->priv = my_get_rpc_clb;
+
+    nc_server_init();
+
+    /* server */
+    nc_server_tls_set_server_cert_clb(clb_server_cert, NULL, NULL);
+    nc_server_tls_set_trusted_cert_list_clb(clb_trusted_cert_lists, NULL, NULL);
+    assert_int_equal(nc_server_add_endpt("main_tls", NC_TI_OPENSSL), 0);
+    assert_int_equal(nc_server_endpt_set_address("main_tls", "127.0.0.1"), 0);
+    assert_int_equal(nc_server_endpt_set_port("main_tls", TEST_PORT), 0);
+    assert_int_equal(nc_server_tls_endpt_set_server_cert("main_tls", "server_cert"), 0);
+    assert_int_equal(nc_server_tls_endpt_add_trusted_cert_list("main_tls", "client_cert_list"), 0);
+    assert_int_equal(nc_server_tls_endpt_add_ctn("main_tls", 0,
+            "02:B3:9F:26:65:76:6B:CC:FC:86:8E:D4:1A:81:64:0F:92:EB:18:AE:FF", NC_TLS_CTN_SPECIFIED, "test"), 0);
+
+    /* client */
+    assert_int_equal(nc_client_tls_set_cert_key_paths(TESTS_DIR "/data/client.crt", TESTS_DIR "/data/client.key"), 0);
+    assert_int_equal(nc_client_tls_set_trusted_ca_paths(NULL, TESTS_DIR "/data"), 0);
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_ctx_cached),
+        cmocka_unit_test(test_ctx_setters),
+        cmocka_unit_test(test_ctx_global_clb),
+        cmocka_unit_test(test_ctx_session_outlives),
+    };
+
+    ret = cmocka_run_group_tests(tests, NULL, NULL);
+
+    nc_client_destroy();
+    nc_server_destroy();
+    ly_ctx_destroy(ctx);
+
+    return ret;
+}